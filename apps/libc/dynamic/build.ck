@@ -106,6 +106,7 @@ function build() {
         "convert.c",
         "ctype.c",
         "dirio.c",
+        "dnscache.c",
         "dynlib.c",
         "env.c",
         "err.c",
@@ -126,11 +127,13 @@ function build() {
         "line.c",
         "locale.c",
         "memory.c",
+        "msort.c",
         "netaddr.c",
         "netent.c",
         "passwd.c",
         "path.c",
         "pid.c",
+        "psort.c",
         "pthread/atfork.c",
         "pthread/barrier.c",
         "pthread/cond.c",
@@ -149,6 +152,7 @@ function build() {
         "realpath.c",
         "regexcmp.c",
         "regexexe.c",
+        "regexnfa.c",
         "resolv.c",
         "resource.c",
         "scan.c",
@@ -186,14 +190,17 @@ function build() {
     buildSources = [
         "bsearch.c",
         "getopt.c",
+        "msort.c",
         "qsort.c",
         "regexcmp.c",
-        "regexexe.c"
+        "regexexe.c",
+        "regexnfa.c"
     ];
 
     wincsupSources = [
         "regexcmp.c",
         "regexexe.c",
+        "regexnfa.c",
         "wincsup/strftime.c"
     ];
 
@@ -0,0 +1,840 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    dnscache.c
+
+Abstract:
+
+    This module implements the DNS answer cache used by getaddrinfo. The cache
+    is private to the process unless the DNSCACHESHM environment variable
+    names a shared memory object, in which case all processes naming the same
+    object share one cache.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the environment variable that names a shared memory object to keep
+// the cache in.
+//
+
+#define DNS_CACHE_SHARED_VARIABLE "DNSCACHESHM"
+
+#define DNS_CACHE_MAGIC 0x68436E44
+
+//
+// Define the shape of the cache. Names hash to a set, and an answer can live
+// in any way of its set.
+//
+
+#define DNS_CACHE_SET_COUNT 32
+#define DNS_CACHE_WAY_COUNT 4
+#define DNS_CACHE_ENTRY_COUNT (DNS_CACHE_SET_COUNT * DNS_CACHE_WAY_COUNT)
+
+//
+// Define the longest time in seconds a positive answer is kept, regardless of
+// its time to live.
+//
+
+#define DNS_CACHE_MAX_TIME_TO_LIVE 3600
+
+//
+// Define the time in seconds a negative answer is kept.
+//
+
+#define DNS_CACHE_NEGATIVE_TIME_TO_LIVE 30
+
+//
+// Define the number of times to try for the lock of a shared cache before
+// checking whether its owner is still alive. If the owner is alive, the
+// operation is treated as a miss. If it died holding the lock, the lock is
+// taken over.
+//
+
+#define DNS_CACHE_LOCK_ATTEMPTS 100
+
+//
+// Define the cache states.
+//
+
+#define DNS_CACHE_STATE_UNINITIALIZED 0
+#define DNS_CACHE_STATE_INITIALIZING 1
+#define DNS_CACHE_STATE_READY 2
+#define DNS_CACHE_STATE_FAILED 3
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores one entry in the DNS cache.
+
+Members:
+
+    Hash - Stores the hash of the name.
+
+    RecordType - Stores the DNS record type of the answer.
+
+    LastUse - Stores the value of the cache use counter the last time this
+        entry was used, for picking an entry to replace.
+
+    ExpirationTime - Stores the time at which the entry expires. Zero means
+        the entry is empty.
+
+    Name - Stores the lowercase name the answer is for.
+
+    Answer - Stores the cached answer.
+
+--*/
+
+typedef struct _DNS_CACHE_ENTRY {
+    ULONG Hash;
+    ULONG RecordType;
+    ULONG LastUse;
+    time_t ExpirationTime;
+    CHAR Name[DNS_CACHE_NAME_SIZE];
+    DNS_CACHE_ANSWER Answer;
+} DNS_CACHE_ENTRY, *PDNS_CACHE_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure stores the DNS cache. When the cache is shared, this
+    structure is the contents of the shared memory object.
+
+Members:
+
+    Magic - Stores the constant DNS_CACHE_MAGIC once the cache is initialized.
+
+    State - Stores the initialization state. See DNS_CACHE_STATE_*
+        definitions.
+
+    Size - Stores the size of this structure, which guards against sharing
+        a cache with a process built with a different layout.
+
+    UseCounter - Stores a counter incremented on every hit or insert.
+
+    Lock - Stores the mutex protecting the entries of a private cache.
+
+    LockOwner - Stores the ID of the process holding the lock of a shared
+        cache, or zero if the lock is free. Recording the owner lets other
+        processes notice when it died while holding the lock.
+
+    Entries - Stores the cache entries.
+
+--*/
+
+typedef struct _DNS_CACHE {
+    ULONG Magic;
+    ULONG State;
+    ULONG Size;
+    ULONG UseCounter;
+    pthread_mutex_t Lock;
+    ULONG LockOwner;
+    DNS_CACHE_ENTRY Entries[DNS_CACHE_ENTRY_COUNT];
+} DNS_CACHE, *PDNS_CACHE;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+PDNS_CACHE
+ClpDnsCacheGet (
+    VOID
+    );
+
+PDNS_CACHE
+ClpDnsCacheMapShared (
+    PSTR ObjectName
+    );
+
+INT
+ClpDnsCacheInitialize (
+    PDNS_CACHE Cache,
+    BOOL Shared
+    );
+
+BOOL
+ClpDnsCacheAcquireLock (
+    PDNS_CACHE Cache
+    );
+
+VOID
+ClpDnsCacheReleaseLock (
+    PDNS_CACHE Cache
+    );
+
+BOOL
+ClpDnsCachePrepareName (
+    PCSTR Name,
+    PSTR LowercaseName,
+    PULONG Hash
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store a pointer to the cache, which is valid once the state is ready.
+//
+
+PDNS_CACHE ClDnsCache;
+ULONG ClDnsCacheState = DNS_CACHE_STATE_UNINITIALIZED;
+BOOL ClDnsCacheShared;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+BOOL
+ClpDnsCacheLookup (
+    PCSTR Name,
+    USHORT RecordType,
+    PDNS_CACHE_ANSWER Answer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks for an unexpired answer in the DNS cache.
+
+Arguments:
+
+    Name - Supplies the name being translated.
+
+    RecordType - Supplies the DNS record type being requested.
+
+    Answer - Supplies a pointer where the cached answer will be returned on
+        success. The time to live is set to the number of seconds remaining.
+
+Return Value:
+
+    TRUE if a cached answer was found.
+
+    FALSE if the name must be translated.
+
+--*/
+
+{
+
+    PDNS_CACHE Cache;
+    time_t CurrentTime;
+    PDNS_CACHE_ENTRY Entry;
+    BOOL Found;
+    ULONG Hash;
+    CHAR LowercaseName[DNS_CACHE_NAME_SIZE];
+    ULONG Way;
+
+    Cache = ClpDnsCacheGet();
+    if (Cache == NULL) {
+        return FALSE;
+    }
+
+    if (ClpDnsCachePrepareName(Name, LowercaseName, &Hash) == FALSE) {
+        return FALSE;
+    }
+
+    if (ClpDnsCacheAcquireLock(Cache) == FALSE) {
+        return FALSE;
+    }
+
+    CurrentTime = time(NULL);
+    Found = FALSE;
+    Entry = &(Cache->Entries[(Hash % DNS_CACHE_SET_COUNT) *
+                             DNS_CACHE_WAY_COUNT]);
+
+    for (Way = 0; Way < DNS_CACHE_WAY_COUNT; Way += 1) {
+        if ((Entry->Hash == Hash) &&
+            (Entry->RecordType == RecordType) &&
+            (Entry->ExpirationTime > CurrentTime) &&
+            (strcmp(Entry->Name, LowercaseName) == 0)) {
+
+            memcpy(Answer, &(Entry->Answer), sizeof(DNS_CACHE_ANSWER));
+            Answer->TimeToLive = Entry->ExpirationTime - CurrentTime;
+            Cache->UseCounter += 1;
+            Entry->LastUse = Cache->UseCounter;
+            Found = TRUE;
+            break;
+        }
+
+        Entry += 1;
+    }
+
+    ClpDnsCacheReleaseLock(Cache);
+    return Found;
+}
+
+VOID
+ClpDnsCacheInsert (
+    PCSTR Name,
+    USHORT RecordType,
+    PDNS_CACHE_ANSWER Answer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine saves an answer in the DNS cache, replacing any previous
+    answer for the same name and record type.
+
+Arguments:
+
+    Name - Supplies the name that was translated.
+
+    RecordType - Supplies the DNS record type that was requested.
+
+    Answer - Supplies a pointer to the answer to save. Positive answers are
+        kept for their time to live, capped at a maximum. Negative answers
+        (those with no addresses) are kept for a short fixed time.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PDNS_CACHE Cache;
+    time_t CurrentTime;
+    PDNS_CACHE_ENTRY Entry;
+    ULONG Hash;
+    CHAR LowercaseName[DNS_CACHE_NAME_SIZE];
+    ULONG TimeToLive;
+    PDNS_CACHE_ENTRY Victim;
+    ULONG Way;
+
+    if (Answer->AddressCount > DNS_CACHE_MAX_ADDRESSES) {
+        return;
+    }
+
+    //
+    // Negative answers don't carry a usable time to live (that would require
+    // the SOA minimum from the authority section), so they get a short fixed
+    // lifetime instead.
+    //
+
+    if (Answer->AddressCount == 0) {
+        TimeToLive = DNS_CACHE_NEGATIVE_TIME_TO_LIVE;
+
+    } else {
+        TimeToLive = Answer->TimeToLive;
+        if (TimeToLive > DNS_CACHE_MAX_TIME_TO_LIVE) {
+            TimeToLive = DNS_CACHE_MAX_TIME_TO_LIVE;
+        }
+    }
+
+    if (TimeToLive == 0) {
+        return;
+    }
+
+    Cache = ClpDnsCacheGet();
+    if (Cache == NULL) {
+        return;
+    }
+
+    if (ClpDnsCachePrepareName(Name, LowercaseName, &Hash) == FALSE) {
+        return;
+    }
+
+    if (ClpDnsCacheAcquireLock(Cache) == FALSE) {
+        return;
+    }
+
+    //
+    // Replace the existing answer for this name if there is one. Otherwise
+    // take an empty or expired way, or failing that the least recently used
+    // one.
+    //
+
+    CurrentTime = time(NULL);
+    Entry = &(Cache->Entries[(Hash % DNS_CACHE_SET_COUNT) *
+                             DNS_CACHE_WAY_COUNT]);
+
+    Victim = Entry;
+    for (Way = 0; Way < DNS_CACHE_WAY_COUNT; Way += 1) {
+        if ((Entry->Hash == Hash) &&
+            (Entry->RecordType == RecordType) &&
+            (strcmp(Entry->Name, LowercaseName) == 0)) {
+
+            Victim = Entry;
+            break;
+        }
+
+        if (Victim->ExpirationTime > CurrentTime) {
+            if ((Entry->ExpirationTime <= CurrentTime) ||
+                ((LONG)(Entry->LastUse - Victim->LastUse) < 0)) {
+
+                Victim = Entry;
+            }
+        }
+
+        Entry += 1;
+    }
+
+    Victim->Hash = Hash;
+    Victim->RecordType = RecordType;
+    Victim->ExpirationTime = CurrentTime + TimeToLive;
+    strcpy(Victim->Name, LowercaseName);
+    memcpy(&(Victim->Answer), Answer, sizeof(DNS_CACHE_ANSWER));
+    Victim->Answer.TimeToLive = TimeToLive;
+    Cache->UseCounter += 1;
+    Victim->LastUse = Cache->UseCounter;
+    ClpDnsCacheReleaseLock(Cache);
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+PDNS_CACHE
+ClpDnsCacheGet (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the DNS cache, creating it on first use.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the cache on success.
+
+    NULL if the cache could not be created, or another thread is creating it
+    right now.
+
+--*/
+
+{
+
+    PDNS_CACHE Cache;
+    PSTR ObjectName;
+    ULONG State;
+
+    State = RtlAtomicOr32(&ClDnsCacheState, 0);
+    if (State == DNS_CACHE_STATE_READY) {
+        return ClDnsCache;
+    }
+
+    //
+    // Only one thread gets to create the cache. Anyone else who comes along
+    // in the meantime just goes without.
+    //
+
+    State = RtlAtomicCompareExchange32(&ClDnsCacheState,
+                                       DNS_CACHE_STATE_INITIALIZING,
+                                       DNS_CACHE_STATE_UNINITIALIZED);
+
+    if (State != DNS_CACHE_STATE_UNINITIALIZED) {
+        return NULL;
+    }
+
+    Cache = NULL;
+    ObjectName = getenv(DNS_CACHE_SHARED_VARIABLE);
+    if ((ObjectName != NULL) && (*ObjectName != '\0')) {
+        Cache = ClpDnsCacheMapShared(ObjectName);
+        if (Cache != NULL) {
+            ClDnsCacheShared = TRUE;
+        }
+    }
+
+    if (Cache == NULL) {
+        Cache = malloc(sizeof(DNS_CACHE));
+        if (Cache != NULL) {
+            memset(Cache, 0, sizeof(DNS_CACHE));
+            if (ClpDnsCacheInitialize(Cache, FALSE) != 0) {
+                free(Cache);
+                Cache = NULL;
+            }
+        }
+    }
+
+    ClDnsCache = Cache;
+    State = DNS_CACHE_STATE_FAILED;
+    if (Cache != NULL) {
+        State = DNS_CACHE_STATE_READY;
+    }
+
+    RtlAtomicExchange32(&ClDnsCacheState, State);
+    return Cache;
+}
+
+PDNS_CACHE
+ClpDnsCacheMapShared (
+    PSTR ObjectName
+    )
+
+/*++
+
+Routine Description:
+
+    This routine opens or creates the shared memory object holding a shared
+    DNS cache and maps it into the process. The first process to map the
+    object initializes it.
+
+Arguments:
+
+    ObjectName - Supplies the name of the shared memory object.
+
+Return Value:
+
+    Returns a pointer to the mapped cache on success.
+
+    NULL on failure.
+
+--*/
+
+{
+
+    ULONG Attempt;
+    PDNS_CACHE Cache;
+    int Descriptor;
+    int Result;
+    struct stat Stat;
+    ULONG State;
+
+    //
+    // Only allow the owner to get at the cache, as anyone who can write to it
+    // can redirect every name lookup.
+    //
+
+    Descriptor = shm_open(ObjectName, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (Descriptor < 0) {
+        return NULL;
+    }
+
+    Cache = NULL;
+    Result = fstat(Descriptor, &Stat);
+    if (Result != 0) {
+        goto DnsCacheMapSharedEnd;
+    }
+
+    //
+    // The creation mode above only applies if this process created the
+    // object. Refuse an object that someone else made, or that others can
+    // get at, since they could feed this process bogus answers.
+    //
+
+    if ((Stat.st_uid != geteuid()) ||
+        ((Stat.st_mode & (S_IRWXG | S_IRWXO)) != 0)) {
+
+        goto DnsCacheMapSharedEnd;
+    }
+
+    if (Stat.st_size < sizeof(DNS_CACHE)) {
+        Result = ftruncate(Descriptor, sizeof(DNS_CACHE));
+        if (Result != 0) {
+            goto DnsCacheMapSharedEnd;
+        }
+    }
+
+    Cache = mmap(NULL,
+                 sizeof(DNS_CACHE),
+                 PROT_READ | PROT_WRITE,
+                 MAP_SHARED,
+                 Descriptor,
+                 0);
+
+    if (Cache == MAP_FAILED) {
+        Cache = NULL;
+        goto DnsCacheMapSharedEnd;
+    }
+
+    //
+    // A freshly created object is all zeroes. Race to initialize it, and if
+    // another process won, give it a moment to finish.
+    //
+
+    State = RtlAtomicCompareExchange32(&(Cache->State),
+                                       DNS_CACHE_STATE_INITIALIZING,
+                                       DNS_CACHE_STATE_UNINITIALIZED);
+
+    if (State == DNS_CACHE_STATE_UNINITIALIZED) {
+        State = DNS_CACHE_STATE_FAILED;
+        if (ClpDnsCacheInitialize(Cache, TRUE) == 0) {
+            State = DNS_CACHE_STATE_READY;
+        }
+
+        RtlAtomicExchange32(&(Cache->State), State);
+
+    } else {
+        for (Attempt = 0; Attempt < DNS_CACHE_LOCK_ATTEMPTS; Attempt += 1) {
+            State = RtlAtomicOr32(&(Cache->State), 0);
+            if (State != DNS_CACHE_STATE_INITIALIZING) {
+                break;
+            }
+
+            sched_yield();
+        }
+    }
+
+    if ((State != DNS_CACHE_STATE_READY) ||
+        (Cache->Magic != DNS_CACHE_MAGIC) ||
+        (Cache->Size != sizeof(DNS_CACHE))) {
+
+        munmap(Cache, sizeof(DNS_CACHE));
+        Cache = NULL;
+    }
+
+DnsCacheMapSharedEnd:
+    close(Descriptor);
+    return Cache;
+}
+
+INT
+ClpDnsCacheInitialize (
+    PDNS_CACHE Cache,
+    BOOL Shared
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the header of a zeroed DNS cache.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to initialize.
+
+    Shared - Supplies a boolean indicating whether the cache lives in shared
+        memory. A shared cache is protected by its lock owner rather than by
+        a mutex, which starts out free in a zeroed cache.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    INT Status;
+
+    if (Shared == FALSE) {
+        Status = pthread_mutex_init(&(Cache->Lock), NULL);
+        if (Status != 0) {
+            return Status;
+        }
+    }
+
+    Cache->Size = sizeof(DNS_CACHE);
+    Cache->Magic = DNS_CACHE_MAGIC;
+    return 0;
+}
+
+BOOL
+ClpDnsCacheAcquireLock (
+    PDNS_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires the DNS cache lock. The lock of a shared cache
+    records the process that holds it. If the holder does not let go after a
+    bounded number of tries, the lock is taken over if the holder has died,
+    and the entries it may have been halfway through changing are thrown
+    out.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache.
+
+Return Value:
+
+    TRUE if the lock was acquired.
+
+    FALSE if the lock could not be acquired.
+
+--*/
+
+{
+
+    ULONG Attempt;
+    ULONG Owner;
+    ULONG Process;
+
+    if (ClDnsCacheShared == FALSE) {
+        pthread_mutex_lock(&(Cache->Lock));
+        return TRUE;
+    }
+
+    Process = getpid();
+    Owner = 0;
+    for (Attempt = 0; Attempt < DNS_CACHE_LOCK_ATTEMPTS; Attempt += 1) {
+        Owner = RtlAtomicCompareExchange32(&(Cache->LockOwner), Process, 0);
+        if (Owner == 0) {
+            return TRUE;
+        }
+
+        sched_yield();
+    }
+
+    //
+    // Another thread in this process might be the holder, in which case it
+    // is certainly alive.
+    //
+
+    if ((Owner == Process) || (kill(Owner, 0) == 0) || (errno != ESRCH)) {
+        return FALSE;
+    }
+
+    if (RtlAtomicCompareExchange32(&(Cache->LockOwner), Process, Owner) !=
+        Owner) {
+
+        return FALSE;
+    }
+
+    memset(Cache->Entries, 0, sizeof(Cache->Entries));
+    return TRUE;
+}
+
+VOID
+ClpDnsCacheReleaseLock (
+    PDNS_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the DNS cache lock.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (ClDnsCacheShared == FALSE) {
+        pthread_mutex_unlock(&(Cache->Lock));
+
+    } else {
+        RtlAtomicExchange32(&(Cache->LockOwner), 0);
+    }
+
+    return;
+}
+
+BOOL
+ClpDnsCachePrepareName (
+    PCSTR Name,
+    PSTR LowercaseName,
+    PULONG Hash
+    )
+
+/*++
+
+Routine Description:
+
+    This routine lowercases and hashes a name for the DNS cache, since DNS
+    names are case insensitive.
+
+Arguments:
+
+    Name - Supplies the name to prepare.
+
+    LowercaseName - Supplies a pointer to a buffer of DNS_CACHE_NAME_SIZE
+        bytes where the lowercase name will be returned.
+
+    Hash - Supplies a pointer where the hash of the lowercase name will be
+        returned.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE if the name is empty or too long to cache.
+
+--*/
+
+{
+
+    CHAR Character;
+    ULONG Index;
+    ULONG Value;
+
+    //
+    // Compute the FNV-1a hash along the way.
+    //
+
+    Value = 0x811C9DC5;
+    for (Index = 0; Name[Index] != '\0'; Index += 1) {
+        if (Index == DNS_CACHE_NAME_SIZE - 1) {
+            return FALSE;
+        }
+
+        Character = tolower((UCHAR)Name[Index]);
+        LowercaseName[Index] = Character;
+        Value = (Value ^ (UCHAR)Character) * 0x01000193;
+    }
+
+    if (Index == 0) {
+        return FALSE;
+    }
+
+    LowercaseName[Index] = '\0';
+    *Hash = Value;
+    return TRUE;
+}
+
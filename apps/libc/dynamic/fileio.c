@@ -1414,6 +1414,157 @@ Return Value:
     return 0;
 }
 
+LIBC_API
+int
+posix_fallocate (
+    int FileDescriptor,
+    off_t Offset,
+    off_t Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ensures that disk space is allocated for the given region of
+    a file. If the region extends beyond the end of the file, the file size is
+    increased to cover it. Subsequent writes to the region will not fail for
+    lack of space.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor to allocate space for. This
+        must be open for writing.
+
+    Offset - Supplies the byte offset of the start of the region.
+
+    Length - Supplies the size of the region in bytes.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+{
+
+    int Error;
+    int OriginalError;
+    struct stat Stat;
+
+    OriginalError = errno;
+    if (fallocate(FileDescriptor, 0, Offset, Length) == 0) {
+        return 0;
+    }
+
+    Error = errno;
+
+    //
+    // If the file system cannot allocate space on its own, fall back to
+    // extending the file, which zero fills it and allocates the space along
+    // the way.
+    //
+
+    if (Error == ENOTSUP) {
+        Error = 0;
+        if (fstat(FileDescriptor, &Stat) != 0) {
+            Error = errno;
+
+        } else if (!S_ISREG(Stat.st_mode)) {
+            Error = ENODEV;
+
+        } else if (Stat.st_size < Offset + Length) {
+            if (ftruncate(FileDescriptor, Offset + Length) != 0) {
+                Error = errno;
+            }
+        }
+    }
+
+    errno = OriginalError;
+    return Error;
+}
+
+LIBC_API
+int
+fallocate (
+    int FileDescriptor,
+    int Mode,
+    off_t Offset,
+    off_t Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates disk space for the given region of a file.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor to allocate space for. This
+        must be open for writing.
+
+    Mode - Supplies a bitmask of flags governing the allocation. See
+        FALLOC_FL_* definitions. If zero, the file size is increased if the
+        region extends beyond the end of the file.
+
+    Offset - Supplies the byte offset of the start of the region.
+
+    Length - Supplies the size of the region in bytes.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
+{
+
+    FILE_CONTROL_PARAMETERS_UNION Parameters;
+    FILE_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if ((Offset < 0) || (Length <= 0) ||
+        ((Mode & ~FALLOC_FL_KEEP_SIZE) != 0)) {
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (Offset + Length < Offset) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    //
+    // Space is always allocated from the start of the file, so the request
+    // only needs to describe where the region ends.
+    //
+
+    Properties.Size = Offset + Length;
+    Parameters.SetFileInformation.FieldsToSet = FILE_PROPERTY_FIELD_ALLOCATION;
+    if ((Mode & FALLOC_FL_KEEP_SIZE) != 0) {
+        Parameters.SetFileInformation.FieldsToSet |=
+                                                FILE_PROPERTY_FIELD_KEEP_SIZE;
+    }
+
+    Parameters.SetFileInformation.FileProperties = &Properties;
+    Status = OsFileControl((HANDLE)(UINTN)FileDescriptor,
+                           FileControlCommandSetFileInformation,
+                           &Parameters);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
+}
+
 LIBC_API
 int
 pipe (
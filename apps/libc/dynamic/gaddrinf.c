@@ -71,6 +71,12 @@ Module Name:
 
 #define DNS_RESPONSE_TIMEOUT 30000
 
+//
+// Define the maximum number of name servers a query is sent to at once.
+//
+
+#define DNS_MAX_PARALLEL_SERVERS 4
+
 //
 // Define the maximum size of the reverse DNS string.
 //
@@ -151,6 +157,14 @@ typedef struct _DNS_RESULT {
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+INT
+ClpPerformCachedDnsTranslation (
+    PSTR Name,
+    UCHAR RecordType,
+    NET_DOMAIN_TYPE Domain,
+    PLIST_ENTRY ListHead
+    );
+
 INT
 ClpPerformDnsTranslation (
     PSTR Name,
@@ -171,8 +185,8 @@ INT
 ClpPerformDnsQuery (
     PSTR Name,
     CHAR RecordType,
-    struct sockaddr *NameServer,
-    socklen_t NameServerSize,
+    struct sockaddr *NameServers,
+    ULONG NameServerCount,
     PLIST_ENTRY ListHead
     );
 
@@ -186,14 +200,21 @@ ClpCreateDnsQuery (
 
 INT
 ClpExecuteDnsQuery (
-    struct sockaddr *NameServer,
-    socklen_t NameServerSize,
+    struct sockaddr *NameServers,
+    ULONG NameServerCount,
     PDNS_HEADER Request,
     ULONG RequestSize,
     PDNS_HEADER *Response,
     PULONG ResponseSize
     );
 
+INT
+ClpSendDnsQuery (
+    struct sockaddr *NameServer,
+    PDNS_HEADER Request,
+    ULONG RequestSize
+    );
+
 INT
 ClpParseDnsResponse (
     PDNS_HEADER Response,
@@ -779,11 +800,10 @@ Return Value:
         //
 
         if ((Family == AF_UNSPEC) || (Family == AF_INET6)) {
-            Status = ClpPerformDnsTranslation((char *)NodeName,
-                                              DNS_RECORD_TYPE_AAAA,
-                                              NetDomainIp6,
-                                              &ResultList,
-                                              0);
+            Status = ClpPerformCachedDnsTranslation((char *)NodeName,
+                                                    DNS_RECORD_TYPE_AAAA,
+                                                    NetDomainIp6,
+                                                    &ResultList);
 
             if (Status != 0) {
                 goto getaddrinfoEnd;
@@ -807,11 +827,10 @@ Return Value:
                 MapV4Addresses = TRUE;
             }
 
-            Status = ClpPerformDnsTranslation((char *)NodeName,
-                                              DNS_RECORD_TYPE_A,
-                                              NetDomainIp4,
-                                              &ResultList,
-                                              0);
+            Status = ClpPerformCachedDnsTranslation((char *)NodeName,
+                                                    DNS_RECORD_TYPE_A,
+                                                    NetDomainIp4,
+                                                    &ResultList);
 
             if (Status != 0) {
                 goto getaddrinfoEnd;
@@ -1195,6 +1214,180 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+INT
+ClpPerformCachedDnsTranslation (
+    PSTR Name,
+    UCHAR RecordType,
+    NET_DOMAIN_TYPE Domain,
+    PLIST_ENTRY ListHead
+    )
+
+/*++
+
+Routine Description:
+
+    This routine translates a name into addresses, using the DNS cache if it
+    has an answer and saving the answer to the cache if it didn't.
+
+Arguments:
+
+    Name - Supplies the name to translate.
+
+    RecordType - Supplies the type of record to query for. This must be
+        DNS_RECORD_TYPE_A or DNS_RECORD_TYPE_AAAA.
+
+    Domain - Supplies the default network domain to use for DNS queries.
+
+    ListHead - Supplies a pointer to the initialized list head where the
+        desired DNS results will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an EAI_* error code on failure.
+
+--*/
+
+{
+
+    PUCHAR Address;
+    ULONG AddressIndex;
+    ULONG AddressSize;
+    DNS_CACHE_ANSWER Answer;
+    PLIST_ENTRY CurrentEntry;
+    time_t CurrentTime;
+    struct sockaddr_in *Ip4Address;
+    struct sockaddr_in6 *Ip6Address;
+    PLIST_ENTRY PreviousEnd;
+    PDNS_RESULT Result;
+    INT Status;
+
+    assert((RecordType == DNS_RECORD_TYPE_A) ||
+           (RecordType == DNS_RECORD_TYPE_AAAA));
+
+    AddressSize = sizeof(struct in_addr);
+    if (RecordType == DNS_RECORD_TYPE_AAAA) {
+        AddressSize = sizeof(struct in6_addr);
+    }
+
+    //
+    // Rebuild the results from a cached answer if there is one.
+    //
+
+    if (ClpDnsCacheLookup(Name, RecordType, &Answer) != FALSE) {
+        if (ClDebugDns != FALSE) {
+            fprintf(stderr,
+                    "DNS: Using cached answer for '%s', %d addresses.\n",
+                    Name,
+                    Answer.AddressCount);
+        }
+
+        if (Answer.Status != 0) {
+            return Answer.Status;
+        }
+
+        CurrentTime = time(NULL);
+        for (AddressIndex = 0;
+             AddressIndex < Answer.AddressCount;
+             AddressIndex += 1) {
+
+            Result = malloc(sizeof(DNS_RESULT));
+            if (Result == NULL) {
+                return EAI_MEMORY;
+            }
+
+            memset(Result, 0, sizeof(DNS_RESULT));
+            Result->Name = strdup(Answer.CanonicalName);
+            if (Result->Name == NULL) {
+                free(Result);
+                return EAI_MEMORY;
+            }
+
+            Result->Type = RecordType;
+            Result->Class = DNS_CLASS_INTERNET;
+            Result->ExpirationTime = CurrentTime + Answer.TimeToLive;
+            Address = Answer.Addresses[AddressIndex];
+            if (RecordType == DNS_RECORD_TYPE_A) {
+                Ip4Address = (struct sockaddr_in *)&(Result->Address);
+                Ip4Address->sin_family = AF_INET;
+                memcpy(&(Ip4Address->sin_addr), Address, AddressSize);
+
+            } else {
+                Ip6Address = (struct sockaddr_in6 *)&(Result->Address);
+                Ip6Address->sin6_family = AF_INET6;
+                memcpy(&(Ip6Address->sin6_addr), Address, AddressSize);
+            }
+
+            INSERT_BEFORE(&(Result->ListEntry), ListHead);
+        }
+
+        return 0;
+    }
+
+    PreviousEnd = ListHead->Previous;
+    Status = ClpPerformDnsTranslation(Name, RecordType, Domain, ListHead, 0);
+
+    //
+    // Only cache real answers: addresses, or the server saying there are
+    // none. Failures to reach a server are not cached.
+    //
+
+    if ((Status != 0) && (Status != EAI_NONAME)) {
+        return Status;
+    }
+
+    memset(&Answer, 0, sizeof(DNS_CACHE_ANSWER));
+    Answer.Status = Status;
+    Answer.TimeToLive = MAX_ULONG;
+    CurrentTime = time(NULL);
+    CurrentEntry = PreviousEnd->Next;
+    while ((Status == 0) && (CurrentEntry != ListHead)) {
+        Result = LIST_VALUE(CurrentEntry, DNS_RESULT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Result->Type != RecordType) {
+            continue;
+        }
+
+        //
+        // Give up on caching answers too big or odd to fit in an entry.
+        //
+
+        if ((Answer.AddressCount == DNS_CACHE_MAX_ADDRESSES) ||
+            (Result->ExpirationTime <= CurrentTime)) {
+
+            return Status;
+        }
+
+        if (Answer.AddressCount == 0) {
+            if (strlen(Result->Name) >= DNS_CACHE_NAME_SIZE) {
+                return Status;
+            }
+
+            strcpy(Answer.CanonicalName, Result->Name);
+        }
+
+        if (Result->ExpirationTime - CurrentTime < Answer.TimeToLive) {
+            Answer.TimeToLive = Result->ExpirationTime - CurrentTime;
+        }
+
+        Address = Answer.Addresses[Answer.AddressCount];
+        if (RecordType == DNS_RECORD_TYPE_A) {
+            Ip4Address = (struct sockaddr_in *)&(Result->Address);
+            memcpy(Address, &(Ip4Address->sin_addr), AddressSize);
+
+        } else {
+            Ip6Address = (struct sockaddr_in6 *)&(Result->Address);
+            memcpy(Address, &(Ip6Address->sin6_addr), AddressSize);
+        }
+
+        Answer.AddressCount += 1;
+    }
+
+    ClpDnsCacheInsert(Name, RecordType, &Answer);
+    return Status;
+}
+
 INT
 ClpPerformDnsTranslation (
     PSTR Name,
@@ -1237,10 +1430,12 @@ Return Value:
 {
 
     PDNS_RESULT Alias;
+    PLIST_ENTRY CurrentEntry;
     BOOL FollowedAlias;
     INT MatchCount;
     PDNS_RESULT NameServer;
-    struct sockaddr NameServerAddress;
+    struct sockaddr NameServerAddresses[DNS_MAX_PARALLEL_SERVERS];
+    ULONG NameServerCount;
     LIST_ENTRY NameServerList;
     INT QueryCount;
     LIST_ENTRY ResultList;
@@ -1276,7 +1471,7 @@ Return Value:
     // to perform the lookup on another network.
     //
 
-    Status = ClpGetDnsServers(Domain, &NameServerAddress, &NameServerList);
+    Status = ClpGetDnsServers(Domain, NameServerAddresses, &NameServerList);
     if (Status != 0) {
         if (Status == ENOENT) {
             if (Domain == NetDomainIp4) {
@@ -1287,7 +1482,7 @@ Return Value:
             }
 
             Status = ClpGetDnsServers(Domain,
-                                      &NameServerAddress,
+                                      NameServerAddresses,
                                       &NameServerList);
         }
 
@@ -1304,6 +1499,27 @@ Return Value:
         }
     }
 
+    //
+    // Send the first query to the primary and the first few alternate
+    // servers all at once, and go with whichever answers first. The
+    // alternates stay on the name server list in case the answer sends the
+    // search elsewhere and that comes up empty.
+    //
+
+    NameServerCount = 1;
+    CurrentEntry = NameServerList.Next;
+    while ((CurrentEntry != &NameServerList) &&
+           (NameServerCount < DNS_MAX_PARALLEL_SERVERS)) {
+
+        NameServer = LIST_VALUE(CurrentEntry, DNS_RESULT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        memcpy(&(NameServerAddresses[NameServerCount]),
+               &(NameServer->Address),
+               sizeof(struct sockaddr));
+
+        NameServerCount += 1;
+    }
+
     //
     // Loop querying name servers for results.
     //
@@ -1311,8 +1527,8 @@ Return Value:
     while (TRUE) {
         Status = ClpPerformDnsQuery(Name,
                                     RecordType,
-                                    &NameServerAddress,
-                                    sizeof(struct sockaddr),
+                                    NameServerAddresses,
+                                    NameServerCount,
                                     &ResultList);
 
         if (Status != 0) {
@@ -1477,7 +1693,7 @@ Return Value:
                 Status = ClpFindNameServerAddress(NameServer,
                                                   RecordType,
                                                   &TranslationList,
-                                                  &NameServerAddress);
+                                                  NameServerAddresses);
 
                 if (Status != 0) {
                     if (ClDebugDns != FALSE) {
@@ -1498,7 +1714,7 @@ Return Value:
                 Status = ClpGetNameServerAddress(NameServer,
                                                  RecordType,
                                                  &TranslationList,
-                                                 &NameServerAddress,
+                                                 NameServerAddresses,
                                                  RecursionDepth);
             }
 
@@ -1509,6 +1725,7 @@ Return Value:
             LIST_REMOVE(&(NameServer->ListEntry));
             ClpDestroyDnsResult(NameServer);
             if (Status == 0) {
+                NameServerCount = 1;
                 break;
             }
         }
@@ -1629,8 +1846,8 @@ INT
 ClpPerformDnsQuery (
     PSTR Name,
     CHAR RecordType,
-    struct sockaddr *NameServer,
-    socklen_t NameServerSize,
+    struct sockaddr *NameServers,
+    ULONG NameServerCount,
     PLIST_ENTRY ListHead
     )
 
@@ -1647,10 +1864,11 @@ Routine Description:
     RecordType - Supplies the type of record to query for. See
         DNS_RECORD_TYPE_* definitions.
 
-    NameServer - Supplies a pointer to the address to connect to for DNS name
-        resolutions.
+    NameServers - Supplies an array of name server addresses to send the
+        query to. The first to answer is used.
 
-    NameServerSize - Supplies the size of the name server address in bytes.
+    NameServerCount - Supplies the number of elements in the name server
+        array. This must be at least one and at most DNS_MAX_PARALLEL_SERVERS.
 
     ListHead - Supplies a pointer to the initialized list head where DNS
         results will be returned.
@@ -1685,8 +1903,8 @@ Return Value:
         goto PerformDnsQueryEnd;
     }
 
-    Status = ClpExecuteDnsQuery(NameServer,
-                                NameServerSize,
+    Status = ClpExecuteDnsQuery(NameServers,
+                                NameServerCount,
                                 Request,
                                 RequestSize,
                                 &Response,
@@ -1696,18 +1914,6 @@ Return Value:
         goto PerformDnsQueryEnd;
     }
 
-    if (Response->Identifier != Request->Identifier) {
-        if (ClDebugDns != FALSE) {
-            fprintf(stderr,
-                    "DNS: Error: Identifier mismatch %x, %x.\n",
-                    Request->Identifier,
-                    Response->Identifier);
-
-            Status = EAI_FAIL;
-            goto PerformDnsQueryEnd;
-        }
-    }
-
     //
     // Save the current end of the list, and parse the response packet into
     // more entries that get stuck on the end of the list.
@@ -1916,8 +2122,8 @@ Return Value:
 
 INT
 ClpExecuteDnsQuery (
-    struct sockaddr *NameServer,
-    socklen_t NameServerSize,
+    struct sockaddr *NameServers,
+    ULONG NameServerCount,
     PDNS_HEADER Request,
     ULONG RequestSize,
     PDNS_HEADER *Response,
@@ -1928,14 +2134,16 @@ ClpExecuteDnsQuery (
 
 Routine Description:
 
-    This routine sends a DNS query and returns the response.
+    This routine sends a DNS query to one or more name servers at once and
+    returns the first response that matches the query.
 
 Arguments:
 
-    NameServer - Supplies a pointer to the address to connect to for DNS name
-        resolutions.
+    NameServers - Supplies an array of name server addresses to send the
+        query to.
 
-    NameServerSize - Supplies the size of the name server parameter.
+    NameServerCount - Supplies the number of elements in the name server
+        array. This must be at least one and at most DNS_MAX_PARALLEL_SERVERS.
 
     Request - Supplies a pointer to the DNS request.
 
@@ -1959,27 +2167,200 @@ Return Value:
 {
 
     ssize_t ByteCount;
+    struct timespec CurrentTime;
     PDNS_HEADER DnsResponse;
+    LONGLONG Elapsed;
     INT Error;
-    struct sockaddr_in Ip4Address;
-    struct sockaddr_in6 Ip6Address;
-    struct pollfd Poll;
+    ULONG OpenCount;
+    ULONG PollCount;
+    ULONG PollIndex;
+    struct pollfd Polls[DNS_MAX_PARALLEL_SERVERS];
     INT Result;
+    ULONG ServerIndex;
     INT Socket;
+    struct timespec StartTime;
+    INT Timeout;
 
-    Socket = -1;
+    assert((NameServerCount != 0) &&
+           (NameServerCount <= DNS_MAX_PARALLEL_SERVERS));
+
+    PollCount = 0;
     DnsResponse = malloc(DNS_RESPONSE_ALLOCATION_SIZE);
     if (DnsResponse == NULL) {
         Error = EAI_MEMORY;
         goto ExecuteDnsQueryEnd;
     }
 
-    Socket = socket(NameServer->sa_family, SOCK_DGRAM, IPPROTO_UDP);
-    if (Socket == -1) {
+    //
+    // Fire the query off to every server. It's only a failure if it couldn't
+    // be sent anywhere.
+    //
+
+    for (ServerIndex = 0; ServerIndex < NameServerCount; ServerIndex += 1) {
+        Socket = ClpSendDnsQuery(&(NameServers[ServerIndex]),
+                                 Request,
+                                 RequestSize);
+
+        if (Socket != -1) {
+            Polls[PollCount].fd = Socket;
+            Polls[PollCount].events = POLLIN;
+            Polls[PollCount].revents = 0;
+            PollCount += 1;
+        }
+    }
+
+    if (PollCount == 0) {
         Error = EAI_SYSTEM;
         goto ExecuteDnsQueryEnd;
     }
 
+    //
+    // Wait for the first real response. Anything that isn't a response to
+    // this query (a stale answer or a spoofing attempt) is dropped without
+    // restarting the clock.
+    //
+
+    clock_gettime(CLOCK_MONOTONIC, &StartTime);
+    Timeout = DNS_RESPONSE_TIMEOUT;
+    while (TRUE) {
+        do {
+            Result = poll(Polls, PollCount, Timeout);
+
+        } while ((Result < 0) && (errno == EINTR));
+
+        if (Result <= 0) {
+            Error = EAI_AGAIN;
+            goto ExecuteDnsQueryEnd;
+        }
+
+        OpenCount = 0;
+        for (PollIndex = 0; PollIndex < PollCount; PollIndex += 1) {
+            if (Polls[PollIndex].fd < 0) {
+                continue;
+            }
+
+            if (Polls[PollIndex].revents != 0) {
+                do {
+                    ByteCount = recv(Polls[PollIndex].fd,
+                                     DnsResponse,
+                                     DNS_RESPONSE_ALLOCATION_SIZE,
+                                     0);
+
+                } while ((ByteCount < 0) && (errno == EINTR));
+
+                if ((ByteCount >= (ssize_t)sizeof(DNS_HEADER)) &&
+                    (DnsResponse->Identifier == Request->Identifier) &&
+                    ((DnsResponse->Flags & DNS_HEADER_FLAG_RESPONSE) != 0)) {
+
+                    *ResponseSize = ByteCount;
+                    Error = 0;
+                    goto ExecuteDnsQueryEnd;
+                }
+
+                //
+                // Stop listening to a server whose socket has failed.
+                //
+
+                if ((ByteCount < 0) ||
+                    ((Polls[PollIndex].revents & POLLIN) == 0)) {
+
+                    close(Polls[PollIndex].fd);
+                    Polls[PollIndex].fd = -1;
+                    continue;
+                }
+
+                if (ClDebugDns != FALSE) {
+                    fprintf(stderr,
+                            "DNS: Dropping unexpected response %x to %x.\n",
+                            DnsResponse->Identifier,
+                            Request->Identifier);
+                }
+            }
+
+            Polls[PollIndex].revents = 0;
+            OpenCount += 1;
+        }
+
+        if (OpenCount == 0) {
+            Error = EAI_AGAIN;
+            goto ExecuteDnsQueryEnd;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &CurrentTime);
+        Elapsed = ((LONGLONG)(CurrentTime.tv_sec - StartTime.tv_sec) * 1000) +
+                  ((CurrentTime.tv_nsec - StartTime.tv_nsec) / 1000000);
+
+        if (Elapsed >= DNS_RESPONSE_TIMEOUT) {
+            Error = EAI_AGAIN;
+            goto ExecuteDnsQueryEnd;
+        }
+
+        Timeout = DNS_RESPONSE_TIMEOUT - Elapsed;
+    }
+
+ExecuteDnsQueryEnd:
+    if (Error != 0) {
+        if (DnsResponse != NULL) {
+            free(DnsResponse);
+            DnsResponse = NULL;
+        }
+    }
+
+    for (PollIndex = 0; PollIndex < PollCount; PollIndex += 1) {
+        if (Polls[PollIndex].fd >= 0) {
+            close(Polls[PollIndex].fd);
+        }
+    }
+
+    *Response = DnsResponse;
+    return Error;
+}
+
+INT
+ClpSendDnsQuery (
+    struct sockaddr *NameServer,
+    PDNS_HEADER Request,
+    ULONG RequestSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a socket and sends a DNS query to a name server on
+    it.
+
+Arguments:
+
+    NameServer - Supplies a pointer to the address of the name server.
+
+    Request - Supplies a pointer to the DNS request.
+
+    RequestSize - Supplies the size of the query in bytes.
+
+Return Value:
+
+    Returns the socket the query was sent on, which the response will arrive
+    on. The caller is responsible for closing it.
+
+    -1 on failure.
+
+--*/
+
+{
+
+    ssize_t ByteCount;
+    struct sockaddr_in Ip4Address;
+    struct sockaddr_in6 Ip6Address;
+    socklen_t NameServerSize;
+    INT Result;
+    INT Socket;
+
+    Socket = socket(NameServer->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (Socket == -1) {
+        goto SendDnsQueryEnd;
+    }
+
     //
     // Create a local address with the same family as the name server
     // destination and bind to it.
@@ -1993,11 +2374,7 @@ Return Value:
                       (struct sockaddr *)&Ip4Address,
                       sizeof(Ip4Address));
 
-        if (Result != 0) {
-            Error = EAI_SYSTEM;
-            goto ExecuteDnsQueryEnd;
-        }
-
+        NameServerSize = sizeof(struct sockaddr_in);
         break;
 
     case AF_INET6:
@@ -2007,19 +2384,19 @@ Return Value:
                       (struct sockaddr *)&Ip6Address,
                       sizeof(Ip6Address));
 
-        if (Result != 0) {
-            Error = EAI_SYSTEM;
-            goto ExecuteDnsQueryEnd;
-        }
-
+        NameServerSize = sizeof(struct sockaddr_in6);
         break;
 
     default:
 
         assert(FALSE);
 
-        Error = EAI_FAMILY;
-        goto ExecuteDnsQueryEnd;
+        Result = -1;
+        break;
+    }
+
+    if (Result != 0) {
+        goto SendDnsQueryEnd;
     }
 
     ByteCount = sendto(Socket,
@@ -2030,54 +2407,17 @@ Return Value:
                        NameServerSize);
 
     if (ByteCount != RequestSize) {
-        Error = EAI_SYSTEM;
-        goto ExecuteDnsQueryEnd;
-    }
-
-    //
-    // Wait for a response.
-    //
-
-    Poll.fd = Socket;
-    Poll.events = POLLIN;
-    Poll.revents = 0;
-    do {
-        Result = poll(&Poll, 1, DNS_RESPONSE_TIMEOUT);
-
-    } while ((Result < 0) && (errno == EINTR));
-
-    if (Result <= 0) {
-        Error = EAI_AGAIN;
-        goto ExecuteDnsQueryEnd;
-    }
-
-    do {
-        ByteCount = recv(Socket, DnsResponse, DNS_RESPONSE_ALLOCATION_SIZE, 0);
-
-    } while ((ByteCount == 0) && (errno == EINTR));
-
-    if (ByteCount == 0) {
-        Error = EAI_SYSTEM;
-        goto ExecuteDnsQueryEnd;
+        goto SendDnsQueryEnd;
     }
 
-    *ResponseSize = ByteCount;
-    Error = 0;
-
-ExecuteDnsQueryEnd:
-    if (Error != 0) {
-        if (DnsResponse != NULL) {
-            free(DnsResponse);
-            DnsResponse = NULL;
-        }
-    }
+    return Socket;
 
+SendDnsQueryEnd:
     if (Socket != -1) {
         close(Socket);
     }
 
-    *Response = DnsResponse;
-    return Error;
+    return -1;
 }
 
 INT
@@ -2340,7 +2680,7 @@ Return Value:
     Buffer += 4;
     DataLength = ((USHORT)*Buffer << BITS_PER_BYTE) | *(Buffer + 1);
     Buffer += 2;
-    if ((UINTN)Buffer + DataLength <= ResponseSize) {
+    if ((UINTN)Buffer + DataLength - (UINTN)Response > ResponseSize) {
         Status = EAI_OVERFLOW;
         goto ParseDnsResponseElementEnd;
     }
@@ -2983,7 +3323,7 @@ Return Value:
         assert((NameServer->Type == DNS_RECORD_TYPE_A) ||
                (NameServer->Type == DNS_RECORD_TYPE_AAAA));
 
-        memcpy(&NameServerAddress,
+        memcpy(NameServerAddress,
                &(NameServer->Address),
                sizeof(struct sockaddr));
 
@@ -3759,7 +4099,9 @@ ClpGetDnsServers (
 
 Routine Description:
 
-    This routine gets the known DNS server addresses from the system.
+    This routine gets the known DNS server addresses from the system. If the
+    DNSCACHEIP environment variable is set to an address, that server is used
+    alone instead.
 
 Arguments:
 
@@ -3785,16 +4127,44 @@ Return Value:
     BOOL AddedOne;
     socklen_t AddressLength;
     PDNS_RESULT Alternate;
+    PSTR CacheIpAddress;
     ULONG DeviceCount;
     ULONG DeviceIndex;
     DEVICE_INFORMATION_RESULT *Devices;
     NETWORK_DEVICE_INFORMATION Information;
+    struct sockaddr_in *Ip4Address;
+    struct sockaddr_in6 *Ip6Address;
     PVOID NewBuffer;
     INT Result;
     ULONG ServerIndex;
     UINTN Size;
     KSTATUS Status;
 
+    //
+    // A server named in the environment overrides the configuration, just
+    // as it does for the resolver.
+    //
+
+    CacheIpAddress = getenv(DNS_DNSCACHEIP_VARIABLE);
+    if ((CacheIpAddress != NULL) && (PrimaryServer != NULL)) {
+        memset(PrimaryServer, 0, sizeof(struct sockaddr));
+        Ip4Address = (struct sockaddr_in *)PrimaryServer;
+        if (inet_pton(AF_INET, CacheIpAddress, &(Ip4Address->sin_addr)) == 1) {
+            Ip4Address->sin_family = AF_INET;
+            Ip4Address->sin_port = htons(DNS_PORT_NUMBER);
+            return 0;
+        }
+
+        Ip6Address = (struct sockaddr_in6 *)PrimaryServer;
+        if (inet_pton(AF_INET6, CacheIpAddress, &(Ip6Address->sin6_addr)) ==
+            1) {
+
+            Ip6Address->sin6_family = AF_INET6;
+            Ip6Address->sin6_port = htons(DNS_PORT_NUMBER);
+            return 0;
+        }
+    }
+
     //
     // Get the array of devices that return network device information.
     //
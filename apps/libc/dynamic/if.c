@@ -55,7 +55,7 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
-#define CL_NETWORK_NAME_FORMAT_COUNT 3
+#define CL_NETWORK_NAME_FORMAT_COUNT 4
 #define CL_NETWORK_NAME_LINK_LAYER_INDEX 0
 #define CL_NETWORK_NAME_DOMAIN_OFFSET 1
 
@@ -119,7 +119,8 @@ ClpDestroyNetworkInterfaceAddress (
 PCSTR ClNetworkNameFormats[CL_NETWORK_NAME_FORMAT_COUNT] = {
     "il%d",
     "eth%d",
-    "wlan%d"
+    "wlan%d",
+    "lo%d"
 };
 
 //
@@ -936,6 +937,10 @@ Return Value:
         NewInterface->ifa_flags |= IFF_RUNNING;
     }
 
+    if (Domain == NetDomainLoopback) {
+        NewInterface->ifa_flags |= IFF_LOOPBACK | IFF_NOARP;
+    }
+
     if (Information.Address.Domain != NetDomainInvalid) {
         NewInterface->ifa_addr = malloc(sizeof(struct sockaddr));
         if (NewInterface->ifa_addr == NULL) {
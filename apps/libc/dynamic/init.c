@@ -82,6 +82,7 @@ Return Value:
     ClpInitializeFileIo();
     ClpInitializeSignals();
     ClpInitializeTypeConversions();
+    ClpInitializeStringRoutines();
     return;
 }
 
@@ -116,6 +116,15 @@ Module Name:
 
 #define SIGNAL_SETID 33
 
+//
+// Define the maximum number of addresses a DNS cache entry can hold, and the
+// size of the name buffers within an entry. Answers that don't fit are simply
+// not cached.
+//
+
+#define DNS_CACHE_MAX_ADDRESSES 8
+#define DNS_CACHE_NAME_SIZE 128
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -160,6 +169,10 @@ Structure Description:
 
     ShiftState - Stores the current multi-byte shift state.
 
+    ElidedLockCount - Stores the number of times the stream was locked while
+        the process had only one thread, in which case the lock itself was
+        skipped.
+
 --*/
 
 typedef struct _FILE {
@@ -176,6 +189,7 @@ typedef struct _FILE {
     WCHAR UngetCharacter;
     pid_t Pid;
     mbstate_t ShiftState;
+    ULONG ElidedLockCount;
 } *PFILE;
 
 /*++
@@ -207,6 +221,37 @@ typedef struct _CL_TYPE_CONVERSION_INTERFACE {
 
 } CL_TYPE_CONVERSION_INTERFACE, *PCL_TYPE_CONVERSION_INTERFACE;
 
+/*++
+
+Structure Description:
+
+    This structure stores an answer saved in or retrieved from the DNS cache.
+
+Members:
+
+    Status - Stores the EAI_* status of the translation. This is zero for
+        positive answers and for names that exist but have no records of the
+        requested type.
+
+    TimeToLive - Stores the number of seconds the answer remains valid.
+
+    AddressCount - Stores the number of valid elements in the addresses array.
+
+    CanonicalName - Stores the canonical name of the translated host.
+
+    Addresses - Stores the raw addresses in network byte order. Only the first
+        four bytes of each element are used for A records.
+
+--*/
+
+typedef struct _DNS_CACHE_ANSWER {
+    INT Status;
+    ULONG TimeToLive;
+    ULONG AddressCount;
+    CHAR CanonicalName[DNS_CACHE_NAME_SIZE];
+    UCHAR Addresses[DNS_CACHE_MAX_ADDRESSES][16];
+} DNS_CACHE_ANSWER, *PDNS_CACHE_ANSWER;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -403,6 +448,66 @@ Return Value:
 
 --*/
 
+VOID
+ClpEnableStreamLocking (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called before the process creates its first additional
+    thread. It turns off stream lock elision, and converts any elided stream
+    locks held by the current thread into real ones.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+INT
+ClpFillStreamReadBuffer (
+    FILE *Stream,
+    PCHAR *Data,
+    size_t *Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the data buffered in a readable byte stream,
+    refilling the buffer from the file if it is empty. The caller consumes
+    data by advancing the buffer's next index. The stream lock must be held.
+
+Arguments:
+
+    Stream - Supplies a pointer to the stream.
+
+    Data - Supplies a pointer where a pointer to the buffered data will be
+        returned.
+
+    Size - Supplies a pointer where the number of buffered bytes will be
+        returned.
+
+Return Value:
+
+    1 if buffered data was returned.
+
+    0 if the end of the file was reached or a read error occurred. The end of
+    file or error indicator for the stream is set.
+
+    -1 if the stream cannot be read through its buffer right now, in which
+    case the caller should fall back to fgetc_unlocked.
+
+--*/
+
 VOID
 ClpInitializeTimeZoneSupport (
     VOID
@@ -424,6 +529,28 @@ Return Value:
 
 --*/
 
+VOID
+ClpInitializeStringRoutines (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine selects the fastest memory and string routines the current
+    processor supports.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
 time_t
 ClpConvertSystemTimeToUnixTime (
     PSYSTEM_TIME SystemTime
@@ -899,3 +1026,137 @@ Return Value:
     -1 on error, and the errno variable will contain more information.
 
 --*/
+
+VOID
+ClpMergeSortRange (
+    PUCHAR Array,
+    PUCHAR Scratch,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+/*++
+
+Routine Description:
+
+    This routine stably sorts a range of elements in place.
+
+Arguments:
+
+    Array - Supplies a pointer to the first element of the range.
+
+    Scratch - Supplies a pointer to scratch space with room for at least half
+        the element count plus one elements.
+
+    ElementCount - Supplies the number of elements in the range.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ClpMergeSortedRuns (
+    PUCHAR Array,
+    PUCHAR Scratch,
+    size_t LeftCount,
+    size_t RightCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+/*++
+
+Routine Description:
+
+    This routine merges two adjacent sorted runs into one sorted run in
+    place. Elements from the left run win ties, which keeps the sort stable.
+
+Arguments:
+
+    Array - Supplies a pointer to the first element of the left run. The
+        right run immediately follows it.
+
+    Scratch - Supplies a pointer to scratch space with room for at least the
+        left run's elements.
+
+    LeftCount - Supplies the number of elements in the left run.
+
+    RightCount - Supplies the number of elements in the right run.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+ClpDnsCacheLookup (
+    PCSTR Name,
+    USHORT RecordType,
+    PDNS_CACHE_ANSWER Answer
+    );
+
+/*++
+
+Routine Description:
+
+    This routine looks for an unexpired answer in the DNS cache.
+
+Arguments:
+
+    Name - Supplies the name being translated.
+
+    RecordType - Supplies the DNS record type being requested.
+
+    Answer - Supplies a pointer where the cached answer will be returned on
+        success. The time to live is set to the number of seconds remaining.
+
+Return Value:
+
+    TRUE if a cached answer was found.
+
+    FALSE if the name must be translated.
+
+--*/
+
+VOID
+ClpDnsCacheInsert (
+    PCSTR Name,
+    USHORT RecordType,
+    PDNS_CACHE_ANSWER Answer
+    );
+
+/*++
+
+Routine Description:
+
+    This routine saves an answer in the DNS cache, replacing any previous
+    answer for the same name and record type.
+
+Arguments:
+
+    Name - Supplies the name that was translated.
+
+    RecordType - Supplies the DNS record type that was requested.
+
+    Answer - Supplies a pointer to the answer to save. Positive answers are
+        kept for their time to live, capped at a maximum. Negative answers
+        (those with no addresses) are kept for a short fixed time.
+
+Return Value:
+
+    None.
+
+--*/
+
@@ -35,6 +35,7 @@ Module Name:
 #include <paths.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -412,10 +413,17 @@ Return Value:
 
 {
 
+    unsigned char Byte;
     int Character;
+    size_t CopySize;
+    PCHAR Data;
+    size_t DataSize;
+    PCHAR End;
     size_t LineSize;
     char *NewBuffer;
     size_t NewSize;
+    ssize_t Result;
+    INT Status;
 
     LineSize = 0;
     if ((LinePointer == NULL) || (Size == NULL)) {
@@ -443,37 +451,74 @@ Return Value:
         *Size = GETLINE_INITIAL_BUFFER_SIZE;
     }
 
+    //
+    // Hold the stream lock across the whole line, and scan the stream buffer
+    // directly for the delimiter when possible.
+    //
+
+    Result = -1;
+    ClpLockStream(Stream);
+    ORIENT_STREAM(Stream, FILE_FLAG_BYTE_ORIENTED);
     while (TRUE) {
-        Character = fgetc(Stream);
-        if (Character == EOF) {
+        Status = ClpFillStreamReadBuffer(Stream, &Data, &DataSize);
+
+        //
+        // If the stream can't be scanned in place, fall back to reading a
+        // single character.
+        //
+
+        if (Status < 0) {
+            Character = fgetc_unlocked(Stream);
+            if (Character != EOF) {
+                Byte = Character;
+                Data = (PCHAR)&Byte;
+                DataSize = 1;
+                Status = 1;
+
+            } else {
+                Status = 0;
+            }
+        }
+
+        if (Status == 0) {
             if (LineSize != 0) {
                 break;
             }
 
-            return -1;
+            goto getdelimEnd;
+        }
+
+        End = memchr(Data, (unsigned char)Delimiter, DataSize);
+        CopySize = DataSize;
+        if (End != NULL) {
+            CopySize = End - Data + 1;
         }
 
-        if (LineSize + 2 > *Size) {
+        if (LineSize + CopySize + 1 > *Size) {
 
             assert(*Size != 0);
 
             NewSize = *Size;
-            while (NewSize < LineSize + 2) {
+            while (NewSize < LineSize + CopySize + 1) {
                 NewSize *= 2;
             }
 
             NewBuffer = realloc(*LinePointer, NewSize);
             if (NewBuffer == NULL) {
-                return -1;
+                goto getdelimEnd;
             }
 
             *LinePointer = NewBuffer;
             *Size = NewSize;
         }
 
-        (*LinePointer)[LineSize] = Character;
-        LineSize += 1;
-        if (Character == Delimiter) {
+        memcpy(*LinePointer + LineSize, Data, CopySize);
+        if (Data != (PCHAR)&Byte) {
+            Stream->BufferNextIndex += CopySize;
+        }
+
+        LineSize += CopySize;
+        if (End != NULL) {
             break;
         }
     }
@@ -481,7 +526,11 @@ Return Value:
     assert(*Size > LineSize);
 
     (*LinePointer)[LineSize] = '\0';
-    return LineSize;
+    Result = LineSize;
+
+getdelimEnd:
+    ClpUnlockStream(Stream);
+    return Result;
 }
 
 //
@@ -93,6 +93,17 @@ Return Value:
     FLOAT_PARTS Parts;
     LONG Word;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_FLOAT(Value, Value, MATH_ROUND_UP);
+    return Value;
+
+#endif
+
     Parts.Float= Value;
     Word = Parts.Ulong;
     Exponent = ((Word & FLOAT_EXPONENT_MASK) >> FLOAT_EXPONENT_SHIFT) -
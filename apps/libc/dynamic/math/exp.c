@@ -15,6 +15,9 @@ Module Name:
 
     This module implements the exponential function.
 
+    The exponential is computed from a table of 2^(j/128) and a short
+    polynomial, which avoids the division in the rational approximation.
+
     Copyright (C) 2004 by Sun Microsystems, Inc. All rights reserved.
 
     Permission to use, copy, modify, and distribute this
@@ -43,9 +46,7 @@ Module Name:
 //
 
 #define EXP_UPPER_THRESHOLD_HIGH_WORD 0x40862E42
-#define EXP_HALF_LN_2_HIGH_WORD 0x3FD62E42
-#define EXP_3_HALVES_LN_2_HIGH_WORD 0x3FF0A2B2
-#define EXP_LOWER_THRESHOLD_HIGH_WORD 0x3E300000
+#define EXP_LOWER_THRESHOLD_HIGH_WORD 0x3C900000
 #define EXP_2_TO_1023 0x1p1023
 
 //
@@ -63,11 +64,162 @@ Module Name:
 const double ClExpOverflowThreshold = 7.09782712893383973096e+02;
 const double ClExpUnderflowThreshold = -7.45133219101941108420e+02;
 
-const double ClExp1 = 1.66666666666666019037e-01;
-const double ClExp2 = -2.77777777770155933842e-03;
-const double ClExp3 = 6.61375632143793436117e-05;
-const double ClExp4 = -1.65339022054652515390e-06;
-const double ClExp5 = 4.13813679705723846039e-08;
+//
+// Define N / ln2, and ln2 / N split into a high part whose multiples by k are
+// exact and a low part.
+//
+
+const double ClExpTableInverseLn2 = 0x1.71547652B82FEp7;
+const double ClExpTableLn2High = 0x1.62E42FEE00000p-8;
+const double ClExpTableLn2Low = 0x1.A39EF35793C76p-40;
+
+//
+// Define the Taylor coefficients of e^r - 1 - r, starting with r^2. They are
+// enough for 2^-60 relative accuracy on the reduced range.
+//
+
+const double ClExpTableCoefficients[4] = {
+    0x1.0000000000000p-1,
+    0x1.5555555555555p-3,
+    0x1.5555555555555p-5,
+    0x1.1111111111111p-7
+};
+
+//
+// Define the table of 2^(j/N), each as a high part and the low part that
+// remains.
+//
+
+const double ClExpTable[EXP_TABLE_SIZE * 2] = {
+    0x1.0000000000000p+0, 0.0,
+    0x1.0163DA9FB3335p+0, 0x1.B61299AB8CDB7p-54,
+    0x1.02C9A3E778061p+0, -0x1.19083535B085Dp-56,
+    0x1.04315E86E7F85p+0, -0x1.0A31C1977C96Ep-54,
+    0x1.059B0D3158574p+0, 0x1.D73E2A475B465p-55,
+    0x1.0706B29DDF6DEp+0, -0x1.C91DFE2B13C27p-55,
+    0x1.0874518759BC8p+0, 0x1.186BE4BB284FFp-57,
+    0x1.09E3ECAC6F383p+0, 0x1.1487818316136p-54,
+    0x1.0B5586CF9890Fp+0, 0x1.8A62E4ADC610Bp-54,
+    0x1.0CC922B7247F7p+0, 0x1.01EDC16E24F71p-54,
+    0x1.0E3EC32D3D1A2p+0, 0x1.03A1727C57B53p-59,
+    0x1.0FB66AFFED31Bp+0, -0x1.B9BEDC44EBD7Bp-57,
+    0x1.11301D0125B51p+0, -0x1.6C51039449B3Ap-54,
+    0x1.12ABDC06C31CCp+0, -0x1.1B514B36CA5C7p-58,
+    0x1.1429AAEA92DE0p+0, -0x1.32FBF9AF1369Ep-54,
+    0x1.15A98C8A58E51p+0, 0x1.2406AB9EEAB0Ap-55,
+    0x1.172B83C7D517Bp+0, -0x1.19041B9D78A76p-55,
+    0x1.18AF9388C8DEAp+0, -0x1.11023D1970F6Cp-54,
+    0x1.1A35BEB6FCB75p+0, 0x1.E5B4C7B4968E4p-55,
+    0x1.1BBE084045CD4p+0, -0x1.95386352EF607p-54,
+    0x1.1D4873168B9AAp+0, 0x1.E016E00A2643Cp-54,
+    0x1.1ED5022FCD91Dp+0, -0x1.1DF98027BB78Cp-54,
+    0x1.2063B88628CD6p+0, 0x1.DC775814A8495p-55,
+    0x1.21F49917DDC96p+0, 0x1.2A97E9494A5EEp-55,
+    0x1.2387A6E756238p+0, 0x1.9B07EB6C70573p-54,
+    0x1.251CE4FB2A63Fp+0, 0x1.AC155BEF4F4A4p-55,
+    0x1.26B4565E27CDDp+0, 0x1.2BD339940E9D9p-55,
+    0x1.284DFE1F56381p+0, -0x1.A4C3A8C3F0D7Ep-54,
+    0x1.29E9DF51FDEE1p+0, 0x1.612E8AFAD1255p-55,
+    0x1.2B87FD0DAD990p+0, -0x1.10ADCD6381AA4p-59,
+    0x1.2D285A6E4030Bp+0, 0x1.0024754DB41D5p-54,
+    0x1.2ECAFA93E2F56p+0, 0x1.1CA0F45D52383p-56,
+    0x1.306FE0A31B715p+0, 0x1.6F46AD23182E4p-55,
+    0x1.32170FC4CD831p+0, 0x1.A9CE78E18047Cp-55,
+    0x1.33C08B26416FFp+0, 0x1.32721843659A6p-54,
+    0x1.356C55F929FF1p+0, -0x1.B5CEE5C4E4628p-55,
+    0x1.371A7373AA9CBp+0, -0x1.63AEABF42EAE2p-54,
+    0x1.38CAE6D05D866p+0, -0x1.E958D3C9904BDp-54,
+    0x1.3A7DB34E59FF7p+0, -0x1.5E436D661F5E3p-56,
+    0x1.3C32DC313A8E5p+0, -0x1.EFFF8375D29C3p-54,
+    0x1.3DEA64C123422p+0, 0x1.ADA0911F09EBCp-55,
+    0x1.3FA4504AC801Cp+0, -0x1.7D023F956F9F3p-54,
+    0x1.4160A21F72E2Ap+0, -0x1.EF3691C309278p-58,
+    0x1.431F5D950A897p+0, -0x1.1C7DDE35F7999p-55,
+    0x1.44E086061892Dp+0, 0x1.89B7A04EF80D0p-59,
+    0x1.46A41ED1D0057p+0, 0x1.C944BD1648A76p-54,
+    0x1.486A2B5C13CD0p+0, 0x1.3C1A3B69062F0p-56,
+    0x1.4A32AF0D7D3DEp+0, 0x1.9CB62F3D1BE56p-54,
+    0x1.4BFDAD5362A27p+0, 0x1.D4397AFEC42E2p-56,
+    0x1.4DCB299FDDD0Dp+0, 0x1.8ECDBBC6A7833p-54,
+    0x1.4F9B2769D2CA7p+0, -0x1.4B309D25957E3p-54,
+    0x1.516DAA2CF6642p+0, -0x1.F768569BD93EFp-55,
+    0x1.5342B569D4F82p+0, -0x1.07ABE1DB13CADp-55,
+    0x1.551A4CA5D920Fp+0, -0x1.D689CEFEDE59Bp-55,
+    0x1.56F4736B527DAp+0, 0x1.9BB2C011D93ADp-54,
+    0x1.58D12D497C7FDp+0, 0x1.295E15B9A1DE8p-55,
+    0x1.5AB07DD485429p+0, 0x1.6324C054647ADp-54,
+    0x1.5C9268A5946B7p+0, 0x1.C4B1B816986A2p-60,
+    0x1.5E76F15AD2148p+0, 0x1.BA6F93080E65Ep-54,
+    0x1.605E1B976DC09p+0, -0x1.3E2429B56DE47p-54,
+    0x1.6247EB03A5585p+0, -0x1.383C17E40B497p-54,
+    0x1.6434634CCC320p+0, -0x1.C483C759D8933p-55,
+    0x1.6623882552225p+0, -0x1.BB60987591C34p-54,
+    0x1.68155D44CA973p+0, 0x1.038AE44F73E65p-57,
+    0x1.6A09E667F3BCDp+0, -0x1.BDD3413B26456p-54,
+    0x1.6C012750BDABFp+0, -0x1.2895667FF0B0Dp-56,
+    0x1.6DFB23C651A2Fp+0, -0x1.BBE3A683C88ABp-57,
+    0x1.6FF7DF9519484p+0, -0x1.83C0F25860EF6p-55,
+    0x1.71F75E8EC5F74p+0, -0x1.16E4786887A99p-55,
+    0x1.73F9A48A58174p+0, -0x1.0A8D96C65D53Cp-54,
+    0x1.75FEB564267C9p+0, -0x1.0245957316DD3p-54,
+    0x1.780694FDE5D3Fp+0, 0x1.866B80A02162Dp-54,
+    0x1.7A11473EB0187p+0, -0x1.41577EE04992Fp-55,
+    0x1.7C1ED0130C132p+0, 0x1.F124CD1164DD6p-54,
+    0x1.7E2F336CF4E62p+0, 0x1.05D02BA15797Ep-56,
+    0x1.80427543E1A12p+0, -0x1.27C86626D972Bp-54,
+    0x1.82589994CCE13p+0, -0x1.D4C1DD41532D8p-54,
+    0x1.8471A4623C7ADp+0, -0x1.8D684A341CDFBp-55,
+    0x1.868D99B4492EDp+0, -0x1.FC6F89BD4F6BAp-54,
+    0x1.88AC7D98A6699p+0, 0x1.994C2F37CB53Ap-54,
+    0x1.8ACE5422AA0DBp+0, 0x1.6E9F156864B27p-54,
+    0x1.8CF3216B5448Cp+0, -0x1.0D55E32E9E3AAp-56,
+    0x1.8F1AE99157736p+0, 0x1.5CC13A2E3976Cp-55,
+    0x1.9145B0B91FFC6p+0, -0x1.DD6792E582524p-54,
+    0x1.93737B0CDC5E5p+0, -0x1.75FC781B57EBCp-57,
+    0x1.95A44CBC8520Fp+0, -0x1.64B7C96A5F039p-56,
+    0x1.97D829FDE4E50p+0, -0x1.D185B7C1B85D1p-54,
+    0x1.9A0F170CA07BAp+0, -0x1.173BD91CEE632p-54,
+    0x1.9C49182A3F090p+0, 0x1.C7C46B071F2BEp-56,
+    0x1.9E86319E32323p+0, 0x1.824CA78E64C6Ep-56,
+    0x1.A0C667B5DE565p+0, -0x1.359495D1CD533p-54,
+    0x1.A309BEC4A2D33p+0, 0x1.6305C7DDC36ABp-54,
+    0x1.A5503B23E255Dp+0, -0x1.D2F6EDB8D41E1p-54,
+    0x1.A799E1330B358p+0, 0x1.BCB7ECAC563C7p-54,
+    0x1.A9E6B5579FDBFp+0, 0x1.0FAC90EF7FD31p-54,
+    0x1.AC36BBFD3F37Ap+0, -0x1.F9234CAE76CD0p-55,
+    0x1.AE89F995AD3ADp+0, 0x1.7A1CD345DCC81p-54,
+    0x1.B0E07298DB666p+0, -0x1.BDEF54C80E425p-54,
+    0x1.B33A2B84F15FBp+0, -0x1.2805E3084D708p-57,
+    0x1.B59728DE5593Ap+0, -0x1.C71DFBBBA6DE3p-54,
+    0x1.B7F76F2FB5E47p+0, -0x1.5584F7E54AC3Bp-56,
+    0x1.BA5B030A1064Ap+0, -0x1.EFCD30E54292Ep-54,
+    0x1.BCC1E904BC1D2p+0, 0x1.23DD07A2D9E84p-55,
+    0x1.BF2C25BD71E09p+0, -0x1.EFDCA3F6B9C73p-54,
+    0x1.C199BDD85529Cp+0, 0x1.11065895048DDp-55,
+    0x1.C40AB5FFFD07Ap+0, 0x1.B4537E083C60Ap-54,
+    0x1.C67F12E57D14Bp+0, 0x1.2884DFF483CADp-54,
+    0x1.C8F6D9406E7B5p+0, 0x1.1ACBC48805C44p-56,
+    0x1.CB720DCEF9069p+0, 0x1.503CBD1E949DBp-56,
+    0x1.CDF0B555DC3FAp+0, -0x1.DD83B53829D72p-55,
+    0x1.D072D4A07897Cp+0, -0x1.CBC3743797A9Cp-54,
+    0x1.D2F87080D89F2p+0, -0x1.D487B719D8578p-54,
+    0x1.D5818DCFBA487p+0, 0x1.2ED02D75B3707p-55,
+    0x1.D80E316C98398p+0, -0x1.11EC18BEDDFE8p-54,
+    0x1.DA9E603DB3285p+0, 0x1.C2300696DB532p-54,
+    0x1.DD321F301B460p+0, 0x1.2DA5778F018C3p-54,
+    0x1.DFC97337B9B5Fp+0, -0x1.1A5CD4F184B5Cp-54,
+    0x1.E264614F5A129p+0, -0x1.7B627817A1496p-54,
+    0x1.E502EE78B3FF6p+0, 0x1.39E8980A9CC8Fp-55,
+    0x1.E7A51FBC74C83p+0, 0x1.2D522CA0C8DE2p-54,
+    0x1.EA4AFA2A490DAp+0, -0x1.E9C23179C2893p-54,
+    0x1.ECF482D8E67F1p+0, -0x1.C93F3B411AD8Cp-54,
+    0x1.EFA1BEE615A27p+0, 0x1.DC7F486A4B6B0p-54,
+    0x1.F252B376BBA97p+0, 0x1.3A1A5BF0D8E43p-54,
+    0x1.F50765B6E4540p+0, 0x1.9D3E12DD8A18Bp-54,
+    0x1.F7BFDAD9CBE14p+0, -0x1.DBB12D006350Ap-54,
+    0x1.FA7C1819E90D8p+0, 0x1.74853F3A5931Ep-55,
+    0x1.FD3C22B8F71F1p+0, 0x1.2EB74966579E7p-57
+};
 
 //
 // Define 2^-1000 for underflow.
@@ -179,81 +331,11 @@ Return Value:
 
 {
 
-    double Approximation;
-    double Exponentiation;
-    double High;
     ULONG HighWord;
-    double Input;
-    LONG Ln2Multiple;
-    double Low;
     ULONG LowWord;
     LONG SignBit;
-    double TwoPower;
     DOUBLE_PARTS ValueParts;
-    volatile double VolatileValue;
 
-    //
-    // There are three steps to the method.
-    // 1. Argument reduction
-    //    Reduce x to an r so that |r| <= 0.5*ln2 ~ 0.34658.
-    //    Given x, find r and integer k such that
-    //
-    //    x = k * ln2 + r,  |r| <= 0.5 * ln2.
-    //    Here r will be represented as r = hi-lo for better accuracy.
-    //
-    // 2. Approximation of exp(r) by a special rational function on
-    //    the interval [0, 0.34658]:
-    //    Write
-    //        R(r^22) = r * (exp(r) + 1) / (exp(r) - 1)
-    //                = 2 + r*r / 6 - r^4 / 360 + ...
-    //    Use a special Remes algorithm on [0,0.34658] to generate
-    //    a polynomial of degree 5 to approximate R. The maximum error
-    //    of this polynomial approximation is bounded by 2**-59. In
-    //    other words,
-    //        R(z) ~ 2.0 + P1*z + P2*z^2 + P3*z^3 + P4*z^4 + P5*z^5
-    //    (where z = r * r, and the values of P1 to P5 are listed below)
-    //    and
-    //
-    //    |                        5          |     -59
-    //    | 2.0 + P1*z + ... + P5*z  -  R(z)  | <= 2
-    //    |                                   |
-    //
-    //    The computation of exp(r) thus becomes
-    //                   2*r
-    //    exp(r) = 1 + -------
-    //                  R - r
-    //
-    //                      r * R1(r)
-    //           = 1 + r + ----------- (for better accuracy)
-    //                      2 - R1(r)
-    //    where
-    //                     2       4             10
-    //    R1(r) = r - (P1*r  + P2*r  + ... + P5*r  ).
-    //
-    // 3. Scale back to obtain exp(x):
-    //    From step 1:
-    //    exp(x) = 2^k * exp(r)
-    //
-    // Special cases:
-    //    exp(INF) is INF, exp(NaN) is NaN;
-    //    exp(-INF) is 0, and
-    //    for finite argument, only exp(0)=1 is exact.
-    //
-    // Accuracy:
-    //    according to an error analysis, the error is always less than
-    //    1 ulp (unit in the last place).
-    //
-    // Miscellaneous:
-    //    For an IEEE double:
-    //    If the value is greater than 7.09782712893383973096e+02 then exp(x)
-    //    will overflow.
-    //    If the value is less than  -7.45133219101941108420e+02 then exp(x)
-    //    will underflow.
-    //
-
-    High = 0.0;
-    Low = 0.0;
-    Ln2Multiple = 0;
     ValueParts.Double = Value;
     HighWord = ValueParts.Ulong.High;
     SignBit = HighWord >> (DOUBLE_SIGN_BIT_SHIFT - DOUBLE_HIGH_WORD_SHIFT);
@@ -303,103 +385,193 @@ Return Value:
         if (Value < ClExpUnderflowThreshold) {
             return ClTwoNegative1000 * ClTwoNegative1000;
         }
-    }
 
     //
-    // Perform argument reduction.
+    // Handle very small values.
     //
 
-    if (HighWord > EXP_HALF_LN_2_HIGH_WORD) {
-        if (HighWord < EXP_3_HALVES_LN_2_HIGH_WORD) {
-            High = Value - ClDoubleLn2High[SignBit];
-            Low = ClDoubleLn2Low[SignBit];
-            Ln2Multiple = 1 - SignBit - SignBit;
-
-        } else {
-            if (SignBit != 0) {
-                Ln2Multiple = (INT)(ClInverseLn2 * Value - ClDoubleOneHalf);
-
-            } else {
-                Ln2Multiple = (INT)(ClInverseLn2 * Value + ClDoubleOneHalf);
-            }
-
-            Input = Ln2Multiple;
+    } else if (HighWord < EXP_LOWER_THRESHOLD_HIGH_WORD)  {
+        if (ClDoubleHugeValue + Value > ClDoubleOne) {
 
             //
-            // Input * Ln2High is exact here.
+            // Trigger an inexact condition.
             //
 
-            High = Value - Input * ClDoubleLn2High[0];
-            Low = Input * ClDoubleLn2Low[0];
+            return ClDoubleOne + Value;
         }
+    }
+
+    return ClpExpKernel(Value);
+}
 
-        VolatileValue = High - Low;
-        Value = VolatileValue;
+LIBC_API
+void
+vexp (
+    double *Results,
+    const double *Values,
+    size_t Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the base e exponential of each value in an array.
+    The results are identical to calling exp on each element.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to raise e to.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG HighWord;
+    size_t Index;
+    DOUBLE_PARTS ValueParts;
 
     //
-    // Handle very small values.
+    // Send every value in the common range straight to the table kernel, so
+    // that the loop body is free of calls and special cases.
     //
 
-    } else if (HighWord < EXP_LOWER_THRESHOLD_HIGH_WORD)  {
-        if (ClDoubleHugeValue + Value > ClDoubleOne) {
+    for (Index = 0; Index < Count; Index += 1) {
+        ValueParts.Double = Values[Index];
+        HighWord = ValueParts.Ulong.High &
+                   (~DOUBLE_SIGN_BIT >> DOUBLE_HIGH_WORD_SHIFT);
 
-            //
-            // Trigger an inexact condition.
-            //
+        if ((HighWord - EXP_LOWER_THRESHOLD_HIGH_WORD) <
+            (EXP_UPPER_THRESHOLD_HIGH_WORD - EXP_LOWER_THRESHOLD_HIGH_WORD)) {
 
-            return ClDoubleOne + Value;
-        }
+            Results[Index] = ClpExpKernel(ValueParts.Double);
 
-    } else {
-        Ln2Multiple = 0;
+        } else {
+            Results[Index] = exp(ValueParts.Double);
+        }
     }
 
+    return;
+}
+
+double
+ClpExpKernel (
+    double Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the base e exponential of a finite value whose
+    magnitude is between 2^-54 and the underflow threshold.
+
+Arguments:
+
+    Value - Supplies the value to raise e to.
+
+Return Value:
+
+    Returns e to the given value.
+
+--*/
+
+{
+
+    LONG Exponent;
+    double Exponentiation;
+    LONG Index;
+    LONG Multiple;
+    double MultipleDouble;
+    double Polynomial;
+    double Reduced;
+    double ReducedSquared;
+    double TableHigh;
+    double TableLow;
+    DOUBLE_PARTS TwoPower;
+
+    //
+    // There are three steps to the method.
+    // 1. Argument reduction
+    //    Find the integer k nearest to x * N / ln2, and r such that
+    //        x = k * ln2 / N + r,  |r| <= ln2 / (2 * N).
+    //    The high part of ln2 / N has enough trailing zeros that
+    //    k * ln2_hi / N is exact, so the only rounding is in the low part.
+    //
+    // 2. Approximation of exp(r)
+    //    With N = 128, |r| < 0.0028, so the Taylor series through r^5
+    //    approximates exp(r) - 1 with a relative error below 2^-60.
+    //
+    // 3. Reconstruction
+    //    Write k = N * e + j, then
+    //        exp(x) = 2^e * 2^(j/N) * exp(r)
+    //               = 2^e * (T[j] + (T_lo[j] + T[j] * (exp(r) - 1)))
+    //    where T[j] + T_lo[j] is 2^(j/N) to about 106 bits.
     //
-    // The value is now in the primary range.
+    // Accuracy:
+    //    The only large rounding error is in the final addition, so the
+    //    error is within about 0.51 ulp for normal results. Subnormal results
+    //    are rounded a second time when scaled, as they were before.
     //
 
-    Input  = Value * Value;
-    if (Ln2Multiple >= -1021) {
-        ValueParts.Ulong.High =
-                            DOUBLE_ONE_HIGH_WORD +
-                            (Ln2Multiple <<
-                             (DOUBLE_EXPONENT_SHIFT - DOUBLE_HIGH_WORD_SHIFT));
+    MultipleDouble = Value * ClExpTableInverseLn2;
+    if (MultipleDouble < 0) {
+        Multiple = (LONG)(MultipleDouble - ClDoubleOneHalf);
 
     } else {
-        ValueParts.Ulong.High =
-                            DOUBLE_ONE_HIGH_WORD +
-                            ((Ln2Multiple + 1000) <<
-                             (DOUBLE_EXPONENT_SHIFT - DOUBLE_HIGH_WORD_SHIFT));
+        Multiple = (LONG)(MultipleDouble + ClDoubleOneHalf);
     }
 
-    ValueParts.Ulong.Low = 0;
-    TwoPower = ValueParts.Double;
-    Approximation = Value - Input *
-                    (ClExp1 + Input *
-                     (ClExp2 + Input *
-                      (ClExp3 + Input *
-                       (ClExp4 + Input * ClExp5))));
+    MultipleDouble = (double)Multiple;
+    Reduced = (Value - MultipleDouble * ClExpTableLn2High) -
+              MultipleDouble * ClExpTableLn2Low;
+
+    Index = Multiple & (EXP_TABLE_SIZE - 1);
+    Exponent = (Multiple - Index) / EXP_TABLE_SIZE;
+    TableHigh = ClExpTable[Index * 2];
+    TableLow = ClExpTable[(Index * 2) + 1];
+    ReducedSquared = Reduced * Reduced;
+    Polynomial = Reduced +
+                 ReducedSquared *
+                 (ClExpTableCoefficients[0] +
+                  Reduced * ClExpTableCoefficients[1]) +
+                 ReducedSquared * ReducedSquared *
+                 (ClExpTableCoefficients[2] +
+                  Reduced * ClExpTableCoefficients[3]);
+
+    Exponentiation = TableHigh + (TableLow + TableHigh * Polynomial);
 
-    if (Ln2Multiple == 0) {
-        Exponentiation = ClDoubleOne -
-                         ((Value * Approximation) / (Approximation - 2.0) -
-                          Value);
+    //
+    // Scale by 2^e, taking care at the ends where 2^e itself is not a normal
+    // double.
+    //
 
-        return Exponentiation;
-    }
+    if ((Exponent >= 1 - DOUBLE_EXPONENT_BIAS) &&
+        (Exponent <= DOUBLE_EXPONENT_BIAS)) {
 
-    Exponentiation = ClDoubleOne -
-        ((Low - (Value * Approximation) / (2.0 - Approximation)) - High);
+        TwoPower.Ulonglong = (ULONGLONG)(Exponent + DOUBLE_EXPONENT_BIAS) <<
+                             DOUBLE_EXPONENT_SHIFT;
 
-    if (Ln2Multiple >= -1021) {
-        if (Ln2Multiple == 1024) {
-            return Exponentiation * 2.0 * EXP_2_TO_1023;
-        }
+        return Exponentiation * TwoPower.Double;
+    }
 
-        return Exponentiation * TwoPower;
+    if (Exponent > DOUBLE_EXPONENT_BIAS) {
+        return Exponentiation * 2.0 * EXP_2_TO_1023;
     }
 
-    return Exponentiation * TwoPower * ClTwoNegative1000;
+    TwoPower.Ulonglong = (ULONGLONG)(Exponent + 1000 + DOUBLE_EXPONENT_BIAS) <<
+                         DOUBLE_EXPONENT_SHIFT;
+
+    return Exponentiation * TwoPower.Double * ClTwoNegative1000;
 }
 
 //
@@ -43,10 +43,7 @@ Module Name:
 //
 
 #define EXPF_UPPER_THRESHOLD_WORD 0x42B17218
-#define EXPF_HALF_LN_2_WORD 0x3EB17218
-#define EXPF_3_HALVES_LN_2_WORD 0x3F851592
-#define EXPF_LOWER_THRESHOLD_WORD 0x39000000
-#define EXPF_2_TO_127 0x1p127F
+#define EXPF_LOWER_THRESHOLD_WORD 0x33000000
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -63,9 +60,6 @@ Module Name:
 const float ClExpfOverflowThreshold = 8.8721679688e+01;
 const float ClExpfUnderflowThreshold = -1.0397208405e+02;
 
-const float ClExpf1 = 1.6666625440e-01;
-const float ClExpf2 = -2.7667332906e-3;
-
 //
 // Define 2^-100 for underflow.
 //
@@ -168,21 +162,10 @@ Return Value:
 
 {
 
-    float Approximation;
-    float Exponentiation;
-    float High;
-    float Input;
-    LONG Ln2Multiple;
-    float Low;
     LONG SignBit;
-    float TwoPower;
     FLOAT_PARTS ValueParts;
-    volatile float VolatileValue;
     ULONG Word;
 
-    High = 0.0;
-    Low = 0.0;
-    Ln2Multiple = 0;
     ValueParts.Float= Value;
     Word = ValueParts.Ulong;
     SignBit = Word >> FLOAT_SIGN_BIT_SHIFT;
@@ -227,38 +210,6 @@ Return Value:
         if (Value < ClExpfUnderflowThreshold) {
             return ClTwoNegative100 * ClTwoNegative100;
         }
-    }
-
-    //
-    // Perform argument reduction.
-    //
-
-    if (Word > EXPF_HALF_LN_2_WORD) {
-        if (Word < EXPF_3_HALVES_LN_2_WORD) {
-            High = Value - ClFloatLn2High[SignBit];
-            Low = ClFloatLn2Low[SignBit];
-            Ln2Multiple = 1 - SignBit - SignBit;
-
-        } else {
-            if (SignBit != 0) {
-                Ln2Multiple = (INT)(ClFloatInverseLn2 * Value - ClFloatOneHalf);
-
-            } else {
-                Ln2Multiple = (INT)(ClFloatInverseLn2 * Value + ClFloatOneHalf);
-            }
-
-            Input = Ln2Multiple;
-
-            //
-            // Input * Ln2High is exact here.
-            //
-
-            High = Value - Input * ClFloatLn2High[0];
-            Low = Input * ClFloatLn2Low[0];
-        }
-
-        VolatileValue = High - Low;
-        Value = VolatileValue;
 
     //
     // Handle very small values.
@@ -273,48 +224,68 @@ Return Value:
 
             return ClFloatOne + Value;
         }
-
-    } else {
-        Ln2Multiple = 0;
     }
 
     //
-    // The value is now in the primary range.
+    // Compute the result in double precision with the table kernel. Its
+    // error is far below a single precision ulp, and the exponent range of a
+    // double covers every single precision result, so the conversion is the
+    // only significant rounding.
     //
 
-    Input  = Value * Value;
-    if (Ln2Multiple >= -125) {
-        ValueParts.Ulong = FLOAT_ONE_WORD +
-                           (Ln2Multiple << FLOAT_EXPONENT_SHIFT);
+    return (float)ClpExpKernel(Value);
+}
 
-    } else {
-        ValueParts.Ulong = FLOAT_ONE_WORD +
-                           ((Ln2Multiple + 100) << FLOAT_EXPONENT_SHIFT);
-    }
+LIBC_API
+void
+vexpf (
+    float *Results,
+    const float *Values,
+    size_t Count
+    )
 
-    TwoPower = ValueParts.Float;
-    Approximation = Value - Input * (ClExpf1 + Input * ClExpf2);
-    if (Ln2Multiple == 0) {
-        Exponentiation = ClFloatOne -
-                         ((Value * Approximation) /
-                          (Approximation - (float)2.0) -
-                         Value);
+/*++
 
-        return Exponentiation;
-    }
+Routine Description:
 
-    Exponentiation = ClFloatOne -
-        ((Low - (Value * Approximation) / ((float)2.0 - Approximation)) - High);
+    This routine computes the base e exponential of each value in an array.
+    The results are identical to calling expf on each element.
 
-    if (Ln2Multiple >= -125) {
-        if (Ln2Multiple == 128) {
-            return Exponentiation * (float)2.0 * EXPF_2_TO_127;
-        }
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to raise e to.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
 
-        return Exponentiation * TwoPower;
+--*/
+
+{
+
+    size_t Index;
+    FLOAT_PARTS ValueParts;
+    ULONG Word;
+
+    for (Index = 0; Index < Count; Index += 1) {
+        ValueParts.Float = Values[Index];
+        Word = ValueParts.Ulong & ~FLOAT_SIGN_BIT;
+        if ((Word - EXPF_LOWER_THRESHOLD_WORD) <
+            (EXPF_UPPER_THRESHOLD_WORD - EXPF_LOWER_THRESHOLD_WORD)) {
+
+            Results[Index] = (float)ClpExpKernel(ValueParts.Float);
+
+        } else {
+            Results[Index] = expf(ValueParts.Float);
+        }
     }
 
-    return Exponentiation * TwoPower * ClTwoNegative100;
+    return;
 }
 
 //
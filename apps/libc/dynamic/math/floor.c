@@ -94,6 +94,17 @@ Return Value:
     ULONG ValueHighWordMask;
     DOUBLE_PARTS ValueParts;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_DOUBLE(Value, Value, MATH_ROUND_DOWN);
+    return Value;
+
+#endif
+
     ExponentHighWordMask = DOUBLE_EXPONENT_MASK >> DOUBLE_HIGH_WORD_SHIFT;
     ExponentHighWordShift = DOUBLE_EXPONENT_SHIFT - DOUBLE_HIGH_WORD_SHIFT;
     ValueHighWordMask = (~(DOUBLE_SIGN_BIT | DOUBLE_EXPONENT_MASK)) >>
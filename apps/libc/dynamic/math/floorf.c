@@ -89,6 +89,17 @@ Return Value:
     FLOAT_PARTS ValueParts;
     LONG Word;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_FLOAT(Value, Value, MATH_ROUND_DOWN);
+    return Value;
+
+#endif
+
     ValueParts.Float = Value;
     Word = ValueParts.Ulong;
 
@@ -43,6 +43,21 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the range around one that uses the polynomial on x - 1 rather than
+// the lookup table, which would lose accuracy to cancellation there.
+//
+
+#define LOG_NEAR_ONE_LOW 0x3FEE000000000000ULL
+#define LOG_NEAR_ONE_HIGH 0x3FF1000000000000ULL
+
+//
+// Define the range of positive normal values.
+//
+
+#define LOG_NORMAL_LOW 0x0010000000000000ULL
+#define LOG_NORMAL_HIGH 0x7FF0000000000000ULL
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -63,6 +78,155 @@ const double ClLog5 = 1.818357216161805012e-01;
 const double ClLog6 = 1.531383769920937332e-01;
 const double ClLog7 = 1.479819860511658591e-01;
 
+//
+// Define the Taylor coefficients of log(1 + r) - r, starting with r^2.
+//
+
+const double ClLogTableCoefficients[6] = {
+    -0x1.0000000000000p-1,
+    0x1.5555555555555p-2,
+    -0x1.0000000000000p-2,
+    0x1.999999999999Ap-3,
+    -0x1.5555555555555p-3,
+    0x1.2492492492492p-3
+};
+
+//
+// Define the log lookup table. Each entry holds 1/c, and log(c) as a high
+// part and the low part that remains.
+//
+
+const double ClLogTable[LOG_TABLE_SIZE * LOG_TABLE_STRIDE] = {
+    0x1.734F0C541FE8Dp+0, -0x1.7CC7F7DB46A0Ep-2, 0x1.8438023CDC3D3p-56,
+    0x1.713786D9C7C09p+0, -0x1.76FEECB947175p-2, 0x1.118D9EB4EA362p-56,
+    0x1.6F26016F26017p+0, -0x1.713E33A46A17Cp-2, 0x1.9367A05AE38D3p-56,
+    0x1.6D1A62681C861p+0, -0x1.6B85B4CFFA3FDp-2, 0x1.8AF2C8DAFCB08p-57,
+    0x1.6B1490AA31A3Dp+0, -0x1.65D558D4CE00Bp-2, 0x1.7605A4748480Ap-56,
+    0x1.691473A88D0C0p+0, -0x1.602D08AF091ECp-2, 0x1.6E8920C09B73Fp-58,
+    0x1.6719F3601671Ap+0, -0x1.5A8CADBBEDFA1p-2, 0x1.E6C2BDFB3E037p-58,
+    0x1.6524F853B4AA3p+0, -0x1.54F431B7BE1A9p-2, 0x1.AACFDBBDAB914p-56,
+    0x1.63356B88AC0DEp+0, -0x1.4F637EBBA9810p-2, 0x1.58CB3124B9245p-56,
+    0x1.614B36831AE94p+0, -0x1.49DA7F3BCC41Fp-2, 0x1.9964A168CCACAp-57,
+    0x1.5F66434292DFCp+0, -0x1.44591E0539F49p-2, 0x1.2B125247B0FA5p-56,
+    0x1.5D867C3ECE2A5p+0, -0x1.3EDF463C1683Ep-2, -0x1.83D680D3C1084p-56,
+    0x1.5BABCC647FA91p+0, -0x1.396CE359BBF54p-2, 0x1.CE2B31B31E8B0p-58,
+    0x1.59D61F123CCAAp+0, -0x1.3401E12AECBA1p-2, 0x1.CD55B8A4746C0p-58,
+    0x1.5805601580560p+0, -0x1.2E9E2BCE12286p-2, -0x1.8251A3B83D97Ap-62,
+    0x1.56397BA7C52E2p+0, -0x1.2941AFB186B7Cp-2, 0x1.856E61C515740p-57,
+    0x1.54725E6BB82FEp+0, -0x1.23EC5991EBA49p-2, -0x1.BB75D1ADDF870p-60,
+    0x1.52AFF56A8054Bp+0, -0x1.1E9E1678899F4p-2, -0x1.512C3749A1E4Ep-56,
+    0x1.50F22E111C4C5p+0, -0x1.1956D3B9BC2FAp-2, -0x1.7B9D68D50A15Dp-56,
+    0x1.4F38F62DD4C9Bp+0, -0x1.14167EF367783p-2, -0x1.E0936ABD4FA6Ep-62,
+    0x1.4D843BEDC2C4Cp+0, -0x1.0EDD060B78081p-2, 0x1.92B49EF282B09p-57,
+    0x1.4BD3EDDA68FE1p+0, -0x1.09AA572E6C6D4p-2, -0x1.43C2E68684D53p-57,
+    0x1.4A27FAD76014Ap+0, -0x1.047E60CDE83B8p-2, 0x1.0779634061CBCp-56,
+    0x1.4880522014880p+0, -0x1.FEB2233EA07CDp-3, -0x1.8DE00938B4C40p-61,
+    0x1.46DCE34596066p+0, -0x1.F474B134DF229p-3, 0x1.27C77DED76AADp-58,
+    0x1.453D9E2C776CAp+0, -0x1.EA4449F04AAF5p-3, 0x1.D33919AB94074p-57,
+    0x1.43A2730ABEE4Dp+0, -0x1.E020CC6235AB5p-3, -0x1.FEA48DD7B81D1p-58,
+    0x1.420B5265E5951p+0, -0x1.D60A17F903515p-3, 0x1.C0DF841A71B7Ap-57,
+    0x1.40782D10E6566p+0, -0x1.CC000C9DB3C52p-3, -0x1.53D154280394Fp-57,
+    0x1.3EE8F42A5AF07p+0, -0x1.C2028AB17F9B4p-3, -0x1.F11AA3853A5F1p-57,
+    0x1.3D5D991AA75C6p+0, -0x1.B811730B823D2p-3, -0x1.A0EE735D9F0ECp-60,
+    0x1.3BD60D9232955p+0, -0x1.AE2CA6F672BD4p-3, -0x1.AB5CA9EAA088Ap-57,
+    0x1.3A524387AC822p+0, -0x1.A454082E6AB05p-3, -0x1.DF207DC5C34C6p-58,
+    0x1.38D22D366088Ep+0, -0x1.9A8778DEBAA38p-3, -0x1.F47DFD871F87Fp-57,
+    0x1.3755BD1C945EEp+0, -0x1.90C6DB9FCBCD9p-3, -0x1.054473941AD99p-57,
+    0x1.35DCE5F9F2AF8p+0, -0x1.871213750E994p-3, -0x1.D685F35EEA2A0p-57,
+    0x1.34679ACE01346p+0, -0x1.7D6903CAF5AD0p-3, 0x1.AC5F0C075B847p-59,
+    0x1.32F5CED6A1DFAp+0, -0x1.73CB9074FD14Dp-3, 0x1.521A000B4CF01p-57,
+    0x1.3187758E9EBB6p+0, -0x1.6A399DABBD383p-3, -0x1.96332BD4B341Fp-57,
+    0x1.301C82AC40260p+0, -0x1.60B3100B09476p-3, 0x1.5B2623E05016Bp-58,
+    0x1.2EB4EA1FED14Bp+0, -0x1.5737CC9018CDDp-3, -0x1.4F4D710FEC38Ep-57,
+    0x1.2D50A012D50A0p+0, -0x1.4DC7B897BC1C8p-3, 0x1.927D47803C5F4p-57,
+    0x1.2BEF98E5A3711p+0, -0x1.4462B9DC9B3DCp-3, 0x1.629C46C186385p-58,
+    0x1.2A91C92F3C105p+0, -0x1.3B08B6757F2A9p-3, -0x1.70D6CDF05266Cp-60,
+    0x1.293725BB804A5p+0, -0x1.31B994D3A4F85p-3, 0x1.C4716BDFC0CC9p-58,
+    0x1.27DFA38A1CE4Dp+0, -0x1.28753BC11ABA5p-3, 0x1.6394D9FA33311p-57,
+    0x1.268B37CD60127p+0, -0x1.1F3B925F25D41p-3, -0x1.62C9EF939AC5Dp-59,
+    0x1.2539D7E9177B2p+0, -0x1.160C8024B27B1p-3, 0x1.2D56FF61C2BFBp-57,
+    0x1.23EB79717605Bp+0, -0x1.0CE7ECDCCC28Dp-3, 0x1.692A0055DC959p-57,
+    0x1.22A0122A0122Ap+0, -0x1.03CDC0A51EC0Dp-3, -0x1.39E2D3F8B7D10p-57,
+    0x1.21579804855E6p+0, -0x1.F57BC7D9005DBp-4, 0x1.9361574FB24E2p-58,
+    0x1.2012012012012p+0, -0x1.E3707EE30487Bp-4, -0x1.09CCECD579D99p-58,
+    0x1.1ECF43C7FB84Cp+0, -0x1.D179788219364p-4, -0x1.9DAF7DF76AD2Ap-59,
+    0x1.1D8F5672E4ABDp+0, -0x1.BF968769FCA11p-4, 0x1.CDC9F6F5F38C7p-59,
+    0x1.1C522FC1CE059p+0, -0x1.ADC77EE5AEA8Cp-4, -0x1.37D8F39BEE659p-58,
+    0x1.1B17C67F2BAE3p+0, -0x1.9C0C32D4D2548p-4, -0x1.FB0BE3CCC1532p-59,
+    0x1.19E0119E0119Ep+0, -0x1.8A6477A91DC29p-4, 0x1.FA83214904842p-59,
+    0x1.18AB083902BDBp+0, -0x1.78D02263D82D3p-4, -0x1.ABCA5B4FDB880p-58,
+    0x1.1778A191BD684p+0, -0x1.674F089365A7Ap-4, 0x1.9ACD8B33F8FDCp-58,
+    0x1.1648D50FC3201p+0, -0x1.55E10050E0384p-4, 0x1.45F9D61C68C1Bp-58,
+    0x1.151B9A3FDD5C9p+0, -0x1.4485E03DBDFADp-4, -0x1.1BA349AADBC6Ep-58,
+    0x1.13F0E8D344724p+0, -0x1.333D7F8183F4Bp-4, -0x1.A92AFC8EF70B1p-58,
+    0x1.12C8B89EDC0ACp+0, -0x1.2207B5C78549Ep-4, 0x1.CC0FBCE104EAAp-58,
+    0x1.11A3019A74826p+0, -0x1.10E45B3CAE831p-4, 0x1.A4A128D192686p-58,
+    0x1.107FBBE011080p+0, -0x1.FFA6911AB9301p-5, 0x1.CD9F1F95C2EEDp-59,
+    0x1.0F5EDFAB325A2p+0, -0x1.DDA8ADC67EE4Ep-5, -0x1.4E6C986F44C55p-59,
+    0x1.0E40655826011p+0, -0x1.BBCEBFC68F420p-5, -0x1.E5CF3A0F56F72p-60,
+    0x1.0D24456359E3Ap+0, -0x1.9A187B573DE7Cp-5, 0x1.727626C86B3ABp-59,
+    0x1.0C0A7868B4171p+0, -0x1.788595A3577BAp-5, -0x1.E5EF898B67923p-59,
+    0x1.0AF2F722EECB5p+0, -0x1.5715C4C03CEEFp-5, 0x1.BBF88EC501B56p-61,
+    0x1.09DDBA6AF8360p+0, -0x1.35C8BFAA1306Bp-5, 0x1.50830A65543A4p-63,
+    0x1.08CABB37565E2p+0, -0x1.149E3E4005A8Dp-5, 0x1.53482D1F9D7D7p-61,
+    0x1.07B9F29B8EAE2p+0, -0x1.E72BF2813CE51p-6, -0x1.75B44595CAB18p-60,
+    0x1.06AB59C7912FBp+0, -0x1.A55F548C5C43Fp-6, -0x1.EC1A5F86D41F9p-62,
+    0x1.059EEA0727586p+0, -0x1.63D6178690BD6p-6, 0x1.8ED4D357C9C97p-64,
+    0x1.04949CC1664C5p+0, -0x1.228FB1FEA2E28p-6, 0x1.CD7B66E01C26Dp-61,
+    0x1.038C6B78247FCp+0, -0x1.C317384C75F06p-7, -0x1.806208C04C220p-61,
+    0x1.02864FC7729E9p+0, -0x1.41929F96832F0p-7, 0x1.C5517F64BC223p-61,
+    0x1.0182436517A37p+0, -0x1.8121214586B54p-8, -0x1.C14B9F9377A1Dp-65,
+    0x1.0080402010080p+0, -0x1.0040155D5889Ep-9, 0x1.8F98E1113F403p-65,
+    0x1.FE01FE01FE020p-1, 0x1.FF00AA2B10BC0p-9, 0x1.2821AD5A6D353p-63,
+    0x1.FA11CAA01FA12p-1, 0x1.7DC475F810A77p-7, -0x1.16D7687D3DF21p-62,
+    0x1.F6310ACA0DBB5p-1, 0x1.3CEA44346A575p-6, -0x1.0CB5A902B3A1Cp-62,
+    0x1.F25F644230AB5p-1, 0x1.B9FC027AF9198p-6, -0x1.0AE69229DC868p-64,
+    0x1.EE9C7F8458E02p-1, 0x1.1B0D98923D980p-5, -0x1.E9AE889BAC481p-60,
+    0x1.EAE807ABA01EBp-1, 0x1.58A5BAFC8E4D5p-5, -0x1.CE55C2B4E2B72p-59,
+    0x1.E741AA59750E4p-1, 0x1.95C830EC8E3EBp-5, 0x1.F5A0E80520BF2p-59,
+    0x1.E3A9179DC1A73p-1, 0x1.D276B8ADB0B52p-5, 0x1.1E3C53257FD47p-61,
+    0x1.E01E01E01E01Ep-1, 0x1.075983598E471p-4, 0x1.80DA5333C45B8p-59,
+    0x1.DCA01DCA01DCAp-1, 0x1.253F62F0A1417p-4, -0x1.C125963FC4CFDp-62,
+    0x1.D92F2231E7F8Ap-1, 0x1.42EDCBEA646F0p-4, 0x1.DDD4F935996C9p-59,
+    0x1.D5CAC807572B2p-1, 0x1.60658A93750C4p-4, -0x1.388458EC21B6Ap-58,
+    0x1.D272CA3FC5B1Ap-1, 0x1.7DA766D7B12CDp-4, -0x1.EEEDFCDD94131p-58,
+    0x1.CF26E5C44BFC6p-1, 0x1.9AB42462033ADp-4, -0x1.2099E1C184E8Ep-59,
+    0x1.CBE6D9601CBE7p-1, 0x1.B78C82BB0EDA1p-4, 0x1.0878CF0327E21p-61,
+    0x1.C8B265AFB8A42p-1, 0x1.D4313D66CB35Dp-4, 0x1.790DD951D90FAp-58,
+    0x1.C5894D10D4986p-1, 0x1.F0A30C01162A6p-4, 0x1.85F325C5BBACDp-58,
+    0x1.C26B5392EA01Cp-1, 0x1.0671512CA596Ep-3, 0x1.50C647EB86499p-58,
+    0x1.BF583EE868D8Bp-1, 0x1.14785846742ACp-3, 0x1.A28813E3A7F07p-57,
+    0x1.BC4FD65883E7Bp-1, 0x1.2266F190A5ACBp-3, 0x1.F547BF1809E88p-57,
+    0x1.B951E2B18FF23p-1, 0x1.303D718E47FD3p-3, -0x1.6B9C7D96091FAp-63,
+    0x1.B65E2E3BEEE05p-1, 0x1.3DFC2B0ECC62Ap-3, -0x1.AB3A8E7D81017p-58,
+    0x1.B37484AD806CEp-1, 0x1.4BA36F39A55E5p-3, 0x1.68981BCC36756p-57,
+    0x1.B094B31D922A4p-1, 0x1.59338D9982086p-3, -0x1.65D22AA8AD7CFp-58,
+    0x1.ADBE87F94905Ep-1, 0x1.66ACD4272AD51p-3, -0x1.0900E4E1EA8B2p-58,
+    0x1.AAF1D2F87EBFDp-1, 0x1.740F8F54037A5p-3, -0x1.B264062A84CDBp-58,
+    0x1.A82E65130E159p-1, 0x1.815C0A14357EBp-3, -0x1.4BE48073A0564p-58,
+    0x1.A574107688A4Ap-1, 0x1.8E928DE886D41p-3, -0x1.569D851A56770p-57,
+    0x1.A2C2A87C51CA0p-1, 0x1.9BB362E7DFB83p-3, 0x1.575E31F003E0Cp-57,
+    0x1.A01A01A01A01Ap-1, 0x1.A8BECFC882F19p-3, -0x1.E8C37918C39EBp-58,
+    0x1.9D79F176B682Dp-1, 0x1.B5B519E8FB5A4p-3, 0x1.BA27FDC19E1A0p-57,
+    0x1.9AE24EA5510DAp-1, 0x1.C2968558C18C1p-3, -0x1.73DEE38A3FB6Bp-57,
+    0x1.9852F0D8EC0FFp-1, 0x1.CF6354E09C5DCp-3, 0x1.239A07D55B695p-57,
+    0x1.95CBB0BE377AEp-1, 0x1.DC1BCA0ABEC7Dp-3, 0x1.834C51998B6FCp-57,
+    0x1.934C67F9B2CE6p-1, 0x1.E8C0252AA5A60p-3, -0x1.6E03A39BFC89Bp-59,
+    0x1.90D4F120190D5p-1, 0x1.F550A564B7B37p-3, 0x1.C5F6DFD018C37p-61,
+    0x1.8E6527AF1373Fp-1, 0x1.00E6C45AD501Dp-2, -0x1.CB9568FF6FEADp-57,
+    0x1.8BFCE8062FF3Ap-1, 0x1.071B85FCD590Dp-2, 0x1.D1707F97BDE80p-58,
+    0x1.899C0F601899Cp-1, 0x1.0D46B579AB74Bp-2, 0x1.03EC81C3CBD92p-57,
+    0x1.87427BCC092B9p-1, 0x1.136870293A8B0p-2, 0x1.7B66298EDD24Ap-56,
+    0x1.84F00C2780614p-1, 0x1.1980D2DD4236Fp-2, 0x1.9D3D1B0E4D147p-56,
+    0x1.82A4A0182A4A0p-1, 0x1.1F8FF9E48A2F3p-2, -0x1.C9FDF9A0C4B07p-56,
+    0x1.8060180601806p-1, 0x1.2596010DF763Ap-2, -0x1.0F76C57075E9Ep-58,
+    0x1.7E225515A4F1Dp-1, 0x1.2B9303AB89D25p-2, -0x1.896B5FD852AD4p-56,
+    0x1.7BEB3922E017Cp-1, 0x1.31871C9544185p-2, -0x1.51ACC4C09B379p-60,
+    0x1.79BAA6BB6398Bp-1, 0x1.3772662BFD85Bp-2, -0x1.B5629D8117DE7p-59,
+    0x1.77908119AC60Dp-1, 0x1.3D54FA5C1F710p-2, -0x1.E3265C6A1C98Dp-56,
+    0x1.756CAC201756Dp-1, 0x1.432EF2A04E814p-2, -0x1.29931715AC903p-56
+};
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -156,6 +320,9 @@ Return Value:
     //    According to an error analysis, the error is always less than
     //    1 ulp (unit in the last place).
     //
+    // Values outside of [1 - 1/16, 1 + 1/16] are handed off to the table
+    // driven kernel before step 1, which avoids the division.
+    //
 
     ExponentShift = DOUBLE_EXPONENT_SHIFT - DOUBLE_HIGH_WORD_SHIFT;
     Parts.Double = Value;
@@ -200,6 +367,17 @@ Return Value:
         return Value + Value;
     }
 
+    //
+    // Use the lookup table unless the value is close to one.
+    //
+
+    Parts.Double = Value;
+    if ((Parts.Ulonglong - LOG_NEAR_ONE_LOW) >=
+        (LOG_NEAR_ONE_HIGH - LOG_NEAR_ONE_LOW)) {
+
+        return ClpLogKernel(Value, Exponent);
+    }
+
     Exponent += (HighWord >> ExponentShift) - DOUBLE_EXPONENT_BIAS;
     HighWord &= DOUBLE_HIGH_VALUE_MASK;
     ExtraExponent = (HighWord + 0x95F64) & (1 << ExponentShift);
@@ -287,6 +465,170 @@ Return Value:
     return Logarithm;
 }
 
+LIBC_API
+void
+vlog (
+    double *Results,
+    const double *Values,
+    size_t Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the natural logarithm of each value in an array.
+    The results are identical to calling log on each element.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to take the logarithm
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    size_t Index;
+    DOUBLE_PARTS ValueParts;
+
+    //
+    // Send positive normal values away from one straight to the table kernel,
+    // so that the loop body is free of calls and special cases.
+    //
+
+    for (Index = 0; Index < Count; Index += 1) {
+        ValueParts.Double = Values[Index];
+        if (((ValueParts.Ulonglong - LOG_NORMAL_LOW) <
+             (LOG_NORMAL_HIGH - LOG_NORMAL_LOW)) &&
+            ((ValueParts.Ulonglong - LOG_NEAR_ONE_LOW) >=
+             (LOG_NEAR_ONE_HIGH - LOG_NEAR_ONE_LOW))) {
+
+            Results[Index] = ClpLogKernel(ValueParts.Double, 0);
+
+        } else {
+            Results[Index] = log(ValueParts.Double);
+        }
+    }
+
+    return;
+}
+
+double
+ClpLogKernel (
+    double Value,
+    LONG Exponent
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the natural logarithm of a positive normal value
+    using the lookup table. The value should not be in the range near one
+    where the table loses accuracy.
+
+Arguments:
+
+    Value - Supplies the value to get the logarithm of.
+
+    Exponent - Supplies the power of two the value has already been scaled
+        by, which is added to the result.
+
+Return Value:
+
+    Returns the logarithm of the value, plus the given exponent times log(2).
+
+--*/
+
+{
+
+    DOUBLE_PARTS Center;
+    double ExponentDouble;
+    double High;
+    LONG Index;
+    double Low;
+    ULONGLONG Offset;
+    DOUBLE_PARTS Parts;
+    double Polynomial;
+    double Reduced;
+    double ReducedSquared;
+    double Sum;
+    const double *Table;
+
+    //
+    // Method:
+    // 1. Argument reduction
+    //    Write x = 2^k * z, where z is in [0.6875, 1.375). The interval
+    //    is split into N pieces that are evenly spaced in the bits of z, and
+    //    c is the center of z's piece. Since c has only a few significant
+    //    bits, z - c is exact, and
+    //        r = (z - c) * (1/c),  |r| < 2^-8.
+    //
+    // 2. Approximation
+    //        log(x) = k * ln2 + log(c) + log(1 + r)
+    //    The Taylor series through r^7 approximates log(1 + r) - r with an
+    //    error below 2^-67.
+    //
+    // 3. Sum
+    //    The large terms k * ln2_hi, log(c)_hi and r are added with their
+    //    rounding errors tracked, and all the small terms go into the low
+    //    part.
+    //
+    // Accuracy:
+    //    Outside the range near one, |log(x)| > 0.06, so the error in r is
+    //    a small fraction of an ulp of the result. The error is within about
+    //    0.52 ulp, and below 0.62 ulp right at the edge of the range near
+    //    one.
+    //
+
+    Parts.Double = Value;
+    Offset = Parts.Ulonglong - LOG_TABLE_START;
+    Index = (Offset >> LOG_TABLE_INDEX_SHIFT) & (LOG_TABLE_SIZE - 1);
+    Exponent += (LONGLONG)Offset >> DOUBLE_EXPONENT_SHIFT;
+    Parts.Ulonglong -= Offset & (DOUBLE_SIGN_BIT | DOUBLE_EXPONENT_MASK);
+    Center.Ulonglong = (Parts.Ulonglong &
+                        ~((1ULL << LOG_TABLE_INDEX_SHIFT) - 1)) |
+                       (1ULL << (LOG_TABLE_INDEX_SHIFT - 1));
+
+    Table = &(ClLogTable[Index * LOG_TABLE_STRIDE]);
+    Reduced = (Parts.Double - Center.Double) * Table[0];
+
+    //
+    // Add k * ln2_hi + log(c)_hi + r, keeping the rounding errors. The
+    // magnitudes decrease from left to right, so each error is exact.
+    //
+
+    ExponentDouble = (double)Exponent;
+    High = ExponentDouble * ClDoubleLn2High[0];
+    Sum = High + Table[1];
+    Low = (High - Sum) + Table[1];
+    High = Sum + Reduced;
+    Low += (Sum - High) + Reduced;
+    Low += ExponentDouble * ClDoubleLn2Low[0] + Table[2];
+    ReducedSquared = Reduced * Reduced;
+    Polynomial = ReducedSquared *
+                 (ClLogTableCoefficients[0] +
+                  Reduced * ClLogTableCoefficients[1] +
+                  ReducedSquared *
+                  (ClLogTableCoefficients[2] +
+                   Reduced * ClLogTableCoefficients[3] +
+                   ReducedSquared *
+                   (ClLogTableCoefficients[4] +
+                    Reduced * ClLogTableCoefficients[5])));
+
+    return High + (Low + Polynomial);
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
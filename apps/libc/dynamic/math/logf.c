@@ -55,14 +55,6 @@ Module Name:
 // -------------------------------------------------------------------- Globals
 //
 
-const float ClFloatLog1 = 6.6666668653e-01;
-const float ClFloatLog2 = 4.0000000596e-01;
-const float ClFloatLog3 = 2.8571429849e-01;
-const float ClFloatLog4 = 2.2222198546e-01;
-const float ClFloatLog5 = 1.8183572590e-01;
-const float ClFloatLog6 = 1.5313838422e-01;
-const float ClFloatLog7 = 1.4798198640e-01;
-
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -91,38 +83,18 @@ Return Value:
 
 {
 
-    float Approximation;
-    float Evens;
-    LONG Exponent;
-    float ExponentFloat;
-    LONG ExtraExponent;
-    LONG ExtraThreshold;
-    float HalfSquare;
-    float Input;
-    float Input2;
-    float Input4;
-    float Logarithm;
-    float Odds;
     FLOAT_PARTS Parts;
-    LONG Threshold;
-    float ValueMinusOne;
     LONG Word;
 
     Parts.Float = Value;
     Word = Parts.Ulong;
-    Exponent = 0;
+    if (Word <= 0) {
 
-    //
-    // Handle a very small value.
-    //
+        //
+        // The log(+-0) = -Infinity.
+        //
 
-    if (Word < (1 << FLOAT_EXPONENT_SHIFT)) {
         if ((Word & ~FLOAT_SIGN_BIT) == 0) {
-
-            //
-            // The log(+-0) = -Infinity.
-            //
-
             return -ClFloatTwo25 / ClFloatZero;
         }
 
@@ -130,112 +102,79 @@ Return Value:
         // The log of a negative number is NaN.
         //
 
-        if (Word < 0) {
-            return (Value - Value) / ClFloatZero;
-        }
-
-        //
-        // This is a subnormal number, scale up the value.
-        //
-
-        Exponent -= 25;
-        Value *= ClFloatTwo25;
-        Parts.Float = Value;
-        Word = Parts.Ulong;
+        return (Value - Value) / ClFloatZero;
     }
 
     if (Word >= FLOAT_NAN) {
         return Value + Value;
     }
 
-    Exponent += (Word >> FLOAT_EXPONENT_SHIFT) - FLOAT_EXPONENT_BIAS;
-    Word &= FLOAT_VALUE_MASK;
-    ExtraExponent = (Word + (0x95F64 << 3)) & (1 << FLOAT_EXPONENT_SHIFT);
-
     //
-    // Normalize value or half the value.
+    // The table kernel is not exact at one, but is otherwise accurate to
+    // within 2^-60 absolute even near one, which is far below a single
+    // precision ulp. Subnormal inputs are normal once widened to double.
     //
 
-    Parts.Ulong = Word | (ExtraExponent ^ FLOAT_ONE_WORD);
-    Value = Parts.Float;
-    Exponent += ExtraExponent >> FLOAT_EXPONENT_SHIFT;
-    ValueMinusOne = Value - ClFloatOne;
+    if (Word == FLOAT_ONE_WORD) {
+        return ClFloatZero;
+    }
 
-    //
-    // Handle the value minus one being between -2^-9 and 2^-9.
-    //
+    return (float)ClpLogKernel(Value, 0);
+}
 
-    if ((FLOAT_VALUE_MASK & (0x8000 + Word)) < 0xC000) {
-        if (ValueMinusOne == ClFloatZero) {
-            if (Exponent == 0) {
-                return ClFloatZero;
+LIBC_API
+void
+vlogf (
+    float *Results,
+    const float *Values,
+    size_t Count
+    )
 
-            } else {
-                ExponentFloat = (float)Exponent;
-                Logarithm = ExponentFloat * ClFloatLn2High[0] +
-                            ExponentFloat * ClFloatLn2Low[0];
+/*++
 
-                return Logarithm;
-            }
-        }
+Routine Description:
 
-        Approximation = ValueMinusOne * ValueMinusOne *
-                        ((float)0.5 - (float)0.33333333333333333 *
-                         ValueMinusOne);
+    This routine computes the natural logarithm of each value in an array.
+    The results are identical to calling logf on each element.
 
-        if (Exponent == 0) {
-            return ValueMinusOne - Approximation;
+Arguments:
 
-        } else {
-            ExponentFloat = (float)Exponent;
-            Logarithm = ExponentFloat * ClFloatLn2High[0] -
-                        ((Approximation - ExponentFloat * ClFloatLn2Low[0]) -
-                         ValueMinusOne);
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
 
-            return Logarithm;
-        }
-    }
+    Values - Supplies a pointer to the array of values to take the logarithm
+        of.
 
-    Input = ValueMinusOne / ((float)2.0 + ValueMinusOne);
-    ExponentFloat = (float)Exponent;
-    Input2 = Input * Input;
-    Threshold = Word - (0x6147A << 3);
-    Input4 = Input2 * Input2;
-    ExtraThreshold = (0x6B851 << 3) - Word;
-    Evens = Input4 * (ClFloatLog2 + Input4 *
-                      (ClFloatLog4 + Input4 * ClFloatLog6));
-
-    Odds = Input2 * (ClFloatLog1 + Input4 *
-                     (ClFloatLog3 + Input4 *
-                      (ClFloatLog5 + Input4 * ClFloatLog7)));
-
-    Threshold |= ExtraThreshold;
-    Approximation = Odds + Evens;
-    if (Threshold > 0) {
-        HalfSquare = (float)0.5 * ValueMinusOne * ValueMinusOne;
-        if (Exponent == 0) {
-            Logarithm = ValueMinusOne -
-                        (HalfSquare - Input * (HalfSquare + Approximation));
-
-            return Logarithm;
-        }
+    Count - Supplies the number of elements in each array.
 
-        Logarithm = ExponentFloat * ClFloatLn2High[0] -
-                    ((HalfSquare - (Input * (HalfSquare + Approximation) +
-                      ExponentFloat * ClFloatLn2Low[0])) - ValueMinusOne);
+Return Value:
 
-        return Logarithm;
-    }
+    None.
 
-    if (Exponent == 0) {
-        return ValueMinusOne - Input * (ValueMinusOne - Approximation);
-    }
+--*/
 
-    Logarithm = ExponentFloat * ClFloatLn2High[0] -
-                ((Input * (ValueMinusOne - Approximation) -
-                  ExponentFloat * ClFloatLn2Low[0]) - ValueMinusOne);
+{
+
+    size_t Index;
+    FLOAT_PARTS ValueParts;
+
+    //
+    // Positive finite values other than one go straight to the table kernel.
+    //
+
+    for (Index = 0; Index < Count; Index += 1) {
+        ValueParts.Float = Values[Index];
+        if (((ValueParts.Ulong - 1) < (FLOAT_NAN - 1)) &&
+            (ValueParts.Ulong != FLOAT_ONE_WORD)) {
+
+            Results[Index] = (float)ClpLogKernel(ValueParts.Float, 0);
+
+        } else {
+            Results[Index] = logf(ValueParts.Float);
+        }
+    }
 
-    return Logarithm;
+    return;
 }
 
 //
@@ -27,6 +27,85 @@ Module Name:
 
 #include <math.h>
 
+//
+// Determine which floating point instructions can be used directly. SSE2 is
+// always present on x64, but the 32-bit x86 build only gets it if the
+// compiler is targeting it. The x87 square root is not used because the FPU
+// runs at extended precision, which would round twice. The SSE4.1 rounding
+// instructions are used only if the compiler is targeting them. ARM VFP has a
+// square root instruction but no rounding instruction before ARMv8.
+//
+
+#if defined(__amd64) || defined(__SSE2__)
+
+#define MATH_HARDWARE_SQRT_SSE 1
+
+#if defined(__SSE4_1__)
+
+#define MATH_HARDWARE_ROUND 1
+
+#endif
+
+#elif defined(__arm__) && defined(__ARM_FP) && ((__ARM_FP & 0xC) == 0xC)
+
+#define MATH_HARDWARE_SQRT_VFP 1
+
+#endif
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// These macros compute a correctly rounded square root using the hardware
+// instruction for it. They are only defined where the architecture section
+// below says one is available.
+//
+
+#if defined(MATH_HARDWARE_SQRT_SSE)
+
+#define MATH_HARDWARE_SQRT(_Result, _Value) \
+    __asm__ ("sqrtsd %1, %0" : "=x" (_Result) : "x" (_Value))
+
+#define MATH_HARDWARE_SQRTF(_Result, _Value) \
+    __asm__ ("sqrtss %1, %0" : "=x" (_Result) : "x" (_Value))
+
+//
+// These macros compute the square roots of two doubles or four floats at once.
+// The values are GCC vector types of the matching size.
+//
+
+#define MATH_HARDWARE_SQRT_VECTOR(_Result, _Value) \
+    __asm__ ("sqrtpd %1, %0" : "=x" (_Result) : "x" (_Value))
+
+#define MATH_HARDWARE_SQRTF_VECTOR(_Result, _Value) \
+    __asm__ ("sqrtps %1, %0" : "=x" (_Result) : "x" (_Value))
+
+#elif defined(MATH_HARDWARE_SQRT_VFP)
+
+#define MATH_HARDWARE_SQRT(_Result, _Value) \
+    __asm__ ("vsqrt.f64 %P0, %P1" : "=w" (_Result) : "w" (_Value))
+
+#define MATH_HARDWARE_SQRTF(_Result, _Value) \
+    __asm__ ("vsqrt.f32 %0, %1" : "=t" (_Result) : "t" (_Value))
+
+#endif
+
+//
+// This macro rounds a value to an integer with the hardware rounding
+// instruction, using one of the MATH_ROUND_* modes.
+//
+
+#if defined(MATH_HARDWARE_ROUND)
+
+#define MATH_HARDWARE_ROUND_DOUBLE(_Result, _Value, _Mode) \
+    __asm__ ("roundsd %2, %1, %0" : "=x" (_Result) : "x" (_Value), "i" (_Mode))
+
+#define MATH_HARDWARE_ROUND_FLOAT(_Result, _Value, _Mode) \
+    __asm__ ("roundss %2, %1, %0" : "=x" (_Result) : "x" (_Value), "i" (_Mode))
+
+#endif
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -52,10 +131,58 @@ Module Name:
 #define FLOAT_ONE_WORD 0x3F800000
 #define FLOAT_TWO_WORD 0x40000000
 
+//
+// Define the immediate values for the SSE4.1 rounding instructions. Bit 2
+// selects the current rounding mode, and bit 3 suppresses the inexact
+// exception.
+//
+
+#define MATH_ROUND_CURRENT_MODE 0x4
+#define MATH_ROUND_CURRENT_MODE_EXACT 0xC
+#define MATH_ROUND_DOWN 0x9
+#define MATH_ROUND_UP 0xA
+#define MATH_ROUND_TOWARD_ZERO 0xB
+
+//
+// Define the size of the exp lookup table, which holds 2^(j/N) for each j.
+//
+
+#define EXP_TABLE_BITS 7
+#define EXP_TABLE_SIZE (1 << EXP_TABLE_BITS)
+
+//
+// Define the size of the log lookup table. The table splits the range
+// [LOG_TABLE_START, 2 * LOG_TABLE_START) into LOG_TABLE_SIZE intervals that
+// are evenly spaced in the bit representation. Each interval holds 1/c and
+// log(c) for its center c.
+//
+
+#define LOG_TABLE_BITS 7
+#define LOG_TABLE_SIZE (1 << LOG_TABLE_BITS)
+#define LOG_TABLE_START 0x3FE6000000000000ULL
+#define LOG_TABLE_INDEX_SHIFT (DOUBLE_EXPONENT_SHIFT - LOG_TABLE_BITS)
+#define LOG_TABLE_STRIDE 3
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+//
+// Define the vector types used with the packed square root instructions.
+// These are only element aligned and may alias their element type, so that
+// callers' arrays can be loaded and stored through them directly.
+//
+
+#if defined(MATH_HARDWARE_SQRT_SSE)
+
+typedef double MATH_DOUBLE_VECTOR
+    __attribute__((vector_size(16), aligned(sizeof(double)), may_alias));
+
+typedef float MATH_FLOAT_VECTOR
+    __attribute__((vector_size(16), aligned(sizeof(float)), may_alias));
+
+#endif
+
 typedef enum _FLOATING_PRECISION {
     FloatingPrecisionSingle,
     FloatingPrecisionDouble,
@@ -86,6 +213,20 @@ extern const double ClDoubleLn2High[2];
 extern const double ClDoubleLn2Low[2];
 extern const double ClTwo52[2];
 
+//
+// Define the exp and log lookup tables. The exp table holds the high and low
+// parts of 2^(j/N). The log table holds the reciprocal of each interval's
+// center, followed by the high and low parts of its logarithm.
+//
+
+extern const double ClExpTable[EXP_TABLE_SIZE * 2];
+extern const double ClExpTableCoefficients[4];
+extern const double ClExpTableInverseLn2;
+extern const double ClExpTableLn2High;
+extern const double ClExpTableLn2Low;
+extern const double ClLogTable[LOG_TABLE_SIZE * LOG_TABLE_STRIDE];
+extern const double ClLogTableCoefficients[6];
+
 extern const float ClFloatHugeValue;
 extern const float ClFloatTinyValue;
 extern const float ClFloatZero;
@@ -126,6 +267,57 @@ Return Value:
 
 --*/
 
+double
+ClpExpKernel (
+    double Value
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the base e exponential of a finite value whose
+    magnitude is between 2^-54 and the underflow threshold, using the lookup
+    table.
+
+Arguments:
+
+    Value - Supplies the value to raise e to.
+
+Return Value:
+
+    Returns e to the given value.
+
+--*/
+
+double
+ClpLogKernel (
+    double Value,
+    LONG Exponent
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the natural logarithm of a positive normal value
+    using the lookup table. Within 1/16 of one the absolute error is still
+    below 2^-60, but the relative error grows, so double precision callers
+    handle that range separately.
+
+Arguments:
+
+    Value - Supplies the value to get the logarithm of.
+
+    Exponent - Supplies the power of two the value has already been scaled
+        by, which is added to the result.
+
+Return Value:
+
+    Returns the logarithm of the value, plus the given exponent times log(2).
+
+--*/
+
 float
 ClpLogOnePlusFloat (
     float Value
@@ -229,6 +229,17 @@ Return Value:
     ULONG SignBitShift;
     volatile double VolatileValue;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_DOUBLE(Value, Value, MATH_ROUND_CURRENT_MODE);
+    return Value;
+
+#endif
+
     Parts.Double = Value;
     HighWord = Parts.Ulong.High;
     LowWord = Parts.Ulong.Low;
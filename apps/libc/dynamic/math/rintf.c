@@ -223,6 +223,17 @@ Return Value:
     LONG SignBit;
     volatile float VolatileValue;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_FLOAT(Value, Value, MATH_ROUND_CURRENT_MODE);
+    return Value;
+
+#endif
+
     Parts.Float = Value;
     Word = Parts.Ulong;
     SignBit = (ULONG)Word >> FLOAT_SIGN_BIT_SHIFT;
@@ -221,6 +221,7 @@ Return Value:
     ValueParts.Ulong.High = (HighWord & (~ExponentHighWordMask)) |
                             (ValueExponent << ExponentHighWordShift);
 
+    Value = ValueParts.Double;
     return Value * ClTwoNegative54;
 }
 
@@ -106,6 +106,19 @@ Return Value:
     ULONG WorkingLow;
     LONG WorkingValue;
 
+    //
+    // Use the hardware instruction if there is one. It rounds correctly and
+    // handles zeros, infinities, NaNs and negative values the same way as the
+    // code below.
+    //
+
+#if defined(MATH_HARDWARE_SQRT)
+
+    MATH_HARDWARE_SQRT(Value, Value);
+    return Value;
+
+#endif
+
     //
     // This method computes the square root bit by bit using integer arithmetic.
     // There are three steps.
@@ -342,6 +355,73 @@ Return Value:
     return ValueParts.Double;
 }
 
+LIBC_API
+void
+vsqrt (
+    double *Results,
+    const double *Values,
+    size_t Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the square root of each value in an array. The
+    results are identical to calling sqrt on each element.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to get the square roots
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    size_t Index;
+
+#if defined(MATH_HARDWARE_SQRT_VECTOR)
+
+    MATH_DOUBLE_VECTOR Vector;
+
+#endif
+
+    Index = 0;
+
+    //
+    // Where there is a packed square root instruction, do as many elements at
+    // a time as fit in a vector register.
+    //
+
+#if defined(MATH_HARDWARE_SQRT_VECTOR)
+
+    while (Count - Index >= sizeof(Vector) / sizeof(double)) {
+        Vector = *((const MATH_DOUBLE_VECTOR *)&(Values[Index]));
+        MATH_HARDWARE_SQRT_VECTOR(Vector, Vector);
+        *((MATH_DOUBLE_VECTOR *)&(Results[Index])) = Vector;
+        Index += sizeof(Vector) / sizeof(double);
+    }
+
+#endif
+
+    while (Index < Count) {
+        Results[Index] = sqrt(Values[Index]);
+        Index += 1;
+    }
+
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -100,6 +100,19 @@ Return Value:
     LONG Word;
     LONG WorkingValue;
 
+    //
+    // Use the hardware instruction if there is one. It rounds correctly and
+    // handles zeros, infinities, NaNs and negative values the same way as the
+    // code below.
+    //
+
+#if defined(MATH_HARDWARE_SQRTF)
+
+    MATH_HARDWARE_SQRTF(Value, Value);
+    return Value;
+
+#endif
+
     ValueParts.Float = Value;
     Word = ValueParts.Ulong;
     FirstExponentBit = 1 << FLOAT_EXPONENT_SHIFT;
@@ -229,6 +242,73 @@ Return Value:
     return ValueParts.Float;
 }
 
+LIBC_API
+void
+vsqrtf (
+    float *Results,
+    const float *Values,
+    size_t Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the square root of each value in an array. The
+    results are identical to calling sqrtf on each element.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to get the square roots
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    size_t Index;
+
+#if defined(MATH_HARDWARE_SQRTF_VECTOR)
+
+    MATH_FLOAT_VECTOR Vector;
+
+#endif
+
+    Index = 0;
+
+    //
+    // Where there is a packed square root instruction, do as many elements at
+    // a time as fit in a vector register.
+    //
+
+#if defined(MATH_HARDWARE_SQRTF_VECTOR)
+
+    while (Count - Index >= sizeof(Vector) / sizeof(float)) {
+        Vector = *((const MATH_FLOAT_VECTOR *)&(Values[Index]));
+        MATH_HARDWARE_SQRTF_VECTOR(Vector, Vector);
+        *((MATH_FLOAT_VECTOR *)&(Results[Index])) = Vector;
+        Index += sizeof(Vector) / sizeof(float);
+    }
+
+#endif
+
+    while (Index < Count) {
+        Results[Index] = sqrtf(Values[Index]);
+        Index += 1;
+    }
+
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -90,10 +90,22 @@ Return Value:
     LONG Low;
     DOUBLE_PARTS Parts;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_DOUBLE(Value, Value, MATH_ROUND_TOWARD_ZERO);
+    return Value;
+
+#endif
+
     Parts.Double = Value;
     High = Parts.Ulong.High;
     Low = Parts.Ulong.Low;
-    Exponent = (High >> (DOUBLE_EXPONENT_SHIFT - DOUBLE_HIGH_WORD_SHIFT)) -
+    Exponent = ((High & (DOUBLE_EXPONENT_MASK >> DOUBLE_HIGH_WORD_SHIFT)) >>
+                (DOUBLE_EXPONENT_SHIFT - DOUBLE_HIGH_WORD_SHIFT)) -
                DOUBLE_EXPONENT_BIAS;
 
     if (Exponent < 20) {
@@ -89,9 +89,21 @@ Return Value:
     LONG Low;
     FLOAT_PARTS Parts;
 
+    //
+    // Use the SSE4.1 rounding instruction if the build targets it.
+    //
+
+#if defined(MATH_HARDWARE_ROUND)
+
+    MATH_HARDWARE_ROUND_FLOAT(Value, Value, MATH_ROUND_TOWARD_ZERO);
+    return Value;
+
+#endif
+
     Parts.Float = Value;
     Low = Parts.Ulong;
-    Exponent = (Low >> FLOAT_EXPONENT_SHIFT) - FLOAT_EXPONENT_BIAS;
+    Exponent = ((Low & FLOAT_EXPONENT_MASK) >> FLOAT_EXPONENT_SHIFT) -
+               FLOAT_EXPONENT_BIAS;
     if (Exponent < 23) {
 
         //
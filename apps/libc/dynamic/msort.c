@@ -0,0 +1,400 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    msort.c
+
+Abstract:
+
+    This module implements a stable merge sort, used by the mergesort C
+    library function and by the parallel sort.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro gets a pointer to the element at the given index.
+//
+
+#define MERGESORT_ELEMENT(_Base, _ElementSize, _Index) \
+    ((_Base) + ((_ElementSize) * (_Index)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the run length at or below which insertion sort is used instead of
+// splitting and merging further.
+//
+
+#define MERGESORT_INSERTION_THRESHOLD 12
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+ClpMergeSortInsertionSort (
+    PUCHAR Array,
+    PUCHAR Scratch,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+LIBC_API
+int
+mergesort (
+    void *ArrayBase,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts an array of items in place using a merge sort. Unlike
+    qsort, the sort is stable: elements that compare equal keep their original
+    relative order. It needs temporary memory of about half the array size.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items to sort.
+
+    ElementCount - Supplies the number of elements in the array.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to a function that will be used to
+        compare elements. The function takes in two pointers that will point
+        within the array. It returns less than zero if the first element is
+        less than the second, zero if the first element is equal to the second,
+        and greater than zero if the first element is greater than the second.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    PUCHAR Scratch;
+    size_t ScratchCount;
+
+    if ((ElementCount < 2) || (ElementSize == 0)) {
+        return 0;
+    }
+
+    ScratchCount = (ElementCount / 2) + 1;
+    if (ScratchCount > ((size_t)-1) / ElementSize) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    Scratch = malloc(ScratchCount * ElementSize);
+    if (Scratch == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ClpMergeSortRange(ArrayBase,
+                      Scratch,
+                      ElementCount,
+                      ElementSize,
+                      CompareFunction);
+
+    free(Scratch);
+    return 0;
+}
+
+VOID
+ClpMergeSortRange (
+    PUCHAR Array,
+    PUCHAR Scratch,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine stably sorts a range of elements in place.
+
+Arguments:
+
+    Array - Supplies a pointer to the first element of the range.
+
+    Scratch - Supplies a pointer to scratch space with room for at least half
+        the element count plus one elements.
+
+    ElementCount - Supplies the number of elements in the range.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    size_t LeftCount;
+
+    if (ElementCount <= MERGESORT_INSERTION_THRESHOLD) {
+        ClpMergeSortInsertionSort(Array,
+                                  Scratch,
+                                  ElementCount,
+                                  ElementSize,
+                                  CompareFunction);
+
+        return;
+    }
+
+    LeftCount = ElementCount / 2;
+    ClpMergeSortRange(Array,
+                      Scratch,
+                      LeftCount,
+                      ElementSize,
+                      CompareFunction);
+
+    ClpMergeSortRange(MERGESORT_ELEMENT(Array, ElementSize, LeftCount),
+                      Scratch,
+                      ElementCount - LeftCount,
+                      ElementSize,
+                      CompareFunction);
+
+    ClpMergeSortedRuns(Array,
+                       Scratch,
+                       LeftCount,
+                       ElementCount - LeftCount,
+                       ElementSize,
+                       CompareFunction);
+
+    return;
+}
+
+VOID
+ClpMergeSortedRuns (
+    PUCHAR Array,
+    PUCHAR Scratch,
+    size_t LeftCount,
+    size_t RightCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine merges two adjacent sorted runs into one sorted run in
+    place. Elements from the left run win ties, which keeps the sort stable.
+
+Arguments:
+
+    Array - Supplies a pointer to the first element of the left run. The
+        right run immediately follows it.
+
+    Scratch - Supplies a pointer to scratch space with room for at least the
+        left run's elements.
+
+    LeftCount - Supplies the number of elements in the left run.
+
+    RightCount - Supplies the number of elements in the right run.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PUCHAR Destination;
+    PUCHAR Left;
+    PUCHAR LeftEnd;
+    PUCHAR Right;
+    PUCHAR RightEnd;
+
+    if ((LeftCount == 0) || (RightCount == 0)) {
+        return;
+    }
+
+    Right = MERGESORT_ELEMENT(Array, ElementSize, LeftCount);
+
+    //
+    // Skip the merge entirely if the runs are already in order, which makes
+    // sorting presorted input linear.
+    //
+
+    if (CompareFunction(Right - ElementSize, Right) <= 0) {
+        return;
+    }
+
+    //
+    // Move the left run out of the way and merge back into the array. The
+    // right run never gets overwritten before it is consumed, since the
+    // destination can't pass it.
+    //
+
+    memcpy(Scratch, Array, LeftCount * ElementSize);
+    Left = Scratch;
+    LeftEnd = MERGESORT_ELEMENT(Scratch, ElementSize, LeftCount);
+    RightEnd = MERGESORT_ELEMENT(Right, ElementSize, RightCount);
+    Destination = Array;
+    while ((Left < LeftEnd) && (Right < RightEnd)) {
+        if (CompareFunction(Right, Left) < 0) {
+            memcpy(Destination, Right, ElementSize);
+            Right += ElementSize;
+
+        } else {
+            memcpy(Destination, Left, ElementSize);
+            Left += ElementSize;
+        }
+
+        Destination += ElementSize;
+    }
+
+    //
+    // Anything left of the right run is already in place. Copy back whatever
+    // remains of the left run.
+    //
+
+    if (Left < LeftEnd) {
+        memcpy(Destination, Left, LeftEnd - Left);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+ClpMergeSortInsertionSort (
+    PUCHAR Array,
+    PUCHAR Scratch,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine stably sorts a small range of elements using insertion sort.
+
+Arguments:
+
+    Array - Supplies a pointer to the first element of the range.
+
+    Scratch - Supplies a pointer to scratch space with room for at least one
+        element.
+
+    ElementCount - Supplies the number of elements in the range.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PUCHAR Element;
+    size_t Index;
+    size_t InsertIndex;
+
+    for (Index = 1; Index < ElementCount; Index += 1) {
+        Element = MERGESORT_ELEMENT(Array, ElementSize, Index);
+        if (CompareFunction(Element - ElementSize, Element) <= 0) {
+            continue;
+        }
+
+        //
+        // Find the first earlier element that is greater than this one, then
+        // slide everything from there up by one to make room.
+        //
+
+        memcpy(Scratch, Element, ElementSize);
+        InsertIndex = Index - 1;
+        while ((InsertIndex > 0) &&
+               (CompareFunction(
+                       MERGESORT_ELEMENT(Array, ElementSize, InsertIndex - 1),
+                       Scratch) > 0)) {
+
+            InsertIndex -= 1;
+        }
+
+        memmove(MERGESORT_ELEMENT(Array, ElementSize, InsertIndex + 1),
+                MERGESORT_ELEMENT(Array, ElementSize, InsertIndex),
+                (Index - InsertIndex) * ElementSize);
+
+        memcpy(MERGESORT_ELEMENT(Array, ElementSize, InsertIndex),
+               Scratch,
+               ElementSize);
+    }
+
+    return;
+}
+
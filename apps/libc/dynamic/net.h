@@ -36,6 +36,13 @@ Module Name:
 
 #define DNS_PORT_NUMBER 53
 
+//
+// Define the name of an environment variable to use as a DNS server address,
+// overriding the configuration.
+//
+
+#define DNS_DNSCACHEIP_VARIABLE "DNSCACHEIP"
+
 //
 // Define DNS request/response flags. These flags code a 16-bit field assuming
 // a little endian machine.
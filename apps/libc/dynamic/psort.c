@@ -0,0 +1,373 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    psort.c
+
+Abstract:
+
+    This module implements a stable sort that spreads the work for large
+    arrays across multiple threads.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the maximum number of threads a single sort will use. This must be a
+// power of two.
+//
+
+#define PSORT_MAX_THREADS 16
+
+//
+// Define the minimum number of elements each thread should get. Below this,
+// the cost of creating threads outweighs sorting in parallel.
+//
+
+#define PSORT_MINIMUM_ELEMENTS_PER_THREAD 8192
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores one unit of parallel sort work: either sorting a
+    chunk of the array or merging two adjacent sorted chunks.
+
+Members:
+
+    Array - Stores a pointer to the first element to work on.
+
+    Scratch - Stores a pointer to the scratch space reserved for this job.
+
+    LeftCount - Stores the number of elements to sort, or the number of
+        elements in the left run if this is a merge.
+
+    RightCount - Stores the number of elements in the right run if this is a
+        merge, or zero if this is a sort.
+
+    ElementSize - Stores the size of one element.
+
+    CompareFunction - Stores a pointer to the element comparison function.
+
+--*/
+
+typedef struct _PSORT_JOB {
+    PUCHAR Array;
+    PUCHAR Scratch;
+    size_t LeftCount;
+    size_t RightCount;
+    size_t ElementSize;
+    int (*CompareFunction)(const void *, const void *);
+} PSORT_JOB, *PPSORT_JOB;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+ClpRunParallelSortJobs (
+    PPSORT_JOB Jobs,
+    ULONG JobCount
+    );
+
+void *
+ClpParallelSortThread (
+    void *Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+LIBC_API
+int
+psort (
+    void *ArrayBase,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts an array of items in place. The sort is stable, like
+    mergesort. If the array is large and more than one processor is online,
+    the array is split into chunks that are sorted and then merged on
+    separate threads, so the compare function must be safe to call from
+    several threads at once.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items to sort.
+
+    ElementCount - Supplies the number of elements in the array.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to a function that will be used to
+        compare elements. The function takes in two pointers that will point
+        within the array. It returns less than zero if the first element is
+        less than the second, zero if the first element is equal to the second,
+        and greater than zero if the first element is greater than the second.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    ULONG ChunkCount;
+    size_t ChunkStart[PSORT_MAX_THREADS + 1];
+    ULONG Index;
+    PSORT_JOB Jobs[PSORT_MAX_THREADS];
+    ULONG JobCount;
+    size_t Offset;
+    long ProcessorCount;
+    PUCHAR Scratch;
+    ULONG Width;
+
+    if ((ElementCount < 2) || (ElementSize == 0)) {
+        return 0;
+    }
+
+    //
+    // Use a power of two number of chunks, no more than there are processors,
+    // and only as many as keep each chunk reasonably large.
+    //
+
+    ProcessorCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ProcessorCount < 1) {
+        ProcessorCount = 1;
+    }
+
+    ChunkCount = 1;
+    while ((ChunkCount * 2 <= PSORT_MAX_THREADS) &&
+           (ChunkCount * 2 <= ProcessorCount) &&
+           (ElementCount / (ChunkCount * 2) >=
+            PSORT_MINIMUM_ELEMENTS_PER_THREAD)) {
+
+        ChunkCount *= 2;
+    }
+
+    if (ChunkCount == 1) {
+        return mergesort(ArrayBase,
+                         ElementCount,
+                         ElementSize,
+                         CompareFunction);
+    }
+
+    if (ElementCount > ((size_t)-1) / ElementSize) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    Scratch = malloc(ElementCount * ElementSize);
+    if (Scratch == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (Index = 0; Index < ChunkCount; Index += 1) {
+        ChunkStart[Index] = (ElementCount / ChunkCount) * Index;
+    }
+
+    ChunkStart[ChunkCount] = ElementCount;
+
+    //
+    // Sort each chunk independently. Each job uses the scratch space that
+    // lines up with its own chunk, so the jobs never collide.
+    //
+
+    for (Index = 0; Index < ChunkCount; Index += 1) {
+        Offset = ChunkStart[Index] * ElementSize;
+        Jobs[Index].Array = (PUCHAR)ArrayBase + Offset;
+        Jobs[Index].Scratch = Scratch + Offset;
+        Jobs[Index].LeftCount = ChunkStart[Index + 1] - ChunkStart[Index];
+        Jobs[Index].RightCount = 0;
+        Jobs[Index].ElementSize = ElementSize;
+        Jobs[Index].CompareFunction = CompareFunction;
+    }
+
+    ClpRunParallelSortJobs(Jobs, ChunkCount);
+
+    //
+    // Merge neighboring runs pairwise, halving the number of runs each round
+    // until one sorted run covers the whole array.
+    //
+
+    for (Width = 1; Width < ChunkCount; Width *= 2) {
+        JobCount = 0;
+        for (Index = 0; Index < ChunkCount; Index += Width * 2) {
+            Offset = ChunkStart[Index] * ElementSize;
+            Jobs[JobCount].Array = (PUCHAR)ArrayBase + Offset;
+            Jobs[JobCount].Scratch = Scratch + Offset;
+            Jobs[JobCount].LeftCount = ChunkStart[Index + Width] -
+                                       ChunkStart[Index];
+
+            Jobs[JobCount].RightCount = ChunkStart[Index + (Width * 2)] -
+                                        ChunkStart[Index + Width];
+
+            Jobs[JobCount].ElementSize = ElementSize;
+            Jobs[JobCount].CompareFunction = CompareFunction;
+            JobCount += 1;
+        }
+
+        ClpRunParallelSortJobs(Jobs, JobCount);
+    }
+
+    free(Scratch);
+    return 0;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+ClpRunParallelSortJobs (
+    PPSORT_JOB Jobs,
+    ULONG JobCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a set of independent sort jobs to completion. The first
+    job runs on the calling thread and the rest each get their own thread. If
+    a thread can't be created, its job runs on the calling thread instead.
+
+Arguments:
+
+    Jobs - Supplies a pointer to the array of jobs to run.
+
+    JobCount - Supplies the number of jobs in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    int Status;
+    BOOL ThreadCreated[PSORT_MAX_THREADS];
+    pthread_t Threads[PSORT_MAX_THREADS];
+
+    assert(JobCount <= PSORT_MAX_THREADS);
+
+    for (Index = 1; Index < JobCount; Index += 1) {
+        ThreadCreated[Index] = FALSE;
+        Status = pthread_create(&(Threads[Index]),
+                                NULL,
+                                ClpParallelSortThread,
+                                &(Jobs[Index]));
+
+        if (Status == 0) {
+            ThreadCreated[Index] = TRUE;
+        }
+    }
+
+    ClpParallelSortThread(&(Jobs[0]));
+    for (Index = 1; Index < JobCount; Index += 1) {
+        if (ThreadCreated[Index] != FALSE) {
+            pthread_join(Threads[Index], NULL);
+
+        } else {
+            ClpParallelSortThread(&(Jobs[Index]));
+        }
+    }
+
+    return;
+}
+
+void *
+ClpParallelSortThread (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs one parallel sort job.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the job to perform.
+
+Return Value:
+
+    NULL always.
+
+--*/
+
+{
+
+    PPSORT_JOB Job;
+
+    Job = Parameter;
+    if (Job->RightCount == 0) {
+        ClpMergeSortRange(Job->Array,
+                          Job->Scratch,
+                          Job->LeftCount,
+                          Job->ElementSize,
+                          Job->CompareFunction);
+
+    } else {
+        ClpMergeSortedRuns(Job->Array,
+                           Job->Scratch,
+                           Job->LeftCount,
+                           Job->RightCount,
+                           Job->ElementSize,
+                           Job->CompareFunction);
+    }
+
+    return NULL;
+}
+
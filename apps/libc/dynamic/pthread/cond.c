@@ -104,6 +104,7 @@ Return Value:
     PPTHREAD_CONDITION ConditionInternal;
 
     ConditionInternal = (PPTHREAD_CONDITION)Condition;
+    ConditionInternal->RequeueAddress = NULL;
     if (Attribute == NULL) {
         ConditionInternal->State = 0;
         return 0;
@@ -578,7 +579,9 @@ Return Value:
 
 {
 
+    KSTATUS KernelStatus;
     ULONG Operation;
+    PULONG RequeueAddress;
     ULONG ThreadCount;
 
     //
@@ -587,12 +590,32 @@ Return Value:
     //
 
     RtlAtomicAdd32(&(Condition->State), 1 << PTHREAD_CONDITION_COUNTER_SHIFT);
-    ThreadCount = Count;
     Operation = UserLockWake;
     if ((Condition->State & PTHREAD_CONDITION_SHARED) == 0) {
         Operation |= USER_LOCK_PRIVATE;
+
+        //
+        // For a broadcast, wake only one thread and move the rest over to
+        // wait on the mutex directly. They would all just pile up on the
+        // mutex anyway, and this way they get woken one at a time as it is
+        // released. If the kernel won't do it, fall back to waking everyone.
+        //
+
+        RequeueAddress = Condition->RequeueAddress;
+        if ((Count == MAX_ULONG) && (RequeueAddress != NULL)) {
+            ThreadCount = 1;
+            KernelStatus = OsUserLockRequeue(&(Condition->State),
+                                             USER_LOCK_PRIVATE,
+                                             &ThreadCount,
+                                             RequeueAddress);
+
+            if (KSUCCESS(KernelStatus)) {
+                return 0;
+            }
+        }
     }
 
+    ThreadCount = Count;
     OsUserLock(&(Condition->State), Operation, &ThreadCount, 0);
     return 0;
 }
@@ -650,6 +673,15 @@ Return Value:
 
     OldState = Condition->State;
 
+    //
+    // Let broadcasts know which mutex waiters can be moved over to. This is
+    // done with the mutex held, so all waiters agree on it.
+    //
+
+    if ((OldState & PTHREAD_CONDITION_SHARED) == 0) {
+        Condition->RequeueAddress = ClpGetMutexRequeueAddress(Mutex);
+    }
+
     //
     // Unlock the mutex and perform the wait.
     //
@@ -690,7 +722,7 @@ Return Value:
 
     } while (KernelStatus == STATUS_INTERRUPTED);
 
-    pthread_mutex_lock(Mutex);
+    ClpAcquireMutexAfterConditionWait(Mutex);
     if (KernelStatus == STATUS_TIMEOUT) {
         return ETIMEDOUT;
     }
@@ -49,6 +49,34 @@ Module Name:
 #define PTHREAD_MUTEX_STATE_ERRORCHECK 0x80000000
 #define PTHREAD_MUTEX_STATE_TYPE_MASK 0xC0000000
 
+//
+// Define the bounds on the number of times a contended acquire polls the
+// mutex before going to sleep in the kernel. The actual count adapts between
+// these based on how long previous acquires of the mutex had to wait.
+//
+
+#define PTHREAD_MUTEX_SPIN_MINIMUM 10
+#define PTHREAD_MUTEX_SPIN_MAXIMUM 100
+
+//
+// Define a hint to the processor that it is in a spin loop. This also acts as
+// a compiler barrier so the mutex state gets reloaded on each pass.
+//
+
+#if defined(__i386) || defined(__amd64)
+
+#define PTHREAD_MUTEX_SPIN_PAUSE() __asm__ __volatile__ ("pause" ::: "memory")
+
+#elif defined(__ARM_ARCH_7A__)
+
+#define PTHREAD_MUTEX_SPIN_PAUSE() __asm__ __volatile__ ("yield" ::: "memory")
+
+#else
+
+#define PTHREAD_MUTEX_SPIN_PAUSE() __asm__ __volatile__ ("" ::: "memory")
+
+#endif
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -72,12 +100,25 @@ ClpAcquireNormalMutex (
     INT Clock
     );
 
+int
+ClpWaitForNormalMutex (
+    PPTHREAD_MUTEX Mutex,
+    ULONG Shared,
+    const struct timespec *AbsoluteTimeout,
+    INT Clock
+    );
+
 int
 ClpTryToAcquireNormalMutex (
     PPTHREAD_MUTEX Mutex,
     ULONG Shared
     );
 
+BOOL
+ClpSpinOnMutex (
+    PPTHREAD_MUTEX Mutex
+    );
+
 VOID
 ClpReleaseNormalMutex (
     PPTHREAD_MUTEX Mutex,
@@ -782,6 +823,84 @@ Return Value:
     return Result;
 }
 
+PULONG
+ClpGetMutexRequeueAddress (
+    pthread_mutex_t *Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the address condition variable waiters can be moved
+    to in order to wait on the given mutex, if the mutex supports it. Only
+    normal mutexes private to the process support having waiters requeued onto
+    them.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex.
+
+Return Value:
+
+    Returns a pointer to the mutex lock value to requeue waiters onto.
+
+    NULL if the mutex does not support requeuing waiters.
+
+--*/
+
+{
+
+    PPTHREAD_MUTEX MutexInternal;
+
+    MutexInternal = (PPTHREAD_MUTEX)Mutex;
+    if ((MutexInternal->State &
+         (PTHREAD_MUTEX_STATE_TYPE_MASK | PTHREAD_MUTEX_STATE_SHARED)) != 0) {
+
+        return NULL;
+    }
+
+    return &(MutexInternal->State);
+}
+
+int
+ClpAcquireMutexAfterConditionWait (
+    pthread_mutex_t *Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reacquires a mutex after a condition variable wait. If the
+    mutex supports requeuing, it is acquired in the contended state, since
+    other waiters may have been moved over to wait on it without marking it
+    contended themselves. This ensures the release wakes the next one.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PPTHREAD_MUTEX MutexInternal;
+
+    MutexInternal = (PPTHREAD_MUTEX)Mutex;
+    if (ClpGetMutexRequeueAddress(Mutex) == NULL) {
+        return pthread_mutex_lock(Mutex);
+    }
+
+    return ClpWaitForNormalMutex(MutexInternal, 0, NULL, 0);
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -877,6 +996,22 @@ Return Value:
         }
     }
 
+    //
+    // Spin for a bit in case the owner is about to release it, and take
+    // another uncontended stab at it if it frees up.
+    //
+
+    if (ClpSpinOnMutex(Mutex) != FALSE) {
+        OldState = RtlAtomicCompareExchange32(&(Mutex->State),
+                                              Locked,
+                                              Unlocked);
+
+        if (OldState == Unlocked) {
+            Mutex->Owner = ThreadId;
+            return 0;
+        }
+    }
+
     //
     // Contend for the mutex.
     //
@@ -1006,13 +1141,6 @@ Return Value:
 
 {
 
-    KSTATUS KernelStatus;
-    ULONG LockedWithWaiters;
-    ULONG OldState;
-    ULONG Operation;
-    ULONG TimeoutInMilliseconds;
-    ULONG Unlocked;
-
     //
     // Give it a quick fast attempt first.
     //
@@ -1021,12 +1149,69 @@ Return Value:
         return 0;
     }
 
+    //
+    // Spin for a bit in case the owner is about to release it, since that's
+    // much cheaper than a round trip through the kernel.
+    //
+
+    if ((ClpSpinOnMutex(Mutex) != FALSE) &&
+        (ClpTryToAcquireNormalMutex(Mutex, Shared) == 0)) {
+
+        return 0;
+    }
+
+    return ClpWaitForNormalMutex(Mutex, Shared, AbsoluteTimeout, Clock);
+}
+
+int
+ClpWaitForNormalMutex (
+    PPTHREAD_MUTEX Mutex,
+    ULONG Shared,
+    const struct timespec *AbsoluteTimeout,
+    INT Clock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires a normal mutex by marking it as contended and
+    sleeping until it is released.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+    Shared - Supplies the shared flag for the mutex.
+
+    AbsoluteTimeout - Supplies an optional pointer to the absolute timeout for
+        the operation.
+
+    Clock - Supplies the clock source.
+
+Return Value:
+
+    0 if the lock was acquired.
+
+    Returns an error code on failure or timeout.
+
+--*/
+
+{
+
+    KSTATUS KernelStatus;
+    ULONG LockedWithWaiters;
+    ULONG OldState;
+    ULONG Operation;
+    ULONG TimeoutInMilliseconds;
+    ULONG Unlocked;
+
     LockedWithWaiters = Shared | PTHREAD_MUTEX_STATE_LOCKED_WITH_WAITERS;
     Unlocked = Shared | PTHREAD_MUTEX_STATE_UNLOCKED;
 
     //
-    // Set the lock to acquired with waiters (since the quick attempt above
-    // failed).
+    // Set the lock to acquired with waiters, since the caller has already
+    // found it contended.
     //
 
     while (TRUE) {
@@ -1120,6 +1305,71 @@ Return Value:
     return EBUSY;
 }
 
+BOOL
+ClpSpinOnMutex (
+    PPTHREAD_MUTEX Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine polls a contended mutex for a bounded amount of time, waiting
+    for it to be released. The spin length adapts to how long recent acquires
+    have had to wait, so mutexes that are held briefly get handed off without
+    a system call, while mutexes held for long periods quickly stop wasting
+    processor time.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to spin on.
+
+Return Value:
+
+    TRUE if the mutex was seen unlocked before the spin ran out. The caller
+    still needs to actually acquire it.
+
+    FALSE if the mutex was still held after spinning.
+
+--*/
+
+{
+
+    LONG Estimate;
+    ULONG SpinCount;
+    ULONG SpinIndex;
+
+    Estimate = Mutex->SpinEstimate;
+    SpinCount = (Estimate * 2) + PTHREAD_MUTEX_SPIN_MINIMUM;
+    if (SpinCount > PTHREAD_MUTEX_SPIN_MAXIMUM) {
+        SpinCount = PTHREAD_MUTEX_SPIN_MAXIMUM;
+    }
+
+    for (SpinIndex = 0; SpinIndex < SpinCount; SpinIndex += 1) {
+        PTHREAD_MUTEX_SPIN_PAUSE();
+        if ((Mutex->State & PTHREAD_MUTEX_STATE_MASK) ==
+            PTHREAD_MUTEX_STATE_UNLOCKED) {
+
+            //
+            // Nudge the estimate towards how long this spin took. Updates
+            // from other threads may be lost, which is fine for a heuristic.
+            //
+
+            Mutex->SpinEstimate = Estimate +
+                                  (((LONG)SpinIndex - Estimate) / 8);
+
+            return TRUE;
+        }
+    }
+
+    //
+    // Spinning didn't pay off, so spin less next time.
+    //
+
+    Mutex->SpinEstimate = Estimate - (Estimate / 8);
+    return FALSE;
+}
+
 VOID
 ClpReleaseNormalMutex (
     PPTHREAD_MUTEX Mutex,
@@ -241,10 +241,11 @@ Return Value:
 
     //
     // Force the main thread to get with the program in case this is the first
-    // thread created.
+    // thread created. Stream locks also stop being elided from here on.
     //
 
     pthread_self();
+    ClpEnableStreamLocking();
     pthread_mutex_lock(&(NewThread->StartMutex));
 
     //
@@ -108,6 +108,9 @@ Structure Description:
 
     State - Stores the state of the mutex.
 
+    SpinEstimate - Stores a running estimate of how long contended acquires
+        need to spin before the mutex frees up.
+
     Owner - Stores the owner of the mutex, used when the recursive
         implementation is set.
 
@@ -115,6 +118,7 @@ Structure Description:
 
 typedef struct _PTHREAD_MUTEX {
     ULONG State;
+    ULONG SpinEstimate;
     UINTN Owner;
 } PTHREAD_MUTEX, *PPTHREAD_MUTEX;
 
@@ -144,10 +148,16 @@ Structure Description:
 
     State - Stores the state of the condition variable.
 
+    RequeueAddress - Stores the address of the lock value of the mutex most
+        recently used to wait on the condition, if broadcasts can move waiters
+        directly over to wait on that mutex. This is NULL if waiters must all
+        be woken instead.
+
 --*/
 
 typedef struct _PTHREAD_CONDITION {
     ULONG State;
+    PULONG RequeueAddress;
 } PTHREAD_CONDITION, *PPTHREAD_CONDITION;
 
 /*++
@@ -447,6 +457,58 @@ Return Value:
 
 --*/
 
+PULONG
+ClpGetMutexRequeueAddress (
+    pthread_mutex_t *Mutex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the address condition variable waiters can be moved
+    to in order to wait on the given mutex, if the mutex supports it. Only
+    normal mutexes private to the process support having waiters requeued onto
+    them.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex.
+
+Return Value:
+
+    Returns a pointer to the mutex lock value to requeue waiters onto.
+
+    NULL if the mutex does not support requeuing waiters.
+
+--*/
+
+int
+ClpAcquireMutexAfterConditionWait (
+    pthread_mutex_t *Mutex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reacquires a mutex after a condition variable wait. If the
+    mutex supports requeuing, it is acquired in the contended state, since
+    other waiters may have been moved over to wait on it without marking it
+    contended themselves. This ensures the release wakes the next one.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
 ULONG
 ClpConvertAbsoluteTimespecToRelativeMilliseconds (
     const struct timespec *AbsoluteTime,
@@ -13,7 +13,10 @@ Module Name:
 
 Abstract:
 
-    This module implements the QuickSort standard C library function.
+    This module implements the QuickSort standard C library function. The
+    sort is an introsort: a median-of-three quicksort that finishes small
+    partitions with insertion sort and falls back to heapsort if the
+    partitioning goes badly enough to threaten quadratic time.
 
 Author:
 
@@ -46,9 +49,18 @@ Module Name:
     (*((void **)((_Base) + ((_ElementSize) * (_Index)))))
 
 //
-// This macro either performs an exchange directly for pointer sized elements,
-// or calls the bytewise swap function to exchange byte for byte. It assumes
-// the presence of a void pointer local called SwapPointer.
+// This macro is a helper to the quicksort swap macro. It gets a pointer to a
+// 32-bit integer at the given index.
+//
+
+#define QUICKSORT_ELEMENT32(_Base, _ElementSize, _Index) \
+    (*((ULONG *)((_Base) + ((_ElementSize) * (_Index)))))
+
+//
+// This macro either performs an exchange directly for pointer sized or 32-bit
+// elements, or calls the swap function to exchange the elements a word or
+// byte at a time. It assumes the presence of a void pointer local called
+// SwapPointer.
 //
 
 #define QUICKSORT_SWAP(_Base, _ElementSize, _FirstIndex, _SecondIndex)         \
@@ -60,6 +72,15 @@ Module Name:
                                                                                \
             QUICKSORT_ELEMENT(_Base, _ElementSize, _SecondIndex) =             \
                                                                   SwapPointer; \
+        } else if ((_ElementSize) == sizeof(ULONG)) {                          \
+            SwapPointer = (void *)(UINTN)                                      \
+                      QUICKSORT_ELEMENT32(_Base, _ElementSize, _FirstIndex);   \
+                                                                               \
+            QUICKSORT_ELEMENT32(_Base, _ElementSize, _FirstIndex) =            \
+                      QUICKSORT_ELEMENT32(_Base, _ElementSize, _SecondIndex);  \
+                                                                               \
+            QUICKSORT_ELEMENT32(_Base, _ElementSize, _SecondIndex) =           \
+                                                  (ULONG)(UINTN)SwapPointer;   \
         } else {                                                               \
             ClpQuickSortSwap((_Base),                                          \
                              (_ElementSize),                                   \
@@ -68,10 +89,32 @@ Module Name:
         }                                                                      \
     }
 
+//
+// This macro compares two elements by index.
+//
+
+#define QUICKSORT_COMPARE(_Base, _ElementSize, _Compare, _Left, _Right) \
+    (_Compare)((_Base) + ((_ElementSize) * (_Left)),                    \
+               (_Base) + ((_ElementSize) * (_Right)))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the partition size at or below which insertion sort is used instead
+// of partitioning further.
+//
+
+#define QUICKSORT_INSERTION_THRESHOLD 12
+
+//
+// Define the partition size at or above which the pivot is chosen as the
+// median of three medians rather than the median of three elements.
+//
+
+#define QUICKSORT_NINTHER_THRESHOLD 40
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -82,6 +125,35 @@ Module Name:
 
 VOID
 ClpQuickSort (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t EndIndex,
+    int (*CompareFunction)(const void *, const void *),
+    ULONG DepthLimit
+    );
+
+VOID
+ClpQuickSortSelectPivot (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t EndIndex,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+ssize_t
+ClpQuickSortMedianOfThree (
+    void *ArrayBase,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *),
+    ssize_t FirstIndex,
+    ssize_t SecondIndex,
+    ssize_t ThirdIndex
+    );
+
+VOID
+ClpInsertionSort (
     void *ArrayBase,
     size_t ElementSize,
     ssize_t StartIndex,
@@ -89,6 +161,25 @@ ClpQuickSort (
     int (*CompareFunction)(const void *, const void *)
     );
 
+VOID
+ClpHeapSort (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t EndIndex,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+VOID
+ClpHeapSortSiftDown (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t RootIndex,
+    ssize_t Count,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
 VOID
 ClpQuickSortSwap (
     void *ArrayBase,
@@ -145,15 +236,32 @@ Return Value:
 
 {
 
+    ULONG DepthLimit;
+    size_t Remaining;
+
     assert(ElementCount < (((size_t)-1) >> 1));
     assert(ElementSize < (((size_t)-1) >> 1));
 
     if (ElementCount > 1) {
+
+        //
+        // Allow twice the recursion depth a perfectly balanced quicksort
+        // would need before switching to heapsort.
+        //
+
+        DepthLimit = 0;
+        Remaining = ElementCount;
+        while (Remaining > 1) {
+            DepthLimit += 2;
+            Remaining >>= 1;
+        }
+
         ClpQuickSort(ArrayBase,
                      ElementSize,
                      0,
                      ElementCount - 1,
-                     CompareFunction);
+                     CompareFunction,
+                     DepthLimit);
     }
 
     return;
@@ -169,7 +277,8 @@ ClpQuickSort (
     size_t ElementSize,
     ssize_t StartIndex,
     ssize_t EndIndex,
-    int (*CompareFunction)(const void *, const void *)
+    int (*CompareFunction)(const void *, const void *),
+    ULONG DepthLimit
     )
 
 /*++
@@ -177,6 +286,10 @@ ClpQuickSort (
 Routine Description:
 
     This routine sorts an array of items in place using the QuickSort algorithm.
+    It partitions around a median-of-three pivot, recursing on the smaller
+    partition and looping on the larger one so the stack depth stays
+    logarithmic. Small partitions are insertion sorted, and if the depth
+    limit runs out the remainder is heap sorted.
 
 Arguments:
 
@@ -197,6 +310,9 @@ Routine Description:
         The routine must not modify the array itself or inconsistently
         report comparisons, otherwise the sorting will not come out correctly.
 
+    DepthLimit - Supplies the number of further partitioning steps allowed
+        before falling back to heapsort.
+
 Return Value:
 
     None.
@@ -214,10 +330,45 @@ Return Value:
     ssize_t SmallestIndex;
     void *SwapPointer;
 
+RestartPartition:
     if (EndIndex <= StartIndex) {
         return;
     }
 
+    if (EndIndex - StartIndex < QUICKSORT_INSERTION_THRESHOLD) {
+        ClpInsertionSort(ArrayBase,
+                         ElementSize,
+                         StartIndex,
+                         EndIndex,
+                         CompareFunction);
+
+        return;
+    }
+
+    if (DepthLimit == 0) {
+        ClpHeapSort(ArrayBase,
+                    ElementSize,
+                    StartIndex,
+                    EndIndex,
+                    CompareFunction);
+
+        return;
+    }
+
+    DepthLimit -= 1;
+
+    //
+    // Move the median of the first, middle, and last elements to the end,
+    // where the partitioning loop expects the pivot. This keeps sorted and
+    // reverse sorted input from degrading to quadratic time.
+    //
+
+    ClpQuickSortSelectPivot(ArrayBase,
+                            ElementSize,
+                            StartIndex,
+                            EndIndex,
+                            CompareFunction);
+
     LastElement = ArrayBase + (EndIndex * ElementSize);
     SmallerIndex = StartIndex - 1;
     SmallestIndex = StartIndex - 1;
@@ -359,23 +510,428 @@ Return Value:
     }
 
     //
-    // Sort the bottom half and then the top half.
+    // Recurse on the smaller half, and go around again for the larger half.
     //
 
-    if (SmallerIndex > StartIndex) {
-        ClpQuickSort(ArrayBase,
-                     ElementSize,
-                     StartIndex,
-                     SmallerIndex,
-                     CompareFunction);
+    if ((SmallerIndex - StartIndex) < (EndIndex - LargerIndex)) {
+        if (SmallerIndex > StartIndex) {
+            ClpQuickSort(ArrayBase,
+                         ElementSize,
+                         StartIndex,
+                         SmallerIndex,
+                         CompareFunction,
+                         DepthLimit);
+        }
+
+        StartIndex = LargerIndex;
+
+    } else {
+        if (EndIndex > LargerIndex) {
+            ClpQuickSort(ArrayBase,
+                         ElementSize,
+                         LargerIndex,
+                         EndIndex,
+                         CompareFunction,
+                         DepthLimit);
+        }
+
+        EndIndex = SmallerIndex;
     }
 
-    if (EndIndex > LargerIndex) {
-        ClpQuickSort(ArrayBase,
-                     ElementSize,
-                     LargerIndex,
-                     EndIndex,
-                     CompareFunction);
+    goto RestartPartition;
+}
+
+VOID
+ClpQuickSortSelectPivot (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t EndIndex,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves the median of the first, middle, and last elements of
+    the given range into the last slot, where it is used as the pivot. Larger
+    ranges use the median of three such medians, taken from evenly spaced
+    samples, which holds up better against input that is already partially
+    ordered.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    StartIndex - Supplies the starting index of the range, inclusive.
+
+    EndIndex - Supplies the ending index of the range, inclusive.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ssize_t FirstIndex;
+    ssize_t LastIndex;
+    ssize_t MedianIndex;
+    ssize_t MiddleIndex;
+    ssize_t Step;
+    void *SwapPointer;
+
+    FirstIndex = StartIndex;
+    LastIndex = EndIndex;
+    MiddleIndex = StartIndex + ((EndIndex - StartIndex) / 2);
+    if (EndIndex - StartIndex >= QUICKSORT_NINTHER_THRESHOLD) {
+        Step = (EndIndex - StartIndex) / 8;
+        FirstIndex = ClpQuickSortMedianOfThree(ArrayBase,
+                                               ElementSize,
+                                               CompareFunction,
+                                               StartIndex,
+                                               StartIndex + Step,
+                                               StartIndex + (Step * 2));
+
+        MiddleIndex = ClpQuickSortMedianOfThree(ArrayBase,
+                                                ElementSize,
+                                                CompareFunction,
+                                                MiddleIndex - Step,
+                                                MiddleIndex,
+                                                MiddleIndex + Step);
+
+        LastIndex = ClpQuickSortMedianOfThree(ArrayBase,
+                                              ElementSize,
+                                              CompareFunction,
+                                              EndIndex - (Step * 2),
+                                              EndIndex - Step,
+                                              EndIndex);
+    }
+
+    MedianIndex = ClpQuickSortMedianOfThree(ArrayBase,
+                                            ElementSize,
+                                            CompareFunction,
+                                            FirstIndex,
+                                            MiddleIndex,
+                                            LastIndex);
+
+    if (MedianIndex != EndIndex) {
+        QUICKSORT_SWAP(ArrayBase, ElementSize, MedianIndex, EndIndex);
+    }
+
+    return;
+}
+
+ssize_t
+ClpQuickSortMedianOfThree (
+    void *ArrayBase,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *),
+    ssize_t FirstIndex,
+    ssize_t SecondIndex,
+    ssize_t ThirdIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the index of the median of three elements.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+    FirstIndex - Supplies the index of the first element.
+
+    SecondIndex - Supplies the index of the second element.
+
+    ThirdIndex - Supplies the index of the third element.
+
+Return Value:
+
+    Returns the index of whichever element is the median.
+
+--*/
+
+{
+
+    if (QUICKSORT_COMPARE(ArrayBase,
+                          ElementSize,
+                          CompareFunction,
+                          FirstIndex,
+                          SecondIndex) < 0) {
+
+        //
+        // First < Second. The median is the second unless the third is
+        // smaller than it, in which case it is the larger of the first and
+        // the third.
+        //
+
+        if (QUICKSORT_COMPARE(ArrayBase,
+                              ElementSize,
+                              CompareFunction,
+                              ThirdIndex,
+                              SecondIndex) >= 0) {
+
+            return SecondIndex;
+        }
+
+        if (QUICKSORT_COMPARE(ArrayBase,
+                              ElementSize,
+                              CompareFunction,
+                              ThirdIndex,
+                              FirstIndex) < 0) {
+
+            return FirstIndex;
+        }
+
+        return ThirdIndex;
+    }
+
+    //
+    // Second <= First. The median is the first unless the third is smaller
+    // than it, in which case it is the larger of the second and the third.
+    //
+
+    if (QUICKSORT_COMPARE(ArrayBase,
+                          ElementSize,
+                          CompareFunction,
+                          ThirdIndex,
+                          FirstIndex) >= 0) {
+
+        return FirstIndex;
+    }
+
+    if (QUICKSORT_COMPARE(ArrayBase,
+                          ElementSize,
+                          CompareFunction,
+                          ThirdIndex,
+                          SecondIndex) < 0) {
+
+        return SecondIndex;
+    }
+
+    return ThirdIndex;
+}
+
+VOID
+ClpInsertionSort (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t EndIndex,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts a small range of the array in place using insertion
+    sort, which beats partitioning for a handful of elements.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    StartIndex - Supplies the starting index of the range, inclusive.
+
+    EndIndex - Supplies the ending index of the range, inclusive.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ssize_t Index;
+    ssize_t InsertIndex;
+    void *SwapPointer;
+
+    for (Index = StartIndex + 1; Index <= EndIndex; Index += 1) {
+        InsertIndex = Index;
+        while ((InsertIndex > StartIndex) &&
+               (QUICKSORT_COMPARE(ArrayBase,
+                                  ElementSize,
+                                  CompareFunction,
+                                  InsertIndex - 1,
+                                  InsertIndex) > 0)) {
+
+            QUICKSORT_SWAP(ArrayBase,
+                           ElementSize,
+                           InsertIndex - 1,
+                           InsertIndex);
+
+            InsertIndex -= 1;
+        }
+    }
+
+    return;
+}
+
+VOID
+ClpHeapSort (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t EndIndex,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts a range of the array in place using heapsort. It is
+    the fallback when quicksort partitioning has gone too deep, and
+    guarantees O(N log N) time for the range.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    StartIndex - Supplies the starting index of the range, inclusive.
+
+    EndIndex - Supplies the ending index of the range, inclusive.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ssize_t Count;
+    ssize_t Index;
+    void *SwapPointer;
+
+    //
+    // Build a max heap out of the range, then repeatedly move the largest
+    // element to the end and restore the heap over what remains.
+    //
+
+    Count = EndIndex - StartIndex + 1;
+    for (Index = (Count / 2) - 1; Index >= 0; Index -= 1) {
+        ClpHeapSortSiftDown(ArrayBase,
+                            ElementSize,
+                            StartIndex,
+                            Index,
+                            Count,
+                            CompareFunction);
+    }
+
+    for (Index = Count - 1; Index > 0; Index -= 1) {
+        QUICKSORT_SWAP(ArrayBase, ElementSize, StartIndex, StartIndex + Index);
+        ClpHeapSortSiftDown(ArrayBase,
+                            ElementSize,
+                            StartIndex,
+                            0,
+                            Index,
+                            CompareFunction);
+    }
+
+    return;
+}
+
+VOID
+ClpHeapSortSiftDown (
+    void *ArrayBase,
+    size_t ElementSize,
+    ssize_t StartIndex,
+    ssize_t RootIndex,
+    ssize_t Count,
+    int (*CompareFunction)(const void *, const void *)
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves an element down the heap until both its children are
+    no larger than it.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    StartIndex - Supplies the array index where the heap begins.
+
+    RootIndex - Supplies the heap relative index of the element to sift down.
+
+    Count - Supplies the number of elements in the heap.
+
+    CompareFunction - Supplies a pointer to the element comparison function.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ssize_t ChildIndex;
+    void *SwapPointer;
+
+    while (TRUE) {
+        ChildIndex = (RootIndex * 2) + 1;
+        if (ChildIndex >= Count) {
+            break;
+        }
+
+        //
+        // Pick the larger of the two children.
+        //
+
+        if ((ChildIndex + 1 < Count) &&
+            (QUICKSORT_COMPARE(ArrayBase,
+                               ElementSize,
+                               CompareFunction,
+                               StartIndex + ChildIndex,
+                               StartIndex + ChildIndex + 1) < 0)) {
+
+            ChildIndex += 1;
+        }
+
+        if (QUICKSORT_COMPARE(ArrayBase,
+                              ElementSize,
+                              CompareFunction,
+                              StartIndex + RootIndex,
+                              StartIndex + ChildIndex) >= 0) {
+
+            break;
+        }
+
+        QUICKSORT_SWAP(ArrayBase,
+                       ElementSize,
+                       StartIndex + RootIndex,
+                       StartIndex + ChildIndex);
+
+        RootIndex = ChildIndex;
     }
 
     return;
@@ -416,15 +972,41 @@ Return Value:
 
     ssize_t ByteIndex;
     unsigned char *FirstElement;
+    UINTN *FirstWord;
     unsigned char *SecondElement;
+    UINTN *SecondWord;
     unsigned char Swap;
+    UINTN SwapWord;
 
     FirstElement = (unsigned char *)ArrayBase + (ElementSize * FirstIndex);
     SecondElement = (unsigned char *)ArrayBase + (ElementSize * SecondIndex);
-    for (ByteIndex = 0; ByteIndex < ElementSize; ByteIndex += 1) {
+    ByteIndex = 0;
+
+    //
+    // Exchange a word at a time if both elements are word aligned, which is
+    // the common case for arrays of structures.
+    //
+
+    if (((((UINTN)FirstElement) | ((UINTN)SecondElement)) &
+         (sizeof(UINTN) - 1)) == 0) {
+
+        FirstWord = (UINTN *)FirstElement;
+        SecondWord = (UINTN *)SecondElement;
+        while (ByteIndex + sizeof(UINTN) <= ElementSize) {
+            SwapWord = *FirstWord;
+            *FirstWord = *SecondWord;
+            *SecondWord = SwapWord;
+            FirstWord += 1;
+            SecondWord += 1;
+            ByteIndex += sizeof(UINTN);
+        }
+    }
+
+    while (ByteIndex < ElementSize) {
         Swap = FirstElement[ByteIndex];
         FirstElement[ByteIndex] = SecondElement[ByteIndex];
         SecondElement[ByteIndex] = Swap;
+        ByteIndex += 1;
     }
 
     return;
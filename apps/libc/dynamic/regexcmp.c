@@ -531,6 +531,11 @@ Return Value:
         goto CompileRegularExpressionEnd;
     }
 
+    Status = ClpCompileRegularExpressionProgram(Result);
+    if (Status != RegexStatusSuccess) {
+        goto CompileRegularExpressionEnd;
+    }
+
 CompileRegularExpressionEnd:
     if (Status != RegexStatusSuccess) {
         if (Result != NULL) {
@@ -582,6 +587,10 @@ Return Value:
         ClpDestroyRegularExpressionEntry(Entry);
     }
 
+    if (Expression->Program != NULL) {
+        ClpDestroyRegularExpressionProgram(Expression->Program);
+    }
+
     free(Expression);
     return;
 }
@@ -612,6 +621,7 @@ Return Value:
 
 {
 
+    PREGULAR_EXPRESSION_ENTRY Entry;
     ULONG EntryFlags;
     REGULAR_EXPRESSION_STATUS Status;
 
@@ -642,11 +652,23 @@ Return Value:
     }
 
     //
-    // Parse an optional right anchor.
+    // Parse an optional right anchor. This is added as an end of string entry
+    // rather than checked after the fact so that the matcher backtracks into
+    // the rest of the expression if the first match found doesn't reach the
+    // end.
     //
 
     if (Lexer->Token == '$') {
-        EntryFlags |= REGULAR_EXPRESSION_ANCHORED_RIGHT;
+        Entry = ClpCreateRegularExpressionEntry(RegexEntryStringEnd);
+        if (Entry == NULL) {
+            Status = RegexStatusNoMemory;
+            goto ParseBasicRegularExpressionEnd;
+        }
+
+        Entry->Parent = &(Expression->BaseEntry);
+        INSERT_BEFORE(&(Entry->ListEntry),
+                      &(Expression->BaseEntry.ChildList));
+
         Status = ClpGetRegularExpressionToken(Lexer, Expression);
         if (Status != RegexStatusSuccess) {
             goto ParseBasicRegularExpressionEnd;
@@ -337,10 +337,12 @@ Return Value:
     REGULAR_EXPRESSION_EXECUTION Context;
     PLIST_ENTRY FreeEntry;
     size_t MatchIndex;
+    BOOL NeedOffsets;
     ULONG StartIndex;
     REGULAR_EXPRESSION_STATUS Status;
 
     Status = RegexStatusNoMatch;
+    NeedOffsets = FALSE;
     INITIALIZE_LIST_HEAD(&(Context.Choices));
     INITIALIZE_LIST_HEAD(&(Context.FreeChoices));
     Context.Expression = RegularExpression;
@@ -350,6 +352,10 @@ Return Value:
     Context.Match = Match;
     Context.MatchSize = MatchArraySize;
     if ((RegularExpression->Flags & REG_NOSUB) == 0) {
+        if (MatchArraySize != 0) {
+            NeedOffsets = TRUE;
+        }
+
         for (MatchIndex = 0; MatchIndex < MatchArraySize; MatchIndex += 1) {
             Match[MatchIndex].rm_so = -1;
             Match[MatchIndex].rm_eo = -1;
@@ -370,6 +376,38 @@ Return Value:
 
     for (StartIndex = 0; StartIndex < Context.InputSize; StartIndex += 1) {
 
+        //
+        // If the expression has an NFA program, use it to skip straight to
+        // the first index where a match begins, or to find out in linear time
+        // that there is no match at all. If the caller doesn't care about
+        // offsets then that's the whole answer. Otherwise the backtracking
+        // matcher fills in the offsets starting from that index.
+        //
+
+        if (RegularExpression->Program != NULL) {
+            if (NeedOffsets == FALSE) {
+                Status = ClpRunRegularExpressionProgram(RegularExpression,
+                                                        String,
+                                                        Context.InputSize - 1,
+                                                        StartIndex,
+                                                        Flags,
+                                                        NULL);
+
+                break;
+            }
+
+            Status = ClpRunRegularExpressionProgram(RegularExpression,
+                                                    String,
+                                                    Context.InputSize - 1,
+                                                    StartIndex,
+                                                    Flags,
+                                                    &StartIndex);
+
+            if (Status != RegexStatusSuccess) {
+                break;
+            }
+        }
+
         //
         // If the expression is anchored to the left, then this had better be:
         // 1) Index zero and REG_NOTBOL is clear or
@@ -394,27 +432,6 @@ Return Value:
                                            &(RegularExpression->BaseEntry));
 
         if (Status == RegexStatusSuccess) {
-
-            //
-            // If the expression is anchored to the right then either:
-            // 1) The index had better be the end and REG_NOTEOL is clear or
-            // 2) REG_NEWLINE is set and it's right before a newline.
-            // If this condition isn't met then it's not a real match.
-            //
-
-            if ((RegularExpression->BaseEntry.Flags &
-                 REGULAR_EXPRESSION_ANCHORED_RIGHT) != 0) {
-
-                if (!(((Context.NextInput == Context.InputSize - 1) &&
-                      ((Flags & REG_NOTEOL) == 0)) ||
-                      (((RegularExpression->Flags & REG_NEWLINE) != 0) &&
-                       (String[Context.NextInput] == '\n')))) {
-
-                    Status = RegexStatusNoMatch;
-                    continue;
-                }
-            }
-
             break;
         }
     }
@@ -626,7 +643,21 @@ Return Value:
 
                 assert(UseThisEntry == FALSE);
 
+                //
+                // An empty option matches without consuming anything. Finish
+                // the branch itself, otherwise the code below would move on
+                // to the next option as if it were the next entry in the
+                // sequence.
+                //
+
                 if (LIST_EMPTY(&(Entry->ChildList)) != FALSE) {
+                    Entry = Entry->Parent;
+                    Parent = Entry->Parent;
+
+                    assert(CurrentChoice->Node == Entry);
+
+                    Iteration = 0;
+                    DuplicateMax = 1;
                     Status = RegexStatusSuccess;
 
                 } else {
@@ -1333,14 +1364,8 @@ Return Value:
 
 {
 
-    PREGULAR_BRACKET_ENTRY BracketEntry;
-    PREGULAR_BRACKET_EXPRESSION BracketExpression;
     CHAR Character;
-    ULONG CharacterCount;
-    ULONG CharacterIndex;
-    PLIST_ENTRY CurrentEntry;
-    PSTR RegularCharacters;
-    REGULAR_EXPRESSION_STATUS Status;
+    BOOL Match;
 
     assert(Entry->Type == RegexEntryBracketExpression);
 
@@ -1353,7 +1378,61 @@ Return Value:
         return RegexStatusNoMatch;
     }
 
-    Status = RegexStatusNoMatch;
+    Match = ClpRegularExpressionMatchBracketCharacter(Context->Expression,
+                                                      Entry,
+                                                      Character);
+
+    if (Match == FALSE) {
+        return RegexStatusNoMatch;
+    }
+
+    Context->NextInput += 1;
+    return RegexStatusSuccess;
+}
+
+BOOL
+ClpRegularExpressionMatchBracketCharacter (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    CHAR Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines if a character is matched by a bracket
+    expression.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the bracket expression entry.
+
+    Character - Supplies the character to test.
+
+Return Value:
+
+    TRUE if the bracket expression matches the character.
+
+    FALSE if the bracket expression does not match the character.
+
+--*/
+
+{
+
+    PREGULAR_BRACKET_ENTRY BracketEntry;
+    PREGULAR_BRACKET_EXPRESSION BracketExpression;
+    ULONG CharacterCount;
+    ULONG CharacterIndex;
+    PLIST_ENTRY CurrentEntry;
+    BOOL Match;
+    PSTR RegularCharacters;
+
+    assert(Entry->Type == RegexEntryBracketExpression);
+
+    Match = FALSE;
     BracketExpression = &(Entry->U.BracketExpression);
     CharacterCount = BracketExpression->RegularCharacters.Size;
     RegularCharacters = BracketExpression->RegularCharacters.Data;
@@ -1367,12 +1446,12 @@ Return Value:
          CharacterIndex += 1) {
 
         if ((Character == RegularCharacters[CharacterIndex]) ||
-            (((Context->Expression->Flags & REG_ICASE) != 0) &&
+            (((Expression->Flags & REG_ICASE) != 0) &&
               (tolower(Character) ==
                tolower(RegularCharacters[CharacterIndex])))) {
 
-            Status = RegexStatusSuccess;
-            goto RegularExpressionMatchBracketExpressionEnd;
+            Match = TRUE;
+            goto RegularExpressionMatchBracketCharacterEnd;
         }
     }
 
@@ -1392,104 +1471,104 @@ Return Value:
             if ((Character >= BracketEntry->U.Range.Minimum) &&
                 (Character <= BracketEntry->U.Range.Maximum)) {
 
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassAlphanumeric:
             if (isalnum(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassAlphabetic:
             if (isalpha(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassBlank:
             if (isblank(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassControl:
             if (iscntrl(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassDigit:
             if (isdigit(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassGraph:
             if (isgraph(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassLowercase:
             if ((islower(Character)) ||
-                (((Context->Expression->Flags & REG_ICASE) != 0) &&
+                (((Expression->Flags & REG_ICASE) != 0) &&
                  (isupper(Character)))) {
 
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassPrintable:
             if (isprint(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassPunctuation:
             if (ispunct(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassSpace:
             if (isspace(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassUppercase:
             if ((isupper(Character)) ||
-                (((Context->Expression->Flags & REG_ICASE) != 0) &&
+                (((Expression->Flags & REG_ICASE) != 0) &&
                  (islower(Character)))) {
 
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassHexDigit:
             if (isxdigit(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassName:
             if (REGULAR_EXPRESSION_IS_NAME(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
@@ -1498,29 +1577,20 @@ Return Value:
 
             assert(FALSE);
 
-            goto RegularExpressionMatchBracketExpressionEnd;
+            return FALSE;
         }
 
-        if (Status == RegexStatusSuccess) {
+        if (Match != FALSE) {
             break;
         }
     }
 
-RegularExpressionMatchBracketExpressionEnd:
+RegularExpressionMatchBracketCharacterEnd:
     if ((Entry->Flags & REGULAR_EXPRESSION_NEGATED) != 0) {
-        if (Status == RegexStatusNoMatch) {
-            Status = RegexStatusSuccess;
-
-        } else if (Status == RegexStatusSuccess) {
-            Status = RegexStatusNoMatch;
-        }
-    }
-
-    if (Status == RegexStatusSuccess) {
-        Context->NextInput += 1;
+        Match = !Match;
     }
 
-    return Status;
+    return Match;
 }
 
 VOID
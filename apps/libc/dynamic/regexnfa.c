@@ -0,0 +1,1564 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    regexnfa.c
+
+Abstract:
+
+    This module implements a Thompson NFA for regular expressions. A compiled
+    regular expression without back references is flattened into a small
+    program, which can determine in time linear to the input whether and where
+    a match begins. The backtracking matcher is then only needed to fill out
+    the match offsets, starting from an index known to match.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#define LIBC_API __DLLEXPORT
+
+#include <minoca/lib/types.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#include "regexp.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// These macros test and set a byte in a character class bitmap.
+//
+
+#define REGEX_CLASS_CONTAINS(_Class, _Byte) \
+    (((_Class)->Bits[(_Byte) / 32] & (1U << ((_Byte) % 32))) != 0)
+
+#define REGEX_CLASS_ADD(_Class, _Byte) \
+    ((_Class)->Bits[(_Byte) / 32] |= (1U << ((_Byte) % 32)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the maximum number of instructions in a program. Expressions that
+// would need more than this (usually due to large repeat counts) are left to
+// the backtracking matcher.
+//
+
+#define REGEX_PROGRAM_MAX_INSTRUCTIONS 4096
+
+//
+// Define the largest program whose execution state is kept on the stack
+// rather than allocated.
+//
+
+#define REGEX_PROGRAM_LOCAL_INSTRUCTIONS 64
+
+//
+// Define the number of ULONGs of execution state needed per instruction: two
+// thread lists of two ULONGs per thread, a mark, and a stack slot.
+//
+
+#define REGEX_PROGRAM_STATE_PER_INSTRUCTION 6
+
+//
+// Define the value used to terminate the list of branch exit jumps during
+// emission.
+//
+
+#define REGEX_JUMP_LIST_END MAX_ULONG
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a thread in the NFA simulation.
+
+Members:
+
+    Instruction - Stores the index of the instruction the thread is waiting to
+        execute.
+
+    Start - Stores the input index where this thread's match attempt began.
+
+--*/
+
+typedef struct _REGEX_THREAD {
+    ULONG Instruction;
+    ULONG Start;
+} REGEX_THREAD, *PREGEX_THREAD;
+
+/*++
+
+Structure Description:
+
+    This structure defines the state for a single run of a program.
+
+Members:
+
+    Program - Stores a pointer to the program being run.
+
+    Input - Stores a pointer to the input string.
+
+    InputLength - Stores the length of the input string, not including the
+        null terminator.
+
+    CompileFlags - Stores the REG_* flags the expression was compiled with.
+
+    Flags - Stores the REG_NOTBOL and REG_NOTEOL execution flags.
+
+    Marks - Stores an array with one element per instruction, recording the
+        generation in which the instruction was last added to a thread list.
+
+    Stack - Stores the work stack used when following empty transitions.
+
+--*/
+
+typedef struct _REGEX_PROGRAM_RUN {
+    PREGULAR_EXPRESSION_PROGRAM Program;
+    PSTR Input;
+    ULONG InputLength;
+    ULONG CompileFlags;
+    INT Flags;
+    PULONG Marks;
+    PULONG Stack;
+} REGEX_PROGRAM_RUN, *PREGEX_PROGRAM_RUN;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+BOOL
+ClpMeasureRegularExpressionEntry (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    PULONGLONG InstructionCount,
+    PULONGLONG ClassCount
+    );
+
+BOOL
+ClpMeasureRegularExpressionAtom (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    PULONGLONG InstructionCount,
+    PULONGLONG ClassCount
+    );
+
+BOOL
+ClpMeasureRegularExpressionList (
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead,
+    PULONGLONG InstructionCount,
+    PULONGLONG ClassCount
+    );
+
+VOID
+ClpEmitRegularExpressionEntry (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry
+    );
+
+VOID
+ClpEmitRegularExpressionAtom (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry
+    );
+
+VOID
+ClpEmitRegularExpressionList (
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead
+    );
+
+ULONG
+ClpEmitRegularExpressionInstruction (
+    PREGULAR_EXPRESSION_PROGRAM Program,
+    REGEX_INSTRUCTION_TYPE Type
+    );
+
+VOID
+ClpEmitRegularExpressionClass (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    CHAR Character
+    );
+
+VOID
+ClpFindRegularExpressionPrefix (
+    PREGULAR_EXPRESSION Expression
+    );
+
+VOID
+ClpAddRegularExpressionThread (
+    PREGEX_PROGRAM_RUN Run,
+    PREGEX_THREAD Threads,
+    PULONG ThreadCount,
+    ULONG Instruction,
+    ULONG Position,
+    ULONG Start
+    );
+
+BOOL
+ClpTestRegularExpressionAssertion (
+    PREGEX_PROGRAM_RUN Run,
+    REGEX_ENTRY_TYPE Assertion,
+    ULONG Position
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+REGULAR_EXPRESSION_STATUS
+ClpCompileRegularExpressionProgram (
+    PREGULAR_EXPRESSION Expression
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the NFA program for a parsed regular expression. If
+    the expression cannot be represented by a program (because it contains
+    back references or is too large), then no program is attached and the
+    expression will be executed by backtracking alone.
+
+Arguments:
+
+    Expression - Supplies a pointer to the parsed regular expression.
+
+Return Value:
+
+    Regular expression status code.
+
+--*/
+
+{
+
+    ULONGLONG ClassCount;
+    PREGULAR_EXPRESSION_ENTRY Entry;
+    ULONGLONG InstructionCount;
+    PREGULAR_EXPRESSION_PROGRAM Program;
+    BOOL Result;
+    REGULAR_EXPRESSION_STATUS Status;
+
+    assert(Expression->Program == NULL);
+
+    //
+    // Size the program up front, including the optional left anchor and the
+    // final match instruction.
+    //
+
+    InstructionCount = 1;
+    ClassCount = 0;
+    if ((Expression->BaseEntry.Flags & REGULAR_EXPRESSION_ANCHORED_LEFT) != 0) {
+        InstructionCount += 1;
+    }
+
+    Result = ClpMeasureRegularExpressionEntry(Expression,
+                                              &(Expression->BaseEntry),
+                                              &InstructionCount,
+                                              &ClassCount);
+
+    if ((Result == FALSE) ||
+        (InstructionCount > REGEX_PROGRAM_MAX_INSTRUCTIONS)) {
+
+        return RegexStatusSuccess;
+    }
+
+    Status = RegexStatusNoMemory;
+    Program = malloc(sizeof(REGULAR_EXPRESSION_PROGRAM));
+    if (Program == NULL) {
+        goto CompileRegularExpressionProgramEnd;
+    }
+
+    memset(Program, 0, sizeof(REGULAR_EXPRESSION_PROGRAM));
+    Expression->Program = Program;
+    Program->Instructions = malloc(sizeof(REGEX_INSTRUCTION) *
+                                   InstructionCount);
+
+    if (Program->Instructions == NULL) {
+        goto CompileRegularExpressionProgramEnd;
+    }
+
+    if (ClassCount != 0) {
+        Program->Classes = malloc(sizeof(REGEX_CHARACTER_CLASS) * ClassCount);
+        if (Program->Classes == NULL) {
+            goto CompileRegularExpressionProgramEnd;
+        }
+    }
+
+    //
+    // A left anchor in a basic regular expression is kept as a flag on the
+    // base entry rather than as its own entry, so emit it here.
+    //
+
+    if ((Expression->BaseEntry.Flags & REGULAR_EXPRESSION_ANCHORED_LEFT) != 0) {
+        Program->Anchored = TRUE;
+        ClpEmitRegularExpressionInstruction(Program, RegexInstructionAssert);
+        Program->Instructions[0].U.Assertion = RegexEntryStringBegin;
+
+    //
+    // An extended regular expression is anchored if it starts with a
+    // circumflex that isn't optional.
+    //
+
+    } else if (LIST_EMPTY(&(Expression->BaseEntry.ChildList)) == FALSE) {
+        Entry = LIST_VALUE(Expression->BaseEntry.ChildList.Next,
+                           REGULAR_EXPRESSION_ENTRY,
+                           ListEntry);
+
+        if ((Entry->Type == RegexEntryStringBegin) &&
+            (Entry->DuplicateMin != 0)) {
+
+            Program->Anchored = TRUE;
+        }
+    }
+
+    ClpEmitRegularExpressionEntry(Expression, &(Expression->BaseEntry));
+    ClpEmitRegularExpressionInstruction(Program, RegexInstructionMatch);
+
+    assert((Program->InstructionCount == InstructionCount) &&
+           (Program->ClassCount == ClassCount));
+
+    ClpFindRegularExpressionPrefix(Expression);
+    Status = RegexStatusSuccess;
+
+CompileRegularExpressionProgramEnd:
+    if (Status != RegexStatusSuccess) {
+        if (Program != NULL) {
+            ClpDestroyRegularExpressionProgram(Program);
+            Expression->Program = NULL;
+        }
+    }
+
+    return Status;
+}
+
+VOID
+ClpDestroyRegularExpressionProgram (
+    PREGULAR_EXPRESSION_PROGRAM Program
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a regular expression program.
+
+Arguments:
+
+    Program - Supplies a pointer to the program to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Program->Instructions != NULL) {
+        free(Program->Instructions);
+    }
+
+    if (Program->Classes != NULL) {
+        free(Program->Classes);
+    }
+
+    if (Program->Prefix != NULL) {
+        free(Program->Prefix);
+    }
+
+    free(Program);
+    return;
+}
+
+REGULAR_EXPRESSION_STATUS
+ClpRunRegularExpressionProgram (
+    PREGULAR_EXPRESSION Expression,
+    PSTR String,
+    ULONG StringLength,
+    ULONG StartIndex,
+    INT Flags,
+    PULONG MatchStart
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a regular expression's program against a string,
+    simulating all paths through the NFA in lockstep so that the time taken
+    is linear in the length of the input.
+
+Arguments:
+
+    Expression - Supplies a pointer to the compiled regular expression, which
+        must have a program.
+
+    String - Supplies a pointer to the null terminated input string.
+
+    StringLength - Supplies the length of the input string in bytes, not
+        including the null terminator.
+
+    StartIndex - Supplies the first index in the string where a match may
+        begin.
+
+    Flags - Supplies the REG_NOTBOL and REG_NOTEOL execution flags.
+
+    MatchStart - Supplies an optional pointer where the lowest index at which
+        a match begins will be returned. If this is NULL, the routine stops as
+        soon as any match is found.
+
+Return Value:
+
+    Success if there was a match.
+
+    No match if there was no match.
+
+    No memory if the execution state could not be allocated.
+
+--*/
+
+{
+
+    ULONG BestStart;
+    UCHAR Character;
+    PREGEX_THREAD Current;
+    ULONG CurrentCount;
+    PSTR Found;
+    PREGEX_INSTRUCTION Instruction;
+    ULONG InstructionCount;
+    ULONG LocalState[REGEX_PROGRAM_LOCAL_INSTRUCTIONS *
+                     REGEX_PROGRAM_STATE_PER_INSTRUCTION];
+
+    PREGEX_THREAD Next;
+    ULONG NextCount;
+    ULONG Position;
+    PREGULAR_EXPRESSION_PROGRAM Program;
+    REGEX_PROGRAM_RUN Run;
+    PULONG State;
+    REGULAR_EXPRESSION_STATUS Status;
+    PREGEX_THREAD Swap;
+    PREGEX_THREAD Thread;
+    ULONG ThreadIndex;
+
+    Program = Expression->Program;
+    InstructionCount = Program->InstructionCount;
+    State = LocalState;
+    if (InstructionCount > REGEX_PROGRAM_LOCAL_INSTRUCTIONS) {
+        State = malloc(sizeof(ULONG) * InstructionCount *
+                       REGEX_PROGRAM_STATE_PER_INSTRUCTION);
+
+        if (State == NULL) {
+            return RegexStatusNoMemory;
+        }
+    }
+
+    Run.Program = Program;
+    Run.Input = String;
+    Run.InputLength = StringLength;
+    Run.CompileFlags = Expression->Flags;
+    Run.Flags = Flags;
+    Run.Marks = State;
+    Run.Stack = State + InstructionCount;
+    Current = (PREGEX_THREAD)(State + (InstructionCount * 2));
+    Next = Current + InstructionCount;
+    memset(Run.Marks, 0, sizeof(ULONG) * InstructionCount);
+    BestStart = MAX_ULONG;
+    CurrentCount = 0;
+    Position = StartIndex;
+    Status = RegexStatusNoMatch;
+    while (TRUE) {
+
+        //
+        // Until a match is found, start a new attempt at every index. Threads
+        // already running began earlier, so they stay ahead of the new one
+        // in the list. This keeps the list sorted by starting index.
+        //
+
+        if (BestStart == MAX_ULONG) {
+            if (CurrentCount == 0) {
+
+                //
+                // With nothing in flight, an anchored expression can only
+                // begin at the start of the string, and an expression with a
+                // literal prefix can skip directly to the next occurrence of
+                // that prefix.
+                //
+
+                if ((Program->Anchored != FALSE) && (Position != 0) &&
+                    ((Run.CompileFlags & REG_NEWLINE) == 0)) {
+
+                    break;
+                }
+
+                if (Program->Prefix != NULL) {
+                    Found = strstr(String + Position, Program->Prefix);
+                    if (Found == NULL) {
+                        break;
+                    }
+
+                    Position = Found - String;
+                }
+            }
+
+            ClpAddRegularExpressionThread(&Run,
+                                          Current,
+                                          &CurrentCount,
+                                          0,
+                                          Position,
+                                          Position);
+        }
+
+        //
+        // Step every thread over the next character.
+        //
+
+        Character = (UCHAR)(String[Position]);
+        NextCount = 0;
+        for (ThreadIndex = 0; ThreadIndex < CurrentCount; ThreadIndex += 1) {
+            Thread = &(Current[ThreadIndex]);
+            Instruction = &(Program->Instructions[Thread->Instruction]);
+            switch (Instruction->Type) {
+            case RegexInstructionCharacter:
+                if ((Position < StringLength) &&
+                    (Character == Instruction->U.Character)) {
+
+                    ClpAddRegularExpressionThread(&Run,
+                                                  Next,
+                                                  &NextCount,
+                                                  Thread->Instruction + 1,
+                                                  Position + 1,
+                                                  Thread->Start);
+                }
+
+                break;
+
+            case RegexInstructionClass:
+                if ((Position < StringLength) &&
+                    (REGEX_CLASS_CONTAINS(
+                             &(Program->Classes[Instruction->U.Class]),
+                             Character))) {
+
+                    ClpAddRegularExpressionThread(&Run,
+                                                  Next,
+                                                  &NextCount,
+                                                  Thread->Instruction + 1,
+                                                  Position + 1,
+                                                  Thread->Start);
+                }
+
+                break;
+
+            //
+            // A thread reached the end of the program. Every thread behind
+            // it in the list began at the same index or later, so they can
+            // all be abandoned. Threads ahead of it began earlier and might
+            // still produce a better match.
+            //
+
+            case RegexInstructionMatch:
+                BestStart = Thread->Start;
+                Status = RegexStatusSuccess;
+                if (MatchStart == NULL) {
+                    goto RunRegularExpressionProgramEnd;
+                }
+
+                ThreadIndex = CurrentCount;
+                break;
+
+            default:
+
+                assert(FALSE);
+
+                break;
+            }
+        }
+
+        if ((Position >= StringLength) ||
+            ((NextCount == 0) && (BestStart != MAX_ULONG))) {
+
+            break;
+        }
+
+        Swap = Current;
+        Current = Next;
+        Next = Swap;
+        CurrentCount = NextCount;
+        Position += 1;
+    }
+
+RunRegularExpressionProgramEnd:
+    if ((Status == RegexStatusSuccess) && (MatchStart != NULL)) {
+        *MatchStart = BestStart;
+    }
+
+    if (State != LocalState) {
+        free(State);
+    }
+
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+BOOL
+ClpMeasureRegularExpressionEntry (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    PULONGLONG InstructionCount,
+    PULONGLONG ClassCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the number of instructions and character classes needed
+    to represent the given entry, including its repeats, to the running
+    totals.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the entry to measure.
+
+    InstructionCount - Supplies a pointer to the running instruction count.
+
+    ClassCount - Supplies a pointer to the running character class count.
+
+Return Value:
+
+    TRUE if the entry can be represented by a program.
+
+    FALSE if the entry contains back references or is too large.
+
+--*/
+
+{
+
+    ULONGLONG AtomClasses;
+    ULONGLONG AtomInstructions;
+    ULONG Maximum;
+    ULONG Minimum;
+    BOOL Result;
+
+    AtomClasses = 0;
+    AtomInstructions = 0;
+    Result = ClpMeasureRegularExpressionAtom(Expression,
+                                             Entry,
+                                             &AtomInstructions,
+                                             &AtomClasses);
+
+    if (Result == FALSE) {
+        return FALSE;
+    }
+
+    //
+    // The required repeats are laid out back to back. An unbounded repeat
+    // adds a loop with a split and a jump, and each optional repeat adds a
+    // body guarded by a split.
+    //
+
+    Minimum = Entry->DuplicateMin;
+    Maximum = Entry->DuplicateMax;
+    *InstructionCount += AtomInstructions * Minimum;
+    *ClassCount += AtomClasses * Minimum;
+    if (Maximum == (ULONG)-1) {
+        *InstructionCount += AtomInstructions + 2;
+        *ClassCount += AtomClasses;
+
+    } else if (Maximum > Minimum) {
+        *InstructionCount += (AtomInstructions + 1) * (Maximum - Minimum);
+        *ClassCount += AtomClasses * (Maximum - Minimum);
+    }
+
+    if (*InstructionCount > REGEX_PROGRAM_MAX_INSTRUCTIONS) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL
+ClpMeasureRegularExpressionAtom (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    PULONGLONG InstructionCount,
+    PULONGLONG ClassCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the number of instructions and character classes needed
+    to represent a single occurrence of the given entry to the running totals.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the entry to measure.
+
+    InstructionCount - Supplies a pointer to the running instruction count.
+
+    ClassCount - Supplies a pointer to the running character class count.
+
+Return Value:
+
+    TRUE if the entry can be represented by a program.
+
+    FALSE if the entry contains back references or is too large.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PREGULAR_EXPRESSION_ENTRY Option;
+    BOOL Result;
+
+    switch (Entry->Type) {
+    case RegexEntryOrdinaryCharacters:
+        *InstructionCount += Entry->U.String.Size;
+        if ((Expression->Flags & REG_ICASE) != 0) {
+            *ClassCount += Entry->U.String.Size;
+        }
+
+        break;
+
+    case RegexEntryAnyCharacter:
+    case RegexEntryBracketExpression:
+        *InstructionCount += 1;
+        *ClassCount += 1;
+        break;
+
+    case RegexEntryStringBegin:
+    case RegexEntryStringEnd:
+    case RegexEntryStartOfWord:
+    case RegexEntryEndOfWord:
+        *InstructionCount += 1;
+        break;
+
+    case RegexEntrySubexpression:
+        return ClpMeasureRegularExpressionList(Expression,
+                                               &(Entry->ChildList),
+                                               InstructionCount,
+                                               ClassCount);
+
+    //
+    // Every option but the last needs a split in front of it and a jump to
+    // the end after it.
+    //
+
+    case RegexEntryBranch:
+        CurrentEntry = Entry->ChildList.Next;
+        while (CurrentEntry != &(Entry->ChildList)) {
+            Option = LIST_VALUE(CurrentEntry,
+                                REGULAR_EXPRESSION_ENTRY,
+                                ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            if (CurrentEntry != &(Entry->ChildList)) {
+                *InstructionCount += 2;
+            }
+
+            Result = ClpMeasureRegularExpressionList(Expression,
+                                                     &(Option->ChildList),
+                                                     InstructionCount,
+                                                     ClassCount);
+
+            if (Result == FALSE) {
+                return FALSE;
+            }
+        }
+
+        break;
+
+    //
+    // Back references can't be represented in a finite automaton.
+    //
+
+    case RegexEntryBackReference:
+    default:
+        return FALSE;
+    }
+
+    if (*InstructionCount > REGEX_PROGRAM_MAX_INSTRUCTIONS) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL
+ClpMeasureRegularExpressionList (
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead,
+    PULONGLONG InstructionCount,
+    PULONGLONG ClassCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the number of instructions and character classes needed
+    to represent a sequence of entries to the running totals.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    ListHead - Supplies a pointer to the head of the list of entries.
+
+    InstructionCount - Supplies a pointer to the running instruction count.
+
+    ClassCount - Supplies a pointer to the running character class count.
+
+Return Value:
+
+    TRUE if the entries can be represented by a program.
+
+    FALSE if the entries contain back references or are too large.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PREGULAR_EXPRESSION_ENTRY Entry;
+    BOOL Result;
+
+    CurrentEntry = ListHead->Next;
+    while (CurrentEntry != ListHead) {
+        Entry = LIST_VALUE(CurrentEntry, REGULAR_EXPRESSION_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Result = ClpMeasureRegularExpressionEntry(Expression,
+                                                  Entry,
+                                                  InstructionCount,
+                                                  ClassCount);
+
+        if (Result == FALSE) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+VOID
+ClpEmitRegularExpressionEntry (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine emits the instructions for an entry and its repeats.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression, whose program
+        has already been sized to fit.
+
+    Entry - Supplies a pointer to the entry to emit.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Iteration;
+    ULONG Loop;
+    ULONG Maximum;
+    ULONG Minimum;
+    PREGULAR_EXPRESSION_PROGRAM Program;
+
+    Program = Expression->Program;
+    Minimum = Entry->DuplicateMin;
+    Maximum = Entry->DuplicateMax;
+    for (Iteration = 0; Iteration < Minimum; Iteration += 1) {
+        ClpEmitRegularExpressionAtom(Expression, Entry);
+    }
+
+    //
+    // An unbounded repeat loops back to a split that either runs the body
+    // again or leaves.
+    //
+
+    if (Maximum == (ULONG)-1) {
+        Loop = ClpEmitRegularExpressionInstruction(Program,
+                                                   RegexInstructionSplit);
+
+        ClpEmitRegularExpressionAtom(Expression, Entry);
+        Iteration = ClpEmitRegularExpressionInstruction(Program,
+                                                        RegexInstructionJump);
+
+        Program->Instructions[Iteration].U.Target = Loop;
+        Program->Instructions[Loop].U.Target = Program->InstructionCount;
+
+    //
+    // Each optional repeat can be skipped with a split.
+    //
+
+    } else {
+        for (Iteration = Minimum; Iteration < Maximum; Iteration += 1) {
+            Loop = ClpEmitRegularExpressionInstruction(Program,
+                                                       RegexInstructionSplit);
+
+            ClpEmitRegularExpressionAtom(Expression, Entry);
+            Program->Instructions[Loop].U.Target = Program->InstructionCount;
+        }
+    }
+
+    return;
+}
+
+VOID
+ClpEmitRegularExpressionAtom (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine emits the instructions for a single occurrence of an entry.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression, whose program
+        has already been sized to fit.
+
+    Entry - Supplies a pointer to the entry to emit.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    ULONG Index;
+    ULONG Instruction;
+    ULONG JumpList;
+    ULONG NextJump;
+    PREGULAR_EXPRESSION_ENTRY Option;
+    PREGULAR_EXPRESSION_PROGRAM Program;
+    ULONG Split;
+
+    Program = Expression->Program;
+    switch (Entry->Type) {
+    case RegexEntryOrdinaryCharacters:
+        for (Index = 0; Index < Entry->U.String.Size; Index += 1) {
+            if ((Expression->Flags & REG_ICASE) != 0) {
+                ClpEmitRegularExpressionClass(Expression,
+                                              Entry,
+                                              Entry->U.String.Data[Index]);
+
+            } else {
+                Instruction = ClpEmitRegularExpressionInstruction(
+                                                   Program,
+                                                   RegexInstructionCharacter);
+
+                Program->Instructions[Instruction].U.Character =
+                                      (UCHAR)(Entry->U.String.Data[Index]);
+            }
+        }
+
+        break;
+
+    case RegexEntryAnyCharacter:
+    case RegexEntryBracketExpression:
+        ClpEmitRegularExpressionClass(Expression, Entry, 0);
+        break;
+
+    case RegexEntryStringBegin:
+    case RegexEntryStringEnd:
+    case RegexEntryStartOfWord:
+    case RegexEntryEndOfWord:
+        Instruction = ClpEmitRegularExpressionInstruction(
+                                                      Program,
+                                                      RegexInstructionAssert);
+
+        Program->Instructions[Instruction].U.Assertion = Entry->Type;
+        break;
+
+    case RegexEntrySubexpression:
+        ClpEmitRegularExpressionList(Expression, &(Entry->ChildList));
+        break;
+
+    //
+    // Each option but the last is preceded by a split to the next option and
+    // followed by a jump to the end. The jumps aren't known until the end,
+    // so they're chained together through their targets until then.
+    //
+
+    case RegexEntryBranch:
+        JumpList = REGEX_JUMP_LIST_END;
+        CurrentEntry = Entry->ChildList.Next;
+        while (CurrentEntry != &(Entry->ChildList)) {
+            Option = LIST_VALUE(CurrentEntry,
+                                REGULAR_EXPRESSION_ENTRY,
+                                ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            if (CurrentEntry == &(Entry->ChildList)) {
+                ClpEmitRegularExpressionList(Expression, &(Option->ChildList));
+                break;
+            }
+
+            Split = ClpEmitRegularExpressionInstruction(Program,
+                                                        RegexInstructionSplit);
+
+            ClpEmitRegularExpressionList(Expression, &(Option->ChildList));
+            Instruction = ClpEmitRegularExpressionInstruction(
+                                                        Program,
+                                                        RegexInstructionJump);
+
+            Program->Instructions[Instruction].U.Target = JumpList;
+            JumpList = Instruction;
+            Program->Instructions[Split].U.Target = Program->InstructionCount;
+        }
+
+        while (JumpList != REGEX_JUMP_LIST_END) {
+            NextJump = Program->Instructions[JumpList].U.Target;
+            Program->Instructions[JumpList].U.Target =
+                                                    Program->InstructionCount;
+
+            JumpList = NextJump;
+        }
+
+        break;
+
+    default:
+
+        assert(FALSE);
+
+        break;
+    }
+
+    return;
+}
+
+VOID
+ClpEmitRegularExpressionList (
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead
+    )
+
+/*++
+
+Routine Description:
+
+    This routine emits the instructions for a sequence of entries.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression, whose program
+        has already been sized to fit.
+
+    ListHead - Supplies a pointer to the head of the list of entries.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PREGULAR_EXPRESSION_ENTRY Entry;
+
+    CurrentEntry = ListHead->Next;
+    while (CurrentEntry != ListHead) {
+        Entry = LIST_VALUE(CurrentEntry, REGULAR_EXPRESSION_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        ClpEmitRegularExpressionEntry(Expression, Entry);
+    }
+
+    return;
+}
+
+ULONG
+ClpEmitRegularExpressionInstruction (
+    PREGULAR_EXPRESSION_PROGRAM Program,
+    REGEX_INSTRUCTION_TYPE Type
+    )
+
+/*++
+
+Routine Description:
+
+    This routine appends an instruction to a program.
+
+Arguments:
+
+    Program - Supplies a pointer to the program, which has already been sized
+        to fit.
+
+    Type - Supplies the type of instruction to append.
+
+Return Value:
+
+    Returns the index of the new instruction.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    Index = Program->InstructionCount;
+    Program->InstructionCount += 1;
+    Program->Instructions[Index].Type = Type;
+    Program->Instructions[Index].U.Target = 0;
+    return Index;
+}
+
+VOID
+ClpEmitRegularExpressionClass (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    CHAR Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine appends an instruction matching a character class, built by
+    applying the same test the backtracking matcher uses to every possible
+    input byte.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression, whose program
+        has already been sized to fit.
+
+    Entry - Supplies a pointer to the entry the class is for: a case
+        insensitive ordinary character, any character, or a bracket
+        expression.
+
+    Character - Supplies the ordinary character for ordinary character
+        entries.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PREGEX_CHARACTER_CLASS Class;
+    ULONG Instruction;
+    CHAR Input;
+    BOOL Match;
+    PREGULAR_EXPRESSION_PROGRAM Program;
+    ULONG Value;
+
+    Program = Expression->Program;
+    Instruction = ClpEmitRegularExpressionInstruction(Program,
+                                                      RegexInstructionClass);
+
+    Program->Instructions[Instruction].U.Class = Program->ClassCount;
+    Class = &(Program->Classes[Program->ClassCount]);
+    Program->ClassCount += 1;
+    memset(Class, 0, sizeof(REGEX_CHARACTER_CLASS));
+
+    //
+    // The null terminator never matches, so start at one.
+    //
+
+    for (Value = 1; Value <= MAX_UCHAR; Value += 1) {
+        Input = (CHAR)Value;
+        switch (Entry->Type) {
+        case RegexEntryOrdinaryCharacters:
+            Match = FALSE;
+            if ((Input == Character) ||
+                (tolower(Input) == tolower(Character))) {
+
+                Match = TRUE;
+            }
+
+            break;
+
+        case RegexEntryAnyCharacter:
+            Match = TRUE;
+            if ((Input == '\n') &&
+                ((Expression->Flags & REG_NEWLINE) != 0)) {
+
+                Match = FALSE;
+            }
+
+            break;
+
+        case RegexEntryBracketExpression:
+            Match = ClpRegularExpressionMatchBracketCharacter(Expression,
+                                                              Entry,
+                                                              Input);
+
+            break;
+
+        default:
+
+            assert(FALSE);
+
+            Match = FALSE;
+            break;
+        }
+
+        if (Match != FALSE) {
+            REGEX_CLASS_ADD(Class, Value);
+        }
+    }
+
+    return;
+}
+
+VOID
+ClpFindRegularExpressionPrefix (
+    PREGULAR_EXPRESSION Expression
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks for a literal string that every match of the
+    expression must begin with. If one is found, it is saved in the program so
+    that execution can skip directly to places in the input where a match
+    could begin.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression with a program.
+
+Return Value:
+
+    None. Allocation failures simply leave the program without a prefix.
+
+--*/
+
+{
+
+    PREGULAR_EXPRESSION_ENTRY Entry;
+    PLIST_ENTRY ListHead;
+    PREGULAR_EXPRESSION_PROGRAM Program;
+    ULONG Size;
+
+    if ((Expression->Flags & REG_ICASE) != 0) {
+        return;
+    }
+
+    Program = Expression->Program;
+    ListHead = &(Expression->BaseEntry.ChildList);
+    while (LIST_EMPTY(ListHead) == FALSE) {
+        Entry = LIST_VALUE(ListHead->Next, REGULAR_EXPRESSION_ENTRY, ListEntry);
+
+        //
+        // A leading anchor takes up no space, so look past it.
+        //
+
+        if ((Entry->Type == RegexEntryStringBegin) &&
+            (Entry->ListEntry.Next != ListHead)) {
+
+            Entry = LIST_VALUE(Entry->ListEntry.Next,
+                               REGULAR_EXPRESSION_ENTRY,
+                               ListEntry);
+        }
+
+        if (Entry->DuplicateMin == 0) {
+            break;
+        }
+
+        if (Entry->Type == RegexEntrySubexpression) {
+            ListHead = &(Entry->ChildList);
+            continue;
+        }
+
+        if (Entry->Type != RegexEntryOrdinaryCharacters) {
+            break;
+        }
+
+        //
+        // If the characters repeat, only the first one is certain.
+        //
+
+        Size = Entry->U.String.Size;
+        if ((Entry->DuplicateMin != 1) || (Entry->DuplicateMax != 1)) {
+            Size = 1;
+        }
+
+        Program->Prefix = malloc(Size + 1);
+        if (Program->Prefix != NULL) {
+            memcpy(Program->Prefix, Entry->U.String.Data, Size);
+            Program->Prefix[Size] = '\0';
+        }
+
+        break;
+    }
+
+    return;
+}
+
+VOID
+ClpAddRegularExpressionThread (
+    PREGEX_PROGRAM_RUN Run,
+    PREGEX_THREAD Threads,
+    PULONG ThreadCount,
+    ULONG Instruction,
+    ULONG Position,
+    ULONG Start
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a thread to a thread list, following all splits, jumps,
+    and satisfied assertions so that only threads waiting on a character or
+    at the match instruction end up in the list. Instructions already in the
+    list for this position are skipped, as the thread already there began no
+    later than this one.
+
+Arguments:
+
+    Run - Supplies a pointer to the program run state.
+
+    Threads - Supplies a pointer to the thread list to add to.
+
+    ThreadCount - Supplies a pointer to the number of threads in the list,
+        which is updated.
+
+    Instruction - Supplies the instruction the new thread is at.
+
+    Position - Supplies the input index the thread is at.
+
+    Start - Supplies the input index where the thread's match attempt began.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Generation;
+    PREGEX_INSTRUCTION Instructions;
+    ULONG Pending;
+    ULONG StackSize;
+    PREGEX_THREAD Thread;
+
+    Generation = Position + 1;
+    Instructions = Run->Program->Instructions;
+    if (Run->Marks[Instruction] == Generation) {
+        return;
+    }
+
+    Run->Marks[Instruction] = Generation;
+    Run->Stack[0] = Instruction;
+    StackSize = 1;
+    while (StackSize != 0) {
+        StackSize -= 1;
+        Instruction = Run->Stack[StackSize];
+        Pending = MAX_ULONG;
+        switch (Instructions[Instruction].Type) {
+        case RegexInstructionCharacter:
+        case RegexInstructionClass:
+        case RegexInstructionMatch:
+            Thread = &(Threads[*ThreadCount]);
+            Thread->Instruction = Instruction;
+            Thread->Start = Start;
+            *ThreadCount += 1;
+            break;
+
+        case RegexInstructionJump:
+            Pending = Instructions[Instruction].U.Target;
+            break;
+
+        //
+        // Push the alternate first so that the straight path is followed
+        // first.
+        //
+
+        case RegexInstructionSplit:
+            Pending = Instructions[Instruction].U.Target;
+            if (Run->Marks[Pending] != Generation) {
+                Run->Marks[Pending] = Generation;
+                Run->Stack[StackSize] = Pending;
+                StackSize += 1;
+            }
+
+            Pending = Instruction + 1;
+            break;
+
+        case RegexInstructionAssert:
+            if (ClpTestRegularExpressionAssertion(
+                                      Run,
+                                      Instructions[Instruction].U.Assertion,
+                                      Position) != FALSE) {
+
+                Pending = Instruction + 1;
+            }
+
+            break;
+
+        default:
+
+            assert(FALSE);
+
+            break;
+        }
+
+        if ((Pending != MAX_ULONG) && (Run->Marks[Pending] != Generation)) {
+            Run->Marks[Pending] = Generation;
+            Run->Stack[StackSize] = Pending;
+            StackSize += 1;
+        }
+    }
+
+    return;
+}
+
+BOOL
+ClpTestRegularExpressionAssertion (
+    PREGEX_PROGRAM_RUN Run,
+    REGEX_ENTRY_TYPE Assertion,
+    ULONG Position
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether a zero width assertion holds at the given
+    position. The conditions are the same as those used by the backtracking
+    matcher.
+
+Arguments:
+
+    Run - Supplies a pointer to the program run state.
+
+    Assertion - Supplies the type of entry being asserted.
+
+    Position - Supplies the input index to test.
+
+Return Value:
+
+    TRUE if the assertion holds.
+
+    FALSE if the assertion does not hold.
+
+--*/
+
+{
+
+    PSTR Input;
+    BOOL NewlineFlag;
+
+    Input = Run->Input;
+    NewlineFlag = FALSE;
+    if ((Run->CompileFlags & REG_NEWLINE) != 0) {
+        NewlineFlag = TRUE;
+    }
+
+    switch (Assertion) {
+    case RegexEntryStringBegin:
+        if ((((Run->Flags & REG_NOTBOL) == 0) && (Position == 0)) ||
+            ((NewlineFlag != FALSE) && (Position != 0) &&
+             (Input[Position - 1] == '\n'))) {
+
+            return TRUE;
+        }
+
+        break;
+
+    case RegexEntryStringEnd:
+        if ((((Run->Flags & REG_NOTEOL) == 0) &&
+             (Position >= Run->InputLength)) ||
+            ((NewlineFlag != FALSE) && (Input[Position] == '\n'))) {
+
+            return TRUE;
+        }
+
+        break;
+
+    case RegexEntryStartOfWord:
+        if ((REGULAR_EXPRESSION_IS_NAME(Input[Position])) &&
+            ((Position == 0) ||
+             (!REGULAR_EXPRESSION_IS_NAME(Input[Position - 1])))) {
+
+            return TRUE;
+        }
+
+        break;
+
+    case RegexEntryEndOfWord:
+        if ((Position != 0) &&
+            (REGULAR_EXPRESSION_IS_NAME(Input[Position - 1])) &&
+            (!REGULAR_EXPRESSION_IS_NAME(Input[Position]))) {
+
+            return TRUE;
+        }
+
+        break;
+
+    default:
+
+        assert(FALSE);
+
+        break;
+    }
+
+    return FALSE;
+}
@@ -48,7 +48,6 @@ Module Name:
 //
 
 #define REGULAR_EXPRESSION_ANCHORED_LEFT 0x00000001
-#define REGULAR_EXPRESSION_ANCHORED_RIGHT 0x00000002
 #define REGULAR_EXPRESSION_NEGATED 0x00000004
 
 //
@@ -105,6 +104,16 @@ typedef enum _BRACKET_EXPRESSION_TYPE {
     BracketExpressionCharacterClassName
 } BRACKET_EXPRESSION_TYPE, *PBRACKET_EXPRESSION_TYPE;
 
+typedef enum _REGEX_INSTRUCTION_TYPE {
+    RegexInstructionInvalid,
+    RegexInstructionCharacter,
+    RegexInstructionClass,
+    RegexInstructionSplit,
+    RegexInstructionJump,
+    RegexInstructionAssert,
+    RegexInstructionMatch
+} REGEX_INSTRUCTION_TYPE, *PREGEX_INSTRUCTION_TYPE;
+
 /*++
 
 Structure Description:
@@ -257,6 +266,96 @@ struct _REGULAR_EXPRESSION_ENTRY {
 
 /*++
 
+Structure Description:
+
+    This structure defines a set of input bytes matched by a program
+    instruction.
+
+Members:
+
+    Bits - Stores a bitmap with one bit set for each byte in the class.
+
+--*/
+
+typedef struct _REGEX_CHARACTER_CLASS {
+    ULONG Bits[(MAX_UCHAR + 1) / (sizeof(ULONG) * BITS_PER_BYTE)];
+} REGEX_CHARACTER_CLASS, *PREGEX_CHARACTER_CLASS;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single instruction of a regular expression
+    program.
+
+Members:
+
+    Type - Stores the type of instruction. Character and class instructions
+        consume one byte of input. Split instructions continue both at the
+        next instruction and at the target, jumps continue only at the target,
+        and assertions continue at the next instruction if the condition
+        holds at the current input position.
+
+    Character - Stores the byte matched by a character instruction.
+
+    Class - Stores the index of the character class matched by a class
+        instruction.
+
+    Target - Stores the target instruction index for splits and jumps.
+
+    Assertion - Stores the type of entry being tested by an assertion.
+
+--*/
+
+typedef struct _REGEX_INSTRUCTION {
+    REGEX_INSTRUCTION_TYPE Type;
+    union {
+        UCHAR Character;
+        ULONG Class;
+        ULONG Target;
+        REGEX_ENTRY_TYPE Assertion;
+    } U;
+
+} REGEX_INSTRUCTION, *PREGEX_INSTRUCTION;
+
+/*++
+
+Structure Description:
+
+    This structure defines the Thompson NFA form of a regular expression,
+    which is used to find matches in linear time.
+
+Members:
+
+    Instructions - Stores the array of instructions. Execution begins at the
+        first instruction.
+
+    InstructionCount - Stores the number of instructions in the program.
+
+    Classes - Stores the array of character classes used by class
+        instructions.
+
+    ClassCount - Stores the number of character classes.
+
+    Prefix - Stores an optional null terminated literal string that every
+        match begins with.
+
+    Anchored - Stores a boolean indicating if the expression only matches at
+        the beginning of a line.
+
+--*/
+
+typedef struct _REGULAR_EXPRESSION_PROGRAM {
+    PREGEX_INSTRUCTION Instructions;
+    ULONG InstructionCount;
+    PREGEX_CHARACTER_CLASS Classes;
+    ULONG ClassCount;
+    PSTR Prefix;
+    BOOL Anchored;
+} REGULAR_EXPRESSION_PROGRAM, *PREGULAR_EXPRESSION_PROGRAM;
+
+/*++
+
 Structure Description:
 
     This structure defines the internal regular expression representation.
@@ -270,12 +369,16 @@ Structure Description:
     BaseEntry - Stores the initial subexpression entry, a slightly modified
         subexpression.
 
+    Program - Stores an optional pointer to the NFA program for the
+        expression. Expressions with back references don't have one.
+
 --*/
 
 typedef struct _REGULAR_EXPRESSION {
     ULONG SubexpressionCount;
     ULONG Flags;
     REGULAR_EXPRESSION_ENTRY BaseEntry;
+    PREGULAR_EXPRESSION_PROGRAM Program;
 } REGULAR_EXPRESSION, *PREGULAR_EXPRESSION;
 
 //
@@ -285,3 +388,125 @@ typedef struct _REGULAR_EXPRESSION {
 //
 // -------------------------------------------------------- Function Prototypes
 //
+
+REGULAR_EXPRESSION_STATUS
+ClpCompileRegularExpressionProgram (
+    PREGULAR_EXPRESSION Expression
+    );
+
+/*++
+
+Routine Description:
+
+    This routine builds the NFA program for a parsed regular expression. If
+    the expression cannot be represented by a program (because it contains
+    back references or is too large), then no program is attached and the
+    expression will be executed by backtracking alone.
+
+Arguments:
+
+    Expression - Supplies a pointer to the parsed regular expression.
+
+Return Value:
+
+    Regular expression status code.
+
+--*/
+
+VOID
+ClpDestroyRegularExpressionProgram (
+    PREGULAR_EXPRESSION_PROGRAM Program
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys a regular expression program.
+
+Arguments:
+
+    Program - Supplies a pointer to the program to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+REGULAR_EXPRESSION_STATUS
+ClpRunRegularExpressionProgram (
+    PREGULAR_EXPRESSION Expression,
+    PSTR String,
+    ULONG StringLength,
+    ULONG StartIndex,
+    INT Flags,
+    PULONG MatchStart
+    );
+
+/*++
+
+Routine Description:
+
+    This routine runs a regular expression's program against a string,
+    simulating all paths through the NFA in lockstep so that the time taken
+    is linear in the length of the input.
+
+Arguments:
+
+    Expression - Supplies a pointer to the compiled regular expression, which
+        must have a program.
+
+    String - Supplies a pointer to the null terminated input string.
+
+    StringLength - Supplies the length of the input string in bytes, not
+        including the null terminator.
+
+    StartIndex - Supplies the first index in the string where a match may
+        begin.
+
+    Flags - Supplies the REG_NOTBOL and REG_NOTEOL execution flags.
+
+    MatchStart - Supplies an optional pointer where the lowest index at which
+        a match begins will be returned. If this is NULL, the routine stops as
+        soon as any match is found.
+
+Return Value:
+
+    Success if there was a match.
+
+    No match if there was no match.
+
+    No memory if the execution state could not be allocated.
+
+--*/
+
+BOOL
+ClpRegularExpressionMatchBracketCharacter (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    CHAR Character
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines if a character is matched by a bracket
+    expression.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the bracket expression entry.
+
+    Character - Supplies the character to test.
+
+Return Value:
+
+    TRUE if the bracket expression matches the character.
+
+    FALSE if the bracket expression does not match the character.
+
+--*/
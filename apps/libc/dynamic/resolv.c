@@ -68,13 +68,6 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
-//
-// Define the name of an environment variable to use as a DNS server address,
-// overriding the configuration.
-//
-
-#define DNS_DNSCACHEIP_VARIABLE "DNSCACHEIP"
-
 //
 // Define the maximum size of the resolver configuration file.
 //
@@ -38,6 +38,7 @@ Module Name:
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -118,12 +119,31 @@ ClpFileFormatWriteCharacter (
     PPRINT_FORMAT_CONTEXT Context
     );
 
+UINTN
+ClpFileFormatWriteString (
+    PCSTR String,
+    UINTN Size,
+    PPRINT_FORMAT_CONTEXT Context
+    );
+
+BOOL
+ClpFileFormatFlushBuffer (
+    PSTREAM_PRINT_CONTEXT StreamContext
+    );
+
 INT
 ClpConvertStreamModeStringToOpenFlags (
     PSTR ModeString,
     INT *OpenFlags
     );
 
+size_t
+ClpWriteStreamBufferAndData (
+    FILE *Stream,
+    const void *Data,
+    size_t Size
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -143,6 +163,13 @@ LIBC_API FILE *stderr;
 LIST_ENTRY ClStreamList;
 pthread_mutex_t ClStreamListLock;
 
+//
+// Store whether stream locks are actually acquired. Until the process creates
+// a second thread, stream locks are elided and only counted.
+//
+
+BOOL ClStreamLockingEnabled;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -816,7 +843,6 @@ Return Value:
     size_t BytesToWrite;
     ULONG CharacterIndex;
     BOOL Flush;
-    ssize_t Result;
     PSTR String;
     size_t TotalBytesToWrite;
     size_t TotalBytesWritten;
@@ -846,51 +872,33 @@ Return Value:
     }
 
     //
-    // For unbuffered streams or large writes, just write the file contents
-    // directly.
+    // If the last thing that happened was a read, flush the buffer.
     //
 
-    if ((Stream->BufferMode == _IONBF) ||
-        (TotalBytesToWrite > Stream->BufferSize)) {
-
+    if ((Stream->Flags & FILE_FLAG_READ_LAST) != 0) {
         if (fflush_unlocked(Stream) != 0) {
             return -1;
         }
 
-        //
-        // Set the last thing that happened to be a write.
-        //
-
         Stream->Flags &= ~FILE_FLAG_READ_LAST;
-        while (TotalBytesWritten != TotalBytesToWrite) {
-            do {
-                Result = write(Stream->Descriptor,
-                               Buffer + TotalBytesWritten,
-                               TotalBytesToWrite - TotalBytesWritten);
-
-            } while ((Result < 0) && (errno == EINTR));
-
-            if (Result <= 0) {
-                Stream->Flags |= FILE_FLAG_ERROR;
-                break;
-            }
-
-            TotalBytesWritten += Result;
-        }
-
-        return TotalBytesWritten / Size;
     }
 
     //
-    // If the last thing that happened was a read, flush the buffer.
+    // For unbuffered streams, large writes, and fully buffered writes that
+    // would overflow the buffer, write out whatever is buffered along with the
+    // new data in a single system call rather than flushing and then writing.
     //
 
-    if ((Stream->Flags & FILE_FLAG_READ_LAST) != 0) {
-        if (fflush_unlocked(Stream) != 0) {
-            return -1;
-        }
+    if ((Stream->BufferMode == _IONBF) ||
+        (TotalBytesToWrite > Stream->BufferSize) ||
+        ((Stream->BufferMode == _IOFBF) &&
+         (TotalBytesToWrite > Stream->BufferSize - Stream->BufferNextIndex))) {
 
-        Stream->Flags &= ~FILE_FLAG_READ_LAST;
+        TotalBytesWritten = ClpWriteStreamBufferAndData(Stream,
+                                                        Buffer,
+                                                        TotalBytesToWrite);
+
+        return TotalBytesWritten / Size;
     }
 
     //
@@ -1693,9 +1701,24 @@ Return Value:
 {
 
     unsigned char Byte;
+    ULONG Flags;
     ssize_t Result;
 
     ORIENT_STREAM(Stream, FILE_FLAG_BYTE_ORIENTED);
+
+    //
+    // Take the byte straight out of the buffer if there's read data there.
+    //
+
+    Flags = Stream->Flags & (FILE_FLAG_READ_LAST | FILE_FLAG_UNGET_VALID);
+    if ((Flags == FILE_FLAG_READ_LAST) &&
+        (Stream->BufferNextIndex < Stream->BufferValidSize)) {
+
+        Byte = Stream->Buffer[Stream->BufferNextIndex];
+        Stream->BufferNextIndex += 1;
+        return Byte;
+    }
+
     Result = fread_unlocked(&Byte, 1, 1, Stream);
     if (Result == 0) {
         return EOF;
@@ -1976,19 +1999,58 @@ Return Value:
 {
 
     int Character;
+    size_t CopySize;
+    PCHAR Data;
+    size_t DataSize;
     int Index;
+    PCHAR Newline;
+    INT Status;
 
     Character = EOF;
     if ((Buffer == NULL) || (BufferSize < 1)) {
         return NULL;
     }
 
+    ORIENT_STREAM(Stream, FILE_FLAG_BYTE_ORIENTED);
+
     //
     // Loop reading in characters until the buffer is full.
     //
 
     Index = 0;
     while (Index < BufferSize - 1) {
+
+        //
+        // Copy whole runs out of the stream buffer up to the end of the line
+        // when possible.
+        //
+
+        Status = ClpFillStreamReadBuffer(Stream, &Data, &DataSize);
+        if (Status == 0) {
+            break;
+        }
+
+        if (Status > 0) {
+            CopySize = BufferSize - 1 - Index;
+            if (CopySize > DataSize) {
+                CopySize = DataSize;
+            }
+
+            Newline = memchr(Data, '\n', CopySize);
+            if (Newline != NULL) {
+                CopySize = Newline - Data + 1;
+            }
+
+            memcpy(Buffer + Index, Data, CopySize);
+            Stream->BufferNextIndex += CopySize;
+            Index += CopySize;
+            if (Newline != NULL) {
+                break;
+            }
+
+            continue;
+        }
+
         Character = fgetc_unlocked(Stream);
         if (Character == EOF) {
             break;
@@ -3103,6 +3165,7 @@ Return Value:
     memset(&PrintContext, 0, sizeof(PRINT_FORMAT_CONTEXT));
     PrintContext.Context = &StreamContext;
     PrintContext.WriteCharacter = ClpFileFormatWriteCharacter;
+    PrintContext.WriteString = ClpFileFormatWriteString;
     RtlInitializeMultibyteState(&(PrintContext.State),
                                 CharacterEncodingDefault);
 
@@ -3301,6 +3364,11 @@ Return Value:
         return;
     }
 
+    if (ClStreamLockingEnabled == FALSE) {
+        Stream->ElidedLockCount += 1;
+        return;
+    }
+
     Status = pthread_mutex_lock(&(Stream->Lock));
 
     ASSERT(Status == 0);
@@ -3340,6 +3408,11 @@ Return Value:
         return TRUE;
     }
 
+    if (ClStreamLockingEnabled == FALSE) {
+        Stream->ElidedLockCount += 1;
+        return TRUE;
+    }
+
     Status = pthread_mutex_trylock(&(Stream->Lock));
     if (Status == 0) {
         return TRUE;
@@ -3375,6 +3448,16 @@ Return Value:
         return;
     }
 
+    //
+    // Locks taken while the process was single threaded are released the same
+    // way, even if another thread has come along since.
+    //
+
+    if (Stream->ElidedLockCount != 0) {
+        Stream->ElidedLockCount -= 1;
+        return;
+    }
+
     pthread_mutex_unlock(&(Stream->Lock));
     return;
 }
@@ -3434,6 +3517,162 @@ Return Value:
     return;
 }
 
+VOID
+ClpEnableStreamLocking (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called before the process creates its first additional
+    thread. It turns off stream lock elision, and converts any elided stream
+    locks held by the current thread into real ones.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PFILE Stream;
+
+    if (ClStreamLockingEnabled != FALSE) {
+        return;
+    }
+
+    //
+    // The process is still single threaded, so any elided locks belong to
+    // this thread. The stream locks are recursive, so acquire each one as many
+    // times as it was elided. The unlock routine only releases the mutex once
+    // the elided count is zero, so clear that too.
+    //
+
+    pthread_mutex_lock(&ClStreamListLock);
+    CurrentEntry = ClStreamList.Next;
+    while (CurrentEntry != &ClStreamList) {
+        Stream = LIST_VALUE(CurrentEntry, FILE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        while (Stream->ElidedLockCount != 0) {
+            pthread_mutex_lock(&(Stream->Lock));
+            Stream->ElidedLockCount -= 1;
+        }
+    }
+
+    ClStreamLockingEnabled = TRUE;
+    pthread_mutex_unlock(&ClStreamListLock);
+    return;
+}
+
+INT
+ClpFillStreamReadBuffer (
+    FILE *Stream,
+    PCHAR *Data,
+    size_t *Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the data buffered in a readable byte stream,
+    refilling the buffer from the file if it is empty. The caller consumes
+    data by advancing the buffer's next index. The stream lock must be held.
+
+Arguments:
+
+    Stream - Supplies a pointer to the stream.
+
+    Data - Supplies a pointer where a pointer to the buffered data will be
+        returned.
+
+    Size - Supplies a pointer where the number of buffered bytes will be
+        returned.
+
+Return Value:
+
+    1 if buffered data was returned.
+
+    0 if the end of the file was reached or a read error occurred. The end of
+    file or error indicator for the stream is set.
+
+    -1 if the stream cannot be read through its buffer right now, in which
+    case the caller should fall back to fgetc_unlocked.
+
+--*/
+
+{
+
+    ULONG Flags;
+    ssize_t Result;
+
+    //
+    // Leave unbuffered streams, unget characters, and wide streams to the
+    // slow path.
+    //
+
+    Flags = Stream->Flags &
+            (FILE_FLAG_CAN_READ | FILE_FLAG_UNGET_VALID |
+             FILE_FLAG_WIDE_ORIENTED);
+
+    if ((Flags != FILE_FLAG_CAN_READ) || (Stream->BufferMode == _IONBF) ||
+        (Stream->Buffer == NULL) || (Stream->Descriptor == -1)) {
+
+        return -1;
+    }
+
+    if (Stream->BufferNextIndex == Stream->BufferValidSize) {
+
+        //
+        // Don't throw away dirty write data.
+        //
+
+        if (((Stream->Flags & FILE_FLAG_READ_LAST) == 0) &&
+            (Stream->BufferNextIndex != 0)) {
+
+            return -1;
+        }
+
+        Stream->Flags |= FILE_FLAG_READ_LAST;
+        Stream->BufferNextIndex = 0;
+        Stream->BufferValidSize = 0;
+        do {
+            Result = read(Stream->Descriptor,
+                          Stream->Buffer,
+                          Stream->BufferSize);
+
+        } while ((Result < 0) && (errno == EINTR));
+
+        if (Result <= 0) {
+            if (Result < 0) {
+                Stream->Flags |= FILE_FLAG_ERROR;
+
+            } else {
+                Stream->Flags |= FILE_FLAG_END_OF_FILE;
+            }
+
+            return 0;
+        }
+
+        Stream->BufferValidSize = Result;
+
+    } else if ((Stream->Flags & FILE_FLAG_READ_LAST) == 0) {
+        return -1;
+    }
+
+    *Data = Stream->Buffer + Stream->BufferNextIndex;
+    *Size = Stream->BufferValidSize - Stream->BufferNextIndex;
+    return 1;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -3607,7 +3846,6 @@ Return Value:
 
 {
 
-    ULONG CharactersWritten;
     PSTREAM_PRINT_CONTEXT StreamContext;
 
     StreamContext = Context->Context;
@@ -3638,23 +3876,135 @@ Return Value:
         //
 
         if (StreamContext->BufferNextIndex == STREAM_PRINT_BUFFER_SIZE) {
-            StreamContext->BufferNextIndex = 0;
-            CharactersWritten = fwrite_unlocked(StreamContext->Buffer,
-                                                1,
-                                                STREAM_PRINT_BUFFER_SIZE,
-                                                StreamContext->Stream);
+            return ClpFileFormatFlushBuffer(StreamContext);
+        }
+    }
 
-            if (CharactersWritten < 0) {
-                return FALSE;
-            }
+    return TRUE;
+}
+
+UINTN
+ClpFileFormatWriteString (
+    PCSTR String,
+    UINTN Size,
+    PPRINT_FORMAT_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes a run of characters to the output during a
+    printf-style formatting operation.
+
+Arguments:
+
+    String - Supplies a pointer to the characters to write.
+
+    Size - Supplies the number of characters to write.
+
+    Context - Supplies a pointer to the printf-context.
+
+Return Value:
+
+    Returns the number of characters written. Anything less than the given
+    size indicates failure.
+
+--*/
+
+{
+
+    UINTN CopySize;
+    PSTREAM_PRINT_CONTEXT StreamContext;
+    UINTN Written;
+
+    StreamContext = Context->Context;
+
+    //
+    // Buffered streams can take the whole run at once.
+    //
+
+    if (StreamContext->Stream->BufferMode != _IONBF) {
+        return fwrite_unlocked(String, 1, Size, StreamContext->Stream);
+    }
+
+    //
+    // Unbuffered streams gather the characters in the local buffer, flushing
+    // it each time it fills.
+    //
+
+    Written = 0;
+    while (Written != Size) {
+        CopySize = STREAM_PRINT_BUFFER_SIZE - StreamContext->BufferNextIndex;
+        if (CopySize > Size - Written) {
+            CopySize = Size - Written;
+        }
+
+        memcpy(StreamContext->Buffer + StreamContext->BufferNextIndex,
+               String + Written,
+               CopySize);
+
+        StreamContext->BufferNextIndex += CopySize;
+        Written += CopySize;
+        if (StreamContext->BufferNextIndex == STREAM_PRINT_BUFFER_SIZE) {
+
+            //
+            // Like the single character version, the character that filled
+            // the buffer is not counted if the flush fails.
+            //
 
-            StreamContext->CharactersWritten += CharactersWritten;
-            if (CharactersWritten != STREAM_PRINT_BUFFER_SIZE) {
-                return FALSE;
+            if (ClpFileFormatFlushBuffer(StreamContext) == FALSE) {
+                return Written - 1;
             }
         }
     }
 
+    return Written;
+}
+
+BOOL
+ClpFileFormatFlushBuffer (
+    PSTREAM_PRINT_CONTEXT StreamContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes the full local print buffer of an unbuffered stream
+    out to the stream.
+
+Arguments:
+
+    StreamContext - Supplies a pointer to the stream print context.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    ULONG CharactersWritten;
+
+    StreamContext->BufferNextIndex = 0;
+    CharactersWritten = fwrite_unlocked(StreamContext->Buffer,
+                                        1,
+                                        STREAM_PRINT_BUFFER_SIZE,
+                                        StreamContext->Stream);
+
+    if (CharactersWritten < 0) {
+        return FALSE;
+    }
+
+    StreamContext->CharactersWritten += CharactersWritten;
+    if (CharactersWritten != STREAM_PRINT_BUFFER_SIZE) {
+        return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -3741,3 +4091,96 @@ Return Value:
     return 0;
 }
 
+size_t
+ClpWriteStreamBufferAndData (
+    FILE *Stream,
+    const void *Data,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes any dirty data in the stream buffer followed by the
+    given data, gathering both into as few system calls as possible. The
+    stream must not have read data in its buffer.
+
+Arguments:
+
+    Stream - Supplies a pointer to the stream to write to.
+
+    Data - Supplies a pointer to the data to write after the buffered data.
+
+    Size - Supplies the number of bytes of data to write.
+
+Return Value:
+
+    Returns the number of bytes of the given data that were written. On
+    failure, the error indicator for the stream is set, and any buffered data
+    that did not make it out is kept at the front of the buffer.
+
+--*/
+
+{
+
+    size_t BufferedSize;
+    size_t BufferWritten;
+    size_t DataWritten;
+    struct iovec IoVector[2];
+    ssize_t Result;
+
+    assert((Stream->Flags & FILE_FLAG_READ_LAST) == 0);
+
+    BufferedSize = Stream->BufferNextIndex;
+    BufferWritten = 0;
+    DataWritten = 0;
+    while ((BufferWritten != BufferedSize) || (DataWritten != Size)) {
+        IoVector[0].iov_base = Stream->Buffer + BufferWritten;
+        IoVector[0].iov_len = BufferedSize - BufferWritten;
+        IoVector[1].iov_base = (PVOID)Data + DataWritten;
+        IoVector[1].iov_len = Size - DataWritten;
+        do {
+            if (IoVector[0].iov_len == 0) {
+                Result = write(Stream->Descriptor,
+                               IoVector[1].iov_base,
+                               IoVector[1].iov_len);
+
+            } else {
+                Result = writev(Stream->Descriptor, IoVector, 2);
+            }
+
+        } while ((Result < 0) && (errno == EINTR));
+
+        if (Result <= 0) {
+            Stream->Flags |= FILE_FLAG_ERROR;
+            break;
+        }
+
+        if (Result <= IoVector[0].iov_len) {
+            BufferWritten += Result;
+
+        } else {
+            BufferWritten = BufferedSize;
+            DataWritten += Result - IoVector[0].iov_len;
+        }
+    }
+
+    //
+    // Keep any buffered data that didn't get written so it isn't lost.
+    //
+
+    if (BufferWritten != 0) {
+        if (BufferWritten != BufferedSize) {
+            memmove(Stream->Buffer,
+                    Stream->Buffer + BufferWritten,
+                    BufferedSize - BufferWritten);
+        }
+
+        Stream->BufferNextIndex = BufferedSize - BufferWritten;
+        Stream->BufferValidSize = Stream->BufferNextIndex;
+    }
+
+    return DataWritten;
+}
+
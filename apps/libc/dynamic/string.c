@@ -41,6 +41,21 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define whether or not the runtime library has SIMD versions of the memory
+// and string routines for this architecture. ARMv6 has no NEON unit.
+//
+
+#if defined(__i386) || defined(__amd64) || defined(__ARM_ARCH_7A__)
+
+#define CL_SIMD_STRING_ROUTINES 1
+
+#else
+
+#define CL_SIMD_STRING_ROUTINES 0
+
+#endif
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -59,10 +74,59 @@ Module Name:
 
 char *ClStringTokenizerContext;
 
+//
+// Store whether or not the SIMD memory and string routines should be used.
+// This starts out false so that anything running before the C library is
+// initialized gets the generic routines.
+//
+
+BOOL ClUseSimdStringRoutines;
+
 //
 // ------------------------------------------------------------------ Functions
 //
 
+VOID
+ClpInitializeStringRoutines (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine selects the fastest memory and string routines the current
+    processor supports.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+#if defined(__i386)
+
+    ClUseSimdStringRoutines = OsTestProcessorFeature(OsX86Sse2);
+
+#elif defined(__amd64)
+
+    ClUseSimdStringRoutines = TRUE;
+
+#elif CL_SIMD_STRING_ROUTINES
+
+    ClUseSimdStringRoutines = OsTestProcessorFeature(OsArmNeon32);
+
+#endif
+
+    return;
+}
+
 LIBC_API
 void *
 memchr (
@@ -100,6 +164,14 @@ Return Value:
 
     PSTR CharacterBuffer;
 
+#if CL_SIMD_STRING_ROUTINES
+
+    if (ClUseSimdStringRoutines != FALSE) {
+        return RtlFindByteSimd(Buffer, Character, Size);
+    }
+
+#endif
+
     CharacterBuffer = (PSTR)Buffer;
     while (Size != 0) {
         if ((unsigned char)*CharacterBuffer == (unsigned char)Character) {
@@ -152,6 +224,14 @@ Return Value:
     unsigned char *LeftCharacters;
     unsigned char *RightCharacters;
 
+#if CL_SIMD_STRING_ROUTINES
+
+    if (ClUseSimdStringRoutines != FALSE) {
+        return RtlCompareMemorySimd(Left, Right, Size);
+    }
+
+#endif
+
     LeftCharacters = (unsigned char *)Left;
     RightCharacters = (unsigned char *)Right;
     for (Index = 0; Index < Size; Index += 1) {
@@ -197,6 +277,14 @@ Return Value:
 
 {
 
+#if CL_SIMD_STRING_ROUTINES
+
+    if (ClUseSimdStringRoutines != FALSE) {
+        return RtlCopyMemorySimd(Destination, Source, ByteCount);
+    }
+
+#endif
+
     return RtlCopyMemory(Destination, (PVOID)Source, ByteCount);
 }
 
@@ -287,6 +375,15 @@ Return Value:
 
 {
 
+#if CL_SIMD_STRING_ROUTINES
+
+    if (ClUseSimdStringRoutines != FALSE) {
+        RtlSetMemorySimd(Destination, Character, ByteCount);
+        return Destination;
+    }
+
+#endif
+
     RtlSetMemory(Destination, Character, ByteCount);
     return Destination;
 }
@@ -571,6 +668,14 @@ Return Value:
 
 {
 
+#if CL_SIMD_STRING_ROUTINES
+
+    if (ClUseSimdStringRoutines != FALSE) {
+        return RtlStringLengthSimd(String);
+    }
+
+#endif
+
     return RtlStringLength((PSTR)String);
 }
 
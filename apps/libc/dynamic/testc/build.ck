@@ -40,6 +40,7 @@ function build() {
         "getoptst.c",
         "mathtst.c",
         "mathftst.c",
+        "mathvtst.c",
         "qsorttst.c",
         "regextst.c",
         "testc.c"
@@ -0,0 +1,1844 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    mathvtst.c
+
+Abstract:
+
+    This module implements the accuracy and throughput tests for the batch
+    math routines and the table driven and hardware assisted paths behind the
+    exponential, logarithm, square root, and rounding functions.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Test
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// Define this so it doesn't get defined to an import.
+//
+
+#define LIBC_API
+
+#include <minoca/lib/types.h>
+#include <minoca/lib/status.h>
+#include <minoca/lib/rtl.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of values run through each routine, and the number of
+// times the throughput tests run over that many values.
+//
+
+#define MATH_VECTOR_SAMPLE_COUNT 4096
+#define MATH_VECTOR_THROUGHPUT_PASSES 256
+
+//
+// Define the maximum allowed error of the double precision exp and log, in
+// units in the last place. The kernels are table driven and come in just over
+// the half ulp of a correctly rounded result.
+//
+
+#define MATH_VECTOR_DOUBLE_MAX_ULP 0.6
+
+//
+// Define the maximum allowed error of the single precision exp and log. These
+// are computed from the double precision kernels, so they should be correctly
+// rounded in all but astronomically rare cases.
+//
+
+#define MATH_VECTOR_FLOAT_MAX_ULP 0.501
+
+//
+// Define the input ranges over which the accuracy of the exponential is
+// measured. These keep the result (and the low half of the reference) normal.
+//
+
+#define MATH_VECTOR_EXP_MIN -700.0
+#define MATH_VECTOR_EXP_MAX 709.0
+#define MATH_VECTOR_EXPF_MIN -87.0
+#define MATH_VECTOR_EXPF_MAX 88.0
+
+//
+// Define the ranges of exponents for the random square root and logarithm
+// inputs used for accuracy checks.
+//
+
+#define MATH_VECTOR_SQRT_EXPONENT_MIN 0x07B
+#define MATH_VECTOR_SQRT_EXPONENT_MAX 0x783
+
+//
+// Define the constants used by the double-double reference routines. The
+// split constant is 2^27 + 1, which splits a double into two halves whose
+// products are exact.
+//
+
+#define MATH_VECTOR_SPLIT 134217729.0
+#define MATH_VECTOR_LN2_HIGH 0x1.62e42fefa39efp-1
+#define MATH_VECTOR_LN2_LOW 0x1.abc9e3b39803fp-56
+#define MATH_VECTOR_SQRT2 0x1.6a09e667f3bcdp+0
+#define MATH_VECTOR_EXP_SQUARINGS 8
+#define MATH_VECTOR_EXP_TERMS 14
+
+#define MATH_VECTOR_DOUBLE_EXPONENT_MASK 0x7FF0000000000000ULL
+#define MATH_VECTOR_DOUBLE_EXPONENT_SHIFT 52
+#define MATH_VECTOR_DOUBLE_EXPONENT_BIAS 1023
+#define MATH_VECTOR_DOUBLE_SIGNIFICAND_BITS 52
+#define MATH_VECTOR_FLOAT_SIGNIFICAND_BITS 23
+#define MATH_VECTOR_FLOAT_EXPONENT_MASK 0x7F800000
+#define MATH_VECTOR_FLOAT_SIGN_BIT 0x80000000
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef
+void
+(*PMATH_VECTOR_DOUBLE_ROUTINE) (
+    double *Results,
+    const double *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prototype describes a batch double precision math routine.
+
+Arguments:
+
+    Results - Supplies a pointer where the results are returned.
+
+    Values - Supplies a pointer to the input values.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+typedef
+void
+(*PMATH_VECTOR_FLOAT_ROUTINE) (
+    float *Results,
+    const float *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prototype describes a batch single precision math routine.
+
+Arguments:
+
+    Results - Supplies a pointer where the results are returned.
+
+    Values - Supplies a pointer to the input values.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+typedef enum _MATH_VECTOR_SAMPLE {
+    MathVectorSampleRange,
+    MathVectorSampleBits
+} MATH_VECTOR_SAMPLE, *PMATH_VECTOR_SAMPLE;
+
+/*++
+
+Structure Description:
+
+    This structure describes a batch double precision math routine and the
+    scalar routine it must match.
+
+Members:
+
+    Name - Stores the name of the batch routine.
+
+    Scalar - Stores a pointer to the scalar routine.
+
+    Vector - Stores a pointer to the batch routine.
+
+    Sample - Stores how random inputs are generated for the routine.
+
+    Minimum - Stores the minimum random input for ranged samples.
+
+    Maximum - Stores the maximum random input for ranged samples.
+
+--*/
+
+typedef struct _MATH_VECTOR_DOUBLE_FUNCTION {
+    PSTR Name;
+    double (*Scalar)(double);
+    PMATH_VECTOR_DOUBLE_ROUTINE Vector;
+    MATH_VECTOR_SAMPLE Sample;
+    double Minimum;
+    double Maximum;
+} MATH_VECTOR_DOUBLE_FUNCTION, *PMATH_VECTOR_DOUBLE_FUNCTION;
+
+/*++
+
+Structure Description:
+
+    This structure describes a batch single precision math routine and the
+    scalar routine it must match.
+
+Members:
+
+    Name - Stores the name of the batch routine.
+
+    Scalar - Stores a pointer to the scalar routine.
+
+    Vector - Stores a pointer to the batch routine.
+
+    Sample - Stores how random inputs are generated for the routine.
+
+    Minimum - Stores the minimum random input for ranged samples.
+
+    Maximum - Stores the maximum random input for ranged samples.
+
+--*/
+
+typedef struct _MATH_VECTOR_FLOAT_FUNCTION {
+    PSTR Name;
+    float (*Scalar)(float);
+    PMATH_VECTOR_FLOAT_ROUTINE Vector;
+    MATH_VECTOR_SAMPLE Sample;
+    float Minimum;
+    float Maximum;
+} MATH_VECTOR_FLOAT_FUNCTION, *PMATH_VECTOR_FLOAT_FUNCTION;
+
+/*++
+
+Structure Description:
+
+    This structure stores an unevaluated sum of two doubles, used to compute
+    reference results with about twice the precision of a double.
+
+Members:
+
+    High - Stores the high part of the value.
+
+    Low - Stores the low part of the value, which is less than half an ulp of
+        the high part in magnitude.
+
+--*/
+
+typedef struct _MATH_DOUBLE_DOUBLE {
+    double High;
+    double Low;
+} MATH_DOUBLE_DOUBLE, *PMATH_DOUBLE_DOUBLE;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+ULONG
+TestVectorMatchesScalar (
+    VOID
+    );
+
+ULONG
+TestVectorExpLogAccuracy (
+    VOID
+    );
+
+ULONG
+TestVectorExpLogFloatAccuracy (
+    VOID
+    );
+
+ULONG
+TestVectorSquareRootAccuracy (
+    VOID
+    );
+
+ULONG
+TestVectorRounding (
+    VOID
+    );
+
+VOID
+TestVectorThroughput (
+    VOID
+    );
+
+double
+TestVectorRandomDouble (
+    PMATH_VECTOR_DOUBLE_FUNCTION Function
+    );
+
+float
+TestVectorRandomFloat (
+    PMATH_VECTOR_FLOAT_FUNCTION Function
+    );
+
+ULONGLONG
+TestVectorRandom (
+    VOID
+    );
+
+double
+TestVectorPositiveDouble (
+    ULONG MinimumExponent,
+    ULONG MaximumExponent
+    );
+
+double
+TestVectorDoubleUlp (
+    double Value
+    );
+
+double
+TestVectorFloatUlp (
+    float Value
+    );
+
+BOOL
+TestVectorCompareDouble (
+    double Value1,
+    double Value2
+    );
+
+BOOL
+TestVectorCompareFloat (
+    float Value1,
+    float Value2
+    );
+
+double
+TestVectorElapsedNanoseconds (
+    clock_t Start,
+    clock_t End,
+    ULONG Count
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorReferenceExp (
+    double Value
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorReferenceLog (
+    double Value
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorTwoSum (
+    double Value1,
+    double Value2
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorTwoProduct (
+    double Value1,
+    double Value2
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorAdd (
+    MATH_DOUBLE_DOUBLE Value1,
+    MATH_DOUBLE_DOUBLE Value2
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorMultiply (
+    MATH_DOUBLE_DOUBLE Value1,
+    MATH_DOUBLE_DOUBLE Value2
+    );
+
+MATH_DOUBLE_DOUBLE
+TestVectorDivide (
+    MATH_DOUBLE_DOUBLE Dividend,
+    double Divisor
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+MATH_VECTOR_DOUBLE_FUNCTION TestVectorDoubleFunctions[] = {
+    {"vexp", exp, vexp, MathVectorSampleRange, -760.0, 720.0},
+    {"vlog", log, vlog, MathVectorSampleBits, 0.0, 0.0},
+    {"vsqrt", sqrt, vsqrt, MathVectorSampleBits, 0.0, 0.0},
+};
+
+MATH_VECTOR_FLOAT_FUNCTION TestVectorFloatFunctions[] = {
+    {"vexpf", expf, vexpf, MathVectorSampleRange, -110.0F, 100.0F},
+    {"vlogf", logf, vlogf, MathVectorSampleBits, 0.0F, 0.0F},
+    {"vsqrtf", sqrtf, vsqrtf, MathVectorSampleBits, 0.0F, 0.0F},
+};
+
+//
+// Define the values that are always run through the batch routines, which
+// cover the special cases and the edges of each routine's fast path.
+//
+
+double TestVectorSpecialDoubles[] = {
+    0.0,
+    -0.0,
+    1.0,
+    -1.0,
+    0.5,
+    2.0,
+    INFINITY,
+    -INFINITY,
+    NAN,
+    0x1p-1022,
+    0x1p-1074,
+    0x1.fffffffffffffp+1023,
+    0x1.62e42fefa39efp+9,
+    0x1.62e42fefa39f0p+9,
+    -0x1.74910d52d3051p+9,
+    -0x1.74910d52d3052p+9,
+    -0x1.6232bdd7abcd2p+9,
+    0x1p-54,
+    -0x1p-54,
+    0x1p-60,
+    0x1.0000000000001p+0,
+    0x1.fffffffffffffp-1,
+    0x1.6a09e667f3bcdp-1,
+    0x1.6a09e667f3bcdp+0,
+};
+
+float TestVectorSpecialFloats[] = {
+    0.0F,
+    -0.0F,
+    1.0F,
+    -1.0F,
+    0.5F,
+    2.0F,
+    INFINITY,
+    -INFINITY,
+    NAN,
+    0x1p-126F,
+    0x1p-149F,
+    0x1.fffffep+127F,
+    0x1.62e42ep+6F,
+    0x1.62e430p+6F,
+    -0x1.9fe368p+6F,
+    -0x1.9fe36ap+6F,
+    -0x1.5d589ep+6F,
+    0x1p-25F,
+    -0x1p-25F,
+    0x1p-30F,
+    0x1.000002p+0F,
+    0x1.fffffep-1F,
+    0x1.6a09e6p-1F,
+    0x1.6a09e6p+0F,
+};
+
+//
+// Store the state of the random number generator, and the buffers the
+// routines run over.
+//
+
+ULONGLONG TestVectorRandomState = 0x2545F4914F6CDD1DULL;
+
+double TestVectorDoubleValues[MATH_VECTOR_SAMPLE_COUNT];
+double TestVectorDoubleResults[MATH_VECTOR_SAMPLE_COUNT];
+float TestVectorFloatValues[MATH_VECTOR_SAMPLE_COUNT];
+float TestVectorFloatResults[MATH_VECTOR_SAMPLE_COUNT];
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+ULONG
+TestMathVector (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the entry point for the batch math routine and
+    math kernel accuracy test. It also reports the throughput of the scalar
+    and batch routines, which does not contribute to the failure count.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    ULONG Failures;
+
+    Failures = 0;
+    Failures += TestVectorMatchesScalar();
+    Failures += TestVectorExpLogAccuracy();
+    Failures += TestVectorExpLogFloatAccuracy();
+    Failures += TestVectorSquareRootAccuracy();
+    Failures += TestVectorRounding();
+    TestVectorThroughput();
+    return Failures;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+ULONG
+TestVectorMatchesScalar (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests that the batch math routines return exactly what the
+    scalar routines do, including for special values, unaligned arrays, odd
+    counts, and results computed in place.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    ULONG Count;
+    PMATH_VECTOR_DOUBLE_FUNCTION DoubleFunction;
+    double DoubleResult;
+    ULONG Failures;
+    PMATH_VECTOR_FLOAT_FUNCTION FloatFunction;
+    float FloatResult;
+    ULONG FunctionCount;
+    ULONG FunctionIndex;
+    ULONG Index;
+    ULONG Offset;
+    ULONG SpecialCount;
+    ULONG Start;
+
+    Failures = 0;
+    FunctionCount = sizeof(TestVectorDoubleFunctions) /
+                    sizeof(TestVectorDoubleFunctions[0]);
+
+    SpecialCount = sizeof(TestVectorSpecialDoubles) /
+                   sizeof(TestVectorSpecialDoubles[0]);
+
+    for (FunctionIndex = 0; FunctionIndex < FunctionCount; FunctionIndex += 1) {
+        DoubleFunction = &(TestVectorDoubleFunctions[FunctionIndex]);
+        for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+            if (Index < SpecialCount) {
+                TestVectorDoubleValues[Index] =
+                                           TestVectorSpecialDoubles[Index];
+
+            } else {
+                TestVectorDoubleValues[Index] =
+                                   TestVectorRandomDouble(DoubleFunction);
+            }
+        }
+
+        //
+        // Run over the whole array, then over an unaligned odd sized piece of
+        // it, and then in place.
+        //
+
+        for (Offset = 0; Offset < 3; Offset += 1) {
+            Count = MATH_VECTOR_SAMPLE_COUNT - (Offset * 3);
+            Start = Offset & 0x1;
+            if (Offset == 2) {
+                memcpy(TestVectorDoubleResults,
+                       TestVectorDoubleValues,
+                       sizeof(TestVectorDoubleResults));
+
+                DoubleFunction->Vector(TestVectorDoubleResults,
+                                       TestVectorDoubleResults,
+                                       Count);
+
+            } else {
+                DoubleFunction->Vector(TestVectorDoubleResults + Start,
+                                       TestVectorDoubleValues + Start,
+                                       Count);
+            }
+
+            for (Index = Start; Index < Start + Count; Index += 1) {
+                DoubleResult = DoubleFunction->Scalar(
+                                           TestVectorDoubleValues[Index]);
+
+                if (TestVectorCompareDouble(TestVectorDoubleResults[Index],
+                                            DoubleResult) == FALSE) {
+
+                    printf("%s(%.13a) was %.13a, but scalar gave %.13a.\n",
+                           DoubleFunction->Name,
+                           TestVectorDoubleValues[Index],
+                           TestVectorDoubleResults[Index],
+                           DoubleResult);
+
+                    Failures += 1;
+                }
+            }
+        }
+    }
+
+    FunctionCount = sizeof(TestVectorFloatFunctions) /
+                    sizeof(TestVectorFloatFunctions[0]);
+
+    SpecialCount = sizeof(TestVectorSpecialFloats) /
+                   sizeof(TestVectorSpecialFloats[0]);
+
+    for (FunctionIndex = 0; FunctionIndex < FunctionCount; FunctionIndex += 1) {
+        FloatFunction = &(TestVectorFloatFunctions[FunctionIndex]);
+        for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+            if (Index < SpecialCount) {
+                TestVectorFloatValues[Index] = TestVectorSpecialFloats[Index];
+
+            } else {
+                TestVectorFloatValues[Index] =
+                                     TestVectorRandomFloat(FloatFunction);
+            }
+        }
+
+        for (Offset = 0; Offset < 3; Offset += 1) {
+            Count = MATH_VECTOR_SAMPLE_COUNT - (Offset * 3);
+            Start = Offset & 0x1;
+            if (Offset == 2) {
+                memcpy(TestVectorFloatResults,
+                       TestVectorFloatValues,
+                       sizeof(TestVectorFloatResults));
+
+                FloatFunction->Vector(TestVectorFloatResults,
+                                      TestVectorFloatResults,
+                                      Count);
+
+            } else {
+                FloatFunction->Vector(TestVectorFloatResults + Start,
+                                      TestVectorFloatValues + Start,
+                                      Count);
+            }
+
+            for (Index = Start; Index < Start + Count; Index += 1) {
+                FloatResult = FloatFunction->Scalar(
+                                            TestVectorFloatValues[Index]);
+
+                if (TestVectorCompareFloat(TestVectorFloatResults[Index],
+                                           FloatResult) == FALSE) {
+
+                    printf("%s(%.6a) was %.6a, but scalar gave %.6a.\n",
+                           FloatFunction->Name,
+                           TestVectorFloatValues[Index],
+                           TestVectorFloatResults[Index],
+                           FloatResult);
+
+                    Failures += 1;
+                }
+            }
+        }
+    }
+
+    return Failures;
+}
+
+ULONG
+TestVectorExpLogAccuracy (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures the error of the double precision exp and log
+    against references computed with double-double arithmetic.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    double Error;
+    ULONG Failures;
+    ULONG Index;
+    double MaxExpError;
+    double MaxLogError;
+    MATH_DOUBLE_DOUBLE Reference;
+    double Result;
+    double Value;
+
+    Failures = 0;
+    MaxExpError = 0.0;
+    MaxLogError = 0.0;
+    for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+        Value = MATH_VECTOR_EXP_MIN +
+                ((MATH_VECTOR_EXP_MAX - MATH_VECTOR_EXP_MIN) *
+                 ((TestVectorRandom() >> 11) * 0x1p-53));
+
+        Result = exp(Value);
+        Reference = TestVectorReferenceExp(Value);
+        Error = ((Result - Reference.High) - Reference.Low) /
+                TestVectorDoubleUlp(Reference.High);
+
+        Error = fabs(Error);
+        if (Error > MaxExpError) {
+            MaxExpError = Error;
+        }
+
+        if (Error > MATH_VECTOR_DOUBLE_MAX_ULP) {
+            printf("exp(%.13a) was %.13a, off by %.3f ulp.\n",
+                   Value,
+                   Result,
+                   Error);
+
+            Failures += 1;
+        }
+
+        Value = TestVectorPositiveDouble(1, MATH_VECTOR_DOUBLE_EXPONENT_MASK >>
+                                            MATH_VECTOR_DOUBLE_EXPONENT_SHIFT);
+
+        //
+        // Skip values so close to one that the reference itself is not
+        // precise enough to grade the result.
+        //
+
+        if (fabs(Value - 1.0) < 0x1p-20) {
+            continue;
+        }
+
+        Result = log(Value);
+        Reference = TestVectorReferenceLog(Value);
+        Error = ((Result - Reference.High) - Reference.Low) /
+                TestVectorDoubleUlp(Reference.High);
+
+        Error = fabs(Error);
+        if (Error > MaxLogError) {
+            MaxLogError = Error;
+        }
+
+        if (Error > MATH_VECTOR_DOUBLE_MAX_ULP) {
+            printf("log(%.13a) was %.13a, off by %.3f ulp.\n",
+                   Value,
+                   Result,
+                   Error);
+
+            Failures += 1;
+        }
+    }
+
+    printf("exp max error %.3f ulp, log max error %.3f ulp.\n",
+           MaxExpError,
+           MaxLogError);
+
+    return Failures;
+}
+
+ULONG
+TestVectorExpLogFloatAccuracy (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures the error of the single precision exp and log
+    against the double precision routines, which are accurate enough to serve
+    as a reference for single precision results.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    double Error;
+    ULONG Failures;
+    ULONG Index;
+    double MaxExpError;
+    double MaxLogError;
+    float Result;
+    ULONG ValueBits;
+    float Value;
+
+    Failures = 0;
+    MaxExpError = 0.0;
+    MaxLogError = 0.0;
+    for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT * 4; Index += 1) {
+        Value = MATH_VECTOR_EXPF_MIN +
+                ((MATH_VECTOR_EXPF_MAX - MATH_VECTOR_EXPF_MIN) *
+                 ((TestVectorRandom() >> 40) * 0x1p-24F));
+
+        Result = expf(Value);
+        Error = fabs((double)Result - exp(Value)) / TestVectorFloatUlp(Result);
+        if (Error > MaxExpError) {
+            MaxExpError = Error;
+        }
+
+        if (Error > MATH_VECTOR_FLOAT_MAX_ULP) {
+            printf("expf(%.6a) was %.6a, off by %.3f ulp.\n",
+                   Value,
+                   Result,
+                   Error);
+
+            Failures += 1;
+        }
+
+        //
+        // Pick a random positive normal float for the logarithm.
+        //
+
+        do {
+            ValueBits = (ULONG)TestVectorRandom() &
+                        ~MATH_VECTOR_FLOAT_SIGN_BIT;
+
+        } while (((ValueBits & MATH_VECTOR_FLOAT_EXPONENT_MASK) == 0) ||
+                 ((ValueBits & MATH_VECTOR_FLOAT_EXPONENT_MASK) ==
+                  MATH_VECTOR_FLOAT_EXPONENT_MASK));
+
+        memcpy(&Value, &ValueBits, sizeof(Value));
+        Result = logf(Value);
+        if (Result == 0.0F) {
+            if (Value != 1.0F) {
+                printf("logf(%.6a) was zero.\n", Value);
+                Failures += 1;
+            }
+
+            continue;
+        }
+
+        Error = fabs((double)Result - log(Value)) / TestVectorFloatUlp(Result);
+        if (Error > MaxLogError) {
+            MaxLogError = Error;
+        }
+
+        if (Error > MATH_VECTOR_FLOAT_MAX_ULP) {
+            printf("logf(%.6a) was %.6a, off by %.3f ulp.\n",
+                   Value,
+                   Result,
+                   Error);
+
+            Failures += 1;
+        }
+    }
+
+    printf("expf max error %.3f ulp, logf max error %.3f ulp.\n",
+           MaxExpError,
+           MaxLogError);
+
+    return Failures;
+}
+
+ULONG
+TestVectorSquareRootAccuracy (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests that the square root routines are correctly rounded,
+    whether they are computed in software or by the hardware.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    ULONG Failures;
+    float FloatExpected;
+    float FloatResult;
+    float FloatValue;
+    ULONG Index;
+    MATH_DOUBLE_DOUBLE Product;
+    double Residual;
+    double Result;
+    double Value;
+    ULONG ValueBits;
+
+    Failures = 0;
+    for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT * 4; Index += 1) {
+
+        //
+        // The result is correctly rounded if the square of the result is
+        // within the square of half an ulp on either side of it, which is
+        // close enough to the result times an ulp. Square the result exactly
+        // to compare it.
+        //
+
+        Value = TestVectorPositiveDouble(MATH_VECTOR_SQRT_EXPONENT_MIN,
+                                         MATH_VECTOR_SQRT_EXPONENT_MAX);
+
+        Result = sqrt(Value);
+        Product = TestVectorTwoProduct(Result, Result);
+        Residual = (Value - Product.High) - Product.Low;
+        if (fabs(Residual) > Result * TestVectorDoubleUlp(Result)) {
+            printf("sqrt(%.13a) was %.13a, which is not correctly rounded.\n",
+                   Value,
+                   Result);
+
+            Failures += 1;
+        }
+
+        //
+        // A correctly rounded double square root rounds correctly again to
+        // single precision, so the float version must match exactly.
+        //
+
+        ValueBits = (ULONG)TestVectorRandom();
+        memcpy(&FloatValue, &ValueBits, sizeof(FloatValue));
+        FloatResult = sqrtf(FloatValue);
+        FloatExpected = (float)sqrt(FloatValue);
+        if ((TestVectorCompareFloat(FloatResult, FloatExpected) == FALSE) &&
+            ((isnan(FloatResult) == 0) || (isnan(FloatExpected) == 0))) {
+
+            printf("sqrtf(%.6a) was %.6a, should have been %.6a.\n",
+                   FloatValue,
+                   FloatResult,
+                   FloatExpected);
+
+            Failures += 1;
+        }
+    }
+
+    return Failures;
+}
+
+ULONG
+TestVectorRounding (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests floor, ceil, and trunc, which may be implemented with
+    rounding instructions, against results computed with integer conversions.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    double Ceiling;
+    ULONG Failures;
+    float FloatCeiling;
+    float FloatFloor;
+    float FloatTruncated;
+    float FloatValue;
+    double Floor;
+    ULONG Index;
+    double Truncated;
+    double Value;
+
+    Failures = 0;
+    for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT * 4; Index += 1) {
+
+        //
+        // Pick values from a fraction up to well past the point where every
+        // value is an integer. Multiplying by zero preserves the sign for
+        // results that truncate to zero.
+        //
+
+        Value = ldexp((double)(LONGLONG)TestVectorRandom(),
+                      -(LONG)(TestVectorRandom() % 72));
+
+        Truncated = Value;
+        if (fabs(Value) < 0x1p52) {
+            Truncated = (double)(LONGLONG)Value;
+            if (Truncated == 0.0) {
+                Truncated = Value * 0.0;
+            }
+        }
+
+        Floor = Truncated;
+        if (Floor > Value) {
+            Floor -= 1.0;
+        }
+
+        Ceiling = Truncated;
+        if (Ceiling < Value) {
+            Ceiling += 1.0;
+        }
+
+        if ((TestVectorCompareDouble(trunc(Value), Truncated) == FALSE) ||
+            (TestVectorCompareDouble(floor(Value), Floor) == FALSE) ||
+            (TestVectorCompareDouble(ceil(Value), Ceiling) == FALSE)) {
+
+            printf("trunc/floor/ceil(%.13a) were %.13a/%.13a/%.13a, should "
+                   "have been %.13a/%.13a/%.13a.\n",
+                   Value,
+                   trunc(Value),
+                   floor(Value),
+                   ceil(Value),
+                   Truncated,
+                   Floor,
+                   Ceiling);
+
+            Failures += 1;
+        }
+
+        FloatValue = (float)Value;
+        if (fabsf(FloatValue) >= 0x1p23F) {
+            FloatValue = ldexpf(FloatValue, -40);
+        }
+
+        FloatTruncated = (float)(LONGLONG)FloatValue;
+        if (FloatTruncated == 0.0F) {
+            FloatTruncated = FloatValue * 0.0F;
+        }
+
+        FloatFloor = FloatTruncated;
+        if (FloatFloor > FloatValue) {
+            FloatFloor -= 1.0F;
+        }
+
+        FloatCeiling = FloatTruncated;
+        if (FloatCeiling < FloatValue) {
+            FloatCeiling += 1.0F;
+        }
+
+        if ((TestVectorCompareFloat(truncf(FloatValue),
+                                    FloatTruncated) == FALSE) ||
+            (TestVectorCompareFloat(floorf(FloatValue), FloatFloor) == FALSE) ||
+            (TestVectorCompareFloat(ceilf(FloatValue),
+                                    FloatCeiling) == FALSE)) {
+
+            printf("truncf/floorf/ceilf(%.6a) were %.6a/%.6a/%.6a, should "
+                   "have been %.6a/%.6a/%.6a.\n",
+                   FloatValue,
+                   truncf(FloatValue),
+                   floorf(FloatValue),
+                   ceilf(FloatValue),
+                   FloatTruncated,
+                   FloatFloor,
+                   FloatCeiling);
+
+            Failures += 1;
+        }
+    }
+
+    return Failures;
+}
+
+VOID
+TestVectorThroughput (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine times a loop calling each scalar routine against a call to
+    the corresponding batch routine, and prints the cost per element of each.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    clock_t BatchEnd;
+    clock_t BatchStart;
+    PMATH_VECTOR_DOUBLE_FUNCTION DoubleFunction;
+    PMATH_VECTOR_FLOAT_FUNCTION FloatFunction;
+    ULONG FunctionCount;
+    ULONG FunctionIndex;
+    ULONG Index;
+    ULONG Pass;
+    clock_t ScalarEnd;
+    clock_t ScalarStart;
+    ULONG Total;
+
+    Total = MATH_VECTOR_SAMPLE_COUNT * MATH_VECTOR_THROUGHPUT_PASSES;
+    FunctionCount = sizeof(TestVectorDoubleFunctions) /
+                    sizeof(TestVectorDoubleFunctions[0]);
+
+    for (FunctionIndex = 0; FunctionIndex < FunctionCount; FunctionIndex += 1) {
+        DoubleFunction = &(TestVectorDoubleFunctions[FunctionIndex]);
+        for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+            do {
+                TestVectorDoubleValues[Index] =
+                                   TestVectorRandomDouble(DoubleFunction);
+
+            } while ((isfinite(TestVectorDoubleValues[Index]) == 0) ||
+                     (TestVectorDoubleValues[Index] < 0.0));
+        }
+
+        ScalarStart = clock();
+        for (Pass = 0; Pass < MATH_VECTOR_THROUGHPUT_PASSES; Pass += 1) {
+            for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+                TestVectorDoubleResults[Index] =
+                      DoubleFunction->Scalar(TestVectorDoubleValues[Index]);
+            }
+        }
+
+        ScalarEnd = clock();
+        BatchStart = ScalarEnd;
+        for (Pass = 0; Pass < MATH_VECTOR_THROUGHPUT_PASSES; Pass += 1) {
+            DoubleFunction->Vector(TestVectorDoubleResults,
+                                   TestVectorDoubleValues,
+                                   MATH_VECTOR_SAMPLE_COUNT);
+        }
+
+        BatchEnd = clock();
+        printf("%s: %.1f ns scalar, %.1f ns batch per element.\n",
+               DoubleFunction->Name,
+               TestVectorElapsedNanoseconds(ScalarStart, ScalarEnd, Total),
+               TestVectorElapsedNanoseconds(BatchStart, BatchEnd, Total));
+    }
+
+    FunctionCount = sizeof(TestVectorFloatFunctions) /
+                    sizeof(TestVectorFloatFunctions[0]);
+
+    for (FunctionIndex = 0; FunctionIndex < FunctionCount; FunctionIndex += 1) {
+        FloatFunction = &(TestVectorFloatFunctions[FunctionIndex]);
+        for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+            do {
+                TestVectorFloatValues[Index] =
+                                     TestVectorRandomFloat(FloatFunction);
+
+            } while ((isfinite(TestVectorFloatValues[Index]) == 0) ||
+                     (TestVectorFloatValues[Index] < 0.0F));
+        }
+
+        ScalarStart = clock();
+        for (Pass = 0; Pass < MATH_VECTOR_THROUGHPUT_PASSES; Pass += 1) {
+            for (Index = 0; Index < MATH_VECTOR_SAMPLE_COUNT; Index += 1) {
+                TestVectorFloatResults[Index] =
+                        FloatFunction->Scalar(TestVectorFloatValues[Index]);
+            }
+        }
+
+        ScalarEnd = clock();
+        BatchStart = ScalarEnd;
+        for (Pass = 0; Pass < MATH_VECTOR_THROUGHPUT_PASSES; Pass += 1) {
+            FloatFunction->Vector(TestVectorFloatResults,
+                                  TestVectorFloatValues,
+                                  MATH_VECTOR_SAMPLE_COUNT);
+        }
+
+        BatchEnd = clock();
+        printf("%s: %.1f ns scalar, %.1f ns batch per element.\n",
+               FloatFunction->Name,
+               TestVectorElapsedNanoseconds(ScalarStart, ScalarEnd, Total),
+               TestVectorElapsedNanoseconds(BatchStart, BatchEnd, Total));
+    }
+
+    return;
+}
+
+double
+TestVectorRandomDouble (
+    PMATH_VECTOR_DOUBLE_FUNCTION Function
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a random input for the given batch routine.
+
+Arguments:
+
+    Function - Supplies a pointer to the routine to generate an input for.
+
+Return Value:
+
+    Returns a random input value.
+
+--*/
+
+{
+
+    ULONGLONG Bits;
+    double Value;
+
+    if (Function->Sample == MathVectorSampleRange) {
+        Value = Function->Minimum +
+                ((Function->Maximum - Function->Minimum) *
+                 ((TestVectorRandom() >> 11) * 0x1p-53));
+
+    } else {
+        Bits = TestVectorRandom();
+        memcpy(&Value, &Bits, sizeof(Value));
+    }
+
+    return Value;
+}
+
+float
+TestVectorRandomFloat (
+    PMATH_VECTOR_FLOAT_FUNCTION Function
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a random input for the given single precision batch
+    routine.
+
+Arguments:
+
+    Function - Supplies a pointer to the routine to generate an input for.
+
+Return Value:
+
+    Returns a random input value.
+
+--*/
+
+{
+
+    ULONG Bits;
+    float Value;
+
+    if (Function->Sample == MathVectorSampleRange) {
+        Value = Function->Minimum +
+                ((Function->Maximum - Function->Minimum) *
+                 ((TestVectorRandom() >> 40) * 0x1p-24F));
+
+    } else {
+        Bits = (ULONG)TestVectorRandom();
+        memcpy(&Value, &Bits, sizeof(Value));
+    }
+
+    return Value;
+}
+
+ULONGLONG
+TestVectorRandom (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next value from a simple xorshift random number
+    generator, which keeps the test repeatable from run to run.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a 64-bit pseudo-random value.
+
+--*/
+
+{
+
+    ULONGLONG State;
+
+    State = TestVectorRandomState;
+    State ^= State << 13;
+    State ^= State >> 7;
+    State ^= State << 17;
+    TestVectorRandomState = State;
+    return State;
+}
+
+double
+TestVectorPositiveDouble (
+    ULONG MinimumExponent,
+    ULONG MaximumExponent
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a random positive double whose biased exponent is
+    within the given range.
+
+Arguments:
+
+    MinimumExponent - Supplies the minimum biased exponent, inclusive.
+
+    MaximumExponent - Supplies the maximum biased exponent, exclusive.
+
+Return Value:
+
+    Returns a random positive value.
+
+--*/
+
+{
+
+    ULONGLONG Bits;
+    ULONGLONG Exponent;
+    double Value;
+
+    Bits = TestVectorRandom();
+    Exponent = MinimumExponent +
+               ((Bits >> MATH_VECTOR_DOUBLE_SIGNIFICAND_BITS) %
+                (MaximumExponent - MinimumExponent));
+
+    Bits &= (1ULL << MATH_VECTOR_DOUBLE_SIGNIFICAND_BITS) - 1;
+    Bits |= Exponent << MATH_VECTOR_DOUBLE_EXPONENT_SHIFT;
+    memcpy(&Value, &Bits, sizeof(Value));
+    return Value;
+}
+
+double
+TestVectorDoubleUlp (
+    double Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the size of a unit in the last place of the given
+    normal double.
+
+Arguments:
+
+    Value - Supplies the value to get the ulp of.
+
+Return Value:
+
+    Returns the ulp of the value.
+
+--*/
+
+{
+
+    ULONGLONG Bits;
+    double Ulp;
+
+    memcpy(&Bits, &Value, sizeof(Bits));
+    Bits &= MATH_VECTOR_DOUBLE_EXPONENT_MASK;
+    Bits -= (ULONGLONG)MATH_VECTOR_DOUBLE_SIGNIFICAND_BITS <<
+            MATH_VECTOR_DOUBLE_EXPONENT_SHIFT;
+
+    memcpy(&Ulp, &Bits, sizeof(Ulp));
+    return Ulp;
+}
+
+double
+TestVectorFloatUlp (
+    float Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the size of a unit in the last place of the given
+    normal float.
+
+Arguments:
+
+    Value - Supplies the value to get the ulp of.
+
+Return Value:
+
+    Returns the ulp of the value, as a double.
+
+--*/
+
+{
+
+    return TestVectorDoubleUlp(Value) *
+           (1ULL << (MATH_VECTOR_DOUBLE_SIGNIFICAND_BITS -
+                     MATH_VECTOR_FLOAT_SIGNIFICAND_BITS));
+}
+
+BOOL
+TestVectorCompareDouble (
+    double Value1,
+    double Value2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two doubles bit for bit, so that the signs of zeros
+    and NaNs are compared too.
+
+Arguments:
+
+    Value1 - Supplies the first value.
+
+    Value2 - Supplies the second value.
+
+Return Value:
+
+    TRUE if the values are identical.
+
+    FALSE if the values differ.
+
+--*/
+
+{
+
+    if (memcmp(&Value1, &Value2, sizeof(double)) == 0) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+BOOL
+TestVectorCompareFloat (
+    float Value1,
+    float Value2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two floats bit for bit, so that the signs of zeros
+    and NaNs are compared too.
+
+Arguments:
+
+    Value1 - Supplies the first value.
+
+    Value2 - Supplies the second value.
+
+Return Value:
+
+    TRUE if the values are identical.
+
+    FALSE if the values differ.
+
+--*/
+
+{
+
+    if (memcmp(&Value1, &Value2, sizeof(float)) == 0) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+double
+TestVectorElapsedNanoseconds (
+    clock_t Start,
+    clock_t End,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts a processor time interval into the average number of
+    nanoseconds spent on each of the given number of elements.
+
+Arguments:
+
+    Start - Supplies the processor time at the start of the interval.
+
+    End - Supplies the processor time at the end of the interval.
+
+    Count - Supplies the number of elements processed in the interval.
+
+Return Value:
+
+    Returns the number of nanoseconds per element.
+
+--*/
+
+{
+
+    return (double)(End - Start) * (1000000000.0 / CLOCKS_PER_SEC) / Count;
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorReferenceExp (
+    double Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes a reference value for exp in double-double
+    arithmetic. The argument is reduced by a multiple of ln2 and then by a
+    power of two, a Taylor series is summed, and the result is squared back up.
+
+Arguments:
+
+    Value - Supplies the value to raise e to. The result must be normal.
+
+Return Value:
+
+    Returns the exponential of the value to about 100 bits.
+
+--*/
+
+{
+
+    LONG Exponent;
+    ULONG Index;
+    MATH_DOUBLE_DOUBLE Product;
+    MATH_DOUBLE_DOUBLE Reduced;
+    MATH_DOUBLE_DOUBLE Sum;
+    MATH_DOUBLE_DOUBLE Term;
+
+    if (Value < 0.0) {
+        Exponent = (LONG)((Value / MATH_VECTOR_LN2_HIGH) - 0.5);
+
+    } else {
+        Exponent = (LONG)((Value / MATH_VECTOR_LN2_HIGH) + 0.5);
+    }
+
+    Product = TestVectorTwoProduct(Exponent, MATH_VECTOR_LN2_HIGH);
+    Reduced = TestVectorTwoSum(Value, -Product.High);
+    Product.High = -Product.Low;
+    Product.Low = -Exponent * MATH_VECTOR_LN2_LOW;
+    Reduced = TestVectorAdd(Reduced, Product);
+    Reduced.High = ldexp(Reduced.High, -MATH_VECTOR_EXP_SQUARINGS);
+    Reduced.Low = ldexp(Reduced.Low, -MATH_VECTOR_EXP_SQUARINGS);
+    Sum.High = 1.0;
+    Sum.Low = 0.0;
+    Term = Sum;
+    for (Index = 1; Index <= MATH_VECTOR_EXP_TERMS; Index += 1) {
+        Term = TestVectorDivide(TestVectorMultiply(Term, Reduced), Index);
+        Sum = TestVectorAdd(Sum, Term);
+    }
+
+    for (Index = 0; Index < MATH_VECTOR_EXP_SQUARINGS; Index += 1) {
+        Sum = TestVectorMultiply(Sum, Sum);
+    }
+
+    Sum.High = ldexp(Sum.High, Exponent);
+    Sum.Low = ldexp(Sum.Low, Exponent);
+    return Sum;
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorReferenceLog (
+    double Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes a reference value for log in double-double
+    arithmetic. The value is split into a power of two and a significand near
+    one, and the logarithm of the significand is refined from the library's
+    answer with a Newton step using the reference exponential.
+
+Arguments:
+
+    Value - Supplies the positive normal value to take the logarithm of.
+
+Return Value:
+
+    Returns the natural logarithm of the value to about 100 bits.
+
+--*/
+
+{
+
+    ULONGLONG Bits;
+    MATH_DOUBLE_DOUBLE Correction;
+    LONG Exponent;
+    MATH_DOUBLE_DOUBLE Result;
+    double Significand;
+
+    memcpy(&Bits, &Value, sizeof(Bits));
+    Exponent = (LONG)(Bits >> MATH_VECTOR_DOUBLE_EXPONENT_SHIFT) -
+               MATH_VECTOR_DOUBLE_EXPONENT_BIAS;
+
+    Bits &= ~MATH_VECTOR_DOUBLE_EXPONENT_MASK;
+    Bits |= (ULONGLONG)MATH_VECTOR_DOUBLE_EXPONENT_BIAS <<
+            MATH_VECTOR_DOUBLE_EXPONENT_SHIFT;
+
+    memcpy(&Significand, &Bits, sizeof(Significand));
+    if (Significand > MATH_VECTOR_SQRT2) {
+        Significand *= 0.5;
+        Exponent += 1;
+    }
+
+    //
+    // Newton's method on exp(y) - x gives y + x * exp(-y) - 1.
+    //
+
+    Result.High = log(Significand);
+    Result.Low = 0.0;
+    Correction.High = Significand;
+    Correction.Low = 0.0;
+    Correction = TestVectorMultiply(TestVectorReferenceExp(-Result.High),
+                                    Correction);
+
+    Correction = TestVectorAdd(Correction, TestVectorTwoSum(-1.0, 0.0));
+    Result = TestVectorAdd(Result, Correction);
+    Correction = TestVectorTwoProduct(Exponent, MATH_VECTOR_LN2_HIGH);
+    Result = TestVectorAdd(Result, Correction);
+    Correction.High = Exponent * MATH_VECTOR_LN2_LOW;
+    Correction.Low = 0.0;
+    Result = TestVectorAdd(Result, Correction);
+    return Result;
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorTwoSum (
+    double Value1,
+    double Value2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds two doubles, returning the rounded sum and its exact
+    rounding error.
+
+Arguments:
+
+    Value1 - Supplies the first value.
+
+    Value2 - Supplies the second value.
+
+Return Value:
+
+    Returns the exact sum as a double-double.
+
+--*/
+
+{
+
+    double Adjusted;
+    MATH_DOUBLE_DOUBLE Result;
+
+    Result.High = Value1 + Value2;
+    Adjusted = Result.High - Value1;
+    Result.Low = (Value1 - (Result.High - Adjusted)) + (Value2 - Adjusted);
+    return Result;
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorTwoProduct (
+    double Value1,
+    double Value2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine multiplies two doubles, returning the rounded product and its
+    exact rounding error.
+
+Arguments:
+
+    Value1 - Supplies the first value.
+
+    Value2 - Supplies the second value.
+
+Return Value:
+
+    Returns the exact product as a double-double.
+
+--*/
+
+{
+
+    double High1;
+    double High2;
+    double Low1;
+    double Low2;
+    MATH_DOUBLE_DOUBLE Result;
+    double Split;
+
+    Split = MATH_VECTOR_SPLIT * Value1;
+    High1 = Split - (Split - Value1);
+    Low1 = Value1 - High1;
+    Split = MATH_VECTOR_SPLIT * Value2;
+    High2 = Split - (Split - Value2);
+    Low2 = Value2 - High2;
+    Result.High = Value1 * Value2;
+    Result.Low = (((High1 * High2) - Result.High) + (High1 * Low2) +
+                  (Low1 * High2)) + (Low1 * Low2);
+
+    return Result;
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorAdd (
+    MATH_DOUBLE_DOUBLE Value1,
+    MATH_DOUBLE_DOUBLE Value2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds two double-double values.
+
+Arguments:
+
+    Value1 - Supplies the first value.
+
+    Value2 - Supplies the second value.
+
+Return Value:
+
+    Returns the sum.
+
+--*/
+
+{
+
+    MATH_DOUBLE_DOUBLE Sum;
+
+    Sum = TestVectorTwoSum(Value1.High, Value2.High);
+    Sum.Low += Value1.Low + Value2.Low;
+    return TestVectorTwoSum(Sum.High, Sum.Low);
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorMultiply (
+    MATH_DOUBLE_DOUBLE Value1,
+    MATH_DOUBLE_DOUBLE Value2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine multiplies two double-double values.
+
+Arguments:
+
+    Value1 - Supplies the first value.
+
+    Value2 - Supplies the second value.
+
+Return Value:
+
+    Returns the product.
+
+--*/
+
+{
+
+    MATH_DOUBLE_DOUBLE Product;
+
+    Product = TestVectorTwoProduct(Value1.High, Value2.High);
+    Product.Low += (Value1.High * Value2.Low) + (Value1.Low * Value2.High);
+    return TestVectorTwoSum(Product.High, Product.Low);
+}
+
+MATH_DOUBLE_DOUBLE
+TestVectorDivide (
+    MATH_DOUBLE_DOUBLE Dividend,
+    double Divisor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine divides a double-double value by a double.
+
+Arguments:
+
+    Dividend - Supplies the value to divide.
+
+    Divisor - Supplies the value to divide by.
+
+Return Value:
+
+    Returns the quotient.
+
+--*/
+
+{
+
+    MATH_DOUBLE_DOUBLE Product;
+    double Quotient;
+    double Remainder;
+
+    Quotient = Dividend.High / Divisor;
+    Product = TestVectorTwoProduct(Quotient, Divisor);
+    Remainder = (((Dividend.High - Product.High) - Product.Low) +
+                 Dividend.Low) / Divisor;
+
+    return TestVectorTwoSum(Quotient, Remainder);
+}
+
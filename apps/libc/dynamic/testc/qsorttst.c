@@ -45,11 +45,17 @@ Module Name:
 //
 
 #define TEST_QUICKSORT_ARRAY_COUNT 1000
+#define TEST_MERGESORT_KEY_COUNT 50
 
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+typedef struct _TEST_MERGESORT_ELEMENT {
+    ULONG Key;
+    ULONG Order;
+} TEST_MERGESORT_ELEMENT, *PTEST_MERGESORT_ELEMENT;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -68,11 +74,23 @@ TestQuickSortCompare (
     const void *Right
     );
 
+ULONG
+TestMergeSortStability (
+    VOID
+    );
+
+int
+TestMergeSortCompare (
+    const void *Left,
+    const void *Right
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 ULONG TestQuickSortArray[TEST_QUICKSORT_ARRAY_COUNT];
+TEST_MERGESORT_ELEMENT TestMergeSortArray[TEST_QUICKSORT_ARRAY_COUNT];
 
 //
 // ------------------------------------------------------------------ Functions
@@ -185,6 +203,27 @@ Return Value:
 
     Case += 1;
 
+    //
+    // Arrange everything in an organ pipe, which defeats a simple median of
+    // three pivot.
+    //
+
+    for (Index = 0; Index < TEST_QUICKSORT_ARRAY_COUNT; Index += 1) {
+        if (Index < TEST_QUICKSORT_ARRAY_COUNT / 2) {
+            Array[Index] = Index * 2;
+
+        } else {
+            Array[Index] = ((TEST_QUICKSORT_ARRAY_COUNT - Index) * 2) - 1;
+        }
+    }
+
+    Failures += TestQuickSortCase(Case,
+                                  Array,
+                                  TEST_QUICKSORT_ARRAY_COUNT,
+                                  TRUE);
+
+    Case += 1;
+
     //
     // Fill it with random numbers that are very likely to repeat.
     //
@@ -229,6 +268,7 @@ Return Value:
                                   FALSE);
 
     Case += 1;
+    Failures += TestMergeSortStability();
     return Failures;
 }
 
@@ -317,6 +357,70 @@ Return Value:
     return 0;
 }
 
+ULONG
+TestMergeSortStability (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests that mergesort keeps elements with equal keys in their
+    original order.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of failures (zero or one).
+
+--*/
+
+{
+
+    PTEST_MERGESORT_ELEMENT Array;
+    ULONG Index;
+    int Status;
+
+    Array = TestMergeSortArray;
+    for (Index = 0; Index < TEST_QUICKSORT_ARRAY_COUNT; Index += 1) {
+        Array[Index].Key = rand() % TEST_MERGESORT_KEY_COUNT;
+        Array[Index].Order = Index;
+    }
+
+    Status = mergesort(Array,
+                       TEST_QUICKSORT_ARRAY_COUNT,
+                       sizeof(TEST_MERGESORT_ELEMENT),
+                       TestMergeSortCompare);
+
+    if (Status != 0) {
+        printf("Error: mergesort failed.\n");
+        return 1;
+    }
+
+    for (Index = 1; Index < TEST_QUICKSORT_ARRAY_COUNT; Index += 1) {
+        if ((Array[Index].Key < Array[Index - 1].Key) ||
+            ((Array[Index].Key == Array[Index - 1].Key) &&
+             (Array[Index].Order < Array[Index - 1].Order))) {
+
+            printf("Error: mergesort index %d had key %d order %d, but "
+                   "previous was key %d order %d.\n",
+                   Index,
+                   Array[Index].Key,
+                   Array[Index].Order,
+                   Array[Index - 1].Key,
+                   Array[Index - 1].Order);
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 int
 TestQuickSortCompare (
     const void *Left,
@@ -365,3 +469,50 @@ Return Value:
     return 0;
 }
 
+int
+TestMergeSortCompare (
+    const void *Left,
+    const void *Right
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two mergesort test array elements by key only.
+
+Arguments:
+
+    Left - Supplies a pointer into the array of the left side of the comparison.
+
+    Right - Supplies a pointer into the array of the right side of the
+        comparison.
+
+Return Value:
+
+    <0 if the left is less than the right.
+
+    0 if the two elements are equal.
+
+    >0 if the left element is greater than the right.
+
+--*/
+
+{
+
+    PTEST_MERGESORT_ELEMENT LeftElement;
+    PTEST_MERGESORT_ELEMENT RightElement;
+
+    LeftElement = (PTEST_MERGESORT_ELEMENT)Left;
+    RightElement = (PTEST_MERGESORT_ELEMENT)Right;
+    if (LeftElement->Key < RightElement->Key) {
+        return -1;
+    }
+
+    if (LeftElement->Key > RightElement->Key) {
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -644,6 +644,136 @@ REGEX_EXECUTION_TEST_CASE RegexExecutionTestCases[] = {
         REG_NOMATCH,
         {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
     },
+
+    //
+    // A trailing dollar sign should apply to every way of matching the
+    // expression, not just the first one tried.
+    //
+
+    {
+
+        "ab*\\(bc\\)*$", 0,
+        "abc", 0,
+        0,
+        {{0, 3}, {1, 3}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    //
+    // An interval expression needs at least its minimum number of iterations.
+    //
+
+    {
+
+        "(b+|ab){2,3}", REG_EXTENDED,
+        "xab bBxac", 0,
+        REG_NOMATCH,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    //
+    // Nested repetition that fails to match should fail quickly.
+    //
+
+    {
+
+        "(a|aa)*b", REG_EXTENDED,
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 0,
+        REG_NOMATCH,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "(a|aa)*b", REG_EXTENDED,
+        "aaaaab", 0,
+        0,
+        {{0, 6}, {4, 5}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    //
+    // An empty alternative matches the empty string wherever it appears, and
+    // the answer shouldn't depend on whether match offsets were requested.
+    //
+
+    {
+
+        "a(|b)c", REG_EXTENDED,
+        "ac", 0,
+        0,
+        {{0, 2}, {1, 1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "a(|b)c", REG_EXTENDED | REG_NOSUB,
+        "ac", 0,
+        0,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "a(|b)c", REG_EXTENDED,
+        "adc", 0,
+        REG_NOMATCH,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "a(|b)c", REG_EXTENDED | REG_NOSUB,
+        "adc", 0,
+        REG_NOMATCH,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "|ab", REG_EXTENDED,
+        "xyz", 0,
+        0,
+        {{0, 0}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "|ab", REG_EXTENDED | REG_NOSUB,
+        "xyz", 0,
+        0,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "b||ab", REG_EXTENDED,
+        "", 0,
+        0,
+        {{0, 0}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "b||ab", REG_EXTENDED | REG_NOSUB,
+        "", 0,
+        0,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "x(a||b)y", REG_EXTENDED,
+        "xy", 0,
+        0,
+        {{0, 2}, {1, 1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
+
+    {
+
+        "x(a||b)y", REG_EXTENDED | REG_NOSUB,
+        "xy", 0,
+        0,
+        {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}},
+    },
 };
 
 //
@@ -885,17 +1015,19 @@ Return Value:
                      Match,
                      Case->InputFlags);
 
+    Status = TRUE;
     if (Result != Case->ExecutionResult) {
         printf("Error: regexec returned %d instead of expected result %d.\n",
                Result,
                Case->ExecutionResult);
+
+        Status = FALSE;
     }
 
     //
     // Compare the matches.
     //
 
-    Status = TRUE;
     for (MatchIndex = 0; MatchIndex < REGEX_TEST_MATCH_COUNT; MatchIndex += 1) {
         if ((Match[MatchIndex].rm_so !=
              Case->ExpectedMatch[MatchIndex].rm_so) ||
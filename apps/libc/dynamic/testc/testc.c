@@ -118,6 +118,12 @@ Return Value:
         TotalFailures += Failures;
     }
 
+    Failures = TestMathVector();
+    if (Failures != 0) {
+        printf("%d math vector failures.\n", Failures);
+        TotalFailures += Failures;
+    }
+
     Failures = TestGetopt();
     if (Failures != 0) {
         printf("%d getopt failures.\n", Failures);
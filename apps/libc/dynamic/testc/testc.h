@@ -149,6 +149,29 @@ Return Value:
 
 --*/
 
+ULONG
+TestMathVector (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the entry point for the batch math routine and
+    math kernel accuracy test. It also reports the throughput of the scalar
+    and batch routines, which does not contribute to the failure count.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
 ULONG
 TestGetopt (
     VOID
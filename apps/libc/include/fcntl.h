@@ -115,6 +115,17 @@ extern "C" {
 // There's no need for 64-bit versions, since off_t is always 64 bits.
 //
 
+//
+// Define fallocate mode flags.
+//
+
+//
+// Allocate the space without changing the size of the file, even if the
+// allocated region extends beyond the end of the file.
+//
+
+#define FALLOC_FL_KEEP_SIZE 0x00000001
+
 #define F_GETLK64 F_GETLK
 #define F_SETLK64 F_SETLK
 #define F_SETLKW64 F_SETLKW
@@ -479,6 +490,76 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+posix_fallocate (
+    int FileDescriptor,
+    off_t Offset,
+    off_t Length
+    );
+
+/*++
+
+Routine Description:
+
+    This routine ensures that disk space is allocated for the given region of
+    a file. If the region extends beyond the end of the file, the file size is
+    increased to cover it. Subsequent writes to the region will not fail for
+    lack of space.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor to allocate space for. This
+        must be open for writing.
+
+    Offset - Supplies the byte offset of the start of the region.
+
+    Length - Supplies the size of the region in bytes.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+LIBC_API
+int
+fallocate (
+    int FileDescriptor,
+    int Mode,
+    off_t Offset,
+    off_t Length
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates disk space for the given region of a file.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor to allocate space for. This
+        must be open for writing.
+
+    Mode - Supplies a bitmask of flags governing the allocation. See
+        FALLOC_FL_* definitions. If zero, the file size is increased if the
+        region extends beyond the end of the file.
+
+    Offset - Supplies the byte offset of the start of the region.
+
+    Length - Supplies the size of the region in bytes.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
 #ifdef __cplusplus
 
 }
@@ -2170,6 +2170,202 @@ Return Value:
 
 --*/
 
+LIBC_API
+void
+vexp (
+    double *Results,
+    const double *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the base e exponential of each value in an array. The
+    results are identical to calling exp on each element, but the work is done
+    in a tight loop that avoids the per-call overhead and special case checks
+    where possible. This routine is not part of the C standard.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to raise e to.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+vexpf (
+    float *Results,
+    const float *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the base e exponential of each value in an array. The
+    results are identical to calling expf on each element, but the work is done
+    in a tight loop that avoids the per-call overhead and special case checks
+    where possible. This routine is not part of the C standard.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to raise e to.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+vlog (
+    double *Results,
+    const double *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the natural logarithm of each value in an array. The
+    results are identical to calling log on each element, but the work is done
+    in a tight loop that avoids the per-call overhead and special case checks
+    where possible. This routine is not part of the C standard.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to take the logarithm
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+vlogf (
+    float *Results,
+    const float *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the natural logarithm of each value in an array. The
+    results are identical to calling logf on each element, but the work is done
+    in a tight loop that avoids the per-call overhead and special case checks
+    where possible. This routine is not part of the C standard.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to take the logarithm
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+vsqrt (
+    double *Results,
+    const double *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the square root of each value in an array. The
+    results are identical to calling sqrt on each element, but the work is done
+    in a tight loop that avoids the per-call overhead and special case checks
+    where possible. This routine is not part of the C standard.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to get the square roots
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+vsqrtf (
+    float *Results,
+    const float *Values,
+    size_t Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine computes the square root of each value in an array. The
+    results are identical to calling sqrtf on each element, but the work is
+    done in a tight loop that avoids the per-call overhead and special case
+    checks where possible. This routine is not part of the C standard.
+
+Arguments:
+
+    Results - Supplies a pointer where the results will be returned. This may
+        be the same as the values array.
+
+    Values - Supplies a pointer to the array of values to get the square roots
+        of.
+
+    Count - Supplies the number of elements in each array.
+
+Return Value:
+
+    None.
+
+--*/
+
 #ifdef __cplusplus
 
 }
@@ -788,6 +788,86 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+mergesort (
+    void *ArrayBase,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sorts an array of items in place using a merge sort. Unlike
+    qsort, the sort is stable: elements that compare equal keep their original
+    relative order. It needs temporary memory of about half the array size.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items to sort.
+
+    ElementCount - Supplies the number of elements in the array.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to a function that will be used to
+        compare elements. The function takes in two pointers that will point
+        within the array. It returns less than zero if the first element is
+        less than the second, zero if the first element is equal to the second,
+        and greater than zero if the first element is greater than the second.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+psort (
+    void *ArrayBase,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sorts an array of items in place. The sort is stable, like
+    mergesort. If the array is large and more than one processor is online,
+    the array is split into chunks that are sorted and then merged on
+    separate threads, so the compare function must be safe to call from
+    several threads at once.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items to sort.
+
+    ElementCount - Supplies the number of elements in the array.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to a function that will be used to
+        compare elements. The function takes in two pointers that will point
+        within the array. It returns less than zero if the first element is
+        less than the second, zero if the first element is equal to the second,
+        and greater than zero if the first element is greater than the second.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
 LIBC_API
 int
 atoi (
@@ -35,6 +35,36 @@ Module Name:
 // --------------------------------------------------------------------- Macros
 //
 
+//
+// This macro returns the block header for a given heap allocation.
+//
+
+#define OS_HEAP_BLOCK_HEADER(_Memory) (((POS_HEAP_BLOCK)(_Memory)) - 1)
+
+//
+// This macro converts an allocation size into a cache size class. Class zero
+// is reserved for blocks that do not live in a thread cache.
+//
+
+#define OS_HEAP_SIZE_TO_CLASS(_Size)                                        \
+    ((((_Size) + OS_HEAP_CACHE_GRANULARITY - 1) /                           \
+      OS_HEAP_CACHE_GRANULARITY) +                                          \
+     ((_Size) == 0))
+
+//
+// This macro returns the usable size of blocks in the given size class.
+//
+
+#define OS_HEAP_CLASS_TO_SIZE(_Class) ((_Class) * OS_HEAP_CACHE_GRANULARITY)
+
+//
+// This macro returns the arena a block was carved from.
+//
+
+#define OS_HEAP_BLOCK_ARENA(_Block)                                         \
+    (&(OsHeapArenas[((_Block)->Flags & OS_HEAP_BLOCK_ARENA_MASK) >>          \
+                    OS_HEAP_BLOCK_ARENA_SHIFT]))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -47,14 +77,201 @@ Module Name:
 #define SYSTEM_HEAP_MAGIC 0x6C6F6F50 // 'looP'
 #define SYSTEM_HEAP_DIRECT_ALLOCATION_THRESHOLD (256 * _1MB)
 
+//
+// Define the number of independently locked arenas backing the heap.
+//
+
+#define OS_HEAP_ARENA_COUNT 4
+
+//
+// Define the thread cache size classes. Allocations up to the maximum size
+// are rounded up to the granularity and served out of per-thread free lists.
+//
+
+#define OS_HEAP_CACHE_GRANULARITY 16
+#define OS_HEAP_CACHE_CLASS_COUNT 32
+#define OS_HEAP_CACHE_MAX_SIZE \
+    (OS_HEAP_CACHE_GRANULARITY * OS_HEAP_CACHE_CLASS_COUNT)
+
+//
+// Define how many blocks are pulled from an arena when a cache list runs dry,
+// how long a list may grow before it is trimmed, and how much is trimmed.
+//
+
+#define OS_HEAP_CACHE_REFILL_COUNT 16
+#define OS_HEAP_CACHE_LIST_LIMIT 64
+#define OS_HEAP_CACHE_FLUSH_COUNT 32
+
+//
+// Define the block header flags.
+//
+
+#define OS_HEAP_BLOCK_CLASS_MASK 0x000000FF
+#define OS_HEAP_BLOCK_ARENA_MASK 0x0000FF00
+#define OS_HEAP_BLOCK_ARENA_SHIFT 8
+#define OS_HEAP_BLOCK_ALIGNED 0x00010000
+#define OS_HEAP_BLOCK_FREE 0x00020000
+#define OS_HEAP_BLOCK_MAGIC_MASK 0xFF000000
+#define OS_HEAP_BLOCK_MAGIC 0xA5000000
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure stores the header that precedes every allocation handed
+    out by the OS heap. It is sized to preserve the natural heap alignment.
+
+Members:
+
+    Owner - Stores the owning thread cache for cached small blocks, the
+        original unaligned allocation for aligned blocks, or NULL for all
+        other blocks.
+
+    Flags - Stores the size class, arena index, and state of the block. See
+        OS_HEAP_BLOCK_* definitions.
+
+--*/
+
+typedef struct _OS_HEAP_BLOCK {
+    PVOID Owner;
+    UINTN Flags;
+} OS_HEAP_BLOCK, *POS_HEAP_BLOCK;
+
+/*++
+
+Structure Description:
+
+    This structure stores an independently locked region of the heap.
+
+Members:
+
+    Lock - Stores the lock serializing access to the arena.
+
+    Heap - Stores the RTL heap backing the arena.
+
+--*/
+
+typedef struct _OS_HEAP_ARENA {
+    OS_LOCK Lock;
+    MEMORY_HEAP Heap;
+} OS_HEAP_ARENA, *POS_HEAP_ARENA;
+
+/*++
+
+Structure Description:
+
+    This structure stores a singly linked list of free blocks of one size
+    class. The link lives in the first word of each free block.
+
+Members:
+
+    Head - Stores a pointer to the first free block.
+
+    Count - Stores the number of blocks on the list.
+
+--*/
+
+typedef struct _OS_HEAP_CACHE_LIST {
+    PVOID Head;
+    UINTN Count;
+} OS_HEAP_CACHE_LIST, *POS_HEAP_CACHE_LIST;
+
+/*++
+
+Structure Description:
+
+    This structure stores a per-thread cache of small blocks. Only the owning
+    thread touches the lists. Other threads return blocks by pushing them
+    onto the remote free list, which the owner collects lazily.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous idle caches when the
+        cache is not owned by any thread.
+
+    RemoteFree - Stores the head of the lock-free list of blocks freed by
+        other threads.
+
+    Parked - Stores a boolean indicating whether the cache is sitting on the
+        idle list with no owner. Blocks freed into a parked cache go straight
+        back to their arenas, since nobody would collect them.
+
+    ArenaIndex - Stores the index of the arena this cache prefers.
+
+    Lists - Stores the free lists, one per size class.
+
+    Statistics - Stores the cache statistics.
+
+--*/
+
+typedef struct _OS_HEAP_THREAD_CACHE {
+    LIST_ENTRY ListEntry;
+    PVOID volatile RemoteFree;
+    BOOL volatile Parked;
+    ULONG ArenaIndex;
+    OS_HEAP_CACHE_LIST Lists[OS_HEAP_CACHE_CLASS_COUNT];
+    OS_HEAP_CACHE_STATISTICS Statistics;
+} OS_HEAP_THREAD_CACHE, *POS_HEAP_THREAD_CACHE;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+POS_HEAP_THREAD_CACHE
+OspHeapGetThreadCache (
+    VOID
+    );
+
+POS_HEAP_THREAD_CACHE
+OspHeapCreateThreadCache (
+    VOID
+    );
+
+PVOID
+OspHeapCacheAllocate (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Tag
+    );
+
+VOID
+OspHeapRefillCache (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Tag
+    );
+
+VOID
+OspHeapFlushCacheList (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Count
+    );
+
+VOID
+OspHeapCollectRemoteFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    );
+
+VOID
+OspHeapDrainRemoteFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    );
+
+POS_HEAP_ARENA
+OspHeapAcquireArena (
+    POS_HEAP_THREAD_CACHE Cache
+    );
+
+BOOL
+OspHeapCheckBlock (
+    POS_HEAP_BLOCK Block
+    );
+
 PVOID
 OspHeapExpand (
     PMEMORY_HEAP Heap,
@@ -81,11 +298,31 @@ OspHeapCorruption (
 //
 
 //
-// Store the primary heap.
+// Store the arenas backing the heap.
+//
+
+OS_HEAP_ARENA OsHeapArenas[OS_HEAP_ARENA_COUNT];
+
+//
+// Store the list of thread caches whose threads have exited, waiting to be
+// picked up by new threads.
+//
+
+LIST_ENTRY OsHeapIdleCacheList;
+OS_LOCK OsHeapIdleCacheLock;
+
+//
+// Store the counter used to spread new thread caches across the arenas.
 //
 
-MEMORY_HEAP OsHeap;
-OS_LOCK OsHeapLock;
+ULONG OsHeapNextArena;
+
+//
+// Store whether thread caches may be used yet. This is set once the thread
+// pointer is valid.
+//
+
+BOOL OsHeapThreadCachesEnabled;
 
 //
 // Store the native page shift and mask.
@@ -127,12 +364,31 @@ Return Value:
 
 {
 
-    PVOID Allocation;
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    POS_HEAP_THREAD_CACHE Cache;
 
-    OsAcquireLock(&OsHeapLock);
-    Allocation = RtlHeapAllocate(&OsHeap, Size, Tag);
-    OsReleaseLock(&OsHeapLock);
-    return Allocation;
+    Cache = OspHeapGetThreadCache();
+    if ((Cache != NULL) && (Size <= OS_HEAP_CACHE_MAX_SIZE)) {
+        return OspHeapCacheAllocate(Cache, OS_HEAP_SIZE_TO_CLASS(Size), Tag);
+    }
+
+    if (Size > MAX_UINTN - sizeof(OS_HEAP_BLOCK)) {
+        return NULL;
+    }
+
+    Arena = OspHeapAcquireArena(Cache);
+    Block = RtlHeapAllocate(&(Arena->Heap), Size + sizeof(OS_HEAP_BLOCK), Tag);
+    OsReleaseLock(&(Arena->Lock));
+    if (Block == NULL) {
+        return NULL;
+    }
+
+    Block->Owner = NULL;
+    Block->Flags = OS_HEAP_BLOCK_MAGIC |
+                   ((Arena - OsHeapArenas) << OS_HEAP_BLOCK_ARENA_SHIFT);
+
+    return Block + 1;
 }
 
 OS_API
@@ -159,9 +415,97 @@ Return Value:
 
 {
 
-    OsAcquireLock(&OsHeapLock);
-    RtlHeapFree(&OsHeap, Memory);
-    OsReleaseLock(&OsHeapLock);
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    POS_HEAP_THREAD_CACHE Cache;
+    UINTN Class;
+    PVOID Head;
+    POS_HEAP_CACHE_LIST List;
+    POS_HEAP_THREAD_CACHE Owner;
+    PVOID Region;
+
+    if (Memory == NULL) {
+        return;
+    }
+
+    Block = OS_HEAP_BLOCK_HEADER(Memory);
+    if (OspHeapCheckBlock(Block) == FALSE) {
+        return;
+    }
+
+    Class = Block->Flags & OS_HEAP_BLOCK_CLASS_MASK;
+    if (Class != 0) {
+        Block->Flags |= OS_HEAP_BLOCK_FREE;
+        Owner = Block->Owner;
+        Cache = OspHeapGetThreadCache();
+
+        //
+        // Blocks owned by this thread go straight back on the local list.
+        //
+
+        if (Owner == Cache) {
+            List = &(Cache->Lists[Class - 1]);
+            *((PVOID *)Memory) = List->Head;
+            List->Head = Memory;
+            List->Count += 1;
+            Cache->Statistics.LocalFrees += 1;
+            Cache->Statistics.CachedBlocks += 1;
+            Cache->Statistics.CachedBytes += OS_HEAP_CLASS_TO_SIZE(Class);
+            if (List->Count > OS_HEAP_CACHE_LIST_LIMIT) {
+                OspHeapFlushCacheList(Cache, Class, OS_HEAP_CACHE_FLUSH_COUNT);
+            }
+
+            return;
+        }
+
+        //
+        // Blocks owned by another thread get pushed onto that thread's remote
+        // free list without taking any locks.
+        //
+
+        if (Cache != NULL) {
+            Cache->Statistics.RemoteFrees += 1;
+        }
+
+        if (Owner->Parked == FALSE) {
+            do {
+                Head = Owner->RemoteFree;
+                *((PVOID *)Memory) = Head;
+
+            } while (RtlAtomicCompareExchange(&(Owner->RemoteFree),
+                                              (UINTN)Memory,
+                                              (UINTN)Head) != (UINTN)Head);
+
+            //
+            // If the owner exited and parked the cache in the meantime, it
+            // may already have done its final collection. Drain the list so
+            // the block is not stranded.
+            //
+
+            if (Owner->Parked == FALSE) {
+                return;
+            }
+
+            OspHeapDrainRemoteFrees(Owner);
+            return;
+        }
+
+        Arena = OS_HEAP_BLOCK_ARENA(Block);
+        OsAcquireLock(&(Arena->Lock));
+        RtlHeapFree(&(Arena->Heap), Block);
+        OsReleaseLock(&(Arena->Lock));
+        return;
+    }
+
+    Region = Block;
+    if ((Block->Flags & OS_HEAP_BLOCK_ALIGNED) != 0) {
+        Region = Block->Owner;
+    }
+
+    Arena = OS_HEAP_BLOCK_ARENA(Block);
+    OsAcquireLock(&(Arena->Lock));
+    RtlHeapFree(&(Arena->Heap), Region);
+    OsReleaseLock(&(Arena->Lock));
     return;
 }
 
@@ -203,10 +547,78 @@ Return Value:
 {
 
     PVOID Allocation;
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    UINTN Class;
+    UINTN Offset;
+    PVOID Region;
+
+    if (Memory == NULL) {
+        return OsHeapAllocate(NewSize, Tag);
+    }
+
+    if (NewSize == 0) {
+        OsHeapFree(Memory);
+        return NULL;
+    }
+
+    Block = OS_HEAP_BLOCK_HEADER(Memory);
+    if (OspHeapCheckBlock(Block) == FALSE) {
+        return NULL;
+    }
+
+    //
+    // Cached blocks have a fixed size. If the new size still fits then
+    // there's nothing to do, otherwise move to a fresh allocation.
+    //
+
+    Class = Block->Flags & OS_HEAP_BLOCK_CLASS_MASK;
+    if (Class != 0) {
+        if (NewSize <= OS_HEAP_CLASS_TO_SIZE(Class)) {
+            return Memory;
+        }
+
+        Allocation = OsHeapAllocate(NewSize, Tag);
+        if (Allocation != NULL) {
+            RtlCopyMemory(Allocation, Memory, OS_HEAP_CLASS_TO_SIZE(Class));
+            OsHeapFree(Memory);
+        }
+
+        return Allocation;
+    }
+
+    //
+    // Arena blocks are resized in place by the RTL heap, header and all. For
+    // aligned blocks the whole region including the alignment padding is
+    // resized, and the data stays at the same offset within it. Alignment is
+    // not preserved across a reallocation.
+    //
+
+    Region = Block;
+    Offset = sizeof(OS_HEAP_BLOCK);
+    if ((Block->Flags & OS_HEAP_BLOCK_ALIGNED) != 0) {
+        Region = Block->Owner;
+        Offset = Memory - Region;
+    }
+
+    if (NewSize > MAX_UINTN - Offset) {
+        return NULL;
+    }
+
+    Arena = OS_HEAP_BLOCK_ARENA(Block);
+    OsAcquireLock(&(Arena->Lock));
+    Region = RtlHeapReallocate(&(Arena->Heap), Region, NewSize + Offset, Tag);
+    OsReleaseLock(&(Arena->Lock));
+    if (Region == NULL) {
+        return NULL;
+    }
+
+    Allocation = Region + Offset;
+    Block = OS_HEAP_BLOCK_HEADER(Allocation);
+    if ((Block->Flags & OS_HEAP_BLOCK_ALIGNED) != 0) {
+        Block->Owner = Region;
+    }
 
-    OsAcquireLock(&OsHeapLock);
-    Allocation = RtlHeapReallocate(&OsHeap, Memory, NewSize, Tag);
-    OsReleaseLock(&OsHeapLock);
     return Allocation;
 }
 
@@ -244,12 +656,67 @@ Return Value:
 
 {
 
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    PVOID Region;
+    ULONG Shift;
     KSTATUS Status;
 
-    OsAcquireLock(&OsHeapLock);
-    Status = RtlHeapAlignedAllocate(&OsHeap, Memory, Alignment, Size, Tag);
-    OsReleaseLock(&OsHeapLock);
-    return Status;
+    *Memory = NULL;
+
+    //
+    // Every allocation is already aligned to the size of the block header, so
+    // small alignments need nothing special.
+    //
+
+    if ((POWER_OF_2(Alignment)) && (Alignment <= sizeof(OS_HEAP_BLOCK))) {
+        *Memory = OsHeapAllocate(Size, Tag);
+        if (*Memory == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        return STATUS_SUCCESS;
+    }
+
+    if (!POWER_OF_2(Alignment)) {
+        Shift = RtlCountLeadingZeros(Alignment);
+        if (Shift == 0) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        Shift = (sizeof(UINTN) * BITS_PER_BYTE) - Shift;
+        Alignment = (UINTN)1 << Shift;
+    }
+
+    if (Size > MAX_UINTN - Alignment) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    //
+    // Allocate an extra alignment's worth up front so that the header can sit
+    // directly below the aligned pointer handed back to the caller.
+    //
+
+    Arena = OspHeapAcquireArena(OspHeapGetThreadCache());
+    Status = RtlHeapAlignedAllocate(&(Arena->Heap),
+                                    &Region,
+                                    Alignment,
+                                    Size + Alignment,
+                                    Tag);
+
+    OsReleaseLock(&(Arena->Lock));
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    *Memory = Region + Alignment;
+    Block = OS_HEAP_BLOCK_HEADER(*Memory);
+    Block->Owner = Region;
+    Block->Flags = OS_HEAP_BLOCK_MAGIC |
+                   OS_HEAP_BLOCK_ALIGNED |
+                   ((Arena - OsHeapArenas) << OS_HEAP_BLOCK_ARENA_SHIFT);
+
+    return STATUS_SUCCESS;
 }
 
 OS_API
@@ -277,12 +744,61 @@ Return Value:
 
 {
 
-    OsAcquireLock(&OsHeapLock);
-    RtlValidateHeap(&OsHeap, NULL);
-    OsReleaseLock(&OsHeapLock);
+    POS_HEAP_ARENA Arena;
+    ULONG Index;
+
+    for (Index = 0; Index < OS_HEAP_ARENA_COUNT; Index += 1) {
+        Arena = &(OsHeapArenas[Index]);
+        OsAcquireLock(&(Arena->Lock));
+        RtlValidateHeap(&(Arena->Heap), NULL);
+        OsReleaseLock(&(Arena->Lock));
+    }
+
     return;
 }
 
+OS_API
+KSTATUS
+OsHeapGetThreadCacheStatistics (
+    POS_HEAP_CACHE_STATISTICS Statistics
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns statistics about the current thread's small block
+    heap cache.
+
+Arguments:
+
+    Statistics - Supplies a pointer where the statistics will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_INITIALIZED if thread caching is not active for this thread.
+
+--*/
+
+{
+
+    POS_HEAP_THREAD_CACHE Cache;
+
+    Cache = OspHeapGetThreadCache();
+    if (Cache == NULL) {
+        return STATUS_NOT_INITIALIZED;
+    }
+
+    Cache->Statistics.ArenaIndex = Cache->ArenaIndex;
+    RtlCopyMemory(Statistics,
+                  &(Cache->Statistics),
+                  sizeof(OS_HEAP_CACHE_STATISTICS));
+
+    return STATUS_SUCCESS;
+}
+
 VOID
 OspInitializeMemory (
     VOID
@@ -306,22 +822,91 @@ Return Value:
 
 {
 
+    POS_HEAP_ARENA Arena;
     ULONG Flags;
+    ULONG Index;
 
-    OsInitializeLockDefault(&OsHeapLock);
     OsPageSize = OsEnvironment->StartData->PageSize;
     OsPageShift = RtlCountTrailingZeros(OsPageSize);
     Flags = MEMORY_HEAP_FLAG_NO_PARTIAL_FREES;
-    RtlHeapInitialize(&OsHeap,
-                      OspHeapExpand,
-                      OspHeapContract,
-                      OspHeapCorruption,
-                      SYSTEM_HEAP_MINIMUM_EXPANSION_PAGES << OsPageShift,
-                      OsPageSize,
-                      SYSTEM_HEAP_MAGIC,
-                      Flags);
-
-    OsHeap.DirectAllocationThreshold = SYSTEM_HEAP_DIRECT_ALLOCATION_THRESHOLD;
+    for (Index = 0; Index < OS_HEAP_ARENA_COUNT; Index += 1) {
+        Arena = &(OsHeapArenas[Index]);
+        OsInitializeLockDefault(&(Arena->Lock));
+        RtlHeapInitialize(&(Arena->Heap),
+                          OspHeapExpand,
+                          OspHeapContract,
+                          OspHeapCorruption,
+                          SYSTEM_HEAP_MINIMUM_EXPANSION_PAGES << OsPageShift,
+                          OsPageSize,
+                          SYSTEM_HEAP_MAGIC,
+                          Flags);
+
+        Arena->Heap.DirectAllocationThreshold =
+                                       SYSTEM_HEAP_DIRECT_ALLOCATION_THRESHOLD;
+    }
+
+    INITIALIZE_LIST_HEAD(&OsHeapIdleCacheList);
+    OsInitializeLockDefault(&OsHeapIdleCacheLock);
+    return;
+}
+
+VOID
+OspHeapReleaseThreadCache (
+    PTHREAD_CONTROL_BLOCK ThreadControlBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a thread's heap cache to the arenas and parks the
+    cache structure for reuse by a future thread. The owning thread must not
+    be allocating concurrently.
+
+Arguments:
+
+    ThreadControlBlock - Supplies a pointer to the thread whose cache should be
+        released.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_THREAD_CACHE Cache;
+    UINTN Class;
+
+    Cache = ThreadControlBlock->HeapCache;
+    if (Cache == NULL) {
+        return;
+    }
+
+    ThreadControlBlock->HeapCache = NULL;
+
+    //
+    // Mark the cache parked before the final collection, so that any frees
+    // from other threads from here on go straight to the arenas. The atomic
+    // exchange in the collection orders the two.
+    //
+
+    Cache->Parked = TRUE;
+    OspHeapCollectRemoteFrees(Cache);
+    for (Class = 1; Class <= OS_HEAP_CACHE_CLASS_COUNT; Class += 1) {
+        OspHeapFlushCacheList(Cache, Class, MAX_UINTN);
+    }
+
+    //
+    // The cache structure itself can never be freed, since blocks it handed
+    // out may still be freed remotely by other threads. Park it so the next
+    // new thread can adopt it.
+    //
+
+    OsAcquireLock(&OsHeapIdleCacheLock);
+    INSERT_BEFORE(&(Cache->ListEntry), &OsHeapIdleCacheList);
+    OsReleaseLock(&OsHeapIdleCacheLock);
     return;
 }
 
@@ -329,6 +914,525 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+POS_HEAP_THREAD_CACHE
+OspHeapGetThreadCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current thread's heap cache, creating it if
+    needed.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the thread cache on success.
+
+    NULL if the thread pointer is not yet set up or no cache could be created.
+
+--*/
+
+{
+
+    POS_HEAP_THREAD_CACHE Cache;
+    PTHREAD_CONTROL_BLOCK ThreadControlBlock;
+
+    if (OsHeapThreadCachesEnabled == FALSE) {
+        return NULL;
+    }
+
+    ThreadControlBlock = OspGetThreadControlBlock();
+    if (ThreadControlBlock == NULL) {
+        return NULL;
+    }
+
+    Cache = ThreadControlBlock->HeapCache;
+    if (Cache == NULL) {
+        Cache = OspHeapCreateThreadCache();
+        ThreadControlBlock->HeapCache = Cache;
+    }
+
+    return Cache;
+}
+
+POS_HEAP_THREAD_CACHE
+OspHeapCreateThreadCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a thread cache, reusing one left behind by an exited
+    thread if possible.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the new thread cache on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_THREAD_CACHE Cache;
+
+    Cache = NULL;
+    OsAcquireLock(&OsHeapIdleCacheLock);
+    if (!LIST_EMPTY(&OsHeapIdleCacheList)) {
+        Cache = LIST_VALUE(OsHeapIdleCacheList.Next,
+                           OS_HEAP_THREAD_CACHE,
+                           ListEntry);
+
+        LIST_REMOVE(&(Cache->ListEntry));
+        Cache->Parked = FALSE;
+    }
+
+    OsReleaseLock(&OsHeapIdleCacheLock);
+    if (Cache == NULL) {
+        Arena = &(OsHeapArenas[0]);
+        OsAcquireLock(&(Arena->Lock));
+        Cache = RtlHeapAllocate(&(Arena->Heap),
+                                sizeof(OS_HEAP_THREAD_CACHE),
+                                SYSTEM_HEAP_MAGIC);
+
+        OsReleaseLock(&(Arena->Lock));
+        if (Cache == NULL) {
+            return NULL;
+        }
+
+        RtlZeroMemory(Cache, sizeof(OS_HEAP_THREAD_CACHE));
+    }
+
+    RtlZeroMemory(&(Cache->Statistics), sizeof(OS_HEAP_CACHE_STATISTICS));
+    Cache->ArenaIndex = RtlAtomicAdd32(&OsHeapNextArena, 1) %
+                        OS_HEAP_ARENA_COUNT;
+
+    return Cache;
+}
+
+PVOID
+OspHeapCacheAllocate (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a small block out of the given thread cache.
+
+Arguments:
+
+    Cache - Supplies a pointer to the current thread's cache.
+
+    Class - Supplies the size class to allocate from.
+
+    Tag - Supplies the tag to use if the cache needs to be refilled.
+
+Return Value:
+
+    Returns a pointer to the allocation on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PVOID Allocation;
+    POS_HEAP_BLOCK Block;
+    POS_HEAP_CACHE_LIST List;
+
+    List = &(Cache->Lists[Class - 1]);
+    if ((List->Head == NULL) && (Cache->RemoteFree != NULL)) {
+        OspHeapCollectRemoteFrees(Cache);
+    }
+
+    if (List->Head != NULL) {
+        Cache->Statistics.CacheHits += 1;
+
+    } else {
+        Cache->Statistics.CacheMisses += 1;
+        OspHeapRefillCache(Cache, Class, Tag);
+        if (List->Head == NULL) {
+            return NULL;
+        }
+    }
+
+    Allocation = List->Head;
+    List->Head = *((PVOID *)Allocation);
+    List->Count -= 1;
+    Cache->Statistics.CachedBlocks -= 1;
+    Cache->Statistics.CachedBytes -= OS_HEAP_CLASS_TO_SIZE(Class);
+    Block = OS_HEAP_BLOCK_HEADER(Allocation);
+    Block->Flags &= ~OS_HEAP_BLOCK_FREE;
+    return Allocation;
+}
+
+VOID
+OspHeapRefillCache (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pulls a batch of blocks for the given size class out of an
+    arena, taking the arena lock only once.
+
+Arguments:
+
+    Cache - Supplies a pointer to the current thread's cache.
+
+    Class - Supplies the size class to refill.
+
+    Tag - Supplies the tag to mark the new blocks with.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    UINTN Count;
+    UINTN Flags;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Memory;
+    UINTN Size;
+
+    List = &(Cache->Lists[Class - 1]);
+    Size = OS_HEAP_CLASS_TO_SIZE(Class) + sizeof(OS_HEAP_BLOCK);
+    Arena = OspHeapAcquireArena(Cache);
+    Flags = OS_HEAP_BLOCK_MAGIC | OS_HEAP_BLOCK_FREE | Class |
+            ((Arena - OsHeapArenas) << OS_HEAP_BLOCK_ARENA_SHIFT);
+
+    for (Count = 0; Count < OS_HEAP_CACHE_REFILL_COUNT; Count += 1) {
+        Block = RtlHeapAllocate(&(Arena->Heap), Size, Tag);
+        if (Block == NULL) {
+            break;
+        }
+
+        Block->Owner = Cache;
+        Block->Flags = Flags;
+        Memory = Block + 1;
+        *((PVOID *)Memory) = List->Head;
+        List->Head = Memory;
+    }
+
+    OsReleaseLock(&(Arena->Lock));
+    List->Count += Count;
+    Cache->Statistics.CachedBlocks += Count;
+    Cache->Statistics.CachedBytes += Count * OS_HEAP_CLASS_TO_SIZE(Class);
+    return;
+}
+
+VOID
+OspHeapFlushCacheList (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns blocks from a thread cache list to the arenas they
+    came from.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to trim.
+
+    Class - Supplies the size class of the list to trim.
+
+    Count - Supplies the maximum number of blocks to return.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    POS_HEAP_ARENA BlockArena;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Memory;
+
+    Arena = NULL;
+    List = &(Cache->Lists[Class - 1]);
+    if (List->Head == NULL) {
+        return;
+    }
+
+    while ((Count != 0) && (List->Head != NULL)) {
+        Memory = List->Head;
+        List->Head = *((PVOID *)Memory);
+        List->Count -= 1;
+        Count -= 1;
+        Cache->Statistics.CachedBlocks -= 1;
+        Cache->Statistics.CachedBytes -= OS_HEAP_CLASS_TO_SIZE(Class);
+
+        //
+        // Blocks collected from remote frees may have come from a different
+        // arena, so switch locks as needed.
+        //
+
+        Block = OS_HEAP_BLOCK_HEADER(Memory);
+        BlockArena = OS_HEAP_BLOCK_ARENA(Block);
+        if (BlockArena != Arena) {
+            if (Arena != NULL) {
+                OsReleaseLock(&(Arena->Lock));
+            }
+
+            Arena = BlockArena;
+            OsAcquireLock(&(Arena->Lock));
+        }
+
+        RtlHeapFree(&(Arena->Heap), Block);
+    }
+
+    if (Arena != NULL) {
+        OsReleaseLock(&(Arena->Lock));
+    }
+
+    Cache->Statistics.Flushes += 1;
+    return;
+}
+
+VOID
+OspHeapCollectRemoteFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves the blocks other threads have freed back into the
+    given cache's local lists.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache, which must be owned by the
+        current thread or by no thread.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_BLOCK Block;
+    UINTN Class;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Memory;
+    PVOID Next;
+
+    //
+    // Grab the whole list at once. Entries are only ever removed by taking
+    // the whole list, so there is no ABA problem with the pushers.
+    //
+
+    Memory = (PVOID)RtlAtomicExchange(&(Cache->RemoteFree), (UINTN)NULL);
+    while (Memory != NULL) {
+        Next = *((PVOID *)Memory);
+        Block = OS_HEAP_BLOCK_HEADER(Memory);
+        Class = Block->Flags & OS_HEAP_BLOCK_CLASS_MASK;
+        List = &(Cache->Lists[Class - 1]);
+        *((PVOID *)Memory) = List->Head;
+        List->Head = Memory;
+        List->Count += 1;
+        Cache->Statistics.RemoteFreesReceived += 1;
+        Cache->Statistics.CachedBlocks += 1;
+        Cache->Statistics.CachedBytes += OS_HEAP_CLASS_TO_SIZE(Class);
+        if (List->Count > OS_HEAP_CACHE_LIST_LIMIT) {
+            OspHeapFlushCacheList(Cache, Class, OS_HEAP_CACHE_FLUSH_COUNT);
+        }
+
+        Memory = Next;
+    }
+
+    return;
+}
+
+VOID
+OspHeapDrainRemoteFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the blocks on a parked cache's remote free list
+    straight to the arenas they came from. Any thread may call this, since
+    the whole list is taken at once and the cache's own lists are untouched.
+
+Arguments:
+
+    Cache - Supplies a pointer to the parked cache.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_ARENA Arena;
+    POS_HEAP_BLOCK Block;
+    POS_HEAP_ARENA BlockArena;
+    PVOID Memory;
+    PVOID Next;
+
+    Arena = NULL;
+    Memory = (PVOID)RtlAtomicExchange(&(Cache->RemoteFree), (UINTN)NULL);
+    while (Memory != NULL) {
+        Next = *((PVOID *)Memory);
+        Block = OS_HEAP_BLOCK_HEADER(Memory);
+        BlockArena = OS_HEAP_BLOCK_ARENA(Block);
+        if (BlockArena != Arena) {
+            if (Arena != NULL) {
+                OsReleaseLock(&(Arena->Lock));
+            }
+
+            Arena = BlockArena;
+            OsAcquireLock(&(Arena->Lock));
+        }
+
+        RtlHeapFree(&(Arena->Heap), Block);
+        Memory = Next;
+    }
+
+    if (Arena != NULL) {
+        OsReleaseLock(&(Arena->Lock));
+    }
+
+    return;
+}
+
+POS_HEAP_ARENA
+OspHeapAcquireArena (
+    POS_HEAP_THREAD_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine picks an arena and acquires its lock. The thread's preferred
+    arena is tried first. If it is busy, the other arenas are tried before
+    waiting, and the thread's preference moves to whichever was free.
+
+Arguments:
+
+    Cache - Supplies an optional pointer to the current thread's cache.
+
+Return Value:
+
+    Returns a pointer to the locked arena.
+
+--*/
+
+{
+
+    POS_HEAP_ARENA Arena;
+    ULONG Attempt;
+    ULONG Index;
+
+    if (Cache == NULL) {
+        Arena = &(OsHeapArenas[0]);
+        OsAcquireLock(&(Arena->Lock));
+        return Arena;
+    }
+
+    for (Attempt = 0; Attempt < OS_HEAP_ARENA_COUNT; Attempt += 1) {
+        Index = (Cache->ArenaIndex + Attempt) % OS_HEAP_ARENA_COUNT;
+        Arena = &(OsHeapArenas[Index]);
+        if (OsTryToAcquireLock(&(Arena->Lock)) != FALSE) {
+            Cache->ArenaIndex = Index;
+            return Arena;
+        }
+    }
+
+    Arena = &(OsHeapArenas[Cache->ArenaIndex]);
+    OsAcquireLock(&(Arena->Lock));
+    return Arena;
+}
+
+BOOL
+OspHeapCheckBlock (
+    POS_HEAP_BLOCK Block
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sanity checks a block header before it is freed or resized.
+
+Arguments:
+
+    Block - Supplies a pointer to the block header.
+
+Return Value:
+
+    TRUE if the block looks valid.
+
+    FALSE if corruption was detected and reported.
+
+--*/
+
+{
+
+    POS_HEAP_ARENA Arena;
+    HEAP_CORRUPTION_CODE Code;
+
+    Arena = &(OsHeapArenas[0]);
+    if ((Block->Flags & OS_HEAP_BLOCK_MAGIC_MASK) != OS_HEAP_BLOCK_MAGIC) {
+        Code = HeapCorruptionBufferOverrun;
+
+    } else if ((Block->Flags & OS_HEAP_BLOCK_FREE) != 0) {
+        Code = HeapCorruptionDoubleFree;
+
+    } else {
+        return TRUE;
+    }
+
+    OspHeapCorruption(&(Arena->Heap), Code, Block + 1);
+    return FALSE;
+}
+
 PVOID
 OspHeapExpand (
     PMEMORY_HEAP Heap,
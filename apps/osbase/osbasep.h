@@ -107,6 +107,9 @@ Structure Description:
     ListEntry - Stores pointers to the next and previous threads in the OS
         Library thread list.
 
+    HeapCache - Stores a pointer to the thread's small block heap cache, or
+        NULL if the thread has not allocated yet.
+
 --*/
 
 typedef struct _THREAD_CONTROL_BLOCK {
@@ -117,6 +120,7 @@ typedef struct _THREAD_CONTROL_BLOCK {
     UINTN StackGuard;
     UINTN BaseAllocationSize;
     LIST_ENTRY ListEntry;
+    PVOID HeapCache;
 } THREAD_CONTROL_BLOCK, *PTHREAD_CONTROL_BLOCK;
 
 //
@@ -160,6 +164,13 @@ extern UINTN OsImModuleGeneration;
 extern UINTN OsPageShift;
 extern UINTN OsPageSize;
 
+//
+// Store whether or not the thread pointer is valid, meaning the heap can use
+// per-thread caches.
+//
+
+extern BOOL OsHeapThreadCachesEnabled;
+
 //
 // -------------------------------------------------------- Function Prototypes
 //
@@ -292,6 +303,30 @@ Return Value:
 
 --*/
 
+VOID
+OspHeapReleaseThreadCache (
+    PTHREAD_CONTROL_BLOCK ThreadControlBlock
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns a thread's heap cache to the arenas and parks the
+    cache structure for reuse by a future thread. The owning thread must not
+    be allocating concurrently.
+
+Arguments:
+
+    ThreadControlBlock - Supplies a pointer to the thread whose cache should be
+        released.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 OspInitializeImageSupport (
     VOID
@@ -382,6 +417,28 @@ Return Value:
 // Thread-Local storage functions
 //
 
+PTHREAD_CONTROL_BLOCK
+OspGetThreadControlBlock (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns a pointer to the thread control block, a structure
+    unique to each thread.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the current thread's control block.
+
+--*/
+
 VOID
 OspInitializeThreadSupport (
     VOID
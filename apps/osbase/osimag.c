@@ -53,6 +53,31 @@ Module Name:
 
 #define LD_BIND_NOW "LD_BIND_NOW"
 
+//
+// Define the name of the environment variable that overrides the directory
+// where symbol binding caches are kept. Setting it to an empty string turns
+// binding caching off.
+//
+
+#define LD_BIND_CACHE "LD_BIND_CACHE"
+
+//
+// Define the default directory for symbol binding caches. It is created world
+// writable and sticky, like /tmp, the first time it is needed, since each user
+// gets their own cache files. If it cannot be created or is not writable,
+// binding caching is off.
+//
+
+#define OS_IMAGE_BINDING_CACHE_DIRECTORY "/var/cache/ldbind"
+
+//
+// Define the size of the buffer used to hold a binding cache path, and the
+// largest binding cache file that will be read.
+//
+
+#define OS_IMAGE_BINDING_CACHE_PATH_SIZE 256
+#define OS_IMAGE_BINDING_CACHE_MAX_SIZE 0x01800000
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -193,6 +218,35 @@ OspImResolvePltEntry (
     UINTN RelocationOffset
     );
 
+KSTATUS
+OspImLoadBindingCache (
+    PLOADED_IMAGE Executable,
+    PVOID *Buffer,
+    PUINTN Size
+    );
+
+VOID
+OspImSaveBindingCache (
+    PLOADED_IMAGE Executable,
+    PVOID Buffer,
+    UINTN Size
+    );
+
+KSTATUS
+OspImGetBindingCachePath (
+    PLOADED_IMAGE Executable,
+    PSTR Path,
+    ULONG PathSize,
+    PULONG PathLength,
+    PULONG DirectoryLength
+    );
+
+KSTATUS
+OspImCreateBindingCacheDirectory (
+    PSTR Path,
+    ULONG DirectoryLength
+    );
+
 KSTATUS
 OspLoadInitialImageList (
     BOOL Relocate
@@ -246,7 +300,9 @@ IM_IMPORT_TABLE OsImageFunctionTable = {
     OspImInvalidateInstructionCacheRegion,
     OspImGetEnvironmentVariable,
     OspImFinalizeSegments,
-    OspImArchResolvePltEntry
+    OspImArchResolvePltEntry,
+    OspImLoadBindingCache,
+    OspImSaveBindingCache
 };
 
 //
@@ -2370,6 +2426,518 @@ Return Value:
     return FunctionAddress;
 }
 
+KSTATUS
+OspImLoadBindingCache (
+    PLOADED_IMAGE Executable,
+    PVOID *Buffer,
+    PUINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine loads the persistent symbol binding cache saved for the given
+    primary executable. The image library validates the contents itself, so
+    this routine only needs to find and read the data.
+
+Arguments:
+
+    Executable - Supplies a pointer to the primary executable image.
+
+    Buffer - Supplies a pointer where a buffer containing the cache contents
+        will be returned on success. The image library will free this buffer
+        with the free memory import.
+
+    Size - Supplies a pointer where the size of the buffer will be returned on
+        success.
+
+Return Value:
+
+    STATUS_SUCCESS if the cache contents were returned.
+
+    STATUS_NOT_SUPPORTED if binding caching is disabled for this executable.
+
+    Other error codes if no cache was loaded but a new one may be saved.
+
+--*/
+
+{
+
+    ULONG Access;
+    PVOID Allocation;
+    UINTN BytesCompleted;
+    ULONG DirectoryLength;
+    FILE_CONTROL_PARAMETERS_UNION FileControlParameters;
+    FILE_PROPERTIES FileProperties;
+    HANDLE Handle;
+    THREAD_IDENTITY Identity;
+    CHAR Path[OS_IMAGE_BINDING_CACHE_PATH_SIZE];
+    ULONG PathLength;
+    KSTATUS Status;
+    KSTATUS WriteStatus;
+
+    Allocation = NULL;
+    Handle = INVALID_HANDLE;
+    Status = OspImGetBindingCachePath(Executable,
+                                      Path,
+                                      sizeof(Path),
+                                      &PathLength,
+                                      &DirectoryLength);
+
+    if (!KSUCCESS(Status)) {
+        goto LoadBindingCacheEnd;
+    }
+
+    Status = OsOpen(INVALID_HANDLE,
+                    Path,
+                    PathLength + 1,
+                    SYS_OPEN_FLAG_READ | SYS_OPEN_FLAG_NO_ACCESS_TIME,
+                    FILE_PERMISSION_NONE,
+                    &Handle);
+
+    //
+    // If there's no cache yet, only bother recording one if it can actually
+    // be saved.
+    //
+
+    if (!KSUCCESS(Status)) {
+        Path[DirectoryLength] = '\0';
+        WriteStatus = OsGetEffectiveAccess(INVALID_HANDLE,
+                                           Path,
+                                           DirectoryLength + 1,
+                                           EFFECTIVE_ACCESS_WRITE,
+                                           FALSE,
+                                           &Access);
+
+        if (WriteStatus == STATUS_PATH_NOT_FOUND) {
+            WriteStatus = OspImCreateBindingCacheDirectory(Path,
+                                                           DirectoryLength);
+
+            if (KSUCCESS(WriteStatus)) {
+                WriteStatus = OsGetEffectiveAccess(INVALID_HANDLE,
+                                                   Path,
+                                                   DirectoryLength + 1,
+                                                   EFFECTIVE_ACCESS_WRITE,
+                                                   FALSE,
+                                                   &Access);
+            }
+        }
+
+        if ((!KSUCCESS(WriteStatus)) ||
+            ((Access & EFFECTIVE_ACCESS_WRITE) == 0)) {
+
+            Status = STATUS_NOT_SUPPORTED;
+        }
+
+        goto LoadBindingCacheEnd;
+    }
+
+    FileControlParameters.SetFileInformation.FieldsToSet = 0;
+    FileControlParameters.SetFileInformation.FileProperties = &FileProperties;
+    Status = OsFileControl(Handle,
+                           FileControlCommandGetFileInformation,
+                           &FileControlParameters);
+
+    if (!KSUCCESS(Status)) {
+        goto LoadBindingCacheEnd;
+    }
+
+    Status = OsSetThreadIdentity(0, &Identity);
+    if (!KSUCCESS(Status)) {
+        goto LoadBindingCacheEnd;
+    }
+
+    //
+    // Only trust a cache written by this user that nobody else can modify.
+    // A cache left by someone else gets replaced when this run saves.
+    //
+
+    if ((FileProperties.Type != IoObjectRegularFile) ||
+        (FileProperties.UserId != Identity.EffectiveUserId) ||
+        ((FileProperties.Permissions &
+          (FILE_PERMISSION_GROUP_WRITE | FILE_PERMISSION_OTHER_WRITE)) != 0) ||
+        (FileProperties.Size <= 0) ||
+        (FileProperties.Size > OS_IMAGE_BINDING_CACHE_MAX_SIZE)) {
+
+        Status = STATUS_ACCESS_DENIED;
+        goto LoadBindingCacheEnd;
+    }
+
+    Allocation = OspImAllocateMemory((ULONG)FileProperties.Size,
+                                     OS_IMAGE_ALLOCATION_TAG);
+
+    if (Allocation == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto LoadBindingCacheEnd;
+    }
+
+    Status = OsPerformIo(Handle,
+                         0,
+                         (UINTN)FileProperties.Size,
+                         0,
+                         SYS_WAIT_TIME_INDEFINITE,
+                         Allocation,
+                         &BytesCompleted);
+
+    if (!KSUCCESS(Status)) {
+        goto LoadBindingCacheEnd;
+    }
+
+    if (BytesCompleted != FileProperties.Size) {
+        Status = STATUS_END_OF_FILE;
+        goto LoadBindingCacheEnd;
+    }
+
+    *Buffer = Allocation;
+    *Size = BytesCompleted;
+    Allocation = NULL;
+
+LoadBindingCacheEnd:
+    if (Handle != INVALID_HANDLE) {
+        OsClose(Handle);
+    }
+
+    if (Allocation != NULL) {
+        OspImFreeMemory(Allocation);
+    }
+
+    return Status;
+}
+
+VOID
+OspImSaveBindingCache (
+    PLOADED_IMAGE Executable,
+    PVOID Buffer,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine persists the symbol binding cache for the given primary
+    executable. The cache is written to a temporary file and renamed into
+    place, so a concurrent run never sees a partially written cache.
+
+Arguments:
+
+    Executable - Supplies a pointer to the primary executable image.
+
+    Buffer - Supplies a pointer to the cache contents to save.
+
+    Size - Supplies the size of the cache contents in bytes.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    ULONG DirectoryLength;
+    ULONG Flags;
+    HANDLE Handle;
+    CHAR Path[OS_IMAGE_BINDING_CACHE_PATH_SIZE];
+    ULONG PathLength;
+    FILE_PERMISSIONS Permissions;
+    PROCESS_ID ProcessId;
+    KSTATUS Status;
+    CHAR TemporaryPath[OS_IMAGE_BINDING_CACHE_PATH_SIZE];
+    ULONG TemporaryPathSize;
+
+    Handle = INVALID_HANDLE;
+    TemporaryPathSize = 0;
+    Status = OspImGetBindingCachePath(Executable,
+                                      Path,
+                                      sizeof(Path),
+                                      &PathLength,
+                                      &DirectoryLength);
+
+    if (!KSUCCESS(Status)) {
+        goto SaveBindingCacheEnd;
+    }
+
+    Status = OsGetProcessId(ProcessIdProcess, &ProcessId);
+    if (!KSUCCESS(Status)) {
+        goto SaveBindingCacheEnd;
+    }
+
+    TemporaryPathSize = RtlPrintToString(TemporaryPath,
+                                         sizeof(TemporaryPath),
+                                         CharacterEncodingDefault,
+                                         "%s.%d",
+                                         Path,
+                                         ProcessId);
+
+    if (TemporaryPathSize > sizeof(TemporaryPath)) {
+        TemporaryPathSize = 0;
+        goto SaveBindingCacheEnd;
+    }
+
+    Flags = SYS_OPEN_FLAG_CREATE | SYS_OPEN_FLAG_FAIL_IF_EXISTS |
+            SYS_OPEN_FLAG_WRITE;
+
+    Permissions = FILE_PERMISSION_USER_READ | FILE_PERMISSION_USER_WRITE;
+    Status = OsOpen(INVALID_HANDLE,
+                    TemporaryPath,
+                    TemporaryPathSize,
+                    Flags,
+                    Permissions,
+                    &Handle);
+
+    if (!KSUCCESS(Status)) {
+        TemporaryPathSize = 0;
+        goto SaveBindingCacheEnd;
+    }
+
+    Status = OsPerformIo(Handle,
+                         0,
+                         Size,
+                         SYS_IO_FLAG_WRITE,
+                         SYS_WAIT_TIME_INDEFINITE,
+                         Buffer,
+                         &BytesCompleted);
+
+    if ((!KSUCCESS(Status)) || (BytesCompleted != Size)) {
+        goto SaveBindingCacheEnd;
+    }
+
+    OsClose(Handle);
+    Handle = INVALID_HANDLE;
+    Status = OsRename(INVALID_HANDLE,
+                      TemporaryPath,
+                      TemporaryPathSize,
+                      INVALID_HANDLE,
+                      Path,
+                      PathLength + 1);
+
+    if (KSUCCESS(Status)) {
+        TemporaryPathSize = 0;
+    }
+
+SaveBindingCacheEnd:
+    if (Handle != INVALID_HANDLE) {
+        OsClose(Handle);
+    }
+
+    if (TemporaryPathSize != 0) {
+        OsDelete(INVALID_HANDLE, TemporaryPath, TemporaryPathSize, 0);
+    }
+
+    return;
+}
+
+KSTATUS
+OspImGetBindingCachePath (
+    PLOADED_IMAGE Executable,
+    PSTR Path,
+    ULONG PathSize,
+    PULONG PathLength,
+    PULONG DirectoryLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the path of the symbol binding cache file for the
+    given executable. Caches are named after the user and the identity of the
+    executable file, so each user keeps their own cache for each program.
+
+Arguments:
+
+    Executable - Supplies a pointer to the primary executable image.
+
+    Path - Supplies a pointer where the path will be returned.
+
+    PathSize - Supplies the size of the path buffer in bytes.
+
+    PathLength - Supplies a pointer where the length of the path will be
+        returned, not including the null terminator.
+
+    DirectoryLength - Supplies a pointer where the length of the directory
+        portion of the path will be returned, not including the separator.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if binding caching is turned off or the executable
+    file is unknown.
+
+    STATUS_NAME_TOO_LONG if the path does not fit in the buffer.
+
+--*/
+
+{
+
+    PSTR Directory;
+    THREAD_IDENTITY Identity;
+    ULONG Length;
+    KSTATUS Status;
+
+    if ((Executable->File.DeviceId == 0) && (Executable->File.FileId == 0)) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Status = OsSetThreadIdentity(0, &Identity);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // Don't let the environment point a set-ID program somewhere else.
+    //
+
+    Directory = NULL;
+    if ((Identity.RealUserId == Identity.EffectiveUserId) &&
+        (Identity.RealGroupId == Identity.EffectiveGroupId)) {
+
+        Directory = OspImGetEnvironmentVariable(LD_BIND_CACHE);
+    }
+
+    if (Directory == NULL) {
+        Directory = OS_IMAGE_BINDING_CACHE_DIRECTORY;
+    }
+
+    if (*Directory == '\0') {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Length = RtlPrintToString(Path,
+                              PathSize,
+                              CharacterEncodingDefault,
+                              "%s/%d-%llx-%llx",
+                              Directory,
+                              Identity.EffectiveUserId,
+                              Executable->File.DeviceId,
+                              Executable->File.FileId);
+
+    if (Length > PathSize) {
+        return STATUS_NAME_TOO_LONG;
+    }
+
+    *PathLength = Length - 1;
+    *DirectoryLength = RtlStringLength(Directory);
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+OspImCreateBindingCacheDirectory (
+    PSTR Path,
+    ULONG DirectoryLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the default symbol binding cache directory, along
+    with any missing parents. The directory is made world writable and sticky
+    so that every user can keep caches there without touching anyone else's.
+    A directory named by the environment is never created.
+
+Arguments:
+
+    Path - Supplies a pointer to the null terminated directory path. The
+        buffer is modified during the call but restored before returning.
+
+    DirectoryLength - Supplies the length of the directory path, not
+        including the null terminator.
+
+Return Value:
+
+    STATUS_SUCCESS if the directory was created or already exists.
+
+    STATUS_NOT_SUPPORTED if the path is not the default cache directory.
+
+    Other error codes if the directory could not be created.
+
+--*/
+
+{
+
+    ULONG Flags;
+    HANDLE Handle;
+    ULONG Index;
+    FILE_CONTROL_PARAMETERS_UNION Parameters;
+    FILE_PERMISSIONS Permissions;
+    FILE_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if ((DirectoryLength != sizeof(OS_IMAGE_BINDING_CACHE_DIRECTORY) - 1) ||
+        (RtlAreStringsEqual(Path,
+                            OS_IMAGE_BINDING_CACHE_DIRECTORY,
+                            DirectoryLength) == FALSE)) {
+
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    //
+    // Create each parent in turn, ignoring those that already exist.
+    //
+
+    Flags = SYS_OPEN_FLAG_CREATE | SYS_OPEN_FLAG_DIRECTORY |
+            SYS_OPEN_FLAG_FAIL_IF_EXISTS;
+
+    Permissions = FILE_PERMISSION_ALL & ~FILE_PERMISSION_GROUP_WRITE &
+                  ~FILE_PERMISSION_OTHER_WRITE;
+
+    for (Index = 1; Index < DirectoryLength; Index += 1) {
+        if (Path[Index] != '/') {
+            continue;
+        }
+
+        Path[Index] = '\0';
+        Status = OsOpen(INVALID_HANDLE,
+                        Path,
+                        Index + 1,
+                        Flags,
+                        Permissions,
+                        &Handle);
+
+        Path[Index] = '/';
+        if (KSUCCESS(Status)) {
+            OsClose(Handle);
+
+        } else if (Status != STATUS_FILE_EXISTS) {
+            return Status;
+        }
+    }
+
+    Status = OsOpen(INVALID_HANDLE,
+                    Path,
+                    DirectoryLength + 1,
+                    Flags,
+                    FILE_PERMISSION_ALL,
+                    &Handle);
+
+    if (!KSUCCESS(Status)) {
+        if (Status == STATUS_FILE_EXISTS) {
+            Status = STATUS_SUCCESS;
+        }
+
+        return Status;
+    }
+
+    //
+    // The umask applies at creation, so set the final permissions explicitly.
+    //
+
+    Properties.Permissions = FILE_PERMISSION_ALL | FILE_PERMISSION_RESTRICTED;
+    Parameters.SetFileInformation.FieldsToSet = FILE_PROPERTY_FIELD_PERMISSIONS;
+    Parameters.SetFileInformation.FileProperties = &Properties;
+    Status = OsFileControl(Handle,
+                           FileControlCommandSetFileInformation,
+                           &Parameters);
+
+    OsClose(Handle);
+    return Status;
+}
+
 KSTATUS
 OspLoadInitialImageList (
     BOOL Relocate
@@ -2396,6 +2964,7 @@ Return Value:
 {
 
     PLOADED_IMAGE Executable;
+    FILE_PROPERTIES FileProperties;
     ULONG Flags;
     IMAGE_BUFFER ImageBuffer;
     PLOADED_IMAGE Interpreter;
@@ -2454,6 +3023,28 @@ Return Value:
 
     ImPrimaryExecutable = Executable;
     Executable->FileName = OsEnvironment->ImageName;
+
+    //
+    // The kernel mapped the executable, so the image library doesn't know
+    // which file it came from. Fill that in so the executable is recognized
+    // if it's opened again and so its symbol binding cache can be found.
+    //
+
+    if (Executable != OsLibrary) {
+        Status = OsGetFileInformation(INVALID_HANDLE,
+                                      OsEnvironment->ImageName,
+                                      OsEnvironment->ImageNameLength,
+                                      TRUE,
+                                      &FileProperties);
+
+        if (KSUCCESS(Status)) {
+            Executable->File.ModificationDate =
+                                          FileProperties.ModifiedTime.Seconds;
+
+            Executable->File.DeviceId = FileProperties.DeviceId;
+            Executable->File.FileId = FileProperties.FileId;
+        }
+    }
     Executable->LoadFlags |= IMAGE_LOAD_FLAG_PRIMARY_LOAD |
                              IMAGE_LOAD_FLAG_PRIMARY_EXECUTABLE;
 
@@ -38,6 +38,34 @@ Module Name:
 #define OS_RWLOCK_UNLOCKED 0
 #define OS_RWLOCK_WRITE_LOCKED ((ULONG)-1)
 
+//
+// Define the bounds on the number of times a contended acquire polls the lock
+// before going to sleep in the kernel. The actual count adapts between these
+// based on how long previous acquires had to wait.
+//
+
+#define OS_RWLOCK_SPIN_MINIMUM 10
+#define OS_RWLOCK_SPIN_MAXIMUM 100
+
+//
+// Define a hint to the processor that it is in a spin loop. This also acts as
+// a compiler barrier so the lock state gets reloaded on each pass.
+//
+
+#if defined(__i386) || defined(__amd64)
+
+#define OS_RWLOCK_SPIN_PAUSE() __asm__ __volatile__ ("pause" ::: "memory")
+
+#elif defined(__ARM_ARCH_7A__)
+
+#define OS_RWLOCK_SPIN_PAUSE() __asm__ __volatile__ ("yield" ::: "memory")
+
+#else
+
+#define OS_RWLOCK_SPIN_PAUSE() __asm__ __volatile__ ("" ::: "memory")
+
+#endif
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -58,6 +86,12 @@ OspAcquireReadWriteLockForWrite (
     ULONG TimeoutInMilliseconds
     );
 
+BOOL
+OspSpinOnReadWriteLock (
+    POS_RWLOCK Lock,
+    BOOL Write
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -444,6 +478,7 @@ Return Value:
     ULONG NewState;
     ULONG OldState;
     ULONG Operation;
+    BOOL Spun;
     UINTN ThreadId;
 
     ThreadId = OsGetThreadId();
@@ -451,6 +486,7 @@ Return Value:
         return STATUS_DEADLOCK;
     }
 
+    Spun = FALSE;
     while (TRUE) {
         OldState = Lock->State;
         if (OldState != OS_RWLOCK_WRITE_LOCKED) {
@@ -468,10 +504,19 @@ Return Value:
             }
 
         //
-        // The lock is already acquired for write access.
+        // The lock is already acquired for write access. Spin for a bit
+        // first in case the writer is about to release it, since that's much
+        // cheaper than a round trip through the kernel.
         //
 
         } else {
+            if (Spun == FALSE) {
+                Spun = TRUE;
+                if (OspSpinOnReadWriteLock(Lock, FALSE) != FALSE) {
+                    continue;
+                }
+            }
+
             Operation = UserLockWait;
             if ((Lock->Attributes & OS_RWLOCK_SHARED) == 0) {
                 Operation |= USER_LOCK_PRIVATE;
@@ -524,6 +569,7 @@ Return Value:
     KSTATUS KernelStatus;
     ULONG OldState;
     ULONG Operation;
+    BOOL Spun;
     UINTN ThreadId;
 
     ThreadId = OsGetThreadId();
@@ -531,6 +577,7 @@ Return Value:
         return STATUS_DEADLOCK;
     }
 
+    Spun = FALSE;
     while (TRUE) {
         OldState = Lock->State;
         if (OldState == OS_RWLOCK_UNLOCKED) {
@@ -549,10 +596,18 @@ Return Value:
             }
 
         //
-        // The lock is already acquired for read or write access.
+        // The lock is already acquired for read or write access. Spin for a
+        // bit before going down to wait in the kernel.
         //
 
         } else {
+            if (Spun == FALSE) {
+                Spun = TRUE;
+                if (OspSpinOnReadWriteLock(Lock, TRUE) != FALSE) {
+                    continue;
+                }
+            }
+
             Operation = UserLockWait;
             if ((Lock->Attributes & OS_RWLOCK_SHARED) == 0) {
                 Operation |= USER_LOCK_PRIVATE;
@@ -574,3 +629,72 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+BOOL
+OspSpinOnReadWriteLock (
+    POS_RWLOCK Lock,
+    BOOL Write
+    )
+
+/*++
+
+Routine Description:
+
+    This routine polls a contended read/write lock for a bounded amount of
+    time, waiting for it to become available. The spin length adapts to how
+    long recent acquires have had to wait, so locks that are held briefly get
+    handed off without a system call, while locks held for long periods quickly
+    stop wasting processor time.
+
+Arguments:
+
+    Lock - Supplies a pointer to the lock to spin on.
+
+    Write - Supplies a boolean indicating whether the caller wants the lock for
+        write access (TRUE) or read access (FALSE).
+
+Return Value:
+
+    TRUE if the lock looked available before the spin ran out. The caller
+    still needs to actually acquire it.
+
+    FALSE if the lock was still held after spinning.
+
+--*/
+
+{
+
+    LONG Estimate;
+    ULONG SpinCount;
+    ULONG SpinIndex;
+    ULONG State;
+
+    Estimate = Lock->SpinEstimate;
+    SpinCount = (Estimate * 2) + OS_RWLOCK_SPIN_MINIMUM;
+    if (SpinCount > OS_RWLOCK_SPIN_MAXIMUM) {
+        SpinCount = OS_RWLOCK_SPIN_MAXIMUM;
+    }
+
+    for (SpinIndex = 0; SpinIndex < SpinCount; SpinIndex += 1) {
+        OS_RWLOCK_SPIN_PAUSE();
+        State = Lock->State;
+        if (((Write != FALSE) && (State == OS_RWLOCK_UNLOCKED)) ||
+            ((Write == FALSE) && (State != OS_RWLOCK_WRITE_LOCKED))) {
+
+            //
+            // Nudge the estimate towards how long this spin took. Updates
+            // from other threads may be lost, which is fine for a heuristic.
+            //
+
+            Lock->SpinEstimate = Estimate + (((LONG)SpinIndex - Estimate) / 8);
+            return TRUE;
+        }
+    }
+
+    //
+    // Spinning didn't pay off, so spin less next time.
+    //
+
+    Lock->SpinEstimate = Estimate - (Estimate / 8);
+    return FALSE;
+}
+
@@ -299,6 +299,65 @@ Return Value:
     Parameters.Value = *Value;
     Parameters.Operation = Operation;
     Parameters.TimeoutInMilliseconds = TimeoutInMilliseconds;
+    Parameters.RequeueAddress = NULL;
+    Status = OsSystemCall(SystemCallUserLock, &Parameters);
+    *Value = Parameters.Value;
+    return Status;
+}
+
+OS_API
+KSTATUS
+OsUserLockRequeue (
+    PVOID Address,
+    ULONG Flags,
+    PULONG Value,
+    PVOID RequeueAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes the given number of threads blocked on a user mode lock
+    address, and moves any remaining waiters over to block on a second
+    address instead. The moved threads are woken by a regular wake operation
+    on the second address.
+
+Arguments:
+
+    Address - Supplies a pointer to the 32-bit user mode lock value threads
+        are currently blocked on.
+
+    Flags - Supplies a bitfield of USER_LOCK_* flags that apply to both
+        addresses.
+
+    Value - Supplies a pointer that on input contains the number of threads
+        to wake. On output, contains the number of threads woken.
+
+    RequeueAddress - Supplies a pointer to the 32-bit user mode lock value
+        that the remaining waiters should be moved to. This must be backed by
+        the same memory object as the original address.
+
+Return Value:
+
+    STATUS_SUCCESS if the operation succeeded.
+
+    STATUS_INVALID_PARAMETER if the addresses are the same or the waiters
+    cannot be moved between them. Callers should fall back to waking all
+    threads in this case.
+
+--*/
+
+{
+
+    SYSTEM_CALL_USER_LOCK Parameters;
+    KSTATUS Status;
+
+    Parameters.Address = Address;
+    Parameters.Value = *Value;
+    Parameters.Operation = UserLockRequeue | Flags;
+    Parameters.TimeoutInMilliseconds = 0;
+    Parameters.RequeueAddress = RequeueAddress;
     Status = OsSystemCall(SystemCallUserLock, &Parameters);
     *Value = Parameters.Value;
     return Status;
@@ -50,11 +50,6 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
-PTHREAD_CONTROL_BLOCK
-OspGetThreadControlBlock (
-    VOID
-    );
-
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -313,7 +308,21 @@ Return Value:
 
 {
 
-    return OsSystemCall(SystemCallSetThreadPointer, Pointer);
+    KSTATUS Status;
+
+    Status = OsSystemCall(SystemCallSetThreadPointer, Pointer);
+
+    //
+    // Once a thread pointer is in place the heap can start handing out
+    // per-thread caches. Threads created later get their pointer from the
+    // kernel before they run.
+    //
+
+    if (KSUCCESS(Status)) {
+        OsHeapThreadCachesEnabled = TRUE;
+    }
+
+    return Status;
 }
 
 VOID
@@ -627,6 +636,7 @@ Return Value:
     OsAcquireLock(&OsThreadListLock);
     LIST_REMOVE(&(ThreadControlBlock->ListEntry));
     OsReleaseLock(&OsThreadListLock);
+    OspHeapReleaseThreadCache(ThreadControlBlock);
     ThreadControlBlock->Self = NULL;
     OsMemoryUnmap(ThreadControlBlock->BaseAllocation,
                   ThreadControlBlock->BaseAllocationSize);
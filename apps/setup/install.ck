@@ -97,6 +97,7 @@ var DriverFiles = [
     "acpi.drv",
     "ehci.drv",
     "fat.drv",
+    "loopback.drv",
     "net80211.drv",
     "netcore.drv",
     "null.drv",
@@ -112,6 +113,7 @@ var DriverFiles = [
     "smsc95xx.drv",
     "sound.drv",
     "special.drv",
+    "tmpfs.drv",
     "usbcomp.drv",
     "usbcore.drv",
     "usbhid.drv",
@@ -133,9 +135,12 @@ if ((arch == "x86") || (arch == "x64")) {
         "e1000.drv",
         "i8042.drv",
         "intelhda.drv",
+        "nvme.drv",
         "rtl81xx.drv",
         "uhci.drv",
         "pcnet32.drv",
+        "virtblk.drv",
+        "virtnet.drv",
     ];
 
 } else if ((arch == "armv7") || (arch == "armv6")) {
@@ -160,6 +165,8 @@ if ((arch == "x86") || (arch == "x64")) {
     BootDrivers += [
         "ahci.drv",
         "ata.drv",
+        "nvme.drv",
+        "virtblk.drv",
         "pci.drv",
         "ehci.drv",
         "usbcomp.drv",
@@ -505,9 +512,11 @@ if (plat == "install-armv6") {
         "libcrypt.so.1",
         "libminocaos.so.1",
         "loadefi",
+        "loopback.drv",
         "net80211.drv",
         "netcore.drv",
         "null.drv",
+        "nvme.drv",
         "om4gpio.drv",
         "onering.drv",
         "part.drv",
@@ -541,6 +550,8 @@ if (plat == "install-armv6") {
         "usbmouse.drv",
         "usrinput.drv",
         "videocon.drv",
+        "virtblk.drv",
+        "virtnet.drv",
     ];
 
     Files += [
@@ -631,9 +642,11 @@ if (plat == "install-armv7") {
         "libcrypt.so.1",
         "libminocaos.so.1",
         "loadefi",
+        "loopback.drv",
         "net80211.drv",
         "netcore.drv",
         "null.drv",
+        "nvme.drv",
         "om4gpio.drv",
         "omap4mlo",
         "onering.drv",
@@ -756,10 +769,12 @@ if ((plat == "install-x86") || (plat == "install-x64")) {
         "libminocaos.so.1",
         "loader",
         "loadefi",
+        "loopback.drv",
         "mbr.bin",
         "net80211.drv",
         "netcore.drv",
         "null.drv",
+        "nvme.drv",
         "onering.drv",
         "part.drv",
         "pci.drv",
@@ -820,10 +835,12 @@ if ((plat == "install-x86") || (plat == "install-x64")) {
             "libminocaos.so.1",
             "loader",
             //"loadefi",
+            "loopback.drv",
             "mbr.bin",
             "net80211.drv",
             "netcore.drv",
             "null.drv",
+            "nvme.drv",
             "onering.drv",
             "part.drv",
             "pci.drv",
@@ -849,6 +866,8 @@ if ((plat == "install-x86") || (plat == "install-x64")) {
             "usbmouse.drv",
             "usrinput.drv",
             "videocon.drv",
+            "virtblk.drv",
+            "virtnet.drv",
         ];
     }
 
@@ -770,10 +770,19 @@ Return Value:
     }
 
     //
-    // Do it, sort the arrays.
+    // Do it, sort the arrays. The compare routine only reads the global
+    // context, so it is safe to sort on several threads.
     //
 
-    qsort(InputLines.Data, InputLines.Size, sizeof(PVOID), SortCompareLines);
+    Status = SwParallelSort(InputLines.Data,
+                            InputLines.Size,
+                            sizeof(PVOID),
+                            SortCompareLines);
+
+    if (Status != 0) {
+        SwPrintError(Status, NULL, "Failed to sort");
+        goto MainEnd;
+    }
 
     //
     // Write all the lines to the output.
@@ -2435,6 +2435,41 @@ Return Value:
 
 --*/
 
+int
+SwParallelSort (
+    void *ArrayBase,
+    size_t ElementCount,
+    size_t ElementSize,
+    int (*CompareFunction)(const void *, const void *)
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sorts an array in place. Where the operating system
+    supports it, large arrays are sorted using multiple threads, so the
+    compare function must be safe to call from several threads at once.
+
+Arguments:
+
+    ArrayBase - Supplies a pointer to the array of items to sort.
+
+    ElementCount - Supplies the number of elements in the array.
+
+    ElementSize - Supplies the size of one of the elements.
+
+    CompareFunction - Supplies a pointer to the qsort style function used to
+        compare two elements.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
 int
 SwResetSystem (
     SWISS_REBOOT_TYPE RebootType
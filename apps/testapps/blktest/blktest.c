@@ -0,0 +1,791 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    blktest.c
+
+Abstract:
+
+    This module implements a block device benchmark that measures throughput
+    and per-request latency with several threads issuing I/O at once.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/types.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+#define PRINT_ERROR(...) fprintf(stderr, "\nblktest: " __VA_ARGS__)
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define BLOCK_TEST_VERSION_MAJOR 1
+#define BLOCK_TEST_VERSION_MINOR 0
+
+#define BLOCK_TEST_USAGE                                                       \
+    "Usage: blktest [options] <device>\n"                                      \
+    "This utility measures the throughput and latency of a block device.\n"  \
+    "Block devices are read through the page cache, so random offsets \n"      \
+    "across a device larger than memory give the most honest numbers. \n"      \
+    "Options are:\n"                                                           \
+    "  -b, --block-size <size> -- Set the size of each request in bytes.\n"    \
+    "  -p, --threads <count> -- Set the number of threads issuing I/O. \n"     \
+    "      Each thread keeps one request in flight.\n"                         \
+    "  -t, --time <seconds> -- Set the duration of the run.\n"                 \
+    "  -r, --random -- Issue requests at random offsets (default).\n"          \
+    "  -s, --sequential -- Have each thread walk its own slice of the \n"      \
+    "      device sequentially.\n"                                             \
+    "  -w, --write -- Write instead of read. This DESTROYS the contents \n"    \
+    "      of the device.\n"                                                   \
+    "  --help -- Print this help text and exit.\n"                             \
+    "  --version -- Print the test version and exit.\n"                        \
+
+#define BLOCK_TEST_OPTIONS_STRING "b:p:t:rswhV"
+
+#define DEFAULT_BLOCK_SIZE 4096
+#define DEFAULT_THREAD_COUNT 1
+#define DEFAULT_DURATION 10
+
+//
+// Latencies are kept in a log-linear histogram: values below the sub-bucket
+// count get their own bucket, and every power of two above that is split
+// into that many buckets. This keeps percentiles within about 3%.
+//
+
+#define BLOCK_TEST_SUB_BUCKET_SHIFT 5
+#define BLOCK_TEST_SUB_BUCKETS (1 << BLOCK_TEST_SUB_BUCKET_SHIFT)
+#define BLOCK_TEST_BUCKET_COUNT \
+    (BLOCK_TEST_SUB_BUCKETS * (64 - BLOCK_TEST_SUB_BUCKET_SHIFT + 1))
+
+#define NANOSECONDS_PER_SECOND 1000000000ULL
+#define NANOSECONDS_PER_MICROSECOND 1000ULL
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores the state and results of one benchmark thread.
+
+Members:
+
+    Thread - Stores the thread identifier.
+
+    Index - Stores the zero-based index of this thread.
+
+    Buffer - Stores the I/O buffer for the thread.
+
+    Seed - Stores the random number generator state.
+
+    Operations - Stores the number of requests completed.
+
+    Bytes - Stores the number of bytes transferred.
+
+    MinLatency - Stores the smallest latency seen, in nanoseconds.
+
+    MaxLatency - Stores the largest latency seen, in nanoseconds.
+
+    TotalLatency - Stores the sum of all latencies, in nanoseconds.
+
+    Histogram - Stores the latency histogram, in microseconds.
+
+    Error - Stores the errno value if the thread hit an error.
+
+--*/
+
+typedef struct _BLOCK_TEST_THREAD {
+    pthread_t Thread;
+    ULONG Index;
+    PVOID Buffer;
+    unsigned int Seed;
+    ULONGLONG Operations;
+    ULONGLONG Bytes;
+    ULONGLONG MinLatency;
+    ULONGLONG MaxLatency;
+    ULONGLONG TotalLatency;
+    ULONGLONG Histogram[BLOCK_TEST_BUCKET_COUNT];
+    INT Error;
+} BLOCK_TEST_THREAD, *PBLOCK_TEST_THREAD;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+PVOID
+BlockTestThread (
+    PVOID Parameter
+    );
+
+ULONGLONG
+BlockTestGetTime (
+    VOID
+    );
+
+ULONG
+BlockTestGetBucket (
+    ULONGLONG Value
+    );
+
+ULONGLONG
+BlockTestGetBucketValue (
+    ULONG Bucket
+    );
+
+ULONGLONG
+BlockTestGetPercentile (
+    PULONGLONG Histogram,
+    ULONGLONG Count,
+    ULONG Thousandths
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+struct option BlockTestLongOptions[] = {
+    {"block-size", required_argument, 0, 'b'},
+    {"threads", required_argument, 0, 'p'},
+    {"time", required_argument, 0, 't'},
+    {"random", no_argument, 0, 'r'},
+    {"sequential", no_argument, 0, 's'},
+    {"write", no_argument, 0, 'w'},
+    {"help", no_argument, 0, 'h'},
+    {"version", no_argument, 0, 'V'},
+    {NULL, 0, 0, 0},
+};
+
+//
+// Store the run parameters shared by all threads.
+//
+
+INT BlockTestDescriptor = -1;
+ULONG BlockTestBlockSize = DEFAULT_BLOCK_SIZE;
+ULONG BlockTestThreadCount = DEFAULT_THREAD_COUNT;
+ULONGLONG BlockTestBlockCount;
+ULONGLONG BlockTestEndTime;
+BOOL BlockTestRandom = TRUE;
+BOOL BlockTestWrite = FALSE;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+int
+main (
+    int ArgumentCount,
+    char **Arguments
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the block device benchmark.
+
+Arguments:
+
+    ArgumentCount - Supplies the number of elements in the arguments array.
+
+    Arguments - Supplies an array of strings. The array count is bounded by the
+        previous parameter, and the strings are null-terminated.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PSTR AfterScan;
+    ULONG Bucket;
+    ULONGLONG Bytes;
+    PSTR Device;
+    off_t DeviceSize;
+    INT Duration;
+    double Elapsed;
+    ULONGLONG EndTime;
+    PULONGLONG Histogram;
+    ULONG Index;
+    ULONGLONG MaxLatency;
+    ULONGLONG MinLatency;
+    ULONGLONG Operations;
+    INT Option;
+    INT OpenFlags;
+    ULONGLONG StartTime;
+    INT Status;
+    struct stat Stat;
+    PBLOCK_TEST_THREAD Thread;
+    PBLOCK_TEST_THREAD Threads;
+    ULONGLONG TotalLatency;
+    INT Value;
+
+    Duration = DEFAULT_DURATION;
+    Histogram = NULL;
+    Threads = NULL;
+    Status = 0;
+    setvbuf(stdout, NULL, _IONBF, 0);
+    setvbuf(stderr, NULL, _IONBF, 0);
+
+    //
+    // Process the control arguments.
+    //
+
+    while (TRUE) {
+        Option = getopt_long(ArgumentCount,
+                             Arguments,
+                             BLOCK_TEST_OPTIONS_STRING,
+                             BlockTestLongOptions,
+                             NULL);
+
+        if (Option == -1) {
+            break;
+        }
+
+        if ((Option == '?') || (Option == ':')) {
+            Status = 1;
+            goto MainEnd;
+        }
+
+        switch (Option) {
+        case 'b':
+            Value = strtol(optarg, &AfterScan, 0);
+            if ((Value <= 0) || (AfterScan == optarg) ||
+                ((Value & (Value - 1)) != 0)) {
+
+                PRINT_ERROR("Invalid block size %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            BlockTestBlockSize = Value;
+            break;
+
+        case 'p':
+            Value = strtol(optarg, &AfterScan, 0);
+            if ((Value <= 0) || (AfterScan == optarg)) {
+                PRINT_ERROR("Invalid thread count %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            BlockTestThreadCount = Value;
+            break;
+
+        case 't':
+            Duration = strtol(optarg, &AfterScan, 0);
+            if ((Duration <= 0) || (AfterScan == optarg)) {
+                PRINT_ERROR("Invalid duration %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            break;
+
+        case 'r':
+            BlockTestRandom = TRUE;
+            break;
+
+        case 's':
+            BlockTestRandom = FALSE;
+            break;
+
+        case 'w':
+            BlockTestWrite = TRUE;
+            break;
+
+        case 'V':
+            printf("Minoca blktest version %d.%d\n",
+                   BLOCK_TEST_VERSION_MAJOR,
+                   BLOCK_TEST_VERSION_MINOR);
+
+            return 1;
+
+        case 'h':
+            printf(BLOCK_TEST_USAGE);
+            return 1;
+
+        default:
+
+            assert(FALSE);
+
+            Status = 1;
+            goto MainEnd;
+        }
+    }
+
+    if (optind != ArgumentCount - 1) {
+        PRINT_ERROR("Expected exactly one device argument.\n");
+        Status = 1;
+        goto MainEnd;
+    }
+
+    Device = Arguments[optind];
+    OpenFlags = O_RDONLY;
+    if (BlockTestWrite != FALSE) {
+        OpenFlags = O_RDWR;
+    }
+
+    BlockTestDescriptor = open(Device, OpenFlags);
+    if (BlockTestDescriptor < 0) {
+        PRINT_ERROR("Failed to open %s: %s.\n", Device, strerror(errno));
+        Status = 1;
+        goto MainEnd;
+    }
+
+    DeviceSize = 0;
+    if (fstat(BlockTestDescriptor, &Stat) == 0) {
+        DeviceSize = Stat.st_size;
+    }
+
+    if (DeviceSize == 0) {
+        DeviceSize = lseek(BlockTestDescriptor, 0, SEEK_END);
+    }
+
+    BlockTestBlockCount = DeviceSize / BlockTestBlockSize;
+    if (BlockTestBlockCount < BlockTestThreadCount) {
+        PRINT_ERROR("Device %s is too small.\n", Device);
+        Status = 1;
+        goto MainEnd;
+    }
+
+    Threads = calloc(BlockTestThreadCount, sizeof(BLOCK_TEST_THREAD));
+    Histogram = calloc(BLOCK_TEST_BUCKET_COUNT, sizeof(ULONGLONG));
+    if ((Threads == NULL) || (Histogram == NULL)) {
+        Status = 1;
+        goto MainEnd;
+    }
+
+    printf("%s: %llu MB, %u threads, %u byte %s %ss for %d seconds.\n",
+           Device,
+           (ULONGLONG)DeviceSize / (1024 * 1024),
+           BlockTestThreadCount,
+           BlockTestBlockSize,
+           (BlockTestRandom != FALSE) ? "random" : "sequential",
+           (BlockTestWrite != FALSE) ? "write" : "read",
+           Duration);
+
+    for (Index = 0; Index < BlockTestThreadCount; Index += 1) {
+        Thread = &(Threads[Index]);
+        Thread->Index = Index;
+        Thread->Seed = time(NULL) ^ getpid() ^ (Index * 0x9E3779B9);
+        Thread->MinLatency = -1ULL;
+        Thread->Buffer = malloc(BlockTestBlockSize);
+        if (Thread->Buffer == NULL) {
+            Status = 1;
+            goto MainEnd;
+        }
+
+        memset(Thread->Buffer, 0xA5 ^ Index, BlockTestBlockSize);
+    }
+
+    StartTime = BlockTestGetTime();
+    BlockTestEndTime = StartTime + (Duration * NANOSECONDS_PER_SECOND);
+    for (Index = 0; Index < BlockTestThreadCount; Index += 1) {
+        Thread = &(Threads[Index]);
+        Status = pthread_create(&(Thread->Thread),
+                                NULL,
+                                BlockTestThread,
+                                Thread);
+
+        if (Status != 0) {
+            PRINT_ERROR("Failed to create thread: %s.\n", strerror(Status));
+            BlockTestThreadCount = Index;
+            BlockTestEndTime = 0;
+            break;
+        }
+    }
+
+    for (Index = 0; Index < BlockTestThreadCount; Index += 1) {
+        pthread_join(Threads[Index].Thread, NULL);
+    }
+
+    EndTime = BlockTestGetTime();
+    if (Status != 0) {
+        goto MainEnd;
+    }
+
+    //
+    // Merge the results from each thread.
+    //
+
+    Bytes = 0;
+    Operations = 0;
+    MinLatency = -1ULL;
+    MaxLatency = 0;
+    TotalLatency = 0;
+    for (Index = 0; Index < BlockTestThreadCount; Index += 1) {
+        Thread = &(Threads[Index]);
+        if (Thread->Error != 0) {
+            PRINT_ERROR("Thread %u failed: %s.\n",
+                        Index,
+                        strerror(Thread->Error));
+
+            Status = 1;
+        }
+
+        Bytes += Thread->Bytes;
+        Operations += Thread->Operations;
+        TotalLatency += Thread->TotalLatency;
+        if (Thread->MinLatency < MinLatency) {
+            MinLatency = Thread->MinLatency;
+        }
+
+        if (Thread->MaxLatency > MaxLatency) {
+            MaxLatency = Thread->MaxLatency;
+        }
+
+        for (Bucket = 0; Bucket < BLOCK_TEST_BUCKET_COUNT; Bucket += 1) {
+            Histogram[Bucket] += Thread->Histogram[Bucket];
+        }
+    }
+
+    if (Operations == 0) {
+        PRINT_ERROR("No I/O completed.\n");
+        Status = 1;
+        goto MainEnd;
+    }
+
+    Elapsed = (double)(EndTime - StartTime) / NANOSECONDS_PER_SECOND;
+    printf("Throughput: %.2f MB/s, %.0f IOPS (%llu requests in %.2fs)\n",
+           (double)Bytes / (1024.0 * 1024.0) / Elapsed,
+           (double)Operations / Elapsed,
+           Operations,
+           Elapsed);
+
+    printf("Latency (us): min %llu, avg %llu, max %llu\n",
+           MinLatency / NANOSECONDS_PER_MICROSECOND,
+           (TotalLatency / Operations) / NANOSECONDS_PER_MICROSECOND,
+           MaxLatency / NANOSECONDS_PER_MICROSECOND);
+
+    printf("Latency (us): p50 %llu, p90 %llu, p99 %llu, p99.9 %llu\n",
+           BlockTestGetPercentile(Histogram, Operations, 500),
+           BlockTestGetPercentile(Histogram, Operations, 900),
+           BlockTestGetPercentile(Histogram, Operations, 990),
+           BlockTestGetPercentile(Histogram, Operations, 999));
+
+MainEnd:
+    if (Threads != NULL) {
+        for (Index = 0; Index < BlockTestThreadCount; Index += 1) {
+            if (Threads[Index].Buffer != NULL) {
+                free(Threads[Index].Buffer);
+            }
+        }
+
+        free(Threads);
+    }
+
+    if (Histogram != NULL) {
+        free(Histogram);
+    }
+
+    if (BlockTestDescriptor >= 0) {
+        close(BlockTestDescriptor);
+    }
+
+    if (Status != 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+PVOID
+BlockTestThread (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements a benchmark thread, which issues one request at
+    a time until the run ends.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the thread's state.
+
+Return Value:
+
+    NULL always.
+
+--*/
+
+{
+
+    ULONGLONG Block;
+    ULONGLONG Latency;
+    ULONGLONG SliceEnd;
+    ULONGLONG SliceSize;
+    ULONGLONG SliceStart;
+    ssize_t Size;
+    ULONGLONG Start;
+    PBLOCK_TEST_THREAD Thread;
+
+    Thread = Parameter;
+    SliceSize = BlockTestBlockCount / BlockTestThreadCount;
+    SliceStart = SliceSize * Thread->Index;
+    SliceEnd = SliceStart + SliceSize;
+    Block = SliceStart;
+    while (TRUE) {
+        if (BlockTestRandom != FALSE) {
+            Block = ((ULONGLONG)rand_r(&(Thread->Seed)) << 31) ^
+                    rand_r(&(Thread->Seed));
+
+            Block %= BlockTestBlockCount;
+
+        } else if (Block >= SliceEnd) {
+            Block = SliceStart;
+        }
+
+        Start = BlockTestGetTime();
+        if (Start >= BlockTestEndTime) {
+            break;
+        }
+
+        if (BlockTestWrite != FALSE) {
+            Size = pwrite(BlockTestDescriptor,
+                          Thread->Buffer,
+                          BlockTestBlockSize,
+                          (off_t)Block * BlockTestBlockSize);
+
+        } else {
+            Size = pread(BlockTestDescriptor,
+                         Thread->Buffer,
+                         BlockTestBlockSize,
+                         (off_t)Block * BlockTestBlockSize);
+        }
+
+        Latency = BlockTestGetTime() - Start;
+        if (Size != BlockTestBlockSize) {
+            Thread->Error = errno;
+            if (Thread->Error == 0) {
+                Thread->Error = EIO;
+            }
+
+            break;
+        }
+
+        Thread->Operations += 1;
+        Thread->Bytes += Size;
+        Thread->TotalLatency += Latency;
+        if (Latency < Thread->MinLatency) {
+            Thread->MinLatency = Latency;
+        }
+
+        if (Latency > Thread->MaxLatency) {
+            Thread->MaxLatency = Latency;
+        }
+
+        Latency /= NANOSECONDS_PER_MICROSECOND;
+        Thread->Histogram[BlockTestGetBucket(Latency)] += 1;
+        Block += 1;
+    }
+
+    return NULL;
+}
+
+ULONGLONG
+BlockTestGetTime (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current monotonic time.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the time in nanoseconds.
+
+--*/
+
+{
+
+    struct timespec Time;
+
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return ((ULONGLONG)Time.tv_sec * NANOSECONDS_PER_SECOND) + Time.tv_nsec;
+}
+
+ULONG
+BlockTestGetBucket (
+    ULONGLONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the histogram bucket for a value.
+
+Arguments:
+
+    Value - Supplies the value to look up.
+
+Return Value:
+
+    Returns the bucket index.
+
+--*/
+
+{
+
+    ULONG HighBit;
+
+    if (Value < BLOCK_TEST_SUB_BUCKETS) {
+        return Value;
+    }
+
+    HighBit = 0;
+    while ((Value >> HighBit) > 1) {
+        HighBit += 1;
+    }
+
+    //
+    // The top bits below the highest set bit pick the sub-bucket.
+    //
+
+    return ((HighBit - BLOCK_TEST_SUB_BUCKET_SHIFT + 1) *
+            BLOCK_TEST_SUB_BUCKETS) +
+           ((Value >> (HighBit - BLOCK_TEST_SUB_BUCKET_SHIFT)) &
+            (BLOCK_TEST_SUB_BUCKETS - 1));
+}
+
+ULONGLONG
+BlockTestGetBucketValue (
+    ULONG Bucket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the smallest value that lands in a histogram bucket.
+
+Arguments:
+
+    Bucket - Supplies the bucket index.
+
+Return Value:
+
+    Returns the lower bound of the bucket.
+
+--*/
+
+{
+
+    ULONG HighBit;
+
+    if (Bucket < BLOCK_TEST_SUB_BUCKETS) {
+        return Bucket;
+    }
+
+    HighBit = (Bucket / BLOCK_TEST_SUB_BUCKETS) +
+              BLOCK_TEST_SUB_BUCKET_SHIFT - 1;
+
+    return ((ULONGLONG)BLOCK_TEST_SUB_BUCKETS +
+            (Bucket % BLOCK_TEST_SUB_BUCKETS)) <<
+           (HighBit - BLOCK_TEST_SUB_BUCKET_SHIFT);
+}
+
+ULONGLONG
+BlockTestGetPercentile (
+    PULONGLONG Histogram,
+    ULONGLONG Count,
+    ULONG Thousandths
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds a percentile in a latency histogram.
+
+Arguments:
+
+    Histogram - Supplies the histogram.
+
+    Count - Supplies the total number of samples in the histogram.
+
+    Thousandths - Supplies the percentile to find, in tenths of a percent.
+
+Return Value:
+
+    Returns the lower bound of the bucket holding the percentile.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    ULONGLONG Seen;
+    ULONGLONG Target;
+
+    Target = ((Count * Thousandths) + 999) / 1000;
+    if (Target == 0) {
+        Target = 1;
+    }
+
+    Seen = 0;
+    for (Bucket = 0; Bucket < BLOCK_TEST_BUCKET_COUNT; Bucket += 1) {
+        Seen += Histogram[Bucket];
+        if (Seen >= Target) {
+            return BlockTestGetBucketValue(Bucket);
+        }
+    }
+
+    return BlockTestGetBucketValue(BLOCK_TEST_BUCKET_COUNT - 1);
+}
+
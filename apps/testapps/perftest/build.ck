@@ -44,6 +44,7 @@ function build() {
         "getppid.c",
         "exec.c",
         "fork.c",
+        "handoff.c",
         "malloc.c",
         "mmap.c",
         "mutex.c",
@@ -53,8 +54,10 @@ function build() {
         "pipeio.c",
         "pthread.c",
         "read.c",
+        "regex.c",
         "rename.c",
         "stat.c",
+        "udprecv.c",
         "write.c"
     ];
 
@@ -0,0 +1,350 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    handoff.c
+
+Abstract:
+
+    This module implements the performance benchmark tests that measure how
+    quickly a mutex and condition variable hand control between threads.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define PT_HANDOFF_BROADCAST_THREAD_COUNT 8
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores the state shared between the threads of a handoff
+    test.
+
+Members:
+
+    Mutex - Stores the mutex protecting the rest of the structure.
+
+    Condition - Stores the condition variable threads wait on for their turn,
+        or for the next broadcast generation.
+
+    DoneCondition - Stores the condition variable the main thread waits on for
+        all broadcast waiters to check in.
+
+    Turn - Stores the handoff counter. The main thread runs when it is even,
+        and the partner thread runs when it is odd.
+
+    Generation - Stores the broadcast generation number.
+
+    Acknowledged - Stores the number of waiters that have seen the current
+        broadcast generation.
+
+    Exit - Stores a boolean indicating whether the threads should exit.
+
+--*/
+
+typedef struct _PT_HANDOFF_STATE {
+    pthread_mutex_t Mutex;
+    pthread_cond_t Condition;
+    pthread_cond_t DoneCondition;
+    unsigned long long Turn;
+    unsigned long long Generation;
+    int Acknowledged;
+    int Exit;
+} PT_HANDOFF_STATE, *PPT_HANDOFF_STATE;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void *
+HandoffPartnerStartRoutine (
+    void *Parameter
+    );
+
+void *
+HandoffBroadcastStartRoutine (
+    void *Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+HandoffMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the mutex and condition variable handoff benchmark
+    tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    unsigned long long Iterations;
+    PT_HANDOFF_STATE State;
+    int Status;
+    int ThreadCount;
+    int ThreadIndex;
+    void *(*ThreadRoutine)(void *);
+    pthread_t Threads[PT_HANDOFF_BROADCAST_THREAD_COUNT];
+
+    Iterations = 0;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+    ThreadIndex = 0;
+    pthread_mutex_init(&(State.Mutex), NULL);
+    pthread_cond_init(&(State.Condition), NULL);
+    pthread_cond_init(&(State.DoneCondition), NULL);
+    State.Turn = 0;
+    State.Generation = 0;
+    State.Acknowledged = 0;
+    State.Exit = 0;
+    switch (Test->TestType) {
+    case PtTestMutexHandoff:
+        ThreadCount = 1;
+        ThreadRoutine = HandoffPartnerStartRoutine;
+        break;
+
+    case PtTestConditionBroadcast:
+        ThreadCount = PT_HANDOFF_BROADCAST_THREAD_COUNT;
+        ThreadRoutine = HandoffBroadcastStartRoutine;
+        break;
+
+    default:
+
+        assert(0);
+
+        Result->Status = EINVAL;
+        goto MainEnd;
+    }
+
+    for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+        Status = pthread_create(&(Threads[ThreadIndex]),
+                                NULL,
+                                ThreadRoutine,
+                                &State);
+
+        if (Status != 0) {
+            Result->Status = Status;
+            goto MainEnd;
+        }
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    pthread_mutex_lock(&(State.Mutex));
+    while (PtIsTimedTestRunning() != 0) {
+
+        //
+        // For the handoff test, pass the turn to the partner and wait for it
+        // to be passed back. Each round trip is two handoffs.
+        //
+
+        if (Test->TestType == PtTestMutexHandoff) {
+            State.Turn += 1;
+            pthread_cond_signal(&(State.Condition));
+            while ((State.Turn & 0x1) != 0) {
+                pthread_cond_wait(&(State.Condition), &(State.Mutex));
+            }
+
+        //
+        // For the broadcast test, wake all the waiters and wait for every one
+        // of them to get the mutex and check in.
+        //
+
+        } else {
+            State.Generation += 1;
+            State.Acknowledged = 0;
+            pthread_cond_broadcast(&(State.Condition));
+            while (State.Acknowledged != ThreadCount) {
+                pthread_cond_wait(&(State.DoneCondition), &(State.Mutex));
+            }
+        }
+
+        Iterations += 1;
+    }
+
+    pthread_mutex_unlock(&(State.Mutex));
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+
+    //
+    // Tell the threads to exit and wait for them.
+    //
+
+    pthread_mutex_lock(&(State.Mutex));
+    State.Exit = 1;
+    pthread_cond_broadcast(&(State.Condition));
+    pthread_mutex_unlock(&(State.Mutex));
+    ThreadCount = ThreadIndex;
+    for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+        pthread_join(Threads[ThreadIndex], NULL);
+    }
+
+    pthread_cond_destroy(&(State.DoneCondition));
+    pthread_cond_destroy(&(State.Condition));
+    pthread_mutex_destroy(&(State.Mutex));
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void *
+HandoffPartnerStartRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the partner thread for the handoff test. It waits
+    for its turn, then immediately hands the turn back to the main thread.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the shared test state.
+
+Return Value:
+
+    Returns the NULL pointer.
+
+--*/
+
+{
+
+    PPT_HANDOFF_STATE State;
+
+    State = Parameter;
+    pthread_mutex_lock(&(State->Mutex));
+    while (State->Exit == 0) {
+        if ((State->Turn & 0x1) != 0) {
+            State->Turn += 1;
+            pthread_cond_signal(&(State->Condition));
+        }
+
+        pthread_cond_wait(&(State->Condition), &(State->Mutex));
+    }
+
+    pthread_mutex_unlock(&(State->Mutex));
+    return NULL;
+}
+
+void *
+HandoffBroadcastStartRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements a waiter thread for the broadcast test. It waits
+    for each new generation, and checks in with the main thread once it has
+    seen it.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the shared test state.
+
+Return Value:
+
+    Returns the NULL pointer.
+
+--*/
+
+{
+
+    unsigned long long Generation;
+    PPT_HANDOFF_STATE State;
+
+    State = Parameter;
+    Generation = 0;
+    pthread_mutex_lock(&(State->Mutex));
+    while (State->Exit == 0) {
+        if (State->Generation != Generation) {
+            Generation = State->Generation;
+            State->Acknowledged += 1;
+            if (State->Acknowledged == PT_HANDOFF_BROADCAST_THREAD_COUNT) {
+                pthread_cond_signal(&(State->DoneCondition));
+            }
+        }
+
+        pthread_cond_wait(&(State->Condition), &(State->Mutex));
+    }
+
+    pthread_mutex_unlock(&(State->Mutex));
+    return NULL;
+}
+
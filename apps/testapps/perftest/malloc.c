@@ -49,10 +49,65 @@ Module Name:
 #define PT_MALLOC_TEST_ALLOCATION_COUNT 32
 #define PT_MALLOC_TEST_THREAD_COUNT 8
 
+//
+// Define the parameters of the threaded test. Every thread allocates small
+// blocks, and one in every few frees is handed to the next thread over in
+// batches so that it gets freed by a thread other than the one that
+// allocated it.
+//
+
+#define PT_MALLOC_TEST_THREADED_LIMIT 512
+#define PT_MALLOC_TEST_BATCH_SIZE 16
+#define PT_MALLOC_TEST_REMOTE_FREE_MASK 0x3
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure stores the state for one thread of the threaded malloc
+    test.
+
+Members:
+
+    Thread - Stores the thread identifier.
+
+    Next - Stores a pointer to the thread that receives this thread's remote
+        frees.
+
+    MailboxMutex - Stores the mutex protecting the mailbox.
+
+    MailboxCount - Stores the number of blocks waiting in the mailbox.
+
+    Mailbox - Stores blocks allocated by another thread that this thread
+        should free.
+
+    OutboxCount - Stores the number of blocks waiting in the outbox.
+
+    Outbox - Stores blocks this thread allocated that are destined for the
+        next thread's mailbox.
+
+    Iterations - Stores the number of iterations this thread completed.
+
+    Status - Stores the result of the thread's run.
+
+--*/
+
+typedef struct _MALLOC_THREAD_CONTEXT {
+    pthread_t Thread;
+    struct _MALLOC_THREAD_CONTEXT *Next;
+    pthread_mutex_t MailboxMutex;
+    volatile int MailboxCount;
+    void *Mailbox[PT_MALLOC_TEST_BATCH_SIZE];
+    int OutboxCount;
+    void *Outbox[PT_MALLOC_TEST_BATCH_SIZE];
+    unsigned long long Iterations;
+    int Status;
+} MALLOC_THREAD_CONTEXT, *PMALLOC_THREAD_CONTEXT;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -62,12 +117,46 @@ MallocStartRoutine (
     void *Parameter
     );
 
+unsigned long long
+MallocRunThreadedTest (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+void *
+MallocThreadedStartRoutine (
+    void *Parameter
+    );
+
+void
+MallocThreadedLoop (
+    PMALLOC_THREAD_CONTEXT Context
+    );
+
+void
+MallocDrainMailbox (
+    PMALLOC_THREAD_CONTEXT Context
+    );
+
+void
+MallocPostOutbox (
+    PMALLOC_THREAD_CONTEXT Context
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 volatile int MallocReadyThreadCount;
 
+//
+// Store a flag telling the threaded test's workers to give up waiting for a
+// test to start.
+//
+
+volatile int MallocThreadedTestDone;
+pthread_mutex_t MallocReadyMutex = PTHREAD_MUTEX_INITIALIZER;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -183,6 +272,10 @@ Return Value:
         RandomSize = 1;
         break;
 
+    case PtTestMallocThreaded:
+        Iterations = MallocRunThreadedTest(Test, Result);
+        goto MainEnd;
+
     default:
 
         assert(0);
@@ -265,6 +358,7 @@ Return Value:
     case PtTestMallocSmall:
     case PtTestMallocLarge:
     case PtTestMallocRandom:
+    case PtTestMallocThreaded:
     default:
         break;
     }
@@ -380,3 +474,345 @@ Return Value:
     return (void *)0;
 }
 
+unsigned long long
+MallocRunThreadedTest (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs the threaded malloc test. Every thread, including this
+    one, allocates and frees small blocks, passing a fraction of its frees to
+    another thread.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    Returns the total number of iterations completed by all threads.
+
+--*/
+
+{
+
+    PMALLOC_THREAD_CONTEXT Context;
+    PMALLOC_THREAD_CONTEXT Contexts;
+    int Index;
+    unsigned long long Iterations;
+    int Status;
+    int ThreadCount;
+
+    Iterations = 0;
+    ThreadCount = 0;
+    MallocReadyThreadCount = 0;
+    MallocThreadedTestDone = 0;
+    Contexts = malloc(sizeof(MALLOC_THREAD_CONTEXT) *
+                      PT_MALLOC_TEST_THREAD_COUNT);
+
+    if (Contexts == NULL) {
+        Result->Status = ENOMEM;
+        return 0;
+    }
+
+    memset(Contexts, 0, sizeof(MALLOC_THREAD_CONTEXT) *
+                        PT_MALLOC_TEST_THREAD_COUNT);
+
+    for (Index = 0; Index < PT_MALLOC_TEST_THREAD_COUNT; Index += 1) {
+        Context = &(Contexts[Index]);
+        Context->Next = &(Contexts[(Index + 1) % PT_MALLOC_TEST_THREAD_COUNT]);
+        pthread_mutex_init(&(Context->MailboxMutex), NULL);
+    }
+
+    //
+    // Context zero belongs to this thread. Spin up the rest.
+    //
+
+    for (ThreadCount = 1;
+         ThreadCount < PT_MALLOC_TEST_THREAD_COUNT;
+         ThreadCount += 1) {
+
+        Context = &(Contexts[ThreadCount]);
+        Status = pthread_create(&(Context->Thread),
+                                NULL,
+                                MallocThreadedStartRoutine,
+                                Context);
+
+        if (Status != 0) {
+            Result->Status = Status;
+            goto RunThreadedTestEnd;
+        }
+    }
+
+    while (MallocReadyThreadCount != PT_MALLOC_TEST_THREAD_COUNT - 1) {
+        sleep(1);
+    }
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto RunThreadedTestEnd;
+    }
+
+    MallocThreadedLoop(&(Contexts[0]));
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+RunThreadedTestEnd:
+    MallocThreadedTestDone = 1;
+    for (Index = 1; Index < ThreadCount; Index += 1) {
+        pthread_join(Contexts[Index].Thread, NULL);
+    }
+
+    for (Index = 0; Index < ThreadCount; Index += 1) {
+        Context = &(Contexts[Index]);
+        if ((Context->Status != 0) && (Result->Status == 0)) {
+            Result->Status = Context->Status;
+        }
+
+        Iterations += Context->Iterations;
+    }
+
+    //
+    // Everyone has stopped, so free anything left in flight.
+    //
+
+    for (Index = 0; Index < PT_MALLOC_TEST_THREAD_COUNT; Index += 1) {
+        Context = &(Contexts[Index]);
+        MallocDrainMailbox(Context);
+        pthread_mutex_destroy(&(Context->MailboxMutex));
+    }
+
+    free(Contexts);
+    return Iterations;
+}
+
+void *
+MallocThreadedStartRoutine (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the start routine for a worker thread in the
+    threaded malloc test.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the thread's context.
+
+Return Value:
+
+    NULL always. The result is stored in the context.
+
+--*/
+
+{
+
+    PMALLOC_THREAD_CONTEXT Context;
+
+    Context = Parameter;
+    pthread_mutex_lock(&MallocReadyMutex);
+    MallocReadyThreadCount += 1;
+    pthread_mutex_unlock(&MallocReadyMutex);
+
+    //
+    // Busy spin waiting for the test to start.
+    //
+
+    while ((PtIsTimedTestRunning() == 0) && (MallocThreadedTestDone == 0)) {
+        continue;
+    }
+
+    MallocThreadedLoop(Context);
+    return NULL;
+}
+
+void
+MallocThreadedLoop (
+    PMALLOC_THREAD_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates and frees small blocks of random size for as long
+    as the test is running.
+
+Arguments:
+
+    Context - Supplies a pointer to the current thread's context.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    void **Allocations;
+    size_t AllocationSize;
+    int Index;
+    unsigned long long Iterations;
+    unsigned int Seed;
+
+    Iterations = 0;
+    AllocationSize = sizeof(void *) * PT_MALLOC_TEST_ALLOCATION_COUNT;
+    Allocations = malloc(AllocationSize);
+    if (Allocations == NULL) {
+        Context->Status = ENOMEM;
+        return;
+    }
+
+    memset(Allocations, 0, AllocationSize);
+    Seed = time(NULL) + (size_t)Context;
+    while (PtIsTimedTestRunning() != 0) {
+        if (Context->MailboxCount != 0) {
+            MallocDrainMailbox(Context);
+        }
+
+        Index = rand_r(&Seed) % PT_MALLOC_TEST_ALLOCATION_COUNT;
+        if (Allocations[Index] == NULL) {
+            AllocationSize = (rand_r(&Seed) % PT_MALLOC_TEST_THREADED_LIMIT) +
+                             1;
+
+            Allocations[Index] = malloc(AllocationSize);
+            if (Allocations[Index] == NULL) {
+                Context->Status = ENOMEM;
+                break;
+            }
+
+        //
+        // Hand some of the frees off to the neighboring thread.
+        //
+
+        } else if ((Iterations & PT_MALLOC_TEST_REMOTE_FREE_MASK) == 0) {
+            Context->Outbox[Context->OutboxCount] = Allocations[Index];
+            Context->OutboxCount += 1;
+            Allocations[Index] = NULL;
+            if (Context->OutboxCount == PT_MALLOC_TEST_BATCH_SIZE) {
+                MallocPostOutbox(Context);
+            }
+
+        } else {
+            free(Allocations[Index]);
+            Allocations[Index] = NULL;
+        }
+
+        Iterations += 1;
+    }
+
+    for (Index = 0; Index < PT_MALLOC_TEST_ALLOCATION_COUNT; Index += 1) {
+        if (Allocations[Index] != NULL) {
+            free(Allocations[Index]);
+        }
+    }
+
+    for (Index = 0; Index < Context->OutboxCount; Index += 1) {
+        free(Context->Outbox[Index]);
+    }
+
+    Context->OutboxCount = 0;
+    free(Allocations);
+    Context->Iterations = Iterations;
+    return;
+}
+
+void
+MallocDrainMailbox (
+    PMALLOC_THREAD_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees all the blocks other threads have posted to the given
+    thread's mailbox.
+
+Arguments:
+
+    Context - Supplies a pointer to the context whose mailbox should be
+        drained.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int Index;
+
+    pthread_mutex_lock(&(Context->MailboxMutex));
+    for (Index = 0; Index < Context->MailboxCount; Index += 1) {
+        free(Context->Mailbox[Index]);
+    }
+
+    Context->MailboxCount = 0;
+    pthread_mutex_unlock(&(Context->MailboxMutex));
+    return;
+}
+
+void
+MallocPostOutbox (
+    PMALLOC_THREAD_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves a full outbox into the next thread's mailbox. If that
+    mailbox hasn't been emptied yet, the blocks are freed locally instead so
+    that no thread ever waits on another.
+
+Arguments:
+
+    Context - Supplies a pointer to the current thread's context.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    int Index;
+    PMALLOC_THREAD_CONTEXT Next;
+
+    Next = Context->Next;
+    pthread_mutex_lock(&(Next->MailboxMutex));
+    if (Next->MailboxCount == 0) {
+        memcpy(Next->Mailbox,
+               Context->Outbox,
+               sizeof(void *) * Context->OutboxCount);
+
+        Next->MailboxCount = Context->OutboxCount;
+        Context->OutboxCount = 0;
+    }
+
+    pthread_mutex_unlock(&(Next->MailboxMutex));
+    for (Index = 0; Index < Context->OutboxCount; Index += 1) {
+        free(Context->Outbox[Index]);
+    }
+
+    Context->OutboxCount = 0;
+    return;
+}
+
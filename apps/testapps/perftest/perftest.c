@@ -351,6 +351,13 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtResultIterations,
      MALLOC_CONTENDED_TEST_DEFAULT_DURATION},
 
+    {MALLOC_THREADED_TEST_NAME,
+     MALLOC_THREADED_TEST_DESCRIPTION,
+     MallocMain,
+     PtTestMallocThreaded,
+     PtResultIterations,
+     MALLOC_THREADED_TEST_DEFAULT_DURATION},
+
     {PTHREAD_JOIN_TEST_NAME,
      PTHREAD_JOIN_TEST_DESCRIPTION,
      PthreadMain,
@@ -379,6 +386,20 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtResultIterations,
      MUTEX_CONTENDED_TEST_DEFAULT_DURATION},
 
+    {MUTEX_HANDOFF_TEST_NAME,
+     MUTEX_HANDOFF_TEST_DESCRIPTION,
+     HandoffMain,
+     PtTestMutexHandoff,
+     PtResultIterations,
+     MUTEX_HANDOFF_TEST_DEFAULT_DURATION},
+
+    {CONDITION_BROADCAST_TEST_NAME,
+     CONDITION_BROADCAST_TEST_DESCRIPTION,
+     HandoffMain,
+     PtTestConditionBroadcast,
+     PtResultIterations,
+     CONDITION_BROADCAST_TEST_DEFAULT_DURATION},
+
     {STAT_TEST_NAME,
      STAT_TEST_DESCRIPTION,
      StatMain,
@@ -392,6 +413,20 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtTestFstat,
      PtResultIterations,
      FSTAT_TEST_DEFAULT_DURATION},
+
+    {REGEX_TEST_NAME,
+     REGEX_TEST_DESCRIPTION,
+     RegexMain,
+     PtTestRegex,
+     PtResultBytes,
+     REGEX_TEST_DEFAULT_DURATION},
+
+    {UDP_RECEIVE_TEST_NAME,
+     UDP_RECEIVE_TEST_DESCRIPTION,
+     UdpReceiveMain,
+     PtTestUdpReceive,
+     PtResultIterations,
+     UDP_RECEIVE_TEST_DEFAULT_DURATION},
 };
 
 //
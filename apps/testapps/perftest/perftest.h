@@ -109,6 +109,10 @@ Module Name:
 #define MALLOC_CONTENDED_TEST_DESCRIPTION \
     "Benchmarks malloc() and free() with multiple threads."
 
+#define MALLOC_THREADED_TEST_NAME "malloc_threaded"
+#define MALLOC_THREADED_TEST_DESCRIPTION \
+    "Benchmarks malloc() and free() scaling with cross-thread frees."
+
 #define PTHREAD_JOIN_TEST_NAME "pthread_join"
 #define PTHREAD_JOIN_TEST_DESCRIPTION \
     "Benchmarks thread creation with pthread_join()."
@@ -125,6 +129,14 @@ Module Name:
 #define MUTEX_CONTENDED_TEST_DESCRIPTION \
     "Benchmarks pthread mutex lock and unlock routines under contention."
 
+#define MUTEX_HANDOFF_TEST_NAME "mutex_handoff"
+#define MUTEX_HANDOFF_TEST_DESCRIPTION \
+    "Benchmarks handing a mutex back and forth between two threads."
+
+#define CONDITION_BROADCAST_TEST_NAME "cond_broadcast"
+#define CONDITION_BROADCAST_TEST_DESCRIPTION \
+    "Benchmarks waking many threads waiting on a condition variable."
+
 #define STAT_TEST_NAME "stat"
 #define STAT_TEST_DESCRIPTION \
     "Benchmarks the stat() C library routine."
@@ -133,6 +145,14 @@ Module Name:
 #define FSTAT_TEST_DESCRIPTION \
     "Benchmarks the fstat() C library routine."
 
+#define REGEX_TEST_NAME "regex"
+#define REGEX_TEST_DESCRIPTION \
+    "Benchmarks regexec() searching a text corpus line by line."
+
+#define UDP_RECEIVE_TEST_NAME "udp_receive"
+#define UDP_RECEIVE_TEST_DESCRIPTION \
+    "Benchmarks the UDP datagram receive rate over loopback."
+
 //
 // Default test durations, in seconds.
 //
@@ -159,12 +179,17 @@ Module Name:
 #define MALLOC_LARGE_TEST_DEFAULT_DURATION 30
 #define MALLOC_RANDOM_TEST_DEFAULT_DURATION 30
 #define MALLOC_CONTENDED_TEST_DEFAULT_DURATION 30
+#define MALLOC_THREADED_TEST_DEFAULT_DURATION 30
 #define PTHREAD_JOIN_TEST_DEFAULT_DURATION 30
 #define PTHREAD_DETACH_TEST_DEFAULT_DURATION 30
 #define MUTEX_TEST_DEFAULT_DURATION 30
 #define MUTEX_CONTENDED_TEST_DEFAULT_DURATION 30
+#define MUTEX_HANDOFF_TEST_DEFAULT_DURATION 30
+#define CONDITION_BROADCAST_TEST_DEFAULT_DURATION 30
 #define STAT_TEST_DEFAULT_DURATION 30
 #define FSTAT_TEST_DEFAULT_DURATION 30
+#define REGEX_TEST_DEFAULT_DURATION 30
+#define UDP_RECEIVE_TEST_DEFAULT_DURATION 30
 
 //
 // Define the number of variables supplied to an iteration of the execute test
@@ -201,12 +226,17 @@ typedef enum _PT_TEST_TYPE {
     PtTestMallocLarge,
     PtTestMallocRandom,
     PtTestMallocContended,
+    PtTestMallocThreaded,
     PtTestPthreadJoin,
     PtTestPthreadDetach,
     PtTestMutex,
     PtTestMutexContended,
+    PtTestMutexHandoff,
+    PtTestConditionBroadcast,
     PtTestStat,
     PtTestFstat,
+    PtTestRegex,
+    PtTestUdpReceive,
     PtTestTypeCount
 } PT_TEST_TYPE, *PPT_TEST_TYPE;
 
@@ -928,6 +958,32 @@ Return Value:
 
 --*/
 
+void
+HandoffMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the mutex and condition variable handoff benchmark
+    tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
 void
 StatMain (
     PPT_TEST_INFORMATION Test,
@@ -978,3 +1034,53 @@ Return Value:
 
 --*/
 
+void
+RegexMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the regular expression performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+UdpReceiveMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the UDP receive performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
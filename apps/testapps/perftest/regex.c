@@ -0,0 +1,301 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    regex.c
+
+Abstract:
+
+    This module implements the performance benchmark test for the regexec()
+    C library routine, matching a set of patterns against a synthetic corpus
+    one line at a time the way grep does.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <errno.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define PT_REGEX_TEST_LINE_COUNT 4096
+#define PT_REGEX_TEST_LINE_LENGTH 80
+#define PT_REGEX_TEST_CORPUS_SIZE \
+    (PT_REGEX_TEST_LINE_COUNT * PT_REGEX_TEST_LINE_LENGTH)
+
+#define PT_REGEX_TEST_PATTERN_COUNT \
+    (sizeof(PtRegexTestPatterns) / sizeof(PtRegexTestPatterns[0]))
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void
+PtRegexCreateCorpus (
+    char *Corpus
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store the patterns run against each line of the corpus. The last one
+// exercises nested repetition, which backtracking matchers handle poorly on
+// long runs of the same character.
+//
+
+char *PtRegexTestPatterns[] = {
+    "timeout",
+    "error: .*(timeout|refused)",
+    "[0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+",
+    "^[a-z]+=[a-z0-9]*$",
+    "(a|aa)*b"
+};
+
+//
+// Store the words the corpus is built out of.
+//
+
+char *PtRegexTestWords[] = {
+    "error:",
+    "connection",
+    "timeout",
+    "refused",
+    "10.0.0.1",
+    "key=value",
+    "aaaaaaaaaaaaaaaaaaaaaaaa",
+    "the",
+    "quick",
+    "brown",
+    "fox"
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+RegexMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the regular expression performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Corpus;
+    char *Line;
+    size_t LineLength;
+    regmatch_t Match;
+    size_t PatternIndex;
+    regex_t Patterns[PT_REGEX_TEST_PATTERN_COUNT];
+    size_t PatternsCompiled;
+    int Status;
+    unsigned long long TotalBytes;
+
+    PatternsCompiled = 0;
+    TotalBytes = 0;
+    Result->Type = PtResultBytes;
+    Result->Status = 0;
+    Corpus = malloc(PT_REGEX_TEST_CORPUS_SIZE);
+    if (Corpus == NULL) {
+        Result->Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    PtRegexCreateCorpus(Corpus);
+    for (PatternIndex = 0;
+         PatternIndex < PT_REGEX_TEST_PATTERN_COUNT;
+         PatternIndex += 1) {
+
+        Status = regcomp(&(Patterns[PatternIndex]),
+                         PtRegexTestPatterns[PatternIndex],
+                         REG_EXTENDED);
+
+        if (Status != 0) {
+            Result->Status = EINVAL;
+            goto MainEnd;
+        }
+
+        PatternsCompiled += 1;
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure the performance of regexec() by counting the number of bytes of
+    // the corpus that can be searched. Ask for the overall match offsets, as
+    // grep does when it needs to color or extract the match.
+    //
+
+    Line = Corpus;
+    while (PtIsTimedTestRunning() != 0) {
+        LineLength = strlen(Line);
+        for (PatternIndex = 0;
+             PatternIndex < PT_REGEX_TEST_PATTERN_COUNT;
+             PatternIndex += 1) {
+
+            Status = regexec(&(Patterns[PatternIndex]), Line, 1, &Match, 0);
+            if ((Status != 0) && (Status != REG_NOMATCH)) {
+                Result->Status = EINVAL;
+                break;
+            }
+
+            TotalBytes += LineLength;
+        }
+
+        if (Result->Status != 0) {
+            break;
+        }
+
+        Line += PT_REGEX_TEST_LINE_LENGTH;
+        if (Line >= Corpus + PT_REGEX_TEST_CORPUS_SIZE) {
+            Line = Corpus;
+        }
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    for (PatternIndex = 0; PatternIndex < PatternsCompiled; PatternIndex += 1) {
+        regfree(&(Patterns[PatternIndex]));
+    }
+
+    if (Corpus != NULL) {
+        free(Corpus);
+    }
+
+    Result->Data.Bytes = TotalBytes;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void
+PtRegexCreateCorpus (
+    char *Corpus
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills the corpus with pseudo-random lines of words. Each line
+    occupies a fixed size slot and is null terminated.
+
+Arguments:
+
+    Corpus - Supplies a pointer to the corpus buffer, which must be
+        PT_REGEX_TEST_CORPUS_SIZE bytes large.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Line;
+    size_t LineIndex;
+    size_t Offset;
+    unsigned int Seed;
+    char *Word;
+    size_t WordCount;
+    size_t WordLength;
+
+    Seed = 1;
+    WordCount = sizeof(PtRegexTestWords) / sizeof(PtRegexTestWords[0]);
+    for (LineIndex = 0; LineIndex < PT_REGEX_TEST_LINE_COUNT; LineIndex += 1) {
+        Line = Corpus + (LineIndex * PT_REGEX_TEST_LINE_LENGTH);
+        Offset = 0;
+        while (1) {
+
+            //
+            // Use a fixed linear congruential generator so that every run
+            // searches the same corpus.
+            //
+
+            Seed = (Seed * 1103515245) + 12345;
+            Word = PtRegexTestWords[(Seed >> 16) % WordCount];
+            WordLength = strlen(Word);
+            if (Offset + WordLength + 1 >= PT_REGEX_TEST_LINE_LENGTH) {
+                break;
+            }
+
+            if (Offset != 0) {
+                Line[Offset] = ' ';
+                Offset += 1;
+            }
+
+            memcpy(Line + Offset, Word, WordLength);
+            Offset += WordLength;
+        }
+
+        Line[Offset] = '\0';
+    }
+
+    return;
+}
+
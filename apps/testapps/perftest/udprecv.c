@@ -0,0 +1,270 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    udprecv.c
+
+Abstract:
+
+    This module implements the performance benchmark test for UDP datagram
+    receive rate. A child process acts as a software traffic source, flooding
+    datagrams at a socket that the test drains.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define PT_UDP_RECEIVE_DATAGRAM_SIZE 1024
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void
+UdpReceiveSendDatagrams (
+    struct sockaddr_in *Address
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+UdpReceiveMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the UDP receive performance benchmark test.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    struct sockaddr_in Address;
+    socklen_t AddressLength;
+    char *Buffer;
+    ssize_t BytesCompleted;
+    pid_t Child;
+    unsigned long long Iterations;
+    int Socket;
+    int Status;
+
+    Child = -1;
+    Iterations = 0;
+    Socket = -1;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+
+    //
+    // Allocate a scratch buffer to receive into.
+    //
+
+    Buffer = malloc(PT_UDP_RECEIVE_DATAGRAM_SIZE);
+    if (Buffer == NULL) {
+        Result->Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    //
+    // Create the receiving socket and bind it to an ephemeral port on the
+    // loopback address.
+    //
+
+    Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (Socket < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    memset(&Address, 0, sizeof(struct sockaddr_in));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = 0;
+    Status = bind(Socket, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    AddressLength = sizeof(Address);
+    Status = getsockname(Socket, (struct sockaddr *)&Address, &AddressLength);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Fire up the traffic source. It runs until it gets killed.
+    //
+
+    Child = fork();
+    if (Child < 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    if (Child == 0) {
+        close(Socket);
+        UdpReceiveSendDatagrams(&Address);
+        exit(0);
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure the rate at which datagrams can be pulled off the socket. The
+    // alarm that ends the test interrupts a blocked receive.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        BytesCompleted = recv(Socket, Buffer, PT_UDP_RECEIVE_DATAGRAM_SIZE, 0);
+        if (BytesCompleted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            Result->Status = errno;
+            break;
+        }
+
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    if (Child > 0) {
+        kill(Child, SIGKILL);
+        waitpid(Child, NULL, 0);
+    }
+
+    if (Socket >= 0) {
+        close(Socket);
+    }
+
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void
+UdpReceiveSendDatagrams (
+    struct sockaddr_in *Address
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends datagrams to the given address as fast as possible,
+    forever. Failures to send (for instance due to a full receive queue) are
+    ignored.
+
+Arguments:
+
+    Address - Supplies a pointer to the address to send datagrams to.
+
+Return Value:
+
+    None. This routine only returns if the socket could not be created.
+
+--*/
+
+{
+
+    char Buffer[PT_UDP_RECEIVE_DATAGRAM_SIZE];
+    int Socket;
+
+    Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (Socket < 0) {
+        return;
+    }
+
+    memset(Buffer, 0xA5, sizeof(Buffer));
+    while (1) {
+        sendto(Socket,
+               Buffer,
+               sizeof(Buffer),
+               0,
+               (struct sockaddr *)Address,
+               sizeof(struct sockaddr_in));
+    }
+
+    return;
+}
+
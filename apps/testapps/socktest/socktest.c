@@ -33,17 +33,42 @@ Module Name:
 #include <minoca/lib/types.h>
 
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <errno.h>
+#include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 //
 // ---------------------------------------------------------------- Definitions
 //
 
+#define SOCKTEST_PORT 7653
+
+//
+// Define the well known DNS port the stand-in server listens on.
+//
+
+#define SOCKTEST_DNS_PORT 53
+
+//
+// Define the names the stand-in DNS server knows about.
+//
+
+#define SOCKTEST_DNS_NAME_CACHED 0
+#define SOCKTEST_DNS_NAME_MISSING 1
+#define SOCKTEST_DNS_NAME_SHORT 2
+#define SOCKTEST_DNS_NAME_COUNT 3
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -58,10 +83,52 @@ TestTransmitThroughput (
     ULONG ChunkCount
     );
 
+ULONG
+TestLoopbackThroughput (
+    ULONG ChunkSize,
+    ULONG ChunkCount
+    );
+
+ULONG
+TestDnsCache (
+    VOID
+    );
+
+ULONG
+TestDnsCacheResolve (
+    PSTR Name,
+    int ExpectedStatus
+    );
+
+ULONG
+TestDnsCacheCheckQueries (
+    ULONG NameIndex,
+    ULONG ExpectedCount
+    );
+
+void *
+TestDnsServerThread (
+    void *Parameter
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
+//
+// Store the names the stand-in DNS server answers for, and the number of
+// queries it has received for each.
+//
+
+PSTR SocktestDnsNames[SOCKTEST_DNS_NAME_COUNT] = {
+    "cached.test",
+    "missing.test",
+    "short.test"
+};
+
+volatile ULONG SocktestDnsQueryCounts[SOCKTEST_DNS_NAME_COUNT];
+volatile int SocktestDnsServerExit;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -78,6 +145,10 @@ Routine Description:
 
     This routine implements the socket test program.
 
+    Pass -l to measure TCP throughput over the loopback interface instead of
+    transmitting to a remote host. Pass -d to test the C library's DNS cache
+    against a stand-in DNS server on the loopback interface.
+
 Arguments:
 
     ArgumentCount - Supplies the number of elements in the arguments array.
@@ -95,6 +166,14 @@ Return Value:
 
 {
 
+    if ((ArgumentCount > 1) && (strcmp(Arguments[1], "-l") == 0)) {
+        return TestLoopbackThroughput(64 * 1024, 4096);
+    }
+
+    if ((ArgumentCount > 1) && (strcmp(Arguments[1], "-d") == 0)) {
+        return TestDnsCache();
+    }
+
     return TestTransmitThroughput(64 * 1024, 16);
 }
 
@@ -152,7 +231,7 @@ Return Value:
     //
 
     DestinationHost.sin_family = AF_INET;
-    DestinationHost.sin_port = htons(7653);
+    DestinationHost.sin_port = htons(SOCKTEST_PORT);
     DestinationHost.sin_addr.s_addr = (192 << 0) | (168 << 8) | (1 << 16) |
                                       (19 << 24);
 
@@ -233,3 +312,573 @@ Return Value:
     return Errors;
 }
 
+
+ULONG
+TestLoopbackThroughput (
+    ULONG ChunkSize,
+    ULONG ChunkCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures TCP throughput over the loopback interface. A child
+    process accepts a connection on 127.0.0.1 and drains it while the parent
+    sends data as fast as it can.
+
+Arguments:
+
+    ChunkSize - Supplies the size of each buffer passed to the send() function.
+
+    ChunkCount - Supplies the number of chunks that will be sent.
+
+Return Value:
+
+    Returns the number of failures that occurred in the test.
+
+--*/
+
+{
+
+    struct sockaddr_in Address;
+    PCHAR Buffer;
+    ssize_t BytesDone;
+    ULONGLONG BytesReceived;
+    pid_t Child;
+    int ChildStatus;
+    int Connection;
+    ULONGLONG ElapsedMicroseconds;
+    struct timeval EndTime;
+    ULONG Errors;
+    int ListenSocket;
+    ULONG LoopIndex;
+    int Result;
+    struct timeval StartTime;
+    int TestSocket;
+    ULONGLONG TotalBytes;
+
+    Buffer = NULL;
+    Child = -1;
+    Errors = 0;
+    TestSocket = -1;
+    ListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (ListenSocket == -1) {
+        printf("socket() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_port = htons(SOCKTEST_PORT);
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Result = bind(ListenSocket, (struct sockaddr *)&Address, sizeof(Address));
+    if (Result != 0) {
+        printf("bind() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    if (listen(ListenSocket, 1) != 0) {
+        printf("listen() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    Buffer = malloc(ChunkSize);
+    if (Buffer == NULL) {
+        printf("Failed to allocate %d bytes.\n", ChunkSize);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    memset(Buffer, 0xA5, ChunkSize);
+    Child = fork();
+    if (Child == -1) {
+        printf("fork() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    //
+    // The child accepts the connection and reads until the parent closes it,
+    // exiting with failure if the byte count comes up short.
+    //
+
+    if (Child == 0) {
+        Connection = accept(ListenSocket, NULL, NULL);
+        if (Connection == -1) {
+            exit(1);
+        }
+
+        BytesReceived = 0;
+        while (TRUE) {
+            BytesDone = recv(Connection, Buffer, ChunkSize, 0);
+            if (BytesDone <= 0) {
+                break;
+            }
+
+            BytesReceived += BytesDone;
+        }
+
+        close(Connection);
+        TotalBytes = (ULONGLONG)ChunkSize * ChunkCount;
+        if (BytesReceived != TotalBytes) {
+            exit(1);
+        }
+
+        exit(0);
+    }
+
+    TestSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (TestSocket == -1) {
+        printf("socket() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    Result = connect(TestSocket, (struct sockaddr *)&Address, sizeof(Address));
+    if (Result != 0) {
+        printf("connect() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestLoopbackThroughputEnd;
+    }
+
+    gettimeofday(&StartTime, NULL);
+    for (LoopIndex = 0; LoopIndex < ChunkCount; LoopIndex += 1) {
+        BytesDone = send(TestSocket, Buffer, ChunkSize, 0);
+        if (BytesDone != ChunkSize) {
+            printf("Error: send() returned %d, errno %d.\n",
+                   (int)BytesDone,
+                   errno);
+
+            Errors += 1;
+            goto TestLoopbackThroughputEnd;
+        }
+    }
+
+    close(TestSocket);
+    TestSocket = -1;
+    if (waitpid(Child, &ChildStatus, 0) != Child) {
+        printf("waitpid() failed. Errno = %d.\n", errno);
+        Errors += 1;
+
+    } else if ((!WIFEXITED(ChildStatus)) || (WEXITSTATUS(ChildStatus) != 0)) {
+        printf("Error: Receiver failed with status 0x%x.\n", ChildStatus);
+        Errors += 1;
+    }
+
+    Child = -1;
+    gettimeofday(&EndTime, NULL);
+    ElapsedMicroseconds = ((EndTime.tv_sec - StartTime.tv_sec) * 1000000ULL) +
+                          EndTime.tv_usec - StartTime.tv_usec;
+
+    if (ElapsedMicroseconds == 0) {
+        ElapsedMicroseconds = 1;
+    }
+
+    TotalBytes = (ULONGLONG)ChunkSize * ChunkCount;
+    printf("Loopback: %llu bytes in %llu us, %llu MB/s.\n",
+           TotalBytes,
+           ElapsedMicroseconds,
+           TotalBytes / ElapsedMicroseconds);
+
+TestLoopbackThroughputEnd:
+    if (TestSocket != -1) {
+        close(TestSocket);
+    }
+
+    if (Child > 0) {
+        kill(Child, SIGKILL);
+        waitpid(Child, NULL, 0);
+    }
+
+    if (ListenSocket != -1) {
+        close(ListenSocket);
+    }
+
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    printf("TestLoopbackThroughput done. %d errors found.\n", Errors);
+    return Errors;
+}
+
+ULONG
+TestDnsCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests that getaddrinfo caches DNS answers. A stand-in DNS
+    server on 127.0.0.1 counts the queries that actually make it out, while
+    the same names are resolved over and over.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of failures that occurred in the test.
+
+--*/
+
+{
+
+    struct sockaddr_in Address;
+    ULONG Errors;
+    ULONG LoopIndex;
+    int Result;
+    int ServerSocket;
+    pthread_t ServerThread;
+    int ThreadCreated;
+
+    Errors = 0;
+    ThreadCreated = 0;
+    ServerSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ServerSocket == -1) {
+        printf("socket() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestDnsCacheEnd;
+    }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_port = htons(SOCKTEST_DNS_PORT);
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Result = bind(ServerSocket, (struct sockaddr *)&Address, sizeof(Address));
+    if (Result != 0) {
+        printf("bind() failed. Errno = %d.\n", errno);
+        Errors += 1;
+        goto TestDnsCacheEnd;
+    }
+
+    SocktestDnsServerExit = 0;
+    Result = pthread_create(&ServerThread,
+                            NULL,
+                            TestDnsServerThread,
+                            (void *)(UINTN)ServerSocket);
+
+    if (Result != 0) {
+        printf("pthread_create() failed: %d.\n", Result);
+        Errors += 1;
+        goto TestDnsCacheEnd;
+    }
+
+    ThreadCreated = 1;
+    setenv("DNSCACHEIP", "127.0.0.1", 1);
+
+    //
+    // A positive answer should go out once and then come from the cache,
+    // regardless of case.
+    //
+
+    for (LoopIndex = 0; LoopIndex < 100; LoopIndex += 1) {
+        Errors += TestDnsCacheResolve("cached.test", 0);
+    }
+
+    Errors += TestDnsCacheResolve("CACHED.Test", 0);
+    Errors += TestDnsCacheCheckQueries(SOCKTEST_DNS_NAME_CACHED, 1);
+
+    //
+    // A name that doesn't exist should be cached too.
+    //
+
+    Errors += TestDnsCacheResolve("missing.test", EAI_NONAME);
+    Errors += TestDnsCacheResolve("missing.test", EAI_NONAME);
+    Errors += TestDnsCacheCheckQueries(SOCKTEST_DNS_NAME_MISSING, 1);
+
+    //
+    // An answer with a short time to live should be asked for again once that
+    // time has passed.
+    //
+
+    Errors += TestDnsCacheResolve("short.test", 0);
+    Errors += TestDnsCacheResolve("short.test", 0);
+    Errors += TestDnsCacheCheckQueries(SOCKTEST_DNS_NAME_SHORT, 1);
+    sleep(4);
+    Errors += TestDnsCacheResolve("short.test", 0);
+    Errors += TestDnsCacheCheckQueries(SOCKTEST_DNS_NAME_SHORT, 2);
+
+TestDnsCacheEnd:
+    if (ThreadCreated != 0) {
+        SocktestDnsServerExit = 1;
+        pthread_join(ServerThread, NULL);
+    }
+
+    if (ServerSocket != -1) {
+        close(ServerSocket);
+    }
+
+    printf("TestDnsCache done. %d errors found.\n", Errors);
+    return Errors;
+}
+
+ULONG
+TestDnsCacheResolve (
+    PSTR Name,
+    int ExpectedStatus
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resolves a name with getaddrinfo and checks the outcome. Every
+    name the stand-in server knows about resolves to 10.1.2.3.
+
+Arguments:
+
+    Name - Supplies the name to resolve.
+
+    ExpectedStatus - Supplies the expected return value from getaddrinfo.
+
+Return Value:
+
+    Returns the number of failures that occurred.
+
+--*/
+
+{
+
+    struct sockaddr_in *Address;
+    struct addrinfo Hints;
+    struct addrinfo *Information;
+    int Status;
+
+    memset(&Hints, 0, sizeof(Hints));
+    Hints.ai_family = AF_INET;
+    Hints.ai_socktype = SOCK_STREAM;
+    Information = NULL;
+    Status = getaddrinfo(Name, NULL, &Hints, &Information);
+    if (Status != ExpectedStatus) {
+        printf("getaddrinfo(%s) returned %d, expected %d.\n",
+               Name,
+               Status,
+               ExpectedStatus);
+
+        if (Status == 0) {
+            freeaddrinfo(Information);
+        }
+
+        return 1;
+    }
+
+    if (Status != 0) {
+        return 0;
+    }
+
+    Address = (struct sockaddr_in *)(Information->ai_addr);
+    Status = 0;
+    if ((Information->ai_family != AF_INET) ||
+        (Address->sin_addr.s_addr != htonl(0x0A010203)) ||
+        (Information->ai_next != NULL)) {
+
+        printf("getaddrinfo(%s) returned the wrong address.\n", Name);
+        Status = 1;
+    }
+
+    freeaddrinfo(Information);
+    return Status;
+}
+
+ULONG
+TestDnsCacheCheckQueries (
+    ULONG NameIndex,
+    ULONG ExpectedCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine checks the number of queries the stand-in DNS server has seen
+    for a name.
+
+Arguments:
+
+    NameIndex - Supplies the index of the name to check.
+
+    ExpectedCount - Supplies the expected number of queries.
+
+Return Value:
+
+    Returns the number of failures that occurred.
+
+--*/
+
+{
+
+    if (SocktestDnsQueryCounts[NameIndex] != ExpectedCount) {
+        printf("DNS server saw %d queries for %s, expected %d.\n",
+               SocktestDnsQueryCounts[NameIndex],
+               SocktestDnsNames[NameIndex],
+               ExpectedCount);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+void *
+TestDnsServerThread (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements a tiny stand-in DNS server. It answers A queries
+    for the names it knows, says the rest don't exist, and counts how many
+    queries it gets for each name.
+
+Arguments:
+
+    Parameter - Supplies the bound UDP socket to serve on.
+
+Return Value:
+
+    NULL always.
+
+--*/
+
+{
+
+    PUCHAR Answer;
+    UCHAR Buffer[512];
+    ssize_t ByteCount;
+    struct sockaddr_in Client;
+    socklen_t ClientLength;
+    ULONG LabelLength;
+    CHAR Name[256];
+    ULONG NameIndex;
+    ULONG NameLength;
+    ULONG Offset;
+    struct pollfd Poll;
+    int Socket;
+    ULONG TimeToLive;
+
+    Socket = (int)(UINTN)Parameter;
+    while (SocktestDnsServerExit == 0) {
+        Poll.fd = Socket;
+        Poll.events = POLLIN;
+        Poll.revents = 0;
+        if (poll(&Poll, 1, 100) <= 0) {
+            continue;
+        }
+
+        ClientLength = sizeof(Client);
+        ByteCount = recvfrom(Socket,
+                             Buffer,
+                             sizeof(Buffer),
+                             0,
+                             (struct sockaddr *)&Client,
+                             &ClientLength);
+
+        if (ByteCount < 12) {
+            continue;
+        }
+
+        //
+        // Convert the question name to a dotted lowercase string.
+        //
+
+        Offset = 12;
+        NameLength = 0;
+        while ((Offset < ByteCount) && (Buffer[Offset] != 0)) {
+            LabelLength = Buffer[Offset];
+            Offset += 1;
+            if ((Offset + LabelLength > ByteCount) ||
+                (NameLength + LabelLength + 1 >= sizeof(Name))) {
+
+                break;
+            }
+
+            if (NameLength != 0) {
+                Name[NameLength] = '.';
+                NameLength += 1;
+            }
+
+            while (LabelLength != 0) {
+                Name[NameLength] = tolower(Buffer[Offset]);
+                NameLength += 1;
+                Offset += 1;
+                LabelLength -= 1;
+            }
+        }
+
+        Name[NameLength] = '\0';
+        Offset += 5;
+        if ((Offset > ByteCount) || (Offset + 16 > sizeof(Buffer))) {
+            continue;
+        }
+
+        for (NameIndex = 0;
+             NameIndex < SOCKTEST_DNS_NAME_COUNT;
+             NameIndex += 1) {
+
+            if (strcmp(Name, SocktestDnsNames[NameIndex]) == 0) {
+                SocktestDnsQueryCounts[NameIndex] += 1;
+                break;
+            }
+        }
+
+        //
+        // Turn the query into a response, with no answer (name error) for
+        // the missing name or unknown names.
+        //
+
+        Buffer[2] |= 0x80;
+        Buffer[3] = 0x80;
+        memset(&(Buffer[6]), 0, 6);
+        if ((NameIndex == SOCKTEST_DNS_NAME_MISSING) ||
+            (NameIndex == SOCKTEST_DNS_NAME_COUNT)) {
+
+            Buffer[3] |= 0x3;
+
+        } else {
+            TimeToLive = 300;
+            if (NameIndex == SOCKTEST_DNS_NAME_SHORT) {
+                TimeToLive = 3;
+            }
+
+            Buffer[7] = 1;
+            Answer = &(Buffer[Offset]);
+            Answer[0] = 0xC0;
+            Answer[1] = 12;
+            Answer[2] = 0;
+            Answer[3] = 1;
+            Answer[4] = 0;
+            Answer[5] = 1;
+            Answer[6] = (UCHAR)(TimeToLive >> 24);
+            Answer[7] = (UCHAR)(TimeToLive >> 16);
+            Answer[8] = (UCHAR)(TimeToLive >> 8);
+            Answer[9] = (UCHAR)TimeToLive;
+            Answer[10] = 0;
+            Answer[11] = 4;
+            Answer[12] = 10;
+            Answer[13] = 1;
+            Answer[14] = 2;
+            Answer[15] = 3;
+            Offset += 16;
+        }
+
+        sendto(Socket,
+               Buffer,
+               Offset,
+               0,
+               (struct sockaddr *)&Client,
+               ClientLength);
+    }
+
+    return NULL;
+}
+
@@ -195,6 +195,8 @@ IM_IMPORT_TABLE BmImageFunctionTable = {
     BmpImInvalidateInstructionCacheRegion,
     NULL,
     NULL,
+    NULL,
+    NULL,
     NULL
 };
 
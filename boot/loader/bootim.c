@@ -224,6 +224,8 @@ IM_IMPORT_TABLE BoImageFunctionTable = {
     BopImInvalidateInstructionCacheRegion,
     BopImGetEnvironmentVariable,
     BopImFinalizeSegments,
+    NULL,
+    NULL,
     NULL
 };
 
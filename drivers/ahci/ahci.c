@@ -1168,6 +1168,7 @@ Return Value:
     ULONG ChildCount;
     PDEVICE Children[AHCI_PORT_COUNT];
     ULONGLONG Duration;
+    BLOCK_QUEUE_POLICY Policy;
     PAHCI_PORT Port;
     ULONG PortIndex;
     ULONGLONG Start;
@@ -1227,6 +1228,17 @@ Return Value:
             }
         }
 
+        //
+        // Let the I/O subsystem know whether or not seeks are expensive so it
+        // can schedule requests to the disk appropriately.
+        //
+
+        Policy = BlockQueuePolicyDeadline;
+        if ((Port->Flags & AHCI_PORT_NON_ROTATIONAL) != 0) {
+            Policy = BlockQueuePolicyNoop;
+        }
+
+        IoSetDeviceBlockQueuePolicy(Port->OsDevice, Policy);
         Children[ChildCount] = Port->OsDevice;
         ChildCount += 1;
     }
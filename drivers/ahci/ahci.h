@@ -152,6 +152,20 @@ Module Name:
 
 #define AHCI_PORT_NATIVE_COMMAND_QUEUING 0x00000002
 
+//
+// This bit is set while the port is reading the NCQ error log to find out
+// which queued command failed. Nothing else is issued in the meantime.
+//
+
+#define AHCI_PORT_RECOVERING 0x00000004
+
+//
+// This bit is set if the drive reports that it is solid state rather than
+// spinning media.
+//
+
+#define AHCI_PORT_NON_ROTATIONAL 0x00000008
+
 //
 // Host capabilities register bits.
 //
@@ -968,11 +982,15 @@ Structure Description:
 
     Irp - Supplies a pointer to the IRP.
 
+    Status - Supplies the completion status of a command issued without an
+        IRP, such as the IDENTIFY command.
+
 --*/
 
 typedef struct _AHCI_COMMAND_STATE {
     UINTN IoSize;
     PIRP Irp;
+    KSTATUS Status;
 } AHCI_COMMAND_STATE, *PAHCI_COMMAND_STATE;
 
 /*++
@@ -1021,7 +1039,25 @@ Structure Description:
 
     AllocatedCommands - Stores the mask of allocated command slots.
 
-    PendingCommands - Stores the mask of commands that are in use.
+    PendingCommands - Stores the mask of commands that have been issued to the
+        hardware and have not yet completed.
+
+    QueuedCommands - Stores the mask of command slots currently holding an
+        FPDMA QUEUED command. Queued commands can run alongside each other,
+        but not alongside a non-queued command.
+
+    DeferredCommands - Stores the mask of commands that have been built but
+        not yet issued, because they cannot run alongside what is pending.
+
+    RecoveryCommands - Stores the mask of queued commands aborted by a device
+        error, which are either failed or retried once the NCQ error log
+        says which one was at fault.
+
+    RecoverySlot - Stores the command slot reserved for reading the NCQ error
+        log. It is outside the command mask, so it is always available.
+
+    ErrorLogIoBuffer - Stores a pointer to the I/O buffer the NCQ error log is
+        read into.
 
     OsDevice - Stores a pointer to the OS device for this port, if present.
 
@@ -1057,6 +1093,11 @@ typedef struct _AHCI_PORT {
     ULONG CommandMask;
     volatile ULONG AllocatedCommands;
     ULONG PendingCommands;
+    ULONG QueuedCommands;
+    ULONG DeferredCommands;
+    ULONG RecoveryCommands;
+    ULONG RecoverySlot;
+    PIO_BUFFER ErrorLogIoBuffer;
     PDEVICE OsDevice;
     ULONG Flags;
     KSPIN_LOCK DpcLock;
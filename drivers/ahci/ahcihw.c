@@ -54,6 +54,35 @@ AhcipProcessInterrupt (
     PAHCI_PORT Port
     );
 
+VOID
+AhcipCompleteCommand (
+    PAHCI_PORT Port,
+    LONG Bit,
+    KSTATUS Status
+    );
+
+VOID
+AhcipRecoverPort (
+    PAHCI_PORT Port,
+    ULONG Finished,
+    ULONG Aborted
+    );
+
+KSTATUS
+AhcipRestartPort (
+    PAHCI_PORT Port
+    );
+
+VOID
+AhcipReadNcqErrorLog (
+    PAHCI_PORT Port
+    );
+
+VOID
+AhcipProcessNcqErrorLog (
+    PAHCI_PORT Port
+    );
+
 KSTATUS
 AhcipPerformBiosHandoff (
     PAHCI_CONTROLLER Controller
@@ -94,12 +123,23 @@ AhcipFreeCommand (
     LONG Index
     );
 
+VOID
+AhcipPrepareCommandHeader (
+    PAHCI_PORT Port,
+    LONG Index
+    );
+
 VOID
 AhcipSubmitCommand (
     PAHCI_PORT Port,
     ULONG Mask
     );
 
+VOID
+AhcipIssueCommands (
+    PAHCI_PORT Port
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -314,15 +354,14 @@ Return Value:
     //
     // Figure out the number of commands that can be simultaneously queued to
     // each port. If native queuing is not supported, then there's not much
-    // point.
+    // point. Whether the drive itself supports queuing is determined when
+    // the port is enumerated.
     //
 
     CommandCount = (Capabilities & AHCI_HOST_CAPABILITY_COMMAND_SLOTS_MASK) >>
                    AHCI_HOST_CAPABILITY_COMMAND_SLOTS_SHIFT;
 
-    if (((Capabilities & AHCI_HOST_CAPABILITY_NATIVE_QUEUING) == 0) ||
-        ((Capabilities & AHCI_HOST_CAPABILITY_SNOTIFICATION) == 0)) {
-
+    if ((Capabilities & AHCI_HOST_CAPABILITY_NATIVE_QUEUING) == 0) {
         CommandCount = 0;
     }
 
@@ -356,6 +395,9 @@ Return Value:
         }
 
         Port->PendingCommands = 0;
+        Port->QueuedCommands = 0;
+        Port->DeferredCommands = 0;
+        Port->RecoveryCommands = 0;
         if (CommandCount >= 32) {
             Port->CommandMask = ~0;
 
@@ -613,11 +655,14 @@ Return Value:
     LONG HeaderIndex;
     PATA_IDENTIFY_PACKET Identify;
     PIO_BUFFER IoBuffer;
+    PIO_BUFFER LogIoBuffer;
+    ULONG Mask;
     RUNLEVEL OldRunLevel;
     PAHCI_PRDT Prdt;
+    ULONG QueueDepth;
     KSTATUS Status;
-    ULONG TaskFile;
 
+    LogIoBuffer = NULL;
     IoBuffer = MmAllocateNonPagedIoBuffer(0,
                                           Port->Controller->MaxPhysical,
                                           ATA_SECTOR_SIZE,
@@ -642,6 +687,8 @@ Return Value:
 
     Header = &(Port->Commands[HeaderIndex]);
     Command = &(Port->Tables[HeaderIndex]);
+    Port->QueuedCommands &= ~(1 << HeaderIndex);
+    Port->CommandState[HeaderIndex].Status = STATUS_NOT_READY;
     RtlZeroMemory(&(Command->CommandFis), sizeof(Command->CommandFis));
     Fis = (PSATA_FIS_REGISTER_H2D)&(Command->CommandFis);
     Fis->Type = SataFisRegisterH2d;
@@ -669,15 +716,41 @@ Return Value:
 
     KeReleaseSpinLock(&(Port->DpcLock));
     KeLowerRunLevel(OldRunLevel);
-    while ((Port->PendingCommands & (1 << HeaderIndex)) != 0) {
+    Mask = 1 << HeaderIndex;
+    while (((Port->PendingCommands | Port->DeferredCommands) & Mask) != 0) {
         KeYield();
     }
 
+    //
+    // The queue depth is only needed if the drive can do native command
+    // queuing, in which case the error log buffer is needed too. Allocate it
+    // before reacquiring the lock.
+    //
+
+    if ((Port->ErrorLogIoBuffer == NULL) &&
+        (Port->Controller->CommandCount > 1) &&
+        ((Identify->SataCapabilities &
+          ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING) != 0)) {
+
+        LogIoBuffer = MmAllocateNonPagedIoBuffer(
+                                         0,
+                                         Port->Controller->MaxPhysical,
+                                         ATA_SECTOR_SIZE,
+                                         ATA_SECTOR_SIZE,
+                                         IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+        if (LogIoBuffer == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+            KeAcquireSpinLock(&(Port->DpcLock));
+            goto EnumeratePortEnd;
+        }
+    }
+
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
     KeAcquireSpinLock(&(Port->DpcLock));
-    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
-    if ((TaskFile & AHCI_PORT_TASK_ERROR_MASK) != 0) {
-        Status = STATUS_DEVICE_IO_ERROR;
+    Status = Port->CommandState[HeaderIndex].Status;
+    if (!KSUCCESS(Status)) {
         goto EnumeratePortEnd;
     }
 
@@ -695,6 +768,43 @@ Return Value:
         Port->TotalSectors = Identify->TotalSectors;
     }
 
+    Port->Flags &= ~AHCI_PORT_NON_ROTATIONAL;
+    if (Identify->NominalRotationRate ==
+        ATA_NOMINAL_ROTATION_RATE_NON_ROTATING) {
+
+        Port->Flags |= AHCI_PORT_NON_ROTATIONAL;
+    }
+
+    //
+    // Turn on native command queuing if both the controller and the drive
+    // support it. FPDMA commands always use 48-bit addressing. The highest
+    // slot is held back from the queue to read the error log with if a
+    // queued command fails, and each slot's index doubles as its tag, so the
+    // drive's queue depth caps the slots used.
+    //
+
+    if (LogIoBuffer != NULL) {
+        Port->ErrorLogIoBuffer = LogIoBuffer;
+        LogIoBuffer = NULL;
+    }
+
+    if ((Port->ErrorLogIoBuffer != NULL) &&
+        ((Port->Flags & AHCI_PORT_LBA48) != 0) &&
+        ((Identify->SataCapabilities &
+          ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING) != 0)) {
+
+        QueueDepth = (Identify->QueueDepth & ATA_QUEUE_DEPTH_MASK) + 1;
+        if (QueueDepth > (Port->Controller->CommandCount - 1)) {
+            QueueDepth = Port->Controller->CommandCount - 1;
+        }
+
+        if (QueueDepth > 1) {
+            Port->RecoverySlot = QueueDepth;
+            Port->CommandMask = (1 << QueueDepth) - 1;
+            Port->Flags |= AHCI_PORT_NATIVE_COMMAND_QUEUING;
+        }
+    }
+
     Status = STATUS_SUCCESS;
 
 EnumeratePortEnd:
@@ -705,6 +815,10 @@ Return Value:
     KeReleaseSpinLock(&(Port->DpcLock));
     KeLowerRunLevel(OldRunLevel);
     MmFreeIoBuffer(IoBuffer);
+    if (LogIoBuffer != NULL) {
+        MmFreeIoBuffer(LogIoBuffer);
+    }
+
     return Status;
 }
 
@@ -844,11 +958,16 @@ Return Value:
     }
 
     //
-    // Clear out all pending commands.
+    // Clear out all pending commands, along with those built but not yet
+    // issued.
     //
 
-    Pending = Port->PendingCommands;
+    Pending = Port->PendingCommands | Port->DeferredCommands |
+              Port->RecoveryCommands;
+
     Port->PendingCommands = 0;
+    Port->DeferredCommands = 0;
+    Port->RecoveryCommands = 0;
     for (Bit = 0; Bit < AHCI_COMMAND_COUNT; Bit += 1) {
         if ((Pending & (1 << Bit)) == 0) {
             continue;
@@ -856,7 +975,10 @@ Return Value:
 
         Irp = Port->CommandState[Bit].Irp;
         Port->CommandState[Bit].Irp = NULL;
-        IoCompleteIrp(AhciDriver, Irp, STATUS_NO_SUCH_DEVICE);
+        if (Irp != NULL) {
+            IoCompleteIrp(AhciDriver, Irp, STATUS_NO_SUCH_DEVICE);
+        }
+
         Pending &= ~(1 << Bit);
         if (Pending == 0) {
             break;
@@ -909,14 +1031,9 @@ Return Value:
 {
 
     LONG Bit;
-    BOOL CommandInUse;
-    BOOL CompleteIrp;
     ULONG Finished;
     ULONG Interrupt;
-    UINTN IoSize;
-    PIRP Irp;
     ULONG NewPending;
-    KSTATUS Status;
     ULONG TaskFile;
 
     Interrupt = RtlAtomicExchange(&(Port->PendingInterrupts), 0);
@@ -947,143 +1064,498 @@ Return Value:
         Interrupt &= ~AHCI_INTERRUPT_ERROR_MASK;
     }
 
-    ASSERT((Interrupt &
-            (AHCI_INTERRUPT_D2H_REGISTER_FIS |
-             AHCI_INTERRUPT_PIO_SETUP_FIS)) != 0);
+    //
+    // Queued commands complete with a set device bits FIS rather than a
+    // register FIS.
+    //
 
     Interrupt &= ~(AHCI_INTERRUPT_D2H_REGISTER_FIS |
-                   AHCI_INTERRUPT_PIO_SETUP_FIS);
+                   AHCI_INTERRUPT_PIO_SETUP_FIS |
+                   AHCI_INTERRUPT_DMA_SETUP_FIS |
+                   AHCI_INTERRUPT_SET_DEVICE_BITS);
 
     if (Interrupt != 0) {
         RtlDebugPrint("AHCI: Got unknown interrupt 0x%x\n", Interrupt);
     }
 
     //
-    // See which commands are no longer outstanding.
+    // See which commands are no longer outstanding. A queued command's
+    // command issue bit clears as soon as the drive accepts it, but its
+    // SATA active bit stays set until the drive finishes it.
     //
 
     NewPending = AHCI_READ(Port, AhciPortCommandIssue);
-    Finished = (NewPending ^ Port->PendingCommands) & Port->PendingCommands;
+    if ((Port->PendingCommands & Port->QueuedCommands) != 0) {
+        NewPending |= AHCI_READ(Port, AhciPortSataActive);
+    }
 
     //
     // Commands better not be magically starting.
     //
 
-    ASSERT(((NewPending ^ Port->PendingCommands) &
-            ~Port->PendingCommands) == 0);
+    ASSERT((NewPending & ~Port->PendingCommands) == 0);
+
+    NewPending &= Port->PendingCommands;
+    Finished = Port->PendingCommands & ~NewPending;
+
+    //
+    // On an error, the port stops processing commands. Anything still
+    // outstanding was aborted.
+    //
 
     TaskFile = AHCI_READ(Port, AhciPortTaskFile);
-    Status = STATUS_SUCCESS;
     if ((TaskFile & AHCI_PORT_TASK_ERROR_MASK) != 0) {
         RtlDebugPrint("AHCI: I/O Error status: %x\n", TaskFile);
-        Status = STATUS_DEVICE_IO_ERROR;
+        AhcipRecoverPort(Port, Finished, NewPending);
+        KeReleaseSpinLock(&(Port->DpcLock));
+        return;
     }
 
     Port->PendingCommands = NewPending;
 
+    //
+    // If the NCQ error log came back, sort out the commands it aborted.
+    //
+
+    if (((Port->Flags & AHCI_PORT_RECOVERING) != 0) &&
+        ((Finished & (1 << Port->RecoverySlot)) != 0)) {
+
+        Finished &= ~(1 << Port->RecoverySlot);
+        AhcipProcessNcqErrorLog(Port);
+    }
+
     //
     // Loop over all the commands that have finished.
     //
 
-    for (Bit = 0; Bit < AHCI_COMMAND_COUNT; Bit += 1) {
-        if ((Finished & (1 << Bit)) == 0) {
-            continue;
-        }
+    while (Finished != 0) {
+        Bit = RtlCountTrailingZeros32(Finished);
+        Finished &= ~(1 << Bit);
+        AhcipCompleteCommand(Port, Bit, STATUS_SUCCESS);
+    }
 
-        Irp = Port->CommandState[Bit].Irp;
-        IoSize = Port->CommandState[Bit].IoSize;
-        Port->CommandState[Bit].IoSize = 0;
-        CommandInUse = FALSE;
-        CompleteIrp = FALSE;
+    AhcipIssueCommands(Port);
+    KeReleaseSpinLock(&(Port->DpcLock));
+    return;
+}
 
-        //
-        // If there was no IRP, assume things are being handled manually. This
-        // happens during the IDENTIFY command.
-        //
+VOID
+AhcipCompleteCommand (
+    PAHCI_PORT Port,
+    LONG Bit,
+    KSTATUS Status
+    )
 
-        if (Irp == NULL) {
-            CommandInUse = TRUE;
+/*++
 
-        } else if (KSUCCESS(Status)) {
+Routine Description:
 
-            ASSERT(Port->Commands[Bit].Size == IoSize);
+    This routine handles a command that is no longer outstanding, moving its
+    IRP on to the next piece of work or completing it. The port lock must be
+    held.
 
-            if (Irp->MajorCode == IrpMajorIo) {
-                Irp->U.ReadWrite.IoBytesCompleted += IoSize;
-                Irp->U.ReadWrite.NewIoOffset += IoSize;
-            }
+Arguments:
 
-            //
-            // If this isn't an I/O request, just complete it.
-            //
+    Port - Supplies a pointer to the port.
 
-            if (Irp->MajorCode == IrpMajorIo) {
+    Bit - Supplies the index of the command that finished.
 
-                //
-                // If this is a synchronized write, then send a cache flush
-                // command along with it. Use the IoSize as a hint as to
-                // whether or not the cache flush part has already gone around.
-                //
+    Status - Supplies the status of the command.
 
-                if ((Irp->MinorCode == IrpMinorIoWrite) &&
-                    ((Irp->U.ReadWrite.IoFlags &
-                      IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
-                    (Irp->U.ReadWrite.IoBytesCompleted >=
-                     Irp->U.ReadWrite.IoSizeInBytes) &&
-                    (IoSize != 0)) {
+Return Value:
 
-                    AhcipExecuteCacheFlush(Port, Bit);
-                    CommandInUse = TRUE;
+    None.
 
-                //
-                // If the IRP is not finished, queue up the next part. The
-                // command table will be in use then.
-                //
+--*/
 
-                } else if (Irp->U.ReadWrite.IoBytesCompleted <
-                           Irp->U.ReadWrite.IoSizeInBytes) {
+{
 
-                    AhcipPerformDmaIo(Port, Irp, Bit);
-                    CommandInUse = TRUE;
+    BOOL CommandInUse;
+    BOOL CompleteIrp;
+    UINTN IoSize;
+    PIRP Irp;
 
-                //
-                // The IRP completed all its I/O.
-                //
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+    ASSERT((Port->PendingCommands & (1 << Bit)) == 0);
 
-                } else {
-                    CompleteIrp = TRUE;
-                }
+    Irp = Port->CommandState[Bit].Irp;
+    IoSize = Port->CommandState[Bit].IoSize;
+    Port->CommandState[Bit].IoSize = 0;
+    CommandInUse = FALSE;
+    CompleteIrp = FALSE;
+
+    //
+    // If there was no IRP, assume things are being handled manually. This
+    // happens during the IDENTIFY command.
+    //
+
+    if (Irp == NULL) {
+        Port->CommandState[Bit].Status = Status;
+        CommandInUse = TRUE;
+
+    } else if (KSUCCESS(Status)) {
+
+        ASSERT((Port->Commands[Bit].Size == IoSize) ||
+               ((Port->QueuedCommands & (1 << Bit)) != 0));
+
+        if (Irp->MajorCode == IrpMajorIo) {
+            Irp->U.ReadWrite.IoBytesCompleted += IoSize;
+            Irp->U.ReadWrite.NewIoOffset += IoSize;
+        }
+
+        //
+        // If this isn't an I/O request, just complete it.
+        //
+
+        if (Irp->MajorCode == IrpMajorIo) {
 
             //
-            // Non I/O IRPs like flush just complete.
+            // If this is a synchronized write, then send a cache flush
+            // command along with it. Use the IoSize as a hint as to whether
+            // or not the cache flush part has already gone around. Queued
+            // writes are sent with forced unit access instead.
+            //
+
+            if ((Irp->MinorCode == IrpMinorIoWrite) &&
+                ((Irp->U.ReadWrite.IoFlags & IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
+                (Irp->U.ReadWrite.IoBytesCompleted >=
+                 Irp->U.ReadWrite.IoSizeInBytes) &&
+                (IoSize != 0) &&
+                ((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) == 0)) {
+
+                AhcipExecuteCacheFlush(Port, Bit);
+                CommandInUse = TRUE;
+
+            //
+            // If the IRP is not finished, queue up the next part. The command
+            // table will be in use then.
+            //
+
+            } else if (Irp->U.ReadWrite.IoBytesCompleted <
+                       Irp->U.ReadWrite.IoSizeInBytes) {
+
+                AhcipPerformDmaIo(Port, Irp, Bit);
+                CommandInUse = TRUE;
+
+            //
+            // The IRP completed all its I/O.
             //
 
             } else {
                 CompleteIrp = TRUE;
             }
-        }
-
-        if (CompleteIrp != FALSE) {
-            Port->CommandState[Bit].Irp = NULL;
-            IoCompleteIrp(AhciDriver, Irp, Status);
-        }
 
         //
-        // Begin the next IRP reusing this command table if there's more
-        // to do.
+        // Non I/O IRPs like flush just complete.
         //
 
-        if (CommandInUse == FALSE) {
-            AhcipBeginNextIrp(Port, Bit);
+        } else {
+            CompleteIrp = TRUE;
         }
 
+    } else {
+        CompleteIrp = TRUE;
+    }
+
+    if (CompleteIrp != FALSE) {
+        Port->CommandState[Bit].Irp = NULL;
+        IoCompleteIrp(AhciDriver, Irp, Status);
+    }
+
+    //
+    // Begin the next IRP reusing this command table if there's more to do.
+    //
+
+    if (CommandInUse == FALSE) {
+        AhcipBeginNextIrp(Port, Bit);
+    }
+
+    return;
+}
+
+VOID
+AhcipRecoverPort (
+    PAHCI_PORT Port,
+    ULONG Finished,
+    ULONG Aborted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine recovers from a device error. It restarts the port, then
+    either fails the non-queued command that caused the error, or reads the
+    NCQ error log to find out which of the aborted queued commands did. The
+    port lock must be held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Finished - Supplies the mask of commands that completed successfully
+        before the error.
+
+    Aborted - Supplies the mask of commands that were still outstanding when
+        the error occurred.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LONG Bit;
+    ULONG Failed;
+    ULONG RecoveryMask;
+    KSTATUS Status;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+
+    Port->PendingCommands = 0;
+    Failed = 0;
+
+    //
+    // If reading the error log is what failed, give up on the commands it
+    // was trying to sort out.
+    //
+
+    if ((Port->Flags & AHCI_PORT_RECOVERING) != 0) {
+        RecoveryMask = 1 << Port->RecoverySlot;
+        Finished &= ~RecoveryMask;
+        Aborted &= ~RecoveryMask;
+        Failed = Port->RecoveryCommands;
+        Port->RecoveryCommands = 0;
+        Port->Flags &= ~AHCI_PORT_RECOVERING;
+    }
+
+    //
+    // A non-queued command runs alone, so if nothing queued was outstanding,
+    // the pending command is the one that failed.
+    //
+
+    if ((Aborted & Port->QueuedCommands) == 0) {
+        Failed |= Finished | Aborted;
+        Finished = 0;
+        Aborted = 0;
+    }
+
+    //
+    // Hold off new commands until the port is sorted out.
+    //
+
+    Port->Flags |= AHCI_PORT_RECOVERING;
+    Status = AhcipRestartPort(Port);
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("AHCI: Failed to restart port: %d\n", Status);
+        Failed |= Aborted;
+        Aborted = 0;
+        IoNotifyDeviceTopologyChange(Port->Controller->OsDevice);
+    }
+
+    while (Finished != 0) {
+        Bit = RtlCountTrailingZeros32(Finished);
         Finished &= ~(1 << Bit);
-        if (Finished == 0) {
-            break;
-        }
+        AhcipCompleteCommand(Port, Bit, STATUS_SUCCESS);
+    }
+
+    while (Failed != 0) {
+        Bit = RtlCountTrailingZeros32(Failed);
+        Failed &= ~(1 << Bit);
+        AhcipCompleteCommand(Port, Bit, STATUS_DEVICE_IO_ERROR);
+    }
+
+    //
+    // If queued commands were aborted, the NCQ error log says which one was
+    // at fault. The rest never ran and can be retried.
+    //
+
+    if (Aborted != 0) {
+        Port->RecoveryCommands = Aborted;
+        AhcipReadNcqErrorLog(Port);
+
+    } else {
+        Port->Flags &= ~AHCI_PORT_RECOVERING;
+        AhcipIssueCommands(Port);
+    }
+
+    return;
+}
+
+KSTATUS
+AhcipRestartPort (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine restarts a port after an error, which clears any commands
+    that were outstanding.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_TIMEOUT if the port could not be stopped.
+
+    STATUS_DEVICE_IO_ERROR if the drive is still busy, in which case it needs
+    a full reset.
+
+--*/
+
+{
+
+    ULONG Command;
+    KSTATUS Status;
+    ULONG TaskFile;
+
+    Status = AhcipStopPort(Port);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    AHCI_WRITE(Port, AhciPortSataError, 0xFFFFFFFF);
+    AHCI_WRITE(Port, AhciPortInterruptStatus, AHCI_INTERRUPT_ERROR_MASK);
+    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
+    if ((TaskFile &
+         (AHCI_PORT_TASK_BUSY | AHCI_PORT_TASK_DATA_REQUEST)) != 0) {
+
+        return STATUS_DEVICE_IO_ERROR;
+    }
+
+    Command = AHCI_READ(Port, AhciPortCommand);
+    Command |= AHCI_PORT_COMMAND_START | AHCI_PORT_COMMAND_FIS_RX_ENABLE;
+    AHCI_WRITE(Port, AhciPortCommand, Command);
+    return STATUS_SUCCESS;
+}
+
+VOID
+AhcipReadNcqErrorLog (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine issues a READ LOG EXT command for the NCQ command error log
+    in the port's reserved recovery slot. The port lock must be held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAHCI_COMMAND_TABLE Command;
+    PSATA_FIS_REGISTER_H2D Fis;
+    PAHCI_COMMAND_HEADER Header;
+    PIO_BUFFER IoBuffer;
+    LONG Index;
+    PAHCI_PRDT Prdt;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+    ASSERT((Port->Flags & AHCI_PORT_RECOVERING) != 0);
+
+    Index = Port->RecoverySlot;
+    IoBuffer = Port->ErrorLogIoBuffer;
+    AhcipPrepareCommandHeader(Port, Index);
+    Port->CommandState[Index].Irp = NULL;
+    Port->CommandState[Index].IoSize = 0;
+    Port->QueuedCommands &= ~(1 << Index);
+    Header = &(Port->Commands[Index]);
+    Command = &(Port->Tables[Index]);
+    RtlZeroMemory(&(Command->CommandFis), sizeof(Command->CommandFis));
+    Fis = (PSATA_FIS_REGISTER_H2D)&(Command->CommandFis);
+    Fis->Type = SataFisRegisterH2d;
+    Fis->Flags = SATA_FIS_REGISTER_H2D_FLAG_COMMAND;
+    Fis->Command = AtaCommandReadLogExt;
+    Fis->Device = ATA_DRIVE_SELECT_LBA;
+    Fis->Lba0 = ATA_LOG_NCQ_COMMAND_ERROR;
+    SATA_SET_FIS_COUNT(Fis, 1);
+    Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
+    Header->PrdtLength = 1;
+    Prdt = &(Command->Prdt[0]);
+    Prdt->AddressLow = (ULONG)(IoBuffer->Fragment[0].PhysicalAddress);
+    Prdt->AddressHigh = (ULONG)(IoBuffer->Fragment[0].PhysicalAddress >> 32);
+    Prdt->Reserved = 0;
+    Prdt->Count = ATA_SECTOR_SIZE - 1;
+    AhcipSubmitCommand(Port, 1 << Index);
+    return;
+}
+
+VOID
+AhcipProcessNcqErrorLog (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when the NCQ error log has been read. It fails the
+    queued command named in the log, and retries the other commands aborted
+    along with it. The port lock must be held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Aborted;
+    LONG Bit;
+    PUCHAR Log;
+    ULONG Tag;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+
+    Aborted = Port->RecoveryCommands;
+    Port->RecoveryCommands = 0;
+    Port->Flags &= ~AHCI_PORT_RECOVERING;
+    Log = Port->ErrorLogIoBuffer->Fragment[0].VirtualAddress;
+
+    //
+    // The aborted commands' tables are still intact, so retrying them is
+    // just a matter of issuing them again. If the log doesn't name one of
+    // them, fail them all rather than risk retrying the culprit forever.
+    //
+
+    Tag = Log[0] & ATA_NCQ_ERROR_TAG_MASK;
+    if (((Log[0] & ATA_NCQ_ERROR_NON_QUEUED) == 0) &&
+        ((Aborted & (1 << Tag)) != 0)) {
+
+        Aborted &= ~(1 << Tag);
+        Port->DeferredCommands |= Aborted;
+        Aborted = 1 << Tag;
+    }
+
+    while (Aborted != 0) {
+        Bit = RtlCountTrailingZeros32(Aborted);
+        Aborted &= ~(1 << Bit);
+        AhcipCompleteCommand(Port, Bit, STATUS_DEVICE_IO_ERROR);
     }
 
-    KeReleaseSpinLock(&(Port->DpcLock));
     return;
 }
 
@@ -1318,6 +1790,7 @@ Return Value:
 
     ULONGLONG BlockAddress;
     UINTN BytesPreviouslyCompleted;
+    ULONG Bit;
     UINTN BytesToComplete;
     ATA_COMMAND Command;
     PAHCI_COMMAND_TABLE CommandTable;
@@ -1335,6 +1808,7 @@ Return Value:
     PHYSICAL_ADDRESS PhysicalAddress;
     PAHCI_PRDT Prdt;
     ULONG PrdtIndex;
+    BOOL Queued;
     ULONG SectorCount;
     UINTN TransferSize;
     UINTN TransferSizeRemaining;
@@ -1453,14 +1927,41 @@ Return Value:
     BlockAddress = IoOffset / ATA_SECTOR_SIZE;
     SectorCount = TransferSize / ATA_SECTOR_SIZE;
     Port->CommandState[HeaderIndex].IoSize = TransferSize;
+    Bit = 1 << HeaderIndex;
+    Queued = FALSE;
+    if ((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) != 0) {
+        Queued = TRUE;
+        Port->QueuedCommands |= Bit;
+
+    } else {
+        Port->QueuedCommands &= ~Bit;
+    }
+
+    //
+    // Queued commands always use 48-bit addressing, with the sector count in
+    // the features register and the tag in the count register. Synchronized
+    // writes are made durable with forced unit access rather than a trailing
+    // cache flush, which would have to wait for the queue to drain.
+    //
+
+    DeviceSelect = ATA_DRIVE_SELECT_LBA;
+    if (Queued != FALSE) {
+        if (Write != FALSE) {
+            Command = AtaCommandWriteFpdmaQueued;
+            if ((Irp->U.ReadWrite.IoFlags & IO_FLAG_DATA_SYNCHRONIZED) != 0) {
+                DeviceSelect |= ATA_FPDMA_FORCE_UNIT_ACCESS;
+            }
+
+        } else {
+            Command = AtaCommandReadFpdmaQueued;
+        }
 
     //
     // Use LBA48 if the block address is too high or the sector size is too
     // large.
     //
 
-    DeviceSelect = ATA_DRIVE_SELECT_LBA;
-    if ((BlockAddress > ATA_MAX_LBA28) ||
+    } else if ((BlockAddress > ATA_MAX_LBA28) ||
         (SectorCount > ATA_MAX_LBA28_SECTOR_COUNT)) {
 
         if (Write != FALSE) {
@@ -1506,7 +2007,15 @@ Return Value:
     Fis->Command = Command;
     SATA_SET_FIS_LBA(Fis, BlockAddress);
     Fis->Device = DeviceSelect;
-    SATA_SET_FIS_COUNT(Fis, SectorCount);
+    if (Queued != FALSE) {
+        Fis->FeaturesLow = (UCHAR)SectorCount;
+        Fis->FeaturesHigh = (UCHAR)(SectorCount >> 8);
+        SATA_SET_FIS_COUNT(Fis, HeaderIndex << ATA_FPDMA_TAG_SHIFT);
+
+    } else {
+        SATA_SET_FIS_COUNT(Fis, SectorCount);
+    }
+
     Header = &(Port->Commands[HeaderIndex]);
     Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
     if (Write != FALSE) {
@@ -1515,7 +2024,7 @@ Return Value:
 
     Header->PrdtLength = PrdtIndex;
     Header->Size = 0;
-    AhcipSubmitCommand(Port, 1 << HeaderIndex);
+    AhcipSubmitCommand(Port, Bit);
     return;
 }
 
@@ -1557,6 +2066,7 @@ Return Value:
 
     Header = &(Port->Commands[Index]);
     Header->Size = 0;
+    Port->QueuedCommands &= ~(1 << Index);
     Command = &(Port->Tables[Index]);
     RtlZeroMemory(&(Command->CommandFis), sizeof(Command->CommandFis));
     Fis = (PSATA_FIS_REGISTER_H2D)&(Command->CommandFis);
@@ -1603,9 +2113,7 @@ Return Value:
 
     ULONG AllocatedMask;
     ULONG Bit;
-    PAHCI_COMMAND_HEADER CommandHeader;
     ULONG Mask;
-    PHYSICAL_ADDRESS PhysicalAddress;
 
     //
     // If there's only one command, then just allocate it. Or don't.
@@ -1647,20 +2155,7 @@ Return Value:
         Port->AllocatedCommands |= 1 << Bit;
     }
 
-    PhysicalAddress = Port->TablesPhysical + (sizeof(AHCI_COMMAND_TABLE) * Bit);
-
-    //
-    // Fill out the command header with the physical address of the command
-    // table.
-    //
-
-    ASSERT((IS_ALIGNED(PhysicalAddress, AHCI_COMMAND_TABLE_ALIGNMENT)) &&
-           (PhysicalAddress <= Port->Controller->MaxPhysical));
-
-    CommandHeader = &(Port->Commands[Bit]);
-    RtlZeroMemory(CommandHeader, sizeof(AHCI_COMMAND_HEADER));
-    CommandHeader->CommandTableLow = (ULONG)PhysicalAddress;
-    CommandHeader->CommandTableHigh = (ULONG)(PhysicalAddress >> 32);
+    AhcipPrepareCommandHeader(Port, Bit);
     return Bit;
 }
 
@@ -1699,6 +2194,53 @@ Return Value:
     return;
 }
 
+VOID
+AhcipPrepareCommandHeader (
+    PAHCI_PORT Port,
+    LONG Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets a command header and points it at its command table.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Index - Supplies the command header index.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAHCI_COMMAND_HEADER CommandHeader;
+    PHYSICAL_ADDRESS PhysicalAddress;
+
+    PhysicalAddress = Port->TablesPhysical +
+                      (sizeof(AHCI_COMMAND_TABLE) * Index);
+
+    //
+    // Fill out the command header with the physical address of the command
+    // table.
+    //
+
+    ASSERT((IS_ALIGNED(PhysicalAddress, AHCI_COMMAND_TABLE_ALIGNMENT)) &&
+           (PhysicalAddress <= Port->Controller->MaxPhysical));
+
+    CommandHeader = &(Port->Commands[Index]);
+    RtlZeroMemory(CommandHeader, sizeof(AHCI_COMMAND_HEADER));
+    CommandHeader->CommandTableLow = (ULONG)PhysicalAddress;
+    CommandHeader->CommandTableHigh = (ULONG)(PhysicalAddress >> 32);
+    return;
+}
+
 VOID
 AhcipSubmitCommand (
     PAHCI_PORT Port,
@@ -1709,8 +2251,10 @@ AhcipSubmitCommand (
 
 Routine Description:
 
-    This routine submits a command for execution. This routine must be executed
-    at dispatch level with the DPC lock held for the port.
+    This routine submits a command for execution. The command is issued to
+    the hardware right away if it can run alongside what is already pending,
+    or held until it can otherwise. This routine must be executed at dispatch
+    level with the DPC lock held for the port.
 
 Arguments:
 
@@ -1727,14 +2271,87 @@ Return Value:
 {
 
     ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+    ASSERT(((Port->PendingCommands | Port->DeferredCommands) & Mask) == 0);
+
+    Port->DeferredCommands |= Mask;
+    AhcipIssueCommands(Port);
+    return;
+}
 
+VOID
+AhcipIssueCommands (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine issues whichever held commands can run now. Queued commands
+    all run together. A non-queued command has to wait for the queue to
+    drain, and holds off any queued commands behind it until it's done. While
+    the port is recovering from an error, only the error log read is issued.
+    The port lock must be held.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Deferred;
+    ULONG Mask;
+    ULONG NonQueued;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+
+    Deferred = Port->DeferredCommands;
+    if (Deferred == 0) {
+        return;
+    }
+
+    if ((Port->Flags & AHCI_PORT_RECOVERING) != 0) {
+        Mask = Deferred & (1 << Port->RecoverySlot);
+
+    } else if ((Port->PendingCommands & ~Port->QueuedCommands) != 0) {
+        Mask = 0;
+
+    } else {
+        NonQueued = Deferred & ~Port->QueuedCommands;
+        if (NonQueued == 0) {
+            Mask = Deferred;
+
+        } else if (Port->PendingCommands == 0) {
+            Mask = NonQueued & (~NonQueued + 1);
+
+        } else {
+            Mask = 0;
+        }
+    }
+
+    if (Mask == 0) {
+        return;
+    }
+
+    Port->DeferredCommands &= ~Mask;
     RtlMemoryBarrier();
 
     //
     // There is no safe order to do these in, which is why holding the lock
-    // is necessary.
+    // is necessary. Queued commands must be marked active before they are
+    // issued.
     //
 
+    if ((Mask & Port->QueuedCommands) != 0) {
+        AHCI_WRITE(Port, AhciPortSataActive, Mask);
+    }
+
     AHCI_WRITE(Port, AhciPortCommandIssue, Mask);
     Port->PendingCommands |= Mask;
     return;
@@ -2069,6 +2069,7 @@ Return Value:
     ULONG ChildCount;
     UINTN ChildIndex;
     PDEVICE Children[4];
+    BLOCK_QUEUE_POLICY Policy;
     KSTATUS Status;
 
     Status = PmDeviceAddReference(Irp->Device);
@@ -2099,6 +2100,22 @@ Return Value:
                     Controller->ChildDevices[ChildIndex] = NULL;
                 }
             }
+
+            //
+            // Let the I/O subsystem know whether or not seeks are expensive
+            // so it can schedule requests to the disk appropriately.
+            //
+
+            if (Controller->ChildDevices[ChildIndex] != NULL) {
+                Policy = BlockQueuePolicyDeadline;
+                if (Child->NonRotational != FALSE) {
+                    Policy = BlockQueuePolicyNoop;
+                }
+
+                IoSetDeviceBlockQueuePolicy(
+                                          Controller->ChildDevices[ChildIndex],
+                                          Policy);
+            }
         }
 
         if (Controller->ChildDevices[ChildIndex] != NULL) {
@@ -2205,6 +2222,13 @@ Return Value:
         Device->TotalSectors = Identify.TotalSectors;
     }
 
+    Device->NonRotational = FALSE;
+    if (Identify.NominalRotationRate ==
+        ATA_NOMINAL_ROTATION_RATE_NON_ROTATING) {
+
+        Device->NonRotational = TRUE;
+    }
+
     //
     // Determine whether or not to do DMA to this device.
     //
@@ -331,6 +331,9 @@ Structure Description:
     Lba48Supported - Stores a boolean indicating whether or not LBA48 is
         supported.
 
+    NonRotational - Stores a boolean indicating whether or not the drive
+        reports itself as solid state rather than spinning media.
+
     TotalSectors - Stores the total number of sectors in the device.
 
     DiskInterface - Stores the disk interface.
@@ -345,6 +348,7 @@ struct _ATA_CHILD {
     UCHAR Slave;
     BOOL DmaSupported;
     BOOL Lba48Supported;
+    BOOL NonRotational;
     ULONGLONG TotalSectors;
     DISK_INTERFACE DiskInterface;
 };
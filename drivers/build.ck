@@ -42,6 +42,7 @@ function build() {
         "drivers/input:input_drivers",
         "drivers/net:net_drivers",
         "drivers/null:null",
+        "drivers/nvme:nvme",
         "drivers/part:part",
         "drivers/pci:pci",
         "drivers/plat:platform_drivers",
@@ -50,8 +51,10 @@ function build() {
         "drivers/sound:sound_drivers",
         "drivers/special:special",
         "drivers/term/ser16550:ser16550",
+        "drivers/tmpfs:tmpfs",
         "drivers/usb:usb_drivers",
-        "drivers/videocon:videocon"
+        "drivers/videocon:videocon",
+        "drivers/virtblk:virtblk"
     ];
 
     if ((arch == "armv7") || (arch == "armv6")) {
@@ -134,11 +134,18 @@ Structure Description:
     OpenFlags - Stores the flags regarding the file. See FATFS_FLAG_*
         definitions.
 
+    WriteLock - Stores a pointer to the lock that serializes writes and
+        allocations that may extend the file's cluster chain. Page cache
+        flushes can write to a file from several threads at once, and with
+        delayed allocation those writes assign clusters. This is NULL for
+        directories and page files.
+
 --*/
 
 typedef struct _FATFS_FILE {
     PVOID FileToken;
     ULONG Flags;
+    PQUEUED_LOCK WriteLock;
 } FATFS_FILE, *PFATFS_FILE;
 
 /*++
@@ -863,12 +870,24 @@ Return Value:
     RtlZeroMemory(FatFile, sizeof(FATFS_FILE));
     FatFile->FileToken = FileToken;
     FatFile->Flags = FatFsFlags;
+    if ((FatFsFlags & (FATFS_FLAG_DIRECTORY | FATFS_FLAG_PAGE_FILE)) == 0) {
+        FatFile->WriteLock = KeCreateQueuedLock();
+        if (FatFile->WriteLock == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto DispatchOpenEnd;
+        }
+    }
+
     Irp->U.Open.DeviceContext = FatFile;
     Status = STATUS_SUCCESS;
 
 DispatchOpenEnd:
     if (!KSUCCESS(Status)) {
         if (FatFile != NULL) {
+            if (FatFile->WriteLock != NULL) {
+                KeDestroyQueuedLock(FatFile->WriteLock);
+            }
+
             if (NonPaged != FALSE) {
                 MmFreeNonPagedPool(FatFile);
 
@@ -929,6 +948,10 @@ Return Value:
     FatFile = (PFATFS_FILE)Irp->U.Close.DeviceContext;
     FatVolume = (PFATFS_VOLUME)DeviceContext;
     FatCloseFile(FatFile->FileToken);
+    if (FatFile->WriteLock != NULL) {
+        KeDestroyQueuedLock(FatFile->WriteLock);
+    }
+
     if ((FatFile->Flags & FATFS_FLAG_PAGE_FILE) != 0) {
         MmFreeNonPagedPool(FatFile);
 
@@ -986,6 +1009,7 @@ Return Value:
     ULONGLONG IoOffset;
     KSTATUS Status;
     PFATFS_TRANSFER Transfer;
+    BOOL WriteLockHeld;
 
     ASSERT(Irp->Direction == IrpDown);
     ASSERT(Irp->MajorCode == IrpMajorIo);
@@ -1003,6 +1027,7 @@ Return Value:
 
     DiskIrp = NULL;
     FileProperties = NULL;
+    WriteLockHeld = FALSE;
     FatFile = (PFATFS_FILE)(Irp->U.ReadWrite.DeviceContext);
     if (((FatFile->Flags & FATFS_FLAG_PAGE_FILE) == 0) ||
         ((Irp->U.ReadWrite.IoFlags & IO_FLAG_NO_ALLOCATE) == 0)) {
@@ -1078,6 +1103,16 @@ Return Value:
         goto DispatchIoEnd;
     }
 
+    //
+    // Writes may extend the cluster chain, which must not race with other
+    // writes doing the same.
+    //
+
+    if ((Irp->MinorCode == IrpMinorIoWrite) && (FatFile->WriteLock != NULL)) {
+        KeAcquireQueuedLock(FatFile->WriteLock);
+        WriteLockHeld = TRUE;
+    }
+
     //
     // If the seek didn't get all the way to the desired offset, write some
     // zeroes.
@@ -1111,6 +1146,36 @@ Return Value:
                          IoOffset,
                          &FatSeekInformation);
 
+    //
+    // With delayed allocation, the file size can be beyond the end of the
+    // cluster chain while the page cache flushes the data in between. If
+    // this write lands past the end of the chain, fill the gap so the write
+    // can proceed. Any data destined for the gap is written over it later.
+    //
+
+    if ((Status == STATUS_END_OF_FILE) &&
+        (Irp->MinorCode == IrpMinorIoWrite) &&
+        (FileProperties != NULL)) {
+
+        Status = FatTruncate(FatVolume->VolumeToken,
+                             FatFile->FileToken,
+                             FileProperties->FileId,
+                             FatSeekInformation.FileByteOffset,
+                             IoOffset);
+
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        RtlZeroMemory(&FatSeekInformation, sizeof(FAT_SEEK_INFORMATION));
+        Status = FatFileSeek(FatFile->FileToken,
+                             DiskIrp,
+                             Irp->U.ReadWrite.IoFlags,
+                             SeekCommandFromBeginning,
+                             IoOffset,
+                             &FatSeekInformation);
+    }
+
     if (!KSUCCESS(Status)) {
         if (Status == STATUS_OUT_OF_BOUNDS) {
             Status = STATUS_END_OF_FILE;
@@ -1151,6 +1216,10 @@ Return Value:
     Irp->U.ReadWrite.NewIoOffset = IoOffset + BytesCompleted;
 
 DispatchIoEnd:
+    if (WriteLockHeld != FALSE) {
+        KeReleaseQueuedLock(FatFile->WriteLock);
+    }
+
     IoCompleteIrp(FatDriver, Irp, Status);
     return;
 }
@@ -1254,6 +1323,7 @@ Return Value:
 
 {
 
+    PSYSTEM_CONTROL_ALLOCATE Allocate;
     PSYSTEM_CONTROL_GET_BLOCK_INFORMATION BlockInformation;
     PVOID Context;
     PSYSTEM_CONTROL_CREATE Create;
@@ -1318,6 +1388,17 @@ Return Value:
                            Lookup->FileNameSize,
                            Lookup->Properties);
 
+        //
+        // Regular files can leave cached writes in the page cache until they
+        // are flushed, reserving clusters for them in the meantime.
+        //
+
+        if ((KSUCCESS(Status)) &&
+            (Lookup->Properties->Type == IoObjectRegularFile)) {
+
+            Lookup->Flags |= LOOKUP_FLAG_DELAYED_ALLOCATION;
+        }
+
         if (Lookup->DirectoryProperties != NULL) {
 
             ASSERT(DirectoryObject != NULL);
@@ -1365,6 +1446,12 @@ Return Value:
                            &(Create->DirectorySize),
                            &(Create->FileProperties));
 
+        if ((KSUCCESS(Status)) &&
+            (Create->FileProperties.Type == IoObjectRegularFile)) {
+
+            Create->Flags |= LOOKUP_FLAG_DELAYED_ALLOCATION;
+        }
+
         KeReleaseQueuedLock(DirectoryObject->Lock);
         FatpDirectoryObjectReleaseReference(Volume, DirectoryObject);
         IoCompleteIrp(FatDriver, Irp, Status);
@@ -1531,6 +1618,39 @@ Return Value:
         IoCompleteIrp(FatDriver, Irp, Status);
         break;
 
+    //
+    // Allocate or reserve clusters for a region of the file.
+    //
+
+    case IrpMinorSystemControlAllocate:
+        Allocate = (PSYSTEM_CONTROL_ALLOCATE)Context;
+
+        ASSERT(Allocate->FileProperties->Type == IoObjectRegularFile);
+        ASSERT(Allocate->DeviceContext != NULL);
+
+        File = (PFATFS_FILE)(Allocate->DeviceContext);
+        if (File->WriteLock == NULL) {
+            IoCompleteIrp(FatDriver, Irp, STATUS_NOT_SUPPORTED);
+            break;
+        }
+
+        KeAcquireQueuedLock(File->WriteLock);
+        if ((Allocate->Flags & SYSTEM_CONTROL_ALLOCATE_FLAG_RESERVE) != 0) {
+            Status = FatReserveFileClusters(File->FileToken,
+                                            Allocate->Offset,
+                                            Allocate->Size);
+
+        } else {
+            Status = FatAllocateFileClusters(
+                                      Volume->VolumeToken,
+                                      Allocate->FileProperties->FileId,
+                                      Allocate->Offset + Allocate->Size);
+        }
+
+        KeReleaseQueuedLock(File->WriteLock);
+        IoCompleteIrp(FatDriver, Irp, Status);
+        break;
+
     //
     // Get the array of block offsets and lengths for the given file.
     //
@@ -57,10 +57,13 @@ function build() {
             "drivers/net/ethernet/e1000:e1000",
             "drivers/net/ethernet/pcnet32:pcnet32",
             "drivers/net/ethernet/rtl81xx:rtl81xx",
+            "drivers/net/ethernet/virtnet:virtnet",
         ];
     }
 
-    netDrivers = ethernetDrivers + wirelessDrivers;
+    netDrivers = ethernetDrivers + wirelessDrivers + [
+        "drivers/net/loopback:loopback"
+    ];
     entries = group("net_drivers", netDrivers);
     return entries;
 }
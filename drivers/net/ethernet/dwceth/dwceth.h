@@ -82,6 +82,13 @@ Module Name:
 
 #define DWE_RECEIVE_FRAME_COUNT 32
 
+//
+// Define the maximum number of received frames handed to the networking core
+// in a single batch.
+//
+
+#define DWE_RECEIVE_BUDGET (DWE_RECEIVE_FRAME_COUNT / 2)
+
 //
 // Define the number of transmit descriptors to allocate for the controller.
 //
@@ -590,6 +597,10 @@ Structure Description:
     ReceiveLock - Stores a pointer to a queued lock that protects the
         received list.
 
+    ReceivePacket - Stores an array of packet structures used to describe a
+        batch of received frames to the networking core. These are protected
+        by the receive lock.
+
     ConfigurationLock - Stores a pointer to a queued lock that protects the
         enabled capabilities field and synchronizes configuration register
         access between capability updates and checking the link state.
@@ -677,6 +688,7 @@ typedef struct _DWE_DEVICE {
     PVOID ReceiveData;
     ULONG ReceiveBegin;
     PQUEUED_LOCK ReceiveLock;
+    NET_PACKET_BUFFER ReceivePacket[DWE_RECEIVE_BUDGET];
     PQUEUED_LOCK ConfigurationLock;
     PIO_BUFFER DescriptorIoBuffer;
     PDWE_DESCRIPTOR TransmitDescriptors;
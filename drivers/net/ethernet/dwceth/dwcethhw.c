@@ -1443,7 +1443,9 @@ DwepReapReceivedFrames (
 
 Routine Description:
 
-    This routine processes any received frames from the network.
+    This routine processes any received frames from the network. Completed
+    frames are handed to the networking core in batches of up to the receive
+    budget until no more completed frames remain.
 
 Arguments:
 
@@ -1460,137 +1462,169 @@ Return Value:
     UINTN Begin;
     PDWE_DESCRIPTOR Descriptor;
     ULONG ExtendedStatus;
-    NET_PACKET_BUFFER Packet;
+    ULONG FrameCount;
+    ULONG FrameIndex;
+    PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST PacketList;
     ULONG PayloadType;
     ULONG ReceivePhysical;
     PVOID ReceiveVirtual;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
-    //
-    // Loop grabbing completed frames.
-    //
-
-    Packet.Flags = 0;
     KeAcquireQueuedLock(Device->ReceiveLock);
     ReceivePhysical =
              (ULONG)(Device->ReceiveDataIoBuffer->Fragment[0].PhysicalAddress);
 
     ReceiveVirtual = Device->ReceiveDataIoBuffer->Fragment[0].VirtualAddress;
-    while (TRUE) {
-        Begin = Device->ReceiveBegin;
-        Descriptor = &(Device->ReceiveDescriptors[Begin]);
-
-        //
-        // If the frame is not complete, then this is the end of packets that
-        // need to be reaped.
-        //
-
-        if ((Descriptor->Control & DWE_RX_STATUS_DMA_OWNED) != 0) {
-            break;
-        }
+    do {
 
         //
-        // If the frame came through alright, send it up to the core networking
-        // library to process.
+        // Gather up a batch of completed frames, leaving them in place until
+        // the networking core is done with them.
         //
 
-        if ((Descriptor->Control & DWE_RX_STATUS_ERROR_MASK) == 0) {
-            Packet.Buffer = ReceiveVirtual +
-                            (Begin * DWE_RECEIVE_FRAME_DATA_SIZE);
-
-            Packet.BufferPhysicalAddress =
-                       ReceivePhysical + (Begin * DWE_RECEIVE_FRAME_DATA_SIZE);
+        NET_INITIALIZE_PACKET_LIST(&PacketList);
+        Begin = Device->ReceiveBegin;
+        for (FrameCount = 0; FrameCount < DWE_RECEIVE_BUDGET; FrameCount += 1) {
+            Descriptor = &(Device->ReceiveDescriptors[Begin]);
 
-            Packet.BufferSize = (Descriptor->Control >>
-                                 DWE_RX_STATUS_FRAME_LENGTH_SHIFT) &
-                                DWE_RX_STATUS_FRAME_LENGTH_MASK;
+            //
+            // If the frame is not complete, then this is the end of packets
+            // that need to be reaped.
+            //
 
-            Packet.DataSize = Packet.BufferSize;
-            Packet.DataOffset = 0;
-            Packet.FooterOffset = Packet.DataSize;
-            Packet.Flags = 0;
+            if ((Descriptor->Control & DWE_RX_STATUS_DMA_OWNED) != 0) {
+                break;
+            }
 
             //
-            // If the extended status bits are set, figure out if checksum
-            // offloading occurred.
+            // If the frame came through alright, add it to the batch to send
+            // up to the core networking library.
             //
 
-            if ((Descriptor->Control & DWE_RX_STATUS_EXTENDED_STATUS) != 0) {
-                ExtendedStatus = Descriptor->ExtendedStatus;
+            if ((Descriptor->Control & DWE_RX_STATUS_ERROR_MASK) == 0) {
+                Packet = &(Device->ReceivePacket[FrameCount]);
+                Packet->IoBuffer = NULL;
+                Packet->Buffer = ReceiveVirtual +
+                                 (Begin * DWE_RECEIVE_FRAME_DATA_SIZE);
 
-                //
-                // If an IP header error occurred, leave it at that.
-                //
+                Packet->BufferPhysicalAddress =
+                       ReceivePhysical + (Begin * DWE_RECEIVE_FRAME_DATA_SIZE);
 
-                if ((ExtendedStatus &
-                     DWE_RX_STATUS2_IP_HEADER_ERROR) != 0) {
+                Packet->BufferSize = (Descriptor->Control >>
+                                      DWE_RX_STATUS_FRAME_LENGTH_SHIFT) &
+                                     DWE_RX_STATUS_FRAME_LENGTH_MASK;
 
-                     Packet.Flags |= NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD |
-                                     NET_PACKET_FLAG_IP_CHECKSUM_FAILED;
+                Packet->DataSize = Packet->BufferSize;
+                Packet->DataOffset = 0;
+                Packet->FooterOffset = Packet->DataSize;
+                Packet->Flags = 0;
 
                 //
-                // If the checksum was not bypassed, then the IP header
-                // checksum was valid.
+                // If the extended status bits are set, figure out if checksum
+                // offloading occurred.
                 //
 
-                } else if ((ExtendedStatus &
-                            DWE_RX_STATUS2_IP_CHECKSUM_BYPASSED) == 0) {
+                if ((Descriptor->Control &
+                     DWE_RX_STATUS_EXTENDED_STATUS) != 0) {
 
-                    Packet.Flags |= NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD;
-                    PayloadType = ExtendedStatus &
-                                  DWE_RX_STATUS2_IP_PAYLOAD_TYPE_MASK;
+                    ExtendedStatus = Descriptor->ExtendedStatus;
 
                     //
-                    // Handle a TCP packet.
+                    // If an IP header error occurred, leave it at that.
                     //
 
-                    if (PayloadType == DWE_RX_STATUS2_IP_PAYLOAD_TCP) {
-                        Packet.Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD;
-                        if ((ExtendedStatus &
-                             DWE_RX_STATUS2_IP_PAYLOAD_ERROR) != 0) {
+                    if ((ExtendedStatus &
+                         DWE_RX_STATUS2_IP_HEADER_ERROR) != 0) {
 
-                            Packet.Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_FAILED;
-                        }
+                        Packet->Flags |= NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD |
+                                         NET_PACKET_FLAG_IP_CHECKSUM_FAILED;
 
                     //
-                    // Handle a UDP packet.
+                    // If the checksum was not bypassed, then the IP header
+                    // checksum was valid.
                     //
 
-                    } else if (PayloadType == DWE_RX_STATUS2_IP_PAYLOAD_UDP) {
-                        Packet.Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
-                        if ((ExtendedStatus &
-                             DWE_RX_STATUS2_IP_PAYLOAD_ERROR) != 0) {
+                    } else if ((ExtendedStatus &
+                                DWE_RX_STATUS2_IP_CHECKSUM_BYPASSED) == 0) {
 
-                            Packet.Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_FAILED;
+                        Packet->Flags |= NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD;
+                        PayloadType = ExtendedStatus &
+                                      DWE_RX_STATUS2_IP_PAYLOAD_TYPE_MASK;
+
+                        //
+                        // Handle a TCP packet.
+                        //
+
+                        if (PayloadType == DWE_RX_STATUS2_IP_PAYLOAD_TCP) {
+                            Packet->Flags |=
+                                          NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD;
+
+                            if ((ExtendedStatus &
+                                 DWE_RX_STATUS2_IP_PAYLOAD_ERROR) != 0) {
+
+                                Packet->Flags |=
+                                           NET_PACKET_FLAG_TCP_CHECKSUM_FAILED;
+                            }
+
+                        //
+                        // Handle a UDP packet.
+                        //
+
+                        } else if (PayloadType ==
+                                   DWE_RX_STATUS2_IP_PAYLOAD_UDP) {
+
+                            Packet->Flags |=
+                                          NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
+
+                            if ((ExtendedStatus &
+                                 DWE_RX_STATUS2_IP_PAYLOAD_ERROR) != 0) {
+
+                                Packet->Flags |=
+                                           NET_PACKET_FLAG_UDP_CHECKSUM_FAILED;
+                            }
                         }
                     }
                 }
+
+                NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+
+            } else {
+                RtlDebugPrint("DWE: RX Error 0x%08x\n",
+                              Descriptor->Control);
             }
 
-            NetProcessReceivedPacket(Device->NetworkLink, &Packet);
+            if (Begin == DWE_RECEIVE_FRAME_COUNT - 1) {
+                Begin = 0;
 
-        } else {
-            RtlDebugPrint("DWE: RX Error 0x%08x\n", Descriptor->Control);
+            } else {
+                Begin += 1;
+            }
         }
 
-        //
-        // Set this frame up to be reused, it will be the new end of the list.
-        //
-
-        HlWriteRegister32(&(Descriptor->Control), DWE_RX_STATUS_DMA_OWNED);
+        if (NET_PACKET_LIST_EMPTY(&PacketList) == FALSE) {
+            NetProcessReceivedPacketList(Device->NetworkLink, &PacketList);
+        }
 
         //
-        // Move the beginning pointer up.
+        // Set each frame in the batch up to be reused, moving the beginning
+        // pointer up.
         //
 
-        if (Begin == DWE_RECEIVE_FRAME_COUNT - 1) {
-            Device->ReceiveBegin = 0;
+        for (FrameIndex = 0; FrameIndex < FrameCount; FrameIndex += 1) {
+            Begin = Device->ReceiveBegin;
+            Descriptor = &(Device->ReceiveDescriptors[Begin]);
+            HlWriteRegister32(&(Descriptor->Control), DWE_RX_STATUS_DMA_OWNED);
+            if (Begin == DWE_RECEIVE_FRAME_COUNT - 1) {
+                Device->ReceiveBegin = 0;
 
-        } else {
-            Device->ReceiveBegin = Begin + 1;
+            } else {
+                Device->ReceiveBegin = Begin + 1;
+            }
         }
-    }
+
+    } while (FrameCount == DWE_RECEIVE_BUDGET);
 
     KeReleaseQueuedLock(Device->ReceiveLock);
     return;
@@ -113,6 +113,13 @@ Module Name:
 
 #define E100_RECEIVE_FRAME_COUNT 32
 
+//
+// Define the maximum number of received frames handed to the networking core
+// in a single batch.
+//
+
+#define E100_RECEIVE_BUDGET (E100_RECEIVE_FRAME_COUNT / 2)
+
 //
 // Define the amount of time to wait in microseconds for the status to move to
 // ready.
@@ -552,6 +559,10 @@ Structure Description:
     ReceiveListLock - Stores a pointer to a queued lock that protects the
         received list.
 
+    ReceivePacket - Stores an array of packet structures used to describe a
+        batch of received frames to the networking core. These are protected
+        by the receive list lock.
+
     CommandPhysicalAddress - Stores the physical address of the base of the
         command list (called a list but is really an array).
 
@@ -633,6 +644,7 @@ typedef struct _E100_DEVICE {
     PE100_RECEIVE_FRAME ReceiveFrame;
     ULONG ReceiveListBegin;
     PQUEUED_LOCK ReceiveListLock;
+    NET_PACKET_BUFFER ReceivePacket[E100_RECEIVE_BUDGET];
     PIO_BUFFER CommandIoBuffer;
     PE100_COMMAND Command;
     PNET_PACKET_BUFFER *CommandPacket;
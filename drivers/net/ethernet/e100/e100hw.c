@@ -1608,7 +1608,9 @@ E100pReapReceivedFrames (
 
 Routine Description:
 
-    This routine processes any received frames from the network.
+    This routine processes any received frames from the network. Completed
+    frames are handed to the networking core in batches of up to the receive
+    budget until no more completed frames remain.
 
 Arguments:
 
@@ -1622,84 +1624,110 @@ Return Value:
 
 {
 
+    ULONG FrameCount;
+    ULONG FrameIndex;
     PE100_RECEIVE_FRAME Frame;
     PE100_RECEIVE_FRAME LastFrame;
     ULONG ListBegin;
     ULONG ListEnd;
-    NET_PACKET_BUFFER Packet;
+    PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST PacketList;
     ULONG ReceivePhysicalAddress;
     USHORT ReceiveStatus;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
-    //
-    // Loop grabbing completed frames.
-    //
-
-    Packet.Flags = 0;
     KeAcquireQueuedLock(Device->ReceiveListLock);
     ReceivePhysicalAddress =
             (ULONG)(Device->ReceiveFrameIoBuffer->Fragment[0].PhysicalAddress);
 
-    while (TRUE) {
-        ListBegin = Device->ReceiveListBegin;
-        Frame = &(Device->ReceiveFrame[ListBegin]);
+    do {
 
         //
-        // If the frame is not complete, then this is the end of packets that
-        // need to be reaped.
+        // Gather up a batch of completed frames, leaving them in place until
+        // the networking core is done with them.
         //
 
-        if ((Frame->Status & E100_RECEIVE_COMPLETE) == 0) {
-            break;
-        }
+        NET_INITIALIZE_PACKET_LIST(&PacketList);
+        ListBegin = Device->ReceiveListBegin;
+        for (FrameCount = 0;
+             FrameCount < E100_RECEIVE_BUDGET;
+             FrameCount += 1) {
 
-        //
-        // If the frame came through alright, send it up to the core networking
-        // library to process.
-        //
+            Frame = &(Device->ReceiveFrame[ListBegin]);
+
+            //
+            // If the frame is not complete, then this is the end of packets
+            // that need to be reaped.
+            //
+
+            if ((Frame->Status & E100_RECEIVE_COMPLETE) == 0) {
+                break;
+            }
+
+            //
+            // If the frame came through alright, add it to the batch to send
+            // up to the core networking library.
+            //
 
-        if ((Frame->Status & E100_RECEIVE_OK) != 0) {
-            Packet.Buffer = (PVOID)(&(Frame->ReceiveFrame));
-            Packet.BufferPhysicalAddress = ReceivePhysicalAddress +
+            if ((Frame->Status & E100_RECEIVE_OK) != 0) {
+                Packet = &(Device->ReceivePacket[FrameCount]);
+                Packet->Buffer = (PVOID)(&(Frame->ReceiveFrame));
+                Packet->IoBuffer = NULL;
+                Packet->BufferPhysicalAddress = ReceivePhysicalAddress +
                                       (ListBegin * sizeof(E100_RECEIVE_FRAME));
 
-            Packet.BufferSize = Frame->Sizes &
-                                E100_RECEIVE_SIZE_ACTUAL_COUNT_MASK;
+                Packet->Flags = 0;
+                Packet->BufferSize = Frame->Sizes &
+                                     E100_RECEIVE_SIZE_ACTUAL_COUNT_MASK;
+
+                Packet->DataSize = Packet->BufferSize;
+                Packet->DataOffset = 0;
+                Packet->FooterOffset = Packet->DataSize;
+                NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+            }
+
+            ListBegin = E100_INCREMENT_RING_INDEX(ListBegin,
+                                                  E100_RECEIVE_FRAME_COUNT);
+        }
 
-            Packet.DataSize = Packet.BufferSize;
-            Packet.DataOffset = 0;
-            Packet.FooterOffset = Packet.DataSize;
-            NetProcessReceivedPacket(Device->NetworkLink, &Packet);
+        if (NET_PACKET_LIST_EMPTY(&PacketList) == FALSE) {
+            NetProcessReceivedPacketList(Device->NetworkLink, &PacketList);
         }
 
         //
-        // Set this frame up to be reused, it will be the new end of the list.
+        // Set each frame in the batch up to be reused. Each will be the new
+        // end of the list in turn.
         //
 
-        Frame->Status = E100_RECEIVE_COMMAND_SUSPEND;
-        Frame->Sizes = RECEIVE_FRAME_DATA_SIZE <<
-                       E100_RECEIVE_SIZE_BUFFER_SIZE_SHIFT;
+        for (FrameIndex = 0; FrameIndex < FrameCount; FrameIndex += 1) {
+            ListBegin = Device->ReceiveListBegin;
+            Frame = &(Device->ReceiveFrame[ListBegin]);
+            Frame->Status = E100_RECEIVE_COMMAND_SUSPEND;
+            Frame->Sizes = RECEIVE_FRAME_DATA_SIZE <<
+                           E100_RECEIVE_SIZE_BUFFER_SIZE_SHIFT;
 
-        //
-        // Clear the end of list bit in the previous final frame. The atomic
-        // AND also acts as a full memory barrier.
-        //
+            //
+            // Clear the end of list bit in the previous final frame. The
+            // atomic AND also acts as a full memory barrier.
+            //
 
-        ListEnd = E100_DECREMENT_RING_INDEX(ListBegin,
-                                            E100_RECEIVE_FRAME_COUNT);
+            ListEnd = E100_DECREMENT_RING_INDEX(ListBegin,
+                                                E100_RECEIVE_FRAME_COUNT);
 
-        LastFrame = &(Device->ReceiveFrame[ListEnd]);
-        RtlAtomicAnd32(&(LastFrame->Status), ~E100_RECEIVE_COMMAND_SUSPEND);
+            LastFrame = &(Device->ReceiveFrame[ListEnd]);
+            RtlAtomicAnd32(&(LastFrame->Status), ~E100_RECEIVE_COMMAND_SUSPEND);
 
-        //
-        // Move the beginning pointer up.
-        //
+            //
+            // Move the beginning pointer up.
+            //
 
-        Device->ReceiveListBegin = E100_INCREMENT_RING_INDEX(
+            Device->ReceiveListBegin = E100_INCREMENT_RING_INDEX(
                                                       ListBegin,
                                                       E100_RECEIVE_FRAME_COUNT);
-    }
+        }
+
+    } while (FrameCount == E100_RECEIVE_BUDGET);
 
     //
     // Resume the receive unit if it's not active.
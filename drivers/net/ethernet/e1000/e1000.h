@@ -76,6 +76,13 @@ Module Name:
 
 #define E1000_RX_RING_SIZE 128
 
+//
+// Define the maximum number of received frames handed to the networking core
+// in a single batch.
+//
+
+#define E1000_RX_BUDGET NET_RECEIVE_DEFAULT_BUDGET
+
 //
 // Define the number of receive address registers in the device.
 //
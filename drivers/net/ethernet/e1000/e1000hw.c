@@ -2671,7 +2671,10 @@ E1000pReapReceivedFrames (
 
 Routine Description:
 
-    This routine processes any received frames from the network.
+    This routine processes any received frames from the network. Frames are
+    handed to the networking core in batches of up to the receive budget, and
+    the ring is polled until it runs dry. Interrupts remain masked by the
+    caller while this runs.
 
 Arguments:
 
@@ -2685,90 +2688,131 @@ Return Value:
 
 {
 
+    ULONG BatchCount;
+    PLIST_ENTRY CurrentEntry;
     PE1000_RX_DESCRIPTOR Descriptor;
     ULONG DescriptorIndex;
     ULONG Flags;
     ULONG NewTail;
     PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST PacketList;
 
     KeAcquireQueuedLock(Device->RxListLock);
-    DescriptorIndex = Device->RxListBegin;
-    Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
-    while ((Descriptor->Status & E1000_RX_STATUS_DONE) != 0) {
+    do {
+        BatchCount = 0;
+        NET_INITIALIZE_PACKET_LIST(&PacketList);
+        DescriptorIndex = Device->RxListBegin;
+        Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
+        while (((Descriptor->Status & E1000_RX_STATUS_DONE) != 0) &&
+               (BatchCount < E1000_RX_BUDGET)) {
 
-        //
-        // Handling packets that spawn multiple descriptors is not currently
-        // supported.
-        //
+            //
+            // Handling packets that spawn multiple descriptors is not
+            // currently supported.
+            //
 
-        ASSERT((Descriptor->Status & E1000_RX_STATUS_END_OF_PACKET) != 0);
+            ASSERT((Descriptor->Status & E1000_RX_STATUS_END_OF_PACKET) != 0);
 
-        if (Descriptor->Errors != 0) {
-            RtlDebugPrint("E1000: RX Packet Error %02x\n", Descriptor->Errors);
-        }
+            if (Descriptor->Errors != 0) {
+                RtlDebugPrint("E1000: RX Packet Error %02x\n",
+                              Descriptor->Errors);
+            }
 
-        Packet = Device->RxPackets[DescriptorIndex];
+            Packet = Device->RxPackets[DescriptorIndex];
 
-        ASSERT(Packet->BufferPhysicalAddress == Descriptor->Address);
+            ASSERT(Packet->BufferPhysicalAddress == Descriptor->Address);
 
-        Packet->DataSize = Descriptor->Length;
-        Packet->DataOffset = 0;
-        Packet->FooterOffset = Packet->DataSize;
+            Packet->DataSize = Descriptor->Length;
+            Packet->DataOffset = 0;
+            Packet->FooterOffset = Packet->DataSize;
 
-        //
-        // Determine the checksum offload flags, if the hardware computed them.
-        //
+            //
+            // Determine the checksum offload flags, if the hardware computed
+            // them. The receive buffers came from the networking core, so it
+            // is free to keep them.
+            //
+
+            Flags = NET_PACKET_FLAG_EXCHANGEABLE;
+            if ((Descriptor->Status & E1000_RX_STATUS_IGNORE_CHECKSUM) == 0) {
+                if ((Descriptor->Status & E1000_RX_STATUS_IP4_CHECKSUM) != 0) {
+                    if ((Descriptor->Errors &
+                         E1000_RX_ERROR_IP_CHECKSUM) != 0) {
 
-        Flags = 0;
-        if ((Descriptor->Status & E1000_RX_STATUS_IGNORE_CHECKSUM) == 0) {
-            if ((Descriptor->Status & E1000_RX_STATUS_IP4_CHECKSUM) != 0) {
-                if ((Descriptor->Errors & E1000_RX_ERROR_IP_CHECKSUM) != 0) {
-                    Flags |= NET_PACKET_FLAG_IP_CHECKSUM_FAILED;
+                        Flags |= NET_PACKET_FLAG_IP_CHECKSUM_FAILED;
 
-                } else {
-                    Flags |= NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD;
+                    } else {
+                        Flags |= NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD;
+                    }
                 }
-            }
 
-            if ((Descriptor->Status & E1000_RX_STATUS_TCP_CHECKSUM) != 0) {
-                if ((Descriptor->Errors &
-                     E1000_RX_ERROR_TCP_UDP_CHECKSUM) != 0) {
+                if ((Descriptor->Status & E1000_RX_STATUS_TCP_CHECKSUM) != 0) {
+                    if ((Descriptor->Errors &
+                         E1000_RX_ERROR_TCP_UDP_CHECKSUM) != 0) {
 
-                    Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_FAILED;
+                        Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_FAILED;
 
-                } else {
-                    Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD;
+                    } else {
+                        Flags |= NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD;
+                    }
                 }
-            }
 
-            if ((Descriptor->Status & E1000_RX_STATUS_UDP_CHECKSUM) != 0) {
-                if ((Descriptor->Errors &
-                     E1000_RX_ERROR_TCP_UDP_CHECKSUM) != 0) {
+                if ((Descriptor->Status & E1000_RX_STATUS_UDP_CHECKSUM) != 0) {
+                    if ((Descriptor->Errors &
+                         E1000_RX_ERROR_TCP_UDP_CHECKSUM) != 0) {
 
-                    Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_FAILED;
+                        Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_FAILED;
 
-                } else {
-                    Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
+                    } else {
+                        Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
+                    }
                 }
             }
+
+            Packet->Flags = Flags;
+            NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+            BatchCount += 1;
+            DescriptorIndex += 1;
+            if (DescriptorIndex == E1000_RX_RING_SIZE) {
+                DescriptorIndex = 0;
+            }
+
+            Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
         }
 
-        Packet->Flags = Flags;
-        NetProcessReceivedPacket(Device->NetworkLink, Packet);
-        Descriptor->Status = 0;
-        DescriptorIndex += 1;
-        if (DescriptorIndex == E1000_RX_RING_SIZE) {
-            DescriptorIndex = 0;
+        if (BatchCount == 0) {
+            break;
         }
 
-        Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
-    }
+        NetProcessReceivedPacketList(Device->NetworkLink, &PacketList);
 
-    //
-    // Write the new tail if there is one.
-    //
+        //
+        // The packets come back in order. The networking core may have
+        // swapped in new buffers for some of them, so reprogram each
+        // descriptor before giving it back to the hardware.
+        //
+
+        DescriptorIndex = Device->RxListBegin;
+        CurrentEntry = PacketList.Head.Next;
+        while (CurrentEntry != &(PacketList.Head)) {
+            Packet = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
+            CurrentEntry = CurrentEntry->Next;
+
+            ASSERT(Packet == Device->RxPackets[DescriptorIndex]);
+
+            Descriptor = &(Device->RxDescriptors[DescriptorIndex]);
+            Descriptor->Address = Packet->BufferPhysicalAddress;
+            Descriptor->Length = 0;
+            Descriptor->Status = 0;
+            DescriptorIndex += 1;
+            if (DescriptorIndex == E1000_RX_RING_SIZE) {
+                DescriptorIndex = 0;
+            }
+        }
+
+        //
+        // Write the new tail.
+        //
 
-    if (DescriptorIndex != Device->RxListBegin) {
         Device->RxListBegin = DescriptorIndex;
         if (DescriptorIndex == 0) {
             NewTail = E1000_RX_RING_SIZE - 1;
@@ -2779,7 +2823,8 @@ Return Value:
 
         RtlMemoryBarrier();
         E1000_WRITE(Device, E1000RxDescriptorTail0, NewTail);
-    }
+
+    } while (BatchCount == E1000_RX_BUDGET);
 
     KeReleaseQueuedLock(Device->RxListLock);
     return;
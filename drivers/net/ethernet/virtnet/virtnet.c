@@ -0,0 +1,1250 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtnet.c
+
+Abstract:
+
+    This module implements support for the driver portion of the virtio
+    network device.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include "virtnet.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtnetAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+VirtnetDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtnetDestroyLink (
+    PVOID DeviceContext
+    );
+
+KSTATUS
+VirtnetpProcessResourceRequirements (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    );
+
+KSTATUS
+VirtnetpStartDevice (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    );
+
+KSTATUS
+VirtnetpEnableMsiX (
+    PVIRTNET_DEVICE Device
+    );
+
+KSTATUS
+VirtnetpConnectInterrupts (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    );
+
+VOID
+VirtnetpDisconnectInterrupts (
+    PVIRTNET_DEVICE Device
+    );
+
+VOID
+VirtnetpProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VirtnetDriver = NULL;
+UUID VirtnetPciMsiInterfaceUuid = UUID_PCI_MESSAGE_SIGNALED_INTERRUPTS;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the virtio network driver. It registers
+    its other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    KSTATUS Status;
+
+    VirtnetDriver = Driver;
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    FunctionTable.AddDevice = VirtnetAddDevice;
+    FunctionTable.DispatchStateChange = VirtnetDispatchStateChange;
+    FunctionTable.DispatchOpen = VirtnetDispatchOpen;
+    FunctionTable.DispatchClose = VirtnetDispatchClose;
+    FunctionTable.DispatchIo = VirtnetDispatchIo;
+    FunctionTable.DispatchSystemControl = VirtnetDispatchSystemControl;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    return Status;
+}
+
+KSTATUS
+VirtnetAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the virtio
+    network driver acts as the function driver. The driver will attach itself
+    to the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    KSTATUS Status;
+
+    Device = MmAllocateNonPagedPool(sizeof(VIRTNET_DEVICE),
+                                    VIRTNET_ALLOCATION_TAG);
+
+    if (Device == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Device, sizeof(VIRTNET_DEVICE));
+    Device->InterruptHandle = INVALID_HANDLE;
+    Device->OsDevice = DeviceToken;
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device != NULL) {
+            MmFreeNonPagedPool(Device);
+            Device = NULL;
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VirtnetDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorStateChange);
+
+    if (Irp->Direction == IrpUp) {
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = VirtnetpProcessResourceRequirements(Irp, DeviceContext);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtnetDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = VirtnetpStartDevice(Irp, DeviceContext);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtnetDriver, Irp, Status);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtnetDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VirtnetDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VirtnetDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VirtnetDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    PSYSTEM_CONTROL_DEVICE_INFORMATION DeviceInformationRequest;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorSystemControlDeviceInformation:
+            DeviceInformationRequest = Irp->U.SystemControl.SystemContext;
+            Status = NetGetSetLinkDeviceInformation(
+                                         Device->NetworkLink,
+                                         &(DeviceInformationRequest->Uuid),
+                                         DeviceInformationRequest->Data,
+                                         &(DeviceInformationRequest->DataSize),
+                                         DeviceInformationRequest->Set);
+
+            IoCompleteIrp(VirtnetDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+VirtnetpAddNetworkDevice (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the device to core networking's available links.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to add.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PNET_PACKET_SIZE_INFORMATION PacketSizeInformation;
+    NET_LINK_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if (Device->NetworkLink != NULL) {
+        Status = STATUS_SUCCESS;
+        goto AddNetworkDeviceEnd;
+    }
+
+    //
+    // Add a link to the core networking library.
+    //
+
+    RtlZeroMemory(&Properties, sizeof(NET_LINK_PROPERTIES));
+    Properties.Version = NET_LINK_PROPERTIES_VERSION;
+    Properties.TransmitAlignment = 1;
+    Properties.Device = Device->OsDevice;
+    Properties.DeviceContext = Device;
+    PacketSizeInformation = &(Properties.PacketSizeInformation);
+    PacketSizeInformation->MaxPacketSize = VIRTNET_MAX_TRANSMIT_PACKET_SIZE;
+    Properties.DataLinkType = NetDomainEthernet;
+    Properties.MaxPhysicalAddress = MAX_ULONGLONG;
+    Properties.PhysicalAddress.Domain = NetDomainEthernet;
+    Properties.Capabilities = Device->SupportedCapabilities;
+    RtlCopyMemory(&(Properties.PhysicalAddress.Address),
+                  &(Device->MacAddress),
+                  sizeof(Device->MacAddress));
+
+    Properties.Interface.Send = VirtnetSend;
+    Properties.Interface.GetSetInformation = VirtnetGetSetInformation;
+    Properties.Interface.DestroyLink = VirtnetDestroyLink;
+    Status = NetAddLink(&Properties, &(Device->NetworkLink));
+    if (!KSUCCESS(Status)) {
+        goto AddNetworkDeviceEnd;
+    }
+
+AddNetworkDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device->NetworkLink != NULL) {
+            NetRemoveLink(Device->NetworkLink);
+            Device->NetworkLink = NULL;
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VirtnetDestroyLink (
+    PVOID DeviceContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device layer that the networking core is in the
+    process of destroying the link and will no longer call into the device for
+    this link. This allows the device layer to release any context that was
+    supporting the device link interface.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtnetpProcessResourceRequirements (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine filters through the resource requirements presented by the
+    bus for a virtio network device. If MSI-X is available, it requests one
+    vector per processor (up to the queue pair limit) plus one for
+    configuration changes. Otherwise it adds an interrupt vector requirement
+    for any interrupt line requested.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Device - Supplies a pointer to the device information.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_CONFIGURATION_LIST ConfigurationList;
+    ULONGLONG EdgeTriggered;
+    ULONG Index;
+    ULONGLONG LineCharacteristics;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    PRESOURCE_REQUIREMENT NextRequirement;
+    ULONG PairCount;
+    PRESOURCE_REQUIREMENT Requirement;
+    PRESOURCE_REQUIREMENT_LIST RequirementList;
+    KSTATUS Status;
+    ULONGLONG VectorCharacteristics;
+    ULONG VectorCount;
+    PRESOURCE_REQUIREMENT VectorRequirement;
+    RESOURCE_REQUIREMENT VectorTemplate;
+
+    ASSERT((Irp->MajorCode == IrpMajorStateChange) &&
+           (Irp->MinorCode == IrpMinorQueryResources));
+
+    //
+    // Initialize a nice interrupt vector requirement in preparation.
+    //
+
+    RtlZeroMemory(&VectorTemplate, sizeof(RESOURCE_REQUIREMENT));
+    VectorTemplate.Type = ResourceTypeInterruptVector;
+    VectorTemplate.Minimum = 0;
+    VectorTemplate.Maximum = -1;
+    VectorTemplate.Length = 1;
+
+    //
+    // Prefer MSI-X over legacy interrupts, as it allows each queue pair to
+    // interrupt its own processor.
+    //
+
+    if ((Device->PciMsiFlags &
+         VIRTNET_PCI_MSI_FLAG_INTERFACE_REGISTERED) == 0) {
+
+        Status = IoRegisterForInterfaceNotifications(
+                            &VirtnetPciMsiInterfaceUuid,
+                            VirtnetpProcessPciMsiInterfaceChangeNotification,
+                            Irp->Device,
+                            Device,
+                            TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Device->PciMsiFlags |= VIRTNET_PCI_MSI_FLAG_INTERFACE_REGISTERED;
+    }
+
+    //
+    // Figure out how many vectors to ask for. The device needs at least two:
+    // one for a queue pair and one for configuration changes.
+    //
+
+    VectorCount = 0;
+    if ((Device->PciMsiFlags & VIRTNET_PCI_MSI_FLAG_INTERFACE_AVAILABLE) != 0) {
+        MsiInterface = &(Device->PciMsiInterface);
+        RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+        MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+        MsiInformation.MsiType = PciMsiTypeExtended;
+        Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                                 &MsiInformation,
+                                                 FALSE);
+
+        if ((KSUCCESS(Status)) && (MsiInformation.MaxVectorCount >= 2)) {
+            PairCount = KeGetActiveProcessorCount();
+            if (PairCount > VIRTNET_MAX_QUEUE_PAIRS) {
+                PairCount = VIRTNET_MAX_QUEUE_PAIRS;
+            }
+
+            if (PairCount > (MsiInformation.MaxVectorCount - 1)) {
+                PairCount = MsiInformation.MaxVectorCount - 1;
+            }
+
+            VectorCount = PairCount + 1;
+        }
+    }
+
+    ConfigurationList = Irp->U.QueryResources.ResourceRequirements;
+    if (VectorCount != 0) {
+        RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                         NULL);
+
+        while (RequirementList != NULL) {
+            for (Index = 0; Index < VectorCount; Index += 1) {
+                VectorTemplate.Characteristics =
+                                               INTERRUPT_VECTOR_EDGE_TRIGGERED;
+
+                VectorTemplate.OwningRequirement = NULL;
+                Status = IoCreateAndAddResourceRequirement(&VectorTemplate,
+                                                           RequirementList,
+                                                           &VectorRequirement);
+
+                if (!KSUCCESS(Status)) {
+                    goto ProcessResourceRequirementsEnd;
+                }
+
+                //
+                // In case the MSI-X vectors cannot be allocated, give the
+                // first vector alternatives for each interrupt line so the
+                // device can fall back to a single line interrupt.
+                //
+
+                if (Index != 0) {
+                    continue;
+                }
+
+                Requirement = IoGetNextResourceRequirement(RequirementList,
+                                                           NULL);
+
+                while (Requirement != NULL) {
+                    NextRequirement = IoGetNextResourceRequirement(
+                                                               RequirementList,
+                                                               Requirement);
+
+                    if (Requirement->Type != ResourceTypeInterruptLine) {
+                        Requirement = NextRequirement;
+                        continue;
+                    }
+
+                    VectorCharacteristics = 0;
+                    LineCharacteristics = Requirement->Characteristics;
+                    if ((LineCharacteristics & INTERRUPT_LINE_ACTIVE_LOW) != 0) {
+                        VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_LOW;
+                    }
+
+                    if ((LineCharacteristics &
+                         INTERRUPT_LINE_ACTIVE_HIGH) != 0) {
+
+                        VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_HIGH;
+                    }
+
+                    EdgeTriggered = LineCharacteristics &
+                                    INTERRUPT_LINE_EDGE_TRIGGERED;
+
+                    if (EdgeTriggered != 0) {
+                        VectorCharacteristics |=
+                                               INTERRUPT_VECTOR_EDGE_TRIGGERED;
+                    }
+
+                    VectorTemplate.Characteristics = VectorCharacteristics;
+                    VectorTemplate.OwningRequirement = Requirement;
+                    Status = IoCreateAndAddResourceRequirementAlternative(
+                                                            &VectorTemplate,
+                                                            VectorRequirement);
+
+                    if (!KSUCCESS(Status)) {
+                        goto ProcessResourceRequirementsEnd;
+                    }
+
+                    Requirement = NextRequirement;
+                }
+            }
+
+            RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                             RequirementList);
+        }
+
+        Device->PciMsiFlags |= VIRTNET_PCI_MSI_FLAG_RESOURCES_REQUESTED;
+
+    //
+    // Otherwise stick with the good, old legacy interrupt setup.
+    //
+
+    } else {
+
+        //
+        // Loop through all configuration lists and add vectors for each line.
+        //
+
+        Status = IoCreateAndAddInterruptVectorsForLines(ConfigurationList,
+                                                        &VectorTemplate);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+    }
+
+    Status = STATUS_SUCCESS;
+
+ProcessResourceRequirementsEnd:
+    return Status;
+}
+
+KSTATUS
+VirtnetpStartDevice (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the virtio network device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Device - Supplies a pointer to the device information.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_ALLOCATION Allocation;
+    PRESOURCE_ALLOCATION_LIST AllocationList;
+    PRESOURCE_ALLOCATION IoPort;
+    PRESOURCE_ALLOCATION LineAllocation;
+    ULONG PairCount;
+    KSTATUS Status;
+
+    IoPort = NULL;
+    Device->MsiVectorCount = 0;
+
+    //
+    // Loop through the allocated resources to get the I/O port range and the
+    // interrupts.
+    //
+
+    AllocationList = Irp->U.StartDevice.ProcessorLocalResources;
+    Allocation = IoGetNextResourceAllocation(AllocationList, NULL);
+    while (Allocation != NULL) {
+
+        //
+        // If the resource is an interrupt vector the presense of an owning
+        // interrupt line allocation will dictate whether or not MSI-X is used
+        // versus legacy interrupts.
+        //
+
+        if (Allocation->Type == ResourceTypeInterruptVector) {
+            LineAllocation = Allocation->OwningAllocation;
+            if (LineAllocation == NULL) {
+
+                ASSERT((Device->PciMsiFlags &
+                        VIRTNET_PCI_MSI_FLAG_RESOURCES_REQUESTED) != 0);
+
+                ASSERT(Allocation->Characteristics ==
+                       INTERRUPT_VECTOR_EDGE_TRIGGERED);
+
+                if (Device->MsiVectorCount < (VIRTNET_MAX_QUEUE_PAIRS + 1)) {
+                    Device->MsiVectors[Device->MsiVectorCount] =
+                                                        Allocation->Allocation;
+
+                    Device->MsiVectorCount += 1;
+                }
+
+            } else {
+
+                ASSERT(LineAllocation->Type == ResourceTypeInterruptLine);
+
+                Device->InterruptLine = LineAllocation->Allocation;
+                Device->InterruptVector = Allocation->Allocation;
+                Device->InterruptResourcesFound = TRUE;
+            }
+
+        //
+        // Look for the first I/O port range, the legacy virtio registers.
+        //
+
+        } else if (Allocation->Type == ResourceTypeIoPort) {
+            if ((IoPort == NULL) && (Allocation->Length != 0)) {
+                IoPort = Allocation;
+            }
+        }
+
+        //
+        // Get the next allocation in the list.
+        //
+
+        Allocation = IoGetNextResourceAllocation(AllocationList, Allocation);
+    }
+
+    //
+    // Fail to start if the registers were not found.
+    //
+
+    if (IoPort == NULL) {
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto StartDeviceEnd;
+    }
+
+    Device->IoPortAddress = (USHORT)IoPort->Allocation;
+
+    //
+    // Use MSI-X if the first vector did not fall back to a line and at least
+    // one queue pair vector plus the configuration vector came through.
+    // Otherwise run a single queue pair off of the line interrupt.
+    //
+
+    PairCount = 1;
+    if ((Device->InterruptResourcesFound == FALSE) &&
+        (Device->MsiVectorCount >= 2)) {
+
+        Device->PciMsiFlags |= VIRTNET_PCI_MSI_FLAG_RESOURCES_ALLOCATED;
+        Device->InterruptLine = INVALID_INTERRUPT_LINE;
+        Device->InterruptVector =
+                                Device->MsiVectors[Device->MsiVectorCount - 1];
+
+        Device->InterruptResourcesFound = TRUE;
+        PairCount = Device->MsiVectorCount - 1;
+
+    } else {
+        Device->PciMsiFlags &= ~VIRTNET_PCI_MSI_FLAG_RESOURCES_ALLOCATED;
+        Device->MsiVectorCount = 0;
+        if (Device->InterruptResourcesFound == FALSE) {
+            Status = STATUS_INVALID_CONFIGURATION;
+            goto StartDeviceEnd;
+        }
+    }
+
+    //
+    // MSI-X must be enabled before the device is touched, as it moves the
+    // device specific configuration and exposes the vector registers.
+    //
+
+    Device->ConfigurationOffset = VirtioRegisterDeviceConfiguration;
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        Status = VirtnetpEnableMsiX(Device);
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+
+        Device->ConfigurationOffset = VirtioRegisterMsixDeviceConfiguration;
+    }
+
+    //
+    // Reset the device, negotiate features, and set up the queues.
+    //
+
+    Status = VirtnetpInitializeDeviceStructures(Device, PairCount);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VirtnetpConnectInterrupts(Irp, Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    //
+    // Start up the device.
+    //
+
+    Status = VirtnetpInitialize(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+StartDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device->NetworkLink != NULL) {
+            NetRemoveLink(Device->NetworkLink);
+            Device->NetworkLink = NULL;
+        }
+
+        VirtnetpDisconnectInterrupts(Device);
+        VirtnetpDestroyDeviceStructures(Device);
+    }
+
+    return Status;
+}
+
+KSTATUS
+VirtnetpEnableMsiX (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine programs the MSI-X table and enables MSI-X for the device.
+    Each queue pair vector is steered to its own processor, while the
+    configuration change vector may go anywhere.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Index;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    ULONG ProcessorCount;
+    PROCESSOR_SET ProcessorSet;
+    KSTATUS Status;
+
+    ASSERT((Device->PciMsiFlags &
+            VIRTNET_PCI_MSI_FLAG_RESOURCES_ALLOCATED) != 0);
+
+    MsiInterface = &(Device->PciMsiInterface);
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (Index = 0; Index < Device->MsiVectorCount; Index += 1) {
+        if (Index == (Device->MsiVectorCount - 1)) {
+            ProcessorSet.Target = ProcessorTargetAny;
+
+        } else {
+            ProcessorSet.Target = ProcessorTargetSingleProcessor;
+            ProcessorSet.U.Number = Index % ProcessorCount;
+        }
+
+        Status = MsiInterface->SetVectors(MsiInterface->DeviceToken,
+                                          PciMsiTypeExtended,
+                                          Device->MsiVectors[Index],
+                                          Index,
+                                          1,
+                                          &ProcessorSet);
+
+        if (!KSUCCESS(Status)) {
+            goto EnableMsiXEnd;
+        }
+    }
+
+    RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+    MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+    MsiInformation.MsiType = PciMsiTypeExtended;
+    MsiInformation.Flags = PCI_MSI_INTERFACE_FLAG_ENABLED;
+    MsiInformation.VectorCount = Device->MsiVectorCount;
+    Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                             &MsiInformation,
+                                             TRUE);
+
+    if (!KSUCCESS(Status)) {
+        goto EnableMsiXEnd;
+    }
+
+EnableMsiXEnd:
+    return Status;
+}
+
+KSTATUS
+VirtnetpConnectInterrupts (
+    PIRP Irp,
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine connects the device's interrupts. With MSI-X, each queue pair
+    gets its own interrupt and a final interrupt handles configuration
+    changes. Otherwise a single line interrupt handles everything.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    ULONG Index;
+    PVIRTNET_QUEUE_PAIR Pair;
+    KSTATUS Status;
+
+    ASSERT(Device->InterruptHandle == INVALID_HANDLE);
+
+    RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+    Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+    Connect.Device = Irp->Device;
+    Connect.LineNumber = INVALID_INTERRUPT_LINE;
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        for (Index = 0; Index < Device->QueuePairCount; Index += 1) {
+            Pair = &(Device->QueuePairs[Index]);
+            Pair->InterruptVector = Device->MsiVectors[Index];
+            Connect.Vector = Pair->InterruptVector;
+            Connect.InterruptServiceRoutine =
+                                            VirtnetpQueuePairInterruptService;
+
+            Connect.LowLevelServiceRoutine =
+                                      VirtnetpQueuePairInterruptServiceWorker;
+
+            Connect.Context = Pair;
+            Connect.Interrupt = &(Pair->InterruptHandle);
+            Status = IoConnectInterrupt(&Connect);
+            if (!KSUCCESS(Status)) {
+                goto ConnectInterruptsEnd;
+            }
+        }
+    }
+
+    Connect.LineNumber = Device->InterruptLine;
+    Connect.Vector = Device->InterruptVector;
+    Connect.InterruptServiceRoutine = VirtnetpInterruptService;
+    Connect.LowLevelServiceRoutine = VirtnetpInterruptServiceWorker;
+    Connect.Context = Device;
+    Connect.Interrupt = &(Device->InterruptHandle);
+    Status = IoConnectInterrupt(&Connect);
+    if (!KSUCCESS(Status)) {
+        goto ConnectInterruptsEnd;
+    }
+
+ConnectInterruptsEnd:
+    return Status;
+}
+
+VOID
+VirtnetpDisconnectInterrupts (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine disconnects any interrupts connected for the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PVIRTNET_QUEUE_PAIR Pair;
+
+    if (Device->InterruptHandle != INVALID_HANDLE) {
+        IoDisconnectInterrupt(Device->InterruptHandle);
+        Device->InterruptHandle = INVALID_HANDLE;
+    }
+
+    if (Device->QueuePairs == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < Device->QueuePairCount; Index += 1) {
+        Pair = &(Device->QueuePairs[Index]);
+        if (Pair->InterruptHandle != INVALID_HANDLE) {
+            IoDisconnectInterrupt(Pair->InterruptHandle);
+            Pair->InterruptHandle = INVALID_HANDLE;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtnetpProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI MSI interface changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE VirtnetDevice;
+
+    VirtnetDevice = (PVIRTNET_DEVICE)Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_MSI)) {
+
+            ASSERT((VirtnetDevice->PciMsiFlags &
+                    VIRTNET_PCI_MSI_FLAG_INTERFACE_AVAILABLE) == 0);
+
+            RtlCopyMemory(&(VirtnetDevice->PciMsiInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_MSI));
+
+            VirtnetDevice->PciMsiFlags |=
+                                      VIRTNET_PCI_MSI_FLAG_INTERFACE_AVAILABLE;
+        }
+
+    } else {
+        VirtnetDevice->PciMsiFlags &= ~VIRTNET_PCI_MSI_FLAG_INTERFACE_AVAILABLE;
+    }
+
+    return;
+}
+
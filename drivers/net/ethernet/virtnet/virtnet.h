@@ -0,0 +1,818 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtnet.h
+
+Abstract:
+
+    This header contains definitions for the virtio network device.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/intrface/pci.h>
+#include <minoca/virtio/virtio.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// Define macros for accessing the legacy virtio registers, which live in I/O
+// port space.
+//
+
+#define VIRTNET_READ_REGISTER32(_Controller, _Register) \
+    HlIoPortInLong((_Controller)->IoPortAddress + (_Register))
+
+#define VIRTNET_READ_REGISTER16(_Controller, _Register) \
+    HlIoPortInShort((_Controller)->IoPortAddress + (_Register))
+
+#define VIRTNET_READ_REGISTER8(_Controller, _Register) \
+    HlIoPortInByte((_Controller)->IoPortAddress + (_Register))
+
+#define VIRTNET_WRITE_REGISTER32(_Controller, _Register, _Value) \
+    HlIoPortOutLong((_Controller)->IoPortAddress + (_Register), (_Value))
+
+#define VIRTNET_WRITE_REGISTER16(_Controller, _Register, _Value) \
+    HlIoPortOutShort((_Controller)->IoPortAddress + (_Register), (_Value))
+
+#define VIRTNET_WRITE_REGISTER8(_Controller, _Register, _Value) \
+    HlIoPortOutByte((_Controller)->IoPortAddress + (_Register), (_Value))
+
+//
+// Define macros for accessing the network specific configuration, which
+// follows the common registers.
+//
+
+#define VIRTNET_READ_CONFIGURATION16(_Controller, _Offset)  \
+    HlIoPortInShort((_Controller)->IoPortAddress +          \
+                    (_Controller)->ConfigurationOffset +    \
+                    (_Offset))
+
+#define VIRTNET_READ_CONFIGURATION8(_Controller, _Offset)   \
+    HlIoPortInByte((_Controller)->IoPortAddress +           \
+                   (_Controller)->ConfigurationOffset +     \
+                   (_Offset))
+
+//
+// Define the virtio queue numbers for a given queue pair.
+//
+
+#define VIRTNET_RECEIVE_QUEUE_INDEX(_Pair) ((_Pair) * 2)
+#define VIRTNET_TRANSMIT_QUEUE_INDEX(_Pair) (((_Pair) * 2) + 1)
+
+//
+// This macro returns the number of packet descriptor chains a queue holds.
+//
+
+#define VIRTNET_QUEUE_CHAIN_COUNT(_Queue) \
+    ((_Queue)->Size / VIRTNET_DESCRIPTORS_PER_PACKET)
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define VIRTNET_ALLOCATION_TAG 0x746E7256 // 'tnrV'
+
+//
+// Define the maximum number of queue pairs the driver will use. One interrupt
+// vector is used per pair, plus one for configuration changes.
+//
+
+#define VIRTNET_MAX_QUEUE_PAIRS 8
+
+//
+// Define the number of descriptors used per packet. Each packet is a chain of
+// a virtio network header and the frame itself.
+//
+
+#define VIRTNET_DESCRIPTORS_PER_PACKET 2
+
+//
+// Define the size of each receive buffer. Mergeable receive buffers are not
+// negotiated, so each buffer must hold a full frame.
+//
+
+#define VIRTNET_RECEIVE_FRAME_SIZE 1536
+
+//
+// Define the maximum number of received frames handed to the networking core
+// at once.
+//
+
+#define VIRTNET_RECEIVE_BUDGET NET_RECEIVE_DEFAULT_BUDGET
+
+//
+// Define the maximum size of a standard frame sent to the device. Larger
+// frames are only sent with segmentation offload.
+//
+
+#define VIRTNET_MAX_TRANSMIT_PACKET_SIZE 1514
+
+//
+// Define the speed reported for the link. Virtual links have no real speed.
+//
+
+#define VIRTNET_LINK_SPEED NET_SPEED_10000_MBPS
+
+//
+// Define the amount of time to wait for the device to respond to a control
+// command, in seconds.
+//
+
+#define VIRTNET_DEVICE_TIMEOUT 1
+
+//
+// Define the offset of the Ethernet type field and the size of the Ethernet
+// header.
+//
+
+#define VIRTNET_ETHERNET_TYPE_OFFSET 12
+#define VIRTNET_ETHERNET_HEADER_SIZE 14
+
+//
+// Define the offsets of the checksum fields within the TCP and UDP headers.
+//
+
+#define VIRTNET_TCP_CHECKSUM_OFFSET 16
+#define VIRTNET_UDP_CHECKSUM_OFFSET 6
+
+//
+// Define the offset and mask of the TCP data offset field.
+//
+
+#define VIRTNET_TCP_HEADER_LENGTH_OFFSET 12
+#define VIRTNET_TCP_HEADER_LENGTH_SHIFT 4
+
+//
+// Define the network device feature bits.
+//
+
+#define VIRTNET_FEATURE_CHECKSUM               (1 << 0)
+#define VIRTNET_FEATURE_GUEST_CHECKSUM         (1 << 1)
+#define VIRTNET_FEATURE_MAC                    (1 << 5)
+#define VIRTNET_FEATURE_GUEST_TSO4             (1 << 7)
+#define VIRTNET_FEATURE_HOST_TSO4              (1 << 11)
+#define VIRTNET_FEATURE_MERGEABLE_RECEIVE      (1 << 15)
+#define VIRTNET_FEATURE_STATUS                 (1 << 16)
+#define VIRTNET_FEATURE_CONTROL_QUEUE          (1 << 17)
+#define VIRTNET_FEATURE_CONTROL_RECEIVE        (1 << 18)
+#define VIRTNET_FEATURE_MULTIQUEUE             (1 << 22)
+
+//
+// Define the set of features the driver accepts.
+//
+
+#define VIRTNET_SUPPORTED_FEATURES        \
+    (VIRTNET_FEATURE_CHECKSUM |           \
+     VIRTNET_FEATURE_GUEST_CHECKSUM |     \
+     VIRTNET_FEATURE_MAC |                \
+     VIRTNET_FEATURE_HOST_TSO4 |          \
+     VIRTNET_FEATURE_STATUS |             \
+     VIRTNET_FEATURE_CONTROL_QUEUE |      \
+     VIRTNET_FEATURE_CONTROL_RECEIVE |    \
+     VIRTNET_FEATURE_MULTIQUEUE |         \
+     VIRTIO_FEATURE_EVENT_INDEX)
+
+//
+// Define the offsets into the network device configuration.
+//
+
+#define VIRTNET_CONFIGURATION_MAC_ADDRESS 0x0
+#define VIRTNET_CONFIGURATION_STATUS 0x6
+#define VIRTNET_CONFIGURATION_MAX_QUEUE_PAIRS 0x8
+
+//
+// Define the network device status bits.
+//
+
+#define VIRTNET_STATUS_LINK_UP 0x0001
+
+//
+// Define the virtio network header flags.
+//
+
+#define VIRTNET_HEADER_FLAG_NEEDS_CHECKSUM 0x01
+#define VIRTNET_HEADER_FLAG_DATA_VALID     0x02
+
+//
+// Define the virtio network header segmentation offload types.
+//
+
+#define VIRTNET_HEADER_GSO_NONE  0x00
+#define VIRTNET_HEADER_GSO_TCPV4 0x01
+
+//
+// Define the control queue command classes and commands.
+//
+
+#define VIRTNET_CONTROL_CLASS_RECEIVE 0
+#define VIRTNET_CONTROL_RECEIVE_PROMISCUOUS 0
+
+#define VIRTNET_CONTROL_CLASS_MULTIQUEUE 4
+#define VIRTNET_CONTROL_MULTIQUEUE_SET_PAIRS 0
+
+//
+// Define the control command acknowledgement values.
+//
+
+#define VIRTNET_CONTROL_ACK_OK 0
+#define VIRTNET_CONTROL_ACK_ERROR 1
+
+//
+// Define the number of descriptors used by a control command: the header,
+// the command data, and the acknowledgement.
+//
+
+#define VIRTNET_CONTROL_DESCRIPTOR_COUNT 3
+
+//
+// Define the maximum size of control command data.
+//
+
+#define VIRTNET_CONTROL_DATA_SIZE 8
+
+//
+// Define the bits for the PCI MSI/MSI-X flags.
+//
+
+#define VIRTNET_PCI_MSI_FLAG_INTERFACE_REGISTERED 0x00000001
+#define VIRTNET_PCI_MSI_FLAG_INTERFACE_AVAILABLE  0x00000002
+#define VIRTNET_PCI_MSI_FLAG_RESOURCES_REQUESTED  0x00000004
+#define VIRTNET_PCI_MSI_FLAG_RESOURCES_ALLOCATED  0x00000008
+
+//
+// Define the pending interrupt bits used with line interrupts.
+//
+
+#define VIRTNET_INTERRUPT_QUEUE VIRTIO_ISR_QUEUE
+#define VIRTNET_INTERRUPT_CONFIGURATION VIRTIO_ISR_CONFIGURATION
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef struct _VIRTNET_DEVICE VIRTNET_DEVICE, *PVIRTNET_DEVICE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the header that precedes every frame sent to or
+    received from a virtio network device, when mergeable receive buffers are
+    not in use.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIRTNET_HEADER_FLAG_* for
+        definitions.
+
+    GsoType - Stores the segmentation offload type. See VIRTNET_HEADER_GSO_*
+        for definitions.
+
+    HeaderLength - Stores the length of all the headers up to and including
+        the transport header, for segmentation offload.
+
+    GsoSize - Stores the maximum segment payload size for segmentation
+        offload.
+
+    ChecksumStart - Stores the offset from the start of the frame where
+        checksumming begins.
+
+    ChecksumOffset - Stores the offset from the checksum start where the
+        checksum is to be stored.
+
+--*/
+
+typedef struct _VIRTNET_HEADER {
+    UCHAR Flags;
+    UCHAR GsoType;
+    USHORT HeaderLength;
+    USHORT GsoSize;
+    USHORT ChecksumStart;
+    USHORT ChecksumOffset;
+} PACKED VIRTNET_HEADER, *PVIRTNET_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a control command as laid out in memory.
+
+Members:
+
+    Class - Stores the command class. See VIRTNET_CONTROL_CLASS_* for
+        definitions.
+
+    Command - Stores the command within the class.
+
+    Data - Stores the command data.
+
+    Ack - Stores the acknowledgement written by the device.
+
+--*/
+
+typedef struct _VIRTNET_CONTROL_COMMAND {
+    UCHAR Class;
+    UCHAR Command;
+    UCHAR Data[VIRTNET_CONTROL_DATA_SIZE];
+    UCHAR Ack;
+} PACKED VIRTNET_CONTROL_COMMAND, *PVIRTNET_CONTROL_COMMAND;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio queue as seen by the driver.
+
+Members:
+
+    Index - Stores the index of the queue within the device.
+
+    Size - Stores the number of descriptors in the queue.
+
+    IoBuffer - Stores a pointer to the I/O buffer holding the queue and any
+        per-packet headers.
+
+    Descriptors - Stores a pointer to the descriptor table.
+
+    Available - Stores a pointer to the available ring.
+
+    Used - Stores a pointer to the used ring.
+
+    UsedEvent - Stores a pointer to the used event index at the end of the
+        available ring, written by the driver to request an interrupt once the
+        device uses the given entry.
+
+    AvailableEvent - Stores a pointer to the available event index at the end
+        of the used ring, written by the device to request a notification once
+        the driver adds the given entry.
+
+    LastUsedIndex - Stores the next used ring index the driver will consume.
+
+    Headers - Stores a pointer to the array of network headers, one per
+        descriptor chain.
+
+    HeadersPhysicalAddress - Stores the physical address of the header array.
+
+--*/
+
+typedef struct _VIRTNET_QUEUE {
+    USHORT Index;
+    USHORT Size;
+    PIO_BUFFER IoBuffer;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors;
+    PVIRTIO_QUEUE_AVAILABLE Available;
+    PVIRTIO_QUEUE_USED Used;
+    volatile USHORT *UsedEvent;
+    volatile USHORT *AvailableEvent;
+    USHORT LastUsedIndex;
+    PVIRTNET_HEADER Headers;
+    PHYSICAL_ADDRESS HeadersPhysicalAddress;
+} VIRTNET_QUEUE, *PVIRTNET_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a receive and transmit queue pair. Each pair has its
+    own interrupt, which is steered to its own processor when MSI-X is in use.
+
+Members:
+
+    Device - Stores a pointer back to the owning device.
+
+    Number - Stores the zero-based number of this pair.
+
+    ReceiveQueue - Stores the receive virtio queue.
+
+    TransmitQueue - Stores the transmit virtio queue.
+
+    ReceiveLock - Stores a pointer to the lock protecting the receive queue.
+
+    TransmitLock - Stores a pointer to the lock protecting the transmit queue
+        and the transmit packet list.
+
+    ReceivePackets - Stores an array of packets posted to the receive queue,
+        indexed by descriptor chain.
+
+    TransmitPackets - Stores an array of packets in flight on the transmit
+        queue, indexed by descriptor chain.
+
+    TransmitFreeChains - Stores a stack of free transmit descriptor chain
+        indices.
+
+    TransmitFreeCount - Stores the number of valid entries in the free chain
+        stack.
+
+    TransmitPacketList - Stores the list of packets waiting for a free
+        transmit descriptor chain.
+
+    InterruptVector - Stores the MSI-X vector assigned to this pair.
+
+    InterruptHandle - Stores the handle of the connected interrupt.
+
+    InterruptPending - Stores a boolean indicating that the pair's interrupt
+        fired and the worker has not yet run.
+
+--*/
+
+typedef struct _VIRTNET_QUEUE_PAIR {
+    PVIRTNET_DEVICE Device;
+    ULONG Number;
+    VIRTNET_QUEUE ReceiveQueue;
+    VIRTNET_QUEUE TransmitQueue;
+    PQUEUED_LOCK ReceiveLock;
+    PQUEUED_LOCK TransmitLock;
+    PNET_PACKET_BUFFER *ReceivePackets;
+    PNET_PACKET_BUFFER *TransmitPackets;
+    PUSHORT TransmitFreeChains;
+    ULONG TransmitFreeCount;
+    NET_PACKET_LIST TransmitPacketList;
+    ULONGLONG InterruptVector;
+    HANDLE InterruptHandle;
+    volatile ULONG InterruptPending;
+} VIRTNET_QUEUE_PAIR, *PVIRTNET_QUEUE_PAIR;
+
+/*++
+
+Structure Description:
+
+    This structure defines the context for a virtio network device.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device object.
+
+    IoPortAddress - Stores the base of the device's legacy I/O port range.
+
+    ConfigurationOffset - Stores the offset of the device specific
+        configuration from the I/O port base, which depends on whether MSI-X is
+        enabled.
+
+    NetworkLink - Stores a pointer to the core networking link.
+
+    InterruptLine - Stores the interrupt line used when MSI-X is not in use.
+
+    InterruptVector - Stores the interrupt vector of the line interrupt, or
+        the MSI-X vector for configuration changes.
+
+    InterruptResourcesFound - Stores a boolean indicating whether or not the
+        interrupt line and interrupt vector fields are valid.
+
+    InterruptHandle - Stores the handle of the line or configuration change
+        interrupt.
+
+    PciMsiFlags - Stores a bitmask of flags indicating whether or not MSI-X
+        interrupts should be used. See VIRTNET_PCI_MSI_FLAG_* for definitions.
+
+    PciMsiInterface - Stores the interface to enable PCI message signaled
+        interrupts.
+
+    MsiVectorCount - Stores the number of MSI-X vectors found in the allocated
+        resources.
+
+    MsiVectors - Stores the allocated MSI-X vectors. The first vectors service
+        the queue pairs and the last services configuration changes.
+
+    PendingInterrupts - Stores the bitmask of pending interrupts. See
+        VIRTNET_INTERRUPT_* for definitions.
+
+    Features - Stores the negotiated feature bits.
+
+    MaxQueuePairs - Stores the number of queue pairs the device supports.
+
+    QueuePairCount - Stores the number of queue pairs allocated.
+
+    ActiveQueuePairCount - Stores the number of queue pairs the device agreed
+        to use. Transmits are spread across these.
+
+    QueuePairs - Stores an array of queue pairs in use.
+
+    ControlQueue - Stores the control virtio queue, if negotiated.
+
+    ControlCommand - Stores a pointer to the control command buffer.
+
+    ControlCommandPhysicalAddress - Stores the physical address of the control
+        command buffer.
+
+    ConfigurationLock - Stores a pointer to a lock that serializes control
+        commands and changes to the enabled capabilities.
+
+    MacAddress - Stores the MAC address of the device.
+
+    SupportedCapabilities - Stores the set of capabilities that this device
+        supports. See NET_LINK_CAPABILITY_* for definitions.
+
+    EnabledCapabilities - Stores the currently enabled capabilities on the
+        devices. See NET_LINK_CAPABILITY_* for definitions.
+
+    LinkActive - Stores a boolean indicating whether the link is up.
+
+--*/
+
+struct _VIRTNET_DEVICE {
+    PDEVICE OsDevice;
+    USHORT IoPortAddress;
+    USHORT ConfigurationOffset;
+    PNET_LINK NetworkLink;
+    ULONGLONG InterruptLine;
+    ULONGLONG InterruptVector;
+    BOOL InterruptResourcesFound;
+    HANDLE InterruptHandle;
+    ULONG PciMsiFlags;
+    INTERFACE_PCI_MSI PciMsiInterface;
+    ULONG MsiVectorCount;
+    ULONGLONG MsiVectors[VIRTNET_MAX_QUEUE_PAIRS + 1];
+    volatile ULONG PendingInterrupts;
+    ULONG Features;
+    ULONG MaxQueuePairs;
+    ULONG QueuePairCount;
+    ULONG ActiveQueuePairCount;
+    PVIRTNET_QUEUE_PAIR QueuePairs;
+    VIRTNET_QUEUE ControlQueue;
+    PVIRTNET_CONTROL_COMMAND ControlCommand;
+    PHYSICAL_ADDRESS ControlCommandPhysicalAddress;
+    PQUEUED_LOCK ConfigurationLock;
+    BYTE MacAddress[ETHERNET_ADDRESS_SIZE];
+    ULONG SupportedCapabilities;
+    ULONG EnabledCapabilities;
+    BOOL LinkActive;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+KSTATUS
+VirtnetSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the network.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link down which this data is to be sent.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if some or all of the packets were dropped due to
+    the hardware being backed up with too many packets to send.
+
+    Other failure codes indicate that none of the packets were sent.
+
+--*/
+
+KSTATUS
+VirtnetGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the network device layer's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link for which information is being set or queried.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KSTATUS
+VirtnetpInitializeDeviceStructures (
+    PVIRTNET_DEVICE Device,
+    ULONG QueuePairCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the device, negotiates features, and allocates the
+    virtio queues.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    QueuePairCount - Supplies the maximum number of queue pairs the caller
+        can service with interrupts.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+VirtnetpDestroyDeviceStructures (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the device and frees its queues and buffers.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+VirtnetpInitialize (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine programs the queues into the device, fills the receive
+    queues, and brings the device up.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpInterruptService (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio network line interrupt service routine.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the device.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpInterruptServiceWorker (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine processes line and configuration change interrupts for the
+    virtio network device at low level.
+
+Arguments:
+
+    Parameter - Supplies the device.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpQueuePairInterruptService (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the MSI-X interrupt service routine for a queue
+    pair. Message signaled interrupts are not shared, so it only needs to
+    note that the pair has work.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtnetpQueuePairInterruptServiceWorker (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine processes a queue pair's transmit completions and received
+    frames at low level.
+
+Arguments:
+
+    Parameter - Supplies the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+//
+// Administrative functions called by the hardware side.
+//
+
+KSTATUS
+VirtnetpAddNetworkDevice (
+    PVIRTNET_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds the device to core networking's available links.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to add.
+
+Return Value:
+
+    Status code.
+
+--*/
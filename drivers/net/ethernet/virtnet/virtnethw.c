@@ -0,0 +1,2176 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtnethw.c
+
+Abstract:
+
+    This module implements the portion of the virtio network driver that
+    interacts with the virtqueues.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include <minoca/net/ip4.h>
+#include "virtnet.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtnetpAllocateQueue (
+    PVIRTNET_DEVICE Device,
+    PVIRTNET_QUEUE Queue,
+    USHORT Index,
+    ULONG ExtraSize
+    );
+
+VOID
+VirtnetpFreeQueue (
+    PVIRTNET_QUEUE Queue
+    );
+
+KSTATUS
+VirtnetpInitializeQueuePair (
+    PVIRTNET_DEVICE Device,
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpDestroyQueuePair (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpNotifyQueue (
+    PVIRTNET_DEVICE Device,
+    PVIRTNET_QUEUE Queue,
+    USHORT OldIndex,
+    USHORT NewIndex
+    );
+
+KSTATUS
+VirtnetpFillReceiveQueue (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpProcessQueuePair (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpReapReceivedFrames (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpReapTransmitDescriptors (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+BOOL
+VirtnetpReapTransmitDescriptorsLocked (
+    PVIRTNET_QUEUE_PAIR Pair,
+    PLIST_ENTRY DestroyList
+    );
+
+VOID
+VirtnetpSendPendingPackets (
+    PVIRTNET_QUEUE_PAIR Pair
+    );
+
+VOID
+VirtnetpPrepareTransmitHeader (
+    PNET_PACKET_BUFFER Packet,
+    PVIRTNET_HEADER Header
+    );
+
+KSTATUS
+VirtnetpSendControlCommand (
+    PVIRTNET_DEVICE Device,
+    UCHAR Class,
+    UCHAR Command,
+    PVOID Data,
+    ULONG DataSize
+    );
+
+VOID
+VirtnetpCheckLinkState (
+    PVIRTNET_DEVICE Device
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+VirtnetSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the network.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link down which this data is to be sent.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if some or all of the packets were dropped due to
+    the hardware being backed up with too many packets to send.
+
+    Other failure codes indicate that none of the packets were sent.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    PVIRTNET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    //
+    // Spread transmits across the queue pairs by processor. The thread may
+    // migrate after the processor number is read, but that only costs some
+    // locality; the pair's lock keeps the queue consistent.
+    //
+
+    Device = (PVIRTNET_DEVICE)DeviceContext;
+    PairIndex = KeGetCurrentProcessorNumber() % Device->ActiveQueuePairCount;
+    Pair = &(Device->QueuePairs[PairIndex]);
+    KeAcquireQueuedLock(Pair->TransmitLock);
+
+    //
+    // If there is any room in the packet list, add all of the packets to the
+    // list waiting to be sent.
+    //
+
+    if (Pair->TransmitPacketList.Count <
+        VIRTNET_QUEUE_CHAIN_COUNT(&(Pair->TransmitQueue))) {
+
+        NET_APPEND_PACKET_LIST(PacketList, &(Pair->TransmitPacketList));
+        VirtnetpSendPendingPackets(Pair);
+        Status = STATUS_SUCCESS;
+
+    //
+    // Otherwise report that the resource is use as it is too busy to handle
+    // more packets.
+    //
+
+    } else {
+        Status = STATUS_RESOURCE_IN_USE;
+    }
+
+    KeReleaseQueuedLock(Pair->TransmitLock);
+    return Status;
+}
+
+KSTATUS
+VirtnetGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the network device layer's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link for which information is being set or queried.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PULONG BooleanOption;
+    PULONG Capabilities;
+    PVIRTNET_DEVICE Device;
+    UCHAR Promiscuous;
+    KSTATUS Status;
+    ULONG SupportedCapabilities;
+
+    Device = (PVIRTNET_DEVICE)DeviceContext;
+    switch (InformationType) {
+    case NetLinkInformationChecksumOffload:
+        if (*DataSize != sizeof(ULONG)) {
+            Status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        Status = STATUS_SUCCESS;
+        Capabilities = (PULONG)Data;
+        if (Set == FALSE) {
+            *Capabilities = Device->EnabledCapabilities &
+                            NET_LINK_CAPABILITY_CHECKSUM_MASK;
+
+            break;
+        }
+
+        *Capabilities &= NET_LINK_CAPABILITY_CHECKSUM_MASK;
+        SupportedCapabilities = Device->SupportedCapabilities &
+                                NET_LINK_CAPABILITY_CHECKSUM_MASK;
+
+        if ((*Capabilities & ~SupportedCapabilities) != 0) {
+            Status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        //
+        // Transmit offloads are requested per packet, and the receive path
+        // only trusts the device's validation if receive offload is enabled,
+        // so there is nothing to reprogram.
+        //
+
+        KeAcquireQueuedLock(Device->ConfigurationLock);
+        Device->EnabledCapabilities &= ~NET_LINK_CAPABILITY_CHECKSUM_MASK;
+        Device->EnabledCapabilities |= *Capabilities;
+        KeReleaseQueuedLock(Device->ConfigurationLock);
+        break;
+
+    case NetLinkInformationPromiscuousMode:
+        if (*DataSize != sizeof(ULONG)) {
+            Status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        Status = STATUS_SUCCESS;
+        BooleanOption = (PULONG)Data;
+        if (Set == FALSE) {
+            if ((Device->EnabledCapabilities &
+                 NET_LINK_CAPABILITY_PROMISCUOUS_MODE) != 0) {
+
+                *BooleanOption = TRUE;
+
+            } else {
+                *BooleanOption = FALSE;
+            }
+
+            break;
+        }
+
+        //
+        // Fail if promiscuous mode is not supported.
+        //
+
+        if ((Device->SupportedCapabilities &
+             NET_LINK_CAPABILITY_PROMISCUOUS_MODE) == 0) {
+
+            Status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        Promiscuous = FALSE;
+        if (*BooleanOption != FALSE) {
+            Promiscuous = TRUE;
+        }
+
+        KeAcquireQueuedLock(Device->ConfigurationLock);
+        Status = VirtnetpSendControlCommand(
+                                          Device,
+                                          VIRTNET_CONTROL_CLASS_RECEIVE,
+                                          VIRTNET_CONTROL_RECEIVE_PROMISCUOUS,
+                                          &Promiscuous,
+                                          sizeof(UCHAR));
+
+        if (KSUCCESS(Status)) {
+            if (Promiscuous != FALSE) {
+                Device->EnabledCapabilities |=
+                                          NET_LINK_CAPABILITY_PROMISCUOUS_MODE;
+
+            } else {
+                Device->EnabledCapabilities &=
+                                         ~NET_LINK_CAPABILITY_PROMISCUOUS_MODE;
+            }
+        }
+
+        KeReleaseQueuedLock(Device->ConfigurationLock);
+        break;
+
+    default:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+    }
+
+    return Status;
+}
+
+KSTATUS
+VirtnetpInitializeDeviceStructures (
+    PVIRTNET_DEVICE Device,
+    ULONG QueuePairCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the device, negotiates features, and allocates the
+    virtio queues.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    QueuePairCount - Supplies the maximum number of queue pairs the caller
+        can service with interrupts.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    ULONG DeviceFeatures;
+    ULONG Features;
+    ULONG Index;
+    PVIRTNET_QUEUE_PAIR Pair;
+    KSTATUS Status;
+    ULONG Supported;
+
+    ASSERT(Device->ConfigurationLock == NULL);
+
+    Device->ConfigurationLock = KeCreateQueuedLock();
+    if (Device->ConfigurationLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeDeviceStructuresEnd;
+    }
+
+    //
+    // Reset the device and announce that a driver has found it.
+    //
+
+    VIRTNET_WRITE_REGISTER8(Device, VirtioRegisterDeviceStatus, 0);
+    VIRTNET_WRITE_REGISTER8(Device,
+                            VirtioRegisterDeviceStatus,
+                            VIRTIO_STATUS_ACKNOWLEDGE);
+
+    VIRTNET_WRITE_REGISTER8(Device,
+                            VirtioRegisterDeviceStatus,
+                            VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    //
+    // Negotiate features. The control receive and multiqueue features are
+    // useless without a control queue, and segmentation offload requires
+    // checksum offload.
+    //
+
+    DeviceFeatures = VIRTNET_READ_REGISTER32(Device,
+                                             VirtioRegisterDeviceFeatures);
+
+    Features = DeviceFeatures & VIRTNET_SUPPORTED_FEATURES;
+    if ((Features & VIRTNET_FEATURE_CONTROL_QUEUE) == 0) {
+        Features &= ~(VIRTNET_FEATURE_CONTROL_RECEIVE |
+                      VIRTNET_FEATURE_MULTIQUEUE);
+    }
+
+    if ((Features & VIRTNET_FEATURE_CHECKSUM) == 0) {
+        Features &= ~VIRTNET_FEATURE_HOST_TSO4;
+    }
+
+    VIRTNET_WRITE_REGISTER32(Device, VirtioRegisterDriverFeatures, Features);
+    Device->Features = Features;
+
+    //
+    // Figure out how many queue pairs to use.
+    //
+
+    Device->MaxQueuePairs = 1;
+    if ((Features & VIRTNET_FEATURE_MULTIQUEUE) != 0) {
+        Device->MaxQueuePairs = VIRTNET_READ_CONFIGURATION16(
+                                        Device,
+                                        VIRTNET_CONFIGURATION_MAX_QUEUE_PAIRS);
+
+        if (Device->MaxQueuePairs == 0) {
+            Device->MaxQueuePairs = 1;
+        }
+    }
+
+    if (QueuePairCount > Device->MaxQueuePairs) {
+        QueuePairCount = Device->MaxQueuePairs;
+    }
+
+    if (QueuePairCount > VIRTNET_MAX_QUEUE_PAIRS) {
+        QueuePairCount = VIRTNET_MAX_QUEUE_PAIRS;
+    }
+
+    ASSERT(QueuePairCount != 0);
+
+    //
+    // Read the MAC address, or make one up.
+    //
+
+    if ((Features & VIRTNET_FEATURE_MAC) != 0) {
+        for (Index = 0; Index < ETHERNET_ADDRESS_SIZE; Index += 1) {
+            Device->MacAddress[Index] = VIRTNET_READ_CONFIGURATION8(
+                                      Device,
+                                      VIRTNET_CONFIGURATION_MAC_ADDRESS + Index);
+        }
+    }
+
+    if (NetIsEthernetAddressValid(Device->MacAddress) == FALSE) {
+        NetCreateEthernetAddress(Device->MacAddress);
+    }
+
+    //
+    // Allocate the queue pairs.
+    //
+
+    ASSERT(Device->QueuePairs == NULL);
+
+    AllocationSize = sizeof(VIRTNET_QUEUE_PAIR) * QueuePairCount;
+    Device->QueuePairs = MmAllocateNonPagedPool(AllocationSize,
+                                                VIRTNET_ALLOCATION_TAG);
+
+    if (Device->QueuePairs == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeDeviceStructuresEnd;
+    }
+
+    RtlZeroMemory(Device->QueuePairs, AllocationSize);
+    for (Index = 0; Index < QueuePairCount; Index += 1) {
+        Pair = &(Device->QueuePairs[Index]);
+        Pair->Device = Device;
+        Pair->Number = Index;
+        Pair->InterruptHandle = INVALID_HANDLE;
+        NET_INITIALIZE_PACKET_LIST(&(Pair->TransmitPacketList));
+    }
+
+    Device->QueuePairCount = QueuePairCount;
+    Device->ActiveQueuePairCount = 1;
+    for (Index = 0; Index < QueuePairCount; Index += 1) {
+        Status = VirtnetpInitializeQueuePair(Device,
+                                             &(Device->QueuePairs[Index]));
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceStructuresEnd;
+        }
+    }
+
+    //
+    // The control queue comes after all of the device's queue pairs, not just
+    // the ones in use. The command buffer lives after the ring.
+    //
+
+    if ((Features & VIRTNET_FEATURE_CONTROL_QUEUE) != 0) {
+        Status = VirtnetpAllocateQueue(Device,
+                                       &(Device->ControlQueue),
+                                       Device->MaxQueuePairs * 2,
+                                       sizeof(VIRTNET_CONTROL_COMMAND));
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceStructuresEnd;
+        }
+
+        Device->ControlCommand =
+                         (PVIRTNET_CONTROL_COMMAND)(Device->ControlQueue.Headers);
+
+        Device->ControlCommandPhysicalAddress =
+                                    Device->ControlQueue.HeadersPhysicalAddress;
+
+        Device->ControlQueue.Available->Flags =
+                                            VIRTIO_AVAILABLE_FLAG_NO_INTERRUPT;
+    }
+
+    //
+    // Advertise the offloads the device agreed to.
+    //
+
+    Supported = 0;
+    if ((Features & VIRTNET_FEATURE_CHECKSUM) != 0) {
+        Supported |= NET_LINK_CAPABILITY_TRANSMIT_UDP_CHECKSUM_OFFLOAD |
+                     NET_LINK_CAPABILITY_TRANSMIT_TCP_CHECKSUM_OFFLOAD;
+    }
+
+    if ((Features & VIRTNET_FEATURE_GUEST_CHECKSUM) != 0) {
+        Supported |= NET_LINK_CAPABILITY_RECEIVE_UDP_CHECKSUM_OFFLOAD |
+                     NET_LINK_CAPABILITY_RECEIVE_TCP_CHECKSUM_OFFLOAD;
+    }
+
+    if ((Features & VIRTNET_FEATURE_HOST_TSO4) != 0) {
+        Supported |= NET_LINK_CAPABILITY_TCP_SEGMENTATION_OFFLOAD;
+    }
+
+    if ((Features & VIRTNET_FEATURE_CONTROL_RECEIVE) != 0) {
+        Supported |= NET_LINK_CAPABILITY_PROMISCUOUS_MODE;
+    }
+
+    Device->SupportedCapabilities = Supported;
+    Device->EnabledCapabilities = Supported &
+                                  ~NET_LINK_CAPABILITY_PROMISCUOUS_MODE;
+
+    Status = STATUS_SUCCESS;
+
+InitializeDeviceStructuresEnd:
+    return Status;
+}
+
+VOID
+VirtnetpDestroyDeviceStructures (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the device and frees its queues and buffers.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    //
+    // Reset the device so it stops touching the queues before they are freed.
+    //
+
+    if (Device->IoPortAddress != 0) {
+        VIRTNET_WRITE_REGISTER8(Device, VirtioRegisterDeviceStatus, 0);
+    }
+
+    if (Device->QueuePairs != NULL) {
+        for (Index = 0; Index < Device->QueuePairCount; Index += 1) {
+            VirtnetpDestroyQueuePair(&(Device->QueuePairs[Index]));
+        }
+
+        MmFreeNonPagedPool(Device->QueuePairs);
+        Device->QueuePairs = NULL;
+        Device->QueuePairCount = 0;
+        Device->ActiveQueuePairCount = 0;
+    }
+
+    VirtnetpFreeQueue(&(Device->ControlQueue));
+    Device->ControlCommand = NULL;
+    if (Device->ConfigurationLock != NULL) {
+        KeDestroyQueuedLock(Device->ConfigurationLock);
+        Device->ConfigurationLock = NULL;
+    }
+
+    return;
+}
+
+KSTATUS
+VirtnetpInitialize (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine programs the queues into the device, fills the receive
+    queues, and brings the device up.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    USHORT Count;
+    ULONG Index;
+    PVIRTNET_QUEUE_PAIR Pair;
+    USHORT QueueIndex;
+    KSTATUS Status;
+    USHORT Vector;
+
+    //
+    // With MSI-X, point each queue pair at its own table entry and
+    // configuration changes at the last one. The device reports failure by
+    // reading back the no vector value.
+    //
+
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        Vector = Device->MsiVectorCount - 1;
+        VIRTNET_WRITE_REGISTER16(Device,
+                                 VirtioRegisterConfigurationVector,
+                                 Vector);
+
+        Vector = VIRTNET_READ_REGISTER16(Device,
+                                         VirtioRegisterConfigurationVector);
+
+        if (Vector == VIRTIO_MSI_NO_VECTOR) {
+            Status = STATUS_DEVICE_IO_ERROR;
+            goto InitializeEnd;
+        }
+
+        for (Index = 0; Index < Device->QueuePairCount; Index += 1) {
+            Pair = &(Device->QueuePairs[Index]);
+            QueueIndex = Pair->ReceiveQueue.Index;
+            while (TRUE) {
+                VIRTNET_WRITE_REGISTER16(Device,
+                                         VirtioRegisterQueueSelect,
+                                         QueueIndex);
+
+                VIRTNET_WRITE_REGISTER16(Device,
+                                         VirtioRegisterQueueVector,
+                                         Index);
+
+                Vector = VIRTNET_READ_REGISTER16(Device,
+                                                 VirtioRegisterQueueVector);
+
+                if (Vector == VIRTIO_MSI_NO_VECTOR) {
+                    Status = STATUS_DEVICE_IO_ERROR;
+                    goto InitializeEnd;
+                }
+
+                if (QueueIndex == Pair->TransmitQueue.Index) {
+                    break;
+                }
+
+                QueueIndex = Pair->TransmitQueue.Index;
+            }
+        }
+    }
+
+    VIRTNET_WRITE_REGISTER8(Device,
+                            VirtioRegisterDeviceStatus,
+                            (VIRTIO_STATUS_ACKNOWLEDGE |
+                             VIRTIO_STATUS_DRIVER |
+                             VIRTIO_STATUS_DRIVER_OK));
+
+    //
+    // Notify the networking core of this new link now that the device is
+    // ready to send. The receive buffers are allocated from the link.
+    //
+
+    Status = VirtnetpAddNetworkDevice(Device);
+    if (!KSUCCESS(Status)) {
+        goto InitializeEnd;
+    }
+
+    for (Index = 0; Index < Device->QueuePairCount; Index += 1) {
+        Status = VirtnetpFillReceiveQueue(&(Device->QueuePairs[Index]));
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
+        }
+    }
+
+    //
+    // The device starts out using a single queue pair. Ask it to use the
+    // rest. If that fails, keep going with one pair.
+    //
+
+    if (Device->QueuePairCount > 1) {
+        Count = Device->QueuePairCount;
+        KeAcquireQueuedLock(Device->ConfigurationLock);
+        Status = VirtnetpSendControlCommand(
+                                         Device,
+                                         VIRTNET_CONTROL_CLASS_MULTIQUEUE,
+                                         VIRTNET_CONTROL_MULTIQUEUE_SET_PAIRS,
+                                         &Count,
+                                         sizeof(USHORT));
+
+        KeReleaseQueuedLock(Device->ConfigurationLock);
+        if (KSUCCESS(Status)) {
+            Device->ActiveQueuePairCount = Device->QueuePairCount;
+
+        } else {
+            RtlDebugPrint("Virtnet: Failed to enable %d queue pairs: %d\n",
+                          Device->QueuePairCount,
+                          Status);
+        }
+    }
+
+    VirtnetpCheckLinkState(Device);
+    Status = STATUS_SUCCESS;
+
+InitializeEnd:
+    return Status;
+}
+
+INTERRUPT_STATUS
+VirtnetpInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio network line interrupt service routine.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the device.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    UCHAR PendingBits;
+
+    Device = (PVIRTNET_DEVICE)Context;
+
+    //
+    // With MSI-X, this is the dedicated configuration change vector.
+    //
+
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        RtlAtomicOr32(&(Device->PendingInterrupts),
+                      VIRTNET_INTERRUPT_CONFIGURATION);
+
+        return InterruptStatusClaimed;
+    }
+
+    //
+    // Reading the status register acknowledges the interrupt. If nothing is
+    // set then the interrupt belongs to someone else sharing the line.
+    //
+
+    PendingBits = VIRTNET_READ_REGISTER8(Device, VirtioRegisterIsrStatus);
+    if (PendingBits == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    RtlAtomicOr32(&(Device->PendingInterrupts), PendingBits);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpInterruptServiceWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes line and configuration change interrupts for the
+    virtio network device at low level.
+
+Arguments:
+
+    Parameter - Supplies the device.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_DEVICE Device;
+    ULONG PendingBits;
+
+    Device = (PVIRTNET_DEVICE)Parameter;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    PendingBits = RtlAtomicExchange32(&(Device->PendingInterrupts), 0);
+    if (PendingBits == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    if ((PendingBits & VIRTNET_INTERRUPT_CONFIGURATION) != 0) {
+        VirtnetpCheckLinkState(Device);
+    }
+
+    //
+    // Line interrupts only ever run a single queue pair.
+    //
+
+    if ((PendingBits & VIRTNET_INTERRUPT_QUEUE) != 0) {
+        VirtnetpProcessQueuePair(&(Device->QueuePairs[0]));
+    }
+
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpQueuePairInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the MSI-X interrupt service routine for a queue
+    pair. Message signaled interrupts are not shared, so it only needs to
+    note that the pair has work.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_QUEUE_PAIR Pair;
+
+    Pair = (PVIRTNET_QUEUE_PAIR)Context;
+    RtlAtomicExchange32(&(Pair->InterruptPending), TRUE);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtnetpQueuePairInterruptServiceWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes a queue pair's transmit completions and received
+    frames at low level.
+
+Arguments:
+
+    Parameter - Supplies the queue pair.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTNET_QUEUE_PAIR Pair;
+
+    Pair = (PVIRTNET_QUEUE_PAIR)Parameter;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    if (RtlAtomicExchange32(&(Pair->InterruptPending), FALSE) == FALSE) {
+        return InterruptStatusNotClaimed;
+    }
+
+    VirtnetpProcessQueuePair(Pair);
+    return InterruptStatusClaimed;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtnetpAllocateQueue (
+    PVIRTNET_DEVICE Device,
+    PVIRTNET_QUEUE Queue,
+    USHORT Index,
+    ULONG ExtraSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a virtio queue in the layout the legacy interface
+    requires and hands its address to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Queue - Supplies a pointer to the queue to initialize.
+
+    Index - Supplies the index of the queue within the device.
+
+    ExtraSize - Supplies the number of bytes to allocate after the queue for
+        headers or commands.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    ULONG IoBufferFlags;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    ULONG QueueSize;
+    USHORT Size;
+    KSTATUS Status;
+    PUCHAR VirtualAddress;
+
+    ASSERT(Queue->IoBuffer == NULL);
+
+    VIRTNET_WRITE_REGISTER16(Device, VirtioRegisterQueueSelect, Index);
+    Size = VIRTNET_READ_REGISTER16(Device, VirtioRegisterQueueSize);
+    if ((Size == 0) || (POWER_OF_2(Size) == FALSE)) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto AllocateQueueEnd;
+    }
+
+    //
+    // The legacy interface takes a 32-bit page frame number, so keep the
+    // queue where the register can describe it.
+    //
+
+    QueueSize = VIRTIO_LEGACY_QUEUE_SIZE(Size);
+    AllocationSize = QueueSize + ExtraSize;
+    IoBufferFlags = IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS;
+    Queue->IoBuffer = MmAllocateNonPagedIoBuffer(
+                                                0,
+                                                MAX_ULONG,
+                                                VIRTIO_LEGACY_QUEUE_ALIGNMENT,
+                                                AllocationSize,
+                                                IoBufferFlags);
+
+    if (Queue->IoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    ASSERT(Queue->IoBuffer->FragmentCount == 1);
+
+    VirtualAddress = Queue->IoBuffer->Fragment[0].VirtualAddress;
+    PhysicalAddress = Queue->IoBuffer->Fragment[0].PhysicalAddress;
+    RtlZeroMemory(VirtualAddress, AllocationSize);
+    Queue->Index = Index;
+    Queue->Size = Size;
+    Queue->Descriptors = (PVIRTIO_QUEUE_DESCRIPTOR)VirtualAddress;
+    Queue->Available = (PVIRTIO_QUEUE_AVAILABLE)(VirtualAddress +
+                                   (sizeof(VIRTIO_QUEUE_DESCRIPTOR) * Size));
+
+    Queue->Used = (PVIRTIO_QUEUE_USED)(VirtualAddress +
+                                       VIRTIO_LEGACY_QUEUE_USED_OFFSET(Size));
+
+    Queue->UsedEvent = (volatile USHORT *)((PUCHAR)(Queue->Available) +
+                                           VIRTIO_QUEUE_AVAILABLE_SIZE(Size) -
+                                           sizeof(USHORT));
+
+    Queue->AvailableEvent = (volatile USHORT *)((PUCHAR)(Queue->Used) +
+                                                VIRTIO_QUEUE_USED_SIZE(Size) -
+                                                sizeof(USHORT));
+    Queue->LastUsedIndex = 0;
+    Queue->Headers = (PVIRTNET_HEADER)(VirtualAddress + QueueSize);
+    Queue->HeadersPhysicalAddress = PhysicalAddress + QueueSize;
+    VIRTNET_WRITE_REGISTER32(
+                         Device,
+                         VirtioRegisterQueueAddress,
+                         (ULONG)(PhysicalAddress >>
+                                 VIRTIO_LEGACY_QUEUE_ADDRESS_SHIFT));
+
+    Status = STATUS_SUCCESS;
+
+AllocateQueueEnd:
+    return Status;
+}
+
+VOID
+VirtnetpFreeQueue (
+    PVIRTNET_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a virtio queue's memory. The device must already be
+    reset.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Queue->IoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->IoBuffer);
+    }
+
+    RtlZeroMemory(Queue, sizeof(VIRTNET_QUEUE));
+    return;
+}
+
+KSTATUS
+VirtnetpInitializeQueuePair (
+    PVIRTNET_DEVICE Device,
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a queue pair's queues and bookkeeping, and links
+    each packet's header and frame descriptors together. The links never
+    change, so they are set up once here.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    ULONG Chain;
+    ULONG ChainCount;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    ULONG ExtraSize;
+    PVIRTNET_QUEUE Queue;
+    KSTATUS Status;
+
+    Pair->ReceiveLock = KeCreateQueuedLock();
+    if (Pair->ReceiveLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueuePairEnd;
+    }
+
+    Pair->TransmitLock = KeCreateQueuedLock();
+    if (Pair->TransmitLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueuePairEnd;
+    }
+
+    //
+    // Set up the receive queue. Both descriptors in each chain are written by
+    // the device.
+    //
+
+    Queue = &(Pair->ReceiveQueue);
+    VIRTNET_WRITE_REGISTER16(Device,
+                             VirtioRegisterQueueSelect,
+                             VIRTNET_RECEIVE_QUEUE_INDEX(Pair->Number));
+
+    ChainCount = VIRTNET_READ_REGISTER16(Device, VirtioRegisterQueueSize) /
+                 VIRTNET_DESCRIPTORS_PER_PACKET;
+
+    ExtraSize = sizeof(VIRTNET_HEADER) * ChainCount;
+    Status = VirtnetpAllocateQueue(Device,
+                                   Queue,
+                                   VIRTNET_RECEIVE_QUEUE_INDEX(Pair->Number),
+                                   ExtraSize);
+
+    if (!KSUCCESS(Status)) {
+        goto InitializeQueuePairEnd;
+    }
+
+    for (Chain = 0; Chain < ChainCount; Chain += 1) {
+        Descriptor = &(Queue->Descriptors[Chain * 2]);
+        Descriptor->Address = Queue->HeadersPhysicalAddress +
+                              (Chain * sizeof(VIRTNET_HEADER));
+
+        Descriptor->Length = sizeof(VIRTNET_HEADER);
+        Descriptor->Flags = VIRTIO_DESCRIPTOR_FLAG_NEXT |
+                            VIRTIO_DESCRIPTOR_FLAG_WRITE;
+
+        Descriptor->Next = (Chain * 2) + 1;
+        Descriptor += 1;
+        Descriptor->Flags = VIRTIO_DESCRIPTOR_FLAG_WRITE;
+    }
+
+    AllocationSize = sizeof(PNET_PACKET_BUFFER) * ChainCount;
+    Pair->ReceivePackets = MmAllocateNonPagedPool(AllocationSize,
+                                                  VIRTNET_ALLOCATION_TAG);
+
+    if (Pair->ReceivePackets == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueuePairEnd;
+    }
+
+    RtlZeroMemory(Pair->ReceivePackets, AllocationSize);
+
+    //
+    // Set up the transmit queue, with every chain free.
+    //
+
+    Queue = &(Pair->TransmitQueue);
+    VIRTNET_WRITE_REGISTER16(Device,
+                             VirtioRegisterQueueSelect,
+                             VIRTNET_TRANSMIT_QUEUE_INDEX(Pair->Number));
+
+    ChainCount = VIRTNET_READ_REGISTER16(Device, VirtioRegisterQueueSize) /
+                 VIRTNET_DESCRIPTORS_PER_PACKET;
+
+    ExtraSize = sizeof(VIRTNET_HEADER) * ChainCount;
+    Status = VirtnetpAllocateQueue(Device,
+                                   Queue,
+                                   VIRTNET_TRANSMIT_QUEUE_INDEX(Pair->Number),
+                                   ExtraSize);
+
+    if (!KSUCCESS(Status)) {
+        goto InitializeQueuePairEnd;
+    }
+
+    for (Chain = 0; Chain < ChainCount; Chain += 1) {
+        Descriptor = &(Queue->Descriptors[Chain * 2]);
+        Descriptor->Address = Queue->HeadersPhysicalAddress +
+                              (Chain * sizeof(VIRTNET_HEADER));
+
+        Descriptor->Length = sizeof(VIRTNET_HEADER);
+        Descriptor->Flags = VIRTIO_DESCRIPTOR_FLAG_NEXT;
+        Descriptor->Next = (Chain * 2) + 1;
+    }
+
+    AllocationSize = sizeof(PNET_PACKET_BUFFER) * ChainCount;
+    Pair->TransmitPackets = MmAllocateNonPagedPool(AllocationSize,
+                                                   VIRTNET_ALLOCATION_TAG);
+
+    if (Pair->TransmitPackets == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueuePairEnd;
+    }
+
+    RtlZeroMemory(Pair->TransmitPackets, AllocationSize);
+    AllocationSize = sizeof(USHORT) * ChainCount;
+    Pair->TransmitFreeChains = MmAllocateNonPagedPool(AllocationSize,
+                                                      VIRTNET_ALLOCATION_TAG);
+
+    if (Pair->TransmitFreeChains == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueuePairEnd;
+    }
+
+    for (Chain = 0; Chain < ChainCount; Chain += 1) {
+        Pair->TransmitFreeChains[Chain] = ChainCount - 1 - Chain;
+    }
+
+    Pair->TransmitFreeCount = ChainCount;
+    Status = STATUS_SUCCESS;
+
+InitializeQueuePairEnd:
+    return Status;
+}
+
+VOID
+VirtnetpDestroyQueuePair (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a queue pair's queues, packets, and bookkeeping. The
+    device must already be reset.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Chain;
+    ULONG ChainCount;
+
+    if (Pair->ReceivePackets != NULL) {
+        ChainCount = VIRTNET_QUEUE_CHAIN_COUNT(&(Pair->ReceiveQueue));
+        for (Chain = 0; Chain < ChainCount; Chain += 1) {
+            if (Pair->ReceivePackets[Chain] != NULL) {
+                NetFreeBuffer(Pair->ReceivePackets[Chain]);
+            }
+        }
+
+        MmFreeNonPagedPool(Pair->ReceivePackets);
+        Pair->ReceivePackets = NULL;
+    }
+
+    if (Pair->TransmitPackets != NULL) {
+        ChainCount = VIRTNET_QUEUE_CHAIN_COUNT(&(Pair->TransmitQueue));
+        for (Chain = 0; Chain < ChainCount; Chain += 1) {
+            if (Pair->TransmitPackets[Chain] != NULL) {
+                NetFreeBuffer(Pair->TransmitPackets[Chain]);
+            }
+        }
+
+        MmFreeNonPagedPool(Pair->TransmitPackets);
+        Pair->TransmitPackets = NULL;
+    }
+
+    if (Pair->TransmitFreeChains != NULL) {
+        MmFreeNonPagedPool(Pair->TransmitFreeChains);
+        Pair->TransmitFreeChains = NULL;
+    }
+
+    NetDestroyBufferList(&(Pair->TransmitPacketList));
+    VirtnetpFreeQueue(&(Pair->ReceiveQueue));
+    VirtnetpFreeQueue(&(Pair->TransmitQueue));
+    if (Pair->ReceiveLock != NULL) {
+        KeDestroyQueuedLock(Pair->ReceiveLock);
+        Pair->ReceiveLock = NULL;
+    }
+
+    if (Pair->TransmitLock != NULL) {
+        KeDestroyQueuedLock(Pair->TransmitLock);
+        Pair->TransmitLock = NULL;
+    }
+
+    return;
+}
+
+VOID
+VirtnetpNotifyQueue (
+    PVIRTNET_DEVICE Device,
+    PVIRTNET_QUEUE Queue,
+    USHORT OldIndex,
+    USHORT NewIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine publishes new available ring entries and notifies the device
+    if it asked to be told about them. Notifications are I/O port writes that
+    exit to the hypervisor, so skipping unneeded ones matters.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Queue - Supplies a pointer to the queue.
+
+    OldIndex - Supplies the available index before the new entries were added.
+
+    NewIndex - Supplies the available index after the new entries were added.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL Notify;
+
+    if (OldIndex == NewIndex) {
+        return;
+    }
+
+    //
+    // Make sure the ring entries are visible before the index, and the index
+    // is visible before the device's suppression state is read.
+    //
+
+    RtlMemoryBarrier();
+    Queue->Available->Index = NewIndex;
+    RtlMemoryBarrier();
+    if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) != 0) {
+        Notify = VIRTIO_QUEUE_NEED_EVENT(*(Queue->AvailableEvent),
+                                         NewIndex,
+                                         OldIndex);
+
+    } else {
+        Notify = TRUE;
+        if ((Queue->Used->Flags & VIRTIO_USED_FLAG_NO_NOTIFY) != 0) {
+            Notify = FALSE;
+        }
+    }
+
+    if (Notify != FALSE) {
+        VIRTNET_WRITE_REGISTER16(Device,
+                                 VirtioRegisterQueueNotify,
+                                 Queue->Index);
+    }
+
+    return;
+}
+
+KSTATUS
+VirtnetpFillReceiveQueue (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a receive buffer for every receive chain and posts
+    them all to the device.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    USHORT AvailableIndex;
+    ULONG Chain;
+    ULONG ChainCount;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    PVIRTNET_DEVICE Device;
+    USHORT OldIndex;
+    PNET_PACKET_BUFFER Packet;
+    PVIRTNET_QUEUE Queue;
+    KSTATUS Status;
+
+    Device = Pair->Device;
+    Queue = &(Pair->ReceiveQueue);
+    ChainCount = VIRTNET_QUEUE_CHAIN_COUNT(Queue);
+    KeAcquireQueuedLock(Pair->ReceiveLock);
+    OldIndex = Queue->Available->Index;
+    AvailableIndex = OldIndex;
+    Status = STATUS_SUCCESS;
+    for (Chain = 0; Chain < ChainCount; Chain += 1) {
+        if (Pair->ReceivePackets[Chain] != NULL) {
+            continue;
+        }
+
+        Status = NetAllocateBuffer(0,
+                                   VIRTNET_RECEIVE_FRAME_SIZE,
+                                   0,
+                                   Device->NetworkLink,
+                                   0,
+                                   &Packet);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Pair->ReceivePackets[Chain] = Packet;
+        Descriptor = &(Queue->Descriptors[(Chain * 2) + 1]);
+        Descriptor->Address = Packet->BufferPhysicalAddress;
+        Descriptor->Length = Packet->BufferSize;
+        Queue->Available->Ring[AvailableIndex & (Queue->Size - 1)] = Chain * 2;
+        AvailableIndex += 1;
+    }
+
+    //
+    // Ask for an interrupt on the very next frame.
+    //
+
+    *(Queue->UsedEvent) = Queue->LastUsedIndex;
+    VirtnetpNotifyQueue(Device, Queue, OldIndex, AvailableIndex);
+    KeReleaseQueuedLock(Pair->ReceiveLock);
+    return Status;
+}
+
+VOID
+VirtnetpProcessQueuePair (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles an interrupt for a queue pair, reaping completed
+    transmits and processing received frames.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    VirtnetpReapTransmitDescriptors(Pair);
+    VirtnetpReapReceivedFrames(Pair);
+    return;
+}
+
+VOID
+VirtnetpReapReceivedFrames (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes any received frames from the network. Frames are
+    handed to the networking core in batches of up to the receive budget, and
+    the queue is polled until it runs dry. Interrupts for the queue stay
+    suppressed until the queue is empty.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    USHORT AvailableIndex;
+    ULONG BatchCount;
+    USHORT BatchChains[VIRTNET_RECEIVE_BUDGET];
+    ULONG Chain;
+    ULONG ChainCount;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    PVIRTNET_DEVICE Device;
+    ULONG Flags;
+    PVIRTNET_HEADER Header;
+    ULONG Index;
+    ULONG Length;
+    USHORT OldIndex;
+    PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST PacketList;
+    PVIRTNET_QUEUE Queue;
+    ULONG ReceiveChecksumFlags;
+    PVIRTIO_QUEUE_USED_ELEMENT UsedElement;
+    USHORT UsedIndex;
+
+    Device = Pair->Device;
+    Queue = &(Pair->ReceiveQueue);
+    ChainCount = VIRTNET_QUEUE_CHAIN_COUNT(Queue);
+    ReceiveChecksumFlags = 0;
+    if ((Device->EnabledCapabilities &
+         NET_LINK_CAPABILITY_CHECKSUM_RECEIVE_MASK) != 0) {
+
+        ReceiveChecksumFlags = NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD |
+                               NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD;
+    }
+
+    KeAcquireQueuedLock(Pair->ReceiveLock);
+
+    //
+    // Without event indexes, interrupts have to be turned off explicitly. With
+    // them, the device will not interrupt again until the used event is moved
+    // forward.
+    //
+
+    if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) == 0) {
+        Queue->Available->Flags |= VIRTIO_AVAILABLE_FLAG_NO_INTERRUPT;
+    }
+
+    while (TRUE) {
+        do {
+            BatchCount = 0;
+            NET_INITIALIZE_PACKET_LIST(&PacketList);
+            UsedIndex = Queue->Used->Index;
+            RtlMemoryBarrier();
+            while ((Queue->LastUsedIndex != UsedIndex) &&
+                   (BatchCount < VIRTNET_RECEIVE_BUDGET)) {
+
+                Index = Queue->LastUsedIndex & (Queue->Size - 1);
+                UsedElement = &(Queue->Used->Ring[Index]);
+                Chain = UsedElement->Id / VIRTNET_DESCRIPTORS_PER_PACKET;
+                Queue->LastUsedIndex += 1;
+
+                ASSERT(Chain < ChainCount);
+
+                Packet = Pair->ReceivePackets[Chain];
+                Header = &(Queue->Headers[Chain]);
+                Length = UsedElement->Length;
+                if (Length < sizeof(VIRTNET_HEADER)) {
+                    Length = 0;
+
+                } else {
+                    Length -= sizeof(VIRTNET_HEADER);
+                }
+
+                Packet->DataSize = Length;
+                Packet->DataOffset = 0;
+                Packet->FooterOffset = Length;
+
+                //
+                // The device either validated the checksum or, for frames
+                // from another guest on the host, never computed it. Either
+                // way the data is intact. The receive buffers came from the
+                // networking core, so it is free to keep them.
+                //
+
+                Flags = NET_PACKET_FLAG_EXCHANGEABLE;
+                if ((Header->Flags & (VIRTNET_HEADER_FLAG_DATA_VALID |
+                                      VIRTNET_HEADER_FLAG_NEEDS_CHECKSUM)) !=
+                    0) {
+
+                    Flags |= ReceiveChecksumFlags;
+                }
+
+                Packet->Flags = Flags;
+                NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+                BatchChains[BatchCount] = Chain;
+                BatchCount += 1;
+            }
+
+            if (BatchCount == 0) {
+                break;
+            }
+
+            NetProcessReceivedPacketList(Device->NetworkLink, &PacketList);
+
+            //
+            // The networking core may have swapped in new buffers for some of
+            // the packets, so reprogram each descriptor before giving the
+            // chains back to the device.
+            //
+
+            OldIndex = Queue->Available->Index;
+            AvailableIndex = OldIndex;
+            for (Index = 0; Index < BatchCount; Index += 1) {
+                Chain = BatchChains[Index];
+                Packet = Pair->ReceivePackets[Chain];
+                Descriptor = &(Queue->Descriptors[(Chain * 2) + 1]);
+                Descriptor->Address = Packet->BufferPhysicalAddress;
+                Descriptor->Length = Packet->BufferSize;
+                Queue->Available->Ring[AvailableIndex & (Queue->Size - 1)] =
+                                          Chain * VIRTNET_DESCRIPTORS_PER_PACKET;
+
+                AvailableIndex += 1;
+            }
+
+            VirtnetpNotifyQueue(Device, Queue, OldIndex, AvailableIndex);
+
+        } while (BatchCount == VIRTNET_RECEIVE_BUDGET);
+
+        //
+        // Re-arm the interrupt, then check again in case a frame landed in
+        // between the last check and the re-arm.
+        //
+
+        if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) != 0) {
+            *(Queue->UsedEvent) = Queue->LastUsedIndex;
+
+        } else {
+            Queue->Available->Flags &= ~VIRTIO_AVAILABLE_FLAG_NO_INTERRUPT;
+        }
+
+        RtlMemoryBarrier();
+        if (Queue->Used->Index == Queue->LastUsedIndex) {
+            break;
+        }
+
+        if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) == 0) {
+            Queue->Available->Flags |= VIRTIO_AVAILABLE_FLAG_NO_INTERRUPT;
+        }
+    }
+
+    KeReleaseQueuedLock(Pair->ReceiveLock);
+    return;
+}
+
+VOID
+VirtnetpReapTransmitDescriptors (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reaps any completed transmits on the given queue pair and
+    sends along more data if it freed any chains.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LIST_ENTRY DestroyList;
+    PNET_PACKET_BUFFER Packet;
+
+    INITIALIZE_LIST_HEAD(&DestroyList);
+    KeAcquireQueuedLock(Pair->TransmitLock);
+    if (VirtnetpReapTransmitDescriptorsLocked(Pair, &DestroyList) != FALSE) {
+        VirtnetpSendPendingPackets(Pair);
+    }
+
+    KeReleaseQueuedLock(Pair->TransmitLock);
+
+    //
+    // Destroy any reaped buffers.
+    //
+
+    while (LIST_EMPTY(&DestroyList) == FALSE) {
+        Packet = LIST_VALUE(DestroyList.Next, NET_PACKET_BUFFER, ListEntry);
+        LIST_REMOVE(&(Packet->ListEntry));
+        NetFreeBuffer(Packet);
+    }
+
+    return;
+}
+
+BOOL
+VirtnetpReapTransmitDescriptorsLocked (
+    PVIRTNET_QUEUE_PAIR Pair,
+    PLIST_ENTRY DestroyList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves completed transmit packets onto the given list and
+    frees their chains. This routine assumes the transmit lock is held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+    DestroyList - Supplies a pointer to the list to put completed packets on.
+
+Return Value:
+
+    TRUE if any chains were freed.
+
+    FALSE otherwise.
+
+--*/
+
+{
+
+    ULONG Chain;
+    ULONG Index;
+    PNET_PACKET_BUFFER Packet;
+    PVIRTNET_QUEUE Queue;
+    BOOL Reaped;
+    USHORT UsedIndex;
+
+    Reaped = FALSE;
+    Queue = &(Pair->TransmitQueue);
+    UsedIndex = Queue->Used->Index;
+    RtlMemoryBarrier();
+    while (Queue->LastUsedIndex != UsedIndex) {
+        Index = Queue->LastUsedIndex & (Queue->Size - 1);
+        Chain = Queue->Used->Ring[Index].Id / VIRTNET_DESCRIPTORS_PER_PACKET;
+        Queue->LastUsedIndex += 1;
+        Packet = Pair->TransmitPackets[Chain];
+
+        ASSERT(Packet != NULL);
+
+        Pair->TransmitPackets[Chain] = NULL;
+        INSERT_BEFORE(&(Packet->ListEntry), DestroyList);
+        Pair->TransmitFreeChains[Pair->TransmitFreeCount] = Chain;
+        Pair->TransmitFreeCount += 1;
+        Reaped = TRUE;
+    }
+
+    return Reaped;
+}
+
+VOID
+VirtnetpSendPendingPackets (
+    PVIRTNET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends as many packets as can fit in the transmit queue. This
+    routine assumes the transmit lock is held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    USHORT AvailableIndex;
+    ULONG Chain;
+    ULONG ChainCount;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    PVIRTNET_DEVICE Device;
+    ULONG InFlight;
+    USHORT OldIndex;
+    PNET_PACKET_BUFFER Packet;
+    PVIRTNET_QUEUE Queue;
+
+    Device = Pair->Device;
+    Queue = &(Pair->TransmitQueue);
+    ChainCount = VIRTNET_QUEUE_CHAIN_COUNT(Queue);
+    OldIndex = Queue->Available->Index;
+    AvailableIndex = OldIndex;
+    while ((NET_PACKET_LIST_EMPTY(&(Pair->TransmitPacketList)) == FALSE) &&
+           (Pair->TransmitFreeCount != 0)) {
+
+        Packet = LIST_VALUE(Pair->TransmitPacketList.Head.Next,
+                            NET_PACKET_BUFFER,
+                            ListEntry);
+
+        NET_REMOVE_PACKET_FROM_LIST(Packet, &(Pair->TransmitPacketList));
+        Pair->TransmitFreeCount -= 1;
+        Chain = Pair->TransmitFreeChains[Pair->TransmitFreeCount];
+
+        ASSERT(Pair->TransmitPackets[Chain] == NULL);
+
+        Pair->TransmitPackets[Chain] = Packet;
+        VirtnetpPrepareTransmitHeader(Packet, &(Queue->Headers[Chain]));
+        Descriptor = &(Queue->Descriptors[(Chain * 2) + 1]);
+        Descriptor->Address = Packet->BufferPhysicalAddress +
+                              Packet->DataOffset;
+
+        Descriptor->Length = Packet->FooterOffset - Packet->DataOffset;
+        Descriptor->Flags = 0;
+        Queue->Available->Ring[AvailableIndex & (Queue->Size - 1)] =
+                                          Chain * VIRTNET_DESCRIPTORS_PER_PACKET;
+
+        AvailableIndex += 1;
+    }
+
+    //
+    // Transmit completions are not urgent. With event indexes, only ask for
+    // an interrupt once most of what is in flight has gone out, leaving
+    // enough to keep the device busy while the chains are reaped.
+    //
+
+    if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) != 0) {
+        InFlight = ChainCount - Pair->TransmitFreeCount;
+        *(Queue->UsedEvent) = Queue->LastUsedIndex + ((InFlight * 3) / 4);
+    }
+
+    VirtnetpNotifyQueue(Device, Queue, OldIndex, AvailableIndex);
+    return;
+}
+
+VOID
+VirtnetpPrepareTransmitHeader (
+    PNET_PACKET_BUFFER Packet,
+    PVIRTNET_HEADER Header
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills out the virtio network header for an outgoing frame,
+    requesting checksum and segmentation offload as the packet flags ask.
+    The device expects the transport checksum field to hold the pseudo-header
+    sum, which it then completes over the rest of the segment.
+
+Arguments:
+
+    Packet - Supplies a pointer to the packet to be sent.
+
+    Header - Supplies a pointer to the header to fill out.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PUCHAR Address;
+    PUCHAR Checksum;
+    USHORT ChecksumOffset;
+    USHORT EthernetType;
+    PUCHAR Frame;
+    USHORT Fragment;
+    PIP4_HEADER Ip4Header;
+    ULONG Ip4HeaderLength;
+    ULONG Length;
+    ULONG Offloads;
+    ULONG Sum;
+    ULONG TransportLength;
+    ULONG TransportOffset;
+
+    RtlZeroMemory(Header, sizeof(VIRTNET_HEADER));
+    Offloads = NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD |
+               NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD |
+               NET_PACKET_FLAG_SEGMENTATION_OFFLOAD;
+
+    if ((Packet->Flags & Offloads) == 0) {
+        return;
+    }
+
+    //
+    // Only IPv4 frames get offloads from the networking core.
+    //
+
+    Frame = Packet->Buffer + Packet->DataOffset;
+    Length = Packet->FooterOffset - Packet->DataOffset;
+    if (Length < (VIRTNET_ETHERNET_HEADER_SIZE + sizeof(IP4_HEADER))) {
+        return;
+    }
+
+    EthernetType = (Frame[VIRTNET_ETHERNET_TYPE_OFFSET] << 8) |
+                   Frame[VIRTNET_ETHERNET_TYPE_OFFSET + 1];
+
+    if (EthernetType != IP4_PROTOCOL_NUMBER) {
+        return;
+    }
+
+    Ip4Header = (PIP4_HEADER)(Frame + VIRTNET_ETHERNET_HEADER_SIZE);
+    Ip4HeaderLength = (Ip4Header->VersionAndHeaderLength &
+                       IP4_HEADER_LENGTH_MASK) * sizeof(ULONG);
+
+    TransportOffset = VIRTNET_ETHERNET_HEADER_SIZE + Ip4HeaderLength;
+    TransportLength = NETWORK_TO_CPU16(Ip4Header->TotalLength) -
+                      Ip4HeaderLength;
+
+    //
+    // A fragment only carries part of the datagram, so the device cannot
+    // checksum it. UDP over IPv4 allows a zero checksum, which is what the
+    // networking core left in the field.
+    //
+
+    Fragment = NETWORK_TO_CPU16(Ip4Header->FragmentOffset);
+    if (((Fragment >> IP4_FRAGMENT_FLAGS_SHIFT) &
+         IP4_FLAG_MORE_FRAGMENTS) != 0) {
+
+        return;
+    }
+
+    if (((Fragment >> IP4_FRAGMENT_OFFSET_SHIFT) &
+         IP4_FRAGMENT_OFFSET_MASK) != 0) {
+
+        return;
+    }
+
+    if (Ip4Header->Protocol == SOCKET_INTERNET_PROTOCOL_TCP) {
+        ChecksumOffset = VIRTNET_TCP_CHECKSUM_OFFSET;
+
+    } else if (Ip4Header->Protocol == SOCKET_INTERNET_PROTOCOL_UDP) {
+        ChecksumOffset = VIRTNET_UDP_CHECKSUM_OFFSET;
+
+    } else {
+        return;
+    }
+
+    if ((TransportOffset + ChecksumOffset + sizeof(USHORT)) > Length) {
+        return;
+    }
+
+    //
+    // Sum the pseudo-header: the addresses, the protocol, and the transport
+    // length. Store it folded but not complemented.
+    //
+
+    Sum = 0;
+    Address = (PUCHAR)&(Ip4Header->SourceAddress);
+    Sum += (Address[0] << 8) | Address[1];
+    Sum += (Address[2] << 8) | Address[3];
+    Address = (PUCHAR)&(Ip4Header->DestinationAddress);
+    Sum += (Address[0] << 8) | Address[1];
+    Sum += (Address[2] << 8) | Address[3];
+    Sum += Ip4Header->Protocol;
+    Sum += TransportLength;
+    while ((Sum >> 16) != 0) {
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+    }
+
+    Checksum = Frame + TransportOffset + ChecksumOffset;
+    Checksum[0] = (UCHAR)(Sum >> 8);
+    Checksum[1] = (UCHAR)Sum;
+    Header->Flags = VIRTNET_HEADER_FLAG_NEEDS_CHECKSUM;
+    Header->ChecksumStart = TransportOffset;
+    Header->ChecksumOffset = ChecksumOffset;
+
+    //
+    // For segmentation offload, the device replicates everything up to the
+    // end of the TCP header in front of each segment.
+    //
+
+    if (((Packet->Flags & NET_PACKET_FLAG_SEGMENTATION_OFFLOAD) != 0) &&
+        (Ip4Header->Protocol == SOCKET_INTERNET_PROTOCOL_TCP)) {
+
+        Header->GsoType = VIRTNET_HEADER_GSO_TCPV4;
+        Header->GsoSize = Packet->SegmentSize;
+        Header->HeaderLength =
+                TransportOffset +
+                ((Frame[TransportOffset + VIRTNET_TCP_HEADER_LENGTH_OFFSET] >>
+                  VIRTNET_TCP_HEADER_LENGTH_SHIFT) * sizeof(ULONG));
+    }
+
+    return;
+}
+
+KSTATUS
+VirtnetpSendControlCommand (
+    PVIRTNET_DEVICE Device,
+    UCHAR Class,
+    UCHAR Command,
+    PVOID Data,
+    ULONG DataSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a command on the control queue and waits for the device
+    to acknowledge it. The device handles control commands synchronously, so a
+    short poll suffices. This routine assumes the configuration lock is held.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Class - Supplies the command class.
+
+    Command - Supplies the command.
+
+    Data - Supplies a pointer to the command data.
+
+    DataSize - Supplies the size of the command data in bytes.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    USHORT AvailableIndex;
+    PVIRTNET_CONTROL_COMMAND ControlCommand;
+    ULONGLONG CurrentTime;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PVIRTNET_QUEUE Queue;
+    KSTATUS Status;
+    ULONGLONG Timeout;
+
+    ASSERT(DataSize <= VIRTNET_CONTROL_DATA_SIZE);
+
+    if (Device->ControlCommand == NULL) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Queue = &(Device->ControlQueue);
+    ControlCommand = Device->ControlCommand;
+    PhysicalAddress = Device->ControlCommandPhysicalAddress;
+    ControlCommand->Class = Class;
+    ControlCommand->Command = Command;
+    RtlCopyMemory(ControlCommand->Data, Data, DataSize);
+    ControlCommand->Ack = VIRTNET_CONTROL_ACK_ERROR;
+    Descriptors = Queue->Descriptors;
+    Descriptors[0].Address = PhysicalAddress;
+    Descriptors[0].Length = sizeof(UCHAR) * 2;
+    Descriptors[0].Flags = VIRTIO_DESCRIPTOR_FLAG_NEXT;
+    Descriptors[0].Next = 1;
+    Descriptors[1].Address = PhysicalAddress +
+                             FIELD_OFFSET(VIRTNET_CONTROL_COMMAND, Data);
+
+    Descriptors[1].Length = DataSize;
+    Descriptors[1].Flags = VIRTIO_DESCRIPTOR_FLAG_NEXT;
+    Descriptors[1].Next = 2;
+    Descriptors[2].Address = PhysicalAddress +
+                             FIELD_OFFSET(VIRTNET_CONTROL_COMMAND, Ack);
+
+    Descriptors[2].Length = sizeof(UCHAR);
+    Descriptors[2].Flags = VIRTIO_DESCRIPTOR_FLAG_WRITE;
+    AvailableIndex = Queue->Available->Index;
+    Queue->Available->Ring[AvailableIndex & (Queue->Size - 1)] = 0;
+    RtlMemoryBarrier();
+    Queue->Available->Index = AvailableIndex + 1;
+    RtlMemoryBarrier();
+    VIRTNET_WRITE_REGISTER16(Device, VirtioRegisterQueueNotify, Queue->Index);
+    CurrentTime = KeGetRecentTimeCounter();
+    Timeout = CurrentTime +
+              (HlQueryTimeCounterFrequency() * VIRTNET_DEVICE_TIMEOUT);
+
+    do {
+        if (Queue->Used->Index != Queue->LastUsedIndex) {
+            break;
+        }
+
+        CurrentTime = KeGetRecentTimeCounter();
+
+    } while (CurrentTime <= Timeout);
+
+    if (Queue->Used->Index == Queue->LastUsedIndex) {
+        Status = STATUS_TIMEOUT;
+        goto SendControlCommandEnd;
+    }
+
+    Queue->LastUsedIndex += 1;
+    RtlMemoryBarrier();
+    Status = STATUS_SUCCESS;
+    if (ControlCommand->Ack != VIRTNET_CONTROL_ACK_OK) {
+        Status = STATUS_UNSUCCESSFUL;
+    }
+
+SendControlCommandEnd:
+    return Status;
+}
+
+VOID
+VirtnetpCheckLinkState (
+    PVIRTNET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the link status from the device configuration and
+    notifies the networking core if it changed. Devices that do not report
+    status are always up.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL LinkActive;
+    ULONGLONG LinkSpeed;
+    USHORT Status;
+
+    if (Device->NetworkLink == NULL) {
+        return;
+    }
+
+    LinkActive = TRUE;
+    if ((Device->Features & VIRTNET_FEATURE_STATUS) != 0) {
+        Status = VIRTNET_READ_CONFIGURATION16(Device,
+                                              VIRTNET_CONFIGURATION_STATUS);
+
+        if ((Status & VIRTNET_STATUS_LINK_UP) == 0) {
+            LinkActive = FALSE;
+        }
+    }
+
+    if (LinkActive == Device->LinkActive) {
+        return;
+    }
+
+    Device->LinkActive = LinkActive;
+    LinkSpeed = NET_SPEED_NONE;
+    if (LinkActive != FALSE) {
+        LinkSpeed = VIRTNET_LINK_SPEED;
+    }
+
+    NetSetLinkState(Device->NetworkLink, LinkActive, LinkSpeed);
+    return;
+}
+
@@ -0,0 +1,881 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    loopback.c
+
+Abstract:
+
+    This module implements the software loopback network device. Packets sent
+    down the link are handed straight back to the networking core as received
+    packets, without ever being copied.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define LOOPBACK_ALLOCATION_TAG 0x706F6F4C // 'pooL'
+
+//
+// Define the maximum number of packets that can be waiting to loop back
+// before new packets are dropped.
+//
+
+#define LOOPBACK_MAX_PENDING_PACKET_COUNT 1024
+
+//
+// Define the nominal speed the loopback link reports, in bits per second.
+//
+
+#define LOOPBACK_LINK_SPEED 10000000000ULL
+
+//
+// Since nothing validates checksums or splits segments on the way through,
+// the loopback link can offload all of that work and skip it entirely.
+//
+
+#define LOOPBACK_CAPABILITIES                          \
+    (NET_LINK_CAPABILITY_CHECKSUM_TRANSMIT_MASK |      \
+     NET_LINK_CAPABILITY_CHECKSUM_RECEIVE_MASK |       \
+     NET_LINK_CAPABILITY_TCP_SEGMENTATION_OFFLOAD)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a loopback device.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device.
+
+    NetworkLink - Stores a pointer to the core networking link.
+
+    Lock - Stores a pointer to the queued lock protecting the pending packet
+        list and the work queued flag.
+
+    PendingList - Stores the list of packets that have been sent but not yet
+        received.
+
+    WorkItem - Stores a pointer to the work item that delivers pending
+        packets back up the stack.
+
+    WorkQueued - Stores a boolean indicating whether or not the work item has
+        been queued and has not yet drained the pending list.
+
+--*/
+
+typedef struct _LOOPBACK_DEVICE {
+    PDEVICE OsDevice;
+    PNET_LINK NetworkLink;
+    PQUEUED_LOCK Lock;
+    NET_PACKET_LIST PendingList;
+    PWORK_ITEM WorkItem;
+    BOOL WorkQueued;
+} LOOPBACK_DEVICE, *PLOOPBACK_DEVICE;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+LoopbackAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+LoopbackDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+LoopbackDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+LoopbackDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+LoopbackDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+LoopbackDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+KSTATUS
+LoopbackSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    );
+
+KSTATUS
+LoopbackGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+VOID
+LoopbackDestroyLink (
+    PVOID DeviceContext
+    );
+
+KSTATUS
+LoopbackpStartDevice (
+    PLOOPBACK_DEVICE Device
+    );
+
+VOID
+LoopbackpReceiveWorker (
+    PVOID Parameter
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER LoopbackDriver = NULL;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the loopback driver. It registers its
+    other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    KSTATUS Status;
+
+    LoopbackDriver = Driver;
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    FunctionTable.AddDevice = LoopbackAddDevice;
+    FunctionTable.DispatchStateChange = LoopbackDispatchStateChange;
+    FunctionTable.DispatchOpen = LoopbackDispatchOpen;
+    FunctionTable.DispatchClose = LoopbackDispatchClose;
+    FunctionTable.DispatchIo = LoopbackDispatchIo;
+    FunctionTable.DispatchSystemControl = LoopbackDispatchSystemControl;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    return Status;
+}
+
+KSTATUS
+LoopbackAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the loopback
+    driver acts as the function driver. The driver will attach itself to the
+    stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PLOOPBACK_DEVICE Device;
+    KSTATUS Status;
+
+    Device = MmAllocateNonPagedPool(sizeof(LOOPBACK_DEVICE),
+                                    LOOPBACK_ALLOCATION_TAG);
+
+    if (Device == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Device, sizeof(LOOPBACK_DEVICE));
+    Device->OsDevice = DeviceToken;
+    NET_INITIALIZE_PACKET_LIST(&(Device->PendingList));
+    Device->Lock = KeCreateQueuedLock();
+    if (Device->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    Device->WorkItem = KeCreateWorkItem(NULL,
+                                        WorkPriorityNormal,
+                                        LoopbackpReceiveWorker,
+                                        Device,
+                                        LOOPBACK_ALLOCATION_TAG);
+
+    if (Device->WorkItem == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device != NULL) {
+            if (Device->WorkItem != NULL) {
+                KeDestroyWorkItem(Device->WorkItem);
+            }
+
+            if (Device->Lock != NULL) {
+                KeDestroyQueuedLock(Device->Lock);
+            }
+
+            MmFreeNonPagedPool(Device);
+            Device = NULL;
+        }
+    }
+
+    return Status;
+}
+
+VOID
+LoopbackDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorStateChange);
+
+    //
+    // The loopback device hangs off the root with no bus driver beneath it,
+    // so it completes the state change IRPs itself on the way down.
+    //
+
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+        case IrpMinorQueryChildren:
+            IoCompleteIrp(LoopbackDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorStartDevice:
+            Status = LoopbackpStartDevice(DeviceContext);
+            IoCompleteIrp(LoopbackDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+LoopbackDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+LoopbackDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+LoopbackDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+LoopbackDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLOOPBACK_DEVICE Device;
+    PSYSTEM_CONTROL_DEVICE_INFORMATION DeviceInformationRequest;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorSystemControlDeviceInformation:
+            DeviceInformationRequest = Irp->U.SystemControl.SystemContext;
+            Status = NetGetSetLinkDeviceInformation(
+                                         Device->NetworkLink,
+                                         &(DeviceInformationRequest->Uuid),
+                                         DeviceInformationRequest->Data,
+                                         &(DeviceInformationRequest->DataSize),
+                                         DeviceInformationRequest->Set);
+
+            IoCompleteIrp(LoopbackDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+LoopbackSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the network. For loopback, the packets are
+    queued to come back up the stack from a work item, as the sender may be
+    holding locks the receive path needs.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link down which this data is to be sent.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if some or all of the packets were dropped due to
+    the hardware being backed up with too many packets to send.
+
+    Other failure codes indicate that none of the packets were sent.
+
+--*/
+
+{
+
+    PLOOPBACK_DEVICE Device;
+    BOOL QueueWork;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Device = (PLOOPBACK_DEVICE)DeviceContext;
+    QueueWork = FALSE;
+    KeAcquireQueuedLock(Device->Lock);
+    if (Device->PendingList.Count < LOOPBACK_MAX_PENDING_PACKET_COUNT) {
+        NET_APPEND_PACKET_LIST(PacketList, &(Device->PendingList));
+        if (Device->WorkQueued == FALSE) {
+            Device->WorkQueued = TRUE;
+            QueueWork = TRUE;
+        }
+
+        Status = STATUS_SUCCESS;
+
+    } else {
+        Status = STATUS_RESOURCE_IN_USE;
+    }
+
+    KeReleaseQueuedLock(Device->Lock);
+    if (QueueWork != FALSE) {
+        KeQueueWorkItem(Device->WorkItem);
+    }
+
+    return Status;
+}
+
+KSTATUS
+LoopbackGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the network device layer's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link for which information is being set or queried.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PULONG BooleanOption;
+    PULONG Flags;
+    KSTATUS Status;
+
+    switch (InformationType) {
+    case NetLinkInformationChecksumOffload:
+        if (*DataSize != sizeof(ULONG)) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (Set != FALSE) {
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        Flags = (PULONG)Data;
+        *Flags = LOOPBACK_CAPABILITIES & NET_LINK_CAPABILITY_CHECKSUM_MASK;
+        Status = STATUS_SUCCESS;
+        break;
+
+    //
+    // The loopback link sees every packet sent on it already, so it is always
+    // effectively promiscuous.
+    //
+
+    case NetLinkInformationPromiscuousMode:
+        if (*DataSize != sizeof(ULONG)) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (Set != FALSE) {
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        BooleanOption = (PULONG)Data;
+        *BooleanOption = TRUE;
+        Status = STATUS_SUCCESS;
+        break;
+
+    default:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+    }
+
+    return Status;
+}
+
+VOID
+LoopbackDestroyLink (
+    PVOID DeviceContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device layer that the networking core is in the
+    process of destroying the link and will no longer call into the device for
+    this link. This allows the device layer to release any context that was
+    supporting the device link interface.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+LoopbackpStartDevice (
+    PLOOPBACK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the loopback device, adding its link to the core
+    networking library and bringing it up.
+
+Arguments:
+
+    Device - Supplies a pointer to the loopback device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    NET_LINK_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if (Device->NetworkLink != NULL) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // The loopback link has no device limits of its own, the data link layer
+    // decides the sizes. The physical address just has to be valid.
+    //
+
+    RtlZeroMemory(&Properties, sizeof(NET_LINK_PROPERTIES));
+    Properties.Version = NET_LINK_PROPERTIES_VERSION;
+    Properties.TransmitAlignment = 1;
+    Properties.Device = Device->OsDevice;
+    Properties.DeviceContext = Device;
+    Properties.PacketSizeInformation.MaxPacketSize = MAX_ULONG;
+    Properties.DataLinkType = NetDomainLoopback;
+    Properties.MaxPhysicalAddress = MAX_ULONG;
+    Properties.PhysicalAddress.Domain = NetDomainLoopback;
+    Properties.Interface.Send = LoopbackSend;
+    Properties.Interface.GetSetInformation = LoopbackGetSetInformation;
+    Properties.Interface.DestroyLink = LoopbackDestroyLink;
+    Properties.Capabilities = LOOPBACK_CAPABILITIES;
+    Status = NetAddLink(&Properties, &(Device->NetworkLink));
+    if (!KSUCCESS(Status)) {
+        Device->NetworkLink = NULL;
+        return Status;
+    }
+
+    NetSetLinkState(Device->NetworkLink, TRUE, LOOPBACK_LINK_SPEED);
+    return STATUS_SUCCESS;
+}
+
+VOID
+LoopbackpReceiveWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine delivers the packets sent on the loopback link back up the
+    stack, a budget's worth at a time.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the loopback device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PLOOPBACK_DEVICE Device;
+    PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST ReceiveList;
+
+    Device = (PLOOPBACK_DEVICE)Parameter;
+    NET_INITIALIZE_PACKET_LIST(&ReceiveList);
+    while (TRUE) {
+        KeAcquireQueuedLock(Device->Lock);
+        if (NET_PACKET_LIST_EMPTY(&(Device->PendingList)) != FALSE) {
+            Device->WorkQueued = FALSE;
+            KeReleaseQueuedLock(Device->Lock);
+            break;
+        }
+
+        while ((NET_PACKET_LIST_EMPTY(&(Device->PendingList)) == FALSE) &&
+               (ReceiveList.Count < NET_RECEIVE_DEFAULT_BUDGET)) {
+
+            Packet = LIST_VALUE(Device->PendingList.Head.Next,
+                                NET_PACKET_BUFFER,
+                                ListEntry);
+
+            NET_REMOVE_PACKET_FROM_LIST(Packet, &(Device->PendingList));
+            NET_ADD_PACKET_TO_LIST(Packet, &ReceiveList);
+        }
+
+        KeReleaseQueuedLock(Device->Lock);
+
+        //
+        // The packets never touched a wire, so their checksums are as good as
+        // verified. The buffers belong to this driver now, so the stack is
+        // free to keep their data rather than copy it.
+        //
+
+        CurrentEntry = ReceiveList.Head.Next;
+        while (CurrentEntry != &(ReceiveList.Head)) {
+            Packet = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
+            CurrentEntry = CurrentEntry->Next;
+            Packet->Flags &= ~(NET_PACKET_FLAG_SEGMENTATION_OFFLOAD |
+                               NET_PACKET_FLAG_IP_CHECKSUM_FAILED |
+                               NET_PACKET_FLAG_UDP_CHECKSUM_FAILED |
+                               NET_PACKET_FLAG_TCP_CHECKSUM_FAILED);
+
+            Packet->Flags |= NET_PACKET_FLAG_CHECKSUM_OFFLOAD_MASK |
+                             NET_PACKET_FLAG_EXCHANGEABLE;
+        }
+
+        NetProcessReceivedPacketList(Device->NetworkLink, &ReceiveList);
+        NetDestroyBufferList(&ReceiveList);
+    }
+
+    return;
+}
+
@@ -190,6 +190,19 @@ NetpCheckLocalAddressAvailability (
     PNETWORK_ADDRESS LocalAddress
     );
 
+BOOL
+NetpIsAddressInSubnet (
+    PNET_LINK_ADDRESS_ENTRY LinkAddress,
+    PNETWORK_ADDRESS Address
+    );
+
+PRED_BLACK_TREE_NODE
+NetpSelectReusePortSocket (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FoundNode,
+    PNET_SOCKET SearchEntry
+    );
+
 VOID
 NetpGetPacketSizeInformation (
     PNET_LINK Link,
@@ -624,13 +637,20 @@ Return Value:
         KeSignalEvent(Link->AddressTranslationEvent, SignalOptionUnsignal);
 
         //
-        // Request an address for the first link.
+        // Request an address for the first link, unless it was statically
+        // configured before the link came up (as the loopback link is).
         //
 
         LinkAddress = LIST_VALUE(Link->LinkAddressList.Next,
                                  NET_LINK_ADDRESS_ENTRY,
                                  ListEntry);
 
+        if ((LinkAddress->Configured != FALSE) &&
+            (LinkAddress->StaticAddress != FALSE)) {
+
+            return;
+        }
+
         Status = NetpDhcpBeginAssignment(Link, LinkAddress);
         if (!KSUCCESS(Status)) {
 
@@ -1079,6 +1099,8 @@ Return Value:
     PNET_LINK_ADDRESS_ENTRY CurrentLinkAddressEntry;
     PLIST_ENTRY CurrentLinkEntry;
     PNET_LINK_ADDRESS_ENTRY FoundAddress;
+    PNET_LINK FoundLink;
+    BOOL Loopback;
     KSTATUS Status;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
@@ -1091,6 +1113,7 @@ Return Value:
 
     Status = STATUS_NO_NETWORK_CONNECTION;
     FoundAddress = NULL;
+    FoundLink = NULL;
     CurrentLinkEntry = NetLinkList.Next;
     while (CurrentLinkEntry != &NetLinkList) {
         CurrentLink = LIST_VALUE(CurrentLinkEntry, NET_LINK, ListEntry);
@@ -1104,6 +1127,19 @@ Return Value:
             continue;
         }
 
+        //
+        // Once a regular link has been found, only a loopback link can
+        // displace it.
+        //
+
+        Loopback = FALSE;
+        if (CurrentLink->Properties.DataLinkType == NetDomainLoopback) {
+            Loopback = TRUE;
+
+        } else if (FoundLink != NULL) {
+            continue;
+        }
+
         //
         // TODO: Properly determine the route for this destination, rather
         // than just connecting through the first working network link and first
@@ -1119,8 +1155,18 @@ Return Value:
                                              NET_LINK_ADDRESS_ENTRY,
                                              ListEntry);
 
-        if (CurrentLinkAddressEntry->Configured != FALSE) {
+        //
+        // A loopback link can only reach the addresses in its own subnet,
+        // but it is always the preferred route to them.
+        //
+
+        if ((CurrentLinkAddressEntry->Configured != FALSE) &&
+            ((Loopback == FALSE) ||
+             (NetpIsAddressInSubnet(CurrentLinkAddressEntry,
+                                    RemoteAddress) != FALSE))) {
+
             FoundAddress = CurrentLinkAddressEntry;
+            FoundLink = CurrentLink;
             RtlCopyMemory(&(LinkResult->ReceiveAddress),
                           &(FoundAddress->Address),
                           sizeof(NETWORK_ADDRESS));
@@ -1135,24 +1181,24 @@ Return Value:
         KeReleaseQueuedLock(CurrentLink->QueuedLock);
 
         //
-        // If a suitable link address was not found, continue on to the next
-        // link.
+        // Stop looking if a loopback route was found.
         //
 
-        if (FoundAddress == NULL) {
-            continue;
+        if ((FoundLink == CurrentLink) && (Loopback != FALSE)) {
+            break;
         }
+    }
 
-        //
-        // Fill out the link information. The local address was copied above
-        // under the lock in order to prevent a torn read.
-        //
+    //
+    // Fill out the link information. The local address was copied above
+    // under the lock in order to prevent a torn read.
+    //
 
-        NetLinkAddReference(CurrentLink);
-        LinkResult->Link = CurrentLink;
+    if (FoundLink != NULL) {
+        NetLinkAddReference(FoundLink);
+        LinkResult->Link = FoundLink;
         LinkResult->LinkAddress = FoundAddress;
         Status = STATUS_SUCCESS;
-        break;
     }
 
 FindLinkForDestinationAddressEnd:
@@ -1415,6 +1461,18 @@ Return Value:
     KSTATUS Status;
     ULONGLONG TimeDelta;
 
+    //
+    // Everything sent on a loopback link comes straight back to the link.
+    //
+
+    if (Link->Properties.DataLinkType == NetDomainLoopback) {
+        RtlCopyMemory(PhysicalAddress,
+                      &(Link->Properties.PhysicalAddress),
+                      sizeof(NETWORK_ADDRESS));
+
+        return STATUS_SUCCESS;
+    }
+
     EndTime = 0;
 
     //
@@ -2688,15 +2746,28 @@ Return Value:
             goto FindSocketEnd;
         }
 
+        //
+        // Multiple sockets may share a local address if they all allow exact
+        // address reuse. Spread the incoming flows across them.
+        //
+
         Tree = &(Protocol->SocketTree[SocketLocallyBound]);
         FoundNode = RtlRedBlackTreeSearch(Tree, &(SearchEntry.U.TreeEntry));
         if (FoundNode != NULL) {
+            FoundNode = NetpSelectReusePortSocket(Tree,
+                                                  FoundNode,
+                                                  &SearchEntry);
+
             goto FindSocketEnd;
         }
 
         Tree = &(Protocol->SocketTree[SocketUnbound]);
         FoundNode = RtlRedBlackTreeSearch(Tree, &(SearchEntry.U.TreeEntry));
         if (FoundNode != NULL) {
+            FoundNode = NetpSelectReusePortSocket(Tree,
+                                                  FoundNode,
+                                                  &SearchEntry);
+
             goto FindSocketEnd;
         }
 
@@ -4474,6 +4545,225 @@ Return Value:
     return AvailableAddress;
 }
 
+BOOL
+NetpIsAddressInSubnet (
+    PNET_LINK_ADDRESS_ENTRY LinkAddress,
+    PNETWORK_ADDRESS Address
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not the given address falls within the
+    subnet of the given link address entry. This routine assumes the link's
+    queued lock is held.
+
+Arguments:
+
+    LinkAddress - Supplies a pointer to the configured link address entry.
+
+    Address - Supplies a pointer to the address to test.
+
+Return Value:
+
+    TRUE if the address is in the link address entry's subnet.
+
+    FALSE if the address is outside the subnet or in a different domain.
+
+--*/
+
+{
+
+    ULONG Index;
+    UINTN Mask;
+
+    if (Address->Domain != LinkAddress->Address.Domain) {
+        return FALSE;
+    }
+
+    for (Index = 0;
+         Index < (MAX_NETWORK_ADDRESS_SIZE / sizeof(UINTN));
+         Index += 1) {
+
+        Mask = LinkAddress->Subnet.Address[Index];
+        if (((Address->Address[Index] ^
+              LinkAddress->Address.Address[Index]) & Mask) != 0) {
+
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+PRED_BLACK_TREE_NODE
+NetpSelectReusePortSocket (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FoundNode,
+    PNET_SOCKET SearchEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine picks which of a group of sockets sharing the same local
+    address via exact address reuse should receive a packet. The choice is
+    made by hashing the remote address and port so that all packets of a
+    flow land on the same socket. If any sockets in the group are listening,
+    only listening sockets are considered. This routine assumes the socket
+    lock is held.
+
+Arguments:
+
+    Tree - Supplies a pointer to the tree the node was found in.
+
+    FoundNode - Supplies a pointer to a node in the tree that matches the
+        search entry.
+
+    SearchEntry - Supplies a pointer to the search entry, which contains the
+        local and remote addresses of the packet.
+
+Return Value:
+
+    Returns a pointer to the tree node of the selected socket.
+
+--*/
+
+{
+
+    ULONG Candidates;
+    ULONG Hash;
+    ULONG Listeners;
+    PRED_BLACK_TREE_NODE LowestNode;
+    ULONG Mask;
+    PRED_BLACK_TREE_NODE NextNode;
+    PNET_SOCKET NextSocket;
+    ULONG PartIndex;
+    PNETWORK_ADDRESS RemoteAddress;
+    COMPARISON_RESULT Result;
+    ULONG Selection;
+
+    NextSocket = RED_BLACK_TREE_VALUE(FoundNode, NET_SOCKET, U.TreeEntry);
+    if ((NextSocket->Flags & NET_SOCKET_FLAG_REUSE_EXACT_ADDRESS) == 0) {
+        return FoundNode;
+    }
+
+    //
+    // Back up to the lowest node that matches.
+    //
+
+    LowestNode = FoundNode;
+    while (TRUE) {
+        NextNode = RtlRedBlackTreeGetNextNode(Tree, TRUE, LowestNode);
+        if (NextNode == NULL) {
+            break;
+        }
+
+        Result = Tree->CompareFunction(Tree,
+                                       NextNode,
+                                       &(SearchEntry->U.TreeEntry));
+
+        if (Result != ComparisonResultSame) {
+            break;
+        }
+
+        LowestNode = NextNode;
+    }
+
+    //
+    // Count the active sockets in the group, and how many of them are
+    // listening.
+    //
+
+    Candidates = 0;
+    Listeners = 0;
+    NextNode = LowestNode;
+    while (NextNode != NULL) {
+        Result = Tree->CompareFunction(Tree,
+                                       NextNode,
+                                       &(SearchEntry->U.TreeEntry));
+
+        if (Result != ComparisonResultSame) {
+            break;
+        }
+
+        NextSocket = RED_BLACK_TREE_VALUE(NextNode, NET_SOCKET, U.TreeEntry);
+        if (((NextSocket->Flags & NET_SOCKET_FLAG_ACTIVE) != 0) &&
+            ((NextSocket->Flags & NET_SOCKET_FLAG_REUSE_EXACT_ADDRESS) != 0)) {
+
+            Candidates += 1;
+            if ((NextSocket->Flags & NET_SOCKET_FLAG_LISTENING) != 0) {
+                Listeners += 1;
+            }
+        }
+
+        NextNode = RtlRedBlackTreeGetNextNode(Tree, FALSE, NextNode);
+    }
+
+    Mask = NET_SOCKET_FLAG_ACTIVE | NET_SOCKET_FLAG_REUSE_EXACT_ADDRESS;
+    if (Listeners != 0) {
+        Candidates = Listeners;
+        Mask |= NET_SOCKET_FLAG_LISTENING;
+    }
+
+    if (Candidates <= 1) {
+        if (Candidates == 0) {
+            return FoundNode;
+        }
+
+        Selection = 0;
+
+    } else {
+
+        //
+        // Hash the remote address and port. This only needs to be stable and
+        // reasonably well distributed, not cryptographically strong.
+        //
+
+        RemoteAddress = &(SearchEntry->RemoteAddress);
+        Hash = RemoteAddress->Port;
+        for (PartIndex = 0;
+             PartIndex < MAX_NETWORK_ADDRESS_SIZE / sizeof(UINTN);
+             PartIndex += 1) {
+
+            Hash ^= (ULONG)(RemoteAddress->Address[PartIndex]);
+            if (sizeof(UINTN) > sizeof(ULONG)) {
+                Hash ^= (ULONG)((ULONGLONG)RemoteAddress->Address[PartIndex] >>
+                                32);
+            }
+
+            Hash *= 0x9E3779B1;
+            Hash ^= Hash >> 16;
+        }
+
+        Selection = Hash % Candidates;
+    }
+
+    //
+    // Walk the group again to find the selected socket.
+    //
+
+    NextNode = LowestNode;
+    while (NextNode != NULL) {
+        NextSocket = RED_BLACK_TREE_VALUE(NextNode, NET_SOCKET, U.TreeEntry);
+        if ((NextSocket->Flags & Mask) == Mask) {
+            if (Selection == 0) {
+                return NextNode;
+            }
+
+            Selection -= 1;
+        }
+
+        NextNode = RtlRedBlackTreeGetNextNode(Tree, FALSE, NextNode);
+    }
+
+    ASSERT(FALSE);
+
+    return FoundNode;
+}
+
 VOID
 NetpGetPacketSizeInformation (
     PNET_LINK Link,
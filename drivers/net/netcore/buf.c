@@ -305,6 +305,7 @@ Return Value:
         Buffer->DataSize = DataSize;
         Buffer->DataOffset = HeaderSize;
         Buffer->FooterOffset = Buffer->DataOffset + Size;
+        Buffer->SegmentSize = 0;
 
         //
         // If padding was added to the packet, then zero it.
@@ -389,6 +390,101 @@ Return Value:
     return;
 }
 
+NET_API
+KSTATUS
+NetClaimReceivedPacket (
+    PNET_RECEIVE_CONTEXT ReceiveContext,
+    PNET_PACKET_BUFFER *ClaimedPacket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to take ownership of the data in a received packet
+    without copying it. This only succeeds for packets the device marked as
+    exchangeable. On success, the received data is moved into a new packet
+    owned by the caller and the device's packet receives a fresh buffer. The
+    packet in the receive context must not be examined after this routine
+    succeeds.
+
+Arguments:
+
+    ReceiveContext - Supplies a pointer to the receive context for the packet.
+
+    ClaimedPacket - Supplies a pointer where a pointer to the packet holding
+        the received data will be returned on success. The caller is
+        responsible for releasing it with NetFreeBuffer.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the packet cannot be exchanged.
+
+    STATUS_INSUFFICIENT_RESOURCES if a replacement buffer could not be
+    allocated.
+
+--*/
+
+{
+
+    PVOID Buffer;
+    PIO_BUFFER IoBuffer;
+    PNET_PACKET_BUFFER Packet;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PNET_PACKET_BUFFER Replacement;
+    ULONG Size;
+    KSTATUS Status;
+
+    *ClaimedPacket = NULL;
+    Packet = ReceiveContext->Packet;
+    if ((Packet->Flags & NET_PACKET_FLAG_EXCHANGEABLE) == 0) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    //
+    // Allocate a buffer with the same constraints the device used for its
+    // receive buffer.
+    //
+
+    Status = NetAllocateBuffer(0,
+                               Packet->BufferSize,
+                               0,
+                               ReceiveContext->Link,
+                               0,
+                               &Replacement);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // Swap the backing storage. The device keeps its packet structure but
+    // with the fresh buffer, and the caller gets the received data.
+    //
+
+    Buffer = Replacement->Buffer;
+    IoBuffer = Replacement->IoBuffer;
+    PhysicalAddress = Replacement->BufferPhysicalAddress;
+    Size = Replacement->BufferSize;
+    Replacement->Buffer = Packet->Buffer;
+    Replacement->IoBuffer = Packet->IoBuffer;
+    Replacement->BufferPhysicalAddress = Packet->BufferPhysicalAddress;
+    Replacement->BufferSize = Packet->BufferSize;
+    Replacement->Flags = Packet->Flags & ~NET_PACKET_FLAG_EXCHANGEABLE;
+    Replacement->DataSize = Packet->DataSize;
+    Replacement->DataOffset = Packet->DataOffset;
+    Replacement->FooterOffset = Packet->FooterOffset;
+    Packet->Buffer = Buffer;
+    Packet->IoBuffer = IoBuffer;
+    Packet->BufferPhysicalAddress = PhysicalAddress;
+    Packet->BufferSize = Size;
+    Packet->Flags &= ~NET_PACKET_FLAG_EXCHANGEABLE;
+    *ClaimedPacket = Replacement;
+    return STATUS_SUCCESS;
+}
+
 KSTATUS
 NetpInitializeBuffers (
     VOID
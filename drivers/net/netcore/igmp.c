@@ -752,7 +752,8 @@ NET_PROTOCOL_ENTRY NetIgmpProtocol = {
         NetpIgmpProcessReceivedSocketData,
         NetpIgmpReceive,
         NetpIgmpGetSetInformation,
-        NetpIgmpUserControl
+        NetpIgmpUserControl,
+        NULL
     }
 };
 
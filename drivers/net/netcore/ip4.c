@@ -528,8 +528,35 @@ Return Value:
 
     PNET_LINK_ADDRESS_ENTRY AddressEntry;
     IP4_ADDRESS InitialAddress;
+    IP4_ADDRESS LoopbackSubnet;
     KSTATUS Status;
 
+    //
+    // The loopback link always gets the well known loopback address, which
+    // needs no configuration.
+    //
+
+    if (Link->Properties.DataLinkType == NetDomainLoopback) {
+        RtlZeroMemory((PNETWORK_ADDRESS)&InitialAddress,
+                      sizeof(NETWORK_ADDRESS));
+
+        RtlZeroMemory((PNETWORK_ADDRESS)&LoopbackSubnet,
+                      sizeof(NETWORK_ADDRESS));
+
+        InitialAddress.Domain = NetDomainIp4;
+        InitialAddress.Address = IP4_LOOPBACK_ADDRESS;
+        LoopbackSubnet.Domain = NetDomainIp4;
+        LoopbackSubnet.Address = IP4_LOOPBACK_SUBNET_MASK;
+        Status = NetCreateLinkAddressEntry(Link,
+                                           (PNETWORK_ADDRESS)&InitialAddress,
+                                           (PNETWORK_ADDRESS)&LoopbackSubnet,
+                                           (PNETWORK_ADDRESS)&InitialAddress,
+                                           TRUE,
+                                           &AddressEntry);
+
+        goto Ip4InitializeLinkEnd;
+    }
+
     //
     // A dummy address with only the network filled in is required, otherwise
     // this link entry cannot be bound to in order to establish the real
@@ -1225,10 +1252,15 @@ Return Value:
         //
         // If the current packet's total data size (including all headers and
         // footers) is larger than the socket's/link's maximum size, then the
-        // IP layer needs to break it into multiple fragments.
+        // IP layer needs to break it into multiple fragments. Packets marked
+        // for segmentation offload are split by the hardware instead.
         //
 
-        } else if (Packet->DataSize > MaxPacketSize) {
+        } else if ((Packet->DataSize > MaxPacketSize) &&
+                   (((Packet->Flags &
+                      NET_PACKET_FLAG_SEGMENTATION_OFFLOAD) == 0) ||
+                    ((Link->Properties.Capabilities &
+                      NET_LINK_CAPABILITY_TCP_SEGMENTATION_OFFLOAD) == 0))) {
 
             //
             // Determine the size of the remaining headers and footers that
@@ -0,0 +1,534 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    loopback.c
+
+Abstract:
+
+    This module implements the data link layer for software loopback links.
+    Loopback packets carry no framing beyond the network protocol number, and
+    never need address resolution.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// Data link layer drivers are supposed to be able to stand on their own (ie be
+// able to be implemented outside the core net library). For the builtin ones,
+// avoid including netcore.h, but still redefine those functions that would
+// otherwise generate imports.
+//
+
+#define NET_API __DLLEXPORT
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the device ID of the root device that the loopback driver attaches
+// to.
+//
+
+#define LOOPBACK_DEVICE_ID "NETLOOP"
+
+//
+// The loopback header is just the network protocol number, kept a full ULONG
+// so that the network header behind it stays aligned.
+//
+
+#define LOOPBACK_HEADER_SIZE sizeof(ULONG)
+
+//
+// Define the largest payload a loopback link carries in one packet. There is
+// no wire to fit, so this is only limited by how large a buffer is reasonable
+// to allocate for every segment.
+//
+
+#define LOOPBACK_MAXIMUM_PAYLOAD_SIZE (16 * _1KB)
+
+#define LOOPBACK_STRING "loopback"
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+NetpLoopbackInitializeLink (
+    PNET_LINK Link
+    );
+
+VOID
+NetpLoopbackDestroyLink (
+    PNET_LINK Link
+    );
+
+KSTATUS
+NetpLoopbackSend (
+    PVOID DataLinkContext,
+    PNET_PACKET_LIST PacketList,
+    PNETWORK_ADDRESS SourcePhysicalAddress,
+    PNETWORK_ADDRESS DestinationPhysicalAddress,
+    ULONG ProtocolNumber
+    );
+
+VOID
+NetpLoopbackProcessReceivedPacket (
+    PVOID DataLinkContext,
+    PNET_PACKET_BUFFER Packet
+    );
+
+KSTATUS
+NetpLoopbackConvertToPhysicalAddress (
+    PNETWORK_ADDRESS NetworkAddress,
+    PNETWORK_ADDRESS PhysicalAddress,
+    NET_ADDRESS_TYPE NetworkAddressType
+    );
+
+ULONG
+NetpLoopbackPrintAddress (
+    PNETWORK_ADDRESS Address,
+    PSTR Buffer,
+    ULONG BufferLength
+    );
+
+VOID
+NetpLoopbackGetPacketSizeInformation (
+    PVOID DataLinkContext,
+    PNET_PACKET_SIZE_INFORMATION PacketSizeInformation,
+    ULONG Flags
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store a pointer to the root device that the loopback link hangs off of.
+//
+
+PDEVICE NetLoopbackDevice;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VOID
+NetpLoopbackInitialize (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes support for loopback links, and reports the root
+    device that the loopback driver attaches to.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    NET_DATA_LINK_ENTRY DataLinkEntry;
+    HANDLE DataLinkHandle;
+    PNET_DATA_LINK_INTERFACE Interface;
+    KSTATUS Status;
+
+    DataLinkEntry.Domain = NetDomainLoopback;
+    Interface = &(DataLinkEntry.Interface);
+    Interface->InitializeLink = NetpLoopbackInitializeLink;
+    Interface->DestroyLink = NetpLoopbackDestroyLink;
+    Interface->Send = NetpLoopbackSend;
+    Interface->ProcessReceivedPacket = NetpLoopbackProcessReceivedPacket;
+    Interface->ConvertToPhysicalAddress = NetpLoopbackConvertToPhysicalAddress;
+    Interface->PrintAddress = NetpLoopbackPrintAddress;
+    Interface->GetPacketSizeInformation = NetpLoopbackGetPacketSizeInformation;
+    Status = NetRegisterDataLinkLayer(&DataLinkEntry, &DataLinkHandle);
+    if (!KSUCCESS(Status)) {
+
+        ASSERT(FALSE);
+
+        return;
+    }
+
+    //
+    // The loopback device is not enumerated by any bus, so create it off the
+    // root. The loopback driver will pick it up and add the link.
+    //
+
+    Status = IoCreateDevice(NULL,
+                            NULL,
+                            NULL,
+                            LOOPBACK_DEVICE_ID,
+                            NULL,
+                            NULL,
+                            &NetLoopbackDevice);
+
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("NET: Failed to create loopback device: %d\n", Status);
+    }
+
+    return;
+}
+
+KSTATUS
+NetpLoopbackInitializeLink (
+    PNET_LINK Link
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes any pieces of information needed by the data link
+    layer for a new link.
+
+Arguments:
+
+    Link - Supplies a pointer to the new link.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    //
+    // Like Ethernet, loopback just needs the network link passed back as the
+    // data link context.
+    //
+
+    Link->DataLinkContext = Link;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NetpLoopbackDestroyLink (
+    PNET_LINK Link
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allows the data link layer to tear down any state before a
+    link is destroyed.
+
+Arguments:
+
+    Link - Supplies a pointer to the dying link.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Link->DataLinkContext = NULL;
+    return;
+}
+
+KSTATUS
+NetpLoopbackSend (
+    PVOID DataLinkContext,
+    PNET_PACKET_LIST PacketList,
+    PNETWORK_ADDRESS SourcePhysicalAddress,
+    PNETWORK_ADDRESS DestinationPhysicalAddress,
+    ULONG ProtocolNumber
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the data link layer and out the link.
+
+Arguments:
+
+    DataLinkContext - Supplies a pointer to the data link context for the
+        link on which to send the data.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+    SourcePhysicalAddress - Supplies a pointer to the source (local) physical
+        network address.
+
+    DestinationPhysicalAddress - Supplies the optional physical address of the
+        destination, or at least the next hop. If NULL is provided, then the
+        packets will be sent to the data link layer's broadcast address.
+
+    ProtocolNumber - Supplies the protocol number of the data inside the data
+        link header.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PVOID DeviceContext;
+    PNET_LINK Link;
+    PNET_PACKET_BUFFER Packet;
+    KSTATUS Status;
+
+    Link = (PNET_LINK)DataLinkContext;
+    CurrentEntry = PacketList->Head.Next;
+    while (CurrentEntry != &(PacketList->Head)) {
+        Packet = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+
+        ASSERT(Packet->DataOffset >= LOOPBACK_HEADER_SIZE);
+
+        Packet->DataOffset -= LOOPBACK_HEADER_SIZE;
+        *((PULONG)(Packet->Buffer + Packet->DataOffset)) = ProtocolNumber;
+    }
+
+    DeviceContext = Link->Properties.DeviceContext;
+    Status = Link->Properties.Interface.Send(DeviceContext, PacketList);
+
+    //
+    // If the device is too backed up to take the packets, drop them just as a
+    // busy wire would.
+    //
+
+    if (Status == STATUS_RESOURCE_IN_USE) {
+        NetDestroyBufferList(PacketList);
+        Status = STATUS_SUCCESS;
+    }
+
+    return Status;
+}
+
+VOID
+NetpLoopbackProcessReceivedPacket (
+    PVOID DataLinkContext,
+    PNET_PACKET_BUFFER Packet
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to process a received loopback packet.
+
+Arguments:
+
+    DataLinkContext - Supplies a pointer to the data link context for the link
+        that received the packet.
+
+    Packet - Supplies a pointer to a structure describing the incoming packet.
+        This structure may be used as a scratch space while this routine
+        executes and the packet travels up the stack, but will not be accessed
+        after this routine returns.
+
+Return Value:
+
+    None. When the function returns, the memory associated with the packet may
+    be reclaimed and reused.
+
+--*/
+
+{
+
+    PNET_LINK Link;
+    PNET_NETWORK_ENTRY NetworkEntry;
+    ULONG NetworkProtocol;
+    NET_RECEIVE_CONTEXT ReceiveContext;
+
+    Link = (PNET_LINK)DataLinkContext;
+    NetworkProtocol = *((PULONG)(Packet->Buffer + Packet->DataOffset));
+    NetworkEntry = NetGetNetworkEntry(NetworkProtocol);
+    if (NetworkEntry == NULL) {
+        RtlDebugPrint("Unknown protocol number 0x%x found in loopback "
+                      "header.\n",
+                      NetworkProtocol);
+
+        return;
+    }
+
+    Packet->DataOffset += LOOPBACK_HEADER_SIZE;
+    RtlZeroMemory(&ReceiveContext, sizeof(NET_RECEIVE_CONTEXT));
+    ReceiveContext.Packet = Packet;
+    ReceiveContext.Link = Link;
+    ReceiveContext.Network = NetworkEntry;
+    NetworkEntry->Interface.ProcessReceivedData(&ReceiveContext);
+    return;
+}
+
+KSTATUS
+NetpLoopbackConvertToPhysicalAddress (
+    PNETWORK_ADDRESS NetworkAddress,
+    PNETWORK_ADDRESS PhysicalAddress,
+    NET_ADDRESS_TYPE NetworkAddressType
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts the given network address to a physical layer address
+    based on the provided network address type.
+
+Arguments:
+
+    NetworkAddress - Supplies a pointer to the network layer address to convert.
+
+    PhysicalAddress - Supplies a pointer to an address that receives the
+        converted physical layer address.
+
+    NetworkAddressType - Supplies the classified type of the given network
+        address, which aids in conversion.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    //
+    // Every address on a loopback link, broadcast and multicast included,
+    // leads right back to the link itself.
+    //
+
+    RtlZeroMemory(PhysicalAddress, sizeof(NETWORK_ADDRESS));
+    PhysicalAddress->Domain = NetDomainLoopback;
+    return STATUS_SUCCESS;
+}
+
+ULONG
+NetpLoopbackPrintAddress (
+    PNETWORK_ADDRESS Address,
+    PSTR Buffer,
+    ULONG BufferLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to convert a network address into a string, or
+    determine the length of the buffer needed to convert an address into a
+    string.
+
+Arguments:
+
+    Address - Supplies an optional pointer to a network address to convert to
+        a string.
+
+    Buffer - Supplies an optional pointer where the string representation of
+        the address will be returned.
+
+    BufferLength - Supplies the length of the supplied buffer, in bytes.
+
+Return Value:
+
+    Returns the maximum length of any address if no network address is
+    supplied.
+
+    Returns the actual length of the network address string if a network address
+    was supplied, including the null terminator.
+
+--*/
+
+{
+
+    if (Address == NULL) {
+        return sizeof(LOOPBACK_STRING);
+    }
+
+    ASSERT(Address->Domain == NetDomainLoopback);
+
+    return RtlPrintToString(Buffer,
+                            BufferLength,
+                            CharacterEncodingAscii,
+                            LOOPBACK_STRING);
+}
+
+VOID
+NetpLoopbackGetPacketSizeInformation (
+    PVOID DataLinkContext,
+    PNET_PACKET_SIZE_INFORMATION PacketSizeInformation,
+    ULONG Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the current packet size information for the given link.
+    As the number of required headers can be different for each link, the
+    packet size information is not a constant for an entire data link layer.
+
+Arguments:
+
+    DataLinkContext - Supplies a pointer to the data link context of the link
+        whose packet size information is being queried.
+
+    PacketSizeInformation - Supplies a pointer to a structure that receives the
+        link's data link layer packet size information.
+
+    Flags - Supplies a bitmask of flags indicating which packet size
+        information is desired. See NET_PACKET_SIZE_FLAG_* for definitions.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PacketSizeInformation->HeaderSize = LOOPBACK_HEADER_SIZE;
+    PacketSizeInformation->FooterSize = 0;
+    PacketSizeInformation->MaxPacketSize = LOOPBACK_HEADER_SIZE +
+                                           LOOPBACK_MAXIMUM_PAYLOAD_SIZE;
+
+    PacketSizeInformation->MinPacketSize = 0;
+    return;
+}
+
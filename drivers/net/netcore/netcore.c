@@ -389,6 +389,12 @@ Return Value:
 
     NetpNetlinkGenericInitialize(1);
 
+    //
+    // Now that everything is registered, report the loopback device.
+    //
+
+    NetpLoopbackInitialize();
+
 DriverEntryEnd:
     if (!KSUCCESS(Status)) {
         if (NetPluginListLock != NULL) {
@@ -1218,6 +1224,268 @@ Return Value:
     return;
 }
 
+NET_API
+VOID
+NetProcessReceivedPacketList (
+    PNET_LINK Link,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called by the low level NIC driver to pass a batch of
+    received packets onto the core networking library for dispatching. Drivers
+    should call this from their receive poll loop, collecting at most a budget
+    of packets (see NET_RECEIVE_DEFAULT_BUDGET) per call. Socket wakeups are
+    deferred until the entire batch has been processed so that readers are
+    woken once per batch rather than once per packet. Protocols may also defer
+    work until the end of the batch, allowing them to merge segments.
+
+Arguments:
+
+    Link - Supplies a pointer to the link that received the packets.
+
+    PacketList - Supplies a pointer to the list of received packets. Each
+        packet may be used as a scratch space while this routine executes.
+        If a packet has the exchangeable flag set, then the networking core
+        may keep the packet's data and swap in a fresh buffer of equal or
+        greater size, in which case the buffer, I/O buffer, and physical
+        address of the packet will have changed when this routine returns. The
+        packet structures themselves always remain on the list.
+
+Return Value:
+
+    None. When the function returns, the packet buffers on the list may be
+    reclaimed and reused by the driver.
+
+--*/
+
+{
+
+    NET_RECEIVE_BATCH Batch;
+    PNET_PROTOCOL_FLUSH_RECEIVED_DATA FlushReceivedData;
+    ULONG Index;
+    PNET_PACKET_BUFFER Packet;
+    PNET_RECEIVE_BATCH PreviousBatch;
+    NET_PACKET_LIST ProcessedList;
+    PNET_SOCKET Socket;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    //
+    // Claim the link's receive batch slot. If another thread is already
+    // processing a batch on this link, just run without deferring wakeups.
+    //
+
+    Batch.Thread = KeGetCurrentThread();
+    Batch.SocketCount = 0;
+    PreviousBatch = (PNET_RECEIVE_BATCH)RtlAtomicCompareExchange(
+                                        (volatile UINTN *)&(Link->ReceiveBatch),
+                                        (UINTN)&Batch,
+                                        (UINTN)NULL);
+
+    //
+    // Pull each packet off the list while it travels up the stack so that it
+    // looks exactly like a packet passed in individually.
+    //
+
+    NET_INITIALIZE_PACKET_LIST(&ProcessedList);
+    while (NET_PACKET_LIST_EMPTY(PacketList) == FALSE) {
+        Packet = LIST_VALUE(PacketList->Head.Next,
+                            NET_PACKET_BUFFER,
+                            ListEntry);
+
+        NET_REMOVE_PACKET_FROM_LIST(Packet, PacketList);
+        Link->DataLinkEntry->Interface.ProcessReceivedPacket(
+                                                         Link->DataLinkContext,
+                                                         Packet);
+
+        Packet->Flags &= ~NET_PACKET_FLAG_EXCHANGEABLE;
+        NET_ADD_PACKET_TO_LIST(Packet, &ProcessedList);
+    }
+
+    NET_APPEND_PACKET_LIST(&ProcessedList, PacketList);
+    if (PreviousBatch != NULL) {
+        return;
+    }
+
+    //
+    // Let protocols finish any work they held back during the batch. This is
+    // done while the batch is still owned so that any wakeups the flush
+    // generates are coalesced too. A flush may add sockets to the batch, but
+    // it may not request another flush.
+    //
+
+    for (Index = 0; Index < Batch.SocketCount; Index += 1) {
+        if (Batch.Flush[Index] != FALSE) {
+            Socket = Batch.Sockets[Index];
+            Batch.Flush[Index] = FALSE;
+            FlushReceivedData = Socket->Protocol->Interface.FlushReceivedData;
+
+            ASSERT(FlushReceivedData != NULL);
+
+            FlushReceivedData(Socket);
+        }
+    }
+
+    //
+    // Release the batch slot before delivering the coalesced wakeups so that
+    // no new events get queued behind this thread's back.
+    //
+
+    RtlAtomicExchange((volatile UINTN *)&(Link->ReceiveBatch), (UINTN)NULL);
+    for (Index = 0; Index < Batch.SocketCount; Index += 1) {
+        Socket = Batch.Sockets[Index];
+        if (Batch.Events[Index] != 0) {
+            IoSetIoObjectState(Socket->KernelSocket.IoState,
+                               Batch.Events[Index],
+                               TRUE);
+        }
+
+        IoSocketReleaseReference(&(Socket->KernelSocket));
+    }
+
+    return;
+}
+
+NET_API
+VOID
+NetSetSocketReceiveEvents (
+    PNET_LINK Link,
+    PNET_SOCKET Socket,
+    ULONG Events
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the given poll events on a socket in response to
+    received data. If the link is in the middle of processing a batch of
+    received packets on the current thread, the events are coalesced and set
+    once when the batch completes. Otherwise they are set immediately.
+
+Arguments:
+
+    Link - Supplies an optional pointer to the link that received the data.
+
+    Socket - Supplies a pointer to the socket to signal.
+
+    Events - Supplies the mask of poll events to set.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_RECEIVE_BATCH Batch;
+    ULONG Index;
+
+    Batch = NULL;
+    if (Link != NULL) {
+        Batch = Link->ReceiveBatch;
+    }
+
+    //
+    // Only the thread processing the batch may touch it. Everyone else
+    // signals directly.
+    //
+
+    if ((Batch == NULL) || (Batch->Thread != KeGetCurrentThread())) {
+        IoSetIoObjectState(Socket->KernelSocket.IoState, Events, TRUE);
+        return;
+    }
+
+    for (Index = 0; Index < Batch->SocketCount; Index += 1) {
+        if (Batch->Sockets[Index] == Socket) {
+            Batch->Events[Index] |= Events;
+            return;
+        }
+    }
+
+    if (Batch->SocketCount == NET_RECEIVE_BATCH_SOCKET_COUNT) {
+        IoSetIoObjectState(Socket->KernelSocket.IoState, Events, TRUE);
+        return;
+    }
+
+    IoSocketAddReference(&(Socket->KernelSocket));
+    Batch->Sockets[Batch->SocketCount] = Socket;
+    Batch->Events[Batch->SocketCount] = Events;
+    Batch->Flush[Batch->SocketCount] = FALSE;
+    Batch->SocketCount += 1;
+    return;
+}
+
+NET_API
+BOOL
+NetDeferSocketReceiveFlush (
+    PNET_LINK Link,
+    PNET_SOCKET Socket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine requests that the socket's protocol flush routine be called
+    once the link finishes processing the current batch of received packets.
+    This allows a protocol to hold back and merge work across the packets of a
+    batch.
+
+Arguments:
+
+    Link - Supplies a pointer to the link that received the data.
+
+    Socket - Supplies a pointer to the socket to flush. A reference is taken on
+        the socket until the flush completes.
+
+Return Value:
+
+    TRUE if the flush routine will be called at the end of the batch.
+
+    FALSE if the calling thread is not processing a receive batch on the link
+    or the batch is full. The caller must not defer any work in this case.
+
+--*/
+
+{
+
+    PNET_RECEIVE_BATCH Batch;
+    ULONG Index;
+
+    if (Socket->Protocol->Interface.FlushReceivedData == NULL) {
+        return FALSE;
+    }
+
+    Batch = Link->ReceiveBatch;
+    if ((Batch == NULL) || (Batch->Thread != KeGetCurrentThread())) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Batch->SocketCount; Index += 1) {
+        if (Batch->Sockets[Index] == Socket) {
+            Batch->Flush[Index] = TRUE;
+            return TRUE;
+        }
+    }
+
+    if (Batch->SocketCount == NET_RECEIVE_BATCH_SOCKET_COUNT) {
+        return FALSE;
+    }
+
+    IoSocketAddReference(&(Socket->KernelSocket));
+    Batch->Sockets[Batch->SocketCount] = Socket;
+    Batch->Events[Batch->SocketCount] = 0;
+    Batch->Flush[Batch->SocketCount] = TRUE;
+    Batch->SocketCount += 1;
+    return TRUE;
+}
+
 NET_API
 BOOL
 NetGetGlobalDebugFlag (
@@ -1714,6 +1982,16 @@ Return Value:
     }
 
     Status = NetSocket->Protocol->Interface.Listen(NetSocket);
+
+    //
+    // Mark the socket as listening so that incoming connections to a port
+    // shared via exact address reuse only get spread across listeners.
+    //
+
+    if (KSUCCESS(Status)) {
+        RtlAtomicOr32(&(NetSocket->Flags), NET_SOCKET_FLAG_LISTENING);
+    }
+
     if (NetGlobalDebug != FALSE) {
         RtlDebugPrint("Net: Socket 0x%x listen %d: %d\n",
                       NetSocket,
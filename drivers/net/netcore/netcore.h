@@ -52,10 +52,52 @@ Module Name:
 
 #define NET_PRINT_ADDRESS_STRING_LENGTH 200
 
+//
+// Define the maximum number of distinct sockets whose wakeups or flushes can
+// be deferred during a single receive batch. Sockets beyond this are handled
+// immediately.
+//
+
+#define NET_RECEIVE_BATCH_SOCKET_COUNT 16
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines a batch of received packets being processed by the
+    networking core on behalf of a link.
+
+Members:
+
+    Thread - Stores a pointer to the thread processing the batch. Only socket
+        events raised on this thread are deferred.
+
+    SocketCount - Stores the number of valid entries in the socket, events,
+        and flush arrays.
+
+    Sockets - Stores an array of referenced sockets awaiting a wakeup or flush
+        at the end of the batch.
+
+    Events - Stores an array of poll events to set on each socket at the end of
+        the batch.
+
+    Flush - Stores an array of booleans indicating whether or not each socket's
+        protocol flush routine should be called at the end of the batch.
+
+--*/
+
+struct _NET_RECEIVE_BATCH {
+    PKTHREAD Thread;
+    ULONG SocketCount;
+    PNET_SOCKET Sockets[NET_RECEIVE_BATCH_SOCKET_COUNT];
+    ULONG Events[NET_RECEIVE_BATCH_SOCKET_COUNT];
+    BOOL Flush[NET_RECEIVE_BATCH_SOCKET_COUNT];
+};
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -472,6 +514,28 @@ Return Value:
 
 --*/
 
+VOID
+NetpLoopbackInitialize (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes support for loopback links, and reports the root
+    device that the loopback driver attaches to.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
 //
 // Prototypes to entry points for built in components.
 //
@@ -375,7 +375,8 @@ NET_PROTOCOL_ENTRY NetlinkGenericProtocol = {
         NetlinkpGenericProcessReceivedSocketData,
         NetlinkpGenericReceive,
         NetlinkpGenericGetSetInformation,
-        NetlinkpGenericUserControl
+        NetlinkpGenericUserControl,
+        NULL
     }
 };
 
@@ -329,7 +329,8 @@ NET_PROTOCOL_ENTRY NetRawProtocol = {
         NetpRawProcessReceivedSocketData,
         NetpRawReceive,
         NetpRawGetSetInformation,
-        NetpRawUserControl
+        NetpRawUserControl,
+        NULL
     }
 };
 
@@ -161,6 +161,11 @@ NetpTcpProcessReceivedSocketData (
     PNET_RECEIVE_CONTEXT ReceiveContext
     );
 
+VOID
+NetpTcpFlushReceivedData (
+    PNET_SOCKET Socket
+    );
+
 KSTATUS
 NetpTcpReceive (
     BOOL FromKernelMode,
@@ -200,6 +205,18 @@ NetpTcpProcessPacket (
     PTCP_HEADER Header
     );
 
+BOOL
+NetpTcpCoalesceReceivedPacket (
+    PTCP_SOCKET Socket,
+    PNET_RECEIVE_CONTEXT ReceiveContext,
+    PTCP_HEADER Header
+    );
+
+VOID
+NetpTcpFlushCoalescedPacket (
+    PTCP_SOCKET Socket
+    );
+
 VOID
 NetpTcpHandleUnconnectedPacket (
     PNET_RECEIVE_CONTEXT ReceiveContext,
@@ -293,6 +310,14 @@ NetpTcpCreatePacket (
     PTCP_SEND_SEGMENT Segment
     );
 
+PNET_PACKET_BUFFER
+NetpTcpCreateSegmentationPacket (
+    PTCP_SOCKET Socket,
+    PTCP_SEND_SEGMENT FirstSegment,
+    ULONG WindowEnd,
+    PTCP_SEND_SEGMENT *LastSegment
+    );
+
 VOID
 NetpTcpFreeSentSegments (
     PTCP_SOCKET Socket,
@@ -327,6 +352,13 @@ NetpTcpCloseOutSocket (
     BOOL InsideWorker
     );
 
+KSTATUS
+NetpTcpWaitForIncomingConnection (
+    PTCP_SOCKET TcpSocket,
+    ULONG Timeout,
+    PULONG ReturnedEvents
+    );
+
 VOID
 NetpTcpHandleIncomingConnection (
     PTCP_SOCKET ListeningSocket,
@@ -450,7 +482,8 @@ NET_PROTOCOL_ENTRY NetTcpProtocol = {
         NetpTcpProcessReceivedSocketData,
         NetpTcpReceive,
         NetpTcpGetSetInformation,
-        NetpTcpUserControl
+        NetpTcpUserControl,
+        NetpTcpFlushReceivedData
     }
 };
 
@@ -906,6 +939,16 @@ Return Value:
     ASSERT(LIST_EMPTY(&(TcpSocket->OutgoingSegmentList)) != FALSE);
     ASSERT(TcpSocket->TimerReferenceCount == 0);
 
+    if (TcpSocket->CoalescePacket != NULL) {
+        NetFreeBuffer(TcpSocket->CoalescePacket);
+        TcpSocket->CoalescePacket = NULL;
+    }
+
+    if (TcpSocket->AcceptEvent != NULL) {
+        KeDestroyEvent(TcpSocket->AcceptEvent);
+        TcpSocket->AcceptEvent = NULL;
+    }
+
     if (Socket->Network->Interface.DestroySocket != NULL) {
         Socket->Network->Interface.DestroySocket(Socket);
     }
@@ -1011,6 +1054,14 @@ Return Value:
             goto TcpListenEnd;
         }
 
+        if (TcpSocket->AcceptEvent == NULL) {
+            TcpSocket->AcceptEvent = KeCreateEvent(NULL);
+            if (TcpSocket->AcceptEvent == NULL) {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                goto TcpListenEnd;
+            }
+        }
+
         NetpTcpSetState(TcpSocket, TcpStateListening);
 
         //
@@ -1105,11 +1156,24 @@ Return Value:
         //
 
         while (TRUE) {
-            Status = IoWaitForIoObjectState(IoState,
-                                            POLL_EVENT_IN,
-                                            TRUE,
-                                            Timeout,
-                                            &ReturnedEvents);
+
+            //
+            // Blocking accepts wait on the accept event, which wakes only one
+            // of them per incoming connection.
+            //
+
+            if ((Timeout != 0) && (TcpSocket->AcceptEvent != NULL)) {
+                Status = NetpTcpWaitForIncomingConnection(TcpSocket,
+                                                          Timeout,
+                                                          &ReturnedEvents);
+
+            } else {
+                Status = IoWaitForIoObjectState(IoState,
+                                                POLL_EVENT_IN,
+                                                TRUE,
+                                                Timeout,
+                                                &ReturnedEvents);
+            }
 
             if (!KSUCCESS(Status)) {
                 if (Status == STATUS_TIMEOUT) {
@@ -1134,7 +1198,9 @@ Return Value:
             }
 
             KeAcquireQueuedLock(TcpSocket->Lock);
-            if ((TcpSocket->ShutdownTypes & SOCKET_SHUTDOWN_READ) != 0) {
+            if (((TcpSocket->ShutdownTypes & SOCKET_SHUTDOWN_READ) != 0) ||
+                (TcpSocket->State != TcpStateListening)) {
+
                 KeReleaseQueuedLock(TcpSocket->Lock);
                 Status = STATUS_CONNECTION_CLOSED;
                 goto TcpAcceptEnd;
@@ -1165,6 +1231,16 @@ Return Value:
                        FALSE);
 
                 IoSetIoObjectState(IoState, POLL_EVENT_IN, FALSE);
+
+            //
+            // Only one accepter was woken for the connection just taken. If
+            // more are queued, pass the wake along to the next one.
+            //
+
+            } else if ((IncomingConnection != NULL) &&
+                       (TcpSocket->AcceptEvent != NULL)) {
+
+                KeSignalEvent(TcpSocket->AcceptEvent, SignalOptionSignalOne);
             }
 
             KeReleaseQueuedLock(TcpSocket->Lock);
@@ -2340,7 +2416,17 @@ Return Value:
                       Length - HeaderLength);
     }
 
-    NetpTcpProcessPacket(TcpSocket, ReceiveContext, Header);
+    //
+    // Plain in-order data may be held back and merged with the rest of the
+    // receive batch. Everything else is processed immediately.
+    //
+
+    if (NetpTcpCoalesceReceivedPacket(TcpSocket, ReceiveContext, Header) ==
+        FALSE) {
+
+        NetpTcpProcessPacket(TcpSocket, ReceiveContext, Header);
+    }
+
     KeReleaseQueuedLock(TcpSocket->Lock);
 
     //
@@ -2390,6 +2476,39 @@ Return Value:
     return STATUS_NOT_SUPPORTED;
 }
 
+VOID
+NetpTcpFlushReceivedData (
+    PNET_SOCKET Socket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called at the end of a batch of received packets to
+    process any data segments the socket merged during the batch.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket to flush.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTCP_SOCKET TcpSocket;
+
+    TcpSocket = (PTCP_SOCKET)Socket;
+    KeAcquireQueuedLock(TcpSocket->Lock);
+    NetpTcpFlushCoalescedPacket(TcpSocket);
+    KeReleaseQueuedLock(TcpSocket->Lock);
+    return;
+}
+
 KSTATUS
 NetpTcpReceive (
     BOOL FromKernelMode,
@@ -4618,6 +4737,189 @@ Return Value:
     return;
 }
 
+BOOL
+NetpTcpCoalesceReceivedPacket (
+    PTCP_SOCKET Socket,
+    PNET_RECEIVE_CONTEXT ReceiveContext,
+    PTCP_HEADER Header
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to merge the given received packet with the other
+    in-order data segments of the current receive batch, deferring its
+    processing until the end of the batch. If the packet cannot be merged, any
+    previously merged data is processed first so that ordering is maintained.
+    This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the TCP socket.
+
+    ReceiveContext - Supplies a pointer to the receive context that stores the
+        link, packet, network, protocol, and source and destination addresses.
+        The packet's data offset should point past the TCP header.
+
+    Header - Supplies a pointer to the TCP header.
+
+Return Value:
+
+    TRUE if the packet was merged and requires no further processing.
+
+    FALSE if the caller should process the packet now.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Coalesce;
+    PTCP_HEADER CoalesceHeader;
+    ULONG CoalesceLength;
+    ULONG CoalesceSequence;
+    PVOID Data;
+    BOOL Eligible;
+    ULONG HeaderLength;
+    ULONG Length;
+    PNET_PACKET_BUFFER Packet;
+    KSTATUS Status;
+
+    Packet = ReceiveContext->Packet;
+    Data = Packet->Buffer + Packet->DataOffset;
+    Length = Packet->FooterOffset - Packet->DataOffset;
+    HeaderLength = ((Header->HeaderLength & TCP_HEADER_LENGTH_MASK) >>
+                    TCP_HEADER_LENGTH_SHIFT) * sizeof(ULONG);
+
+    //
+    // Only plain data segments on an established connection are merged.
+    // Anything with options or control flags is processed on its own, as is
+    // anything already too large to merge (from a link that does not split
+    // up segmentation offload packets, for example).
+    //
+
+    Eligible = FALSE;
+    if ((Socket->State == TcpStateEstablished) &&
+        (HeaderLength == sizeof(TCP_HEADER)) &&
+        ((Header->Flags & ~TCP_HEADER_FLAG_PUSH) ==
+         TCP_HEADER_FLAG_ACKNOWLEDGE) &&
+        (Length != 0) &&
+        (Length <= TCP_MAX_COALESCE_SIZE)) {
+
+        Eligible = TRUE;
+    }
+
+    //
+    // Append to the pending packet if this segment picks up exactly where it
+    // left off and carries the same acknowledgment and window.
+    //
+
+    Coalesce = Socket->CoalescePacket;
+    if (Coalesce != NULL) {
+        if (Eligible != FALSE) {
+            CoalesceHeader = (PTCP_HEADER)(Coalesce->Buffer);
+            CoalesceLength = Coalesce->FooterOffset - Coalesce->DataOffset;
+            CoalesceSequence = NETWORK_TO_CPU32(CoalesceHeader->SequenceNumber);
+            if (((CoalesceHeader->Flags & TCP_HEADER_FLAG_PUSH) == 0) &&
+                (NETWORK_TO_CPU32(Header->SequenceNumber) ==
+                 CoalesceSequence + CoalesceLength) &&
+                (Header->AcknowledgmentNumber ==
+                 CoalesceHeader->AcknowledgmentNumber) &&
+                (Header->WindowSize == CoalesceHeader->WindowSize) &&
+                ((CoalesceLength + Length) <= TCP_MAX_COALESCE_SIZE)) {
+
+                RtlCopyMemory(Coalesce->Buffer + Coalesce->FooterOffset,
+                              Data,
+                              Length);
+
+                Coalesce->FooterOffset += Length;
+                CoalesceHeader->Flags |= Header->Flags;
+                return TRUE;
+            }
+        }
+
+        NetpTcpFlushCoalescedPacket(Socket);
+    }
+
+    if (Eligible == FALSE) {
+        return FALSE;
+    }
+
+    //
+    // Start a new pending packet, but only if the end of the batch will come
+    // back around to process it.
+    //
+
+    if (NetDeferSocketReceiveFlush(ReceiveContext->Link,
+                                   &(Socket->NetSocket)) == FALSE) {
+
+        return FALSE;
+    }
+
+    Status = NetAllocateBuffer(0,
+                               sizeof(TCP_HEADER) + TCP_MAX_COALESCE_SIZE,
+                               0,
+                               NULL,
+                               0,
+                               &Coalesce);
+
+    if (!KSUCCESS(Status)) {
+        return FALSE;
+    }
+
+    RtlCopyMemory(Coalesce->Buffer, Header, sizeof(TCP_HEADER));
+    RtlCopyMemory(Coalesce->Buffer + sizeof(TCP_HEADER), Data, Length);
+    Coalesce->DataOffset = sizeof(TCP_HEADER);
+    Coalesce->FooterOffset = Coalesce->DataOffset + Length;
+    Socket->CoalescePacket = Coalesce;
+    return TRUE;
+}
+
+VOID
+NetpTcpFlushCoalescedPacket (
+    PTCP_SOCKET Socket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes any merged data segments pending on the socket.
+    This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the TCP socket.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Packet;
+    NET_RECEIVE_CONTEXT ReceiveContext;
+
+    Packet = Socket->CoalescePacket;
+    if (Packet == NULL) {
+        return;
+    }
+
+    Socket->CoalescePacket = NULL;
+    RtlZeroMemory(&ReceiveContext, sizeof(NET_RECEIVE_CONTEXT));
+    ReceiveContext.Packet = Packet;
+    ReceiveContext.Link = Socket->NetSocket.Link;
+    ReceiveContext.Network = Socket->NetSocket.Network;
+    ReceiveContext.Protocol = Socket->NetSocket.Protocol;
+    ReceiveContext.Source = &(Socket->NetSocket.RemoteAddress);
+    ReceiveContext.Destination = &(Socket->NetSocket.LocalReceiveAddress);
+    NetpTcpProcessPacket(Socket, &ReceiveContext, (PTCP_HEADER)Packet->Buffer);
+    NetFreeBuffer(Packet);
+    return;
+}
+
 VOID
 NetpTcpHandleUnconnectedPacket (
     PNET_RECEIVE_CONTEXT ReceiveContext,
@@ -5939,6 +6241,27 @@ Return Value:
         return;
     }
 
+    //
+    // Received segments are stored in allocations sized for the maximum
+    // segment size. Feed merged segments through in pieces no larger than
+    // that.
+    //
+
+    while (Length > Socket->ReceiveMaxSegmentSize) {
+        NetpTcpProcessReceivedDataSegment(Socket,
+                                          SequenceNumber,
+                                          Buffer,
+                                          Socket->ReceiveMaxSegmentSize,
+                                          Header);
+
+        SequenceNumber += Socket->ReceiveMaxSegmentSize;
+        Buffer += Socket->ReceiveMaxSegmentSize;
+        Length -= Socket->ReceiveMaxSegmentSize;
+        if (Socket->ReceiveWindowFreeSize == 0) {
+            return;
+        }
+    }
+
     if (NetTcpDebugPrintSequenceNumbers != FALSE) {
         NetpTcpPrintSocketEndpoints(Socket, FALSE);
         RtlDebugPrint(" RX Segment %d size %d.\n",
@@ -6120,7 +6443,9 @@ Return Value:
                              Socket->ReceiveWindowFreeSize;
 
             if (AvailableBytes >= Socket->ReceiveMinimum) {
-                IoSetIoObjectState(IoState, POLL_EVENT_IN, TRUE);
+                NetSetSocketReceiveEvents(Socket->NetSocket.Link,
+                                          &(Socket->NetSocket),
+                                          POLL_EVENT_IN);
             }
 
             Socket->ReceiveNextSequence = NextSequence;
@@ -6605,6 +6930,7 @@ Return Value:
 
 {
 
+    ULONG Capabilities;
     PLIST_ENTRY CurrentEntry;
     PTCP_SEND_SEGMENT FirstSegment;
     PULONG Flags;
@@ -6613,8 +6939,10 @@ Return Value:
     ULONGLONG LocalCurrentTime;
     PNET_PACKET_BUFFER Packet;
     NET_PACKET_LIST PacketList;
+    PTCP_SEND_SEGMENT RunEnd;
     PTCP_SEND_SEGMENT Segment;
     ULONG SegmentBegin;
+    BOOL Segmentation;
     KSTATUS Status;
     ULONG WindowBegin;
     ULONG WindowEnd;
@@ -6678,6 +7006,21 @@ Return Value:
     WindowBegin = Socket->SendWindowUpdateAcknowledge;
     WindowEnd = WindowBegin + WindowSize;
 
+    //
+    // If the link can split large packets into segments itself (and can
+    // therefore checksum them too), hand it runs of new segments as single
+    // packets.
+    //
+
+    Segmentation = FALSE;
+    Capabilities = Socket->NetSocket.Link->Properties.Capabilities;
+    if (((Capabilities & NET_LINK_CAPABILITY_TCP_SEGMENTATION_OFFLOAD) != 0) &&
+        ((Capabilities &
+          NET_LINK_CAPABILITY_TRANSMIT_TCP_CHECKSUM_OFFLOAD) != 0)) {
+
+        Segmentation = TRUE;
+    }
+
     //
     // Loop adding as many segments as possible to the packets list.
     //
@@ -6731,7 +7074,17 @@ Return Value:
 
             ASSERT(Segment->Offset == 0);
 
-            Packet = NetpTcpCreatePacket(Socket, Segment);
+            if (Segmentation != FALSE) {
+                Packet = NetpTcpCreateSegmentationPacket(Socket,
+                                                         Segment,
+                                                         WindowEnd,
+                                                         &RunEnd);
+
+            } else {
+                Packet = NetpTcpCreatePacket(Socket, Segment);
+                RunEnd = Segment;
+            }
+
             if (Packet == NULL) {
                 break;
             }
@@ -6741,27 +7094,38 @@ Return Value:
                 FirstSegment = Segment;
             }
 
-            LastSegment = Segment;
+            LastSegment = RunEnd;
+            CurrentEntry = RunEnd->Header.ListEntry.Next;
 
             //
-            // Update the next pointer and record the send time.
+            // Update the next pointer and record the send time for every
+            // segment that went into the packet.
             //
 
-            Socket->SendNextNetworkSequence = Segment->SequenceNumber +
-                                              Segment->Length;
+            while (TRUE) {
+                Socket->SendNextNetworkSequence = Segment->SequenceNumber +
+                                                  Segment->Length;
 
-            if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_FIN) != 0) {
-                Socket->SendNextNetworkSequence += 1;
-                if (Socket->State == TcpStateCloseWait) {
-                    NetpTcpSetState(Socket, TcpStateLastAcknowledge);
+                if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_FIN) != 0) {
+                    Socket->SendNextNetworkSequence += 1;
+                    if (Socket->State == TcpStateCloseWait) {
+                        NetpTcpSetState(Socket, TcpStateLastAcknowledge);
 
-                } else {
-                    NetpTcpSetState(Socket, TcpStateFinWait1);
+                    } else {
+                        NetpTcpSetState(Socket, TcpStateFinWait1);
+                    }
                 }
-            }
 
-            NetpTcpGetTransmitTimeoutInterval(Socket, Segment);
-            Segment->SendAttemptCount += 1;
+                NetpTcpGetTransmitTimeoutInterval(Socket, Segment);
+                Segment->SendAttemptCount += 1;
+                if (Segment == RunEnd) {
+                    break;
+                }
+
+                Segment = LIST_VALUE(Segment->Header.ListEntry.Next,
+                                     TCP_SEND_SEGMENT,
+                                     Header.ListEntry);
+            }
 
         //
         // This segment has been sent before. Check to see if enough
@@ -7034,6 +7398,150 @@ Return Value:
     return Packet;
 }
 
+PNET_PACKET_BUFFER
+NetpTcpCreateSegmentationPacket (
+    PTCP_SOCKET Socket,
+    PTCP_SEND_SEGMENT FirstSegment,
+    ULONG WindowEnd,
+    PTCP_SEND_SEGMENT *LastSegment
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a single network packet covering a run of unsent,
+    contiguous segments starting with the given segment. The link is expected
+    to split the packet into maximum segment size pieces on the way out.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket involved.
+
+    FirstSegment - Supplies a pointer to the first segment of the run. It must
+        not have been sent before and must be within the send window.
+
+    WindowEnd - Supplies the sequence number of the end of the send window.
+
+    LastSegment - Supplies a pointer where a pointer to the last segment
+        included in the packet will be returned.
+
+Return Value:
+
+    Returns a pointer to the newly allocated packet buffer on success, or NULL
+    on failure.
+
+--*/
+
+{
+
+    PVOID Data;
+    ULONG ExcludedFlags;
+    USHORT HeaderFlags;
+    ULONG Length;
+    PLIST_ENTRY NextEntry;
+    PTCP_SEND_SEGMENT NextSegment;
+    PNET_PACKET_BUFFER Packet;
+    PTCP_SEND_SEGMENT Segment;
+    PNET_PACKET_SIZE_INFORMATION SizeInformation;
+    KSTATUS Status;
+
+    ASSERT(FirstSegment->SendAttemptCount == 0);
+
+    //
+    // Control flags other than push cannot be repeated on every piece, so
+    // segments carrying them are sent on their own.
+    //
+
+    ExcludedFlags = TCP_SEND_SEGMENT_HEADER_FLAG_MASK &
+                    ~(TCP_SEND_SEGMENT_FLAG_PUSH |
+                      TCP_SEND_SEGMENT_FLAG_ACKNOWLEDGE);
+
+    *LastSegment = FirstSegment;
+    if ((FirstSegment->Flags & ExcludedFlags) != 0) {
+        return NetpTcpCreatePacket(Socket, FirstSegment);
+    }
+
+    //
+    // Gather up as many following segments as possible.
+    //
+
+    Segment = FirstSegment;
+    Length = Segment->Length;
+    HeaderFlags = Segment->Flags & TCP_SEND_SEGMENT_HEADER_FLAG_MASK;
+    NextEntry = Segment->Header.ListEntry.Next;
+    while (NextEntry != &(Socket->OutgoingSegmentList)) {
+        NextSegment = LIST_VALUE(NextEntry, TCP_SEND_SEGMENT, Header.ListEntry);
+        if ((NextSegment->SendAttemptCount != 0) ||
+            ((NextSegment->Flags & ExcludedFlags) != 0) ||
+            (NextSegment->SequenceNumber !=
+             Segment->SequenceNumber + Segment->Length) ||
+            (!TCP_SEQUENCE_LESS_THAN(NextSegment->SequenceNumber,
+                                     WindowEnd)) ||
+            ((Length + NextSegment->Length) >
+             TCP_MAX_SEGMENTATION_OFFLOAD_SIZE)) {
+
+            break;
+        }
+
+        Length += NextSegment->Length;
+        HeaderFlags |= NextSegment->Flags & TCP_SEND_SEGMENT_HEADER_FLAG_MASK;
+        Segment = NextSegment;
+        NextEntry = NextEntry->Next;
+    }
+
+    if (Segment == FirstSegment) {
+        return NetpTcpCreatePacket(Socket, FirstSegment);
+    }
+
+    SizeInformation = &(Socket->NetSocket.PacketSizeInformation);
+    Status = NetAllocateBuffer(SizeInformation->HeaderSize,
+                               Length,
+                               SizeInformation->FooterSize,
+                               Socket->NetSocket.Link,
+                               0,
+                               &Packet);
+
+    if (!KSUCCESS(Status)) {
+        return NULL;
+    }
+
+    *LastSegment = Segment;
+
+    //
+    // Copy the data from each segment in the run.
+    //
+
+    Data = Packet->Buffer + Packet->DataOffset;
+    Segment = FirstSegment;
+    while (TRUE) {
+        RtlCopyMemory(Data, Segment + 1, Segment->Length);
+        Data += Segment->Length;
+        if (Segment == *LastSegment) {
+            break;
+        }
+
+        Segment = LIST_VALUE(Segment->Header.ListEntry.Next,
+                             TCP_SEND_SEGMENT,
+                             Header.ListEntry);
+    }
+
+    ASSERT(Packet->DataOffset >= sizeof(TCP_HEADER));
+
+    Packet->DataOffset -= sizeof(TCP_HEADER);
+    NetpTcpFillOutHeader(Socket,
+                         Packet,
+                         FirstSegment->SequenceNumber,
+                         HeaderFlags,
+                         0,
+                         0,
+                         Length);
+
+    Packet->Flags |= NET_PACKET_FLAG_SEGMENTATION_OFFLOAD;
+    Packet->SegmentSize = Socket->SendMaxSegmentSize;
+    return Packet;
+}
+
 VOID
 NetpTcpFreeSentSegments (
     PTCP_SOCKET Socket,
@@ -7911,6 +8419,10 @@ Return Value:
 
     IoState = ListeningSocket->NetSocket.KernelSocket.IoState;
     IoSetIoObjectState(IoState, POLL_EVENT_IN, TRUE);
+    if (ListeningSocket->AcceptEvent != NULL) {
+        KeSignalEvent(ListeningSocket->AcceptEvent, SignalOptionSignalOne);
+    }
+
     Status = STATUS_SUCCESS;
 
 TcpHandleIncomingConnectionEnd:
@@ -7949,6 +8461,76 @@ Return Value:
     return;
 }
 
+KSTATUS
+NetpTcpWaitForIncomingConnection (
+    PTCP_SOCKET TcpSocket,
+    ULONG Timeout,
+    PULONG ReturnedEvents
+    )
+
+/*++
+
+Routine Description:
+
+    This routine blocks an accept call on a listening socket until either an
+    incoming connection is queued for it or an error occurs on the socket.
+
+Arguments:
+
+    TcpSocket - Supplies a pointer to the listening socket.
+
+    Timeout - Supplies the number of milliseconds to wait.
+
+    ReturnedEvents - Supplies a pointer where the poll events signaled on the
+        socket are returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_OBJECT_STATE IoState;
+    KSTATUS Status;
+    PVOID WaitObjectArray[2];
+
+    ASSERT(2 < BUILTIN_WAIT_BLOCK_ENTRY_COUNT);
+
+    *ReturnedEvents = 0;
+    IoState = TcpSocket->NetSocket.KernelSocket.IoState;
+    WaitObjectArray[0] = IoState->ErrorEvent;
+    WaitObjectArray[1] = TcpSocket->AcceptEvent;
+    Status = ObWaitOnObjects(WaitObjectArray,
+                             2,
+                             WAIT_FLAG_INTERRUPTIBLE,
+                             Timeout,
+                             NULL,
+                             NULL);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // The wait may have consumed the wake for a queued connection. Hand
+        // it to another accepter so the connection is not stranded.
+        //
+
+        KeAcquireQueuedLock(TcpSocket->Lock);
+        if (TcpSocket->IncomingConnectionCount != 0) {
+            KeSignalEvent(TcpSocket->AcceptEvent, SignalOptionSignalOne);
+        }
+
+        KeReleaseQueuedLock(TcpSocket->Lock);
+        return Status;
+    }
+
+    *ReturnedEvents = IoState->Events & (POLL_EVENT_IN |
+                                         POLL_NONMASKABLE_EVENTS);
+
+    return STATUS_SUCCESS;
+}
+
 VOID
 NetpTcpSetState (
     PTCP_SOCKET Socket,
@@ -7985,6 +8567,14 @@ Return Value:
     Socket->PreviousState = OldState;
     Socket->State = NewState;
 
+    //
+    // Release every blocked accept call if the socket stops listening.
+    //
+
+    if ((OldState == TcpStateListening) && (Socket->AcceptEvent != NULL)) {
+        KeSignalEvent(Socket->AcceptEvent, SignalOptionSignalAll);
+    }
+
     //
     // Modify the socket based on the new state.
     //
@@ -228,6 +228,21 @@ Module Name:
 
 #define TCP_RETRANSMIT_COUNT 10
 
+//
+// Define the maximum amount of data TCP places in a single packet handed to a
+// link that supports segmentation offload. This keeps the IP total length
+// within 16 bits with plenty of room for headers.
+//
+
+#define TCP_MAX_SEGMENTATION_OFFLOAD_SIZE (60 * _1KB)
+
+//
+// Define the maximum amount of in-order data TCP merges from the segments of
+// a receive batch before processing them as a single segment.
+//
+
+#define TCP_MAX_COALESCE_SIZE (32 * _1KB)
+
 //
 // Define the time, in seconds, to wait after a connection goes idle before
 // sending the first keep alive probe.
@@ -537,6 +552,11 @@ Structure Description:
     IncomingConnectionCount - Stores the number of elements that are on the
         incoming connection list.
 
+    AcceptEvent - Stores an optional pointer to the event blocking accept
+        calls wait on. It is signaled for one waiter per incoming connection
+        so that a new connection does not wake every accepting thread. This
+        is created when the socket starts listening.
+
     SlowStartThreshold - Stores the threshold value for the congestion window.
         If the congestion window size is less than or equal to this value, then
         Slow Start is used. Otherwise, Congestion Avoidance is used.
@@ -600,6 +620,11 @@ Structure Description:
     SegmentAllocationSize - Stores the allocation size for each of the send and
         receive TCP segments, including enough size for the header and data.
 
+    CoalescePacket - Stores an optional pointer to a packet holding in-order
+        data segments received during the current receive batch that have not
+        yet been processed. The packet begins with the TCP header of the first
+        segment, and the data of later segments is appended to it.
+
 --*/
 
 typedef struct _TCP_SOCKET {
@@ -639,6 +664,7 @@ typedef struct _TCP_SOCKET {
     LIST_ENTRY FreeSegmentList;
     LIST_ENTRY IncomingConnectionList;
     ULONG IncomingConnectionCount;
+    PKEVENT AcceptEvent;
     ULONG SlowStartThreshold;
     ULONG CongestionWindowSize;
     ULONG FastRecoveryEndSequence;
@@ -657,6 +683,7 @@ typedef struct _TCP_SOCKET {
     ULONG ShutdownTypes;
     LONG OutOfBandData;
     ULONG SegmentAllocationSize;
+    PNET_PACKET_BUFFER CoalescePacket;
 } TCP_SOCKET, *PTCP_SOCKET;
 
 /*++
@@ -77,6 +77,13 @@ Module Name:
 
 #define UDP_DEFAULT_RECEIVE_MINIMUM 1
 
+//
+// Define the minimum payload size for which UDP will try to keep the device's
+// receive buffer rather than copying the data out of it.
+//
+
+#define UDP_RECEIVE_EXCHANGE_MINIMUM 512
+
 //
 // Define the minmum number of bytes necessary for UDP sockets to become
 // writable. There is no minimum and bytes are immediately sent on the wire.
@@ -186,6 +193,10 @@ Structure Description:
 
     Size - Stores the number of bytes in the data buffer.
 
+    NetPacket - Stores an optional pointer to the network packet the data
+        buffer points into. This is set when the packet was handed off from
+        the device without being copied.
+
 --*/
 
 typedef struct _UDP_RECEIVED_PACKET {
@@ -193,6 +204,7 @@ typedef struct _UDP_RECEIVED_PACKET {
     NETWORK_ADDRESS Address;
     PVOID DataBuffer;
     ULONG Size;
+    PNET_PACKET_BUFFER NetPacket;
 } UDP_RECEIVED_PACKET, *PUDP_RECEIVED_PACKET;
 
 /*++
@@ -294,6 +306,11 @@ NetpUdpProcessReceivedSocketData (
     PNET_RECEIVE_CONTEXT ReceiveContext
     );
 
+VOID
+NetpUdpFreeReceivedPacket (
+    PUDP_RECEIVED_PACKET Packet
+    );
+
 KSTATUS
 NetpUdpReceive (
     BOOL FromKernelMode,
@@ -347,7 +364,8 @@ NET_PROTOCOL_ENTRY NetUdpProtocol = {
         NetpUdpProcessReceivedSocketData,
         NetpUdpReceive,
         NetpUdpGetSetInformation,
-        NetpUdpUserControl
+        NetpUdpUserControl,
+        NULL
     }
 };
 
@@ -622,7 +640,7 @@ Return Value:
 
         LIST_REMOVE(&(Packet->ListEntry));
         UdpSocket->ReceiveBufferFreeSize += Packet->Size;
-        MmFreePagedPool(Packet);
+        NetpUdpFreeReceivedPacket(Packet);
     }
 
     ASSERT(UdpSocket->ReceiveBufferFreeSize ==
@@ -1231,6 +1249,7 @@ Return Value:
 
 {
 
+    ULONG ExchangeFlag;
     PUDP_HEADER Header;
     USHORT Length;
     PNET_PACKET_BUFFER Packet;
@@ -1241,6 +1260,8 @@ Return Value:
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
     Packet = ReceiveContext->Packet;
+    ExchangeFlag = Packet->Flags & NET_PACKET_FLAG_EXCHANGEABLE;
+    Packet->Flags &= ~NET_PACKET_FLAG_EXCHANGEABLE;
     Header = (PUDP_HEADER)(Packet->Buffer + Packet->DataOffset);
     Length = NETWORK_TO_CPU16(Header->Length);
     if (Length > (Packet->FooterOffset - Packet->DataOffset)) {
@@ -1270,9 +1291,14 @@ Return Value:
 
         //
         // Pass the packet onto the socket for copying and safe keeping until
-        // the data is read.
+        // the data is read. Only the last socket may keep the device's buffer
+        // outright, as the others all need to read the same data.
         //
 
+        if (Status == STATUS_SUCCESS) {
+            Packet->Flags |= ExchangeFlag;
+        }
+
         NetpUdpProcessReceivedSocketData(Socket, ReceiveContext);
 
         //
@@ -1324,6 +1350,7 @@ Return Value:
 {
 
     ULONG AllocationSize;
+    PNET_PACKET_BUFFER ClaimedPacket;
     PUDP_HEADER Header;
     USHORT Length;
     PNET_PACKET_BUFFER Packet;
@@ -1334,6 +1361,7 @@ Return Value:
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
 
+    ClaimedPacket = NULL;
     UdpSocket = (PUDP_SOCKET)Socket;
     Packet = ReceiveContext->Packet;
     Header = (PUDP_HEADER)(Packet->Buffer + Packet->DataOffset);
@@ -1360,15 +1388,36 @@ Return Value:
            NETWORK_TO_CPU16(Header->DestinationPort));
 
     //
-    // Create a received packet entry for this data.
+    // For larger datagrams, try to keep the device's buffer rather than
+    // copying the data out of it.
     //
 
     PayloadLength = Length - sizeof(UDP_HEADER);
-    AllocationSize = sizeof(UDP_RECEIVED_PACKET) + PayloadLength;
+    if (PayloadLength >= UDP_RECEIVE_EXCHANGE_MINIMUM) {
+        Status = NetClaimReceivedPacket(ReceiveContext, &ClaimedPacket);
+        if (KSUCCESS(Status)) {
+            Packet = ClaimedPacket;
+            Header = (PUDP_HEADER)(Packet->Buffer + Packet->DataOffset);
+        }
+    }
+
+    //
+    // Create a received packet entry for this data.
+    //
+
+    AllocationSize = sizeof(UDP_RECEIVED_PACKET);
+    if (ClaimedPacket == NULL) {
+        AllocationSize += PayloadLength;
+    }
+
     UdpPacket = MmAllocatePagedPool(AllocationSize,
                                     UDP_PROTOCOL_ALLOCATION_TAG);
 
     if (UdpPacket == NULL) {
+        if (ClaimedPacket != NULL) {
+            NetFreeBuffer(ClaimedPacket);
+        }
+
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto ProcessReceivedSocketDataEnd;
     }
@@ -1377,14 +1426,19 @@ Return Value:
                   ReceiveContext->Source,
                   sizeof(NETWORK_ADDRESS));
 
-    UdpPacket->DataBuffer = (PVOID)(UdpPacket + 1);
     UdpPacket->Size = PayloadLength;
+    UdpPacket->NetPacket = ClaimedPacket;
+    if (ClaimedPacket != NULL) {
+        UdpPacket->DataBuffer = (PVOID)(Header + 1);
 
     //
     // Copy the packet contents into the receive packet buffer.
     //
 
-    RtlCopyMemory(UdpPacket->DataBuffer, Header + 1, PayloadLength);
+    } else {
+        UdpPacket->DataBuffer = (PVOID)(UdpPacket + 1);
+        RtlCopyMemory(UdpPacket->DataBuffer, Header + 1, PayloadLength);
+    }
 
     //
     // Work to insert the packet on the list of received packets.
@@ -1401,10 +1455,11 @@ Return Value:
                UdpSocket->ReceiveBufferTotalSize);
 
         //
-        // One packet is always enough to notify a waiting receiver.
+        // One packet is always enough to notify a waiting receiver. If the
+        // link is processing a batch, the wakeup is deferred to the end of it.
         //
 
-        IoSetIoObjectState(Socket->KernelSocket.IoState, POLL_EVENT_IN, TRUE);
+        NetSetSocketReceiveEvents(ReceiveContext->Link, Socket, POLL_EVENT_IN);
         UdpPacket = NULL;
 
     } else {
@@ -1419,7 +1474,7 @@ Return Value:
     //
 
     if (UdpPacket != NULL) {
-        MmFreePagedPool(UdpPacket);
+        NetpUdpFreeReceivedPacket(UdpPacket);
     }
 
     Status = STATUS_SUCCESS;
@@ -1597,10 +1652,16 @@ Return Value:
         }
 
         //
-        // If another thread beat this one to the punch, try again.
+        // If another thread beat this one to the punch, try again. The event
+        // may also have been set late by the end of a receive batch, so clear
+        // it to avoid spinning.
         //
 
         if (LIST_EMPTY(&(UdpSocket->ReceivedPacketList)) != FALSE) {
+            IoSetIoObjectState(Socket->KernelSocket.IoState,
+                               POLL_EVENT_IN,
+                               FALSE);
+
             KeReleaseQueuedLock(UdpSocket->ReceiveLock);
             LockHeld = FALSE;
             continue;
@@ -1684,7 +1745,7 @@ Return Value:
                                              UdpSocket->ReceiveBufferTotalSize;
             }
 
-            MmFreePagedPool(Packet);
+            NetpUdpFreeReceivedPacket(Packet);
 
             //
             // Unsignal the IN event if there are no more packets.
@@ -2060,3 +2121,36 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+
+VOID
+NetpUdpFreeReceivedPacket (
+    PUDP_RECEIVED_PACKET Packet
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a UDP received packet entry, including the network
+    packet backing it if the data was handed off from the device.
+
+Arguments:
+
+    Packet - Supplies a pointer to the received packet to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Packet->NetPacket != NULL) {
+        NetFreeBuffer(Packet->NetPacket);
+    }
+
+    MmFreePagedPool(Packet);
+    return;
+}
+
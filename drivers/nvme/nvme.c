@@ -0,0 +1,1651 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    nvme.c
+
+Abstract:
+
+    This module implements driver support for NVM Express (NVMe) storage
+    controllers.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "nvme.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+NvmeAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+NvmeDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+NvmeDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+NvmeDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+NvmeDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+NvmeDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+NvmepDispatchControllerStateChange (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    );
+
+VOID
+NvmepDispatchNamespaceStateChange (
+    PIRP Irp,
+    PNVME_NAMESPACE Namespace
+    );
+
+VOID
+NvmepDispatchNamespaceSystemControl (
+    PIRP Irp,
+    PNVME_NAMESPACE Namespace
+    );
+
+KSTATUS
+NvmepProcessResourceRequirements (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    );
+
+KSTATUS
+NvmepStartController (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    );
+
+KSTATUS
+NvmepEnableMsiX (
+    PNVME_CONTROLLER Controller
+    );
+
+KSTATUS
+NvmepConnectInterrupts (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    );
+
+VOID
+NvmepDisconnectInterrupts (
+    PNVME_CONTROLLER Controller
+    );
+
+VOID
+NvmepEnumerateNamespaces (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    );
+
+VOID
+NvmepProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER NvmeDriver = NULL;
+UUID NvmePciMsiInterfaceUuid = UUID_PCI_MESSAGE_SIGNALED_INTERRUPTS;
+
+DRIVER_FUNCTION_TABLE NvmeDriverFunctionTable = {
+    DRIVER_FUNCTION_TABLE_VERSION,
+    NULL,
+    NvmeAddDevice,
+    NULL,
+    NULL,
+    NvmeDispatchStateChange,
+    NvmeDispatchOpen,
+    NvmeDispatchClose,
+    NvmeDispatchIo,
+    NvmeDispatchSystemControl,
+    NULL
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the NVMe driver. It registers its other
+    dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    NvmeDriver = Driver;
+    Status = IoRegisterDriverFunctions(Driver, &NvmeDriverFunctionTable);
+    return Status;
+}
+
+KSTATUS
+NvmeAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the NVMe driver
+    acts as the function driver. The driver will attach itself to the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PNVME_CONTROLLER Controller;
+    KSTATUS Status;
+
+    Controller = MmAllocateNonPagedPool(sizeof(NVME_CONTROLLER),
+                                        NVME_ALLOCATION_TAG);
+
+    if (Controller == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Controller, sizeof(NVME_CONTROLLER));
+    Controller->Type = NvmeContextController;
+    Controller->InterruptLine = INVALID_INTERRUPT_LINE;
+    Controller->InterruptVector = INVALID_INTERRUPT_VECTOR;
+    Controller->AdminQueue.Controller = Controller;
+    Controller->AdminQueue.InterruptHandle = INVALID_HANDLE;
+    KeInitializeSpinLock(&(Controller->AdminQueue.Lock));
+    INITIALIZE_LIST_HEAD(&(Controller->AdminQueue.IrpQueue));
+    Controller->OsDevice = DeviceToken;
+    Controller->AdminLock = KeCreateQueuedLock();
+    if (Controller->AdminLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Controller);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Controller != NULL) {
+            if (Controller->AdminLock != NULL) {
+                KeDestroyQueuedLock(Controller->AdminLock);
+            }
+
+            MmFreeNonPagedPool(Controller);
+        }
+    }
+
+    return Status;
+}
+
+VOID
+NvmeDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_CONTROLLER Controller;
+
+    Controller = DeviceContext;
+    switch (Controller->Type) {
+    case NvmeContextController:
+        NvmepDispatchControllerStateChange(Irp, Controller);
+        break;
+
+    case NvmeContextNamespace:
+        NvmepDispatchNamespaceStateChange(Irp, (PNVME_NAMESPACE)Controller);
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        IoCompleteIrp(NvmeDriver, Irp, STATUS_INVALID_CONFIGURATION);
+        break;
+    }
+
+    return;
+}
+
+VOID
+NvmeDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_NAMESPACE Namespace;
+
+    //
+    // Only namespaces can be opened or closed.
+    //
+
+    Namespace = (PNVME_NAMESPACE)DeviceContext;
+    if (Namespace->Type != NvmeContextNamespace) {
+        return;
+    }
+
+    Irp->U.Open.DeviceContext = Namespace;
+    IoCompleteIrp(NvmeDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+NvmeDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_NAMESPACE Namespace;
+
+    //
+    // Only namespaces can be opened or closed.
+    //
+
+    Namespace = (PNVME_NAMESPACE)DeviceContext;
+    if (Namespace->Type != NvmeContextNamespace) {
+        return;
+    }
+
+    IoCompleteIrp(NvmeDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+NvmeDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL CompleteIrp;
+    ULONG IrpReadWriteFlags;
+    PNVME_NAMESPACE Namespace;
+    BOOL PmReferenceAdded;
+    KSTATUS Status;
+
+    Namespace = (PNVME_NAMESPACE)Irp->U.ReadWrite.DeviceContext;
+    if (Namespace->Type != NvmeContextNamespace) {
+        return;
+    }
+
+    CompleteIrp = TRUE;
+
+    //
+    // If this IRP is on the way down, always add a power management reference.
+    //
+
+    PmReferenceAdded = FALSE;
+    if (Irp->Direction == IrpDown) {
+        Status = PmDeviceAddReference(Namespace->OsDevice);
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        PmReferenceAdded = TRUE;
+    }
+
+    //
+    // Set the IRP read/write flags for the preparation and completion steps.
+    //
+
+    IrpReadWriteFlags = IRP_READ_WRITE_FLAG_DMA;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        IrpReadWriteFlags |= IRP_READ_WRITE_FLAG_WRITE;
+    }
+
+    //
+    // If the IRP is on the way up, then clean up after the DMA. An IRP going
+    // up is already complete.
+    //
+
+    if (Irp->Direction == IrpUp) {
+        CompleteIrp = FALSE;
+        PmDeviceReleaseReference(Namespace->OsDevice);
+        Status = IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+        if (!KSUCCESS(Status)) {
+            IoUpdateIrpStatus(Irp, Status);
+        }
+
+    //
+    // Start the DMA on the way down.
+    //
+
+    } else {
+        Irp->U.ReadWrite.NewIoOffset = Irp->U.ReadWrite.IoOffset;
+
+        //
+        // NVMe can reach all of physical memory, so the only requirement is
+        // that the buffer be block aligned.
+        //
+
+        Status = IoPrepareReadWriteIrp(&(Irp->U.ReadWrite),
+                                       1 << Namespace->BlockShift,
+                                       0,
+                                       MAX_ULONGLONG,
+                                       IrpReadWriteFlags);
+
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        CompleteIrp = FALSE;
+        Status = NvmepEnqueueIrp(Namespace, Irp);
+        if (!KSUCCESS(Status)) {
+            IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+            CompleteIrp = TRUE;
+        }
+    }
+
+DispatchIoEnd:
+    if (CompleteIrp != FALSE) {
+        if (PmReferenceAdded != FALSE) {
+            PmDeviceReleaseReference(Namespace->OsDevice);
+        }
+
+        IoCompleteIrp(NvmeDriver, Irp, Status);
+    }
+
+    return;
+}
+
+VOID
+NvmeDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_NAMESPACE Namespace;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Namespace = (PNVME_NAMESPACE)DeviceContext;
+    if (Namespace->Type == NvmeContextNamespace) {
+        NvmepDispatchNamespaceSystemControl(Irp, Namespace);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+NvmepDispatchControllerStateChange (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for an NVMe controller.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the controller context.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Irp->Direction == IrpUp) {
+        if (!KSUCCESS(IoGetIrpStatus(Irp))) {
+            return;
+        }
+
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = NvmepProcessResourceRequirements(Irp, Controller);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(NvmeDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = NvmepStartController(Irp, Controller);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(NvmeDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorQueryChildren:
+            NvmepEnumerateNamespaces(Irp, Controller);
+            break;
+
+        case IrpMinorIdle:
+        case IrpMinorSuspend:
+        case IrpMinorResume:
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+NvmepDispatchNamespaceStateChange (
+    PIRP Irp,
+    PNVME_NAMESPACE Namespace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for an NVMe namespace device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Namespace - Supplies a pointer to the namespace.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorStartDevice:
+
+            ASSERT(Namespace->OsDevice == Irp->Device);
+
+            Status = PmInitialize(Irp->Device);
+            IoCompleteIrp(NvmeDriver, Irp, Status);
+            break;
+
+        case IrpMinorQueryResources:
+        case IrpMinorQueryChildren:
+        case IrpMinorIdle:
+        case IrpMinorSuspend:
+        case IrpMinorResume:
+            IoCompleteIrp(NvmeDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorRemoveDevice:
+            Namespace->BlockCount = 0;
+            IoCompleteIrp(NvmeDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+NvmepDispatchNamespaceSystemControl (
+    PIRP Irp,
+    PNVME_NAMESPACE Namespace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs for an NVMe namespace.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Namespace - Supplies a pointer to the namespace.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG BlockSize;
+    PVOID Context;
+    PSYSTEM_CONTROL_FILE_OPERATION FileOperation;
+    PSYSTEM_CONTROL_LOOKUP Lookup;
+    PFILE_PROPERTIES Properties;
+    ULONGLONG PropertiesFileSize;
+    KSTATUS Status;
+
+    BlockSize = 1 << Namespace->BlockShift;
+    Context = Irp->U.SystemControl.SystemContext;
+    if (Irp->Direction == IrpUp) {
+
+        ASSERT(Irp->MinorCode == IrpMinorSystemControlSynchronize);
+
+        PmDeviceReleaseReference(Namespace->OsDevice);
+        return;
+    }
+
+    switch (Irp->MinorCode) {
+    case IrpMinorSystemControlLookup:
+        Lookup = (PSYSTEM_CONTROL_LOOKUP)Context;
+        Status = STATUS_PATH_NOT_FOUND;
+        if (Lookup->Root != FALSE) {
+
+            //
+            // Enable opening of the root as a single file.
+            //
+
+            Properties = Lookup->Properties;
+            Properties->FileId = 0;
+            Properties->Type = IoObjectBlockDevice;
+            Properties->HardLinkCount = 1;
+            Properties->BlockSize = BlockSize;
+            Properties->BlockCount = Namespace->BlockCount;
+            Properties->Size = Namespace->BlockCount << Namespace->BlockShift;
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(NvmeDriver, Irp, Status);
+        break;
+
+    //
+    // Writes to the disk's properties are not allowed. Fail if the data
+    // has changed.
+    //
+
+    case IrpMinorSystemControlWriteFileProperties:
+        FileOperation = (PSYSTEM_CONTROL_FILE_OPERATION)Context;
+        Properties = FileOperation->FileProperties;
+        PropertiesFileSize = Properties->Size;
+        if ((Properties->FileId != 0) ||
+            (Properties->Type != IoObjectBlockDevice) ||
+            (Properties->HardLinkCount != 1) ||
+            (Properties->BlockSize != BlockSize) ||
+            (Properties->BlockCount != Namespace->BlockCount) ||
+            (PropertiesFileSize !=
+             (Namespace->BlockCount << Namespace->BlockShift))) {
+
+            Status = STATUS_NOT_SUPPORTED;
+
+        } else {
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(NvmeDriver, Irp, Status);
+        break;
+
+    //
+    // Do not support disk device truncation.
+    //
+
+    case IrpMinorSystemControlTruncate:
+        IoCompleteIrp(NvmeDriver, Irp, STATUS_NOT_SUPPORTED);
+        break;
+
+    //
+    // Gather and return device information.
+    //
+
+    case IrpMinorSystemControlDeviceInformation:
+        break;
+
+    //
+    // Send a flush command to the device upon getting a synchronize request.
+    //
+
+    case IrpMinorSystemControlSynchronize:
+        Status = PmDeviceAddReference(Namespace->OsDevice);
+        if (!KSUCCESS(Status)) {
+            IoCompleteIrp(NvmeDriver, Irp, Status);
+            break;
+        }
+
+        Status = NvmepEnqueueIrp(Namespace, Irp);
+        if (!KSUCCESS(Status)) {
+            PmDeviceReleaseReference(Namespace->OsDevice);
+            IoCompleteIrp(NvmeDriver, Irp, Status);
+        }
+
+        break;
+
+    //
+    // Ignore everything unrecognized.
+    //
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    return;
+}
+
+KSTATUS
+NvmepProcessResourceRequirements (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine filters through the resource requirements presented by the
+    bus for an NVMe controller. If MSI-X is available, it requests one vector
+    per processor, up to the I/O queue limit. Otherwise it adds an interrupt
+    vector requirement for any interrupt line requested.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the NVMe controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_CONFIGURATION_LIST ConfigurationList;
+    ULONGLONG EdgeTriggered;
+    ULONG Index;
+    ULONGLONG LineCharacteristics;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    PRESOURCE_REQUIREMENT NextRequirement;
+    PRESOURCE_REQUIREMENT Requirement;
+    PRESOURCE_REQUIREMENT_LIST RequirementList;
+    KSTATUS Status;
+    ULONGLONG VectorCharacteristics;
+    ULONG VectorCount;
+    PRESOURCE_REQUIREMENT VectorRequirement;
+    RESOURCE_REQUIREMENT VectorTemplate;
+
+    ASSERT((Irp->MajorCode == IrpMajorStateChange) &&
+           (Irp->MinorCode == IrpMinorQueryResources));
+
+    //
+    // Initialize a nice interrupt vector requirement in preparation.
+    //
+
+    RtlZeroMemory(&VectorTemplate, sizeof(RESOURCE_REQUIREMENT));
+    VectorTemplate.Type = ResourceTypeInterruptVector;
+    VectorTemplate.Minimum = 0;
+    VectorTemplate.Maximum = -1;
+    VectorTemplate.Length = 1;
+
+    //
+    // Prefer MSI-X over legacy interrupts, as it allows each I/O queue to
+    // interrupt the processor that submits to it.
+    //
+
+    if ((Controller->PciMsiFlags &
+         NVME_PCI_MSI_FLAG_INTERFACE_REGISTERED) == 0) {
+
+        Status = IoRegisterForInterfaceNotifications(
+                                &NvmePciMsiInterfaceUuid,
+                                NvmepProcessPciMsiInterfaceChangeNotification,
+                                Irp->Device,
+                                Controller,
+                                TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Controller->PciMsiFlags |= NVME_PCI_MSI_FLAG_INTERFACE_REGISTERED;
+    }
+
+    VectorCount = 0;
+    if ((Controller->PciMsiFlags &
+         NVME_PCI_MSI_FLAG_INTERFACE_AVAILABLE) != 0) {
+
+        MsiInterface = &(Controller->PciMsiInterface);
+        RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+        MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+        MsiInformation.MsiType = PciMsiTypeExtended;
+        Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                                 &MsiInformation,
+                                                 FALSE);
+
+        if ((KSUCCESS(Status)) && (MsiInformation.MaxVectorCount != 0)) {
+            VectorCount = KeGetActiveProcessorCount();
+            if (VectorCount > NVME_MAX_IO_QUEUES) {
+                VectorCount = NVME_MAX_IO_QUEUES;
+            }
+
+            if (VectorCount > MsiInformation.MaxVectorCount) {
+                VectorCount = MsiInformation.MaxVectorCount;
+            }
+        }
+    }
+
+    ConfigurationList = Irp->U.QueryResources.ResourceRequirements;
+    if (VectorCount != 0) {
+        RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                         NULL);
+
+        while (RequirementList != NULL) {
+            for (Index = 0; Index < VectorCount; Index += 1) {
+                VectorTemplate.Characteristics =
+                                               INTERRUPT_VECTOR_EDGE_TRIGGERED;
+
+                VectorTemplate.OwningRequirement = NULL;
+                Status = IoCreateAndAddResourceRequirement(&VectorTemplate,
+                                                           RequirementList,
+                                                           &VectorRequirement);
+
+                if (!KSUCCESS(Status)) {
+                    goto ProcessResourceRequirementsEnd;
+                }
+
+                //
+                // In case the MSI-X vectors cannot be allocated, give the
+                // first vector alternatives for each interrupt line so the
+                // controller can fall back to a single line interrupt.
+                //
+
+                if (Index != 0) {
+                    continue;
+                }
+
+                Requirement = IoGetNextResourceRequirement(RequirementList,
+                                                           NULL);
+
+                while (Requirement != NULL) {
+                    NextRequirement = IoGetNextResourceRequirement(
+                                                               RequirementList,
+                                                               Requirement);
+
+                    if (Requirement->Type != ResourceTypeInterruptLine) {
+                        Requirement = NextRequirement;
+                        continue;
+                    }
+
+                    VectorCharacteristics = 0;
+                    LineCharacteristics = Requirement->Characteristics;
+                    if ((LineCharacteristics &
+                         INTERRUPT_LINE_ACTIVE_LOW) != 0) {
+
+                        VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_LOW;
+                    }
+
+                    if ((LineCharacteristics &
+                         INTERRUPT_LINE_ACTIVE_HIGH) != 0) {
+
+                        VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_HIGH;
+                    }
+
+                    EdgeTriggered = LineCharacteristics &
+                                    INTERRUPT_LINE_EDGE_TRIGGERED;
+
+                    if (EdgeTriggered != 0) {
+                        VectorCharacteristics |=
+                                               INTERRUPT_VECTOR_EDGE_TRIGGERED;
+                    }
+
+                    VectorTemplate.Characteristics = VectorCharacteristics;
+                    VectorTemplate.OwningRequirement = Requirement;
+                    Status = IoCreateAndAddResourceRequirementAlternative(
+                                                            &VectorTemplate,
+                                                            VectorRequirement);
+
+                    if (!KSUCCESS(Status)) {
+                        goto ProcessResourceRequirementsEnd;
+                    }
+
+                    Requirement = NextRequirement;
+                }
+            }
+
+            RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                             RequirementList);
+        }
+
+        Controller->PciMsiFlags |= NVME_PCI_MSI_FLAG_RESOURCES_REQUESTED;
+
+    //
+    // Otherwise stick with the good, old legacy interrupt setup.
+    //
+
+    } else {
+        Status = IoCreateAndAddInterruptVectorsForLines(ConfigurationList,
+                                                        &VectorTemplate);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+    }
+
+    Status = STATUS_SUCCESS;
+
+ProcessResourceRequirementsEnd:
+    return Status;
+}
+
+KSTATUS
+NvmepStartController (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts an NVMe controller device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the NVMe controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AlignmentOffset;
+    PRESOURCE_ALLOCATION Allocation;
+    PRESOURCE_ALLOCATION_LIST AllocationList;
+    PRESOURCE_ALLOCATION ControllerBase;
+    PHYSICAL_ADDRESS EndAddress;
+    PRESOURCE_ALLOCATION LineAllocation;
+    UINTN PageSize;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    ULONG QueueCount;
+    UINTN Size;
+    KSTATUS Status;
+    PVOID VirtualAddress;
+
+    ControllerBase = NULL;
+    Controller->MsiVectorCount = 0;
+    Status = PmInitialize(Irp->Device);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Status = PmDeviceAddReference(Irp->Device);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // Loop through the allocated resources to get the controller base and the
+    // interrupts.
+    //
+
+    AllocationList = Irp->U.StartDevice.ProcessorLocalResources;
+    Allocation = IoGetNextResourceAllocation(AllocationList, NULL);
+    while (Allocation != NULL) {
+
+        //
+        // The presence of an owning interrupt line allocation dictates
+        // whether or not MSI-X is used versus legacy interrupts.
+        //
+
+        if (Allocation->Type == ResourceTypeInterruptVector) {
+            LineAllocation = Allocation->OwningAllocation;
+            if (LineAllocation == NULL) {
+
+                ASSERT((Controller->PciMsiFlags &
+                        NVME_PCI_MSI_FLAG_RESOURCES_REQUESTED) != 0);
+
+                if (Controller->MsiVectorCount < NVME_MAX_IO_QUEUES) {
+                    Controller->MsiVectors[Controller->MsiVectorCount] =
+                                                        Allocation->Allocation;
+
+                    Controller->MsiVectorCount += 1;
+                }
+
+            } else {
+                Controller->InterruptLine = LineAllocation->Allocation;
+                Controller->InterruptVector = Allocation->Allocation;
+                Controller->InterruptResourcesFound = TRUE;
+            }
+
+        //
+        // The registers live in the first memory BAR.
+        //
+
+        } else if (Allocation->Type == ResourceTypePhysicalAddressSpace) {
+            if ((ControllerBase == NULL) && (Allocation->Length != 0)) {
+                ControllerBase = Allocation;
+            }
+        }
+
+        Allocation = IoGetNextResourceAllocation(AllocationList, Allocation);
+    }
+
+    if (ControllerBase == NULL) {
+        RtlDebugPrint("NVMe: Missing resources.\n");
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto StartControllerEnd;
+    }
+
+    //
+    // Use MSI-X if the first vector did not fall back to a line. Otherwise
+    // run a single I/O queue off of the line interrupt.
+    //
+
+    QueueCount = 1;
+    if ((Controller->InterruptResourcesFound == FALSE) &&
+        (Controller->MsiVectorCount != 0)) {
+
+        Controller->PciMsiFlags |= NVME_PCI_MSI_FLAG_RESOURCES_ALLOCATED;
+        QueueCount = Controller->MsiVectorCount;
+
+    } else {
+        Controller->PciMsiFlags &= ~NVME_PCI_MSI_FLAG_RESOURCES_ALLOCATED;
+        Controller->MsiVectorCount = 0;
+        if (Controller->InterruptResourcesFound == FALSE) {
+            RtlDebugPrint("NVMe: Missing interrupt.\n");
+            Status = STATUS_INVALID_CONFIGURATION;
+            goto StartControllerEnd;
+        }
+    }
+
+    if (Controller->ControllerBase == NULL) {
+
+        //
+        // Page align the mapping request.
+        //
+
+        PageSize = MmPageSize();
+        PhysicalAddress = ControllerBase->Allocation;
+        EndAddress = PhysicalAddress + ControllerBase->Length;
+        PhysicalAddress = ALIGN_RANGE_DOWN(PhysicalAddress, PageSize);
+        AlignmentOffset = ControllerBase->Allocation - PhysicalAddress;
+        EndAddress = ALIGN_RANGE_UP(EndAddress, PageSize);
+        Size = (ULONG)(EndAddress - PhysicalAddress);
+        VirtualAddress = MmMapPhysicalAddress(PhysicalAddress,
+                                              Size,
+                                              TRUE,
+                                              FALSE,
+                                              TRUE);
+
+        if (VirtualAddress == NULL) {
+            Status = STATUS_NO_MEMORY;
+            goto StartControllerEnd;
+        }
+
+        Controller->ControllerBase = VirtualAddress + AlignmentOffset;
+    }
+
+    if ((Controller->PciMsiFlags &
+         NVME_PCI_MSI_FLAG_RESOURCES_ALLOCATED) != 0) {
+
+        Status = NvmepEnableMsiX(Controller);
+        if (!KSUCCESS(Status)) {
+            goto StartControllerEnd;
+        }
+    }
+
+    //
+    // Reset the controller and create the queues.
+    //
+
+    Status = NvmepInitializeController(Controller, QueueCount);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+    Status = NvmepConnectInterrupts(Irp, Controller);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+StartControllerEnd:
+    if (!KSUCCESS(Status)) {
+        NvmepDisconnectInterrupts(Controller);
+        NvmepDestroyController(Controller);
+    }
+
+    PmDeviceReleaseReference(Irp->Device);
+    return Status;
+}
+
+KSTATUS
+NvmepEnableMsiX (
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine programs the MSI-X table and enables MSI-X for the
+    controller. Each vector is steered to the processor that submits to the
+    matching I/O queue, so completions are handled where the I/O was issued.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Index;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    ULONG ProcessorCount;
+    PROCESSOR_SET ProcessorSet;
+    KSTATUS Status;
+
+    MsiInterface = &(Controller->PciMsiInterface);
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (Index = 0; Index < Controller->MsiVectorCount; Index += 1) {
+        ProcessorSet.Target = ProcessorTargetSingleProcessor;
+        ProcessorSet.U.Number = Index % ProcessorCount;
+        Status = MsiInterface->SetVectors(MsiInterface->DeviceToken,
+                                          PciMsiTypeExtended,
+                                          Controller->MsiVectors[Index],
+                                          Index,
+                                          1,
+                                          &ProcessorSet);
+
+        if (!KSUCCESS(Status)) {
+            goto EnableMsiXEnd;
+        }
+    }
+
+    RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+    MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+    MsiInformation.MsiType = PciMsiTypeExtended;
+    MsiInformation.Flags = PCI_MSI_INTERFACE_FLAG_ENABLED;
+    MsiInformation.VectorCount = Controller->MsiVectorCount;
+    Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                             &MsiInformation,
+                                             TRUE);
+
+    if (!KSUCCESS(Status)) {
+        goto EnableMsiXEnd;
+    }
+
+EnableMsiXEnd:
+    return Status;
+}
+
+KSTATUS
+NvmepConnectInterrupts (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine connects an interrupt for each I/O queue. With MSI-X, each
+    queue has its own vector. Otherwise the single queue uses the line
+    interrupt.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    ULONG Index;
+    PNVME_QUEUE Queue;
+    KSTATUS Status;
+
+    RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+    Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+    Connect.Device = Irp->Device;
+    Connect.InterruptServiceRoutine = NvmeInterruptService;
+    Connect.DispatchServiceRoutine = NvmeInterruptServiceDpc;
+    Status = STATUS_SUCCESS;
+    for (Index = 0; Index < Controller->IoQueueCount; Index += 1) {
+        Queue = &(Controller->IoQueues[Index]);
+        if (Queue->InterruptHandle != INVALID_HANDLE) {
+            continue;
+        }
+
+        if (Controller->MsiVectorCount != 0) {
+            Connect.LineNumber = INVALID_INTERRUPT_LINE;
+            Queue->InterruptVector = Controller->MsiVectors[Index];
+
+        } else {
+            Connect.LineNumber = Controller->InterruptLine;
+            Queue->InterruptVector = Controller->InterruptVector;
+        }
+
+        Connect.Vector = Queue->InterruptVector;
+        Connect.Context = Queue;
+        Connect.Interrupt = &(Queue->InterruptHandle);
+        Status = IoConnectInterrupt(&Connect);
+        if (!KSUCCESS(Status)) {
+            goto ConnectInterruptsEnd;
+        }
+    }
+
+ConnectInterruptsEnd:
+    return Status;
+}
+
+VOID
+NvmepDisconnectInterrupts (
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine disconnects any interrupts connected for the controller.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PNVME_QUEUE Queue;
+
+    if (Controller->IoQueues == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < Controller->IoQueueCount; Index += 1) {
+        Queue = &(Controller->IoQueues[Index]);
+        if (Queue->InterruptHandle != INVALID_HANDLE) {
+            IoDisconnectInterrupt(Queue->InterruptHandle);
+            Queue->InterruptHandle = INVALID_HANDLE;
+        }
+    }
+
+    return;
+}
+
+VOID
+NvmepEnumerateNamespaces (
+    PIRP Irp,
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine enumerates the active namespaces on the controller, creating
+    a disk device for each.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the NVMe controller.
+
+Return Value:
+
+    None. The IRP is completed with the appropriate status.
+
+--*/
+
+{
+
+    ULONGLONG BlockCount;
+    ULONG BlockShift;
+    ULONG ChildCount;
+    PDEVICE Children[NVME_MAX_NAMESPACES];
+    ULONG Index;
+    ULONG MaxNamespaces;
+    PNVME_NAMESPACE Namespace;
+    KSTATUS Status;
+
+    Status = PmDeviceAddReference(Irp->Device);
+    if (!KSUCCESS(Status)) {
+        IoCompleteIrp(NvmeDriver, Irp, Status);
+        return;
+    }
+
+    ChildCount = 0;
+    MaxNamespaces = Controller->NamespaceCount;
+    if (MaxNamespaces > NVME_MAX_NAMESPACES) {
+        MaxNamespaces = NVME_MAX_NAMESPACES;
+    }
+
+    for (Index = 0; Index < MaxNamespaces; Index += 1) {
+        Status = NvmepIdentifyNamespace(Controller,
+                                        Index + 1,
+                                        &BlockShift,
+                                        &BlockCount);
+
+        if (!KSUCCESS(Status)) {
+            if (Status == STATUS_NOT_SUPPORTED) {
+                RtlDebugPrint("NVMe: Skipping namespace %d.\n", Index + 1);
+                continue;
+            }
+
+            RtlDebugPrint("NVMe: Identify namespace %d failed: %d\n",
+                          Index + 1,
+                          Status);
+
+            goto EnumerateNamespacesEnd;
+        }
+
+        if (BlockCount == 0) {
+            continue;
+        }
+
+        Namespace = Controller->Namespaces[Index];
+        if (Namespace == NULL) {
+            Namespace = MmAllocateNonPagedPool(sizeof(NVME_NAMESPACE),
+                                               NVME_ALLOCATION_TAG);
+
+            if (Namespace == NULL) {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                goto EnumerateNamespacesEnd;
+            }
+
+            RtlZeroMemory(Namespace, sizeof(NVME_NAMESPACE));
+            Namespace->Type = NvmeContextNamespace;
+            Namespace->Controller = Controller;
+            Namespace->NamespaceId = Index + 1;
+            Controller->Namespaces[Index] = Namespace;
+        }
+
+        Namespace->BlockShift = BlockShift;
+        Namespace->BlockCount = BlockCount;
+
+        //
+        // Create a new device if there was not one there before.
+        //
+
+        if (Namespace->OsDevice == NULL) {
+            Status = IoCreateDevice(NvmeDriver,
+                                    Namespace,
+                                    Irp->Device,
+                                    "Disk",
+                                    DISK_CLASS_ID,
+                                    NULL,
+                                    &(Namespace->OsDevice));
+
+            if (!KSUCCESS(Status)) {
+                goto EnumerateNamespacesEnd;
+            }
+
+            IoSetDeviceBlockQueuePolicy(Namespace->OsDevice,
+                                        BlockQueuePolicyNoop);
+        }
+
+        Children[ChildCount] = Namespace->OsDevice;
+        ChildCount += 1;
+    }
+
+    Status = STATUS_SUCCESS;
+    if (ChildCount != 0) {
+        Status = IoMergeChildArrays(Irp,
+                                    Children,
+                                    ChildCount,
+                                    NVME_ALLOCATION_TAG);
+
+        if (!KSUCCESS(Status)) {
+            goto EnumerateNamespacesEnd;
+        }
+    }
+
+EnumerateNamespacesEnd:
+    PmDeviceReleaseReference(Irp->Device);
+    IoCompleteIrp(NvmeDriver, Irp, Status);
+    return;
+}
+
+VOID
+NvmepProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI MSI interface changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_CONTROLLER Controller;
+
+    Controller = (PNVME_CONTROLLER)Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_MSI)) {
+
+            ASSERT((Controller->PciMsiFlags &
+                    NVME_PCI_MSI_FLAG_INTERFACE_AVAILABLE) == 0);
+
+            RtlCopyMemory(&(Controller->PciMsiInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_MSI));
+
+            Controller->PciMsiFlags |= NVME_PCI_MSI_FLAG_INTERFACE_AVAILABLE;
+        }
+
+    } else {
+        Controller->PciMsiFlags &= ~NVME_PCI_MSI_FLAG_INTERFACE_AVAILABLE;
+    }
+
+    return;
+}
+
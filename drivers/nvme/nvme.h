@@ -0,0 +1,797 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    nvme.h
+
+Abstract:
+
+    This header contains definitions for the NVM Express (NVMe) storage
+    controller driver.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/intrface/pci.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// These macros read from and write to controller registers.
+//
+
+#define NVME_READ(_Controller, _Register) \
+    HlReadRegister32((PUCHAR)(_Controller)->ControllerBase + (_Register))
+
+#define NVME_WRITE(_Controller, _Register, _Value)                          \
+    HlWriteRegister32((PUCHAR)(_Controller)->ControllerBase + (_Register),  \
+                      (_Value))
+
+//
+// This macro reads a 64-bit register, low half first.
+//
+
+#define NVME_READ64(_Controller, _Register)                     \
+    ((ULONGLONG)NVME_READ((_Controller), (_Register)) |         \
+     ((ULONGLONG)NVME_READ((_Controller), (_Register) + 4) << 32))
+
+//
+// This macro writes a 64-bit register, low half first.
+//
+
+#define NVME_WRITE64(_Controller, _Register, _Value)                        \
+    NVME_WRITE((_Controller), (_Register), (ULONG)(_Value)),                \
+    NVME_WRITE((_Controller), (_Register) + 4, (ULONG)((_Value) >> 32))
+
+//
+// These macros return the register offsets of a queue's doorbells.
+//
+
+#define NVME_SUBMISSION_DOORBELL(_Controller, _QueueId)              \
+    (NvmeRegisterDoorbellBase +                                      \
+     (((_QueueId) * 2) * (_Controller)->DoorbellStride))
+
+#define NVME_COMPLETION_DOORBELL(_Controller, _QueueId)              \
+    (NvmeRegisterDoorbellBase +                                      \
+     ((((_QueueId) * 2) + 1) * (_Controller)->DoorbellStride))
+
+//
+// These macros pull fields out of the capabilities register.
+//
+
+#define NVME_CAPABILITY_MAX_QUEUE_ENTRIES(_Capabilities) \
+    ((ULONG)((_Capabilities) & 0xFFFF) + 1)
+
+#define NVME_CAPABILITY_TIMEOUT(_Capabilities) \
+    ((ULONG)(((_Capabilities) >> 24) & 0xFF))
+
+#define NVME_CAPABILITY_DOORBELL_STRIDE(_Capabilities) \
+    (4 << (ULONG)(((_Capabilities) >> 32) & 0xF))
+
+#define NVME_CAPABILITY_PAGE_SHIFT_MIN(_Capabilities) \
+    (12 + (ULONG)(((_Capabilities) >> 48) & 0xF))
+
+#define NVME_CAPABILITY_PAGE_SHIFT_MAX(_Capabilities) \
+    (12 + (ULONG)(((_Capabilities) >> 52) & 0xF))
+
+//
+// This macro builds the first dword of a command.
+//
+
+#define NVME_COMMAND_DWORD0(_Opcode, _Flags, _CommandId) \
+    ((_Opcode) | ((_Flags) << 8) | ((_CommandId) << 16))
+
+//
+// These macros pull fields out of the completion status.
+//
+
+#define NVME_COMPLETION_PHASE(_Status) ((_Status) & 0x1)
+#define NVME_COMPLETION_STATUS_CODE(_Status) (((_Status) >> 1) & 0x7FF)
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define NVME_ALLOCATION_TAG 0x656D764E
+
+//
+// Define the maximum number of I/O queue pairs to create. Each one gets its
+// own interrupt vector and is used by one processor.
+//
+
+#define NVME_MAX_IO_QUEUES 16
+
+//
+// Define the number of entries in the admin and I/O queues.
+//
+
+#define NVME_ADMIN_QUEUE_DEPTH 16
+#define NVME_IO_QUEUE_DEPTH 64
+
+//
+// Define the maximum number of namespaces that are exposed.
+//
+
+#define NVME_MAX_NAMESPACES 16
+
+//
+// Define the page size used for queues and PRP lists.
+//
+
+#define NVME_PAGE_SHIFT 12
+#define NVME_PAGE_SIZE (1 << NVME_PAGE_SHIFT)
+
+//
+// Define the size of queue entries as powers of two.
+//
+
+#define NVME_SUBMISSION_ENTRY_SHIFT 6
+#define NVME_COMPLETION_ENTRY_SHIFT 4
+
+//
+// Define the number of entries in the single list page each command owns.
+//
+
+#define NVME_PRP_LIST_COUNT (NVME_PAGE_SIZE / sizeof(ULONGLONG))
+#define NVME_SGL_LIST_COUNT (NVME_PAGE_SIZE / sizeof(NVME_SGL_DESCRIPTOR))
+
+//
+// Define the time to wait for admin commands, in seconds.
+//
+
+#define NVME_ADMIN_TIMEOUT 5
+
+//
+// Define the unit of the capabilities timeout, in milliseconds.
+//
+
+#define NVME_CAPABILITY_TIMEOUT_UNIT 500
+
+//
+// Define controller configuration register bits.
+//
+
+#define NVME_CONFIGURATION_ENABLE 0x00000001
+#define NVME_CONFIGURATION_PAGE_SIZE_SHIFT 7
+#define NVME_CONFIGURATION_SUBMISSION_ENTRY_SHIFT 16
+#define NVME_CONFIGURATION_COMPLETION_ENTRY_SHIFT 20
+
+//
+// Define controller status register bits.
+//
+
+#define NVME_STATUS_READY 0x00000001
+#define NVME_STATUS_FATAL 0x00000002
+
+//
+// Define the interrupt mask bit used for the single pin-based vector.
+//
+
+#define NVME_INTERRUPT_MASK_VECTOR0 0x00000001
+
+//
+// Define admin command opcodes.
+//
+
+#define NVME_ADMIN_DELETE_SUBMISSION_QUEUE 0x00
+#define NVME_ADMIN_CREATE_SUBMISSION_QUEUE 0x01
+#define NVME_ADMIN_DELETE_COMPLETION_QUEUE 0x04
+#define NVME_ADMIN_CREATE_COMPLETION_QUEUE 0x05
+#define NVME_ADMIN_IDENTIFY                0x06
+#define NVME_ADMIN_SET_FEATURES            0x09
+
+//
+// Define NVM command opcodes.
+//
+
+#define NVME_COMMAND_FLUSH 0x00
+#define NVME_COMMAND_WRITE 0x01
+#define NVME_COMMAND_READ  0x02
+
+//
+// Define the command flags that select SGLs instead of PRPs for the data.
+//
+
+#define NVME_COMMAND_FLAG_SGL 0x40
+
+//
+// Define queue creation flags.
+//
+
+#define NVME_QUEUE_PHYSICALLY_CONTIGUOUS 0x00000001
+#define NVME_QUEUE_INTERRUPTS_ENABLED    0x00000002
+
+//
+// Define identify command types.
+//
+
+#define NVME_IDENTIFY_NAMESPACE  0x00
+#define NVME_IDENTIFY_CONTROLLER 0x01
+
+//
+// Define the number of queues feature.
+//
+
+#define NVME_FEATURE_NUMBER_OF_QUEUES 0x07
+
+//
+// Define the read/write command bit that forces data to durable media.
+//
+
+#define NVME_READ_WRITE_FORCE_UNIT_ACCESS 0x40000000
+
+//
+// Define the maximum number of blocks a read or write can transfer.
+//
+
+#define NVME_MAX_BLOCK_COUNT 0x10000
+
+//
+// Define offsets into the identify controller data.
+//
+
+#define NVME_IDENTIFY_CONTROLLER_MAX_TRANSFER 77
+#define NVME_IDENTIFY_CONTROLLER_NAMESPACE_COUNT 516
+#define NVME_IDENTIFY_CONTROLLER_SGL_SUPPORT 536
+
+//
+// Define the SGL support field values.
+//
+
+#define NVME_SGL_SUPPORT_MASK 0x00000003
+
+//
+// Define offsets into the identify namespace data.
+//
+
+#define NVME_IDENTIFY_NAMESPACE_SIZE 0
+#define NVME_IDENTIFY_NAMESPACE_FORMATTED_SIZE 26
+#define NVME_IDENTIFY_NAMESPACE_FORMATS 128
+
+//
+// Define fields within the LBA format entries.
+//
+
+#define NVME_FORMAT_INDEX_MASK 0x0F
+#define NVME_FORMAT_METADATA_SIZE_MASK 0x0000FFFF
+#define NVME_FORMAT_BLOCK_SHIFT(_Format) (((_Format) >> 16) & 0xFF)
+
+//
+// Define SGL descriptor identifiers.
+//
+
+#define NVME_SGL_DATA_BLOCK   0x00
+#define NVME_SGL_LAST_SEGMENT 0x30
+
+//
+// Define controller flags.
+//
+
+#define NVME_CONTROLLER_FLAG_SGL_SUPPORTED 0x00000001
+
+//
+// Define PCI MSI/MSI-X flags.
+//
+
+#define NVME_PCI_MSI_FLAG_INTERFACE_REGISTERED 0x00000001
+#define NVME_PCI_MSI_FLAG_INTERFACE_AVAILABLE  0x00000002
+#define NVME_PCI_MSI_FLAG_RESOURCES_REQUESTED  0x00000004
+#define NVME_PCI_MSI_FLAG_RESOURCES_ALLOCATED  0x00000008
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef struct _NVME_CONTROLLER NVME_CONTROLLER, *PNVME_CONTROLLER;
+
+typedef enum _NVME_CONTEXT_TYPE {
+    NvmeContextInvalid,
+    NvmeContextController,
+    NvmeContextNamespace
+} NVME_CONTEXT_TYPE, *PNVME_CONTEXT_TYPE;
+
+typedef enum _NVME_REGISTER {
+    NvmeRegisterCapabilities = 0x00,
+    NvmeRegisterVersion = 0x08,
+    NvmeRegisterInterruptMaskSet = 0x0C,
+    NvmeRegisterInterruptMaskClear = 0x10,
+    NvmeRegisterConfiguration = 0x14,
+    NvmeRegisterStatus = 0x1C,
+    NvmeRegisterAdminQueueAttributes = 0x24,
+    NvmeRegisterAdminSubmissionQueue = 0x28,
+    NvmeRegisterAdminCompletionQueue = 0x30,
+    NvmeRegisterDoorbellBase = 0x1000
+} NVME_REGISTER, *PNVME_REGISTER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a submission queue entry. This structure is hardware
+    defined.
+
+Members:
+
+    Command - Stores the opcode, flags, and command identifier.
+
+    NamespaceId - Stores the namespace the command applies to.
+
+    Reserved - Stores reserved dwords. Set to zero.
+
+    MetadataPointer - Stores the physical address of separate metadata.
+
+    DataPointer - Stores either two PRP entries or an SGL descriptor
+        describing the data.
+
+    CommandDword - Stores command specific dwords 10 through 15.
+
+--*/
+
+typedef struct _NVME_COMMAND {
+    ULONG Command;
+    ULONG NamespaceId;
+    ULONG Reserved[2];
+    ULONGLONG MetadataPointer;
+    ULONGLONG DataPointer[2];
+    ULONG CommandDword[6];
+} PACKED NVME_COMMAND, *PNVME_COMMAND;
+
+/*++
+
+Structure Description:
+
+    This structure defines a completion queue entry. This structure is
+    hardware defined.
+
+Members:
+
+    Result - Stores the command specific result.
+
+    Reserved - Stores a reserved dword.
+
+    SubmissionHead - Stores the submission queue head at the time the entry
+        was posted.
+
+    SubmissionQueueId - Stores the submission queue the command came from.
+
+    CommandId - Stores the identifier of the completed command.
+
+    Status - Stores the phase tag and status field.
+
+--*/
+
+typedef struct _NVME_COMPLETION {
+    ULONG Result;
+    ULONG Reserved;
+    USHORT SubmissionHead;
+    USHORT SubmissionQueueId;
+    USHORT CommandId;
+    USHORT Status;
+} PACKED NVME_COMPLETION, *PNVME_COMPLETION;
+
+/*++
+
+Structure Description:
+
+    This structure defines a scatter gather list descriptor. This structure
+    is hardware defined.
+
+Members:
+
+    Address - Stores the physical address of the data or next segment.
+
+    Length - Stores the length of the data or segment in bytes.
+
+    Reserved - Stores reserved bytes. Set to zero.
+
+    Identifier - Stores the descriptor type. See NVME_SGL_* definitions.
+
+--*/
+
+typedef struct _NVME_SGL_DESCRIPTOR {
+    ULONGLONG Address;
+    ULONG Length;
+    UCHAR Reserved[3];
+    UCHAR Identifier;
+} PACKED NVME_SGL_DESCRIPTOR, *PNVME_SGL_DESCRIPTOR;
+
+/*++
+
+Structure Description:
+
+    This structure defines state associated with an NVMe namespace, which is
+    exposed as a disk.
+
+Members:
+
+    Type - Stores a marker identifying the structure as a namespace.
+
+    Controller - Stores a pointer to the parent controller.
+
+    OsDevice - Stores a pointer to the OS device for the namespace.
+
+    NamespaceId - Stores the NVMe namespace identifier.
+
+    BlockShift - Stores the log2 of the block size.
+
+    BlockCount - Stores the number of blocks in the namespace.
+
+--*/
+
+typedef struct _NVME_NAMESPACE {
+    NVME_CONTEXT_TYPE Type;
+    PNVME_CONTROLLER Controller;
+    PDEVICE OsDevice;
+    ULONG NamespaceId;
+    ULONG BlockShift;
+    ULONGLONG BlockCount;
+} NVME_NAMESPACE, *PNVME_NAMESPACE;
+
+/*++
+
+Structure Description:
+
+    This structure defines state associated with an in-flight command.
+
+Members:
+
+    Irp - Stores a pointer to the IRP the command is working on.
+
+    Namespace - Stores a pointer to the namespace the IRP is destined for.
+
+    IoSize - Stores the number of bytes the command is transferring.
+
+    List - Stores the virtual address of the command's PRP or SGL list page.
+
+    ListPhysical - Stores the physical address of the list page.
+
+--*/
+
+typedef struct _NVME_COMMAND_STATE {
+    PIRP Irp;
+    PNVME_NAMESPACE Namespace;
+    UINTN IoSize;
+    PVOID List;
+    PHYSICAL_ADDRESS ListPhysical;
+} NVME_COMMAND_STATE, *PNVME_COMMAND_STATE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a submission and completion queue pair.
+
+Members:
+
+    Controller - Stores a pointer to the controller.
+
+    QueueId - Stores the queue identifier. Zero is the admin queue.
+
+    Depth - Stores the number of entries in each queue.
+
+    IoBuffer - Stores the I/O buffer holding the submission and completion
+        queues.
+
+    Submission - Stores the submission queue entries.
+
+    Completion - Stores the completion queue entries.
+
+    SubmissionPhysical - Stores the physical address of the submission queue.
+
+    CompletionPhysical - Stores the physical address of the completion queue.
+
+    SubmissionTail - Stores the index of the next submission entry to fill.
+
+    CompletionHead - Stores the index of the next completion entry to read.
+
+    Phase - Stores the phase tag that marks new completion entries.
+
+    ListIoBuffer - Stores the I/O buffer holding one PRP or SGL list page
+        per command.
+
+    CommandState - Stores the array of command states, indexed by command ID.
+
+    FreeCommands - Stores the bitmask of free command IDs.
+
+    Lock - Stores the spin lock serializing the queue. It is acquired at
+        dispatch level.
+
+    IrpQueue - Stores the list of IRPs waiting for a free command.
+
+    InterruptVector - Stores the interrupt vector for the queue.
+
+    InterruptHandle - Stores the handle of the connected interrupt.
+
+    PendingInterrupt - Stores a boolean set by the interrupt service routine.
+
+--*/
+
+typedef struct _NVME_QUEUE {
+    PNVME_CONTROLLER Controller;
+    USHORT QueueId;
+    USHORT Depth;
+    PIO_BUFFER IoBuffer;
+    volatile NVME_COMMAND *Submission;
+    volatile NVME_COMPLETION *Completion;
+    PHYSICAL_ADDRESS SubmissionPhysical;
+    PHYSICAL_ADDRESS CompletionPhysical;
+    USHORT SubmissionTail;
+    USHORT CompletionHead;
+    USHORT Phase;
+    PIO_BUFFER ListIoBuffer;
+    PNVME_COMMAND_STATE CommandState;
+    ULONGLONG FreeCommands;
+    KSPIN_LOCK Lock;
+    LIST_ENTRY IrpQueue;
+    ULONGLONG InterruptVector;
+    HANDLE InterruptHandle;
+    volatile ULONG PendingInterrupt;
+} NVME_QUEUE, *PNVME_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines state associated with an NVMe controller.
+
+Members:
+
+    Type - Stores a value identifying this structure as a controller.
+
+    ControllerBase - Stores the mapping to the controller registers.
+
+    OsDevice - Stores a pointer to the controller's OS device.
+
+    InterruptLine - Stores the interrupt line if a line interrupt is in use,
+        or INVALID_INTERRUPT_LINE if MSI-X is in use.
+
+    InterruptVector - Stores the line interrupt's vector.
+
+    InterruptResourcesFound - Stores a boolean indicating if a line interrupt
+        was allocated.
+
+    PciMsiFlags - Stores a bitmask of MSI state. See NVME_PCI_MSI_FLAG_*.
+
+    PciMsiInterface - Stores the PCI MSI interface.
+
+    MsiVectorCount - Stores the number of MSI-X vectors allocated.
+
+    MsiVectors - Stores the allocated MSI-X vectors.
+
+    Capabilities - Stores the capabilities register.
+
+    DoorbellStride - Stores the distance between doorbells in bytes.
+
+    ReadyTimeout - Stores the number of time counter ticks to wait for the
+        controller to change its ready state.
+
+    MaxTransferSize - Stores the maximum number of bytes a single command can
+        transfer.
+
+    NamespaceCount - Stores the number of namespaces the controller reports.
+
+    Flags - Stores a bitmask of flags. See NVME_CONTROLLER_FLAG_*.
+
+    AdminLock - Stores the lock serializing admin commands.
+
+    AdminQueue - Stores the admin queue pair. It is used synchronously.
+
+    AdminCommandId - Stores the next admin command identifier.
+
+    IdentifyBuffer - Stores a page used to receive identify data.
+
+    IoQueues - Stores the array of I/O queue pairs.
+
+    IoQueueCount - Stores the number of I/O queue pairs.
+
+    Namespaces - Stores pointers to the namespaces found.
+
+--*/
+
+struct _NVME_CONTROLLER {
+    NVME_CONTEXT_TYPE Type;
+    PVOID ControllerBase;
+    PDEVICE OsDevice;
+    ULONGLONG InterruptLine;
+    ULONGLONG InterruptVector;
+    BOOL InterruptResourcesFound;
+    ULONG PciMsiFlags;
+    INTERFACE_PCI_MSI PciMsiInterface;
+    ULONG MsiVectorCount;
+    ULONGLONG MsiVectors[NVME_MAX_IO_QUEUES];
+    ULONGLONG Capabilities;
+    ULONG DoorbellStride;
+    ULONGLONG ReadyTimeout;
+    UINTN MaxTransferSize;
+    ULONG NamespaceCount;
+    ULONG Flags;
+    PQUEUED_LOCK AdminLock;
+    NVME_QUEUE AdminQueue;
+    USHORT AdminCommandId;
+    PIO_BUFFER IdentifyBuffer;
+    PNVME_QUEUE IoQueues;
+    ULONG IoQueueCount;
+    PNVME_NAMESPACE Namespaces[NVME_MAX_NAMESPACES];
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+extern PDRIVER NvmeDriver;
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+INTERRUPT_STATUS
+NvmeInterruptService (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the NVMe interrupt service routine for an I/O
+    queue.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the I/O queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+NvmeInterruptServiceDpc (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the NVMe dispatch level interrupt service, which
+    reaps completions from an I/O queue.
+
+Arguments:
+
+    Parameter - Supplies the context, in this case the I/O queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+KSTATUS
+NvmepInitializeController (
+    PNVME_CONTROLLER Controller,
+    ULONG QueueCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the controller, brings up the admin queue, and
+    creates the I/O queues.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    QueueCount - Supplies the number of I/O queues the caller has interrupt
+        vectors for.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+NvmepDestroyController (
+    PNVME_CONTROLLER Controller
+    );
+
+/*++
+
+Routine Description:
+
+    This routine disables the controller and frees its queues.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+NvmepIdentifyNamespace (
+    PNVME_CONTROLLER Controller,
+    ULONG NamespaceId,
+    PULONG BlockShift,
+    PULONGLONG BlockCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine identifies a namespace.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    NamespaceId - Supplies the namespace to identify.
+
+    BlockShift - Supplies a pointer where the log2 of the block size is
+        returned.
+
+    BlockCount - Supplies a pointer where the number of blocks is returned.
+        This is zero if the namespace is inactive.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the namespace is formatted in a way the driver
+    cannot use.
+
+    Other error codes on failure.
+
+--*/
+
+KSTATUS
+NvmepEnqueueIrp (
+    PNVME_NAMESPACE Namespace,
+    PIRP Irp
+    );
+
+/*++
+
+Routine Description:
+
+    This routine begins I/O on a fresh IRP, using the current processor's I/O
+    queue.
+
+Arguments:
+
+    Namespace - Supplies a pointer to the namespace.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was successfully started or even queued.
+
+    Error code on failure.
+
+--*/
@@ -0,0 +1,2154 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    nvmehw.c
+
+Abstract:
+
+    This module implements the hardware support for NVMe controllers: queue
+    management, admin commands, and the I/O path.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "nvme.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro determines whether or not the next entry in the given completion
+// queue has been posted by the controller.
+//
+
+#define NVME_COMPLETION_PENDING(_Queue)                                  \
+    (NVME_COMPLETION_PHASE(                                              \
+        (_Queue)->Completion[(_Queue)->CompletionHead].Status) ==        \
+     (_Queue)->Phase)
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+NvmepAllocateQueue (
+    PNVME_CONTROLLER Controller,
+    PNVME_QUEUE Queue,
+    USHORT QueueId,
+    USHORT Depth
+    );
+
+VOID
+NvmepFreeQueue (
+    PNVME_QUEUE Queue
+    );
+
+KSTATUS
+NvmepWaitForReady (
+    PNVME_CONTROLLER Controller,
+    BOOL Ready
+    );
+
+KSTATUS
+NvmepIdentifyController (
+    PNVME_CONTROLLER Controller
+    );
+
+KSTATUS
+NvmepCreateIoQueues (
+    PNVME_CONTROLLER Controller,
+    ULONG QueueCount
+    );
+
+KSTATUS
+NvmepExecuteAdminCommand (
+    PNVME_CONTROLLER Controller,
+    PNVME_COMMAND Command,
+    PULONG Result
+    );
+
+VOID
+NvmepSubmitCommand (
+    PNVME_QUEUE Queue,
+    PNVME_COMMAND Command
+    );
+
+VOID
+NvmepProcessCompletions (
+    PNVME_QUEUE Queue
+    );
+
+LONG
+NvmepAllocateCommand (
+    PNVME_QUEUE Queue
+    );
+
+VOID
+NvmepFreeCommand (
+    PNVME_QUEUE Queue,
+    LONG CommandId
+    );
+
+VOID
+NvmepBeginNextIrp (
+    PNVME_QUEUE Queue,
+    LONG CommandId
+    );
+
+VOID
+NvmepStartIrp (
+    PNVME_QUEUE Queue,
+    PNVME_NAMESPACE Namespace,
+    PIRP Irp,
+    LONG CommandId
+    );
+
+VOID
+NvmepPerformIo (
+    PNVME_QUEUE Queue,
+    PIRP Irp,
+    LONG CommandId
+    );
+
+UINTN
+NvmepBuildPrpList (
+    PNVME_COMMAND_STATE State,
+    PIO_BUFFER IoBuffer,
+    UINTN FragmentIndex,
+    UINTN FragmentOffset,
+    UINTN TransferSize,
+    PNVME_COMMAND Command,
+    PBOOL Incompatible
+    );
+
+UINTN
+NvmepBuildSglList (
+    PNVME_COMMAND_STATE State,
+    PIO_BUFFER IoBuffer,
+    UINTN FragmentIndex,
+    UINTN FragmentOffset,
+    UINTN TransferSize,
+    PNVME_COMMAND Command
+    );
+
+VOID
+NvmepExecuteFlush (
+    PNVME_QUEUE Queue,
+    LONG CommandId
+    );
+
+PNVME_NAMESPACE
+NvmepGetIrpNamespace (
+    PNVME_CONTROLLER Controller,
+    PIRP Irp
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+INTERRUPT_STATUS
+NvmeInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the NVMe interrupt service routine for an I/O
+    queue.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the I/O queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PNVME_CONTROLLER Controller;
+    PNVME_QUEUE Queue;
+
+    Queue = (PNVME_QUEUE)Context;
+    Controller = Queue->Controller;
+
+    //
+    // MSI-X vectors are not shared, so the interrupt is always for this
+    // queue.
+    //
+
+    if (Controller->MsiVectorCount != 0) {
+        RtlAtomicExchange32(&(Queue->PendingInterrupt), TRUE);
+        return InterruptStatusClaimed;
+    }
+
+    //
+    // The line may be shared. NVMe has no interrupt status register, so look
+    // for new completion entries. The admin queue also interrupts on this
+    // line.
+    //
+
+    if ((!NVME_COMPLETION_PENDING(Queue)) &&
+        (!NVME_COMPLETION_PENDING(&(Controller->AdminQueue)))) {
+
+        return InterruptStatusNotClaimed;
+    }
+
+    //
+    // Mask the interrupt until the completions have been reaped, otherwise
+    // the level-triggered line keeps firing.
+    //
+
+    NVME_WRITE(Controller,
+               NvmeRegisterInterruptMaskSet,
+               NVME_INTERRUPT_MASK_VECTOR0);
+
+    RtlAtomicExchange32(&(Queue->PendingInterrupt), TRUE);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+NvmeInterruptServiceDpc (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the NVMe dispatch level interrupt service, which
+    reaps completions from an I/O queue.
+
+Arguments:
+
+    Parameter - Supplies the context, in this case the I/O queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PNVME_CONTROLLER Controller;
+    PNVME_QUEUE Queue;
+
+    Queue = (PNVME_QUEUE)Parameter;
+    Controller = Queue->Controller;
+    if (RtlAtomicExchange32(&(Queue->PendingInterrupt), FALSE) == FALSE) {
+        return InterruptStatusNotClaimed;
+    }
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+
+    KeAcquireSpinLock(&(Queue->Lock));
+    NvmepProcessCompletions(Queue);
+    KeReleaseSpinLock(&(Queue->Lock));
+
+    //
+    // Unmask the line interrupt unless an admin completion is still waiting
+    // for its poller, which unmasks the interrupt when it is done.
+    //
+
+    if ((Controller->MsiVectorCount == 0) &&
+        (!NVME_COMPLETION_PENDING(&(Controller->AdminQueue)))) {
+
+        NVME_WRITE(Controller,
+                   NvmeRegisterInterruptMaskClear,
+                   NVME_INTERRUPT_MASK_VECTOR0);
+    }
+
+    return InterruptStatusClaimed;
+}
+
+KSTATUS
+NvmepInitializeController (
+    PNVME_CONTROLLER Controller,
+    ULONG QueueCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the controller, brings up the admin queue, and
+    creates the I/O queues.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    QueueCount - Supplies the number of I/O queues the caller has interrupt
+        vectors for.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Attributes;
+    ULONG Configuration;
+    USHORT Depth;
+    ULONGLONG Frequency;
+    KSTATUS Status;
+    ULONG Timeout;
+
+    //
+    // Leave an already running controller alone.
+    //
+
+    if (Controller->IoQueues != NULL) {
+        return STATUS_SUCCESS;
+    }
+
+    KeAcquireQueuedLock(Controller->AdminLock);
+    Controller->Capabilities = NVME_READ64(Controller,
+                                           NvmeRegisterCapabilities);
+
+    if (NVME_CAPABILITY_PAGE_SHIFT_MIN(Controller->Capabilities) >
+        NVME_PAGE_SHIFT) {
+
+        RtlDebugPrint("NVMe: Unsupported minimum page size.\n");
+        Status = STATUS_NOT_SUPPORTED;
+        goto InitializeControllerEnd;
+    }
+
+    Controller->DoorbellStride =
+                     NVME_CAPABILITY_DOORBELL_STRIDE(Controller->Capabilities);
+
+    Timeout = NVME_CAPABILITY_TIMEOUT(Controller->Capabilities);
+    if (Timeout == 0) {
+        Timeout = 1;
+    }
+
+    Frequency = HlQueryTimeCounterFrequency();
+    Controller->ReadyTimeout = (Timeout * NVME_CAPABILITY_TIMEOUT_UNIT *
+                                Frequency) / MILLISECONDS_PER_SECOND;
+
+    //
+    // Disable the controller, which also deletes any queues the firmware may
+    // have left behind.
+    //
+
+    Configuration = NVME_READ(Controller, NvmeRegisterConfiguration);
+    if ((Configuration & NVME_CONFIGURATION_ENABLE) != 0) {
+        Configuration &= ~NVME_CONFIGURATION_ENABLE;
+        NVME_WRITE(Controller, NvmeRegisterConfiguration, Configuration);
+    }
+
+    Status = NvmepWaitForReady(Controller, FALSE);
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("NVMe: Failed to disable controller.\n");
+        goto InitializeControllerEnd;
+    }
+
+    //
+    // Set up the admin queue and enable the controller.
+    //
+
+    Depth = NVME_ADMIN_QUEUE_DEPTH;
+    if (Depth > NVME_CAPABILITY_MAX_QUEUE_ENTRIES(Controller->Capabilities)) {
+        Depth = NVME_CAPABILITY_MAX_QUEUE_ENTRIES(Controller->Capabilities);
+    }
+
+    if (Controller->AdminQueue.IoBuffer == NULL) {
+        Status = NvmepAllocateQueue(Controller,
+                                    &(Controller->AdminQueue),
+                                    0,
+                                    Depth);
+
+        if (!KSUCCESS(Status)) {
+            goto InitializeControllerEnd;
+        }
+
+    } else {
+        Depth = Controller->AdminQueue.Depth;
+        RtlZeroMemory((PVOID)(Controller->AdminQueue.Completion),
+                      Depth << NVME_COMPLETION_ENTRY_SHIFT);
+
+        Controller->AdminQueue.SubmissionTail = 0;
+        Controller->AdminQueue.CompletionHead = 0;
+        Controller->AdminQueue.Phase = 1;
+    }
+
+    Depth = Controller->AdminQueue.Depth;
+    Attributes = (Depth - 1) | ((Depth - 1) << 16);
+    NVME_WRITE(Controller, NvmeRegisterAdminQueueAttributes, Attributes);
+    NVME_WRITE64(Controller,
+                 NvmeRegisterAdminSubmissionQueue,
+                 Controller->AdminQueue.SubmissionPhysical);
+
+    NVME_WRITE64(Controller,
+                 NvmeRegisterAdminCompletionQueue,
+                 Controller->AdminQueue.CompletionPhysical);
+
+    Configuration = NVME_CONFIGURATION_ENABLE |
+                    ((NVME_PAGE_SHIFT - 12) <<
+                     NVME_CONFIGURATION_PAGE_SIZE_SHIFT) |
+                    (NVME_SUBMISSION_ENTRY_SHIFT <<
+                     NVME_CONFIGURATION_SUBMISSION_ENTRY_SHIFT) |
+                    (NVME_COMPLETION_ENTRY_SHIFT <<
+                     NVME_CONFIGURATION_COMPLETION_ENTRY_SHIFT);
+
+    NVME_WRITE(Controller, NvmeRegisterConfiguration, Configuration);
+    Status = NvmepWaitForReady(Controller, TRUE);
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("NVMe: Failed to enable controller.\n");
+        goto InitializeControllerEnd;
+    }
+
+    if (Controller->IdentifyBuffer == NULL) {
+        Controller->IdentifyBuffer = MmAllocateNonPagedIoBuffer(
+                                         0,
+                                         MAX_ULONGLONG,
+                                         NVME_PAGE_SIZE,
+                                         NVME_PAGE_SIZE,
+                                         IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+        if (Controller->IdentifyBuffer == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto InitializeControllerEnd;
+        }
+
+        ASSERT(Controller->IdentifyBuffer->FragmentCount == 1);
+    }
+
+    Status = NvmepIdentifyController(Controller);
+    if (!KSUCCESS(Status)) {
+        goto InitializeControllerEnd;
+    }
+
+    Status = NvmepCreateIoQueues(Controller, QueueCount);
+    if (!KSUCCESS(Status)) {
+        goto InitializeControllerEnd;
+    }
+
+InitializeControllerEnd:
+    KeReleaseQueuedLock(Controller->AdminLock);
+    return Status;
+}
+
+VOID
+NvmepDestroyController (
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine disables the controller and frees its queues.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Configuration;
+    ULONG Index;
+
+    //
+    // Disabling the controller implicitly deletes all the I/O queues.
+    //
+
+    if ((Controller->ControllerBase != NULL) &&
+        (Controller->AdminQueue.IoBuffer != NULL)) {
+
+        Configuration = NVME_READ(Controller, NvmeRegisterConfiguration);
+        Configuration &= ~NVME_CONFIGURATION_ENABLE;
+        NVME_WRITE(Controller, NvmeRegisterConfiguration, Configuration);
+        NvmepWaitForReady(Controller, FALSE);
+    }
+
+    if (Controller->IoQueues != NULL) {
+        for (Index = 0; Index < Controller->IoQueueCount; Index += 1) {
+            NvmepFreeQueue(&(Controller->IoQueues[Index]));
+        }
+
+        MmFreeNonPagedPool(Controller->IoQueues);
+        Controller->IoQueues = NULL;
+        Controller->IoQueueCount = 0;
+    }
+
+    NvmepFreeQueue(&(Controller->AdminQueue));
+    if (Controller->IdentifyBuffer != NULL) {
+        MmFreeIoBuffer(Controller->IdentifyBuffer);
+        Controller->IdentifyBuffer = NULL;
+    }
+
+    return;
+}
+
+KSTATUS
+NvmepIdentifyNamespace (
+    PNVME_CONTROLLER Controller,
+    ULONG NamespaceId,
+    PULONG BlockShift,
+    PULONGLONG BlockCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine identifies a namespace.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    NamespaceId - Supplies the namespace to identify.
+
+    BlockShift - Supplies a pointer where the log2 of the block size is
+        returned.
+
+    BlockCount - Supplies a pointer where the number of blocks is returned.
+        This is zero if the namespace is inactive.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the namespace is formatted in a way the driver
+    cannot use.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    NVME_COMMAND Command;
+    PUCHAR Data;
+    ULONG Format;
+    ULONG FormatIndex;
+    ULONG Shift;
+    KSTATUS Status;
+
+    *BlockShift = 0;
+    *BlockCount = 0;
+    if (Controller->IdentifyBuffer == NULL) {
+        return STATUS_NOT_READY;
+    }
+
+    KeAcquireQueuedLock(Controller->AdminLock);
+    Data = Controller->IdentifyBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(Data, NVME_PAGE_SIZE);
+    RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+    Command.Command = NVME_ADMIN_IDENTIFY;
+    Command.NamespaceId = NamespaceId;
+    Command.DataPointer[0] =
+                       Controller->IdentifyBuffer->Fragment[0].PhysicalAddress;
+
+    Command.CommandDword[0] = NVME_IDENTIFY_NAMESPACE;
+    Status = NvmepExecuteAdminCommand(Controller, &Command, NULL);
+    if (!KSUCCESS(Status)) {
+        goto IdentifyNamespaceEnd;
+    }
+
+    //
+    // An inactive namespace returns all zeroes.
+    //
+
+    *BlockCount = *((PULONGLONG)(Data + NVME_IDENTIFY_NAMESPACE_SIZE));
+    if (*BlockCount == 0) {
+        goto IdentifyNamespaceEnd;
+    }
+
+    FormatIndex = Data[NVME_IDENTIFY_NAMESPACE_FORMATTED_SIZE] &
+                  NVME_FORMAT_INDEX_MASK;
+
+    Format = *((PULONG)(Data + NVME_IDENTIFY_NAMESPACE_FORMATS +
+                        (FormatIndex * sizeof(ULONG))));
+
+    //
+    // The block must fit in a page so that page-aligned PRP entries always
+    // land on block boundaries. Formats with metadata are not supported.
+    //
+
+    Shift = NVME_FORMAT_BLOCK_SHIFT(Format);
+    if (((Format & NVME_FORMAT_METADATA_SIZE_MASK) != 0) ||
+        (Shift < 9) ||
+        (Shift > NVME_PAGE_SHIFT)) {
+
+        *BlockCount = 0;
+        Status = STATUS_NOT_SUPPORTED;
+        goto IdentifyNamespaceEnd;
+    }
+
+    *BlockShift = Shift;
+
+IdentifyNamespaceEnd:
+    KeReleaseQueuedLock(Controller->AdminLock);
+    return Status;
+}
+
+KSTATUS
+NvmepEnqueueIrp (
+    PNVME_NAMESPACE Namespace,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine begins I/O on a fresh IRP, using the current processor's I/O
+    queue.
+
+Arguments:
+
+    Namespace - Supplies a pointer to the namespace.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was successfully started or even queued.
+
+    Error code on failure.
+
+--*/
+
+{
+
+    LONG CommandId;
+    PNVME_CONTROLLER Controller;
+    RUNLEVEL OldRunLevel;
+    PNVME_QUEUE Queue;
+    ULONG QueueIndex;
+    KSTATUS Status;
+
+    Controller = Namespace->Controller;
+    if ((Controller->IoQueues == NULL) || (Namespace->BlockCount == 0)) {
+        return STATUS_NO_SUCH_DEVICE;
+    }
+
+    IoPendIrp(NvmeDriver, Irp);
+
+    //
+    // Pick the queue belonging to this processor. The queue's interrupt is
+    // steered back to the same processor, so the completion stays local.
+    // Raise to dispatch first so the thread cannot migrate in between.
+    //
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    QueueIndex = KeGetCurrentProcessorNumber() % Controller->IoQueueCount;
+    Queue = &(Controller->IoQueues[QueueIndex]);
+    KeAcquireSpinLock(&(Queue->Lock));
+
+    //
+    // Attempt to grab a command. If they are all in use, add this IRP to the
+    // queue atomically so it's always clear who is taking care of it.
+    //
+
+    CommandId = NvmepAllocateCommand(Queue);
+    if (CommandId < 0) {
+        INSERT_BEFORE(&(Irp->ListEntry), &(Queue->IrpQueue));
+        Status = STATUS_SUCCESS;
+        goto EnqueueIrpEnd;
+    }
+
+    NvmepStartIrp(Queue, Namespace, Irp, CommandId);
+    Status = STATUS_SUCCESS;
+
+EnqueueIrpEnd:
+    KeReleaseSpinLock(&(Queue->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+NvmepAllocateQueue (
+    PNVME_CONTROLLER Controller,
+    PNVME_QUEUE Queue,
+    USHORT QueueId,
+    USHORT Depth
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates the memory for a submission and completion queue
+    pair. I/O queues also get their command state and a list page per
+    command.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    Queue - Supplies a pointer to the queue to initialize.
+
+    QueueId - Supplies the queue identifier. Zero is the admin queue.
+
+    Depth - Supplies the number of entries in each queue.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG CommandCount;
+    UINTN CompletionOffset;
+    UINTN CompletionSize;
+    PIO_BUFFER_FRAGMENT Fragment;
+    UINTN FragmentIndex;
+    UINTN FragmentOffset;
+    ULONG Index;
+    PIO_BUFFER IoBuffer;
+    PIO_BUFFER ListIoBuffer;
+    UINTN Size;
+    PNVME_COMMAND_STATE State;
+    KSTATUS Status;
+    PUCHAR VirtualAddress;
+
+    ASSERT((Depth >= 2) && (Depth <= NVME_IO_QUEUE_DEPTH));
+
+    Queue->Controller = Controller;
+    Queue->QueueId = QueueId;
+    Queue->Depth = Depth;
+    Queue->SubmissionTail = 0;
+    Queue->CompletionHead = 0;
+    Queue->Phase = 1;
+    CompletionOffset = ALIGN_RANGE_UP(Depth << NVME_SUBMISSION_ENTRY_SHIFT,
+                                      NVME_PAGE_SIZE);
+
+    CompletionSize = ALIGN_RANGE_UP(Depth << NVME_COMPLETION_ENTRY_SHIFT,
+                                    NVME_PAGE_SIZE);
+
+    Size = CompletionOffset + CompletionSize;
+    IoBuffer = MmAllocateNonPagedIoBuffer(0,
+                                          MAX_ULONGLONG,
+                                          NVME_PAGE_SIZE,
+                                          Size,
+                                          IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+    if (IoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    ASSERT(IoBuffer->FragmentCount == 1);
+
+    Queue->IoBuffer = IoBuffer;
+    VirtualAddress = IoBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(VirtualAddress, Size);
+    Queue->Submission = (volatile NVME_COMMAND *)VirtualAddress;
+    Queue->Completion =
+              (volatile NVME_COMPLETION *)(VirtualAddress + CompletionOffset);
+
+    Queue->SubmissionPhysical = IoBuffer->Fragment[0].PhysicalAddress;
+    Queue->CompletionPhysical = Queue->SubmissionPhysical + CompletionOffset;
+
+    //
+    // The admin queue is used synchronously and needs nothing else.
+    //
+
+    if (QueueId == 0) {
+        Status = STATUS_SUCCESS;
+        goto AllocateQueueEnd;
+    }
+
+    //
+    // Leave one submission entry unused so the submission queue can never
+    // overflow, even without looking at the reported head.
+    //
+
+    CommandCount = Depth - 1;
+    Queue->CommandState = MmAllocateNonPagedPool(
+                                  CommandCount * sizeof(NVME_COMMAND_STATE),
+                                  NVME_ALLOCATION_TAG);
+
+    if (Queue->CommandState == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    RtlZeroMemory(Queue->CommandState,
+                  CommandCount * sizeof(NVME_COMMAND_STATE));
+
+    ListIoBuffer = MmAllocateNonPagedIoBuffer(0,
+                                              MAX_ULONGLONG,
+                                              NVME_PAGE_SIZE,
+                                              CommandCount * NVME_PAGE_SIZE,
+                                              0);
+
+    if (ListIoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    Queue->ListIoBuffer = ListIoBuffer;
+
+    //
+    // Hand out a list page to each command. Fragments are page multiples, so
+    // a page never straddles two fragments.
+    //
+
+    FragmentIndex = 0;
+    FragmentOffset = 0;
+    for (Index = 0; Index < CommandCount; Index += 1) {
+
+        ASSERT(FragmentIndex < ListIoBuffer->FragmentCount);
+
+        Fragment = &(ListIoBuffer->Fragment[FragmentIndex]);
+        State = &(Queue->CommandState[Index]);
+        State->List = Fragment->VirtualAddress + FragmentOffset;
+        State->ListPhysical = Fragment->PhysicalAddress + FragmentOffset;
+        FragmentOffset += NVME_PAGE_SIZE;
+        if (FragmentOffset >= Fragment->Size) {
+            FragmentIndex += 1;
+            FragmentOffset = 0;
+        }
+    }
+
+    Queue->FreeCommands = (1ULL << CommandCount) - 1;
+    Status = STATUS_SUCCESS;
+
+AllocateQueueEnd:
+    if (!KSUCCESS(Status)) {
+        NvmepFreeQueue(Queue);
+    }
+
+    return Status;
+}
+
+VOID
+NvmepFreeQueue (
+    PNVME_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the memory associated with a queue pair. The
+    controller must already be done with it.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(LIST_EMPTY(&(Queue->IrpQueue)) != FALSE);
+
+    if (Queue->IoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->IoBuffer);
+        Queue->IoBuffer = NULL;
+    }
+
+    if (Queue->ListIoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->ListIoBuffer);
+        Queue->ListIoBuffer = NULL;
+    }
+
+    if (Queue->CommandState != NULL) {
+        MmFreeNonPagedPool(Queue->CommandState);
+        Queue->CommandState = NULL;
+    }
+
+    Queue->Submission = NULL;
+    Queue->Completion = NULL;
+    Queue->FreeCommands = 0;
+    return;
+}
+
+KSTATUS
+NvmepWaitForReady (
+    PNVME_CONTROLLER Controller,
+    BOOL Ready
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for the controller's ready bit to reach the given
+    state.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    Ready - Supplies a boolean indicating whether to wait for the controller
+        to become ready (TRUE) or not ready (FALSE).
+
+Return Value:
+
+    STATUS_SUCCESS if the controller reached the desired state.
+
+    STATUS_DEVICE_IO_ERROR if the controller reported a fatal error.
+
+    STATUS_TIMEOUT if the controller did not respond in time.
+
+--*/
+
+{
+
+    ULONG Status;
+    ULONGLONG Timeout;
+
+    Timeout = HlQueryTimeCounter() + Controller->ReadyTimeout;
+    while (TRUE) {
+        Status = NVME_READ(Controller, NvmeRegisterStatus);
+        if ((Ready != FALSE) && ((Status & NVME_STATUS_FATAL) != 0)) {
+            return STATUS_DEVICE_IO_ERROR;
+        }
+
+        if (((Status & NVME_STATUS_READY) != 0) == (Ready != FALSE)) {
+            break;
+        }
+
+        if (HlQueryTimeCounter() > Timeout) {
+            return STATUS_TIMEOUT;
+        }
+
+        KeDelayExecution(FALSE, FALSE, MICROSECONDS_PER_MILLISECOND);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+NvmepIdentifyController (
+    PNVME_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends an identify controller command and records the
+    transfer limits, SGL support, and namespace count. The admin lock must be
+    held.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    NVME_COMMAND Command;
+    PUCHAR Data;
+    UCHAR MaxTransferShift;
+    UINTN MaxTransferSize;
+    ULONG SglSupport;
+    KSTATUS Status;
+
+    Data = Controller->IdentifyBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+    Command.Command = NVME_ADMIN_IDENTIFY;
+    Command.DataPointer[0] =
+                       Controller->IdentifyBuffer->Fragment[0].PhysicalAddress;
+
+    Command.CommandDword[0] = NVME_IDENTIFY_CONTROLLER;
+    Status = NvmepExecuteAdminCommand(Controller, &Command, NULL);
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("NVMe: Identify controller failed: %d\n", Status);
+        return Status;
+    }
+
+    //
+    // A single command is limited by the one PRP list page it owns. The
+    // controller's own limit is in units of its minimum page size.
+    //
+
+    MaxTransferSize = NVME_PRP_LIST_COUNT * NVME_PAGE_SIZE;
+    MaxTransferShift = Data[NVME_IDENTIFY_CONTROLLER_MAX_TRANSFER];
+    if ((MaxTransferShift != 0) &&
+        ((MaxTransferShift +
+          NVME_CAPABILITY_PAGE_SHIFT_MIN(Controller->Capabilities)) <
+         (sizeof(UINTN) * BITS_PER_BYTE))) {
+
+        MaxTransferShift +=
+                      NVME_CAPABILITY_PAGE_SHIFT_MIN(Controller->Capabilities);
+
+        if (((UINTN)1 << MaxTransferShift) < MaxTransferSize) {
+            MaxTransferSize = (UINTN)1 << MaxTransferShift;
+        }
+    }
+
+    Controller->MaxTransferSize = MaxTransferSize;
+    SglSupport = *((PULONG)(Data + NVME_IDENTIFY_CONTROLLER_SGL_SUPPORT));
+    if ((SglSupport & NVME_SGL_SUPPORT_MASK) != 0) {
+        Controller->Flags |= NVME_CONTROLLER_FLAG_SGL_SUPPORTED;
+    }
+
+    Controller->NamespaceCount =
+                 *((PULONG)(Data + NVME_IDENTIFY_CONTROLLER_NAMESPACE_COUNT));
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+NvmepCreateIoQueues (
+    PNVME_CONTROLLER Controller,
+    ULONG QueueCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine negotiates the number of I/O queues with the controller and
+    creates them. The admin lock must be held.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    QueueCount - Supplies the desired number of I/O queue pairs.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Allocated;
+    NVME_COMMAND Command;
+    USHORT Depth;
+    ULONG Index;
+    PNVME_QUEUE Queue;
+    ULONG Result;
+    KSTATUS Status;
+    ULONG Vector;
+
+    ASSERT((QueueCount != 0) && (QueueCount <= NVME_MAX_IO_QUEUES));
+
+    //
+    // Ask for the queues. The controller reports how many it allocated as
+    // zero-based counts.
+    //
+
+    RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+    Command.Command = NVME_ADMIN_SET_FEATURES;
+    Command.CommandDword[0] = NVME_FEATURE_NUMBER_OF_QUEUES;
+    Command.CommandDword[1] = (QueueCount - 1) | ((QueueCount - 1) << 16);
+    Status = NvmepExecuteAdminCommand(Controller, &Command, &Result);
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("NVMe: Set queue count failed: %d\n", Status);
+        return Status;
+    }
+
+    Allocated = (Result & 0xFFFF) + 1;
+    if (Allocated > ((Result >> 16) & 0xFFFF) + 1) {
+        Allocated = ((Result >> 16) & 0xFFFF) + 1;
+    }
+
+    if (QueueCount > Allocated) {
+        QueueCount = Allocated;
+    }
+
+    Depth = NVME_IO_QUEUE_DEPTH;
+    if (Depth > NVME_CAPABILITY_MAX_QUEUE_ENTRIES(Controller->Capabilities)) {
+        Depth = NVME_CAPABILITY_MAX_QUEUE_ENTRIES(Controller->Capabilities);
+    }
+
+    Controller->IoQueues = MmAllocateNonPagedPool(
+                                              QueueCount * sizeof(NVME_QUEUE),
+                                              NVME_ALLOCATION_TAG);
+
+    if (Controller->IoQueues == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Controller->IoQueues, QueueCount * sizeof(NVME_QUEUE));
+    for (Index = 0; Index < QueueCount; Index += 1) {
+        Queue = &(Controller->IoQueues[Index]);
+        Queue->InterruptHandle = INVALID_HANDLE;
+        KeInitializeSpinLock(&(Queue->Lock));
+        INITIALIZE_LIST_HEAD(&(Queue->IrpQueue));
+    }
+
+    //
+    // Create each completion queue followed by its submission queue. With
+    // MSI-X each completion queue gets its own vector, otherwise they all
+    // share the single pin-based vector.
+    //
+
+    for (Index = 0; Index < QueueCount; Index += 1) {
+        Queue = &(Controller->IoQueues[Index]);
+        Status = NvmepAllocateQueue(Controller, Queue, Index + 1, Depth);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        Controller->IoQueueCount += 1;
+        Vector = 0;
+        if (Controller->MsiVectorCount != 0) {
+            Vector = Index;
+        }
+
+        RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+        Command.Command = NVME_ADMIN_CREATE_COMPLETION_QUEUE;
+        Command.DataPointer[0] = Queue->CompletionPhysical;
+        Command.CommandDword[0] = Queue->QueueId | ((Depth - 1) << 16);
+        Command.CommandDword[1] = NVME_QUEUE_PHYSICALLY_CONTIGUOUS |
+                                  NVME_QUEUE_INTERRUPTS_ENABLED |
+                                  (Vector << 16);
+
+        Status = NvmepExecuteAdminCommand(Controller, &Command, NULL);
+        if (!KSUCCESS(Status)) {
+            RtlDebugPrint("NVMe: Create completion queue failed: %d\n",
+                          Status);
+
+            return Status;
+        }
+
+        RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+        Command.Command = NVME_ADMIN_CREATE_SUBMISSION_QUEUE;
+        Command.DataPointer[0] = Queue->SubmissionPhysical;
+        Command.CommandDword[0] = Queue->QueueId | ((Depth - 1) << 16);
+        Command.CommandDword[1] = NVME_QUEUE_PHYSICALLY_CONTIGUOUS |
+                                  (Queue->QueueId << 16);
+
+        Status = NvmepExecuteAdminCommand(Controller, &Command, NULL);
+        if (!KSUCCESS(Status)) {
+            RtlDebugPrint("NVMe: Create submission queue failed: %d\n",
+                          Status);
+
+            return Status;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+NvmepExecuteAdminCommand (
+    PNVME_CONTROLLER Controller,
+    PNVME_COMMAND Command,
+    PULONG Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine submits an admin command and polls for its completion. The
+    admin lock must be held.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    Command - Supplies a pointer to the command. The low byte of the first
+        dword holds the opcode; the command identifier is filled in here.
+
+    Result - Supplies an optional pointer where the command specific result
+        is returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    volatile NVME_COMPLETION *Completion;
+    USHORT CompletionStatus;
+    PNVME_QUEUE Queue;
+    KSTATUS Status;
+    ULONGLONG Timeout;
+
+    ASSERT(KeIsQueuedLockHeld(Controller->AdminLock) != FALSE);
+
+    Queue = &(Controller->AdminQueue);
+    Command->Command = NVME_COMMAND_DWORD0(Command->Command & 0xFF,
+                                           0,
+                                           Controller->AdminCommandId);
+
+    Controller->AdminCommandId += 1;
+    NvmepSubmitCommand(Queue, Command);
+    Timeout = HlQueryTimeCounter() +
+              (NVME_ADMIN_TIMEOUT * HlQueryTimeCounterFrequency());
+
+    while (!NVME_COMPLETION_PENDING(Queue)) {
+        if (HlQueryTimeCounter() > Timeout) {
+            RtlDebugPrint("NVMe: Admin command 0x%x timed out.\n",
+                          Command->Command & 0xFF);
+
+            return STATUS_TIMEOUT;
+        }
+
+        KeYield();
+    }
+
+    RtlMemoryBarrier();
+    Completion = &(Queue->Completion[Queue->CompletionHead]);
+    CompletionStatus = Completion->Status;
+    if (Result != NULL) {
+        *Result = Completion->Result;
+    }
+
+    Queue->CompletionHead += 1;
+    if (Queue->CompletionHead == Queue->Depth) {
+        Queue->CompletionHead = 0;
+        Queue->Phase ^= 1;
+    }
+
+    NVME_WRITE(Controller,
+               NVME_COMPLETION_DOORBELL(Controller, 0),
+               Queue->CompletionHead);
+
+    //
+    // The line interrupt may have been masked by the I/O queue's interrupt
+    // service routine on account of this completion.
+    //
+
+    if (Controller->MsiVectorCount == 0) {
+        NVME_WRITE(Controller,
+                   NvmeRegisterInterruptMaskClear,
+                   NVME_INTERRUPT_MASK_VECTOR0);
+    }
+
+    Status = STATUS_SUCCESS;
+    if (NVME_COMPLETION_STATUS_CODE(CompletionStatus) != 0) {
+        RtlDebugPrint("NVMe: Admin command 0x%x failed: 0x%x\n",
+                      Command->Command & 0xFF,
+                      NVME_COMPLETION_STATUS_CODE(CompletionStatus));
+
+        Status = STATUS_DEVICE_IO_ERROR;
+    }
+
+    return Status;
+}
+
+VOID
+NvmepSubmitCommand (
+    PNVME_QUEUE Queue,
+    PNVME_COMMAND Command
+    )
+
+/*++
+
+Routine Description:
+
+    This routine copies a command into the submission queue and rings the
+    doorbell. The queue must be synchronized by the caller.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Command - Supplies a pointer to the command to submit.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_CONTROLLER Controller;
+
+    Controller = Queue->Controller;
+    RtlCopyMemory((PVOID)&(Queue->Submission[Queue->SubmissionTail]),
+                  Command,
+                  sizeof(NVME_COMMAND));
+
+    Queue->SubmissionTail += 1;
+    if (Queue->SubmissionTail == Queue->Depth) {
+        Queue->SubmissionTail = 0;
+    }
+
+    RtlMemoryBarrier();
+    NVME_WRITE(Controller,
+               NVME_SUBMISSION_DOORBELL(Controller, Queue->QueueId),
+               Queue->SubmissionTail);
+
+    return;
+}
+
+VOID
+NvmepProcessCompletions (
+    PNVME_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reaps all new entries from an I/O completion queue,
+    continuing or completing their IRPs. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL CommandInUse;
+    USHORT CommandId;
+    volatile NVME_COMPLETION *Completion;
+    USHORT CompletionStatus;
+    BOOL CompleteIrp;
+    PNVME_CONTROLLER Controller;
+    UINTN IoSize;
+    PIRP Irp;
+    BOOL Processed;
+    PNVME_COMMAND_STATE State;
+    KSTATUS Status;
+
+    Controller = Queue->Controller;
+    Processed = FALSE;
+    while (NVME_COMPLETION_PENDING(Queue)) {
+
+        //
+        // Don't read the rest of the entry until the phase has been seen.
+        //
+
+        RtlMemoryBarrier();
+        Completion = &(Queue->Completion[Queue->CompletionHead]);
+        CommandId = Completion->CommandId;
+        CompletionStatus = Completion->Status;
+        Queue->CompletionHead += 1;
+        if (Queue->CompletionHead == Queue->Depth) {
+            Queue->CompletionHead = 0;
+            Queue->Phase ^= 1;
+        }
+
+        Processed = TRUE;
+        if ((CommandId >= (Queue->Depth - 1)) ||
+            ((Queue->FreeCommands & (1ULL << CommandId)) != 0)) {
+
+            RtlDebugPrint("NVMe: Spurious completion %d on queue %d.\n",
+                          CommandId,
+                          Queue->QueueId);
+
+            continue;
+        }
+
+        State = &(Queue->CommandState[CommandId]);
+        Irp = State->Irp;
+        IoSize = State->IoSize;
+        State->IoSize = 0;
+        CommandInUse = FALSE;
+        CompleteIrp = TRUE;
+        Status = STATUS_SUCCESS;
+
+        ASSERT(Irp != NULL);
+
+        if (NVME_COMPLETION_STATUS_CODE(CompletionStatus) != 0) {
+            RtlDebugPrint("NVMe: I/O error status: 0x%x\n",
+                          NVME_COMPLETION_STATUS_CODE(CompletionStatus));
+
+            Status = STATUS_DEVICE_IO_ERROR;
+
+        } else if (Irp->MajorCode == IrpMajorIo) {
+            Irp->U.ReadWrite.IoBytesCompleted += IoSize;
+            Irp->U.ReadWrite.NewIoOffset += IoSize;
+
+            //
+            // If the IRP is not finished, queue up the next part on the same
+            // command.
+            //
+
+            if (Irp->U.ReadWrite.IoBytesCompleted <
+                Irp->U.ReadWrite.IoSizeInBytes) {
+
+                NvmepPerformIo(Queue, Irp, CommandId);
+                CommandInUse = TRUE;
+                CompleteIrp = FALSE;
+            }
+        }
+
+        if (CompleteIrp != FALSE) {
+            State->Irp = NULL;
+            IoCompleteIrp(NvmeDriver, Irp, Status);
+        }
+
+        //
+        // Begin the next IRP reusing this command if there's more to do.
+        //
+
+        if (CommandInUse == FALSE) {
+            NvmepBeginNextIrp(Queue, CommandId);
+        }
+    }
+
+    //
+    // Tell the controller how far the queue has been consumed, once for the
+    // whole batch.
+    //
+
+    if (Processed != FALSE) {
+        NVME_WRITE(Controller,
+                   NVME_COMPLETION_DOORBELL(Controller, Queue->QueueId),
+                   Queue->CompletionHead);
+    }
+
+    return;
+}
+
+LONG
+NvmepAllocateCommand (
+    PNVME_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a command identifier. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the command identifier on success.
+
+    -1 if all commands are in use.
+
+--*/
+
+{
+
+    LONG CommandId;
+
+    if (Queue->FreeCommands == 0) {
+        return -1;
+    }
+
+    CommandId = RtlCountTrailingZeros64(Queue->FreeCommands);
+    Queue->FreeCommands &= ~(1ULL << CommandId);
+    return CommandId;
+}
+
+VOID
+NvmepFreeCommand (
+    PNVME_QUEUE Queue,
+    LONG CommandId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a command identifier. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    CommandId - Supplies the command identifier to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT((Queue->FreeCommands & (1ULL << CommandId)) == 0);
+    ASSERT(Queue->CommandState[CommandId].Irp == NULL);
+
+    Queue->FreeCommands |= 1ULL << CommandId;
+    return;
+}
+
+VOID
+NvmepBeginNextIrp (
+    PNVME_QUEUE Queue,
+    LONG CommandId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the next queued IRP on the given command, or frees
+    the command if nothing is waiting. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    CommandId - Supplies the command identifier that just became available.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIRP Irp;
+
+    ASSERT(Queue->CommandState[CommandId].Irp == NULL);
+
+    if (LIST_EMPTY(&(Queue->IrpQueue)) != FALSE) {
+        NvmepFreeCommand(Queue, CommandId);
+        return;
+    }
+
+    Irp = LIST_VALUE(Queue->IrpQueue.Next, IRP, ListEntry);
+    LIST_REMOVE(&(Irp->ListEntry));
+    NvmepStartIrp(Queue,
+                  NvmepGetIrpNamespace(Queue->Controller, Irp),
+                  Irp,
+                  CommandId);
+
+    return;
+}
+
+VOID
+NvmepStartIrp (
+    PNVME_QUEUE Queue,
+    PNVME_NAMESPACE Namespace,
+    PIRP Irp,
+    LONG CommandId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts an IRP on an allocated command. The queue lock must
+    be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Namespace - Supplies a pointer to the namespace the IRP targets.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+    CommandId - Supplies the allocated command identifier.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNVME_COMMAND_STATE State;
+
+    State = &(Queue->CommandState[CommandId]);
+
+    ASSERT(State->Irp == NULL);
+
+    State->Irp = Irp;
+    State->Namespace = Namespace;
+    if (Irp->MajorCode == IrpMajorIo) {
+        NvmepPerformIo(Queue, Irp, CommandId);
+
+    } else {
+
+        ASSERT((Irp->MajorCode == IrpMajorSystemControl) &&
+               (Irp->MinorCode == IrpMinorSystemControlSynchronize));
+
+        NvmepExecuteFlush(Queue, CommandId);
+    }
+
+    return;
+}
+
+VOID
+NvmepPerformIo (
+    PNVME_QUEUE Queue,
+    PIRP Irp,
+    LONG CommandId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills out and submits a read or write command for the next
+    portion of an IRP. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Irp - Supplies a pointer to the read/write IRP.
+
+    CommandId - Supplies the command identifier to use.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG BlockAddress;
+    ULONG BlockCount;
+    ULONG BlockShift;
+    UINTN BytesPreviouslyCompleted;
+    UINTN BytesToComplete;
+    NVME_COMMAND Command;
+    PNVME_CONTROLLER Controller;
+    ULONG Flags;
+    PIO_BUFFER_FRAGMENT Fragment;
+    UINTN FragmentIndex;
+    UINTN FragmentOffset;
+    BOOL Incompatible;
+    PIO_BUFFER IoBuffer;
+    UINTN IoBufferOffset;
+    ULONGLONG IoOffset;
+    UINTN MaxTransferSize;
+    PNVME_NAMESPACE Namespace;
+    UCHAR Opcode;
+    PNVME_COMMAND_STATE State;
+    UINTN TransferSize;
+
+    Controller = Queue->Controller;
+    State = &(Queue->CommandState[CommandId]);
+    Namespace = State->Namespace;
+    BlockShift = Namespace->BlockShift;
+    IoBuffer = Irp->U.ReadWrite.IoBuffer;
+    BytesPreviouslyCompleted = Irp->U.ReadWrite.IoBytesCompleted;
+    BytesToComplete = Irp->U.ReadWrite.IoSizeInBytes;
+    IoOffset = Irp->U.ReadWrite.NewIoOffset;
+
+    ASSERT(BytesPreviouslyCompleted < BytesToComplete);
+    ASSERT(IoOffset == (Irp->U.ReadWrite.IoOffset + BytesPreviouslyCompleted));
+    ASSERT(IS_ALIGNED(IoOffset, 1 << BlockShift) != FALSE);
+    ASSERT(IS_ALIGNED(BytesToComplete, 1 << BlockShift) != FALSE);
+
+    //
+    // Determine the bytes to complete this round.
+    //
+
+    MaxTransferSize = Controller->MaxTransferSize;
+    if (MaxTransferSize > ((UINTN)NVME_MAX_BLOCK_COUNT << BlockShift)) {
+        MaxTransferSize = (UINTN)NVME_MAX_BLOCK_COUNT << BlockShift;
+    }
+
+    TransferSize = BytesToComplete - BytesPreviouslyCompleted;
+    if (TransferSize > MaxTransferSize) {
+        TransferSize = MaxTransferSize;
+    }
+
+    if (TransferSize == 0) {
+        State->Irp = NULL;
+        NvmepFreeCommand(Queue, CommandId);
+        IoCompleteIrp(NvmeDriver, Irp, STATUS_SUCCESS);
+        return;
+    }
+
+    //
+    // Get to the currect spot in the I/O buffer.
+    //
+
+    IoBufferOffset = MmGetIoBufferCurrentOffset(IoBuffer);
+    IoBufferOffset += BytesPreviouslyCompleted;
+    FragmentIndex = 0;
+    FragmentOffset = 0;
+    while (IoBufferOffset != 0) {
+
+        ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        if (IoBufferOffset < Fragment->Size) {
+            FragmentOffset = IoBufferOffset;
+            break;
+        }
+
+        IoBufferOffset -= Fragment->Size;
+        FragmentIndex += 1;
+    }
+
+    //
+    // PRPs are cheapest for the controller, so use them when the buffer is
+    // page-shaped. Fall back to an SGL if the fragments are laid out in a
+    // way PRPs cannot describe, and otherwise transfer what PRPs can
+    // describe and pick up the rest in the next round.
+    //
+
+    RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+    Flags = 0;
+    Incompatible = FALSE;
+    TransferSize = NvmepBuildPrpList(State,
+                                     IoBuffer,
+                                     FragmentIndex,
+                                     FragmentOffset,
+                                     TransferSize,
+                                     &Command,
+                                     &Incompatible);
+
+    if ((Incompatible != FALSE) &&
+        ((Controller->Flags & NVME_CONTROLLER_FLAG_SGL_SUPPORTED) != 0)) {
+
+        TransferSize = BytesToComplete - BytesPreviouslyCompleted;
+        if (TransferSize > MaxTransferSize) {
+            TransferSize = MaxTransferSize;
+        }
+
+        TransferSize = NvmepBuildSglList(State,
+                                         IoBuffer,
+                                         FragmentIndex,
+                                         FragmentOffset,
+                                         TransferSize,
+                                         &Command);
+
+        Flags = NVME_COMMAND_FLAG_SGL;
+    }
+
+    //
+    // If the buffer cannot describe even a single whole block from here (for
+    // example a block split across fragments that neither PRPs nor the SGL
+    // limits can cover), there is no way to make progress. Fail the IRP
+    // rather than submitting a zero length command.
+    //
+
+    TransferSize = ALIGN_RANGE_DOWN(TransferSize, 1 << BlockShift);
+    if (TransferSize == 0) {
+        State->Irp = NULL;
+        NvmepFreeCommand(Queue, CommandId);
+        IoCompleteIrp(NvmeDriver, Irp, STATUS_INVALID_PARAMETER);
+        return;
+    }
+
+    BlockAddress = IoOffset >> BlockShift;
+    BlockCount = TransferSize >> BlockShift;
+    State->IoSize = TransferSize;
+    Opcode = NVME_COMMAND_READ;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        Opcode = NVME_COMMAND_WRITE;
+    }
+
+    Command.Command = NVME_COMMAND_DWORD0(Opcode, Flags, CommandId);
+    Command.NamespaceId = Namespace->NamespaceId;
+    Command.CommandDword[0] = (ULONG)BlockAddress;
+    Command.CommandDword[1] = (ULONG)(BlockAddress >> 32);
+    Command.CommandDword[2] = BlockCount - 1;
+
+    //
+    // Synchronized writes go straight to durable media rather than being
+    // followed by a separate flush.
+    //
+
+    if ((Irp->MinorCode == IrpMinorIoWrite) &&
+        ((Irp->U.ReadWrite.IoFlags & IO_FLAG_DATA_SYNCHRONIZED) != 0)) {
+
+        Command.CommandDword[2] |= NVME_READ_WRITE_FORCE_UNIT_ACCESS;
+    }
+
+    NvmepSubmitCommand(Queue, &Command);
+    return;
+}
+
+UINTN
+NvmepBuildPrpList (
+    PNVME_COMMAND_STATE State,
+    PIO_BUFFER IoBuffer,
+    UINTN FragmentIndex,
+    UINTN FragmentOffset,
+    UINTN TransferSize,
+    PNVME_COMMAND Command,
+    PBOOL Incompatible
+    )
+
+/*++
+
+Routine Description:
+
+    This routine describes as much of the transfer as possible with Physical
+    Region Page entries. Only the first entry may start mid-page, and every
+    segment but the last must end on a page boundary.
+
+Arguments:
+
+    State - Supplies a pointer to the command state, which owns the list
+        page.
+
+    IoBuffer - Supplies a pointer to the I/O buffer.
+
+    FragmentIndex - Supplies the fragment the transfer starts in.
+
+    FragmentOffset - Supplies the offset into that fragment.
+
+    TransferSize - Supplies the number of bytes to describe.
+
+    Command - Supplies a pointer to the command whose data pointer is filled
+        in.
+
+    Incompatible - Supplies a pointer where TRUE is returned if the transfer
+        was cut short because the buffer layout cannot be described with
+        PRPs.
+
+Return Value:
+
+    Returns the number of bytes described.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Address;
+    UINTN Covered;
+    PHYSICAL_ADDRESS End;
+    UINTN EntryCount;
+    PIO_BUFFER_FRAGMENT Fragment;
+    PULONGLONG List;
+    UINTN PageSize;
+    UINTN Size;
+
+    Covered = 0;
+    EntryCount = 0;
+    List = State->List;
+    *Incompatible = FALSE;
+    while (Covered < TransferSize) {
+
+        ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        Address = Fragment->PhysicalAddress + FragmentOffset;
+        Size = Fragment->Size - FragmentOffset;
+        if (Size > (TransferSize - Covered)) {
+            Size = TransferSize - Covered;
+        }
+
+        //
+        // Everything after the first entry has to start on a page.
+        //
+
+        if ((Covered != 0) &&
+            (IS_ALIGNED(Address, NVME_PAGE_SIZE) == FALSE)) {
+
+            *Incompatible = TRUE;
+            break;
+        }
+
+        End = Address + Size;
+        while (Address < End) {
+            PageSize = NVME_PAGE_SIZE - REMAINDER(Address, NVME_PAGE_SIZE);
+            if (PageSize > (End - Address)) {
+                PageSize = End - Address;
+            }
+
+            if (Covered == 0) {
+                Command->DataPointer[0] = Address;
+
+            } else {
+                if (EntryCount == NVME_PRP_LIST_COUNT) {
+                    goto BuildPrpListEnd;
+                }
+
+                List[EntryCount] = Address;
+                EntryCount += 1;
+            }
+
+            Covered += PageSize;
+            Address += PageSize;
+        }
+
+        //
+        // A segment ending mid-page must be the last one.
+        //
+
+        if ((Covered < TransferSize) &&
+            (IS_ALIGNED(End, NVME_PAGE_SIZE) == FALSE)) {
+
+            *Incompatible = TRUE;
+            break;
+        }
+
+        FragmentIndex += 1;
+        FragmentOffset = 0;
+    }
+
+BuildPrpListEnd:
+
+    //
+    // A single extra page goes directly in the second pointer. More than
+    // that needs the list.
+    //
+
+    if (EntryCount == 1) {
+        Command->DataPointer[1] = List[0];
+
+    } else if (EntryCount > 1) {
+        Command->DataPointer[1] = State->ListPhysical;
+    }
+
+    return Covered;
+}
+
+UINTN
+NvmepBuildSglList (
+    PNVME_COMMAND_STATE State,
+    PIO_BUFFER IoBuffer,
+    UINTN FragmentIndex,
+    UINTN FragmentOffset,
+    UINTN TransferSize,
+    PNVME_COMMAND Command
+    )
+
+/*++
+
+Routine Description:
+
+    This routine describes the transfer with a scatter gather list, merging
+    physically contiguous fragments into a single data block descriptor.
+
+Arguments:
+
+    State - Supplies a pointer to the command state, which owns the list
+        page.
+
+    IoBuffer - Supplies a pointer to the I/O buffer.
+
+    FragmentIndex - Supplies the fragment the transfer starts in.
+
+    FragmentOffset - Supplies the offset into that fragment.
+
+    TransferSize - Supplies the number of bytes to describe.
+
+    Command - Supplies a pointer to the command whose data pointer is filled
+        in.
+
+Return Value:
+
+    Returns the number of bytes described.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Address;
+    UINTN Covered;
+    PNVME_SGL_DESCRIPTOR Descriptor;
+    UINTN DescriptorCount;
+    PIO_BUFFER_FRAGMENT Fragment;
+    PNVME_SGL_DESCRIPTOR List;
+    UINTN Size;
+
+    Covered = 0;
+    DescriptorCount = 0;
+    Descriptor = NULL;
+    List = State->List;
+    while (Covered < TransferSize) {
+
+        ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        Address = Fragment->PhysicalAddress + FragmentOffset;
+        Size = Fragment->Size - FragmentOffset;
+        if (Size > (TransferSize - Covered)) {
+            Size = TransferSize - Covered;
+        }
+
+        if ((Descriptor != NULL) &&
+            ((Descriptor->Address + Descriptor->Length) == Address) &&
+            ((Descriptor->Length + Size) <= MAX_ULONG)) {
+
+            Descriptor->Length += Size;
+
+        } else {
+            if (DescriptorCount == NVME_SGL_LIST_COUNT) {
+                break;
+            }
+
+            Descriptor = &(List[DescriptorCount]);
+            RtlZeroMemory(Descriptor, sizeof(NVME_SGL_DESCRIPTOR));
+            Descriptor->Address = Address;
+            Descriptor->Length = Size;
+            Descriptor->Identifier = NVME_SGL_DATA_BLOCK;
+            DescriptorCount += 1;
+        }
+
+        Covered += Size;
+        FragmentIndex += 1;
+        FragmentOffset = 0;
+    }
+
+    ASSERT(DescriptorCount != 0);
+
+    //
+    // A single descriptor fits in the command itself. Otherwise point at the
+    // list as the last (and only) segment.
+    //
+
+    if (DescriptorCount == 1) {
+        Command->DataPointer[0] = List[0].Address;
+        Command->DataPointer[1] = List[0].Length |
+                                  ((ULONGLONG)NVME_SGL_DATA_BLOCK << 56);
+
+    } else {
+        Command->DataPointer[0] = State->ListPhysical;
+        Command->DataPointer[1] =
+                        (DescriptorCount * sizeof(NVME_SGL_DESCRIPTOR)) |
+                        ((ULONGLONG)NVME_SGL_LAST_SEGMENT << 56);
+    }
+
+    return Covered;
+}
+
+VOID
+NvmepExecuteFlush (
+    PNVME_QUEUE Queue,
+    LONG CommandId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine submits a flush command for the namespace in the command
+    state. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    CommandId - Supplies the command identifier to use.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    NVME_COMMAND Command;
+    PNVME_COMMAND_STATE State;
+
+    State = &(Queue->CommandState[CommandId]);
+    State->IoSize = 0;
+    RtlZeroMemory(&Command, sizeof(NVME_COMMAND));
+    Command.Command = NVME_COMMAND_DWORD0(NVME_COMMAND_FLUSH, 0, CommandId);
+    Command.NamespaceId = State->Namespace->NamespaceId;
+    NvmepSubmitCommand(Queue, &Command);
+    return;
+}
+
+PNVME_NAMESPACE
+NvmepGetIrpNamespace (
+    PNVME_CONTROLLER Controller,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the namespace a queued IRP was sent to.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    Irp - Supplies a pointer to the IRP.
+
+Return Value:
+
+    Returns a pointer to the namespace.
+
+--*/
+
+{
+
+    ULONG Index;
+    PNVME_NAMESPACE Namespace;
+
+    if (Irp->MajorCode == IrpMajorIo) {
+        return Irp->U.ReadWrite.DeviceContext;
+    }
+
+    for (Index = 0; Index < NVME_MAX_NAMESPACES; Index += 1) {
+        Namespace = Controller->Namespaces[Index];
+        if ((Namespace != NULL) && (Namespace->OsDevice == Irp->Device)) {
+            return Namespace;
+        }
+    }
+
+    ASSERT(FALSE);
+
+    return NULL;
+}
+
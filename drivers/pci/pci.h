@@ -213,6 +213,7 @@ Module Name:
 #define PCI_CLASS_MASS_STORAGE_IDE_MASK 0xFF00
 #define PCI_CLASS_MASS_STORAGE_IDE 0x0100
 #define PCI_CLASS_MASS_STORAGE_SATA 0x0601
+#define PCI_CLASS_MASS_STORAGE_NVME 0x0802
 
 #define PCI_CLASS_MULTIMEDIA_AUDIO 0x0300
 
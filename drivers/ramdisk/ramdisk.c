@@ -173,6 +173,7 @@ Return Value:
     CHAR DeviceIdString[11];
     DRIVER_FUNCTION_TABLE FunctionTable;
     PSYSTEM_RESOURCE_HEADER GenericHeader;
+    PDEVICE OsDevice;
     PRAM_DISK_DEVICE RamDiskDevice;
     PSYSTEM_RESOURCE_RAM_DISK RamDiskResource;
     KSTATUS Status;
@@ -241,11 +242,17 @@ Return Value:
                                 DeviceIdString,
                                 DISK_CLASS_ID,
                                 NULL,
-                                NULL);
+                                &OsDevice);
 
         if (!KSUCCESS(Status)) {
             goto DriverEntryEnd;
         }
+
+        //
+        // Seeking is free in memory, so don't bother sorting requests.
+        //
+
+        IoSetDeviceBlockQueuePolicy(OsDevice, BlockQueuePolicyNoop);
     }
 
 DriverEntryEnd:
@@ -1880,6 +1880,8 @@ Return Value:
             goto SlotQueryChildrenEnd;
         }
 
+        IoSetDeviceBlockQueuePolicy(NewDisk->Device, BlockQueuePolicyNoop);
+
         Slot->Disk = NewDisk;
         NewDisk = NULL;
     }
@@ -1868,6 +1868,8 @@ Return Value:
             goto SlotQueryChildrenEnd;
         }
 
+        IoSetDeviceBlockQueuePolicy(NewDisk->Device, BlockQueuePolicyNoop);
+
         //
         // The disk for the slot is all set to go.
         //
@@ -1556,6 +1556,8 @@ Return Value:
             return Status;
         }
 
+        IoSetDeviceBlockQueuePolicy(NewChild->Device, BlockQueuePolicyNoop);
+
         Device->Child = NewChild;
         NewChild = NULL;
     }
@@ -1711,6 +1711,8 @@ Return Value:
             return Status;
         }
 
+        IoSetDeviceBlockQueuePolicy(NewChild->Device, BlockQueuePolicyNoop);
+
         Device->Child = NewChild;
         NewChild = NULL;
     }
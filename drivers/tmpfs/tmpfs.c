@@ -0,0 +1,3079 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    tmpfs.c
+
+Abstract:
+
+    This module implements the temporary file system driver. File data lives
+    only in the page cache. Writes are acknowledged without being stored
+    anywhere until the page cache needs to evict a dirty page, at which point
+    the data is saved to the page file. The directory tree is kept entirely in
+    memory.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define TMPFS_ALLOCATION_TAG 0x73706D54 // 'spmT'
+
+#define TMPFS_DEVICE_ID "tmpfs"
+
+//
+// Define the file ID of the root directory. Other files are numbered
+// sequentially after it.
+//
+
+#define TMPFS_ROOT_FILE_ID 1
+
+//
+// By default the file system may use up to half of physical memory, and may
+// hold one file for each page it could store.
+//
+
+#define TMPFS_DEFAULT_SIZE_SHIFT 1
+
+//
+// Define the maximum size of a page file region backing a file. This keeps a
+// large file from needing a massive contiguous chunk of the page file just to
+// page out a few pages. Do not increase this beyond 128KB so that the region's
+// dirty bitmap can remain one ULONG.
+//
+
+#define TMPFS_MAX_BACKING_REGION_SIZE _128KB
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _TMPFS_OBJECT_TYPE {
+    TmpfsObjectInvalid,
+    TmpfsObjectDevice,
+    TmpfsObjectVolume
+} TMPFS_OBJECT_TYPE, *PTMPFS_OBJECT_TYPE;
+
+/*++
+
+Structure Description:
+
+    This structure stores the context for the root tmpfs device, which
+    describes how large the file system mounted on it may grow.
+
+Members:
+
+    Type - Stores the type of context this is, TmpfsObjectDevice.
+
+    CreationTime - Stores the system time when the device was created.
+
+    ReferenceCount - Stores the number of references held on the device.
+
+    Capacity - Stores the maximum number of bytes of file data the file system
+        may hold.
+
+--*/
+
+typedef struct _TMPFS_DEVICE {
+    TMPFS_OBJECT_TYPE Type;
+    SYSTEM_TIME CreationTime;
+    volatile ULONG ReferenceCount;
+    ULONGLONG Capacity;
+} TMPFS_DEVICE, *PTMPFS_DEVICE;
+
+/*++
+
+Structure Description:
+
+    This structure stores information about a tmpfs volume.
+
+Members:
+
+    Type - Stores the type of context this is, TmpfsObjectVolume.
+
+    Lock - Stores a pointer to the lock that protects the node tree, the
+        directory hierarchy, the file properties, and the usage counts.
+
+    NodeTree - Stores the tree of every node in the volume, keyed by file ID.
+
+    Root - Stores a pointer to the root directory node.
+
+    NextFileId - Stores the file ID to hand out to the next created node.
+
+    MaxSize - Stores the maximum number of bytes of file data the volume can
+        hold.
+
+    UsedSize - Stores the number of bytes of file data currently charged to
+        the volume. This is always a multiple of the page size.
+
+    MaxNodes - Stores the maximum number of files the volume can hold.
+
+    NodeCount - Stores the number of files currently in the volume.
+
+    ReferenceCount - Stores the reference count of the volume.
+
+    Attached - Stores a boolean indicating whether the volume is attached.
+
+--*/
+
+typedef struct _TMPFS_VOLUME {
+    TMPFS_OBJECT_TYPE Type;
+    PQUEUED_LOCK Lock;
+    RED_BLACK_TREE NodeTree;
+    struct _TMPFS_NODE *Root;
+    FILE_ID NextFileId;
+    ULONGLONG MaxSize;
+    ULONGLONG UsedSize;
+    ULONGLONG MaxNodes;
+    ULONGLONG NodeCount;
+    volatile ULONG ReferenceCount;
+    BOOL Attached;
+} TMPFS_VOLUME, *PTMPFS_VOLUME;
+
+/*++
+
+Structure Description:
+
+    This structure defines a region of the page file that holds pages evicted
+    from the page cache for a file.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous backing regions of
+        the file.
+
+    ImageBacking - Stores the image backing handle for this region.
+
+    Offset - Stores the file offset where this backing region starts.
+
+    Size - Stores the size of the region, in bytes.
+
+    DirtyBitmap - Stores a bitmap of which pages in the region have actually
+        been written to the page file. Clean pages cannot be read from, as they
+        would hand back uninitialized data from the disk.
+
+--*/
+
+typedef struct _TMPFS_BACKING_REGION {
+    LIST_ENTRY ListEntry;
+    IMAGE_BACKING ImageBacking;
+    IO_OFFSET Offset;
+    ULONG Size;
+    ULONG DirtyBitmap;
+} TMPFS_BACKING_REGION, *PTMPFS_BACKING_REGION;
+
+/*++
+
+Structure Description:
+
+    This structure stores a file, directory, or symbolic link in a tmpfs
+    volume.
+
+Members:
+
+    TreeNode - Stores the node's entry in the volume's node tree.
+
+    SiblingListEntry - Stores pointers to the next and previous entries in the
+        parent directory. The next pointer is NULL if the node is unlinked.
+
+    ChildList - Stores the head of the list of entries in this directory,
+        sorted by directory offset.
+
+    Parent - Stores a pointer to the directory containing this node, or NULL
+        for the root and for unlinked nodes.
+
+    Name - Stores a pointer to the null terminated name of the node.
+
+    NameSize - Stores the size of the name, including the null terminator.
+
+    DirectoryOffset - Stores the offset of this entry within its parent
+        directory, as seen by directory enumeration.
+
+    NextDirectoryOffset - Stores the offset to hand to the next entry added
+        to this directory. Offsets are never reused, so an enumeration can pick
+        up where it left off even if entries are removed in between.
+
+    Properties - Stores the file properties of the node.
+
+    ChargedSize - Stores the number of bytes of file data charged against the
+        volume for this node. This is the page aligned high water mark of the
+        file size.
+
+    BackingLock - Stores a pointer to the lock that protects the backing
+        region list. Only files and symbolic links have one.
+
+    BackingRegionList - Stores the list of page file regions that hold pages
+        evicted from the page cache, sorted by offset.
+
+--*/
+
+typedef struct _TMPFS_NODE {
+    RED_BLACK_TREE_NODE TreeNode;
+    LIST_ENTRY SiblingListEntry;
+    LIST_ENTRY ChildList;
+    struct _TMPFS_NODE *Parent;
+    PSTR Name;
+    ULONG NameSize;
+    IO_OFFSET DirectoryOffset;
+    IO_OFFSET NextDirectoryOffset;
+    FILE_PROPERTIES Properties;
+    ULONGLONG ChargedSize;
+    PSHARED_EXCLUSIVE_LOCK BackingLock;
+    LIST_ENTRY BackingRegionList;
+} TMPFS_NODE, *PTMPFS_NODE;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+TmpfsAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+TmpfsDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+TmpfsDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+TmpfsDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+TmpfsDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+TmpfsDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+KSTATUS
+TmpfspAddVolume (
+    PVOID Driver,
+    PVOID DeviceToken
+    );
+
+VOID
+TmpfspDeviceSystemControl (
+    PIRP Irp,
+    PTMPFS_DEVICE Device
+    );
+
+VOID
+TmpfspDeviceAddReference (
+    PTMPFS_DEVICE Device
+    );
+
+VOID
+TmpfspDeviceReleaseReference (
+    PTMPFS_DEVICE Device
+    );
+
+VOID
+TmpfspVolumeAddReference (
+    PTMPFS_VOLUME Volume
+    );
+
+VOID
+TmpfspVolumeReleaseReference (
+    PTMPFS_VOLUME Volume
+    );
+
+VOID
+TmpfspDestroyVolume (
+    PTMPFS_VOLUME Volume
+    );
+
+KSTATUS
+TmpfspLookup (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_LOOKUP Lookup
+    );
+
+KSTATUS
+TmpfspCreate (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_CREATE Create
+    );
+
+KSTATUS
+TmpfspUnlink (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_UNLINK Unlink
+    );
+
+KSTATUS
+TmpfspRename (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_RENAME Rename
+    );
+
+KSTATUS
+TmpfspTruncate (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Node,
+    PFILE_PROPERTIES FileProperties,
+    ULONGLONG NewSize
+    );
+
+VOID
+TmpfspDelete (
+    PTMPFS_VOLUME Volume,
+    PFILE_PROPERTIES FileProperties
+    );
+
+VOID
+TmpfspWriteFileProperties (
+    PTMPFS_VOLUME Volume,
+    PFILE_PROPERTIES FileProperties
+    );
+
+KSTATUS
+TmpfspEnumerateDirectory (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Directory,
+    PIRP Irp
+    );
+
+KSTATUS
+TmpfspPerformFileIo (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Node,
+    PIRP Irp
+    );
+
+KSTATUS
+TmpfspPerformBackingIo (
+    PTMPFS_NODE Node,
+    PIRP Irp,
+    PUINTN BytesCompleted
+    );
+
+KSTATUS
+TmpfspChargeNode (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Node,
+    ULONGLONG NewSize,
+    BOOL Truncate
+    );
+
+PTMPFS_NODE
+TmpfspCreateNode (
+    PTMPFS_VOLUME Volume,
+    PFILE_PROPERTIES Properties,
+    PCSTR Name,
+    ULONG NameSize
+    );
+
+VOID
+TmpfspDestroyNode (
+    PTMPFS_NODE Node
+    );
+
+PTMPFS_NODE
+TmpfspGetNode (
+    PTMPFS_VOLUME Volume,
+    FILE_ID FileId
+    );
+
+PTMPFS_NODE
+TmpfspFindChild (
+    PTMPFS_NODE Directory,
+    PCSTR Name,
+    ULONG NameSize
+    );
+
+VOID
+TmpfspLinkNode (
+    PTMPFS_NODE Directory,
+    PTMPFS_NODE Node
+    );
+
+VOID
+TmpfspUnlinkNode (
+    PTMPFS_NODE Node
+    );
+
+PSTR
+TmpfspCopyName (
+    PCSTR Name,
+    ULONG NameSize
+    );
+
+PTMPFS_BACKING_REGION
+TmpfspCreateBackingRegion (
+    PTMPFS_NODE Node,
+    IO_OFFSET Offset,
+    PTMPFS_BACKING_REGION NextRegion
+    );
+
+VOID
+TmpfspDestroyBackingRegion (
+    PTMPFS_BACKING_REGION Region
+    );
+
+COMPARISON_RESULT
+TmpfspCompareNodes (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER TmpfsDriver = NULL;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the tmpfs driver. It registers its
+    other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    KSTATUS Status;
+
+    TmpfsDriver = Driver;
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    FunctionTable.AddDevice = TmpfsAddDevice;
+    FunctionTable.DispatchStateChange = TmpfsDispatchStateChange;
+    FunctionTable.DispatchOpen = TmpfsDispatchOpen;
+    FunctionTable.DispatchClose = TmpfsDispatchClose;
+    FunctionTable.DispatchIo = TmpfsDispatchIo;
+    FunctionTable.DispatchSystemControl = TmpfsDispatchSystemControl;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    if (!KSUCCESS(Status)) {
+        goto DriverEntryEnd;
+    }
+
+    Status = IoRegisterFileSystem(Driver);
+    if (!KSUCCESS(Status)) {
+        goto DriverEntryEnd;
+    }
+
+DriverEntryEnd:
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+TmpfsAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called both when the root tmpfs device is enumerated and
+    when any volume is detected. The driver acts as the function driver for
+    the root device, which it marks mountable. When the volume for that device
+    arrives, the driver attaches to it as the file system.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PTMPFS_DEVICE Device;
+    ULONG PageShift;
+    KSTATUS Status;
+    PDEVICE TargetDevice;
+
+    //
+    // Volumes have a target device. Only attach to volumes that sit on the
+    // root tmpfs device, leaving all others to the disk file systems.
+    //
+
+    TargetDevice = IoGetTargetDevice(DeviceToken);
+    if (TargetDevice != NULL) {
+        if (IoAreDeviceIdsEqual(IoGetDeviceId(TargetDevice),
+                                TMPFS_DEVICE_ID) == FALSE) {
+
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        return TmpfspAddVolume(Driver, DeviceToken);
+    }
+
+    if (IoAreDeviceIdsEqual(DeviceId, TMPFS_DEVICE_ID) == FALSE) {
+        RtlDebugPrint("Tmpfs device %s not recognized.\n", DeviceId);
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Device = MmAllocatePagedPool(sizeof(TMPFS_DEVICE), TMPFS_ALLOCATION_TAG);
+    if (Device == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Device, sizeof(TMPFS_DEVICE));
+    Device->Type = TmpfsObjectDevice;
+    Device->ReferenceCount = 1;
+    KeGetSystemTime(&(Device->CreationTime));
+    PageShift = MmPageShift();
+    Device->Capacity = (ULONGLONG)MmGetTotalPhysicalPages() << PageShift;
+    Device->Capacity >>= TMPFS_DEFAULT_SIZE_SHIFT;
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        TmpfspDeviceReleaseReference(Device);
+    }
+
+    return Status;
+}
+
+VOID
+TmpfsDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_DEVICE Device;
+    PTMPFS_VOLUME Volume;
+
+    ASSERT(Irp->MajorCode == IrpMajorStateChange);
+
+    //
+    // The root device is handled on the way up, as the function driver.
+    //
+
+    Device = (PTMPFS_DEVICE)DeviceContext;
+    if (Device->Type == TmpfsObjectDevice) {
+        if (Irp->Direction != IrpUp) {
+            return;
+        }
+
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+        case IrpMinorQueryChildren:
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        //
+        // Mark the device mountable so that a volume gets created for it.
+        //
+
+        case IrpMinorStartDevice:
+            IoSetDeviceMountable(Irp->Device);
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorRemoveDevice:
+            TmpfspDeviceReleaseReference(Device);
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        //
+        // For all other IRPs, do nothing.
+        //
+
+        default:
+            break;
+        }
+
+        return;
+    }
+
+    //
+    // The volume is handled on the way down, as the file system.
+    //
+
+    Volume = (PTMPFS_VOLUME)DeviceContext;
+
+    ASSERT(Volume->Type == TmpfsObjectVolume);
+
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+        case IrpMinorStartDevice:
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorQueryChildren:
+            Irp->U.QueryChildren.ChildCount = 0;
+            Irp->U.QueryChildren.Children = NULL;
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        //
+        // Mark the volume as detached and release the original reference. The
+        // system may still hold the root open, in which case the volume is
+        // destroyed when it is closed.
+        //
+
+        case IrpMinorRemoveDevice:
+
+            ASSERT(Volume->Attached != FALSE);
+
+            Volume->Attached = FALSE;
+            TmpfspVolumeReleaseReference(Volume);
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        default:
+
+            ASSERT(FALSE);
+
+            IoCompleteIrp(TmpfsDriver, Irp, STATUS_NOT_SUPPORTED);
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+TmpfsDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_DEVICE Device;
+    PTMPFS_NODE Node;
+    KSTATUS Status;
+    PTMPFS_VOLUME Volume;
+
+    ASSERT(Irp->MajorCode == IrpMajorOpen);
+    ASSERT(Irp->MinorCode == IrpMinorOpen);
+
+    Device = (PTMPFS_DEVICE)DeviceContext;
+    if (Device->Type == TmpfsObjectDevice) {
+        TmpfspDeviceAddReference(Device);
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+        return;
+    }
+
+    Volume = (PTMPFS_VOLUME)DeviceContext;
+
+    ASSERT(Volume->Type == TmpfsObjectVolume);
+    ASSERT(Volume->Attached != FALSE);
+
+    //
+    // Paging to a file that itself lives in memory would be pointless.
+    //
+
+    if ((Irp->U.Open.OpenFlags & OPEN_FLAG_PAGE_FILE) != 0) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto DispatchOpenEnd;
+    }
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Node = TmpfspGetNode(Volume, Irp->U.Open.FileProperties->FileId);
+    KeReleaseQueuedLock(Volume->Lock);
+    if (Node == NULL) {
+        Status = STATUS_PATH_NOT_FOUND;
+        goto DispatchOpenEnd;
+    }
+
+    //
+    // The node stays around until the system deletes it, which happens only
+    // after the last open file is closed.
+    //
+
+    TmpfspVolumeAddReference(Volume);
+    Irp->U.Open.DeviceContext = Node;
+    Status = STATUS_SUCCESS;
+
+DispatchOpenEnd:
+    IoCompleteIrp(TmpfsDriver, Irp, Status);
+    return;
+}
+
+VOID
+TmpfsDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_DEVICE Device;
+
+    ASSERT(Irp->MajorCode == IrpMajorClose);
+    ASSERT(Irp->MinorCode == IrpMinorClose);
+
+    Device = (PTMPFS_DEVICE)DeviceContext;
+    if (Device->Type == TmpfsObjectDevice) {
+        TmpfspDeviceReleaseReference(Device);
+
+    } else {
+
+        ASSERT(Device->Type == TmpfsObjectVolume);
+
+        TmpfspVolumeReleaseReference((PTMPFS_VOLUME)DeviceContext);
+    }
+
+    IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+TmpfsDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_DEVICE Device;
+    PTMPFS_NODE Node;
+    KSTATUS Status;
+    PTMPFS_VOLUME Volume;
+
+    ASSERT(Irp->Direction == IrpDown);
+    ASSERT(Irp->MajorCode == IrpMajorIo);
+
+    //
+    // The root device has no contents of its own. Failing I/O to it also
+    // stops the disk file systems from claiming its volume.
+    //
+
+    Device = (PTMPFS_DEVICE)DeviceContext;
+    if (Device->Type == TmpfsObjectDevice) {
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_NOT_SUPPORTED);
+        return;
+    }
+
+    Volume = (PTMPFS_VOLUME)DeviceContext;
+
+    ASSERT(Volume->Type == TmpfsObjectVolume);
+
+    if (Volume->Attached == FALSE) {
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_DEVICE_NOT_CONNECTED);
+        return;
+    }
+
+    ASSERT(Irp->U.ReadWrite.IoBuffer != NULL);
+
+    Node = (PTMPFS_NODE)(Irp->U.ReadWrite.DeviceContext);
+    if (Node->Properties.Type == IoObjectRegularDirectory) {
+
+        //
+        // Directories cannot be written to directly.
+        //
+
+        if (Irp->MinorCode == IrpMinorIoWrite) {
+            Status = STATUS_ACCESS_DENIED;
+
+        } else {
+            Status = TmpfspEnumerateDirectory(Volume, Node, Irp);
+        }
+
+    } else {
+        Status = TmpfspPerformFileIo(Volume, Node, Irp);
+    }
+
+    IoCompleteIrp(TmpfsDriver, Irp, Status);
+    return;
+}
+
+VOID
+TmpfsDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Context;
+    PTMPFS_DEVICE Device;
+    PSYSTEM_CONTROL_FILE_OPERATION FileOperation;
+    KSTATUS Status;
+    PSYSTEM_CONTROL_TRUNCATE Truncate;
+    PTMPFS_VOLUME Volume;
+
+    Device = (PTMPFS_DEVICE)DeviceContext;
+    if (Device->Type == TmpfsObjectDevice) {
+        TmpfspDeviceSystemControl(Irp, Device);
+        return;
+    }
+
+    Volume = (PTMPFS_VOLUME)DeviceContext;
+
+    ASSERT(Volume->Type == TmpfsObjectVolume);
+    ASSERT(Volume->Attached != FALSE);
+
+    Context = Irp->U.SystemControl.SystemContext;
+    switch (Irp->MinorCode) {
+    case IrpMinorSystemControlLookup:
+        Status = TmpfspLookup(Volume, (PSYSTEM_CONTROL_LOOKUP)Context);
+        IoCompleteIrp(TmpfsDriver, Irp, Status);
+        break;
+
+    case IrpMinorSystemControlCreate:
+        Status = TmpfspCreate(Volume, (PSYSTEM_CONTROL_CREATE)Context);
+        IoCompleteIrp(TmpfsDriver, Irp, Status);
+        break;
+
+    //
+    // Free the node and its page file space now that the system can no longer
+    // reference it.
+    //
+
+    case IrpMinorSystemControlDelete:
+        FileOperation = (PSYSTEM_CONTROL_FILE_OPERATION)Context;
+
+        ASSERT(FileOperation->FileProperties->HardLinkCount == 0);
+        ASSERT(FileOperation->FileProperties->FileId != TMPFS_ROOT_FILE_ID);
+
+        TmpfspDelete(Volume, FileOperation->FileProperties);
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+        break;
+
+    case IrpMinorSystemControlWriteFileProperties:
+        FileOperation = (PSYSTEM_CONTROL_FILE_OPERATION)Context;
+        TmpfspWriteFileProperties(Volume, FileOperation->FileProperties);
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+        break;
+
+    case IrpMinorSystemControlUnlink:
+        Status = TmpfspUnlink(Volume, (PSYSTEM_CONTROL_UNLINK)Context);
+        IoCompleteIrp(TmpfsDriver, Irp, Status);
+        break;
+
+    case IrpMinorSystemControlRename:
+        Status = TmpfspRename(Volume, (PSYSTEM_CONTROL_RENAME)Context);
+        IoCompleteIrp(TmpfsDriver, Irp, Status);
+        break;
+
+    //
+    // Truncate the file. The system shouldn't pass directories down for
+    // truncation.
+    //
+
+    case IrpMinorSystemControlTruncate:
+        Truncate = (PSYSTEM_CONTROL_TRUNCATE)Context;
+
+        ASSERT(Truncate->FileProperties->Type != IoObjectRegularDirectory);
+        ASSERT(Truncate->DeviceContext != NULL);
+
+        Status = TmpfspTruncate(Volume,
+                                Truncate->DeviceContext,
+                                Truncate->FileProperties,
+                                Truncate->NewSize);
+
+        IoCompleteIrp(TmpfsDriver, Irp, Status);
+        break;
+
+    //
+    // There is nothing to synchronize, the data is already where it lives.
+    //
+
+    case IrpMinorSystemControlSynchronize:
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+        break;
+
+    //
+    // Ignore everything unrecognized.
+    //
+
+    default:
+        break;
+    }
+
+    return;
+}
+
+KSTATUS
+TmpfspAddVolume (
+    PVOID Driver,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attaches the file system to a volume on the root tmpfs
+    device, creating an empty root directory.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceToken - Supplies the token of the volume.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_HANDLE DeviceHandle;
+    ULONGLONG IoCapacity;
+    ULONG IoOffsetAlignment;
+    ULONG IoSizeAlignment;
+    ULONG PageShift;
+    FILE_PROPERTIES Properties;
+    PTMPFS_NODE Root;
+    KSTATUS Status;
+    PTMPFS_VOLUME Volume;
+
+    Volume = NULL;
+    PageShift = MmPageShift();
+
+    //
+    // The root device reports the size limit as its capacity.
+    //
+
+    Status = IoOpenDevice(IoGetTargetDevice(DeviceToken),
+                          IO_ACCESS_READ,
+                          0,
+                          &DeviceHandle,
+                          &IoOffsetAlignment,
+                          &IoSizeAlignment,
+                          &IoCapacity);
+
+    if (!KSUCCESS(Status)) {
+        goto AddVolumeEnd;
+    }
+
+    IoClose(DeviceHandle);
+    Volume = MmAllocatePagedPool(sizeof(TMPFS_VOLUME), TMPFS_ALLOCATION_TAG);
+    if (Volume == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddVolumeEnd;
+    }
+
+    RtlZeroMemory(Volume, sizeof(TMPFS_VOLUME));
+    Volume->Type = TmpfsObjectVolume;
+    RtlRedBlackTreeInitialize(&(Volume->NodeTree), 0, TmpfspCompareNodes);
+    Volume->NextFileId = TMPFS_ROOT_FILE_ID;
+    Volume->MaxSize = ALIGN_RANGE_DOWN(IoCapacity, 1ULL << PageShift);
+    Volume->MaxNodes = Volume->MaxSize >> PageShift;
+    Volume->Lock = KeCreateQueuedLock();
+    if (Volume->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddVolumeEnd;
+    }
+
+    //
+    // Create the root directory. It is world writable with the sticky bit set,
+    // as is customary for a scratch area.
+    //
+
+    RtlZeroMemory(&Properties, sizeof(FILE_PROPERTIES));
+    Properties.Type = IoObjectRegularDirectory;
+    Properties.Permissions = FILE_PERMISSION_ALL | FILE_PERMISSION_RESTRICTED;
+    Properties.HardLinkCount = 1;
+    KeGetSystemTime(&(Properties.CreationTime));
+    Properties.AccessTime = Properties.CreationTime;
+    Properties.ModifiedTime = Properties.CreationTime;
+    Properties.StatusChangeTime = Properties.CreationTime;
+    Root = TmpfspCreateNode(Volume, &Properties, NULL, 0);
+    if (Root == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddVolumeEnd;
+    }
+
+    ASSERT(Root->Properties.FileId == TMPFS_ROOT_FILE_ID);
+
+    RtlRedBlackTreeInsert(&(Volume->NodeTree), &(Root->TreeNode));
+    Volume->NodeCount = 1;
+    Volume->Root = Root;
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Volume);
+    if (!KSUCCESS(Status)) {
+        goto AddVolumeEnd;
+    }
+
+    Volume->ReferenceCount = 1;
+    Volume->Attached = TRUE;
+
+AddVolumeEnd:
+    if (!KSUCCESS(Status)) {
+        if (Volume != NULL) {
+            TmpfspDestroyVolume(Volume);
+        }
+    }
+
+    return Status;
+}
+
+VOID
+TmpfspDeviceSystemControl (
+    PIRP Irp,
+    PTMPFS_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs sent to the root tmpfs device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Device - Supplies a pointer to the root device context.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSYSTEM_CONTROL_LOOKUP Lookup;
+    ULONG PageSize;
+    PFILE_PROPERTIES Properties;
+    KSTATUS Status;
+
+    switch (Irp->MinorCode) {
+
+    //
+    // The root device looks like a block device so that it can be mounted.
+    // Its size is the most the file system on it can hold. Keep it out of the
+    // page cache, as it cannot actually be read.
+    //
+
+    case IrpMinorSystemControlLookup:
+        Lookup = (PSYSTEM_CONTROL_LOOKUP)(Irp->U.SystemControl.SystemContext);
+        Status = STATUS_PATH_NOT_FOUND;
+        if (Lookup->Root != FALSE) {
+            PageSize = MmPageSize();
+            Properties = Lookup->Properties;
+            Properties->FileId = 0;
+            Properties->Type = IoObjectBlockDevice;
+            Properties->HardLinkCount = 1;
+            Properties->BlockSize = PageSize;
+            Properties->BlockCount = Device->Capacity / PageSize;
+            Properties->UserId = 0;
+            Properties->GroupId = 0;
+            Properties->StatusChangeTime = Device->CreationTime;
+            Properties->ModifiedTime = Properties->StatusChangeTime;
+            Properties->AccessTime = Properties->StatusChangeTime;
+            Properties->Permissions = FILE_PERMISSION_USER_READ |
+                                      FILE_PERMISSION_USER_WRITE;
+
+            Properties->Size = Properties->BlockCount * PageSize;
+            Lookup->Flags = LOOKUP_FLAG_NO_PAGE_CACHE;
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(TmpfsDriver, Irp, Status);
+        break;
+
+    //
+    // Succeed for the basics.
+    //
+
+    case IrpMinorSystemControlWriteFileProperties:
+    case IrpMinorSystemControlSynchronize:
+        IoCompleteIrp(TmpfsDriver, Irp, STATUS_SUCCESS);
+        break;
+
+    //
+    // Ignore everything unrecognized.
+    //
+
+    default:
+        break;
+    }
+
+    return;
+}
+
+VOID
+TmpfspDeviceAddReference (
+    PTMPFS_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine increments the reference count on the root tmpfs device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Device->ReferenceCount), 1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x10000000));
+
+    return;
+}
+
+VOID
+TmpfspDeviceReleaseReference (
+    PTMPFS_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine decrements the reference count on the root tmpfs device, and
+    frees it if it hits zero.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Device->ReferenceCount), -1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x10000000));
+
+    if (OldReferenceCount == 1) {
+        MmFreePagedPool(Device);
+    }
+
+    return;
+}
+
+VOID
+TmpfspVolumeAddReference (
+    PTMPFS_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine increments the reference count on the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume whose reference count should be
+        incremented.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Volume->ReferenceCount), 1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x30000000));
+
+    return;
+}
+
+VOID
+TmpfspVolumeReleaseReference (
+    PTMPFS_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine decrements the reference count on the given volume, and
+    destroys it if it hits zero.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume whose reference count should be
+        decremented.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Volume->ReferenceCount), -1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x30000000));
+
+    if (OldReferenceCount == 1) {
+        TmpfspDestroyVolume(Volume);
+    }
+
+    return;
+}
+
+VOID
+TmpfspDestroyVolume (
+    PTMPFS_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a tmpfs volume and every file in it.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_NODE Node;
+    PRED_BLACK_TREE_NODE TreeNode;
+
+    ASSERT(Volume->Attached == FALSE);
+
+    while (TRUE) {
+        TreeNode = RtlRedBlackTreeGetLowestNode(&(Volume->NodeTree));
+        if (TreeNode == NULL) {
+            break;
+        }
+
+        RtlRedBlackTreeRemove(&(Volume->NodeTree), TreeNode);
+        Node = RED_BLACK_TREE_VALUE(TreeNode, TMPFS_NODE, TreeNode);
+        TmpfspDestroyNode(Node);
+    }
+
+    if (Volume->Lock != NULL) {
+        KeDestroyQueuedLock(Volume->Lock);
+    }
+
+    MmFreePagedPool(Volume);
+    return;
+}
+
+KSTATUS
+TmpfspLookup (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_LOOKUP Lookup
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up the root directory or a file within a directory.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Lookup - Supplies a pointer to the lookup request.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PTMPFS_NODE Directory;
+    PTMPFS_NODE Node;
+    KSTATUS Status;
+
+    KeAcquireQueuedLock(Volume->Lock);
+    if (Lookup->Root != FALSE) {
+        Node = Volume->Root;
+
+    } else {
+
+        ASSERT(Lookup->DirectoryProperties->HardLinkCount != 0);
+
+        Directory = TmpfspGetNode(Volume, Lookup->DirectoryProperties->FileId);
+        if ((Directory == NULL) ||
+            (Directory->Properties.Type != IoObjectRegularDirectory)) {
+
+            Status = STATUS_NOT_A_DIRECTORY;
+            goto LookupEnd;
+        }
+
+        Node = TmpfspFindChild(Directory,
+                               Lookup->FileName,
+                               Lookup->FileNameSize);
+    }
+
+    if (Node == NULL) {
+        Status = STATUS_PATH_NOT_FOUND;
+        goto LookupEnd;
+    }
+
+    RtlCopyMemory(Lookup->Properties,
+                  &(Node->Properties),
+                  sizeof(FILE_PROPERTIES));
+
+    if (Node->BackingLock != NULL) {
+        Lookup->Flags |= LOOKUP_FLAG_HARD_FLUSH_REQUIRED;
+    }
+
+    Status = STATUS_SUCCESS;
+
+LookupEnd:
+    KeReleaseQueuedLock(Volume->Lock);
+    return Status;
+}
+
+KSTATUS
+TmpfspCreate (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_CREATE Create
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new file, directory, or symbolic link.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Create - Supplies a pointer to the create request. The file properties
+        are filled in from the system, and updated with the new file ID on
+        success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PTMPFS_NODE Directory;
+    PTMPFS_NODE Node;
+    KSTATUS Status;
+
+    ASSERT(Create->DirectoryProperties->HardLinkCount != 0);
+
+    if (Create->NameSize <= 1) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Directory = TmpfspGetNode(Volume, Create->DirectoryProperties->FileId);
+    if ((Directory == NULL) ||
+        (Directory->Properties.Type != IoObjectRegularDirectory)) {
+
+        Status = STATUS_NOT_A_DIRECTORY;
+        goto CreateEnd;
+    }
+
+    if (TmpfspFindChild(Directory, Create->Name, Create->NameSize) != NULL) {
+        Status = STATUS_FILE_EXISTS;
+        goto CreateEnd;
+    }
+
+    if (Volume->NodeCount >= Volume->MaxNodes) {
+        Status = STATUS_VOLUME_FULL;
+        goto CreateEnd;
+    }
+
+    Node = TmpfspCreateNode(Volume,
+                            &(Create->FileProperties),
+                            Create->Name,
+                            Create->NameSize);
+
+    if (Node == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateEnd;
+    }
+
+    RtlRedBlackTreeInsert(&(Volume->NodeTree), &(Node->TreeNode));
+    Volume->NodeCount += 1;
+    TmpfspLinkNode(Directory, Node);
+    RtlCopyMemory(&(Create->FileProperties),
+                  &(Node->Properties),
+                  sizeof(FILE_PROPERTIES));
+
+    Create->DirectorySize = Directory->Properties.Size;
+    if (Node->BackingLock != NULL) {
+        Create->Flags |= LOOKUP_FLAG_HARD_FLUSH_REQUIRED;
+    }
+
+    Status = STATUS_SUCCESS;
+
+CreateEnd:
+    KeReleaseQueuedLock(Volume->Lock);
+    return Status;
+}
+
+KSTATUS
+TmpfspUnlink (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_UNLINK Unlink
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a file or empty directory from its directory. The
+    node itself lives on until the system sends the delete request.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Unlink - Supplies a pointer to the unlink request.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PTMPFS_NODE Node;
+    KSTATUS Status;
+
+    ASSERT(Unlink->FileProperties->FileId != TMPFS_ROOT_FILE_ID);
+    ASSERT(Unlink->FileProperties->FileId !=
+           Unlink->DirectoryProperties->FileId);
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Node = TmpfspGetNode(Volume, Unlink->FileProperties->FileId);
+    if ((Node == NULL) || (Node->Parent == NULL) ||
+        (Node->Parent->Properties.FileId !=
+         Unlink->DirectoryProperties->FileId)) {
+
+        Status = STATUS_PATH_NOT_FOUND;
+        goto UnlinkEnd;
+    }
+
+    if (LIST_EMPTY(&(Node->ChildList)) == FALSE) {
+        Status = STATUS_DIRECTORY_NOT_EMPTY;
+        goto UnlinkEnd;
+    }
+
+    TmpfspUnlinkNode(Node);
+    Unlink->Unlinked = TRUE;
+    Status = STATUS_SUCCESS;
+
+UnlinkEnd:
+    KeReleaseQueuedLock(Volume->Lock);
+    return Status;
+}
+
+KSTATUS
+TmpfspRename (
+    PTMPFS_VOLUME Volume,
+    PSYSTEM_CONTROL_RENAME Rename
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves a file or directory to a new name, replacing whatever
+    was at the destination.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Rename - Supplies a pointer to the rename request.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PTMPFS_NODE Destination;
+    PTMPFS_NODE DestinationDirectory;
+    FILE_ID DirectoryId;
+    PSTR NewName;
+    PTMPFS_NODE Source;
+    KSTATUS Status;
+
+    //
+    // The system should have handled the case of renaming to the same file.
+    //
+
+    ASSERT(Rename->SourceFileProperties != Rename->DestinationFileProperties);
+    ASSERT(Rename->DestinationFileUnlinked == FALSE);
+
+    Rename->SourceFileHardLinkDelta = 0;
+    if (Rename->NameSize <= 1) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    //
+    // Copy the name up front so that nothing can fail once the tree starts
+    // changing.
+    //
+
+    NewName = TmpfspCopyName(Rename->Name, Rename->NameSize);
+    if (NewName == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Source = TmpfspGetNode(Volume, Rename->SourceFileProperties->FileId);
+    DirectoryId = Rename->DestinationDirectoryProperties->FileId;
+    DestinationDirectory = TmpfspGetNode(Volume, DirectoryId);
+
+    if ((Source == NULL) || (Source->Parent == NULL) ||
+        (DestinationDirectory == NULL)) {
+
+        Status = STATUS_PATH_NOT_FOUND;
+        goto RenameEnd;
+    }
+
+    //
+    // The system should not have allowed a rename into a directory that has
+    // been unlinked.
+    //
+
+    ASSERT(DestinationDirectory->Properties.Type == IoObjectRegularDirectory);
+    ASSERT(Rename->DestinationDirectoryProperties->HardLinkCount != 0);
+
+    if (Rename->DestinationFileProperties != NULL) {
+        Destination = TmpfspGetNode(Volume,
+                                    Rename->DestinationFileProperties->FileId);
+
+        if (Destination == NULL) {
+            Status = STATUS_PATH_NOT_FOUND;
+            goto RenameEnd;
+        }
+
+        if (LIST_EMPTY(&(Destination->ChildList)) == FALSE) {
+            Status = STATUS_DIRECTORY_NOT_EMPTY;
+            goto RenameEnd;
+        }
+
+        TmpfspUnlinkNode(Destination);
+        Rename->DestinationFileUnlinked = TRUE;
+    }
+
+    TmpfspUnlinkNode(Source);
+    MmFreePagedPool(Source->Name);
+    Source->Name = NewName;
+    Source->NameSize = Rename->NameSize;
+    NewName = NULL;
+    TmpfspLinkNode(DestinationDirectory, Source);
+    Rename->DestinationDirectorySize = DestinationDirectory->Properties.Size;
+    Status = STATUS_SUCCESS;
+
+RenameEnd:
+    KeReleaseQueuedLock(Volume->Lock);
+    if (NewName != NULL) {
+        MmFreePagedPool(NewName);
+    }
+
+    return Status;
+}
+
+KSTATUS
+TmpfspTruncate (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Node,
+    PFILE_PROPERTIES FileProperties,
+    ULONGLONG NewSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the size of a file, charging or refunding the volume and
+    releasing page file space beyond the new end of the file.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Node - Supplies a pointer to the node being truncated.
+
+    FileProperties - Supplies a pointer to the system's properties for the
+        file. The size is updated on success.
+
+    NewSize - Supplies the new file size.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    ULONG PageCount;
+    ULONG PageShift;
+    ULONG PageSize;
+    PTMPFS_BACKING_REGION Region;
+    ULONG RegionSize;
+    KSTATUS Status;
+
+    ASSERT(Node->BackingLock != NULL);
+
+    PageShift = MmPageShift();
+    PageSize = MmPageSize();
+    KeAcquireSharedExclusiveLockExclusive(Node->BackingLock);
+    Status = TmpfspChargeNode(Volume, Node, NewSize, TRUE);
+    if (!KSUCCESS(Status)) {
+        goto TruncateEnd;
+    }
+
+    CurrentEntry = Node->BackingRegionList.Next;
+    while (CurrentEntry != &(Node->BackingRegionList)) {
+        Region = LIST_VALUE(CurrentEntry, TMPFS_BACKING_REGION, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+
+        //
+        // Release regions entirely beyond the end of the file.
+        //
+
+        if (Region->Offset >= NewSize) {
+            LIST_REMOVE(&(Region->ListEntry));
+            Region->ListEntry.Next = NULL;
+            TmpfspDestroyBackingRegion(Region);
+
+        //
+        // If only the end is beyond the new size, keep the region in case the
+        // file grows again, but forget the pages past the end so they read
+        // back as zeroes.
+        //
+
+        } else if ((Region->Offset + Region->Size) > NewSize) {
+            RegionSize = (ULONG)(NewSize - Region->Offset);
+            RegionSize = ALIGN_RANGE_UP(RegionSize, PageSize);
+            PageCount = RegionSize >> PageShift;
+            Region->DirtyBitmap &= (1 << PageCount) - 1;
+        }
+    }
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Node->Properties.Size = NewSize;
+    KeReleaseQueuedLock(Volume->Lock);
+    FileProperties->Size = NewSize;
+
+TruncateEnd:
+    KeReleaseSharedExclusiveLockExclusive(Node->BackingLock);
+    return Status;
+}
+
+VOID
+TmpfspDelete (
+    PTMPFS_VOLUME Volume,
+    PFILE_PROPERTIES FileProperties
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys an unlinked node that the system no longer
+    references, returning its space to the volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    FileProperties - Supplies a pointer to the properties of the file to
+        delete.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_NODE Node;
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Node = TmpfspGetNode(Volume, FileProperties->FileId);
+    if (Node != NULL) {
+
+        ASSERT(Node->Parent == NULL);
+        ASSERT(Volume->UsedSize >= Node->ChargedSize);
+
+        RtlRedBlackTreeRemove(&(Volume->NodeTree), &(Node->TreeNode));
+        Volume->NodeCount -= 1;
+        Volume->UsedSize -= Node->ChargedSize;
+    }
+
+    KeReleaseQueuedLock(Volume->Lock);
+    if (Node != NULL) {
+        TmpfspDestroyNode(Node);
+    }
+
+    return;
+}
+
+VOID
+TmpfspWriteFileProperties (
+    PTMPFS_VOLUME Volume,
+    PFILE_PROPERTIES FileProperties
+    )
+
+/*++
+
+Routine Description:
+
+    This routine saves the system's copy of a file's properties.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    FileProperties - Supplies a pointer to the new properties.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    IO_OFFSET BlockCount;
+    IO_OFFSET BlockSize;
+    PTMPFS_NODE Node;
+
+    KeAcquireQueuedLock(Volume->Lock);
+    Node = TmpfspGetNode(Volume, FileProperties->FileId);
+    if (Node != NULL) {
+
+        //
+        // The block counts reflect what the volume has charged the file, so
+        // keep those.
+        //
+
+        BlockCount = Node->Properties.BlockCount;
+        BlockSize = Node->Properties.BlockSize;
+        RtlCopyMemory(&(Node->Properties),
+                      FileProperties,
+                      sizeof(FILE_PROPERTIES));
+
+        Node->Properties.BlockCount = BlockCount;
+        Node->Properties.BlockSize = BlockSize;
+    }
+
+    KeReleaseQueuedLock(Volume->Lock);
+    return;
+}
+
+KSTATUS
+TmpfspEnumerateDirectory (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Directory,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads directory entries into the caller's buffer.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Directory - Supplies a pointer to the directory to enumerate.
+
+    Irp - Supplies a pointer to the read IRP. The I/O offset is the directory
+        offset to start at.
+
+Return Value:
+
+    STATUS_SUCCESS if entries were read and the end of the directory was
+    reached.
+
+    STATUS_MORE_PROCESSING_REQUIRED if the buffer filled up before the end of
+    the directory.
+
+    STATUS_END_OF_FILE if there were no more entries to read.
+
+--*/
+
+{
+
+    UINTN BytesWritten;
+    PTMPFS_NODE Child;
+    PLIST_ENTRY CurrentEntry;
+    DIRECTORY_ENTRY Entry;
+    UINTN EntrySize;
+    PIO_BUFFER IoBuffer;
+    IO_OFFSET IoOffset;
+    IO_OFFSET NextOffset;
+    UINTN SpaceLeft;
+    KSTATUS Status;
+
+    ASSERT(Irp->U.ReadWrite.IoOffset >= DIRECTORY_CONTENTS_OFFSET);
+
+    BytesWritten = 0;
+    IoBuffer = Irp->U.ReadWrite.IoBuffer;
+    IoOffset = Irp->U.ReadWrite.IoOffset;
+    NextOffset = IoOffset;
+    SpaceLeft = Irp->U.ReadWrite.IoSizeInBytes;
+    Status = STATUS_SUCCESS;
+    KeAcquireQueuedLock(Volume->Lock);
+    CurrentEntry = Directory->ChildList.Next;
+    while (CurrentEntry != &(Directory->ChildList)) {
+        Child = LIST_VALUE(CurrentEntry, TMPFS_NODE, SiblingListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Child->DirectoryOffset < IoOffset) {
+            continue;
+        }
+
+        EntrySize = ALIGN_RANGE_UP(sizeof(DIRECTORY_ENTRY) + Child->NameSize,
+                                   8);
+
+        if (EntrySize > SpaceLeft) {
+            NextOffset = Child->DirectoryOffset;
+            Status = STATUS_MORE_PROCESSING_REQUIRED;
+            break;
+        }
+
+        Entry.FileId = Child->Properties.FileId;
+        Entry.NextOffset = Child->DirectoryOffset + 1;
+        Entry.Size = EntrySize;
+        Entry.Type = Child->Properties.Type;
+        Status = MmCopyIoBufferData(IoBuffer,
+                                    &Entry,
+                                    BytesWritten,
+                                    sizeof(DIRECTORY_ENTRY),
+                                    TRUE);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Status = MmCopyIoBufferData(IoBuffer,
+                                    Child->Name,
+                                    BytesWritten + sizeof(DIRECTORY_ENTRY),
+                                    Child->NameSize,
+                                    TRUE);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        BytesWritten += EntrySize;
+        SpaceLeft -= EntrySize;
+        NextOffset = Entry.NextOffset;
+    }
+
+    KeReleaseQueuedLock(Volume->Lock);
+    if ((KSUCCESS(Status)) && (BytesWritten == 0)) {
+        Status = STATUS_END_OF_FILE;
+    }
+
+    Irp->U.ReadWrite.IoBytesCompleted = BytesWritten;
+    Irp->U.ReadWrite.NewIoOffset = NextOffset;
+    return Status;
+}
+
+KSTATUS
+TmpfspPerformFileIo (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Node,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads from or writes to a file. Writes are acknowledged
+    without storing anything unless the page cache is evicting the data, in
+    which case it goes to the page file. Reads return zeroes except for pages
+    that were previously evicted.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Node - Supplies a pointer to the file.
+
+    Irp - Supplies a pointer to the I/O IRP.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    IO_OFFSET FileSize;
+    IO_OFFSET IoOffset;
+    UINTN IoSize;
+    KSTATUS Status;
+
+    ASSERT(Node->BackingLock != NULL);
+    ASSERT(Irp->U.ReadWrite.FileProperties != NULL);
+
+    BytesCompleted = 0;
+    IoOffset = Irp->U.ReadWrite.IoOffset;
+    IoSize = Irp->U.ReadWrite.IoSizeInBytes;
+    if (Irp->MinorCode == IrpMinorIoRead) {
+        FileSize = Irp->U.ReadWrite.FileProperties->Size;
+        if (IoOffset >= FileSize) {
+            Status = STATUS_END_OF_FILE;
+            goto PerformFileIoEnd;
+        }
+
+    } else {
+
+        ASSERT(Irp->MinorCode == IrpMinorIoWrite);
+
+        //
+        // This is where the file system finds out that the file is growing,
+        // so enforce the size limit here.
+        //
+
+        Status = TmpfspChargeNode(Volume, Node, IoOffset + IoSize, FALSE);
+        if (!KSUCCESS(Status)) {
+            goto PerformFileIoEnd;
+        }
+
+        //
+        // The page cache holds the only copy of the data. Unless it is about
+        // to let go of it, there is nothing to do.
+        //
+
+        if ((Irp->U.ReadWrite.IoFlags & IO_FLAG_HARD_FLUSH) == 0) {
+            BytesCompleted = IoSize;
+            Status = STATUS_SUCCESS;
+            goto PerformFileIoEnd;
+        }
+    }
+
+    Status = TmpfspPerformBackingIo(Node, Irp, &BytesCompleted);
+
+PerformFileIoEnd:
+    Irp->U.ReadWrite.IoBytesCompleted = BytesCompleted;
+    Irp->U.ReadWrite.NewIoOffset = IoOffset + BytesCompleted;
+    return Status;
+}
+
+KSTATUS
+TmpfspPerformBackingIo (
+    PTMPFS_NODE Node,
+    PIRP Irp,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads or writes the page file regions that back a file. All
+    I/O is page aligned.
+
+Arguments:
+
+    Node - Supplies a pointer to the file.
+
+    Irp - Supplies a pointer to the I/O IRP.
+
+    BytesCompleted - Supplies a pointer where the number of bytes read or
+        written will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AlignedSize;
+    UINTN BytesCompletedThisRound;
+    UINTN BytesRemaining;
+    UINTN BytesThisRound;
+    PLIST_ENTRY CurrentEntry;
+    IO_OFFSET CurrentOffset;
+    UINTN Completed;
+    PIO_BUFFER IoBuffer;
+    IO_OFFSET IoEnd;
+    UINTN OriginalIoBufferOffset;
+    ULONG PageCount;
+    ULONG PageIndex;
+    ULONG PageMask;
+    ULONG PageShift;
+    ULONG PageSize;
+    PTMPFS_BACKING_REGION Region;
+    IO_OFFSET RegionEnd;
+    ULONG RegionOffset;
+    KSTATUS Status;
+    BOOL Write;
+
+    PageShift = MmPageShift();
+    PageSize = MmPageSize();
+    IoBuffer = Irp->U.ReadWrite.IoBuffer;
+    Write = FALSE;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        Write = TRUE;
+    }
+
+    Completed = 0;
+    RegionEnd = 0;
+    Status = STATUS_SUCCESS;
+    OriginalIoBufferOffset = MmGetIoBufferCurrentOffset(IoBuffer);
+    AlignedSize = ALIGN_RANGE_UP(Irp->U.ReadWrite.IoSizeInBytes, PageSize);
+
+    ASSERT(IS_ALIGNED(Irp->U.ReadWrite.IoOffset, PageSize) != FALSE);
+
+    //
+    // The page file write is a no-allocate I/O path. Make sure the buffer is
+    // mapped before the write happens. Reads start with a zeroed buffer and
+    // only fill in the pages that were saved.
+    //
+
+    if (Write != FALSE) {
+        MmMapIoBuffer(IoBuffer, FALSE, FALSE, FALSE);
+        KeAcquireSharedExclusiveLockExclusive(Node->BackingLock);
+
+    } else {
+        MmZeroIoBuffer(IoBuffer, 0, AlignedSize);
+        KeAcquireSharedExclusiveLockShared(Node->BackingLock);
+    }
+
+    BytesRemaining = AlignedSize;
+    CurrentOffset = Irp->U.ReadWrite.IoOffset;
+    CurrentEntry = Node->BackingRegionList.Next;
+    IoEnd = CurrentOffset + BytesRemaining;
+    while (BytesRemaining != 0) {
+
+        //
+        // If the current entry is the head of the list, there are no more
+        // backing regions.
+        //
+
+        if (CurrentEntry == &(Node->BackingRegionList)) {
+            Region = NULL;
+            BytesThisRound = BytesRemaining;
+
+        //
+        // Get the next region and determine if any of it overlaps with the
+        // I/O offset and size.
+        //
+
+        } else {
+            Region = LIST_VALUE(CurrentEntry, TMPFS_BACKING_REGION, ListEntry);
+            RegionEnd = Region->Offset + Region->Size;
+            if (CurrentOffset >= RegionEnd) {
+                CurrentEntry = CurrentEntry->Next;
+                continue;
+            }
+
+            if (RegionEnd < IoEnd) {
+                BytesThisRound = RegionEnd - CurrentOffset;
+
+            } else {
+                BytesThisRound = IoEnd - CurrentOffset;
+            }
+        }
+
+        ASSERT(IS_ALIGNED(BytesThisRound, PageSize) != FALSE);
+
+        //
+        // If there is a gap in the backing regions, reads skip it as it was
+        // zeroed above, and writes allocate a new region to fill it.
+        //
+
+        if ((Region == NULL) || (CurrentOffset < Region->Offset)) {
+            if (Write == FALSE) {
+                if (Region != NULL) {
+                    BytesThisRound = Region->Offset - CurrentOffset;
+                }
+
+                MmIoBufferIncrementOffset(IoBuffer, BytesThisRound);
+                BytesRemaining -= BytesThisRound;
+                Completed += BytesThisRound;
+                CurrentOffset += BytesThisRound;
+
+            } else {
+                Region = TmpfspCreateBackingRegion(Node, CurrentOffset, Region);
+                if (Region == NULL) {
+                    Status = STATUS_INSUFFICIENT_RESOURCES;
+                    goto PerformBackingIoEnd;
+                }
+
+                CurrentEntry = &(Region->ListEntry);
+            }
+
+            continue;
+        }
+
+        RegionOffset = (ULONG)(CurrentOffset - Region->Offset);
+
+        //
+        // On read, only read the pages that were previously written out. Skip
+        // the leading pages that were never saved, then read the run of saved
+        // pages after them.
+        //
+
+        if (Write == FALSE) {
+            PageIndex = RegionOffset >> PageShift;
+            PageCount = BytesThisRound >> PageShift;
+            PageMask = (1 << PageCount) - 1;
+            PageMask &= (Region->DirtyBitmap >> PageIndex);
+            if (PageMask != 0) {
+                PageCount = RtlCountTrailingZeros32(PageMask);
+            }
+
+            BytesThisRound = PageCount << PageShift;
+            MmIoBufferIncrementOffset(IoBuffer, BytesThisRound);
+            BytesRemaining -= BytesThisRound;
+            Completed += BytesThisRound;
+            CurrentOffset += BytesThisRound;
+            RegionOffset += BytesThisRound;
+            BytesThisRound = 0;
+            if (PageMask != 0) {
+                PageMask >>= PageCount;
+                PageCount = RtlCountTrailingZeros32(~PageMask);
+                BytesThisRound = PageCount << PageShift;
+            }
+
+            if (BytesThisRound == 0) {
+
+                ASSERT((CurrentOffset == RegionEnd) || (BytesRemaining == 0));
+
+                CurrentEntry = CurrentEntry->Next;
+                continue;
+            }
+        }
+
+        Status = MmPageFilePerformIo(&(Region->ImageBacking),
+                                     IoBuffer,
+                                     RegionOffset,
+                                     BytesThisRound,
+                                     Irp->U.ReadWrite.IoFlags,
+                                     Irp->U.ReadWrite.TimeoutInMilliseconds,
+                                     Write,
+                                     &BytesCompletedThisRound);
+
+        if (!KSUCCESS(Status)) {
+            goto PerformBackingIoEnd;
+        }
+
+        ASSERT(BytesThisRound == BytesCompletedThisRound);
+
+        //
+        // Remember which pages were saved so the next read goes and gets them.
+        //
+
+        if (Write != FALSE) {
+            PageIndex = RegionOffset >> PageShift;
+            PageMask = (1 << (BytesCompletedThisRound >> PageShift)) - 1;
+            Region->DirtyBitmap |= (PageMask << PageIndex);
+        }
+
+        MmIoBufferIncrementOffset(IoBuffer, BytesCompletedThisRound);
+        BytesRemaining -= BytesCompletedThisRound;
+        Completed += BytesCompletedThisRound;
+        CurrentOffset += BytesCompletedThisRound;
+        if (CurrentOffset >= RegionEnd) {
+            CurrentEntry = CurrentEntry->Next;
+        }
+    }
+
+PerformBackingIoEnd:
+    if (Write != FALSE) {
+        KeReleaseSharedExclusiveLockExclusive(Node->BackingLock);
+
+    } else {
+        KeReleaseSharedExclusiveLockShared(Node->BackingLock);
+    }
+
+    MmSetIoBufferCurrentOffset(IoBuffer, OriginalIoBufferOffset);
+
+    //
+    // The I/O size may have been aligned up to a page. Make sure the bytes
+    // completed is not larger than the request.
+    //
+
+    if (Completed > Irp->U.ReadWrite.IoSizeInBytes) {
+        Completed = Irp->U.ReadWrite.IoSizeInBytes;
+    }
+
+    *BytesCompleted = Completed;
+    return Status;
+}
+
+KSTATUS
+TmpfspChargeNode (
+    PTMPFS_VOLUME Volume,
+    PTMPFS_NODE Node,
+    ULONGLONG NewSize,
+    BOOL Truncate
+    )
+
+/*++
+
+Routine Description:
+
+    This routine charges the volume for a file growing to the given size.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Node - Supplies a pointer to the file.
+
+    NewSize - Supplies the size the file is growing to.
+
+    Truncate - Supplies a boolean indicating if the file is being set to this
+        size (TRUE), in which case a smaller size is refunded, or if the file
+        is merely being written up to this size (FALSE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_VOLUME_FULL if the volume does not have room for the growth.
+
+--*/
+
+{
+
+    ULONGLONG AlignedSize;
+    ULONGLONG Delta;
+    ULONG PageShift;
+    KSTATUS Status;
+
+    PageShift = MmPageShift();
+    AlignedSize = ALIGN_RANGE_UP(NewSize, 1ULL << PageShift);
+    Status = STATUS_SUCCESS;
+    KeAcquireQueuedLock(Volume->Lock);
+    if (AlignedSize > Node->ChargedSize) {
+        Delta = AlignedSize - Node->ChargedSize;
+        if ((Volume->UsedSize + Delta > Volume->MaxSize) ||
+            (Volume->UsedSize + Delta < Volume->UsedSize)) {
+
+            Status = STATUS_VOLUME_FULL;
+            goto ChargeNodeEnd;
+        }
+
+        Volume->UsedSize += Delta;
+
+    } else if ((Truncate != FALSE) && (AlignedSize < Node->ChargedSize)) {
+        Delta = Node->ChargedSize - AlignedSize;
+
+        ASSERT(Volume->UsedSize >= Delta);
+
+        Volume->UsedSize -= Delta;
+
+    } else {
+        goto ChargeNodeEnd;
+    }
+
+    Node->ChargedSize = AlignedSize;
+    Node->Properties.BlockCount = AlignedSize >> PageShift;
+
+ChargeNodeEnd:
+    KeReleaseQueuedLock(Volume->Lock);
+    return Status;
+}
+
+PTMPFS_NODE
+TmpfspCreateNode (
+    PTMPFS_VOLUME Volume,
+    PFILE_PROPERTIES Properties,
+    PCSTR Name,
+    ULONG NameSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a new node and assigns it a file ID. The caller is
+    responsible for inserting it into the tree and its directory. This routine
+    assumes the volume lock is held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    Properties - Supplies the initial properties of the node, filled in by the
+        system.
+
+    Name - Supplies an optional pointer to the name of the node, which may not
+        be null terminated.
+
+    NameSize - Supplies the size of the name buffer including space for a null
+        terminator.
+
+Return Value:
+
+    Returns a pointer to the new node on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PTMPFS_NODE Node;
+
+    Node = MmAllocatePagedPool(sizeof(TMPFS_NODE), TMPFS_ALLOCATION_TAG);
+    if (Node == NULL) {
+        goto CreateNodeEnd;
+    }
+
+    RtlZeroMemory(Node, sizeof(TMPFS_NODE));
+    INITIALIZE_LIST_HEAD(&(Node->ChildList));
+    INITIALIZE_LIST_HEAD(&(Node->BackingRegionList));
+    Node->NextDirectoryOffset = DIRECTORY_CONTENTS_OFFSET;
+    if (Name != NULL) {
+        Node->Name = TmpfspCopyName(Name, NameSize);
+        if (Node->Name == NULL) {
+            goto CreateNodeEnd;
+        }
+
+        Node->NameSize = NameSize;
+    }
+
+    //
+    // Files and symbolic links have data in the page cache, which may get
+    // pushed out to the page file.
+    //
+
+    if (Properties->Type != IoObjectRegularDirectory) {
+        Node->BackingLock = KeCreateSharedExclusiveLock();
+        if (Node->BackingLock == NULL) {
+            goto CreateNodeEnd;
+        }
+    }
+
+    RtlCopyMemory(&(Node->Properties), Properties, sizeof(FILE_PROPERTIES));
+    Node->Properties.FileId = Volume->NextFileId;
+    Node->Properties.Size = 0;
+    Node->Properties.BlockSize = MmPageSize();
+    Node->Properties.BlockCount = 0;
+    Volume->NextFileId += 1;
+    return Node;
+
+CreateNodeEnd:
+    if (Node != NULL) {
+        TmpfspDestroyNode(Node);
+    }
+
+    return NULL;
+}
+
+VOID
+TmpfspDestroyNode (
+    PTMPFS_NODE Node
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a node and releases its page file space. The node must
+    already be out of the volume's tree.
+
+Arguments:
+
+    Node - Supplies a pointer to the node to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTMPFS_BACKING_REGION Region;
+
+    while (LIST_EMPTY(&(Node->BackingRegionList)) == FALSE) {
+        Region = LIST_VALUE(Node->BackingRegionList.Next,
+                            TMPFS_BACKING_REGION,
+                            ListEntry);
+
+        LIST_REMOVE(&(Region->ListEntry));
+        Region->ListEntry.Next = NULL;
+        TmpfspDestroyBackingRegion(Region);
+    }
+
+    if (Node->BackingLock != NULL) {
+        KeDestroySharedExclusiveLock(Node->BackingLock);
+    }
+
+    if (Node->Name != NULL) {
+        MmFreePagedPool(Node->Name);
+    }
+
+    MmFreePagedPool(Node);
+    return;
+}
+
+PTMPFS_NODE
+TmpfspGetNode (
+    PTMPFS_VOLUME Volume,
+    FILE_ID FileId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds a node by its file ID. This routine assumes the volume
+    lock is held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the volume.
+
+    FileId - Supplies the file ID to find.
+
+Return Value:
+
+    Returns a pointer to the node on success.
+
+    NULL if no node has the given file ID.
+
+--*/
+
+{
+
+    PRED_BLACK_TREE_NODE FoundNode;
+    TMPFS_NODE SearchNode;
+
+    SearchNode.Properties.FileId = FileId;
+    FoundNode = RtlRedBlackTreeSearch(&(Volume->NodeTree),
+                                      &(SearchNode.TreeNode));
+
+    if (FoundNode == NULL) {
+        return NULL;
+    }
+
+    return RED_BLACK_TREE_VALUE(FoundNode, TMPFS_NODE, TreeNode);
+}
+
+PTMPFS_NODE
+TmpfspFindChild (
+    PTMPFS_NODE Directory,
+    PCSTR Name,
+    ULONG NameSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds an entry in a directory by name. This routine assumes
+    the volume lock is held.
+
+Arguments:
+
+    Directory - Supplies a pointer to the directory to search.
+
+    Name - Supplies a pointer to the name to find, which may not be null
+        terminated.
+
+    NameSize - Supplies the size of the name buffer including space for a null
+        terminator.
+
+Return Value:
+
+    Returns a pointer to the matching node on success.
+
+    NULL if the directory has no entry by that name.
+
+--*/
+
+{
+
+    PTMPFS_NODE Child;
+    PLIST_ENTRY CurrentEntry;
+
+    CurrentEntry = Directory->ChildList.Next;
+    while (CurrentEntry != &(Directory->ChildList)) {
+        Child = LIST_VALUE(CurrentEntry, TMPFS_NODE, SiblingListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((Child->NameSize == NameSize) &&
+            (RtlAreStringsEqual(Child->Name, Name, NameSize - 1) != FALSE)) {
+
+            return Child;
+        }
+    }
+
+    return NULL;
+}
+
+VOID
+TmpfspLinkNode (
+    PTMPFS_NODE Directory,
+    PTMPFS_NODE Node
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a node to the end of a directory. This routine assumes
+    the volume lock is held.
+
+Arguments:
+
+    Directory - Supplies a pointer to the directory.
+
+    Node - Supplies a pointer to the unlinked node to add.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(Node->Parent == NULL);
+    ASSERT(Node->SiblingListEntry.Next == NULL);
+
+    Node->Parent = Directory;
+    Node->DirectoryOffset = Directory->NextDirectoryOffset;
+    Directory->NextDirectoryOffset += 1;
+    INSERT_BEFORE(&(Node->SiblingListEntry), &(Directory->ChildList));
+    return;
+}
+
+VOID
+TmpfspUnlinkNode (
+    PTMPFS_NODE Node
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a node from its directory. This routine assumes the
+    volume lock is held.
+
+Arguments:
+
+    Node - Supplies a pointer to the node to remove.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(Node->Parent != NULL);
+
+    LIST_REMOVE(&(Node->SiblingListEntry));
+    Node->SiblingListEntry.Next = NULL;
+    Node->Parent = NULL;
+    return;
+}
+
+PSTR
+TmpfspCopyName (
+    PCSTR Name,
+    ULONG NameSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes a null terminated copy of a name.
+
+Arguments:
+
+    Name - Supplies a pointer to the name, which may not be null terminated.
+
+    NameSize - Supplies the size of the name buffer including space for a null
+        terminator.
+
+Return Value:
+
+    Returns a pointer to the copy, allocated from paged pool.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PSTR Copy;
+
+    ASSERT(NameSize != 0);
+
+    Copy = MmAllocatePagedPool(NameSize, TMPFS_ALLOCATION_TAG);
+    if (Copy == NULL) {
+        return NULL;
+    }
+
+    RtlCopyMemory(Copy, Name, NameSize - 1);
+    Copy[NameSize - 1] = '\0';
+    return Copy;
+}
+
+PTMPFS_BACKING_REGION
+TmpfspCreateBackingRegion (
+    PTMPFS_NODE Node,
+    IO_OFFSET Offset,
+    PTMPFS_BACKING_REGION NextRegion
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates page file space covering the given file offset and
+    inserts it in the file's backing region list. This routine assumes the
+    backing lock is held exclusively.
+
+Arguments:
+
+    Node - Supplies a pointer to the file.
+
+    Offset - Supplies the file offset the region needs to cover.
+
+    NextRegion - Supplies a pointer to the backing region before which the new
+        region should be placed, or NULL to place it at the end of the list.
+
+Return Value:
+
+    Returns a pointer to the new region on success.
+
+    NULL on failure.
+
+--*/
+
+{
+
+    PTMPFS_BACKING_REGION NewRegion;
+    ULONG PageSize;
+    IO_OFFSET PreviousEnd;
+    PTMPFS_BACKING_REGION PreviousRegion;
+    IO_OFFSET RegionEnd;
+    PLIST_ENTRY RegionList;
+    IO_OFFSET RegionOffset;
+    UINTN RegionSize;
+    ULONG RetryCount;
+    KSTATUS Status;
+
+    ASSERT(KeIsSharedExclusiveLockHeldExclusive(Node->BackingLock));
+
+    NewRegion = MmAllocatePagedPool(sizeof(TMPFS_BACKING_REGION),
+                                    TMPFS_ALLOCATION_TAG);
+
+    if (NewRegion == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory(NewRegion, sizeof(TMPFS_BACKING_REGION));
+    NewRegion->ImageBacking.DeviceHandle = INVALID_HANDLE;
+    RegionList = &(Node->BackingRegionList);
+    PreviousRegion = NULL;
+    if (NextRegion == NULL) {
+        if (LIST_EMPTY(RegionList) == FALSE) {
+            PreviousRegion = LIST_VALUE(RegionList->Previous,
+                                        TMPFS_BACKING_REGION,
+                                        ListEntry);
+        }
+
+    } else if (NextRegion->ListEntry.Previous != RegionList) {
+        PreviousRegion = LIST_VALUE(NextRegion->ListEntry.Previous,
+                                    TMPFS_BACKING_REGION,
+                                    ListEntry);
+    }
+
+    //
+    // Try to allocate regions of the maximum size, aligned down, fitting
+    // between the neighboring regions. Fall back to smaller regions if the
+    // page file is tight.
+    //
+
+    RetryCount = 0;
+    RegionSize = TMPFS_MAX_BACKING_REGION_SIZE;
+    PageSize = MmPageSize();
+    Status = STATUS_INSUFFICIENT_RESOURCES;
+    while (RegionSize >= PageSize) {
+        RegionOffset = ALIGN_RANGE_DOWN(Offset, RegionSize);
+        if (PreviousRegion != NULL) {
+            PreviousEnd = PreviousRegion->Offset + PreviousRegion->Size;
+            if (PreviousEnd > RegionOffset) {
+                RegionSize -= (PreviousEnd - RegionOffset);
+                RegionOffset = PreviousEnd;
+            }
+        }
+
+        if (NextRegion != NULL) {
+            RegionEnd = RegionOffset + RegionSize;
+            if (NextRegion->Offset < RegionEnd) {
+                RegionSize -= (RegionEnd - NextRegion->Offset);
+            }
+        }
+
+        ASSERT(RegionSize >= PageSize);
+
+        Status = MmAllocatePageFileSpace(&(NewRegion->ImageBacking),
+                                         RegionSize);
+
+        if (KSUCCESS(Status)) {
+            break;
+        }
+
+        if (Status != STATUS_INSUFFICIENT_RESOURCES) {
+            break;
+        }
+
+        RetryCount += 1;
+        RegionSize = TMPFS_MAX_BACKING_REGION_SIZE >> RetryCount;
+    }
+
+    if (!KSUCCESS(Status)) {
+        MmFreePagedPool(NewRegion);
+        return NULL;
+    }
+
+    NewRegion->Offset = RegionOffset;
+    NewRegion->Size = RegionSize;
+    if (NextRegion != NULL) {
+        INSERT_BEFORE(&(NewRegion->ListEntry), &(NextRegion->ListEntry));
+
+    } else {
+        INSERT_BEFORE(&(NewRegion->ListEntry), RegionList);
+    }
+
+    return NewRegion;
+}
+
+VOID
+TmpfspDestroyBackingRegion (
+    PTMPFS_BACKING_REGION Region
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a backing region's page file space and frees it.
+
+Arguments:
+
+    Region - Supplies a pointer to the region, which must already be off of
+        its file's list.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(Region->ListEntry.Next == NULL);
+
+    MmFreePageFileSpace(&(Region->ImageBacking), Region->Size);
+    MmFreePagedPool(Region);
+    return;
+}
+
+COMPARISON_RESULT
+TmpfspCompareNodes (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares tmpfs nodes by their file IDs.
+
+Arguments:
+
+    Tree - Supplies a pointer to the Red-Black tree that owns both nodes.
+
+    FirstNode - Supplies a pointer to the left side of the comparison.
+
+    SecondNode - Supplies a pointer to the second side of the comparison.
+
+Return Value:
+
+    Same if the two nodes have the same value.
+
+    Ascending if the first node is less than the second node.
+
+    Descending if the second node is less than the first node.
+
+--*/
+
+{
+
+    PTMPFS_NODE First;
+    PTMPFS_NODE Second;
+
+    First = RED_BLACK_TREE_VALUE(FirstNode, TMPFS_NODE, TreeNode);
+    Second = RED_BLACK_TREE_VALUE(SecondNode, TMPFS_NODE, TreeNode);
+    if (First->Properties.FileId > Second->Properties.FileId) {
+        return ComparisonResultDescending;
+    }
+
+    if (First->Properties.FileId < Second->Properties.FileId) {
+        return ComparisonResultAscending;
+    }
+
+    return ComparisonResultSame;
+}
+
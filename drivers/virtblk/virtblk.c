@@ -0,0 +1,1563 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtblk.c
+
+Abstract:
+
+    This module implements driver support for virtio block devices.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "virtblk.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtblkAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+VirtblkDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VirtblkpDispatchDeviceStateChange (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    );
+
+VOID
+VirtblkpDispatchDiskStateChange (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    );
+
+VOID
+VirtblkpDispatchDiskSystemControl (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    );
+
+KSTATUS
+VirtblkpProcessResourceRequirements (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    );
+
+KSTATUS
+VirtblkpStartDevice (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    );
+
+KSTATUS
+VirtblkpEnableMsiX (
+    PVIRTBLK_DEVICE Device
+    );
+
+KSTATUS
+VirtblkpConnectInterrupts (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    );
+
+VOID
+VirtblkpDisconnectInterrupts (
+    PVIRTBLK_DEVICE Device
+    );
+
+VOID
+VirtblkpEnumerateChildren (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    );
+
+VOID
+VirtblkpProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VirtblkDriver = NULL;
+UUID VirtblkPciMsiInterfaceUuid = UUID_PCI_MESSAGE_SIGNALED_INTERRUPTS;
+
+DRIVER_FUNCTION_TABLE VirtblkDriverFunctionTable = {
+    DRIVER_FUNCTION_TABLE_VERSION,
+    NULL,
+    VirtblkAddDevice,
+    NULL,
+    NULL,
+    VirtblkDispatchStateChange,
+    VirtblkDispatchOpen,
+    VirtblkDispatchClose,
+    VirtblkDispatchIo,
+    VirtblkDispatchSystemControl,
+    NULL
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the virtio block driver. It registers
+    its other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    VirtblkDriver = Driver;
+    Status = IoRegisterDriverFunctions(Driver, &VirtblkDriverFunctionTable);
+    return Status;
+}
+
+KSTATUS
+VirtblkAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the virtio
+    block driver acts as the function driver. The driver will attach itself to
+    the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PVIRTBLK_DEVICE Device;
+    KSTATUS Status;
+
+    Device = MmAllocateNonPagedPool(sizeof(VIRTBLK_DEVICE),
+                                    VIRTBLK_ALLOCATION_TAG);
+
+    if (Device == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Device, sizeof(VIRTBLK_DEVICE));
+    Device->Type = VirtblkContextDevice;
+    Device->InterruptLine = INVALID_INTERRUPT_LINE;
+    Device->InterruptVector = INVALID_INTERRUPT_VECTOR;
+    Device->OsDevice = DeviceToken;
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device != NULL) {
+            MmFreeNonPagedPool(Device);
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VirtblkDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DEVICE Device;
+
+    Device = DeviceContext;
+    switch (Device->Type) {
+    case VirtblkContextDevice:
+        VirtblkpDispatchDeviceStateChange(Irp, Device);
+        break;
+
+    case VirtblkContextDisk:
+        VirtblkpDispatchDiskStateChange(Irp, (PVIRTBLK_DISK)Device);
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        IoCompleteIrp(VirtblkDriver, Irp, STATUS_INVALID_CONFIGURATION);
+        break;
+    }
+
+    return;
+}
+
+VOID
+VirtblkDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+
+    //
+    // Only the disk can be opened or closed.
+    //
+
+    Disk = (PVIRTBLK_DISK)DeviceContext;
+    if (Disk->Type != VirtblkContextDisk) {
+        return;
+    }
+
+    Irp->U.Open.DeviceContext = Disk;
+    IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+VirtblkDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+
+    //
+    // Only the disk can be opened or closed.
+    //
+
+    Disk = (PVIRTBLK_DISK)DeviceContext;
+    if (Disk->Type != VirtblkContextDisk) {
+        return;
+    }
+
+    IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+VirtblkDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL CompleteIrp;
+    ULONG IrpReadWriteFlags;
+    PVIRTBLK_DISK Disk;
+    BOOL PmReferenceAdded;
+    KSTATUS Status;
+
+    Disk = (PVIRTBLK_DISK)Irp->U.ReadWrite.DeviceContext;
+    if (Disk->Type != VirtblkContextDisk) {
+        return;
+    }
+
+    CompleteIrp = TRUE;
+
+    //
+    // If this IRP is on the way down, always add a power management reference.
+    //
+
+    PmReferenceAdded = FALSE;
+    if (Irp->Direction == IrpDown) {
+        Status = PmDeviceAddReference(Disk->OsDevice);
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        PmReferenceAdded = TRUE;
+    }
+
+    //
+    // Set the IRP read/write flags for the preparation and completion steps.
+    //
+
+    IrpReadWriteFlags = IRP_READ_WRITE_FLAG_DMA;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        IrpReadWriteFlags |= IRP_READ_WRITE_FLAG_WRITE;
+    }
+
+    //
+    // If the IRP is on the way up, then clean up after the DMA. An IRP going
+    // up is already complete.
+    //
+
+    if (Irp->Direction == IrpUp) {
+        CompleteIrp = FALSE;
+        PmDeviceReleaseReference(Disk->OsDevice);
+        Status = IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+        if (!KSUCCESS(Status)) {
+            IoUpdateIrpStatus(Irp, Status);
+        }
+
+    //
+    // Start the DMA on the way down.
+    //
+
+    } else {
+        Irp->U.ReadWrite.NewIoOffset = Irp->U.ReadWrite.IoOffset;
+
+        //
+        // Virtio devices can reach all of physical memory, so the only
+        // requirement is that the buffer be block aligned.
+        //
+
+        Status = IoPrepareReadWriteIrp(&(Irp->U.ReadWrite),
+                                       1 << Disk->BlockShift,
+                                       0,
+                                       MAX_ULONGLONG,
+                                       IrpReadWriteFlags);
+
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        CompleteIrp = FALSE;
+        Status = VirtblkpEnqueueIrp(Disk, Irp);
+        if (!KSUCCESS(Status)) {
+            IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+            CompleteIrp = TRUE;
+        }
+    }
+
+DispatchIoEnd:
+    if (CompleteIrp != FALSE) {
+        if (PmReferenceAdded != FALSE) {
+            PmDeviceReleaseReference(Disk->OsDevice);
+        }
+
+        IoCompleteIrp(VirtblkDriver, Irp, Status);
+    }
+
+    return;
+}
+
+VOID
+VirtblkDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Disk = (PVIRTBLK_DISK)DeviceContext;
+    if (Disk->Type == VirtblkContextDisk) {
+        VirtblkpDispatchDiskSystemControl(Irp, Disk);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+VirtblkpDispatchDeviceStateChange (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for a virtio block device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Device - Supplies a pointer to the device context.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Irp->Direction == IrpUp) {
+        if (!KSUCCESS(IoGetIrpStatus(Irp))) {
+            return;
+        }
+
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = VirtblkpProcessResourceRequirements(Irp, Device);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtblkDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = VirtblkpStartDevice(Irp, Device);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VirtblkDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorQueryChildren:
+            VirtblkpEnumerateChildren(Irp, Device);
+            break;
+
+        case IrpMinorIdle:
+        case IrpMinorSuspend:
+        case IrpMinorResume:
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtblkpDispatchDiskStateChange (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for the virtio block disk.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Disk - Supplies a pointer to the disk.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorStartDevice:
+
+            ASSERT(Disk->OsDevice == Irp->Device);
+
+            Status = PmInitialize(Irp->Device);
+            IoCompleteIrp(VirtblkDriver, Irp, Status);
+            break;
+
+        case IrpMinorQueryResources:
+        case IrpMinorQueryChildren:
+        case IrpMinorIdle:
+        case IrpMinorSuspend:
+        case IrpMinorResume:
+            IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorRemoveDevice:
+            Disk->BlockCount = 0;
+            IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtblkpDispatchDiskSystemControl (
+    PIRP Irp,
+    PVIRTBLK_DISK Disk
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs for the virtio block disk.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Disk - Supplies a pointer to the disk.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG BlockSize;
+    PVOID Context;
+    PSYSTEM_CONTROL_FILE_OPERATION FileOperation;
+    PSYSTEM_CONTROL_LOOKUP Lookup;
+    PFILE_PROPERTIES Properties;
+    ULONGLONG PropertiesFileSize;
+    KSTATUS Status;
+
+    BlockSize = 1 << Disk->BlockShift;
+    Context = Irp->U.SystemControl.SystemContext;
+    if (Irp->Direction == IrpUp) {
+
+        ASSERT(Irp->MinorCode == IrpMinorSystemControlSynchronize);
+
+        PmDeviceReleaseReference(Disk->OsDevice);
+        return;
+    }
+
+    switch (Irp->MinorCode) {
+    case IrpMinorSystemControlLookup:
+        Lookup = (PSYSTEM_CONTROL_LOOKUP)Context;
+        Status = STATUS_PATH_NOT_FOUND;
+        if (Lookup->Root != FALSE) {
+
+            //
+            // Enable opening of the root as a single file.
+            //
+
+            Properties = Lookup->Properties;
+            Properties->FileId = 0;
+            Properties->Type = IoObjectBlockDevice;
+            Properties->HardLinkCount = 1;
+            Properties->BlockSize = BlockSize;
+            Properties->BlockCount = Disk->BlockCount;
+            Properties->Size = Disk->BlockCount << Disk->BlockShift;
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(VirtblkDriver, Irp, Status);
+        break;
+
+    //
+    // Writes to the disk's properties are not allowed. Fail if the data
+    // has changed.
+    //
+
+    case IrpMinorSystemControlWriteFileProperties:
+        FileOperation = (PSYSTEM_CONTROL_FILE_OPERATION)Context;
+        Properties = FileOperation->FileProperties;
+        PropertiesFileSize = Properties->Size;
+        if ((Properties->FileId != 0) ||
+            (Properties->Type != IoObjectBlockDevice) ||
+            (Properties->HardLinkCount != 1) ||
+            (Properties->BlockSize != BlockSize) ||
+            (Properties->BlockCount != Disk->BlockCount) ||
+            (PropertiesFileSize !=
+             (Disk->BlockCount << Disk->BlockShift))) {
+
+            Status = STATUS_NOT_SUPPORTED;
+
+        } else {
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(VirtblkDriver, Irp, Status);
+        break;
+
+    //
+    // Do not support disk device truncation.
+    //
+
+    case IrpMinorSystemControlTruncate:
+        IoCompleteIrp(VirtblkDriver, Irp, STATUS_NOT_SUPPORTED);
+        break;
+
+    //
+    // Gather and return device information.
+    //
+
+    case IrpMinorSystemControlDeviceInformation:
+        break;
+
+    //
+    // Send a flush command to the device upon getting a synchronize request.
+    // Devices that do not offer flush have no volatile write cache.
+    //
+
+    case IrpMinorSystemControlSynchronize:
+        if ((Disk->Device->Features & VIRTBLK_FEATURE_FLUSH) == 0) {
+            IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+            break;
+        }
+
+        Status = PmDeviceAddReference(Disk->OsDevice);
+        if (!KSUCCESS(Status)) {
+            IoCompleteIrp(VirtblkDriver, Irp, Status);
+            break;
+        }
+
+        Status = VirtblkpEnqueueIrp(Disk, Irp);
+        if (!KSUCCESS(Status)) {
+            PmDeviceReleaseReference(Disk->OsDevice);
+            IoCompleteIrp(VirtblkDriver, Irp, Status);
+        }
+
+        break;
+
+    //
+    // Ignore everything unrecognized.
+    //
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    return;
+}
+
+KSTATUS
+VirtblkpProcessResourceRequirements (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine filters through the resource requirements presented by the
+    bus for a virtio block device. If MSI-X is available, it requests one
+    vector per processor, up to the queue limit. Otherwise it adds an
+    interrupt vector requirement for any interrupt line requested.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Device - Supplies a pointer to the virtio block device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_CONFIGURATION_LIST ConfigurationList;
+    ULONGLONG EdgeTriggered;
+    ULONG Index;
+    ULONGLONG LineCharacteristics;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    PRESOURCE_REQUIREMENT NextRequirement;
+    PRESOURCE_REQUIREMENT Requirement;
+    PRESOURCE_REQUIREMENT_LIST RequirementList;
+    KSTATUS Status;
+    ULONGLONG VectorCharacteristics;
+    ULONG VectorCount;
+    PRESOURCE_REQUIREMENT VectorRequirement;
+    RESOURCE_REQUIREMENT VectorTemplate;
+
+    ASSERT((Irp->MajorCode == IrpMajorStateChange) &&
+           (Irp->MinorCode == IrpMinorQueryResources));
+
+    //
+    // Initialize a nice interrupt vector requirement in preparation.
+    //
+
+    RtlZeroMemory(&VectorTemplate, sizeof(RESOURCE_REQUIREMENT));
+    VectorTemplate.Type = ResourceTypeInterruptVector;
+    VectorTemplate.Minimum = 0;
+    VectorTemplate.Maximum = -1;
+    VectorTemplate.Length = 1;
+
+    //
+    // Prefer MSI-X over legacy interrupts, as it allows each request queue
+    // to interrupt the processor that submits to it. Configuration change
+    // interrupts are not used, so no extra vector is needed for them.
+    //
+
+    if ((Device->PciMsiFlags &
+         VIRTBLK_PCI_MSI_FLAG_INTERFACE_REGISTERED) == 0) {
+
+        Status = IoRegisterForInterfaceNotifications(
+                               &VirtblkPciMsiInterfaceUuid,
+                               VirtblkpProcessPciMsiInterfaceChangeNotification,
+                                Irp->Device,
+                                Device,
+                                TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Device->PciMsiFlags |= VIRTBLK_PCI_MSI_FLAG_INTERFACE_REGISTERED;
+    }
+
+    VectorCount = 0;
+    if ((Device->PciMsiFlags &
+         VIRTBLK_PCI_MSI_FLAG_INTERFACE_AVAILABLE) != 0) {
+
+        MsiInterface = &(Device->PciMsiInterface);
+        RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+        MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+        MsiInformation.MsiType = PciMsiTypeExtended;
+        Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                                 &MsiInformation,
+                                                 FALSE);
+
+        if ((KSUCCESS(Status)) && (MsiInformation.MaxVectorCount != 0)) {
+            VectorCount = KeGetActiveProcessorCount();
+            if (VectorCount > VIRTBLK_MAX_QUEUES) {
+                VectorCount = VIRTBLK_MAX_QUEUES;
+            }
+
+            if (VectorCount > MsiInformation.MaxVectorCount) {
+                VectorCount = MsiInformation.MaxVectorCount;
+            }
+        }
+    }
+
+    ConfigurationList = Irp->U.QueryResources.ResourceRequirements;
+    if (VectorCount != 0) {
+        RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                         NULL);
+
+        while (RequirementList != NULL) {
+            for (Index = 0; Index < VectorCount; Index += 1) {
+                VectorTemplate.Characteristics =
+                                               INTERRUPT_VECTOR_EDGE_TRIGGERED;
+
+                VectorTemplate.OwningRequirement = NULL;
+                Status = IoCreateAndAddResourceRequirement(&VectorTemplate,
+                                                           RequirementList,
+                                                           &VectorRequirement);
+
+                if (!KSUCCESS(Status)) {
+                    goto ProcessResourceRequirementsEnd;
+                }
+
+                //
+                // In case the MSI-X vectors cannot be allocated, give the
+                // first vector alternatives for each interrupt line so the
+                // device can fall back to a single line interrupt.
+                //
+
+                if (Index != 0) {
+                    continue;
+                }
+
+                Requirement = IoGetNextResourceRequirement(RequirementList,
+                                                           NULL);
+
+                while (Requirement != NULL) {
+                    NextRequirement = IoGetNextResourceRequirement(
+                                                               RequirementList,
+                                                               Requirement);
+
+                    if (Requirement->Type != ResourceTypeInterruptLine) {
+                        Requirement = NextRequirement;
+                        continue;
+                    }
+
+                    VectorCharacteristics = 0;
+                    LineCharacteristics = Requirement->Characteristics;
+                    if ((LineCharacteristics &
+                         INTERRUPT_LINE_ACTIVE_LOW) != 0) {
+
+                        VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_LOW;
+                    }
+
+                    if ((LineCharacteristics &
+                         INTERRUPT_LINE_ACTIVE_HIGH) != 0) {
+
+                        VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_HIGH;
+                    }
+
+                    EdgeTriggered = LineCharacteristics &
+                                    INTERRUPT_LINE_EDGE_TRIGGERED;
+
+                    if (EdgeTriggered != 0) {
+                        VectorCharacteristics |=
+                                               INTERRUPT_VECTOR_EDGE_TRIGGERED;
+                    }
+
+                    VectorTemplate.Characteristics = VectorCharacteristics;
+                    VectorTemplate.OwningRequirement = Requirement;
+                    Status = IoCreateAndAddResourceRequirementAlternative(
+                                                            &VectorTemplate,
+                                                            VectorRequirement);
+
+                    if (!KSUCCESS(Status)) {
+                        goto ProcessResourceRequirementsEnd;
+                    }
+
+                    Requirement = NextRequirement;
+                }
+            }
+
+            RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                             RequirementList);
+        }
+
+        Device->PciMsiFlags |= VIRTBLK_PCI_MSI_FLAG_RESOURCES_REQUESTED;
+
+    //
+    // Otherwise stick with the good, old legacy interrupt setup.
+    //
+
+    } else {
+        Status = IoCreateAndAddInterruptVectorsForLines(ConfigurationList,
+                                                        &VectorTemplate);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+    }
+
+    Status = STATUS_SUCCESS;
+
+ProcessResourceRequirementsEnd:
+    return Status;
+}
+
+KSTATUS
+VirtblkpStartDevice (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts a virtio block device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Device - Supplies a pointer to the virtio block device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_ALLOCATION Allocation;
+    PRESOURCE_ALLOCATION_LIST AllocationList;
+    PRESOURCE_ALLOCATION IoPort;
+    PRESOURCE_ALLOCATION LineAllocation;
+    ULONG QueueCount;
+    KSTATUS Status;
+
+    IoPort = NULL;
+    Device->MsiVectorCount = 0;
+    Status = PmInitialize(Irp->Device);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Status = PmDeviceAddReference(Irp->Device);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // Loop through the allocated resources to get the registers and the
+    // interrupts.
+    //
+
+    AllocationList = Irp->U.StartDevice.ProcessorLocalResources;
+    Allocation = IoGetNextResourceAllocation(AllocationList, NULL);
+    while (Allocation != NULL) {
+
+        //
+        // The presence of an owning interrupt line allocation dictates
+        // whether or not MSI-X is used versus legacy interrupts.
+        //
+
+        if (Allocation->Type == ResourceTypeInterruptVector) {
+            LineAllocation = Allocation->OwningAllocation;
+            if (LineAllocation == NULL) {
+
+                ASSERT((Device->PciMsiFlags &
+                        VIRTBLK_PCI_MSI_FLAG_RESOURCES_REQUESTED) != 0);
+
+                if (Device->MsiVectorCount < VIRTBLK_MAX_QUEUES) {
+                    Device->MsiVectors[Device->MsiVectorCount] =
+                                                        Allocation->Allocation;
+
+                    Device->MsiVectorCount += 1;
+                }
+
+            } else {
+                Device->InterruptLine = LineAllocation->Allocation;
+                Device->InterruptVector = Allocation->Allocation;
+                Device->InterruptResourcesFound = TRUE;
+            }
+
+        //
+        // Look for the first I/O port range, the legacy virtio registers.
+        //
+
+        } else if (Allocation->Type == ResourceTypeIoPort) {
+            if ((IoPort == NULL) && (Allocation->Length != 0)) {
+                IoPort = Allocation;
+            }
+        }
+
+        Allocation = IoGetNextResourceAllocation(AllocationList, Allocation);
+    }
+
+    if (IoPort == NULL) {
+        RtlDebugPrint("Virtblk: Missing resources.\n");
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto StartDeviceEnd;
+    }
+
+    Device->IoPortAddress = (USHORT)IoPort->Allocation;
+
+    //
+    // Use MSI-X if the first vector did not fall back to a line. Otherwise
+    // run a single queue off of the line interrupt.
+    //
+
+    QueueCount = 1;
+    if ((Device->InterruptResourcesFound == FALSE) &&
+        (Device->MsiVectorCount != 0)) {
+
+        Device->PciMsiFlags |= VIRTBLK_PCI_MSI_FLAG_RESOURCES_ALLOCATED;
+        Device->InterruptLine = INVALID_INTERRUPT_LINE;
+        QueueCount = Device->MsiVectorCount;
+
+    } else {
+        Device->PciMsiFlags &= ~VIRTBLK_PCI_MSI_FLAG_RESOURCES_ALLOCATED;
+        Device->MsiVectorCount = 0;
+        if (Device->InterruptResourcesFound == FALSE) {
+            RtlDebugPrint("Virtblk: Missing interrupt.\n");
+            Status = STATUS_INVALID_CONFIGURATION;
+            goto StartDeviceEnd;
+        }
+    }
+
+    //
+    // MSI-X must be enabled before the device is touched, as it moves the
+    // device specific configuration and exposes the vector registers.
+    //
+
+    Device->ConfigurationOffset = VirtioRegisterDeviceConfiguration;
+    if ((Device->PciMsiFlags &
+         VIRTBLK_PCI_MSI_FLAG_RESOURCES_ALLOCATED) != 0) {
+
+        Status = VirtblkpEnableMsiX(Device);
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+
+        Device->ConfigurationOffset = VirtioRegisterMsixDeviceConfiguration;
+    }
+
+    //
+    // Reset the device, negotiate features, and create the queues.
+    //
+
+    Status = VirtblkpInitializeDevice(Device, QueueCount);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VirtblkpConnectInterrupts(Irp, Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+StartDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        VirtblkpDisconnectInterrupts(Device);
+        VirtblkpDestroyDevice(Device);
+    }
+
+    PmDeviceReleaseReference(Irp->Device);
+    return Status;
+}
+
+KSTATUS
+VirtblkpEnableMsiX (
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine programs the MSI-X table and enables MSI-X for the device.
+    Each vector is steered to the processor that submits to the matching
+    request queue, so completions are handled where the I/O was issued.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Index;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    ULONG ProcessorCount;
+    PROCESSOR_SET ProcessorSet;
+    KSTATUS Status;
+
+    MsiInterface = &(Device->PciMsiInterface);
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (Index = 0; Index < Device->MsiVectorCount; Index += 1) {
+        ProcessorSet.Target = ProcessorTargetSingleProcessor;
+        ProcessorSet.U.Number = Index % ProcessorCount;
+        Status = MsiInterface->SetVectors(MsiInterface->DeviceToken,
+                                          PciMsiTypeExtended,
+                                          Device->MsiVectors[Index],
+                                          Index,
+                                          1,
+                                          &ProcessorSet);
+
+        if (!KSUCCESS(Status)) {
+            goto EnableMsiXEnd;
+        }
+    }
+
+    RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+    MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+    MsiInformation.MsiType = PciMsiTypeExtended;
+    MsiInformation.Flags = PCI_MSI_INTERFACE_FLAG_ENABLED;
+    MsiInformation.VectorCount = Device->MsiVectorCount;
+    Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                             &MsiInformation,
+                                             TRUE);
+
+    if (!KSUCCESS(Status)) {
+        goto EnableMsiXEnd;
+    }
+
+EnableMsiXEnd:
+    return Status;
+}
+
+KSTATUS
+VirtblkpConnectInterrupts (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine connects an interrupt for each request queue. With MSI-X,
+    each queue has its own vector. Otherwise the single queue uses the line
+    interrupt.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    ULONG Index;
+    PVIRTBLK_QUEUE Queue;
+    KSTATUS Status;
+
+    RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+    Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+    Connect.Device = Irp->Device;
+    Connect.InterruptServiceRoutine = VirtblkInterruptService;
+    Connect.DispatchServiceRoutine = VirtblkInterruptServiceDpc;
+    Status = STATUS_SUCCESS;
+    for (Index = 0; Index < Device->QueueCount; Index += 1) {
+        Queue = &(Device->Queues[Index]);
+        if (Queue->InterruptHandle != INVALID_HANDLE) {
+            continue;
+        }
+
+        if (Device->MsiVectorCount != 0) {
+            Connect.LineNumber = INVALID_INTERRUPT_LINE;
+            Queue->InterruptVector = Device->MsiVectors[Index];
+
+        } else {
+            Connect.LineNumber = Device->InterruptLine;
+            Queue->InterruptVector = Device->InterruptVector;
+        }
+
+        Connect.Vector = Queue->InterruptVector;
+        Connect.Context = Queue;
+        Connect.Interrupt = &(Queue->InterruptHandle);
+        Status = IoConnectInterrupt(&Connect);
+        if (!KSUCCESS(Status)) {
+            goto ConnectInterruptsEnd;
+        }
+    }
+
+ConnectInterruptsEnd:
+    return Status;
+}
+
+VOID
+VirtblkpDisconnectInterrupts (
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine disconnects any interrupts connected for the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PVIRTBLK_QUEUE Queue;
+
+    if (Device->Queues == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < Device->QueueCount; Index += 1) {
+        Queue = &(Device->Queues[Index]);
+        if (Queue->InterruptHandle != INVALID_HANDLE) {
+            IoDisconnectInterrupt(Queue->InterruptHandle);
+            Queue->InterruptHandle = INVALID_HANDLE;
+        }
+    }
+
+    return;
+}
+
+VOID
+VirtblkpEnumerateChildren (
+    PIRP Irp,
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the disk device for the virtio block device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Device - Supplies a pointer to the virtio block device.
+
+Return Value:
+
+    None. The IRP is completed with the appropriate status.
+
+--*/
+
+{
+
+    PVIRTBLK_DISK Disk;
+    KSTATUS Status;
+
+    Disk = Device->Disk;
+    if ((Disk == NULL) || (Disk->BlockCount == 0)) {
+        IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+        return;
+    }
+
+    //
+    // Create a new device if there was not one there before.
+    //
+
+    if (Disk->OsDevice == NULL) {
+        Status = IoCreateDevice(VirtblkDriver,
+                                Disk,
+                                Irp->Device,
+                                "Disk",
+                                DISK_CLASS_ID,
+                                NULL,
+                                &(Disk->OsDevice));
+
+        if (!KSUCCESS(Status)) {
+            goto EnumerateChildrenEnd;
+        }
+
+        //
+        // The host schedules the backing storage itself, so requests are
+        // passed along in the order they arrive.
+        //
+
+        IoSetDeviceBlockQueuePolicy(Disk->OsDevice, BlockQueuePolicyNoop);
+    }
+
+    Status = IoMergeChildArrays(Irp,
+                                &(Disk->OsDevice),
+                                1,
+                                VIRTBLK_ALLOCATION_TAG);
+
+    if (!KSUCCESS(Status)) {
+        goto EnumerateChildrenEnd;
+    }
+
+EnumerateChildrenEnd:
+    IoCompleteIrp(VirtblkDriver, Irp, Status);
+    return;
+}
+
+VOID
+VirtblkpProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI MSI interface changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DEVICE VirtblkDevice;
+
+    VirtblkDevice = (PVIRTBLK_DEVICE)Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_MSI)) {
+
+            ASSERT((VirtblkDevice->PciMsiFlags &
+                    VIRTBLK_PCI_MSI_FLAG_INTERFACE_AVAILABLE) == 0);
+
+            RtlCopyMemory(&(VirtblkDevice->PciMsiInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_MSI));
+
+            VirtblkDevice->PciMsiFlags |=
+                                      VIRTBLK_PCI_MSI_FLAG_INTERFACE_AVAILABLE;
+        }
+
+    } else {
+        VirtblkDevice->PciMsiFlags &= ~VIRTBLK_PCI_MSI_FLAG_INTERFACE_AVAILABLE;
+    }
+
+    return;
+}
+
@@ -0,0 +1,573 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtblk.h
+
+Abstract:
+
+    This header contains definitions for the virtio block device driver.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/intrface/pci.h>
+#include <minoca/virtio/virtio.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// Define macros for accessing the legacy virtio registers, which live in I/O
+// port space.
+//
+
+#define VIRTBLK_READ_REGISTER32(_Device, _Register) \
+    HlIoPortInLong((_Device)->IoPortAddress + (_Register))
+
+#define VIRTBLK_READ_REGISTER16(_Device, _Register) \
+    HlIoPortInShort((_Device)->IoPortAddress + (_Register))
+
+#define VIRTBLK_READ_REGISTER8(_Device, _Register) \
+    HlIoPortInByte((_Device)->IoPortAddress + (_Register))
+
+#define VIRTBLK_WRITE_REGISTER32(_Device, _Register, _Value) \
+    HlIoPortOutLong((_Device)->IoPortAddress + (_Register), (_Value))
+
+#define VIRTBLK_WRITE_REGISTER16(_Device, _Register, _Value) \
+    HlIoPortOutShort((_Device)->IoPortAddress + (_Register), (_Value))
+
+#define VIRTBLK_WRITE_REGISTER8(_Device, _Register, _Value) \
+    HlIoPortOutByte((_Device)->IoPortAddress + (_Register), (_Value))
+
+//
+// Define macros for accessing the block specific configuration, which follows
+// the common registers.
+//
+
+#define VIRTBLK_READ_CONFIGURATION32(_Device, _Offset)      \
+    HlIoPortInLong((_Device)->IoPortAddress +               \
+                   (_Device)->ConfigurationOffset +         \
+                   (_Offset))
+
+#define VIRTBLK_READ_CONFIGURATION16(_Device, _Offset)      \
+    HlIoPortInShort((_Device)->IoPortAddress +              \
+                    (_Device)->ConfigurationOffset +        \
+                    (_Offset))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define VIRTBLK_ALLOCATION_TAG 0x6B6C6256 // 'klbV'
+
+//
+// Define the maximum number of request queues the driver will use. Each one
+// gets its own interrupt vector and is used by one processor.
+//
+
+#define VIRTBLK_MAX_QUEUES 16
+
+//
+// Define the maximum number of requests in flight on a single queue.
+//
+
+#define VIRTBLK_MAX_REQUESTS 64
+
+//
+// Define the size of the page each request owns. The command lives at the
+// start of the page and the indirect descriptor table fills the rest.
+//
+
+#define VIRTBLK_REQUEST_PAGE_SIZE 4096
+
+//
+// Define the number of descriptors in a request's indirect table.
+//
+
+#define VIRTBLK_INDIRECT_DESCRIPTORS                            \
+    ((VIRTBLK_REQUEST_PAGE_SIZE - sizeof(VIRTBLK_COMMAND)) /    \
+     sizeof(VIRTIO_QUEUE_DESCRIPTOR))
+
+//
+// Define the number of ring descriptors each request owns when indirect
+// descriptors are not available.
+//
+
+#define VIRTBLK_DIRECT_DESCRIPTORS 16
+
+//
+// Define the number of descriptors in each request that do not describe data:
+// the request header and the status byte.
+//
+
+#define VIRTBLK_OVERHEAD_DESCRIPTORS 2
+
+//
+// Define the unit of the sector field in requests and of the capacity,
+// regardless of the device's block size.
+//
+
+#define VIRTBLK_SECTOR_SHIFT 9
+
+//
+// Define the range of block sizes the driver supports, as powers of two.
+//
+
+#define VIRTBLK_MAX_BLOCK_SHIFT 12
+
+//
+// Define the block device feature bits.
+//
+
+#define VIRTBLK_FEATURE_SIZE_MAX        (1 << 1)
+#define VIRTBLK_FEATURE_SEGMENT_MAX     (1 << 2)
+#define VIRTBLK_FEATURE_BLOCK_SIZE      (1 << 6)
+#define VIRTBLK_FEATURE_FLUSH           (1 << 9)
+#define VIRTBLK_FEATURE_MULTIQUEUE      (1 << 12)
+
+//
+// Define the set of features the driver accepts.
+//
+
+#define VIRTBLK_SUPPORTED_FEATURES          \
+    (VIRTBLK_FEATURE_SIZE_MAX |             \
+     VIRTBLK_FEATURE_SEGMENT_MAX |          \
+     VIRTBLK_FEATURE_BLOCK_SIZE |           \
+     VIRTBLK_FEATURE_FLUSH |                \
+     VIRTBLK_FEATURE_MULTIQUEUE |           \
+     VIRTIO_FEATURE_INDIRECT_DESCRIPTOR |   \
+     VIRTIO_FEATURE_EVENT_INDEX)
+
+//
+// Define the offsets into the block device configuration.
+//
+
+#define VIRTBLK_CONFIGURATION_CAPACITY 0x00
+#define VIRTBLK_CONFIGURATION_SIZE_MAX 0x08
+#define VIRTBLK_CONFIGURATION_SEGMENT_MAX 0x0C
+#define VIRTBLK_CONFIGURATION_BLOCK_SIZE 0x14
+#define VIRTBLK_CONFIGURATION_QUEUE_COUNT 0x22
+
+//
+// Define the request types.
+//
+
+#define VIRTBLK_REQUEST_READ  0
+#define VIRTBLK_REQUEST_WRITE 1
+#define VIRTBLK_REQUEST_FLUSH 4
+
+//
+// Define the request status values written by the device. The driver fills
+// in the invalid value before submitting a request.
+//
+
+#define VIRTBLK_STATUS_OK          0
+#define VIRTBLK_STATUS_IO_ERROR    1
+#define VIRTBLK_STATUS_UNSUPPORTED 2
+#define VIRTBLK_STATUS_INVALID     0xFF
+
+//
+// Define PCI MSI/MSI-X flags.
+//
+
+#define VIRTBLK_PCI_MSI_FLAG_INTERFACE_REGISTERED 0x00000001
+#define VIRTBLK_PCI_MSI_FLAG_INTERFACE_AVAILABLE  0x00000002
+#define VIRTBLK_PCI_MSI_FLAG_RESOURCES_REQUESTED  0x00000004
+#define VIRTBLK_PCI_MSI_FLAG_RESOURCES_ALLOCATED  0x00000008
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef struct _VIRTBLK_DEVICE VIRTBLK_DEVICE, *PVIRTBLK_DEVICE;
+
+typedef enum _VIRTBLK_CONTEXT_TYPE {
+    VirtblkContextInvalid,
+    VirtblkContextDevice,
+    VirtblkContextDisk
+} VIRTBLK_CONTEXT_TYPE, *PVIRTBLK_CONTEXT_TYPE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the header at the start of every virtio block
+    request, followed by the status byte the device writes when it is done.
+    This structure is hardware defined.
+
+Members:
+
+    Type - Stores the request type. See VIRTBLK_REQUEST_* definitions.
+
+    Reserved - Stores a reserved field. Set to zero.
+
+    Sector - Stores the starting sector of the request, in 512 byte units.
+
+    Status - Stores the status written by the device. See VIRTBLK_STATUS_*
+        definitions.
+
+    Padding - Stores padding that keeps the indirect table that follows
+        aligned.
+
+--*/
+
+typedef struct _VIRTBLK_COMMAND {
+    ULONG Type;
+    ULONG Reserved;
+    ULONGLONG Sector;
+    UCHAR Status;
+    UCHAR Padding[15];
+} PACKED VIRTBLK_COMMAND, *PVIRTBLK_COMMAND;
+
+/*++
+
+Structure Description:
+
+    This structure defines state associated with the virtio block disk.
+
+Members:
+
+    Type - Stores a marker identifying the structure as a disk.
+
+    Device - Stores a pointer to the parent device.
+
+    OsDevice - Stores a pointer to the OS device for the disk.
+
+    BlockShift - Stores the log2 of the block size.
+
+    BlockCount - Stores the number of blocks on the disk.
+
+--*/
+
+typedef struct _VIRTBLK_DISK {
+    VIRTBLK_CONTEXT_TYPE Type;
+    PVIRTBLK_DEVICE Device;
+    PDEVICE OsDevice;
+    ULONG BlockShift;
+    ULONGLONG BlockCount;
+} VIRTBLK_DISK, *PVIRTBLK_DISK;
+
+/*++
+
+Structure Description:
+
+    This structure defines state associated with an in-flight request.
+
+Members:
+
+    Irp - Stores a pointer to the IRP the request is working on.
+
+    IoSize - Stores the number of bytes the request is transferring.
+
+    FlushPending - Stores a boolean indicating that the request is a flush
+        following a synchronized write, and the IRP completes with it.
+
+    Command - Stores the virtual address of the request's command.
+
+    CommandPhysical - Stores the physical address of the command.
+
+    Table - Stores the virtual address of the request's indirect descriptor
+        table.
+
+    TablePhysical - Stores the physical address of the indirect table.
+
+--*/
+
+typedef struct _VIRTBLK_REQUEST {
+    PIRP Irp;
+    UINTN IoSize;
+    BOOL FlushPending;
+    PVIRTBLK_COMMAND Command;
+    PHYSICAL_ADDRESS CommandPhysical;
+    PVIRTIO_QUEUE_DESCRIPTOR Table;
+    PHYSICAL_ADDRESS TablePhysical;
+} VIRTBLK_REQUEST, *PVIRTBLK_REQUEST;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio request queue.
+
+Members:
+
+    Device - Stores a pointer to the device.
+
+    Index - Stores the index of the queue within the device.
+
+    Size - Stores the number of descriptors in the queue.
+
+    IoBuffer - Stores the I/O buffer holding the queue.
+
+    Descriptors - Stores the descriptor table.
+
+    Available - Stores the available ring.
+
+    Used - Stores the used ring.
+
+    UsedEvent - Stores the pointer to the used event index, which tells the
+        device when to interrupt.
+
+    AvailableEvent - Stores the pointer to the available event index, which
+        tells the driver when to notify the device.
+
+    AvailableIndex - Stores the next available ring index the driver will
+        fill. Entries up to this index are published in batches.
+
+    LastUsedIndex - Stores the next used ring index the driver will reap.
+
+    RequestIoBuffer - Stores the I/O buffer holding one page per request.
+
+    Requests - Stores the array of request states.
+
+    RequestCount - Stores the number of requests the queue can hold.
+
+    FreeRequests - Stores the bitmask of free requests.
+
+    Lock - Stores the spin lock serializing the queue. It is acquired at
+        dispatch level.
+
+    IrpQueue - Stores the list of IRPs waiting for a free request.
+
+    InterruptVector - Stores the interrupt vector for the queue.
+
+    InterruptHandle - Stores the handle of the connected interrupt.
+
+    PendingInterrupt - Stores a boolean set by the interrupt service routine.
+
+--*/
+
+typedef struct _VIRTBLK_QUEUE {
+    PVIRTBLK_DEVICE Device;
+    USHORT Index;
+    USHORT Size;
+    PIO_BUFFER IoBuffer;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors;
+    PVIRTIO_QUEUE_AVAILABLE Available;
+    volatile VIRTIO_QUEUE_USED *Used;
+    volatile USHORT *UsedEvent;
+    volatile USHORT *AvailableEvent;
+    USHORT AvailableIndex;
+    USHORT LastUsedIndex;
+    PIO_BUFFER RequestIoBuffer;
+    PVIRTBLK_REQUEST Requests;
+    ULONG RequestCount;
+    ULONGLONG FreeRequests;
+    KSPIN_LOCK Lock;
+    LIST_ENTRY IrpQueue;
+    ULONGLONG InterruptVector;
+    HANDLE InterruptHandle;
+    volatile ULONG PendingInterrupt;
+} VIRTBLK_QUEUE, *PVIRTBLK_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines state associated with a virtio block device.
+
+Members:
+
+    Type - Stores a value identifying this structure as a device.
+
+    OsDevice - Stores a pointer to the device's OS device.
+
+    IoPortAddress - Stores the base of the legacy virtio registers.
+
+    ConfigurationOffset - Stores the offset of the block specific
+        configuration from the register base.
+
+    InterruptLine - Stores the interrupt line if a line interrupt is in use,
+        or INVALID_INTERRUPT_LINE if MSI-X is in use.
+
+    InterruptVector - Stores the line interrupt's vector.
+
+    InterruptResourcesFound - Stores a boolean indicating if a line interrupt
+        was allocated.
+
+    PciMsiFlags - Stores a bitmask of MSI state. See VIRTBLK_PCI_MSI_FLAG_*.
+
+    PciMsiInterface - Stores the PCI MSI interface.
+
+    MsiVectorCount - Stores the number of MSI-X vectors allocated.
+
+    MsiVectors - Stores the allocated MSI-X vectors.
+
+    Features - Stores the features negotiated with the device.
+
+    MaxSegments - Stores the maximum number of data segments in a request.
+
+    MaxSegmentSize - Stores the maximum size of a single data segment.
+
+    Queues - Stores the array of request queues.
+
+    QueueCount - Stores the number of request queues.
+
+    Disk - Stores a pointer to the disk exposed by the device.
+
+--*/
+
+struct _VIRTBLK_DEVICE {
+    VIRTBLK_CONTEXT_TYPE Type;
+    PDEVICE OsDevice;
+    USHORT IoPortAddress;
+    USHORT ConfigurationOffset;
+    ULONGLONG InterruptLine;
+    ULONGLONG InterruptVector;
+    BOOL InterruptResourcesFound;
+    ULONG PciMsiFlags;
+    INTERFACE_PCI_MSI PciMsiInterface;
+    ULONG MsiVectorCount;
+    ULONGLONG MsiVectors[VIRTBLK_MAX_QUEUES];
+    ULONG Features;
+    ULONG MaxSegments;
+    ULONG MaxSegmentSize;
+    PVIRTBLK_QUEUE Queues;
+    ULONG QueueCount;
+    PVIRTBLK_DISK Disk;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+extern PDRIVER VirtblkDriver;
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+INTERRUPT_STATUS
+VirtblkInterruptService (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio block interrupt service routine for a
+    request queue.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+INTERRUPT_STATUS
+VirtblkInterruptServiceDpc (
+    PVOID Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio block dispatch level interrupt
+    service, which reaps completed requests from a queue.
+
+Arguments:
+
+    Parameter - Supplies the context, in this case the queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+KSTATUS
+VirtblkpInitializeDevice (
+    PVIRTBLK_DEVICE Device,
+    ULONG QueueCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the device, negotiates features, reads the disk
+    geometry, sets up the request queues, and brings the device up.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    QueueCount - Supplies the number of queues the caller has interrupt
+        vectors for.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+VirtblkpDestroyDevice (
+    PVIRTBLK_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the device and frees its queues.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+VirtblkpEnqueueIrp (
+    PVIRTBLK_DISK Disk,
+    PIRP Irp
+    );
+
+/*++
+
+Routine Description:
+
+    This routine begins I/O on a fresh IRP, using the current processor's
+    request queue.
+
+Arguments:
+
+    Disk - Supplies a pointer to the disk.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was successfully started or even queued.
+
+    Error code on failure.
+
+--*/
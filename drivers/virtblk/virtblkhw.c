@@ -0,0 +1,1699 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtblkhw.c
+
+Abstract:
+
+    This module implements the hardware support for virtio block devices:
+    feature negotiation, request queue management, and the I/O path.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "virtblk.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro evaluates to non-zero if the device negotiated indirect
+// descriptors.
+//
+
+#define VIRTBLK_INDIRECT(_Device) \
+    (((_Device)->Features & VIRTIO_FEATURE_INDIRECT_DESCRIPTOR) != 0)
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtblkpAllocateQueue (
+    PVIRTBLK_DEVICE Device,
+    PVIRTBLK_QUEUE Queue,
+    USHORT Index
+    );
+
+VOID
+VirtblkpFreeQueue (
+    PVIRTBLK_QUEUE Queue
+    );
+
+VOID
+VirtblkpNotifyQueue (
+    PVIRTBLK_QUEUE Queue
+    );
+
+VOID
+VirtblkpProcessCompletions (
+    PVIRTBLK_QUEUE Queue
+    );
+
+LONG
+VirtblkpAllocateRequest (
+    PVIRTBLK_QUEUE Queue
+    );
+
+VOID
+VirtblkpFreeRequest (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex
+    );
+
+VOID
+VirtblkpBeginNextIrp (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex
+    );
+
+VOID
+VirtblkpStartIrp (
+    PVIRTBLK_QUEUE Queue,
+    PIRP Irp,
+    LONG RequestIndex
+    );
+
+VOID
+VirtblkpPerformIo (
+    PVIRTBLK_QUEUE Queue,
+    PIRP Irp,
+    LONG RequestIndex
+    );
+
+UINTN
+VirtblkpBuildDataDescriptors (
+    PVIRTBLK_DEVICE Device,
+    PIO_BUFFER IoBuffer,
+    UINTN FragmentIndex,
+    UINTN FragmentOffset,
+    UINTN TransferSize,
+    ULONG BlockSize,
+    USHORT Flags,
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors,
+    USHORT FirstIndex,
+    PULONG DescriptorCount
+    );
+
+VOID
+VirtblkpExecuteFlush (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex
+    );
+
+PVIRTIO_QUEUE_DESCRIPTOR
+VirtblkpGetRequestDescriptors (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex,
+    PUSHORT FirstIndex
+    );
+
+VOID
+VirtblkpSubmitRequest (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex,
+    ULONG DescriptorCount
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+INTERRUPT_STATUS
+VirtblkInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio block interrupt service routine for a
+    request queue.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTBLK_DEVICE Device;
+    UCHAR PendingBits;
+    PVIRTBLK_QUEUE Queue;
+
+    Queue = (PVIRTBLK_QUEUE)Context;
+    Device = Queue->Device;
+
+    //
+    // MSI-X vectors are not shared, so the interrupt is always for this
+    // queue.
+    //
+
+    if (Device->MsiVectorCount != 0) {
+        RtlAtomicExchange32(&(Queue->PendingInterrupt), TRUE);
+        return InterruptStatusClaimed;
+    }
+
+    //
+    // Reading the status register acknowledges the interrupt. If nothing is
+    // set then the interrupt belongs to someone else sharing the line.
+    // Configuration changes are acknowledged but otherwise ignored.
+    //
+
+    PendingBits = VIRTBLK_READ_REGISTER8(Device, VirtioRegisterIsrStatus);
+    if (PendingBits == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    if ((PendingBits & VIRTIO_ISR_QUEUE) != 0) {
+        RtlAtomicExchange32(&(Queue->PendingInterrupt), TRUE);
+    }
+
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtblkInterruptServiceDpc (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio block dispatch level interrupt
+    service, which reaps completed requests from a queue.
+
+Arguments:
+
+    Parameter - Supplies the context, in this case the queue.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTBLK_QUEUE Queue;
+
+    Queue = (PVIRTBLK_QUEUE)Parameter;
+    if (RtlAtomicExchange32(&(Queue->PendingInterrupt), FALSE) == FALSE) {
+        return InterruptStatusNotClaimed;
+    }
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+
+    KeAcquireSpinLock(&(Queue->Lock));
+    VirtblkpProcessCompletions(Queue);
+    KeReleaseSpinLock(&(Queue->Lock));
+    return InterruptStatusClaimed;
+}
+
+KSTATUS
+VirtblkpInitializeDevice (
+    PVIRTBLK_DEVICE Device,
+    ULONG QueueCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the device, negotiates features, reads the disk
+    geometry, sets up the request queues, and brings the device up.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    QueueCount - Supplies the number of queues the caller has interrupt
+        vectors for.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    ULONG BlockShift;
+    ULONG BlockSize;
+    ULONGLONG Capacity;
+    ULONG DeviceFeatures;
+    ULONG DeviceQueueCount;
+    PVIRTBLK_DISK Disk;
+    ULONG Features;
+    ULONG Index;
+    PVIRTBLK_QUEUE Queue;
+    ULONG SegmentMax;
+    ULONG SizeMax;
+    KSTATUS Status;
+    USHORT Vector;
+
+    ASSERT(Device->Queues == NULL);
+
+    //
+    // Reset the device and announce that a driver has found it.
+    //
+
+    VIRTBLK_WRITE_REGISTER8(Device, VirtioRegisterDeviceStatus, 0);
+    VIRTBLK_WRITE_REGISTER8(Device,
+                            VirtioRegisterDeviceStatus,
+                            VIRTIO_STATUS_ACKNOWLEDGE);
+
+    VIRTBLK_WRITE_REGISTER8(Device,
+                            VirtioRegisterDeviceStatus,
+                            VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    DeviceFeatures = VIRTBLK_READ_REGISTER32(Device,
+                                             VirtioRegisterDeviceFeatures);
+
+    Features = DeviceFeatures & VIRTBLK_SUPPORTED_FEATURES;
+    VIRTBLK_WRITE_REGISTER32(Device, VirtioRegisterDriverFeatures, Features);
+    Device->Features = Features;
+
+    //
+    // The capacity is always in 512 byte sectors. Use the device's preferred
+    // block size if it is one the driver can handle.
+    //
+
+    Capacity = VIRTBLK_READ_CONFIGURATION32(Device,
+                                            VIRTBLK_CONFIGURATION_CAPACITY);
+
+    Capacity |= (ULONGLONG)VIRTBLK_READ_CONFIGURATION32(
+                                      Device,
+                                      VIRTBLK_CONFIGURATION_CAPACITY + 4) << 32;
+
+    BlockShift = VIRTBLK_SECTOR_SHIFT;
+    if ((Features & VIRTBLK_FEATURE_BLOCK_SIZE) != 0) {
+        BlockSize = VIRTBLK_READ_CONFIGURATION32(
+                                             Device,
+                                             VIRTBLK_CONFIGURATION_BLOCK_SIZE);
+
+        if ((POWER_OF_2(BlockSize) != FALSE) &&
+            (BlockSize > (1 << VIRTBLK_SECTOR_SHIFT)) &&
+            (BlockSize <= (1 << VIRTBLK_MAX_BLOCK_SHIFT))) {
+
+            while ((1 << BlockShift) < BlockSize) {
+                BlockShift += 1;
+            }
+        }
+    }
+
+    //
+    // Figure out how large a request can be. Indirect tables hold far more
+    // segments than the slice of the ring a request gets without them.
+    //
+
+    Device->MaxSegmentSize = MAX_ULONG;
+    if ((Features & VIRTBLK_FEATURE_SIZE_MAX) != 0) {
+        SizeMax = VIRTBLK_READ_CONFIGURATION32(Device,
+                                               VIRTBLK_CONFIGURATION_SIZE_MAX);
+
+        if (SizeMax >= (1 << BlockShift)) {
+            Device->MaxSegmentSize = SizeMax;
+        }
+    }
+
+    if (VIRTBLK_INDIRECT(Device)) {
+        Device->MaxSegments = VIRTBLK_INDIRECT_DESCRIPTORS -
+                              VIRTBLK_OVERHEAD_DESCRIPTORS;
+
+    } else {
+        Device->MaxSegments = VIRTBLK_DIRECT_DESCRIPTORS -
+                              VIRTBLK_OVERHEAD_DESCRIPTORS;
+    }
+
+    if ((Features & VIRTBLK_FEATURE_SEGMENT_MAX) != 0) {
+        SegmentMax = VIRTBLK_READ_CONFIGURATION32(
+                                            Device,
+                                            VIRTBLK_CONFIGURATION_SEGMENT_MAX);
+
+        if ((SegmentMax != 0) && (SegmentMax < Device->MaxSegments)) {
+            Device->MaxSegments = SegmentMax;
+        }
+    }
+
+    //
+    // Figure out how many queues to use.
+    //
+
+    DeviceQueueCount = 1;
+    if ((Features & VIRTBLK_FEATURE_MULTIQUEUE) != 0) {
+        DeviceQueueCount = VIRTBLK_READ_CONFIGURATION16(
+                                            Device,
+                                            VIRTBLK_CONFIGURATION_QUEUE_COUNT);
+
+        if (DeviceQueueCount == 0) {
+            DeviceQueueCount = 1;
+        }
+    }
+
+    if (QueueCount > DeviceQueueCount) {
+        QueueCount = DeviceQueueCount;
+    }
+
+    if (QueueCount > VIRTBLK_MAX_QUEUES) {
+        QueueCount = VIRTBLK_MAX_QUEUES;
+    }
+
+    ASSERT(QueueCount != 0);
+
+    AllocationSize = sizeof(VIRTBLK_QUEUE) * QueueCount;
+    Device->Queues = MmAllocateNonPagedPool(AllocationSize,
+                                            VIRTBLK_ALLOCATION_TAG);
+
+    if (Device->Queues == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeDeviceEnd;
+    }
+
+    RtlZeroMemory(Device->Queues, AllocationSize);
+    for (Index = 0; Index < QueueCount; Index += 1) {
+        Queue = &(Device->Queues[Index]);
+        Queue->Device = Device;
+        Queue->InterruptHandle = INVALID_HANDLE;
+        KeInitializeSpinLock(&(Queue->Lock));
+        INITIALIZE_LIST_HEAD(&(Queue->IrpQueue));
+    }
+
+    Device->QueueCount = QueueCount;
+    for (Index = 0; Index < QueueCount; Index += 1) {
+        Status = VirtblkpAllocateQueue(Device, &(Device->Queues[Index]), Index);
+        if (!KSUCCESS(Status)) {
+            goto InitializeDeviceEnd;
+        }
+    }
+
+    //
+    // With MSI-X, point each queue at its own table entry. Configuration
+    // changes are not used. The device reports failure by reading back the
+    // no vector value.
+    //
+
+    if (Device->MsiVectorCount != 0) {
+        VIRTBLK_WRITE_REGISTER16(Device,
+                                 VirtioRegisterConfigurationVector,
+                                 VIRTIO_MSI_NO_VECTOR);
+
+        for (Index = 0; Index < QueueCount; Index += 1) {
+            VIRTBLK_WRITE_REGISTER16(Device, VirtioRegisterQueueSelect, Index);
+            VIRTBLK_WRITE_REGISTER16(Device, VirtioRegisterQueueVector, Index);
+            Vector = VIRTBLK_READ_REGISTER16(Device, VirtioRegisterQueueVector);
+            if (Vector == VIRTIO_MSI_NO_VECTOR) {
+                Status = STATUS_DEVICE_IO_ERROR;
+                goto InitializeDeviceEnd;
+            }
+        }
+    }
+
+    //
+    // Create or update the disk.
+    //
+
+    Disk = Device->Disk;
+    if (Disk == NULL) {
+        Disk = MmAllocateNonPagedPool(sizeof(VIRTBLK_DISK),
+                                      VIRTBLK_ALLOCATION_TAG);
+
+        if (Disk == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto InitializeDeviceEnd;
+        }
+
+        RtlZeroMemory(Disk, sizeof(VIRTBLK_DISK));
+        Disk->Type = VirtblkContextDisk;
+        Disk->Device = Device;
+        Device->Disk = Disk;
+    }
+
+    Disk->BlockShift = BlockShift;
+    Disk->BlockCount = Capacity >> (BlockShift - VIRTBLK_SECTOR_SHIFT);
+    VIRTBLK_WRITE_REGISTER8(Device,
+                            VirtioRegisterDeviceStatus,
+                            (VIRTIO_STATUS_ACKNOWLEDGE |
+                             VIRTIO_STATUS_DRIVER |
+                             VIRTIO_STATUS_DRIVER_OK));
+
+    Status = STATUS_SUCCESS;
+
+InitializeDeviceEnd:
+    return Status;
+}
+
+VOID
+VirtblkpDestroyDevice (
+    PVIRTBLK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the device and frees its queues.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    //
+    // Reset the device so it stops touching the queues before they are freed.
+    //
+
+    if (Device->IoPortAddress != 0) {
+        VIRTBLK_WRITE_REGISTER8(Device, VirtioRegisterDeviceStatus, 0);
+    }
+
+    if (Device->Queues != NULL) {
+        for (Index = 0; Index < Device->QueueCount; Index += 1) {
+            VirtblkpFreeQueue(&(Device->Queues[Index]));
+        }
+
+        MmFreeNonPagedPool(Device->Queues);
+        Device->Queues = NULL;
+        Device->QueueCount = 0;
+    }
+
+    return;
+}
+
+KSTATUS
+VirtblkpEnqueueIrp (
+    PVIRTBLK_DISK Disk,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine begins I/O on a fresh IRP, using the current processor's
+    request queue.
+
+Arguments:
+
+    Disk - Supplies a pointer to the disk.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was successfully started or even queued.
+
+    Error code on failure.
+
+--*/
+
+{
+
+    PVIRTBLK_DEVICE Device;
+    RUNLEVEL OldRunLevel;
+    PVIRTBLK_QUEUE Queue;
+    ULONG QueueIndex;
+    LONG RequestIndex;
+    KSTATUS Status;
+
+    Device = Disk->Device;
+    if ((Device->Queues == NULL) || (Disk->BlockCount == 0)) {
+        return STATUS_NO_SUCH_DEVICE;
+    }
+
+    IoPendIrp(VirtblkDriver, Irp);
+
+    //
+    // Pick the queue belonging to this processor. The queue's interrupt is
+    // steered back to the same processor, so the completion stays local.
+    // Raise to dispatch first so the thread cannot migrate in between.
+    //
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    QueueIndex = KeGetCurrentProcessorNumber() % Device->QueueCount;
+    Queue = &(Device->Queues[QueueIndex]);
+    KeAcquireSpinLock(&(Queue->Lock));
+
+    //
+    // Attempt to grab a request. If they are all in use, add this IRP to the
+    // queue atomically so it's always clear who is taking care of it.
+    //
+
+    RequestIndex = VirtblkpAllocateRequest(Queue);
+    if (RequestIndex < 0) {
+        INSERT_BEFORE(&(Irp->ListEntry), &(Queue->IrpQueue));
+        Status = STATUS_SUCCESS;
+        goto EnqueueIrpEnd;
+    }
+
+    VirtblkpStartIrp(Queue, Irp, RequestIndex);
+    VirtblkpNotifyQueue(Queue);
+    Status = STATUS_SUCCESS;
+
+EnqueueIrpEnd:
+    KeReleaseSpinLock(&(Queue->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtblkpAllocateQueue (
+    PVIRTBLK_DEVICE Device,
+    PVIRTBLK_QUEUE Queue,
+    USHORT Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a virtio queue in the layout the legacy interface
+    requires, along with a page per request for its command and indirect
+    table, and hands the queue's address to the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Queue - Supplies a pointer to the queue to initialize.
+
+    Index - Supplies the index of the queue within the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_BUFFER_FRAGMENT Fragment;
+    UINTN FragmentIndex;
+    UINTN FragmentOffset;
+    ULONG IoBufferFlags;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PVIRTBLK_REQUEST Request;
+    ULONG RequestCount;
+    PIO_BUFFER RequestIoBuffer;
+    ULONG RequestIndex;
+    ULONG RingSize;
+    USHORT Size;
+    KSTATUS Status;
+    PUCHAR VirtualAddress;
+
+    ASSERT(Queue->IoBuffer == NULL);
+
+    VIRTBLK_WRITE_REGISTER16(Device, VirtioRegisterQueueSelect, Index);
+    Size = VIRTBLK_READ_REGISTER16(Device, VirtioRegisterQueueSize);
+    if ((Size == 0) || (POWER_OF_2(Size) == FALSE)) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto AllocateQueueEnd;
+    }
+
+    //
+    // With indirect descriptors each request takes one ring descriptor.
+    // Otherwise each request gets a fixed slice of the ring.
+    //
+
+    RequestCount = Size;
+    if (!VIRTBLK_INDIRECT(Device)) {
+        RequestCount = Size / VIRTBLK_DIRECT_DESCRIPTORS;
+    }
+
+    if (RequestCount > VIRTBLK_MAX_REQUESTS) {
+        RequestCount = VIRTBLK_MAX_REQUESTS;
+    }
+
+    if (RequestCount == 0) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto AllocateQueueEnd;
+    }
+
+    //
+    // The legacy interface takes a 32-bit page frame number, so keep the
+    // queue where the register can describe it.
+    //
+
+    RingSize = VIRTIO_LEGACY_QUEUE_SIZE(Size);
+    IoBufferFlags = IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS;
+    Queue->IoBuffer = MmAllocateNonPagedIoBuffer(
+                                                0,
+                                                MAX_ULONG,
+                                                VIRTIO_LEGACY_QUEUE_ALIGNMENT,
+                                                RingSize,
+                                                IoBufferFlags);
+
+    if (Queue->IoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    ASSERT(Queue->IoBuffer->FragmentCount == 1);
+
+    VirtualAddress = Queue->IoBuffer->Fragment[0].VirtualAddress;
+    PhysicalAddress = Queue->IoBuffer->Fragment[0].PhysicalAddress;
+    RtlZeroMemory(VirtualAddress, RingSize);
+    Queue->Index = Index;
+    Queue->Size = Size;
+    Queue->Descriptors = (PVIRTIO_QUEUE_DESCRIPTOR)VirtualAddress;
+    Queue->Available = (PVIRTIO_QUEUE_AVAILABLE)(VirtualAddress +
+                                   (sizeof(VIRTIO_QUEUE_DESCRIPTOR) * Size));
+
+    Queue->Used = (PVIRTIO_QUEUE_USED)(VirtualAddress +
+                                       VIRTIO_LEGACY_QUEUE_USED_OFFSET(Size));
+
+    Queue->UsedEvent = (volatile USHORT *)((PUCHAR)(Queue->Available) +
+                                           VIRTIO_QUEUE_AVAILABLE_SIZE(Size) -
+                                           sizeof(USHORT));
+
+    Queue->AvailableEvent = (volatile USHORT *)((PUCHAR)(Queue->Used) +
+                                                VIRTIO_QUEUE_USED_SIZE(Size) -
+                                                sizeof(USHORT));
+
+    Queue->AvailableIndex = 0;
+    Queue->LastUsedIndex = 0;
+
+    //
+    // Allocate the request states and a page for each request.
+    //
+
+    Queue->Requests = MmAllocateNonPagedPool(
+                                      RequestCount * sizeof(VIRTBLK_REQUEST),
+                                      VIRTBLK_ALLOCATION_TAG);
+
+    if (Queue->Requests == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    RtlZeroMemory(Queue->Requests, RequestCount * sizeof(VIRTBLK_REQUEST));
+    RequestIoBuffer = MmAllocateNonPagedIoBuffer(
+                                     0,
+                                     MAX_ULONGLONG,
+                                     VIRTBLK_REQUEST_PAGE_SIZE,
+                                     RequestCount * VIRTBLK_REQUEST_PAGE_SIZE,
+                                     0);
+
+    if (RequestIoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AllocateQueueEnd;
+    }
+
+    Queue->RequestIoBuffer = RequestIoBuffer;
+
+    //
+    // Hand out a page to each request. Fragments are page multiples, so a
+    // page never straddles two fragments.
+    //
+
+    FragmentIndex = 0;
+    FragmentOffset = 0;
+    for (RequestIndex = 0; RequestIndex < RequestCount; RequestIndex += 1) {
+
+        ASSERT(FragmentIndex < RequestIoBuffer->FragmentCount);
+
+        Fragment = &(RequestIoBuffer->Fragment[FragmentIndex]);
+        Request = &(Queue->Requests[RequestIndex]);
+        Request->Command = (PVIRTBLK_COMMAND)((PUCHAR)Fragment->VirtualAddress +
+                                               FragmentOffset);
+        Request->CommandPhysical = Fragment->PhysicalAddress + FragmentOffset;
+        Request->Table = (PVIRTIO_QUEUE_DESCRIPTOR)(Request->Command + 1);
+        Request->TablePhysical = Request->CommandPhysical +
+                                 sizeof(VIRTBLK_COMMAND);
+
+        FragmentOffset += VIRTBLK_REQUEST_PAGE_SIZE;
+        if (FragmentOffset >= Fragment->Size) {
+            FragmentIndex += 1;
+            FragmentOffset = 0;
+        }
+    }
+
+    Queue->RequestCount = RequestCount;
+    Queue->FreeRequests = MAX_ULONGLONG;
+    if (RequestCount < (sizeof(ULONGLONG) * BITS_PER_BYTE)) {
+        Queue->FreeRequests = (1ULL << RequestCount) - 1;
+    }
+
+    VIRTBLK_WRITE_REGISTER32(
+                         Device,
+                         VirtioRegisterQueueAddress,
+                         (ULONG)(PhysicalAddress >>
+                                 VIRTIO_LEGACY_QUEUE_ADDRESS_SHIFT));
+
+    Status = STATUS_SUCCESS;
+
+AllocateQueueEnd:
+    return Status;
+}
+
+VOID
+VirtblkpFreeQueue (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a virtio queue's memory. The device must already be
+    reset.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Queue->IoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->IoBuffer);
+        Queue->IoBuffer = NULL;
+    }
+
+    if (Queue->RequestIoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->RequestIoBuffer);
+        Queue->RequestIoBuffer = NULL;
+    }
+
+    if (Queue->Requests != NULL) {
+        MmFreeNonPagedPool(Queue->Requests);
+        Queue->Requests = NULL;
+    }
+
+    Queue->RequestCount = 0;
+    Queue->FreeRequests = 0;
+    return;
+}
+
+VOID
+VirtblkpNotifyQueue (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine publishes any requests added to the available ring since the
+    last call and notifies the device if it asked to be told about them.
+    Notifications are I/O port writes that exit to the hypervisor, so
+    requests started together are published together. The queue lock must be
+    held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_DEVICE Device;
+    USHORT NewIndex;
+    BOOL Notify;
+    USHORT OldIndex;
+
+    Device = Queue->Device;
+    OldIndex = Queue->Available->Index;
+    NewIndex = Queue->AvailableIndex;
+    if (OldIndex == NewIndex) {
+        return;
+    }
+
+    //
+    // Make sure the ring entries are visible before the index, and the index
+    // is visible before the device's suppression state is read.
+    //
+
+    RtlMemoryBarrier();
+    Queue->Available->Index = NewIndex;
+    RtlMemoryBarrier();
+    if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) != 0) {
+        Notify = VIRTIO_QUEUE_NEED_EVENT(*(Queue->AvailableEvent),
+                                         NewIndex,
+                                         OldIndex);
+
+    } else {
+        Notify = TRUE;
+        if ((Queue->Used->Flags & VIRTIO_USED_FLAG_NO_NOTIFY) != 0) {
+            Notify = FALSE;
+        }
+    }
+
+    if (Notify != FALSE) {
+        VIRTBLK_WRITE_REGISTER16(Device,
+                                 VirtioRegisterQueueNotify,
+                                 Queue->Index);
+    }
+
+    return;
+}
+
+VOID
+VirtblkpProcessCompletions (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reaps all new entries from a queue's used ring, continuing
+    or completing their IRPs. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL CompleteIrp;
+    PVIRTBLK_DEVICE Device;
+    UCHAR DeviceStatus;
+    ULONG Id;
+    UINTN IoSize;
+    PIRP Irp;
+    PVIRTBLK_REQUEST Request;
+    BOOL RequestInUse;
+    LONG RequestIndex;
+    KSTATUS Status;
+    USHORT UsedIndex;
+
+    Device = Queue->Device;
+    while (TRUE) {
+        UsedIndex = Queue->Used->Index;
+
+        //
+        // Don't read the ring entries until the index has been seen.
+        //
+
+        RtlMemoryBarrier();
+        while (Queue->LastUsedIndex != UsedIndex) {
+            Id = Queue->Used->Ring[Queue->LastUsedIndex &
+                                   (Queue->Size - 1)].Id;
+
+            Queue->LastUsedIndex += 1;
+            RequestIndex = Id;
+            if (!VIRTBLK_INDIRECT(Device)) {
+                RequestIndex = Id / VIRTBLK_DIRECT_DESCRIPTORS;
+            }
+
+            if ((Id >= Queue->Size) ||
+                (RequestIndex >= Queue->RequestCount) ||
+                ((Queue->FreeRequests & (1ULL << RequestIndex)) != 0)) {
+
+                RtlDebugPrint("Virtblk: Spurious completion %d on queue %d.\n",
+                              Id,
+                              Queue->Index);
+
+                continue;
+            }
+
+            Request = &(Queue->Requests[RequestIndex]);
+            Irp = Request->Irp;
+            IoSize = Request->IoSize;
+            Request->IoSize = 0;
+            DeviceStatus = Request->Command->Status;
+            RequestInUse = FALSE;
+            CompleteIrp = TRUE;
+            Status = STATUS_SUCCESS;
+
+            ASSERT(Irp != NULL);
+
+            if (DeviceStatus != VIRTBLK_STATUS_OK) {
+                RtlDebugPrint("Virtblk: I/O error status: 0x%x\n",
+                              DeviceStatus);
+
+                Status = STATUS_DEVICE_IO_ERROR;
+                if (DeviceStatus == VIRTBLK_STATUS_UNSUPPORTED) {
+                    Status = STATUS_NOT_SUPPORTED;
+                }
+
+            } else if ((Irp->MajorCode == IrpMajorIo) &&
+                       (Request->FlushPending == FALSE)) {
+
+                Irp->U.ReadWrite.IoBytesCompleted += IoSize;
+                Irp->U.ReadWrite.NewIoOffset += IoSize;
+
+                //
+                // If the IRP is not finished, queue up the next part on the
+                // same request.
+                //
+
+                if (Irp->U.ReadWrite.IoBytesCompleted <
+                    Irp->U.ReadWrite.IoSizeInBytes) {
+
+                    VirtblkpPerformIo(Queue, Irp, RequestIndex);
+                    RequestInUse = TRUE;
+                    CompleteIrp = FALSE;
+
+                //
+                // Virtio has no forced unit access, so synchronized writes
+                // are followed by a flush before the IRP completes.
+                //
+
+                } else if ((Irp->MinorCode == IrpMinorIoWrite) &&
+                           ((Irp->U.ReadWrite.IoFlags &
+                             IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
+                           ((Device->Features & VIRTBLK_FEATURE_FLUSH) != 0)) {
+
+                    Request->FlushPending = TRUE;
+                    VirtblkpExecuteFlush(Queue, RequestIndex);
+                    RequestInUse = TRUE;
+                    CompleteIrp = FALSE;
+                }
+            }
+
+            if (CompleteIrp != FALSE) {
+                Request->Irp = NULL;
+                Request->FlushPending = FALSE;
+                IoCompleteIrp(VirtblkDriver, Irp, Status);
+            }
+
+            //
+            // Begin the next IRP reusing this request if there's more to do.
+            //
+
+            if (RequestInUse == FALSE) {
+                VirtblkpBeginNextIrp(Queue, RequestIndex);
+            }
+        }
+
+        //
+        // Ask for an interrupt on the next completion. The device does not
+        // interrupt again until the driver has caught up to this point, so
+        // completions that land while a batch is being reaped cost nothing.
+        // Check once more in case one slipped in before the event was set.
+        //
+
+        if ((Device->Features & VIRTIO_FEATURE_EVENT_INDEX) != 0) {
+            *(Queue->UsedEvent) = Queue->LastUsedIndex;
+        }
+
+        RtlMemoryBarrier();
+        if (Queue->Used->Index == Queue->LastUsedIndex) {
+            break;
+        }
+    }
+
+    //
+    // Publish everything started while reaping with a single notification.
+    //
+
+    VirtblkpNotifyQueue(Queue);
+    return;
+}
+
+LONG
+VirtblkpAllocateRequest (
+    PVIRTBLK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a request. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the request index on success.
+
+    -1 if all requests are in use.
+
+--*/
+
+{
+
+    LONG RequestIndex;
+
+    if (Queue->FreeRequests == 0) {
+        return -1;
+    }
+
+    RequestIndex = RtlCountTrailingZeros64(Queue->FreeRequests);
+    Queue->FreeRequests &= ~(1ULL << RequestIndex);
+    return RequestIndex;
+}
+
+VOID
+VirtblkpFreeRequest (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a request. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    RequestIndex - Supplies the index of the request to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT((Queue->FreeRequests & (1ULL << RequestIndex)) == 0);
+    ASSERT(Queue->Requests[RequestIndex].Irp == NULL);
+
+    Queue->FreeRequests |= 1ULL << RequestIndex;
+    return;
+}
+
+VOID
+VirtblkpBeginNextIrp (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the next queued IRP on the given request, or frees
+    the request if nothing is waiting. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    RequestIndex - Supplies the index of the request that just became
+        available.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIRP Irp;
+
+    ASSERT(Queue->Requests[RequestIndex].Irp == NULL);
+
+    if (LIST_EMPTY(&(Queue->IrpQueue)) != FALSE) {
+        VirtblkpFreeRequest(Queue, RequestIndex);
+        return;
+    }
+
+    Irp = LIST_VALUE(Queue->IrpQueue.Next, IRP, ListEntry);
+    LIST_REMOVE(&(Irp->ListEntry));
+    VirtblkpStartIrp(Queue, Irp, RequestIndex);
+    return;
+}
+
+VOID
+VirtblkpStartIrp (
+    PVIRTBLK_QUEUE Queue,
+    PIRP Irp,
+    LONG RequestIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts an IRP on an allocated request. The queue lock must
+    be held. The caller is responsible for notifying the device.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+    RequestIndex - Supplies the index of the allocated request.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_REQUEST Request;
+
+    Request = &(Queue->Requests[RequestIndex]);
+
+    ASSERT(Request->Irp == NULL);
+
+    Request->Irp = Irp;
+    Request->FlushPending = FALSE;
+    if (Irp->MajorCode == IrpMajorIo) {
+        VirtblkpPerformIo(Queue, Irp, RequestIndex);
+
+    } else {
+
+        ASSERT((Irp->MajorCode == IrpMajorSystemControl) &&
+               (Irp->MinorCode == IrpMinorSystemControlSynchronize));
+
+        VirtblkpExecuteFlush(Queue, RequestIndex);
+    }
+
+    return;
+}
+
+VOID
+VirtblkpPerformIo (
+    PVIRTBLK_QUEUE Queue,
+    PIRP Irp,
+    LONG RequestIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds and submits a read or write request for the next
+    portion of an IRP. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Irp - Supplies a pointer to the read/write IRP.
+
+    RequestIndex - Supplies the index of the request to use.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG BlockShift;
+    UINTN BytesPreviouslyCompleted;
+    UINTN BytesToComplete;
+    PVIRTBLK_COMMAND Command;
+    ULONG DataCount;
+    USHORT DataFlags;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors;
+    PVIRTBLK_DEVICE Device;
+    USHORT FirstIndex;
+    PIO_BUFFER_FRAGMENT Fragment;
+    UINTN FragmentIndex;
+    UINTN FragmentOffset;
+    PIO_BUFFER IoBuffer;
+    UINTN IoBufferOffset;
+    ULONGLONG IoOffset;
+    PVIRTBLK_REQUEST Request;
+    UINTN TransferSize;
+
+    Device = Queue->Device;
+    Request = &(Queue->Requests[RequestIndex]);
+    BlockShift = Device->Disk->BlockShift;
+    IoBuffer = Irp->U.ReadWrite.IoBuffer;
+    BytesPreviouslyCompleted = Irp->U.ReadWrite.IoBytesCompleted;
+    BytesToComplete = Irp->U.ReadWrite.IoSizeInBytes;
+    IoOffset = Irp->U.ReadWrite.NewIoOffset;
+
+    ASSERT(BytesPreviouslyCompleted < BytesToComplete);
+    ASSERT(IoOffset == (Irp->U.ReadWrite.IoOffset + BytesPreviouslyCompleted));
+    ASSERT(IS_ALIGNED(IoOffset, 1 << BlockShift) != FALSE);
+    ASSERT(IS_ALIGNED(BytesToComplete, 1 << BlockShift) != FALSE);
+
+    TransferSize = BytesToComplete - BytesPreviouslyCompleted;
+    if (TransferSize == 0) {
+        Request->Irp = NULL;
+        VirtblkpFreeRequest(Queue, RequestIndex);
+        IoCompleteIrp(VirtblkDriver, Irp, STATUS_SUCCESS);
+        return;
+    }
+
+    //
+    // Get to the currect spot in the I/O buffer.
+    //
+
+    IoBufferOffset = MmGetIoBufferCurrentOffset(IoBuffer);
+    IoBufferOffset += BytesPreviouslyCompleted;
+    FragmentIndex = 0;
+    FragmentOffset = 0;
+    while (IoBufferOffset != 0) {
+
+        ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        if (IoBufferOffset < Fragment->Size) {
+            FragmentOffset = IoBufferOffset;
+            break;
+        }
+
+        IoBufferOffset -= Fragment->Size;
+        FragmentIndex += 1;
+    }
+
+    //
+    // The chain is the header, the data, and the status byte. The device
+    // writes into the data for reads.
+    //
+
+    Descriptors = VirtblkpGetRequestDescriptors(Queue,
+                                                RequestIndex,
+                                                &FirstIndex);
+
+    DataFlags = VIRTIO_DESCRIPTOR_FLAG_NEXT;
+    if (Irp->MinorCode == IrpMinorIoRead) {
+        DataFlags |= VIRTIO_DESCRIPTOR_FLAG_WRITE;
+    }
+
+    TransferSize = VirtblkpBuildDataDescriptors(Device,
+                                                IoBuffer,
+                                                FragmentIndex,
+                                                FragmentOffset,
+                                                TransferSize,
+                                                1 << BlockShift,
+                                                DataFlags,
+                                                &(Descriptors[1]),
+                                                FirstIndex + 1,
+                                                &DataCount);
+
+    ASSERT(TransferSize != 0);
+
+    Command = Request->Command;
+    Command->Type = VIRTBLK_REQUEST_READ;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        Command->Type = VIRTBLK_REQUEST_WRITE;
+    }
+
+    Command->Reserved = 0;
+    Command->Sector = IoOffset >> VIRTBLK_SECTOR_SHIFT;
+    Command->Status = VIRTBLK_STATUS_INVALID;
+    Descriptor = &(Descriptors[0]);
+    Descriptor->Address = Request->CommandPhysical;
+    Descriptor->Length = FIELD_OFFSET(VIRTBLK_COMMAND, Status);
+    Descriptor->Flags = VIRTIO_DESCRIPTOR_FLAG_NEXT;
+    Descriptor->Next = FirstIndex + 1;
+    Descriptor = &(Descriptors[DataCount + 1]);
+    Descriptor->Address = Request->CommandPhysical +
+                          FIELD_OFFSET(VIRTBLK_COMMAND, Status);
+
+    Descriptor->Length = sizeof(UCHAR);
+    Descriptor->Flags = VIRTIO_DESCRIPTOR_FLAG_WRITE;
+    Descriptor->Next = 0;
+    Request->IoSize = TransferSize;
+    VirtblkpSubmitRequest(Queue,
+                          RequestIndex,
+                          DataCount + VIRTBLK_OVERHEAD_DESCRIPTORS);
+
+    return;
+}
+
+UINTN
+VirtblkpBuildDataDescriptors (
+    PVIRTBLK_DEVICE Device,
+    PIO_BUFFER IoBuffer,
+    UINTN FragmentIndex,
+    UINTN FragmentOffset,
+    UINTN TransferSize,
+    ULONG BlockSize,
+    USHORT Flags,
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors,
+    USHORT FirstIndex,
+    PULONG DescriptorCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills out descriptors for the data portion of a request,
+    one per physically contiguous run of the I/O buffer. Runs are merged
+    across fragments where they touch, and split where they exceed the
+    device's segment size.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    IoBuffer - Supplies a pointer to the I/O buffer.
+
+    FragmentIndex - Supplies the index of the fragment to start at.
+
+    FragmentOffset - Supplies the offset within the fragment to start at.
+
+    TransferSize - Supplies the number of bytes remaining in the IRP.
+
+    BlockSize - Supplies the disk's block size. The number of bytes
+        described is rounded down to a multiple of it.
+
+    Flags - Supplies the flags to set in each descriptor.
+
+    Descriptors - Supplies a pointer to the descriptors to fill out.
+
+    FirstIndex - Supplies the index of the first descriptor within its table,
+        used to link the chain.
+
+    DescriptorCount - Supplies a pointer where the number of descriptors
+        filled out is returned.
+
+Return Value:
+
+    Returns the number of bytes the descriptors describe.
+
+--*/
+
+{
+
+    ULONG Count;
+    UINTN Covered;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    UINTN Excess;
+    PIO_BUFFER_FRAGMENT Fragment;
+    ULONG Length;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    UINTN Size;
+
+    Count = 0;
+    Covered = 0;
+    while ((Covered < TransferSize) &&
+           (FragmentIndex < IoBuffer->FragmentCount)) {
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        PhysicalAddress = Fragment->PhysicalAddress + FragmentOffset;
+        Size = Fragment->Size - FragmentOffset;
+        if (Size > (TransferSize - Covered)) {
+            Size = TransferSize - Covered;
+        }
+
+        //
+        // Grow the previous descriptor if this run picks up where it left
+        // off.
+        //
+
+        if (Count != 0) {
+            Descriptor = &(Descriptors[Count - 1]);
+            if ((Descriptor->Address + Descriptor->Length) == PhysicalAddress) {
+                Length = Device->MaxSegmentSize - Descriptor->Length;
+                if (Length > Size) {
+                    Length = Size;
+                }
+
+                Descriptor->Length += Length;
+                PhysicalAddress += Length;
+                Size -= Length;
+                Covered += Length;
+                FragmentOffset += Length;
+            }
+        }
+
+        while (Size != 0) {
+            if (Count == Device->MaxSegments) {
+                goto BuildDataDescriptorsEnd;
+            }
+
+            Length = Device->MaxSegmentSize;
+            if (Length > Size) {
+                Length = Size;
+            }
+
+            Descriptor = &(Descriptors[Count]);
+            Descriptor->Address = PhysicalAddress;
+            Descriptor->Length = Length;
+            Descriptor->Flags = Flags;
+            Descriptor->Next = FirstIndex + Count + 1;
+            Count += 1;
+            PhysicalAddress += Length;
+            Size -= Length;
+            Covered += Length;
+            FragmentOffset += Length;
+        }
+
+        if (FragmentOffset >= Fragment->Size) {
+            FragmentIndex += 1;
+            FragmentOffset = 0;
+        }
+    }
+
+BuildDataDescriptorsEnd:
+
+    //
+    // Trim the tail so the request covers whole blocks. The rest is picked
+    // up in the next round.
+    //
+
+    Excess = Covered - ALIGN_RANGE_DOWN(Covered, BlockSize);
+    Covered -= Excess;
+    while (Excess != 0) {
+
+        ASSERT(Count != 0);
+
+        Descriptor = &(Descriptors[Count - 1]);
+        if (Descriptor->Length > Excess) {
+            Descriptor->Length -= Excess;
+            break;
+        }
+
+        Excess -= Descriptor->Length;
+        Count -= 1;
+    }
+
+    *DescriptorCount = Count;
+    return Covered;
+}
+
+VOID
+VirtblkpExecuteFlush (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine submits a flush request. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    RequestIndex - Supplies the index of the request to use.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTBLK_COMMAND Command;
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptors;
+    USHORT FirstIndex;
+    PVIRTBLK_REQUEST Request;
+
+    Request = &(Queue->Requests[RequestIndex]);
+    Request->IoSize = 0;
+    Command = Request->Command;
+    Command->Type = VIRTBLK_REQUEST_FLUSH;
+    Command->Reserved = 0;
+    Command->Sector = 0;
+    Command->Status = VIRTBLK_STATUS_INVALID;
+    Descriptors = VirtblkpGetRequestDescriptors(Queue,
+                                                RequestIndex,
+                                                &FirstIndex);
+
+    Descriptors[0].Address = Request->CommandPhysical;
+    Descriptors[0].Length = FIELD_OFFSET(VIRTBLK_COMMAND, Status);
+    Descriptors[0].Flags = VIRTIO_DESCRIPTOR_FLAG_NEXT;
+    Descriptors[0].Next = FirstIndex + 1;
+    Descriptors[1].Address = Request->CommandPhysical +
+                             FIELD_OFFSET(VIRTBLK_COMMAND, Status);
+
+    Descriptors[1].Length = sizeof(UCHAR);
+    Descriptors[1].Flags = VIRTIO_DESCRIPTOR_FLAG_WRITE;
+    Descriptors[1].Next = 0;
+    VirtblkpSubmitRequest(Queue, RequestIndex, VIRTBLK_OVERHEAD_DESCRIPTORS);
+    return;
+}
+
+PVIRTIO_QUEUE_DESCRIPTOR
+VirtblkpGetRequestDescriptors (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex,
+    PUSHORT FirstIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the descriptors a request builds its chain in:
+    either its indirect table or its slice of the ring.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    RequestIndex - Supplies the index of the request.
+
+    FirstIndex - Supplies a pointer where the index of the first descriptor
+        within its table is returned, for linking the chain.
+
+Return Value:
+
+    Returns a pointer to the first descriptor.
+
+--*/
+
+{
+
+    if (VIRTBLK_INDIRECT(Queue->Device)) {
+        *FirstIndex = 0;
+        return Queue->Requests[RequestIndex].Table;
+    }
+
+    *FirstIndex = RequestIndex * VIRTBLK_DIRECT_DESCRIPTORS;
+    return &(Queue->Descriptors[*FirstIndex]);
+}
+
+VOID
+VirtblkpSubmitRequest (
+    PVIRTBLK_QUEUE Queue,
+    LONG RequestIndex,
+    ULONG DescriptorCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a built request to the available ring. It is not
+    visible to the device until the queue is notified. The queue lock must be
+    held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    RequestIndex - Supplies the index of the request.
+
+    DescriptorCount - Supplies the number of descriptors in the request's
+        chain.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_QUEUE_DESCRIPTOR Descriptor;
+    USHORT Head;
+    PVIRTBLK_REQUEST Request;
+
+    //
+    // With indirect descriptors, the request's ring descriptor points at its
+    // table, and the whole chain costs one slot in the ring.
+    //
+
+    if (VIRTBLK_INDIRECT(Queue->Device)) {
+        Request = &(Queue->Requests[RequestIndex]);
+        Head = RequestIndex;
+        Descriptor = &(Queue->Descriptors[Head]);
+        Descriptor->Address = Request->TablePhysical;
+        Descriptor->Length = DescriptorCount * sizeof(VIRTIO_QUEUE_DESCRIPTOR);
+        Descriptor->Flags = VIRTIO_DESCRIPTOR_FLAG_INDIRECT;
+        Descriptor->Next = 0;
+
+    } else {
+
+        ASSERT(DescriptorCount <= VIRTBLK_DIRECT_DESCRIPTORS);
+
+        Head = RequestIndex * VIRTBLK_DIRECT_DESCRIPTORS;
+    }
+
+    Queue->Available->Ring[Queue->AvailableIndex & (Queue->Size - 1)] = Head;
+    Queue->AvailableIndex += 1;
+    return;
+}
+
@@ -0,0 +1,126 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    blkqueue.h
+
+Abstract:
+
+    This header contains definitions for the block request queue device
+    information structure.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define BLOCK_QUEUE_DEVICE_INFORMATION_UUID \
+    {{0x6A1C2F0E, 0x4B3D11F1, 0x9E27A3C5, 0x0D8B4E61}}
+
+#define BLOCK_QUEUE_DEVICE_INFORMATION_VERSION 0x00010000
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Enumeration Description:
+
+    This enumeration describes the scheduling policies a block request queue
+    can use to order requests headed to the disk.
+
+Values:
+
+    BlockQueuePolicyDefault - Indicates that the device has no preference. The
+        queue inherits the policy of the nearest ancestor that has one, and
+        falls back to the deadline policy.
+
+    BlockQueuePolicyDeadline - Indicates that requests are sorted by offset
+        and issued in a single sweep across the disk, except that a request
+        waiting longer than its deadline is issued next. This suits rotating
+        media where seeks are expensive.
+
+    BlockQueuePolicyNoop - Indicates that requests are issued in arrival order
+        with many in flight at once. This suits non-rotational media like
+        solid state drives and RAM disks, where seeks cost nothing.
+
+--*/
+
+typedef enum _BLOCK_QUEUE_POLICY {
+    BlockQueuePolicyDefault,
+    BlockQueuePolicyDeadline,
+    BlockQueuePolicyNoop,
+    BlockQueuePolicyCount
+} BLOCK_QUEUE_POLICY, *PBLOCK_QUEUE_POLICY;
+
+/*++
+
+Structure Description:
+
+    This structure stores the block request queue information published by
+    block devices. Only the policy can be set; the statistics are read-only.
+
+Members:
+
+    Version - Stores the table version. Future revisions will be backwards
+        compatible. Set to BLOCK_QUEUE_DEVICE_INFORMATION_VERSION.
+
+    Policy - Stores the scheduling policy of the queue, type
+        BLOCK_QUEUE_POLICY.
+
+    QueueDepth - Stores the number of requests currently waiting in the queue.
+
+    MaxQueueDepth - Stores the largest number of requests that have ever been
+        waiting in the queue at once.
+
+    InFlight - Stores the number of requests currently out at the device.
+
+    Requests - Stores the total number of requests submitted to the queue.
+
+    Merges - Stores the number of requests that were merged into a contiguous
+        neighbor rather than being sent to the device on their own.
+
+    Dispatches - Stores the number of I/O requests actually sent to the
+        device.
+
+    DeadlineExpirations - Stores the number of times a request was issued out
+        of order because its deadline expired.
+
+--*/
+
+typedef struct _BLOCK_QUEUE_DEVICE_INFORMATION {
+    ULONG Version;
+    ULONG Policy;
+    ULONG QueueDepth;
+    ULONG MaxQueueDepth;
+    ULONG InFlight;
+    ULONGLONG Requests;
+    ULONGLONG Merges;
+    ULONGLONG Dispatches;
+    ULONGLONG DeadlineExpirations;
+} BLOCK_QUEUE_DEVICE_INFORMATION, *PBLOCK_QUEUE_DEVICE_INFORMATION;
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
@@ -26,6 +26,7 @@ Module Name:
 //
 
 #include <minoca/kernel/devres.h>
+#include <minoca/devinfo/blkqueue.h>
 
 //
 // --------------------------------------------------------------------- Macros
@@ -467,6 +468,15 @@ Module Name:
 #define FILE_PROPERTY_FIELD_MODIFIED_TIME       0x00000010
 #define FILE_PROPERTY_FIELD_STATUS_CHANGE_TIME  0x00000020
 #define FILE_PROPERTY_FIELD_FILE_SIZE           0x00000040
+#define FILE_PROPERTY_FIELD_ALLOCATION          0x00000080
+#define FILE_PROPERTY_FIELD_KEEP_SIZE           0x00000100
+
+//
+// The allocation field requests that disk space be allocated for the file up
+// to the size in the properties. If the file is smaller than that, its size is
+// extended as well unless the keep size field is also set. The allocation
+// field cannot be combined with the file size field.
+//
 
 //
 // Define the set of properties that only the file owner or a privileged
@@ -869,6 +879,31 @@ Module Name:
 
 #define LOOKUP_FLAG_NON_PAGED_IO_STATE 0x00000002
 
+//
+// Set this flag if the file's data is only preserved by writes that carry
+// IO_FLAG_HARD_FLUSH. Other writes may be acknowledged without storing the
+// data, so the page cache must hard flush dirty pages before evicting them.
+// Memory-backed file systems use this to keep their data in the page cache.
+//
+
+#define LOOKUP_FLAG_HARD_FLUSH_REQUIRED 0x00000004
+
+//
+// Set this flag if the file system can reserve space for cached writes that
+// extend the file and assign the blocks later, when the page cache flushes
+// the data. Without this flag, cached writes that miss in the cache are
+// written through immediately so that their blocks get allocated.
+//
+
+#define LOOKUP_FLAG_DELAYED_ALLOCATION 0x00000008
+
+//
+// Set this flag in an allocate request to only reserve space for the given
+// region. The blocks themselves are assigned when the data is written.
+//
+
+#define SYSTEM_CONTROL_ALLOCATE_FLAG_RESERVE 0x00000001
+
 //
 // Define the version number for the I/O cache statistics.
 //
@@ -876,6 +911,19 @@ Module Name:
 #define IO_CACHE_STATISTICS_VERSION 0x1
 #define IO_CACHE_STATISTICS_MAX_VERSION 0x10000000
 
+//
+// Define the version number for the device start timeline.
+//
+
+#define IO_DEVICE_TIMELINE_VERSION 0x1
+
+//
+// Define the size of the device name buffer in a timeline entry, including
+// the null terminator. Longer names are truncated.
+//
+
+#define IO_DEVICE_TIMELINE_NAME_SIZE 48
+
 //
 // Define the version number for the global cache statistics.
 //
@@ -957,6 +1005,7 @@ typedef struct _DRIVER DRIVER, *PDRIVER;
 typedef struct _IRP IRP, *PIRP;
 typedef struct _STREAM_BUFFER STREAM_BUFFER, *PSTREAM_BUFFER;
 typedef struct _IO_HANDLE IO_HANDLE, *PIO_HANDLE;
+typedef struct _IO_COMPLETION_QUEUE IO_COMPLETION_QUEUE, *PIO_COMPLETION_QUEUE;
 typedef struct _PAGE_CACHE_ENTRY PAGE_CACHE_ENTRY, *PPAGE_CACHE_ENTRY;
 
 typedef enum _SEEK_COMMAND {
@@ -1051,6 +1100,7 @@ typedef enum _IO_INFORMATION_TYPE {
     IoInformationBoot,
     IoInformationMountPoints,
     IoInformationCacheStatistics,
+    IoInformationDeviceTimeline,
 } IO_INFORMATION_TYPE, *PIO_INFORMATION_TYPE;
 
 typedef enum _SHARED_MEMORY_COMMAND {
@@ -1791,6 +1841,7 @@ typedef enum _IRP_MINOR_CODE {
     IrpMinorSystemControlDeviceInformation,
     IrpMinorSystemControlGetBlockInformation,
     IrpMinorSystemControlSynchronize,
+    IrpMinorSystemControlAllocate,
 } IRP_MINOR_CODE, *PIRP_MINOR_CODE;
 
 typedef enum _IRP_DIRECTION {
@@ -2294,6 +2345,9 @@ Structure Description:
         permissions, object type, user ID, group ID, and access times are all
         valid from the system.
 
+    Flags - Stores a bitmask of flags returned by create. See LOOKUP_FLAG_*
+        for definitions.
+
 --*/
 
 typedef struct _SYSTEM_CONTROL_CREATE {
@@ -2302,6 +2356,7 @@ typedef struct _SYSTEM_CONTROL_CREATE {
     PCSTR Name;
     ULONG NameSize;
     FILE_PROPERTIES FileProperties;
+    ULONG Flags;
 } SYSTEM_CONTROL_CREATE, *PSYSTEM_CONTROL_CREATE;
 
 /*++
@@ -2426,6 +2481,37 @@ typedef struct _SYSTEM_CONTROL_TRUNCATE {
 
 /*++
 
+Structure Description:
+
+    This structure defines the information sent to a file system for an
+    allocate operation, which sets aside disk space for a region of a file
+    without writing to it.
+
+Members:
+
+    FileProperties - Stores a pointer to the properties of the target file.
+
+    DeviceContext - Stores a pointer to the open device context for the file.
+
+    Offset - Stores the byte offset of the start of the region to allocate.
+
+    Size - Stores the size of the region to allocate, in bytes.
+
+    Flags - Stores a bitmask of flags governing the allocation. See
+        SYSTEM_CONTROL_ALLOCATE_FLAG_* definitions.
+
+--*/
+
+typedef struct _SYSTEM_CONTROL_ALLOCATE {
+    PFILE_PROPERTIES FileProperties;
+    PVOID DeviceContext;
+    ULONGLONG Offset;
+    ULONGLONG Size;
+    ULONG Flags;
+} SYSTEM_CONTROL_ALLOCATE, *PSYSTEM_CONTROL_ALLOCATE;
+
+/*++
+
 Structure Description:
 
     This structure defines a device information result returned as an array
@@ -2652,6 +2738,96 @@ typedef struct _IO_CACHE_STATISTICS {
 
 /*++
 
+Structure Description:
+
+    This structure defines a single device start record in the device
+    timeline.
+
+Members:
+
+    DeviceId - Stores the numeric identifier of the device.
+
+    StartTime - Stores the time counter value when the system began starting
+        the device.
+
+    EndTime - Stores the time counter value when the device reached the
+        started state or failed to get there.
+
+    Status - Stores the result of the start. This is STATUS_SUCCESS if the
+        device started, or the problem status if it did not.
+
+    Name - Stores the null terminated name of the device, truncated if
+        necessary.
+
+--*/
+
+typedef struct _IO_DEVICE_TIMELINE_ENTRY {
+    DEVICE_ID DeviceId;
+    ULONGLONG StartTime;
+    ULONGLONG EndTime;
+    KSTATUS Status;
+    CHAR Name[IO_DEVICE_TIMELINE_NAME_SIZE];
+} IO_DEVICE_TIMELINE_ENTRY, *PIO_DEVICE_TIMELINE_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the device start timeline, which records how long
+    each device took to start, in the order they finished. Entries recorded
+    during boot remain available afterwards.
+
+Members:
+
+    Version - Stores the version information for this structure. Set this to
+        IO_DEVICE_TIMELINE_VERSION.
+
+    EntryCount - Stores the number of entries that follow.
+
+    DroppedCount - Stores the number of device starts that were not recorded
+        because the timeline was full.
+
+    Frequency - Stores the frequency of the time counter, in Hertz, used to
+        convert the entry times into real time.
+
+    Entries - Stores the array of timeline entries.
+
+--*/
+
+typedef struct _IO_DEVICE_TIMELINE {
+    ULONG Version;
+    ULONG EntryCount;
+    ULONG DroppedCount;
+    ULONGLONG Frequency;
+    IO_DEVICE_TIMELINE_ENTRY Entries[ANYSIZE_ARRAY];
+} IO_DEVICE_TIMELINE, *PIO_DEVICE_TIMELINE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the result of an asynchronous I/O request, as
+    collected from an I/O completion queue.
+
+Members:
+
+    Context - Stores the context pointer supplied when the request was
+        submitted.
+
+    Status - Stores the final status of the request.
+
+    BytesCompleted - Stores the number of bytes actually read or written.
+
+--*/
+
+typedef struct _IO_COMPLETION {
+    PVOID Context;
+    KSTATUS Status;
+    UINTN BytesCompleted;
+} IO_COMPLETION, *PIO_COMPLETION;
+
+/*++
+
 Structure Description:
 
     This structure defines a set of I/O cache statistics.
@@ -3210,6 +3386,34 @@ Return Value:
 
 --*/
 
+KERNEL_API
+VOID
+IoSetDeviceBlockQueuePolicy (
+    PDEVICE Device,
+    BLOCK_QUEUE_POLICY Policy
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the policy used to schedule block I/O requests headed
+    to the given device or any device stacked on top of it, like partitions.
+    Disk drivers call this to indicate whether or not their media is
+    rotational.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Policy - Supplies the scheduling policy to use.
+
+Return Value:
+
+    None.
+
+--*/
+
 KERNEL_API
 DEVICE_ID
 IoGetDeviceNumericId (
@@ -3783,6 +3987,44 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoSendAsynchronousIrp (
+    PIRP Irp
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends an initialized IRP down the device stack and returns
+    without waiting for it to complete. If a driver pends the IRP, the calling
+    thread is released, and the IRP is driven the rest of the way through the
+    stack by a system worker thread once the driver completes it, usually from
+    its DPC. The IRP's completion routine is called at low level when the IRP
+    finishes its round trip, and is free to destroy the IRP. This routine must
+    be called at low level.
+
+Arguments:
+
+    Irp - Supplies a pointer to the initialized IRP to send. All parameters
+        should already be filled out and ready to go, including the
+        completion routine.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was sent. The completion routine will be called
+    exactly once, possibly before this routine returns. This says nothing of
+    the completion status of the IRP.
+
+    STATUS_INVALID_PARAMETER if the IRP was not properly initialized or has no
+    completion routine.
+
+    STATUS_INSUFFICIENT_RESOURCES if memory could not be allocated. The
+    completion routine is not called in this case.
+
+--*/
+
 KERNEL_API
 KSTATUS
 IoPrepareReadWriteIrp (
@@ -4377,6 +4619,154 @@ Return Value:
 
 --*/
 
+KERNEL_API
+PIO_COMPLETION_QUEUE
+IoCreateCompletionQueue (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an I/O completion queue, which collects the results of
+    asynchronous I/O requests.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the new completion queue on success.
+
+    NULL on allocation failure.
+
+--*/
+
+KERNEL_API
+VOID
+IoDestroyCompletionQueue (
+    PIO_COMPLETION_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys an I/O completion queue. Requests still in flight
+    keep the queue alive until they complete, and their results are then
+    discarded. The I/O buffers of those requests must remain valid until then.
+
+Arguments:
+
+    Queue - Supplies a pointer to the completion queue to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+KERNEL_API
+KSTATUS
+IoSubmitAsynchronousIo (
+    PIO_HANDLE Handle,
+    PIO_BUFFER IoBuffer,
+    IO_OFFSET Offset,
+    UINTN SizeInBytes,
+    ULONG Flags,
+    BOOL Write,
+    PIO_COMPLETION_QUEUE Queue,
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine starts a read or write on an I/O handle and returns without
+    waiting for it. When the I/O finishes, its results are posted to the given
+    completion queue along with the supplied context. Block aligned I/O to a
+    block device opened without the page cache is sent directly to the device
+    and completes from the driver. Any other I/O is performed synchronously
+    before this routine returns, and its result is posted all the same.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    IoBuffer - Supplies a pointer to the I/O buffer to read into or write
+        from. This buffer must stay valid until the completion is posted.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the I/O should be done.
+
+    SizeInBytes - Supplies the number of bytes to read or write.
+
+    Flags - Supplies flags regarding the I/O operation. See IO_FLAG_*
+        definitions.
+
+    Write - Supplies a boolean indicating whether this is a read (FALSE) or a
+        write (TRUE).
+
+    Queue - Supplies a pointer to the completion queue to post the result to.
+
+    Context - Supplies an opaque pointer that is returned with the completion.
+
+Return Value:
+
+    STATUS_SUCCESS if the request was started. Its result, successful or not,
+    is delivered through the completion queue.
+
+    Other error codes if the request could not be started. Nothing is posted to
+    the completion queue in this case.
+
+--*/
+
+KERNEL_API
+KSTATUS
+IoGetQueuedCompletions (
+    PIO_COMPLETION_QUEUE Queue,
+    PIO_COMPLETION Completions,
+    UINTN Count,
+    ULONG TimeoutInMilliseconds,
+    PUINTN CompletionCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine collects the results of finished asynchronous I/O requests
+    from a completion queue, waiting for at least one if none are ready.
+
+Arguments:
+
+    Queue - Supplies a pointer to the completion queue.
+
+    Completions - Supplies a pointer to an array where the completions will be
+        returned, in the order the requests finished.
+
+    Count - Supplies the number of elements in the completions array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for a
+        completion. Use WAIT_TIME_INDEFINITE to wait forever, or zero to only
+        collect completions that are already available.
+
+    CompletionCount - Supplies a pointer where the number of completions
+        returned will be stored.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one completion was returned.
+
+    STATUS_TIMEOUT if no requests finished before the timeout expired.
+
+    Other error codes if the wait was interrupted.
+
+--*/
+
 KERNEL_API
 KSTATUS
 IoFlush (
@@ -140,6 +140,13 @@ Module Name:
 
 #define X86_FEATURE_FXSAVE   0x00000008
 
+//
+// This bit is set if the processor supports SSE2 instructions and the kernel
+// preserves the XMM registers.
+//
+
+#define X86_FEATURE_SSE2     0x00000010
+
 //
 // This bit is set if the kernel is ARMv7.
 //
@@ -2258,6 +2265,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 ULONG
 KeGetCurrentProcessorNumber (
     VOID
@@ -2280,6 +2288,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 ULONG
 KeGetActiveProcessorCount (
     VOID
@@ -2302,6 +2311,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 PKTHREAD
 KeGetCurrentThread (
     VOID
@@ -2526,6 +2536,45 @@ Return Value:
 
 --*/
 
+KERNEL_API
+PWORK_QUEUE
+KeCreateMultiThreadedWorkQueue (
+    ULONG Flags,
+    PCSTR Name,
+    ULONG ThreadCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new work queue serviced by a pool of worker
+    threads. Work items are still dequeued in priority order, but up to the
+    given number of them may run concurrently, so callers must provide their
+    own ordering between dependent items.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags governing the behavior of the work
+        queue. See WORK_QUEUE_FLAG_* definitions.
+
+    Name - Supplies an optional pointer to the name of the worker threads
+        created. A copy of this memory will be made. This should only be used
+        for debugging, as text may be added to the end of the name supplied
+        here to the actual worker thread names.
+
+    ThreadCount - Supplies the number of worker threads to create. If not all
+        of them can be created, the queue is serviced by as many as could be.
+        At least one thread is always created.
+
+Return Value:
+
+    Returns a pointer to the new work queue on success.
+
+    NULL on failure.
+
+--*/
+
 KERNEL_API
 VOID
 KeDestroyWorkQueue (
@@ -2560,7 +2609,9 @@ KeFlushWorkQueue (
 Routine Description:
 
     This routine flushes a work queue. If there are items on the work queue,
-    they will be completed before this routine returns.
+    they will be completed before this routine returns. On a queue with
+    multiple worker threads, items dequeued ahead of the flush may still be
+    running when this routine returns.
 
 Arguments:
 
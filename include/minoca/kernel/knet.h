@@ -296,7 +296,8 @@ typedef enum _NET_DOMAIN_TYPE {
     NetDomainArp = NET_DOMAIN_LOW_LEVEL_NETWORK_BASE,
     NetDomainEapol,
     NetDomainEthernet = NET_DOMAIN_PHYSICAL_BASE,
-    NetDomain80211
+    NetDomain80211,
+    NetDomainLoopback
 } NET_DOMAIN_TYPE, *PNET_DOMAIN_TYPE;
 
 typedef enum _NET_SOCKET_TYPE {
@@ -3450,6 +3450,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 KSTATUS
 MmAllocatePageFileSpace (
     PIMAGE_BACKING ImageBacking,
@@ -3478,6 +3479,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 VOID
 MmFreePageFileSpace (
     PIMAGE_BACKING ImageBacking,
@@ -3532,6 +3534,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 KSTATUS
 MmPageFilePerformIo (
     PIMAGE_BACKING ImageBacking,
@@ -4027,6 +4030,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 UINTN
 MmGetTotalPhysicalPages (
     VOID
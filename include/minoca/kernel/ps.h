@@ -611,6 +611,7 @@ typedef enum _USER_LOCK_OPERATION {
     UserLockInvalid,
     UserLockWait,
     UserLockWake,
+    UserLockRequeue,
 } USER_LOCK_OPERATION, *PUSER_LOCK_OPERATION;
 
 //
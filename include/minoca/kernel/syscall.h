@@ -2355,6 +2355,10 @@ Structure Description:
     TimeoutInMilliseconds - Stores the timeout in milliseconds the caller
         should wait. Set to SYS_WAIT_TIME_INDEFINITE to wait forever.
 
+    RequeueAddress - Stores a pointer to the address of the lock that
+        remaining waiters are moved to for a requeue operation. This is unused
+        by other operations.
+
 --*/
 
 typedef struct _SYSTEM_CALL_USER_LOCK {
@@ -2362,6 +2366,7 @@ typedef struct _SYSTEM_CALL_USER_LOCK {
     ULONG Value;
     ULONG Operation;
     ULONG TimeoutInMilliseconds;
+    PULONG RequeueAddress;
 } SYSCALL_STRUCT SYSTEM_CALL_USER_LOCK, *PSYSTEM_CALL_USER_LOCK;
 
 /*++
@@ -246,6 +246,7 @@ Module Name:
 #define X86_CPUID_BASIC_EDX_SYSENTER (1 << 11)
 #define X86_CPUID_BASIC_EDX_CMOV (1 << 15)
 #define X86_CPUID_BASIC_EDX_FX_SAVE_RESTORE (1 << 24)
+#define X86_CPUID_BASIC_EDX_SSE2 (1 << 26)
 
 //
 // Define known CPU vendors.
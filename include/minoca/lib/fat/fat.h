@@ -836,7 +836,8 @@ Routine Description:
     This routine expands the file capacity of the given file ID by allocating
     clusters for it. It does not zero out those clusters, so the usefulness of
     this function is limited to scenarios where the security of uninitialized
-    disk contents is not a concern.
+    disk contents is not a concern. The new clusters are placed in a single
+    contiguous run if the volume has one large enough.
 
 Arguments:
 
@@ -852,6 +853,41 @@ Return Value:
 
 --*/
 
+KSTATUS
+FatReserveFileClusters (
+    PVOID FileToken,
+    ULONGLONG Offset,
+    ULONGLONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reserves free clusters on the volume for a region of the
+    given file that is about to be written, without assigning them. Later
+    writes that extend the file's cluster chain draw from the reservation, so
+    they cannot fail for lack of space. Any unused reservation is released
+    when the file is truncated below it or closed.
+
+Arguments:
+
+    FileToken - Supplies the open file token.
+
+    Offset - Supplies the byte offset where the region begins. This is
+        expected to be the current end of the file.
+
+    Size - Supplies the size of the region in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_VOLUME_FULL if the volume does not have enough unreserved free
+    clusters.
+
+--*/
+
 //
 // Prototypes of routines that support the FAT library.
 //
@@ -1063,6 +1063,74 @@ Return Value:
 
 --*/
 
+typedef
+KSTATUS
+(*PIM_LOAD_BINDING_CACHE) (
+    PLOADED_IMAGE Executable,
+    PVOID *Buffer,
+    PUINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine loads the persistent symbol binding cache saved for the given
+    primary executable. The image library validates the contents itself, so
+    this routine only needs to find and read the data.
+
+Arguments:
+
+    Executable - Supplies a pointer to the primary executable image.
+
+    Buffer - Supplies a pointer where a buffer containing the cache contents
+        will be returned on success. The image library will free this buffer
+        with the free memory import.
+
+    Size - Supplies a pointer where the size of the buffer will be returned on
+        success.
+
+Return Value:
+
+    STATUS_SUCCESS if the cache contents were returned.
+
+    STATUS_NOT_SUPPORTED if binding caching is disabled for this executable.
+    The image library will not attempt to save a new cache either.
+
+    Other error codes if no cache was loaded but a new one may be saved.
+
+--*/
+
+typedef
+VOID
+(*PIM_SAVE_BINDING_CACHE) (
+    PLOADED_IMAGE Executable,
+    PVOID Buffer,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine persists the symbol binding cache for the given primary
+    executable. Failures are not reported, since the cache is only an
+    optimization.
+
+Arguments:
+
+    Executable - Supplies a pointer to the primary executable image.
+
+    Buffer - Supplies a pointer to the cache contents to save.
+
+    Size - Supplies the size of the cache contents in bytes.
+
+Return Value:
+
+    None.
+
+--*/
+
 /*++
 
 Structure Description:
@@ -1123,6 +1191,12 @@ Structure Description:
     ResolvePltEntry - Stores an optional pointer to an assembly function used
         to resolve procedure linkage table entries on the fly.
 
+    LoadBindingCache - Stores an optional pointer to a function used to load
+        the persistent symbol binding cache for the primary executable.
+
+    SaveBindingCache - Stores an optional pointer to a function used to save
+        the persistent symbol binding cache for the primary executable.
+
 --*/
 
 typedef struct _IM_IMPORT_TABLE {
@@ -1143,6 +1217,8 @@ typedef struct _IM_IMPORT_TABLE {
     PIM_GET_ENVIRONMENT_VARIABLE GetEnvironmentVariable;
     PIM_FINALIZE_SEGMENTS FinalizeSegments;
     PIM_RESOLVE_PLT_ENTRY ResolvePltEntry;
+    PIM_LOAD_BINDING_CACHE LoadBindingCache;
+    PIM_SAVE_BINDING_CACHE SaveBindingCache;
 } IM_IMPORT_TABLE, *PIM_IMPORT_TABLE;
 
 //
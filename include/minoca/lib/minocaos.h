@@ -92,6 +92,7 @@ typedef enum _OS_X86_PROCESSOR_FEATURE {
     OsX86Sysenter,
     OsX86I686,
     OsX86FxSave,
+    OsX86Sse2,
     OsX86FeatureCount
 } OS_X86_PROCESSOR_FEATURE, *POS_X86_PROCESSOR_FEATURE;
 
@@ -192,6 +193,12 @@ Structure Description:
     PendingWriters - Stores the number of threads waiting to acquire the lock
         for write access.
 
+    Attributes - Stores the OS_RWLOCK_* flags governing the lock behavior.
+
+    SpinEstimate - Stores a running estimate of how long contended acquires
+        need to spin before the lock frees up, used to size the spin before
+        going to sleep in the kernel.
+
 --*/
 
 typedef struct _OS_RWLOCK {
@@ -200,6 +207,7 @@ typedef struct _OS_RWLOCK {
     ULONG PendingReaders;
     ULONG PendingWriters;
     ULONG Attributes;
+    ULONG SpinEstimate;
 } OS_RWLOCK, *POS_RWLOCK;
 
 /*++
@@ -249,6 +257,55 @@ typedef struct _OS_IMAGE_SYMBOL {
     PVOID SymbolAddress;
 } OS_IMAGE_SYMBOL, *POS_IMAGE_SYMBOL;
 
+/*++
+
+Structure Description:
+
+    This structure stores statistics about the calling thread's heap cache.
+
+Members:
+
+    ArenaIndex - Stores the index of the heap arena the thread currently
+        prefers for refills and large allocations.
+
+    CacheHits - Stores the number of small allocations satisfied directly from
+        the thread cache.
+
+    CacheMisses - Stores the number of small allocations that had to refill
+        the thread cache from an arena.
+
+    LocalFrees - Stores the number of blocks freed by this thread back into
+        its own cache.
+
+    RemoteFrees - Stores the number of blocks this thread freed that were
+        owned by another thread's cache.
+
+    RemoteFreesReceived - Stores the number of blocks freed by other threads
+        that have been collected back into this cache.
+
+    Flushes - Stores the number of times an overfull cache list was trimmed
+        back into the arenas.
+
+    CachedBlocks - Stores the number of free blocks currently held in the
+        cache.
+
+    CachedBytes - Stores the number of usable bytes currently held in the
+        cache.
+
+--*/
+
+typedef struct _OS_HEAP_CACHE_STATISTICS {
+    ULONG ArenaIndex;
+    UINTN CacheHits;
+    UINTN CacheMisses;
+    UINTN LocalFrees;
+    UINTN RemoteFrees;
+    UINTN RemoteFreesReceived;
+    UINTN Flushes;
+    UINTN CachedBlocks;
+    UINTN CachedBytes;
+} OS_HEAP_CACHE_STATISTICS, *POS_HEAP_CACHE_STATISTICS;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -2617,6 +2674,31 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsHeapGetThreadCacheStatistics (
+    POS_HEAP_CACHE_STATISTICS Statistics
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns statistics about the current thread's small block
+    heap cache.
+
+Arguments:
+
+    Statistics - Supplies a pointer where the statistics will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_INITIALIZED if thread caching is not active for this thread.
+
+--*/
+
 OS_API
 PPROCESS_ENVIRONMENT
 OsCreateEnvironment (
@@ -4152,6 +4234,49 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsUserLockRequeue (
+    PVOID Address,
+    ULONG Flags,
+    PULONG Value,
+    PVOID RequeueAddress
+    );
+
+/*++
+
+Routine Description:
+
+    This routine wakes the given number of threads blocked on a user mode lock
+    address, and moves any remaining waiters over to block on a second
+    address instead. The moved threads are woken by a regular wake operation
+    on the second address.
+
+Arguments:
+
+    Address - Supplies a pointer to the 32-bit user mode lock value threads
+        are currently blocked on.
+
+    Flags - Supplies a bitfield of USER_LOCK_* flags that apply to both
+        addresses.
+
+    Value - Supplies a pointer that on input contains the number of threads
+        to wake. On output, contains the number of threads woken.
+
+    RequeueAddress - Supplies a pointer to the 32-bit user mode lock value
+        that the remaining waiters should be moved to. This must be backed by
+        the same memory object as the original address.
+
+Return Value:
+
+    STATUS_SUCCESS if the operation succeeded.
+
+    STATUS_INVALID_PARAMETER if the addresses are the same or the waiters
+    cannot be moved between them. Callers should fall back to waking all
+    threads in this case.
+
+--*/
+
 OS_API
 PVOID
 OsGetTlsAddress (
@@ -733,6 +733,37 @@ Return Value:
 
 --*/
 
+typedef
+UINTN
+(*PPRINT_FORMAT_WRITE_STRING) (
+    PCSTR String,
+    UINTN Size,
+    PPRINT_FORMAT_CONTEXT Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine writes a run of characters to the output during a
+    printf-style formatting operation.
+
+Arguments:
+
+    String - Supplies a pointer to the characters to write. This is not null
+        terminated.
+
+    Size - Supplies the number of characters to write.
+
+    Context - Supplies a pointer to the printf-context.
+
+Return Value:
+
+    Returns the number of characters written. Anything less than the given
+    size indicates failure.
+
+--*/
+
 /*++
 
 Structure Description:
@@ -745,6 +776,11 @@ Structure Description:
         character to the destination of the formatted string operation. Usually
         this is a file or string.
 
+    WriteString - Stores an optional pointer to a function used to write a
+        run of characters at once. If this is NULL, each character is sent to
+        the write character routine. This is only used for narrow character
+        format operations.
+
     Context - Stores a pointer's worth of additional context. This pointer is
         not touched by the format string function, it's generally used inside
         the write character routine.
@@ -763,6 +799,7 @@ Structure Description:
 
 struct _PRINT_FORMAT_CONTEXT {
     PPRINT_FORMAT_WRITE_CHARACTER WriteCharacter;
+    PPRINT_FORMAT_WRITE_STRING WriteString;
     PVOID Context;
     ULONG Limit;
     ULONG CharactersWritten;
@@ -3262,6 +3299,156 @@ Return Value:
 
 --*/
 
+RTL_API
+PVOID
+RtlCopyMemorySimd (
+    PVOID Destination,
+    PCVOID Source,
+    UINTN ByteCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine copies a section of memory using SIMD instructions. The
+    buffers must not overlap. This routine is only available on architectures
+    with SIMD support, and callers must check that the processor supports it
+    (SSE2 on x86, NEON on ARMv7). It uses the floating point registers, so it
+    cannot be called from kernel mode.
+
+Arguments:
+
+    Destination - Supplies a pointer to the buffer where the memory will be
+        copied to.
+
+    Source - Supplies a pointer to the buffer to be copied.
+
+    ByteCount - Supplies the number of bytes to copy.
+
+Return Value:
+
+    Returns the destination pointer.
+
+--*/
+
+RTL_API
+VOID
+RtlSetMemorySimd (
+    PVOID Buffer,
+    INT Byte,
+    UINTN Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine writes the given byte value repeatedly into a region of memory
+    using SIMD instructions. The same restrictions as RtlCopyMemorySimd apply.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to set.
+
+    Byte - Supplies the byte to set.
+
+    Count - Supplies the number of bytes to set.
+
+Return Value:
+
+    None.
+
+--*/
+
+RTL_API
+INT
+RtlCompareMemorySimd (
+    PCVOID FirstBuffer,
+    PCVOID SecondBuffer,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine compares two buffers using SIMD instructions, and reports
+    which one sorts first. The same restrictions as RtlCopyMemorySimd apply.
+
+Arguments:
+
+    FirstBuffer - Supplies a pointer to the first buffer to compare.
+
+    SecondBuffer - Supplies a pointer to the second buffer to compare.
+
+    Size - Supplies the number of bytes to compare.
+
+Return Value:
+
+    0 if the buffers are equal.
+
+    Returns the difference between the first pair of unequal bytes, treated as
+    unsigned characters, otherwise.
+
+--*/
+
+RTL_API
+UINTN
+RtlStringLengthSimd (
+    PCSTR String
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines the length of the given string, not including its
+    NULL terminator, using SIMD instructions. The same restrictions as
+    RtlCopyMemorySimd apply.
+
+Arguments:
+
+    String - Supplies a pointer to the beginning of the string.
+
+Return Value:
+
+    Returns the length of the string, not including the NULL terminator.
+
+--*/
+
+RTL_API
+PVOID
+RtlFindByteSimd (
+    PCVOID Buffer,
+    INT Byte,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine finds the first occurrence of a byte in a buffer using SIMD
+    instructions. The same restrictions as RtlCopyMemorySimd apply.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Byte - Supplies the byte to search for. It is converted to an unsigned
+        character.
+
+    Size - Supplies the number of bytes to search.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the byte on success.
+
+    NULL if the byte does not occur in the buffer.
+
+--*/
+
 RTL_API
 BOOL
 RtlAreUuidsEqual (
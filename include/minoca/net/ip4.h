@@ -71,6 +71,14 @@ Module Name:
 
 #define IP4_BROADCAST_ADDRESS    0xFFFFFFFF
 
+//
+// Define the address and subnet mask assigned to the loopback link. These are
+// in network byte order.
+//
+
+#define IP4_LOOPBACK_ADDRESS     CPU_TO_NETWORK32(0x7F000001)
+#define IP4_LOOPBACK_SUBNET_MASK CPU_TO_NETWORK32(0xFF000000)
+
 #define IP4_ADDRESS_SIZE         4
 
 //
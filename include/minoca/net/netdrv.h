@@ -160,6 +160,7 @@ Module Name:
 #define NET_SPEED_100_MBPS 100000000ULL
 #define NET_SPEED_1000_MBPS 1000000000ULL
 #define NET_SPEED_2500_MBPS 2500000000ULL
+#define NET_SPEED_10000_MBPS 10000000000ULL
 
 //
 // Define well-known protocol numbers.
@@ -191,6 +192,7 @@ Module Name:
 #define NET_SOCKET_FLAG_FORKED_LISTENER         0x00000080
 #define NET_SOCKET_FLAG_NETWORK_HEADER_INCLUDED 0x00000100
 #define NET_SOCKET_FLAG_KERNEL                  0x00000200
+#define NET_SOCKET_FLAG_LISTENING               0x00000400
 
 //
 // Define the set of network socket flags that should be carried over to a
@@ -222,12 +224,21 @@ Module Name:
 #define NET_PACKET_FLAG_FORCE_TRANSMIT       0x00000040
 #define NET_PACKET_FLAG_UNENCRYPTED          0x00000080
 #define NET_PACKET_FLAG_MULTICAST            0x00000100
+#define NET_PACKET_FLAG_EXCHANGEABLE         0x00000200
+#define NET_PACKET_FLAG_SEGMENTATION_OFFLOAD 0x00000400
 
 #define NET_PACKET_FLAG_CHECKSUM_OFFLOAD_MASK \
     (NET_PACKET_FLAG_IP_CHECKSUM_OFFLOAD |    \
      NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD |   \
      NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD)
 
+//
+// Define the default number of received packets a device should hand to the
+// networking core in a single batch before checking for other work.
+//
+
+#define NET_RECEIVE_DEFAULT_BUDGET 64
+
 //
 // Define the network link capabilities.
 //
@@ -239,6 +250,7 @@ Module Name:
 #define NET_LINK_CAPABILITY_RECEIVE_UDP_CHECKSUM_OFFLOAD  0x00000010
 #define NET_LINK_CAPABILITY_RECEIVE_TCP_CHECKSUM_OFFLOAD  0x00000020
 #define NET_LINK_CAPABILITY_PROMISCUOUS_MODE              0x00000040
+#define NET_LINK_CAPABILITY_TCP_SEGMENTATION_OFFLOAD      0x00000080
 
 #define NET_LINK_CAPABILITY_CHECKSUM_TRANSMIT_MASK       \
     (NET_LINK_CAPABILITY_TRANSMIT_IP_CHECKSUM_OFFLOAD |  \
@@ -426,6 +438,10 @@ Structure Description:
         beginning of the footer data (ie the location to store the first byte
         of new footer).
 
+    SegmentSize - Stores the maximum payload size of each segment the hardware
+        should split the packet into. This is only valid if the segmentation
+        offload flag is set.
+
 --*/
 
 typedef struct _NET_PACKET_BUFFER {
@@ -438,6 +454,7 @@ typedef struct _NET_PACKET_BUFFER {
     ULONG DataSize;
     ULONG DataOffset;
     ULONG FooterOffset;
+    ULONG SegmentSize;
 } NET_PACKET_BUFFER, *PNET_PACKET_BUFFER;
 
 /*++
@@ -636,6 +653,7 @@ typedef struct _NET_LINK_PROPERTIES {
 } NET_LINK_PROPERTIES, *PNET_LINK_PROPERTIES;
 
 typedef struct _NET_DATA_LINK_ENTRY NET_DATA_LINK_ENTRY, *PNET_DATA_LINK_ENTRY;
+typedef struct _NET_RECEIVE_BATCH NET_RECEIVE_BATCH, *PNET_RECEIVE_BATCH;
 
 /*++
 
@@ -679,6 +697,10 @@ Structure Description:
     AddressTranslationTree - Stores the tree containing translations between
         network addresses and physical addresses, keyed by network address.
 
+    ReceiveBatch - Stores a pointer to the batch of received packets currently
+        being processed on this link, if any. This is owned by the core
+        networking library.
+
 --*/
 
 typedef struct _NET_LINK {
@@ -693,6 +715,7 @@ typedef struct _NET_LINK {
     NET_LINK_PROPERTIES Properties;
     PKEVENT AddressTranslationEvent;
     RED_BLACK_TREE AddressTranslationTree;
+    volatile PNET_RECEIVE_BATCH ReceiveBatch;
 } NET_LINK, *PNET_LINK;
 
 typedef
@@ -1568,6 +1591,30 @@ Return Value:
 
 --*/
 
+typedef
+VOID
+(*PNET_PROTOCOL_FLUSH_RECEIVED_DATA) (
+    PNET_SOCKET Socket
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called at the end of a batch of received packets for a
+    socket that deferred work with NetDeferSocketReceiveFlush. The protocol
+    should process anything it held back while the batch was in progress.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket to flush.
+
+Return Value:
+
+    None.
+
+--*/
+
 /*++
 
 Structure Description:
@@ -1617,6 +1664,10 @@ Structure Description:
     UserControl - Stores a pointer to a function used to respond to user
         control (ioctl) requests.
 
+    FlushReceivedData - Stores an optional pointer to a function called at the
+        end of a batch of received packets for sockets that asked to defer
+        work until then.
+
 --*/
 
 typedef struct _NET_PROTOCOL_INTERFACE {
@@ -1634,6 +1685,7 @@ typedef struct _NET_PROTOCOL_INTERFACE {
     PNET_PROTOCOL_RECEIVE Receive;
     PNET_PROTOCOL_GET_SET_INFORMATION GetSetInformation;
     PNET_PROTOCOL_USER_CONTROL UserControl;
+    PNET_PROTOCOL_FLUSH_RECEIVED_DATA FlushReceivedData;
 } NET_PROTOCOL_INTERFACE, *PNET_PROTOCOL_INTERFACE;
 
 /*++
@@ -2519,6 +2571,143 @@ Return Value:
 
 --*/
 
+NET_API
+VOID
+NetProcessReceivedPacketList (
+    PNET_LINK Link,
+    PNET_PACKET_LIST PacketList
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called by the low level NIC driver to pass a batch of
+    received packets onto the core networking library for dispatching. Drivers
+    should call this from their receive poll loop, collecting at most a budget
+    of packets (see NET_RECEIVE_DEFAULT_BUDGET) per call. Socket wakeups are
+    deferred until the entire batch has been processed so that readers are
+    woken once per batch rather than once per packet.
+
+Arguments:
+
+    Link - Supplies a pointer to the link that received the packets.
+
+    PacketList - Supplies a pointer to the list of received packets. Each
+        packet may be used as a scratch space while this routine executes.
+        If a packet has the exchangeable flag set, then the networking core
+        may keep the packet's data and swap in a fresh buffer of equal or
+        greater size, in which case the buffer, I/O buffer, and physical
+        address of the packet will have changed when this routine returns. The
+        packet structures themselves always remain on the list.
+
+Return Value:
+
+    None. When the function returns, the packet buffers on the list may be
+    reclaimed and reused by the driver.
+
+--*/
+
+NET_API
+VOID
+NetSetSocketReceiveEvents (
+    PNET_LINK Link,
+    PNET_SOCKET Socket,
+    ULONG Events
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the given poll events on a socket in response to
+    received data. If the link is in the middle of processing a batch of
+    received packets on the current thread, the events are coalesced and set
+    once when the batch completes. Otherwise they are set immediately.
+
+Arguments:
+
+    Link - Supplies an optional pointer to the link that received the data.
+
+    Socket - Supplies a pointer to the socket to signal.
+
+    Events - Supplies the mask of poll events to set.
+
+Return Value:
+
+    None.
+
+--*/
+
+NET_API
+KSTATUS
+NetClaimReceivedPacket (
+    PNET_RECEIVE_CONTEXT ReceiveContext,
+    PNET_PACKET_BUFFER *ClaimedPacket
+    );
+
+/*++
+
+Routine Description:
+
+    This routine attempts to take ownership of the data in a received packet
+    without copying it. This only succeeds for packets the device marked as
+    exchangeable. On success, the received data is moved into a new packet
+    owned by the caller and the device's packet receives a fresh buffer. The
+    packet in the receive context must not be examined after this routine
+    succeeds.
+
+Arguments:
+
+    ReceiveContext - Supplies a pointer to the receive context for the packet.
+
+    ClaimedPacket - Supplies a pointer where a pointer to the packet holding
+        the received data will be returned on success. The caller is
+        responsible for releasing it with NetFreeBuffer.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the packet cannot be exchanged.
+
+    STATUS_INSUFFICIENT_RESOURCES if a replacement buffer could not be
+    allocated.
+
+--*/
+
+NET_API
+BOOL
+NetDeferSocketReceiveFlush (
+    PNET_LINK Link,
+    PNET_SOCKET Socket
+    );
+
+/*++
+
+Routine Description:
+
+    This routine requests that the socket's protocol flush routine be called
+    once the link finishes processing the current batch of received packets.
+    This allows a protocol to hold back and merge work across the packets of a
+    batch.
+
+Arguments:
+
+    Link - Supplies a pointer to the link that received the data.
+
+    Socket - Supplies a pointer to the socket to flush. A reference is taken on
+        the socket until the flush completes.
+
+Return Value:
+
+    TRUE if the flush routine will be called at the end of the batch.
+
+    FALSE if the calling thread is not processing a receive batch on the link
+    or the batch is full. The caller must not defer any work in this case.
+
+--*/
+
 NET_API
 BOOL
 NetGetGlobalDebugFlag (
@@ -71,6 +71,48 @@ Module Name:
 #define ATA_DRIVE_SELECT_MASTER 0xA0
 #define ATA_DRIVE_SELECT_SLAVE 0xB0
 
+//
+// Define Serial ATA capabilities bits (word 76 of the identify data).
+//
+
+#define ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING 0x0100
+
+//
+// Define the mask of the queue depth field, which holds the maximum queue
+// depth minus one.
+//
+
+#define ATA_QUEUE_DEPTH_MASK 0x001F
+
+//
+// Define the nominal media rotation rate reported by solid state devices
+// (word 217 of the identify data).
+//
+
+#define ATA_NOMINAL_ROTATION_RATE_NON_ROTATING 0x0001
+
+//
+// Define the FPDMA QUEUED command fields. The tag goes in the count register,
+// and the sector count goes in the features register.
+//
+
+#define ATA_FPDMA_TAG_SHIFT 3
+#define ATA_FPDMA_FORCE_UNIT_ACCESS 0x80
+
+//
+// Define the log address of the NCQ command error log, read with READ LOG EXT
+// to find out which queued command failed.
+//
+
+#define ATA_LOG_NCQ_COMMAND_ERROR 0x10
+
+//
+// Define bits in the first byte of the NCQ command error log.
+//
+
+#define ATA_NCQ_ERROR_TAG_MASK 0x1F
+#define ATA_NCQ_ERROR_NON_QUEUED 0x80
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -79,9 +121,12 @@ typedef enum _ATA_COMMAND {
     AtaCommandReadPio28         = 0x20,
     AtaCommandReadPio48         = 0x24,
     AtaCommandReadDma48         = 0x25,
+    AtaCommandReadLogExt        = 0x2F,
     AtaCommandWritePio28        = 0x30,
     AtaCommandWritePio48        = 0x34,
     AtaCommandWriteDma48        = 0x35,
+    AtaCommandReadFpdmaQueued   = 0x60,
+    AtaCommandWriteFpdmaQueued  = 0x61,
     AtaCommandPacket            = 0xA0,
     AtaCommandIdentifyPacket    = 0xA1,
     AtaCommandReadDma28         = 0xC8,
@@ -147,6 +192,10 @@ Structure Description:
 
     QueueDepth - Stores the maximum queue depth minus one.
 
+    SataCapabilities - Stores the Serial ATA capabilities, such as whether or
+        not native command queuing is supported. See ATA_SATA_CAPABILITY_*
+        definitions.
+
     MajorVersion - Stores the major version of the ATA/ATAPI protocol
         supported.
 
@@ -227,7 +276,8 @@ typedef struct _ATA_IDENTIFY_PACKET {
     USHORT MinPioTransferCyclesWithFlow;
     USHORT Reserved7[6];
     USHORT QueueDepth;
-    USHORT Reserved8[4];
+    USHORT SataCapabilities;
+    USHORT Reserved8[3];
     USHORT MajorVersion;
     USHORT MinorVersion;
     ULONG CommandSetSupported;
@@ -250,7 +300,9 @@ typedef struct _ATA_IDENTIFY_PACKET {
     USHORT PowerMode1;
     USHORT Reserved12[15];
     USHORT MediaSerialNumber[30];
-    USHORT Reserved13[49];
+    USHORT Reserved13[11];
+    USHORT NominalRotationRate;
+    USHORT Reserved14[37];
     USHORT Checksum;
 } PACKED ATA_IDENTIFY_PACKET, *PATA_IDENTIFY_PACKET;
 
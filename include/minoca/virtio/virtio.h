@@ -0,0 +1,331 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtio.h
+
+Abstract:
+
+    This header contains definitions for virtio devices exposed through the
+    legacy (transitional) PCI interface, shared by the virtio device drivers.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro returns the size of the available ring for a queue with the
+// given number of entries, including the trailing used event field.
+//
+
+#define VIRTIO_QUEUE_AVAILABLE_SIZE(_Count) \
+    (sizeof(USHORT) * (3 + (_Count)))
+
+//
+// This macro returns the size of the used ring for a queue with the given
+// number of entries, including the trailing available event field.
+//
+
+#define VIRTIO_QUEUE_USED_SIZE(_Count)                   \
+    ((sizeof(USHORT) * 3) +                              \
+     (sizeof(VIRTIO_QUEUE_USED_ELEMENT) * (_Count)))
+
+//
+// This macro returns the offset of the used ring from the start of a legacy
+// queue allocation. The legacy interface places it on the next aligned
+// boundary after the descriptors and available ring.
+//
+
+#define VIRTIO_LEGACY_QUEUE_USED_OFFSET(_Count)                      \
+    ALIGN_RANGE_UP((sizeof(VIRTIO_QUEUE_DESCRIPTOR) * (_Count)) +    \
+                   VIRTIO_QUEUE_AVAILABLE_SIZE(_Count),              \
+                   VIRTIO_LEGACY_QUEUE_ALIGNMENT)
+
+//
+// This macro returns the total size of a legacy queue allocation.
+//
+
+#define VIRTIO_LEGACY_QUEUE_SIZE(_Count)                             \
+    ALIGN_RANGE_UP(VIRTIO_LEGACY_QUEUE_USED_OFFSET(_Count) +         \
+                   VIRTIO_QUEUE_USED_SIZE(_Count),                   \
+                   VIRTIO_LEGACY_QUEUE_ALIGNMENT)
+
+//
+// This macro evaluates to non-zero if moving a ring index from the old value
+// to the new value crosses the event index published by the other side. This
+// is used to decide whether to notify the device or expect an interrupt when
+// event indexes have been negotiated.
+//
+
+#define VIRTIO_QUEUE_NEED_EVENT(_Event, _New, _Old) \
+    ((USHORT)((_New) - (_Event) - 1) < (USHORT)((_New) - (_Old)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the PCI vendor ID used by all virtio devices.
+//
+
+#define VIRTIO_PCI_VENDOR_ID 0x1AF4
+
+//
+// Define the transitional PCI device IDs.
+//
+
+#define VIRTIO_PCI_DEVICE_ID_NET   0x1000
+#define VIRTIO_PCI_DEVICE_ID_BLOCK 0x1001
+
+//
+// Define the alignment of the used ring and the page size used for queue
+// addresses in the legacy interface.
+//
+
+#define VIRTIO_LEGACY_QUEUE_ALIGNMENT 4096
+#define VIRTIO_LEGACY_QUEUE_ADDRESS_SHIFT 12
+
+//
+// Define the value that disconnects a queue or configuration change event
+// from any MSI-X vector.
+//
+
+#define VIRTIO_MSI_NO_VECTOR 0xFFFF
+
+//
+// Define the device status bits.
+//
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FEATURES_OK 0x08
+#define VIRTIO_STATUS_FAILED      0x80
+
+//
+// Define the interrupt status register bits, used with line interrupts. The
+// register is cleared when read.
+//
+
+#define VIRTIO_ISR_QUEUE          0x01
+#define VIRTIO_ISR_CONFIGURATION  0x02
+
+//
+// Define the device independent feature bits.
+//
+
+#define VIRTIO_FEATURE_NOTIFY_ON_EMPTY     (1 << 24)
+#define VIRTIO_FEATURE_ANY_LAYOUT          (1 << 27)
+#define VIRTIO_FEATURE_INDIRECT_DESCRIPTOR (1 << 28)
+#define VIRTIO_FEATURE_EVENT_INDEX         (1 << 29)
+
+//
+// Define the queue descriptor flags.
+//
+
+#define VIRTIO_DESCRIPTOR_FLAG_NEXT     0x0001
+#define VIRTIO_DESCRIPTOR_FLAG_WRITE    0x0002
+#define VIRTIO_DESCRIPTOR_FLAG_INDIRECT 0x0004
+
+//
+// Define the available ring flags. This asks the device not to interrupt when
+// it consumes a buffer, and is only a hint. It is not used when event indexes
+// are negotiated.
+//
+
+#define VIRTIO_AVAILABLE_FLAG_NO_INTERRUPT 0x0001
+
+//
+// Define the used ring flags. This tells the driver not to notify the device
+// when adding buffers, and is not used when event indexes are negotiated.
+//
+
+#define VIRTIO_USED_FLAG_NO_NOTIFY 0x0001
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Enumeration Description:
+
+    This enumeration describes the registers in the legacy virtio PCI I/O
+    space. The device specific configuration follows the last register, at an
+    offset that depends on whether or not MSI-X is enabled.
+
+Values:
+
+    VirtioRegisterDeviceFeatures - Indicates the 32-bit register of features
+        the device supports.
+
+    VirtioRegisterDriverFeatures - Indicates the 32-bit register where the
+        driver writes the features it accepts.
+
+    VirtioRegisterQueueAddress - Indicates the 32-bit register holding the
+        physical page frame number of the selected queue.
+
+    VirtioRegisterQueueSize - Indicates the 16-bit read-only register holding
+        the number of entries in the selected queue.
+
+    VirtioRegisterQueueSelect - Indicates the 16-bit register that selects the
+        queue the address, size, and vector registers refer to.
+
+    VirtioRegisterQueueNotify - Indicates the 16-bit register the driver writes
+        a queue index to in order to notify the device of new buffers.
+
+    VirtioRegisterDeviceStatus - Indicates the 8-bit device status register.
+
+    VirtioRegisterIsrStatus - Indicates the 8-bit interrupt status register.
+
+    VirtioRegisterConfigurationVector - Indicates the 16-bit register holding
+        the MSI-X vector for configuration changes. Only present when MSI-X is
+        enabled.
+
+    VirtioRegisterQueueVector - Indicates the 16-bit register holding the MSI-X
+        vector for the selected queue. Only present when MSI-X is enabled.
+
+    VirtioRegisterDeviceConfiguration - Indicates the offset of the device
+        specific configuration when MSI-X is disabled.
+
+    VirtioRegisterMsixDeviceConfiguration - Indicates the offset of the device
+        specific configuration when MSI-X is enabled.
+
+--*/
+
+typedef enum _VIRTIO_REGISTER {
+    VirtioRegisterDeviceFeatures = 0x00,
+    VirtioRegisterDriverFeatures = 0x04,
+    VirtioRegisterQueueAddress = 0x08,
+    VirtioRegisterQueueSize = 0x0C,
+    VirtioRegisterQueueSelect = 0x0E,
+    VirtioRegisterQueueNotify = 0x10,
+    VirtioRegisterDeviceStatus = 0x12,
+    VirtioRegisterIsrStatus = 0x13,
+    VirtioRegisterConfigurationVector = 0x14,
+    VirtioRegisterQueueVector = 0x16,
+    VirtioRegisterDeviceConfiguration = 0x14,
+    VirtioRegisterMsixDeviceConfiguration = 0x18
+} VIRTIO_REGISTER, *PVIRTIO_REGISTER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio queue descriptor.
+
+Members:
+
+    Address - Stores the physical address of the buffer.
+
+    Length - Stores the length of the buffer in bytes.
+
+    Flags - Stores a bitmask of flags. See VIRTIO_DESCRIPTOR_FLAG_*.
+
+    Next - Stores the index of the next descriptor in the chain if the next
+        flag is set.
+
+--*/
+
+typedef struct _VIRTIO_QUEUE_DESCRIPTOR {
+    ULONGLONG Address;
+    ULONG Length;
+    USHORT Flags;
+    USHORT Next;
+} PACKED VIRTIO_QUEUE_DESCRIPTOR, *PVIRTIO_QUEUE_DESCRIPTOR;
+
+/*++
+
+Structure Description:
+
+    This structure defines the ring of descriptor chains the driver makes
+    available to the device. When event indexes are negotiated, the ring is
+    followed by a USHORT holding the used ring index at which the driver next
+    wants an interrupt.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIRTIO_AVAILABLE_FLAG_*.
+
+    Index - Stores the free running index where the driver will put the next
+        entry in the ring.
+
+    Ring - Stores the array of descriptor chain head indices.
+
+--*/
+
+typedef struct _VIRTIO_QUEUE_AVAILABLE {
+    USHORT Flags;
+    USHORT Index;
+    USHORT Ring[ANYSIZE_ARRAY];
+} PACKED VIRTIO_QUEUE_AVAILABLE, *PVIRTIO_QUEUE_AVAILABLE;
+
+/*++
+
+Structure Description:
+
+    This structure defines an entry in the used ring.
+
+Members:
+
+    Id - Stores the index of the head of the descriptor chain that was used.
+
+    Length - Stores the number of bytes the device wrote into the chain.
+
+--*/
+
+typedef struct _VIRTIO_QUEUE_USED_ELEMENT {
+    ULONG Id;
+    ULONG Length;
+} PACKED VIRTIO_QUEUE_USED_ELEMENT, *PVIRTIO_QUEUE_USED_ELEMENT;
+
+/*++
+
+Structure Description:
+
+    This structure defines the ring of descriptor chains the device has
+    finished with. When event indexes are negotiated, the ring is followed by
+    a USHORT holding the available ring index at which the device next wants
+    to be notified.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIRTIO_USED_FLAG_*.
+
+    Index - Stores the free running index where the device will put the next
+        entry in the ring.
+
+    Ring - Stores the array of used elements.
+
+--*/
+
+typedef struct _VIRTIO_QUEUE_USED {
+    USHORT Flags;
+    USHORT Index;
+    VIRTIO_QUEUE_USED_ELEMENT Ring[ANYSIZE_ARRAY];
+} PACKED VIRTIO_QUEUE_USED, *PVIRTIO_QUEUE_USED;
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
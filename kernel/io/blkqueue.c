@@ -0,0 +1,1297 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    blkqueue.c
+
+Abstract:
+
+    This module implements the block request queue, which sits between the
+    I/O subsystem and block devices. Reads and writes from all threads headed
+    to a block device gather in the device's queue while the device is busy.
+    When a request is dispatched, contiguous neighbors going the same
+    direction are merged into it so the disk sees one large transfer instead
+    of many small ones.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the largest request the queue will build by merging neighbors.
+//
+
+#define BLOCK_QUEUE_MAX_MERGE_SIZE (128 * _1KB)
+
+//
+// Define the maximum number of requests that can be merged into one.
+//
+
+#define BLOCK_QUEUE_MAX_BATCH 32
+
+//
+// Define the number of dispatches each policy allows out at the device at
+// once. While all of these slots are busy the queue is plugged, and arriving
+// requests wait in the queue where they can be sorted and merged.
+//
+
+#define BLOCK_QUEUE_DEADLINE_MAX_IN_FLIGHT 1
+#define BLOCK_QUEUE_NOOP_MAX_IN_FLIGHT 32
+
+//
+// Define how long reads and writes can wait in a deadline queue before they
+// are issued ahead of the sweep, in microseconds. Writes are usually on
+// behalf of the page cache, so nobody is waiting on them directly.
+//
+
+#define BLOCK_QUEUE_READ_DEADLINE (500 * MICROSECONDS_PER_MILLISECOND)
+#define BLOCK_QUEUE_WRITE_DEADLINE (5000 * MICROSECONDS_PER_MILLISECOND)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _BLOCK_REQUEST_STATE {
+    BlockRequestQueued,
+    BlockRequestDispatch,
+    BlockRequestComplete
+} BLOCK_REQUEST_STATE, *PBLOCK_REQUEST_STATE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a request waiting in a block queue. It lives on the
+    stack of the thread that submitted it.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous requests in the
+        queue. The next pointer is NULL if the request is not in the queue.
+
+    MinorCode - Stores the minor code of the request, either read or write.
+
+    ReadWrite - Stores a pointer to the submitter's I/O parameters, which
+        also receive the results.
+
+    Deadline - Stores the time counter value after which the request should
+        be issued ahead of others.
+
+    Event - Stores a pointer to the event the submitter waits on while the
+        request is queued.
+
+    State - Stores the state of the request, which tells the submitter why it
+        was woken.
+
+    Status - Stores the completion status of the request.
+
+    Mergeable - Stores a boolean indicating if the request's buffer is
+        backed by the page cache, and so can be combined with others.
+
+--*/
+
+typedef struct _BLOCK_REQUEST {
+    LIST_ENTRY ListEntry;
+    IRP_MINOR_CODE MinorCode;
+    PIRP_READ_WRITE ReadWrite;
+    ULONGLONG Deadline;
+    PKEVENT Event;
+    volatile BLOCK_REQUEST_STATE State;
+    KSTATUS Status;
+    BOOL Mergeable;
+} BLOCK_REQUEST, *PBLOCK_REQUEST;
+
+/*++
+
+Structure Description:
+
+    This structure defines a block request queue.
+
+Members:
+
+    Lock - Stores a pointer to the lock protecting the queue.
+
+    RequestListHead - Stores the head of the list of waiting requests. This
+        list is sorted by offset for the deadline policy, and in arrival order
+        for the no-op policy.
+
+    Policy - Stores the scheduling policy.
+
+    MaxInFlight - Stores the maximum number of dispatches allowed out at the
+        device at once.
+
+    InFlight - Stores the number of dispatches currently out at the device.
+
+    QueueDepth - Stores the number of requests waiting in the list.
+
+    MaxQueueDepth - Stores the highest the queue depth has ever been.
+
+    HeadOffset - Stores the offset just beyond the last dispatched request,
+        which approximates where the disk head is.
+
+    ReadDeadline - Stores the read deadline, in time counter ticks.
+
+    WriteDeadline - Stores the write deadline, in time counter ticks.
+
+    Requests - Stores the number of requests submitted to the queue.
+
+    Merges - Stores the number of requests merged into another.
+
+    Dispatches - Stores the number of requests sent to the device.
+
+    DeadlineExpirations - Stores the number of requests issued out of order
+        because their deadline expired.
+
+--*/
+
+struct _BLOCK_QUEUE {
+    PQUEUED_LOCK Lock;
+    LIST_ENTRY RequestListHead;
+    BLOCK_QUEUE_POLICY Policy;
+    ULONG MaxInFlight;
+    ULONG InFlight;
+    ULONG QueueDepth;
+    ULONG MaxQueueDepth;
+    IO_OFFSET HeadOffset;
+    ULONGLONG ReadDeadline;
+    ULONGLONG WriteDeadline;
+    ULONGLONG Requests;
+    ULONGLONG Merges;
+    ULONGLONG Dispatches;
+    ULONGLONG DeadlineExpirations;
+};
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+PBLOCK_QUEUE
+IopGetBlockQueue (
+    PDEVICE Device
+    );
+
+BLOCK_QUEUE_POLICY
+IopGetInheritedBlockQueuePolicy (
+    PDEVICE Device
+    );
+
+VOID
+IopSetBlockQueuePolicy (
+    PBLOCK_QUEUE Queue,
+    BLOCK_QUEUE_POLICY Policy
+    );
+
+KSTATUS
+IopDispatchBlockRequest (
+    PBLOCK_QUEUE Queue,
+    PDEVICE Device,
+    PBLOCK_REQUEST Request
+    );
+
+VOID
+IopInsertBlockRequest (
+    PBLOCK_QUEUE Queue,
+    PBLOCK_REQUEST Request
+    );
+
+PBLOCK_REQUEST
+IopSelectBlockRequest (
+    PBLOCK_QUEUE Queue
+    );
+
+ULONG
+IopGatherBlockRequests (
+    PBLOCK_QUEUE Queue,
+    PBLOCK_REQUEST *Batch
+    );
+
+VOID
+IopSendBlockRequests (
+    PDEVICE Device,
+    PBLOCK_REQUEST *Batch,
+    ULONG Count
+    );
+
+BOOL
+IopIsBlockRequestMergeable (
+    PIRP_READ_WRITE Request
+    );
+
+BOOL
+IopCanMergeBlockRequests (
+    PBLOCK_REQUEST Request,
+    PBLOCK_REQUEST Candidate
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+UUID IoBlockQueueInformationUuid = BLOCK_QUEUE_DEVICE_INFORMATION_UUID;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KERNEL_API
+VOID
+IoSetDeviceBlockQueuePolicy (
+    PDEVICE Device,
+    BLOCK_QUEUE_POLICY Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the policy used to schedule block I/O requests headed
+    to the given device or any device stacked on top of it, like partitions.
+    Disk drivers call this to indicate whether or not their media is
+    rotational.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Policy - Supplies the scheduling policy to use.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PBLOCK_QUEUE Queue;
+
+    ASSERT(Policy < BlockQueuePolicyCount);
+
+    //
+    // Queues on devices stacked above this one pick up the policy when they
+    // are created on their first I/O, so this only needs to update the
+    // device's own queue if it has one already.
+    //
+
+    Device->BlockQueuePolicy = Policy;
+    Queue = Device->BlockQueue;
+    if (Queue != NULL) {
+        Policy = IopGetInheritedBlockQueuePolicy(Device);
+        KeAcquireQueuedLock(Queue->Lock);
+        IopSetBlockQueuePolicy(Queue, Policy);
+        KeReleaseQueuedLock(Queue->Lock);
+    }
+
+    return;
+}
+
+KSTATUS
+IopSendBlockIoRequest (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCode,
+    PIRP_READ_WRITE Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a block I/O request through the device's request
+    queue, where it may be reordered according to the queue's policy and
+    merged with contiguous requests from other threads. This routine waits
+    for the request to complete, and must be called at low level.
+
+Arguments:
+
+    Device - Supplies a pointer to the block device to send the request to.
+
+    MinorCode - Supplies the minor code of the request, either read or write.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters, and on output contains the completion results.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BLOCK_REQUEST BlockRequest;
+    PBLOCK_QUEUE Queue;
+    BOOL Queued;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT((MinorCode == IrpMinorIoRead) || (MinorCode == IrpMinorIoWrite));
+
+    Queue = IopGetBlockQueue(Device);
+    if (Queue == NULL) {
+        return IopSendIoRequest(Device, MinorCode, Request);
+    }
+
+    BlockRequest.ListEntry.Next = NULL;
+    BlockRequest.MinorCode = MinorCode;
+    BlockRequest.ReadWrite = Request;
+    BlockRequest.Deadline = KeGetRecentTimeCounter();
+    if (MinorCode == IrpMinorIoRead) {
+        BlockRequest.Deadline += Queue->ReadDeadline;
+
+    } else {
+        BlockRequest.Deadline += Queue->WriteDeadline;
+    }
+
+    BlockRequest.Event = NULL;
+    BlockRequest.State = BlockRequestQueued;
+    BlockRequest.Status = STATUS_SUCCESS;
+    BlockRequest.Mergeable = IopIsBlockRequestMergeable(Request);
+
+    //
+    // If the queue is empty and there's a free dispatch slot, take it and go
+    // straight to the device. Otherwise wait in the queue, which needs an
+    // event. The event is created with the lock dropped, so the state of the
+    // queue has to be rechecked afterwards.
+    //
+
+    Queued = FALSE;
+    while (TRUE) {
+        KeAcquireQueuedLock(Queue->Lock);
+        if ((Queue->InFlight < Queue->MaxInFlight) &&
+            (LIST_EMPTY(&(Queue->RequestListHead)) != FALSE)) {
+
+            Queue->InFlight += 1;
+            break;
+        }
+
+        if (BlockRequest.Event != NULL) {
+            IopInsertBlockRequest(Queue, &BlockRequest);
+            Queued = TRUE;
+            break;
+        }
+
+        KeReleaseQueuedLock(Queue->Lock);
+        BlockRequest.Event = KeCreateEvent(NULL);
+        if (BlockRequest.Event == NULL) {
+            return IopSendIoRequest(Device, MinorCode, Request);
+        }
+    }
+
+    Queue->Requests += 1;
+    KeReleaseQueuedLock(Queue->Lock);
+
+    //
+    // Wait for either another thread to complete this request as part of its
+    // dispatch, or for a dispatch slot to be handed over. Bounce through the
+    // lock afterwards, since the event is signaled with the lock held, and
+    // the event cannot be destroyed until the signaler is done with it.
+    //
+
+    if (Queued != FALSE) {
+        KeWaitForEvent(BlockRequest.Event, FALSE, WAIT_TIME_INDEFINITE);
+        KeAcquireQueuedLock(Queue->Lock);
+        KeReleaseQueuedLock(Queue->Lock);
+        if (BlockRequest.State == BlockRequestComplete) {
+            Status = BlockRequest.Status;
+            goto SendBlockIoRequestEnd;
+        }
+
+        ASSERT(BlockRequest.State == BlockRequestDispatch);
+    }
+
+    Status = IopDispatchBlockRequest(Queue, Device, &BlockRequest);
+
+SendBlockIoRequestEnd:
+    if (BlockRequest.Event != NULL) {
+        KeDestroyEvent(BlockRequest.Event);
+    }
+
+    return Status;
+}
+
+VOID
+IopDestroyBlockQueue (
+    PDEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys the block request queue for the given device, if
+    one was ever created.
+
+Arguments:
+
+    Device - Supplies a pointer to the device being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PBLOCK_QUEUE Queue;
+
+    Queue = Device->BlockQueue;
+    if (Queue == NULL) {
+        return;
+    }
+
+    IoRegisterDeviceInformation(Device, &IoBlockQueueInformationUuid, FALSE);
+
+    ASSERT(LIST_EMPTY(&(Queue->RequestListHead)) != FALSE);
+    ASSERT(Queue->InFlight == 0);
+
+    KeDestroyQueuedLock(Queue->Lock);
+    MmFreeNonPagedPool(Queue);
+    Device->BlockQueue = NULL;
+    return;
+}
+
+KSTATUS
+IopGetSetBlockQueueInformation (
+    PDEVICE Device,
+    PBLOCK_QUEUE_DEVICE_INFORMATION Information,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the block request queue device information for
+    the given device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Information - Supplies a pointer to the information buffer.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        buffer. On output, returns the needed size of the buffer.
+
+    Set - Supplies a boolean indicating whether to get the information (FALSE)
+        or set the policy (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BLOCK_QUEUE_POLICY Policy;
+    PBLOCK_QUEUE Queue;
+
+    Queue = Device->BlockQueue;
+    if (Queue == NULL) {
+        *DataSize = 0;
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (*DataSize < sizeof(BLOCK_QUEUE_DEVICE_INFORMATION)) {
+        *DataSize = sizeof(BLOCK_QUEUE_DEVICE_INFORMATION);
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    *DataSize = sizeof(BLOCK_QUEUE_DEVICE_INFORMATION);
+    if (Set != FALSE) {
+        if (Information->Version < BLOCK_QUEUE_DEVICE_INFORMATION_VERSION) {
+            return STATUS_VERSION_MISMATCH;
+        }
+
+        Policy = Information->Policy;
+        if (Policy >= BlockQueuePolicyCount) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (Policy == BlockQueuePolicyDefault) {
+            Policy = IopGetInheritedBlockQueuePolicy(Device);
+        }
+
+        KeAcquireQueuedLock(Queue->Lock);
+        IopSetBlockQueuePolicy(Queue, Policy);
+        KeReleaseQueuedLock(Queue->Lock);
+        return STATUS_SUCCESS;
+    }
+
+    KeAcquireQueuedLock(Queue->Lock);
+    Information->Version = BLOCK_QUEUE_DEVICE_INFORMATION_VERSION;
+    Information->Policy = Queue->Policy;
+    Information->QueueDepth = Queue->QueueDepth;
+    Information->MaxQueueDepth = Queue->MaxQueueDepth;
+    Information->InFlight = Queue->InFlight;
+    Information->Requests = Queue->Requests;
+    Information->Merges = Queue->Merges;
+    Information->Dispatches = Queue->Dispatches;
+    Information->DeadlineExpirations = Queue->DeadlineExpirations;
+    KeReleaseQueuedLock(Queue->Lock);
+    return STATUS_SUCCESS;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+PBLOCK_QUEUE
+IopGetBlockQueue (
+    PDEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the block request queue for the given device,
+    creating it if this is the device's first block I/O.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Returns a pointer to the queue, or NULL on allocation failure.
+
+--*/
+
+{
+
+    PBLOCK_QUEUE NewQueue;
+    PBLOCK_QUEUE Queue;
+
+    Queue = Device->BlockQueue;
+    if (Queue != NULL) {
+        return Queue;
+    }
+
+    //
+    // The queue is touched on the paging path, so it cannot be paged out.
+    //
+
+    NewQueue = MmAllocateNonPagedPool(sizeof(BLOCK_QUEUE),
+                                      BLOCK_QUEUE_ALLOCATION_TAG);
+
+    if (NewQueue == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory(NewQueue, sizeof(BLOCK_QUEUE));
+    INITIALIZE_LIST_HEAD(&(NewQueue->RequestListHead));
+    NewQueue->Lock = KeCreateQueuedLock();
+    if (NewQueue->Lock == NULL) {
+        MmFreeNonPagedPool(NewQueue);
+        return NULL;
+    }
+
+    NewQueue->ReadDeadline =
+                    KeConvertMicrosecondsToTimeTicks(BLOCK_QUEUE_READ_DEADLINE);
+
+    NewQueue->WriteDeadline =
+                   KeConvertMicrosecondsToTimeTicks(BLOCK_QUEUE_WRITE_DEADLINE);
+
+    IopSetBlockQueuePolicy(NewQueue, IopGetInheritedBlockQueuePolicy(Device));
+
+    //
+    // Race to install the queue. The loser cleans up its copy.
+    //
+
+    Queue = (PBLOCK_QUEUE)RtlAtomicCompareExchange(
+                                                (PUINTN)&(Device->BlockQueue),
+                                                (UINTN)NewQueue,
+                                                (UINTN)NULL);
+
+    if (Queue != NULL) {
+        KeDestroyQueuedLock(NewQueue->Lock);
+        MmFreeNonPagedPool(NewQueue);
+        return Queue;
+    }
+
+    //
+    // Publish the queue statistics. Failure here only means they can't be
+    // queried.
+    //
+
+    IoRegisterDeviceInformation(Device, &IoBlockQueueInformationUuid, TRUE);
+    return NewQueue;
+}
+
+BLOCK_QUEUE_POLICY
+IopGetInheritedBlockQueuePolicy (
+    PDEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines the scheduling policy for a device's block
+    queue, which comes from the nearest device up the tree that expressed a
+    preference. A partition's parent is its disk, for example.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Returns the policy to use.
+
+--*/
+
+{
+
+    while (Device != NULL) {
+        if (Device->BlockQueuePolicy != BlockQueuePolicyDefault) {
+            return Device->BlockQueuePolicy;
+        }
+
+        Device = Device->ParentDevice;
+    }
+
+    return BlockQueuePolicyDeadline;
+}
+
+VOID
+IopSetBlockQueuePolicy (
+    PBLOCK_QUEUE Queue,
+    BLOCK_QUEUE_POLICY Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine changes the scheduling policy of a block queue. This routine
+    assumes the queue lock is held or the queue is not yet published.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Policy - Supplies the new policy. This must not be the default policy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PBLOCK_REQUEST Request;
+    LIST_ENTRY WaitingList;
+
+    ASSERT((Policy == BlockQueuePolicyDeadline) ||
+           (Policy == BlockQueuePolicyNoop));
+
+    if (Queue->Policy == Policy) {
+        return;
+    }
+
+    Queue->Policy = Policy;
+    if (Policy == BlockQueuePolicyDeadline) {
+        Queue->MaxInFlight = BLOCK_QUEUE_DEADLINE_MAX_IN_FLIGHT;
+
+    } else {
+        Queue->MaxInFlight = BLOCK_QUEUE_NOOP_MAX_IN_FLIGHT;
+    }
+
+    //
+    // Reinsert any waiting requests in the order the new policy keeps them.
+    // Dispatches already out may exceed the new limit until they finish.
+    //
+
+    if (LIST_EMPTY(&(Queue->RequestListHead)) != FALSE) {
+        return;
+    }
+
+    MOVE_LIST(&(Queue->RequestListHead), &WaitingList);
+    INITIALIZE_LIST_HEAD(&(Queue->RequestListHead));
+    Queue->QueueDepth = 0;
+    while (LIST_EMPTY(&WaitingList) == FALSE) {
+        Request = LIST_VALUE(WaitingList.Next, BLOCK_REQUEST, ListEntry);
+        LIST_REMOVE(&(Request->ListEntry));
+        IopInsertBlockRequest(Queue, Request);
+    }
+
+    return;
+}
+
+KSTATUS
+IopDispatchBlockRequest (
+    PBLOCK_QUEUE Queue,
+    PDEVICE Device,
+    PBLOCK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends the given request to the device along with any
+    neighbors it can be merged with, completes those neighbors, and then
+    passes the dispatch slot on to the next request the policy selects. The
+    caller must own a dispatch slot.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Device - Supplies a pointer to the device.
+
+    Request - Supplies a pointer to the caller's request.
+
+Return Value:
+
+    Returns the completion status of the caller's request.
+
+--*/
+
+{
+
+    PBLOCK_REQUEST Batch[BLOCK_QUEUE_MAX_BATCH];
+    ULONG Count;
+    ULONG Index;
+    PBLOCK_REQUEST Next;
+
+    Batch[0] = Request;
+    KeAcquireQueuedLock(Queue->Lock);
+    if (Request->ListEntry.Next != NULL) {
+        LIST_REMOVE(&(Request->ListEntry));
+        Request->ListEntry.Next = NULL;
+        Queue->QueueDepth -= 1;
+    }
+
+    Count = IopGatherBlockRequests(Queue, Batch);
+    Queue->Dispatches += 1;
+    Queue->Merges += Count - 1;
+    KeReleaseQueuedLock(Queue->Lock);
+    IopSendBlockRequests(Device, Batch, Count);
+
+    //
+    // Wake the submitters of the merged requests, and then either hand the
+    // dispatch slot to the next request or give it back.
+    //
+
+    KeAcquireQueuedLock(Queue->Lock);
+    for (Index = 0; Index < Count; Index += 1) {
+        if (Batch[Index] != Request) {
+            Batch[Index]->State = BlockRequestComplete;
+            KeSignalEvent(Batch[Index]->Event, SignalOptionSignalAll);
+        }
+    }
+
+    //
+    // Pull the next request out of the queue as it is handed the slot, so
+    // that no other dispatcher can select it again or merge it into a batch
+    // before its submitter wakes up.
+    //
+
+    Next = IopSelectBlockRequest(Queue);
+    if ((Next != NULL) && (Queue->InFlight <= Queue->MaxInFlight)) {
+        LIST_REMOVE(&(Next->ListEntry));
+        Next->ListEntry.Next = NULL;
+        Queue->QueueDepth -= 1;
+        Next->State = BlockRequestDispatch;
+        KeSignalEvent(Next->Event, SignalOptionSignalAll);
+
+    } else {
+        Queue->InFlight -= 1;
+    }
+
+    KeReleaseQueuedLock(Queue->Lock);
+    return Request->Status;
+}
+
+VOID
+IopInsertBlockRequest (
+    PBLOCK_QUEUE Queue,
+    PBLOCK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a request to the queue. This routine assumes the queue
+    lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Request - Supplies a pointer to the request to add.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PBLOCK_REQUEST Entry;
+    IO_OFFSET Offset;
+
+    //
+    // The deadline policy keeps the list sorted by offset so the sweep can
+    // walk it in order. The no-op policy simply appends.
+    //
+
+    CurrentEntry = &(Queue->RequestListHead);
+    if (Queue->Policy == BlockQueuePolicyDeadline) {
+        Offset = Request->ReadWrite->IoOffset;
+        CurrentEntry = Queue->RequestListHead.Next;
+        while (CurrentEntry != &(Queue->RequestListHead)) {
+            Entry = LIST_VALUE(CurrentEntry, BLOCK_REQUEST, ListEntry);
+            if (Entry->ReadWrite->IoOffset > Offset) {
+                break;
+            }
+
+            CurrentEntry = CurrentEntry->Next;
+        }
+    }
+
+    INSERT_BEFORE(&(Request->ListEntry), CurrentEntry);
+    Queue->QueueDepth += 1;
+    if (Queue->QueueDepth > Queue->MaxQueueDepth) {
+        Queue->MaxQueueDepth = Queue->QueueDepth;
+    }
+
+    return;
+}
+
+PBLOCK_REQUEST
+IopSelectBlockRequest (
+    PBLOCK_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine selects the next request to dispatch according to the
+    queue's policy. This routine assumes the queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns a pointer to the next request to dispatch, or NULL if the queue is
+    empty. The request is left in the queue.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PBLOCK_REQUEST Entry;
+    PBLOCK_REQUEST Oldest;
+    PBLOCK_REQUEST Sweep;
+
+    if (LIST_EMPTY(&(Queue->RequestListHead)) != FALSE) {
+        return NULL;
+    }
+
+    if (Queue->Policy == BlockQueuePolicyNoop) {
+        return LIST_VALUE(Queue->RequestListHead.Next,
+                          BLOCK_REQUEST,
+                          ListEntry);
+    }
+
+    //
+    // Continue the sweep from where the head is, wrapping back to the lowest
+    // offset at the end of the disk. A request past its deadline trumps the
+    // sweep though.
+    //
+
+    Oldest = NULL;
+    Sweep = NULL;
+    CurrentEntry = Queue->RequestListHead.Next;
+    while (CurrentEntry != &(Queue->RequestListHead)) {
+        Entry = LIST_VALUE(CurrentEntry, BLOCK_REQUEST, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((Oldest == NULL) || (Entry->Deadline < Oldest->Deadline)) {
+            Oldest = Entry;
+        }
+
+        if ((Sweep == NULL) &&
+            (Entry->ReadWrite->IoOffset >= Queue->HeadOffset)) {
+
+            Sweep = Entry;
+        }
+    }
+
+    if (Oldest->Deadline <= KeGetRecentTimeCounter()) {
+        if (Oldest != Sweep) {
+            Queue->DeadlineExpirations += 1;
+        }
+
+        return Oldest;
+    }
+
+    if (Sweep == NULL) {
+        Sweep = LIST_VALUE(Queue->RequestListHead.Next,
+                           BLOCK_REQUEST,
+                           ListEntry);
+    }
+
+    return Sweep;
+}
+
+ULONG
+IopGatherBlockRequests (
+    PBLOCK_QUEUE Queue,
+    PBLOCK_REQUEST *Batch
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pulls the requests directly before and after the first
+    request in the batch out of the queue, as long as they can be merged
+    with it. This routine assumes the queue lock is held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Batch - Supplies a pointer to an array of BLOCK_QUEUE_MAX_BATCH requests.
+        On input, the first element contains the request being dispatched.
+        On output, contains the requests to send, sorted by offset.
+
+Return Value:
+
+    Returns the number of requests in the batch.
+
+--*/
+
+{
+
+    ULONG Count;
+    PLIST_ENTRY CurrentEntry;
+    IO_OFFSET End;
+    PBLOCK_REQUEST Entry;
+    BOOL Merged;
+    ULONG MoveIndex;
+    UINTN Size;
+    IO_OFFSET Start;
+
+    Count = 1;
+    if (Batch[0]->Mergeable == FALSE) {
+        Queue->HeadOffset = Batch[0]->ReadWrite->IoOffset +
+                            Batch[0]->ReadWrite->IoSizeInBytes;
+
+        return Count;
+    }
+
+    Start = Batch[0]->ReadWrite->IoOffset;
+    Size = Batch[0]->ReadWrite->IoSizeInBytes;
+    End = Start + Size;
+    Merged = TRUE;
+    while ((Merged != FALSE) && (Count < BLOCK_QUEUE_MAX_BATCH)) {
+        Merged = FALSE;
+        CurrentEntry = Queue->RequestListHead.Next;
+        while (CurrentEntry != &(Queue->RequestListHead)) {
+            Entry = LIST_VALUE(CurrentEntry, BLOCK_REQUEST, ListEntry);
+            CurrentEntry = CurrentEntry->Next;
+            if ((IopCanMergeBlockRequests(Batch[0], Entry) == FALSE) ||
+                ((Size + Entry->ReadWrite->IoSizeInBytes) >
+                 BLOCK_QUEUE_MAX_MERGE_SIZE)) {
+
+                continue;
+            }
+
+            if (Entry->ReadWrite->IoOffset == End) {
+                Batch[Count] = Entry;
+                End += Entry->ReadWrite->IoSizeInBytes;
+
+            } else if ((Entry->ReadWrite->IoOffset +
+                        Entry->ReadWrite->IoSizeInBytes) == Start) {
+
+                for (MoveIndex = Count; MoveIndex > 0; MoveIndex -= 1) {
+                    Batch[MoveIndex] = Batch[MoveIndex - 1];
+                }
+
+                Batch[0] = Entry;
+                Start = Entry->ReadWrite->IoOffset;
+
+            } else {
+                continue;
+            }
+
+            LIST_REMOVE(&(Entry->ListEntry));
+            Entry->ListEntry.Next = NULL;
+            Queue->QueueDepth -= 1;
+            Size += Entry->ReadWrite->IoSizeInBytes;
+            Count += 1;
+            Merged = TRUE;
+            break;
+        }
+    }
+
+    Queue->HeadOffset = End;
+    return Count;
+}
+
+VOID
+IopSendBlockRequests (
+    PDEVICE Device,
+    PBLOCK_REQUEST *Batch,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of contiguous requests to the device as a
+    single I/O request, and then splits the results back out. If the merged
+    request fails, the requests are retried individually so that each one
+    gets its own accurate status.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Batch - Supplies an array of requests, sorted by offset.
+
+    Count - Supplies the number of requests in the batch.
+
+Return Value:
+
+    None. The status and results are returned in each request.
+
+--*/
+
+{
+
+    UINTN Completed;
+    ULONG Index;
+    PIO_BUFFER IoBuffer;
+    IRP_READ_WRITE Merged;
+    IRP_MINOR_CODE MinorCode;
+    PIRP_READ_WRITE ReadWrite;
+    UINTN Size;
+    UINTN Start;
+    KSTATUS Status;
+
+    MinorCode = Batch[0]->MinorCode;
+    if (Count == 1) {
+        Batch[0]->Status = IopSendIoRequest(Device,
+                                            MinorCode,
+                                            Batch[0]->ReadWrite);
+
+        return;
+    }
+
+    //
+    // Stitch the requests' buffers together. Mergeable buffers are all backed
+    // by page cache entries, so their physical pages are pinned.
+    //
+
+    Size = 0;
+    for (Index = 0; Index < Count; Index += 1) {
+        Size += Batch[Index]->ReadWrite->IoSizeInBytes;
+    }
+
+    IoBuffer = MmAllocateUninitializedIoBuffer(Size, 0);
+    if (IoBuffer == NULL) {
+        goto SendBlockRequestsIndividually;
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        ReadWrite = Batch[Index]->ReadWrite;
+        Status = MmAppendIoBuffer(IoBuffer,
+                                  ReadWrite->IoBuffer,
+                                  0,
+                                  ReadWrite->IoSizeInBytes);
+
+        if (!KSUCCESS(Status)) {
+            MmFreeIoBuffer(IoBuffer);
+            goto SendBlockRequestsIndividually;
+        }
+    }
+
+    RtlCopyMemory(&Merged, Batch[0]->ReadWrite, sizeof(IRP_READ_WRITE));
+    Merged.IoBuffer = IoBuffer;
+    Merged.IoSizeInBytes = Size;
+    Merged.IoBytesCompleted = 0;
+    Merged.NewIoOffset = Merged.IoOffset;
+    Status = IopSendIoRequest(Device, MinorCode, &Merged);
+    MmFreeIoBuffer(IoBuffer);
+    if (!KSUCCESS(Status)) {
+        goto SendBlockRequestsIndividually;
+    }
+
+    //
+    // Hand each request its share of the bytes completed.
+    //
+
+    for (Index = 0; Index < Count; Index += 1) {
+        ReadWrite = Batch[Index]->ReadWrite;
+        Start = ReadWrite->IoOffset - Merged.IoOffset;
+        Completed = 0;
+        if (Merged.IoBytesCompleted > Start) {
+            Completed = Merged.IoBytesCompleted - Start;
+            if (Completed > ReadWrite->IoSizeInBytes) {
+                Completed = ReadWrite->IoSizeInBytes;
+            }
+        }
+
+        ReadWrite->IoBytesCompleted = Completed;
+        ReadWrite->NewIoOffset = ReadWrite->IoOffset + Completed;
+        Batch[Index]->Status = Status;
+    }
+
+    return;
+
+SendBlockRequestsIndividually:
+    for (Index = 0; Index < Count; Index += 1) {
+        Batch[Index]->Status = IopSendIoRequest(Device,
+                                                MinorCode,
+                                                Batch[Index]->ReadWrite);
+    }
+
+    return;
+}
+
+BOOL
+IopIsBlockRequestMergeable (
+    PIRP_READ_WRITE Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not a request's buffer can be merged
+    with others. Only page aligned buffers made entirely of page cache pages
+    qualify, since those pages stay put for the duration of the I/O.
+
+Arguments:
+
+    Request - Supplies a pointer to the I/O parameters.
+
+Return Value:
+
+    TRUE if the request can be merged.
+
+    FALSE if the request must be sent on its own.
+
+--*/
+
+{
+
+    PIO_BUFFER IoBuffer;
+    UINTN Offset;
+    ULONG PageSize;
+
+    IoBuffer = Request->IoBuffer;
+    PageSize = MmPageSize();
+    if ((IoBuffer == NULL) ||
+        (Request->IoSizeInBytes == 0) ||
+        (Request->IoSizeInBytes > BLOCK_QUEUE_MAX_MERGE_SIZE) ||
+        (Request->IoSizeInBytes > MmGetIoBufferSize(IoBuffer)) ||
+        (IS_ALIGNED(Request->IoOffset, PageSize) == FALSE) ||
+        (IS_ALIGNED(Request->IoSizeInBytes, PageSize) == FALSE) ||
+        (IS_ALIGNED(MmGetIoBufferCurrentOffset(IoBuffer), PageSize) ==
+         FALSE)) {
+
+        return FALSE;
+    }
+
+    for (Offset = 0; Offset < Request->IoSizeInBytes; Offset += PageSize) {
+        if (MmGetIoBufferPageCacheEntry(IoBuffer, Offset) == NULL) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOL
+IopCanMergeBlockRequests (
+    PBLOCK_REQUEST Request,
+    PBLOCK_REQUEST Candidate
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not two requests are compatible enough
+    to be sent as one, ignoring their offsets.
+
+Arguments:
+
+    Request - Supplies a pointer to the request being dispatched.
+
+    Candidate - Supplies a pointer to the request to potentially merge in.
+
+Return Value:
+
+    TRUE if the requests can be merged if they are adjacent.
+
+    FALSE if the requests can never be merged.
+
+--*/
+
+{
+
+    PIRP_READ_WRITE CandidateReadWrite;
+    PIRP_READ_WRITE ReadWrite;
+
+    if ((Candidate->Mergeable == FALSE) ||
+        (Candidate->MinorCode != Request->MinorCode)) {
+
+        return FALSE;
+    }
+
+    ReadWrite = Request->ReadWrite;
+    CandidateReadWrite = Candidate->ReadWrite;
+    if ((CandidateReadWrite->DeviceContext != ReadWrite->DeviceContext) ||
+        (CandidateReadWrite->IoFlags != ReadWrite->IoFlags) ||
+        (CandidateReadWrite->TimeoutInMilliseconds !=
+         ReadWrite->TimeoutInMilliseconds)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
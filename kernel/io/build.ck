@@ -39,6 +39,7 @@ function build() {
 
     baseSources = [
         "arb.c",
+        "blkqueue.c",
         "cachedio.c",
         "cstate.c",
         "device.c",
@@ -54,6 +55,7 @@ function build() {
         "intrface.c",
         "intrupt.c",
         "iobase.c",
+        "iocomp.c",
         "iohandle.c",
         "irp.c",
         "mount.c",
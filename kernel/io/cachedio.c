@@ -80,6 +80,11 @@ Structure Description:
 
     IoFlags - Stores the I/O flags from the request. See IO_FLAG_* definitions.
 
+    DelayAllocation - Stores a boolean indicating whether the file system has
+        reserved space for this write, allowing page cache misses to stay in
+        the cache until they are flushed rather than being written through to
+        allocate their blocks.
+
 --*/
 
 typedef struct _IO_WRITE_CONTEXT {
@@ -94,6 +99,7 @@ typedef struct _IO_WRITE_CONTEXT {
     ULONG BytesThisRound;
     ULONG PageByteOffset;
     ULONG IoFlags;
+    BOOL DelayAllocation;
 } IO_WRITE_CONTEXT, *PIO_WRITE_CONTEXT;
 
 //
@@ -851,6 +857,7 @@ Return Value:
     ULONG PageSize;
     UINTN SizeInBytes;
     KSTATUS Status;
+    BOOL UpdateFileSize;
     IO_WRITE_CONTEXT WriteContext;
     BOOL WriteOutNow;
 
@@ -873,6 +880,7 @@ Return Value:
     WriteContext.BytesCompleted = 0;
     WriteContext.CacheBuffer = NULL;
     WriteContext.IoFlags = IoContext->Flags;
+    WriteContext.DelayAllocation = FALSE;
     PageSize = MmPageSize();
     SizeInBytes = IoContext->SizeInBytes;
     WriteOutNow = FALSE;
@@ -946,6 +954,33 @@ Return Value:
 
     FileSize = FileObject->Properties.Size;
 
+    //
+    // If the file system supports delayed allocation, reserve space for the
+    // part of the write that extends the file and leave the data in the cache.
+    // The blocks get assigned when the dirty pages are flushed, which lets
+    // the file system allocate whole runs at once. Writes that start beyond
+    // the end of the file still go through immediately so the file system
+    // fills the gap.
+    //
+
+    if (((FileObject->Flags & FILE_OBJECT_FLAG_DELAYED_ALLOCATION) != 0) &&
+        (IO_IS_CACHEABLE_FILE(FileObject->Properties.Type)) &&
+        (IoContext->Offset <= FileSize)) {
+
+        EndOffset = IoContext->Offset + SizeInBytes;
+        if (EndOffset > FileSize) {
+            Status = IopReserveFileObjectSpace(FileObject,
+                                               FileSize,
+                                               EndOffset - FileSize);
+
+            if (!KSUCCESS(Status)) {
+                goto PerformCachedWriteEnd;
+            }
+        }
+
+        WriteContext.DelayAllocation = TRUE;
+    }
+
     //
     // Iterate over each page, searching for page cache entries to copy into.
     //
@@ -994,18 +1029,7 @@ Return Value:
                 goto PerformCachedWriteEnd;
             }
 
-            //
-            // Hits need to update the file size so that future misses don't
-            // hit the file size and end up zeroing this region.
-            //
-
-            NewFileSize = WriteContext.FileOffset +
-                          WriteContext.PageByteOffset +
-                          WriteContext.BytesThisRound;
-
-            if (NewFileSize > FileSize) {
-                IopUpdateFileObjectFileSize(FileObject, NewFileSize);
-            }
+            UpdateFileSize = TRUE;
 
         //
         // If no page cache entry was found at this file offset, then handle
@@ -1021,8 +1045,36 @@ Return Value:
                 goto PerformCachedWriteEnd;
             }
 
+            //
+            // Misses on cacheable files are written through so the file
+            // system allocates their blocks, unless space was reserved for
+            // them. The write through updates the file size.
+            //
+
+            UpdateFileSize = FALSE;
             if (IO_IS_CACHEABLE_FILE(FileObject->Properties.Type)) {
-                WriteOutNow = TRUE;
+                if (WriteContext.DelayAllocation != FALSE) {
+                    UpdateFileSize = TRUE;
+
+                } else {
+                    WriteOutNow = TRUE;
+                }
+            }
+        }
+
+        //
+        // Data that stays in the cache needs to update the file size so that
+        // future misses don't hit the file size and end up zeroing this
+        // region.
+        //
+
+        if (UpdateFileSize != FALSE) {
+            NewFileSize = WriteContext.FileOffset +
+                          WriteContext.PageByteOffset +
+                          WriteContext.BytesThisRound;
+
+            if (NewFileSize > FileSize) {
+                IopUpdateFileObjectFileSize(FileObject, NewFileSize);
             }
         }
 
@@ -1377,10 +1429,12 @@ Return Value:
     // This page cache entry was created or read, so if it's a cacheable file
     // type, it will need to go down through the file system to ensure
     // there's disk space allocated to it. Create a cache buffer if one
-    // has not been created yet.
+    // has not been created yet. Skip this if the file system already reserved
+    // the space; the blocks are assigned when the entry is flushed.
     //
 
-    if (IO_IS_CACHEABLE_FILE(FileObject->Properties.Type)) {
+    if ((IO_IS_CACHEABLE_FILE(FileObject->Properties.Type)) &&
+        (WriteContext->DelayAllocation == FALSE)) {
         if (WriteContext->CacheBuffer == NULL) {
             CacheBufferSize = WriteContext->PageByteOffset +
                               WriteContext->BytesRemaining;
@@ -107,6 +107,12 @@ IopGetUniqueDeviceId (
     PCSTR DeviceId
     );
 
+VOID
+IopRecordDeviceTimeline (
+    PDEVICE Device,
+    KSTATUS Status
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -131,6 +137,15 @@ PQUEUED_LOCK IoDeviceListLock;
 
 UINTN IoDeviceWorkItemsQueued;
 
+//
+// Store the device start timeline and the lock that protects it.
+//
+
+PQUEUED_LOCK IoDeviceTimelineLock;
+IO_DEVICE_TIMELINE_ENTRY IoDeviceTimeline[IO_DEVICE_TIMELINE_SIZE];
+ULONG IoDeviceTimelineCount;
+ULONG IoDeviceTimelineDropped;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -1686,6 +1701,7 @@ Return Value:
     PDEVICE_WORK_ENTRY NewEntry;
     BOOL NewWorkItemNeeded;
     DEVICE_QUEUE_STATE OldQueueState;
+    WORK_PRIORITY Priority;
     BOOL Result;
     KSTATUS Status;
 
@@ -1796,9 +1812,26 @@ Return Value:
     //
 
     if (NewWorkItemNeeded != FALSE) {
+
+        //
+        // The device work queue has several workers, so devices in different
+        // subtrees are processed concurrently. Ordering between dependent
+        // devices is preserved because each device has at most one work item
+        // in flight, and a child is only reported (and so only gets work)
+        // once its parent has started. Move storage along ahead of everything
+        // else so that the boot volume shows up as soon as possible.
+        //
+
+        Priority = WorkPriorityNormal;
+        if (((Device->Flags & DEVICE_FLAG_MOUNTABLE) != 0) ||
+            (Device->Header.Type == ObjectVolume)) {
+
+            Priority = WorkPriorityHigh;
+        }
+
         RtlAtomicAdd(&IoDeviceWorkItemsQueued, 1);
         Status = KeCreateAndQueueWorkItem(IoDeviceWorkQueue,
-                                          WorkPriorityNormal,
+                                          Priority,
                                           IopDeviceWorker,
                                           Device);
 
@@ -2015,6 +2048,14 @@ Return Value:
     Device->ProblemState.File = SourceFile;
     Device->ProblemState.Line = LineNumber;
 
+    //
+    // If the device was on its way to starting, record the failed attempt.
+    //
+
+    if (Device->StartTime != 0) {
+        IopRecordDeviceTimeline(Device, Status);
+    }
+
     //
     // Signal anyone waiting on the device. They were queued up waiting for it
     // to complete a state transition. It failed to do so; let them check the
@@ -2053,6 +2094,79 @@ Return Value:
     return;
 }
 
+KSTATUS
+IopGetDeviceTimeline (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the device start timeline.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the timeline is
+        returned, an IO_DEVICE_TIMELINE structure.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if the buffer cannot hold every entry.
+
+    STATUS_ACCESS_DENIED if this is a set operation.
+
+--*/
+
+{
+
+    ULONG EntryCount;
+    UINTN RequiredSize;
+    KSTATUS Status;
+    PIO_DEVICE_TIMELINE Timeline;
+
+    if (Set != FALSE) {
+        *DataSize = 0;
+        return STATUS_ACCESS_DENIED;
+    }
+
+    KeAcquireQueuedLock(IoDeviceTimelineLock);
+    EntryCount = IoDeviceTimelineCount;
+    RequiredSize = FIELD_OFFSET(IO_DEVICE_TIMELINE, Entries) +
+                   (EntryCount * sizeof(IO_DEVICE_TIMELINE_ENTRY));
+
+    if (*DataSize < RequiredSize) {
+        Status = STATUS_BUFFER_TOO_SMALL;
+        goto GetDeviceTimelineEnd;
+    }
+
+    Timeline = Data;
+    Timeline->Version = IO_DEVICE_TIMELINE_VERSION;
+    Timeline->EntryCount = EntryCount;
+    Timeline->DroppedCount = IoDeviceTimelineDropped;
+    Timeline->Frequency = HlQueryTimeCounterFrequency();
+    RtlCopyMemory(Timeline->Entries,
+                  IoDeviceTimeline,
+                  EntryCount * sizeof(IO_DEVICE_TIMELINE_ENTRY));
+
+    Status = STATUS_SUCCESS;
+
+GetDeviceTimelineEnd:
+    KeReleaseQueuedLock(IoDeviceTimelineLock);
+    *DataSize = RequiredSize;
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2340,6 +2454,15 @@ Return Value:
     IRP_START_DEVICE StartDevice;
     KSTATUS Status;
 
+    //
+    // Note when the device begins its trip to the started state for the
+    // timeline. Retries after a problem begin a new trip.
+    //
+
+    if ((Device->StartTime == 0) && (Device->State == DeviceInitialized)) {
+        Device->StartTime = HlQueryTimeCounter();
+    }
+
     //
     // Loop until a resting state is achieved.
     //
@@ -2474,6 +2597,7 @@ Return Value:
 
         case DeviceEnumerated:
             IopSetDeviceState(Device, DeviceStarted);
+            IopRecordDeviceTimeline(Device, STATUS_SUCCESS);
             if (((Device->Flags & DEVICE_FLAG_MOUNTABLE) != 0) &&
                 ((Device->Flags & DEVICE_FLAG_MOUNTED) == 0)) {
 
@@ -2491,7 +2615,7 @@ Return Value:
             if (Device->Header.Type == ObjectVolume) {
                 ObAddReference(Device);
                 Status = KeCreateAndQueueWorkItem(IoDeviceWorkQueue,
-                                                  WorkPriorityNormal,
+                                                  WorkPriorityHigh,
                                                   IopVolumeArrival,
                                                   Device);
 
@@ -3118,3 +3242,59 @@ Return Value:
     return NewDeviceId;
 }
 
+VOID
+IopRecordDeviceTimeline (
+    PDEVICE Device,
+    KSTATUS Status
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records the end of an attempt to start a device in the device
+    timeline.
+
+Arguments:
+
+    Device - Supplies a pointer to the device that finished starting.
+
+    Status - Supplies the result of the start attempt.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG EndTime;
+    PIO_DEVICE_TIMELINE_ENTRY Entry;
+
+    if (Device->StartTime == 0) {
+        return;
+    }
+
+    EndTime = HlQueryTimeCounter();
+    KeAcquireQueuedLock(IoDeviceTimelineLock);
+    if (IoDeviceTimelineCount < IO_DEVICE_TIMELINE_SIZE) {
+        Entry = &(IoDeviceTimeline[IoDeviceTimelineCount]);
+        Entry->DeviceId = Device->DeviceId;
+        Entry->StartTime = Device->StartTime;
+        Entry->EndTime = EndTime;
+        Entry->Status = Status;
+        RtlStringCopy(Entry->Name,
+                      Device->Header.Name,
+                      IO_DEVICE_TIMELINE_NAME_SIZE);
+
+        IoDeviceTimelineCount += 1;
+
+    } else {
+        IoDeviceTimelineDropped += 1;
+    }
+
+    KeReleaseQueuedLock(IoDeviceTimelineLock);
+    Device->StartTime = 0;
+    return;
+}
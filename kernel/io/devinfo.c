@@ -278,6 +278,15 @@ Return Value:
         return STATUS_NO_INTERFACE;
     }
 
+    //
+    // The block request queue lives in the kernel, not in the device's
+    // driver stack, so answer for it directly.
+    //
+
+    if (RtlAreUuidsEqual(Uuid, &IoBlockQueueInformationUuid) != FALSE) {
+        return IopGetSetBlockQueueInformation(Device, Data, DataSize, Set);
+    }
+
     RtlZeroMemory(&Request, sizeof(SYSTEM_CONTROL_DEVICE_INFORMATION));
     RtlCopyMemory(&(Request.Uuid), Uuid, sizeof(UUID));
     Request.Data = Data;
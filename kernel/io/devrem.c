@@ -706,6 +706,7 @@ Return Value:
     //
 
     PmpDestroyDevice(Device);
+    IopDestroyBlockQueue(Device);
 
     //
     // Delete the arbiter list and the various resource lists.
@@ -2174,6 +2174,157 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+IopPreallocateFileObject (
+    PFILE_OBJECT FileObject,
+    PVOID DeviceContext,
+    ULONGLONG AllocationSize,
+    BOOL KeepSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the file system to allocate disk space for the given
+    file object up to the given size. If the file is smaller than the
+    allocation and the caller did not ask to keep the size, the file size is
+    extended to match.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object to allocate space for.
+
+    DeviceContext - Supplies an optional pointer to the device context to use
+        when doing file operations. Not every file object has a built-in device
+        context.
+
+    AllocationSize - Supplies the number of bytes, starting at the beginning of
+        the file, that should have disk space allocated.
+
+    KeepSize - Supplies a boolean indicating whether the file size should be
+        left alone (TRUE) or extended to the allocation size if it is smaller
+        (FALSE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the file system cannot allocate space.
+
+    STATUS_VOLUME_FULL if there is not enough free space.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    BOOL Extend;
+    SYSTEM_CONTROL_ALLOCATE Request;
+    KSTATUS Status;
+
+    Extend = FALSE;
+    KeAcquireSharedExclusiveLockExclusive(FileObject->Lock);
+
+    //
+    // Shared memory objects have no backing store to reserve, so only the
+    // size needs handling.
+    //
+
+    if (FileObject->Properties.Type == IoObjectSharedMemoryObject) {
+        Status = STATUS_SUCCESS;
+
+    } else {
+        if (DeviceContext == NULL) {
+            DeviceContext = FileObject->DeviceContext;
+        }
+
+        Request.FileProperties = &(FileObject->Properties);
+        Request.DeviceContext = DeviceContext;
+        Request.Offset = 0;
+        Request.Size = AllocationSize;
+        Request.Flags = 0;
+        Status = IopSendSystemControlIrp(FileObject->Device,
+                                         IrpMinorSystemControlAllocate,
+                                         &Request);
+
+        if (Status == STATUS_NOT_HANDLED) {
+            Status = STATUS_NOT_SUPPORTED;
+        }
+    }
+
+    if ((KSUCCESS(Status)) &&
+        (KeepSize == FALSE) &&
+        (AllocationSize > FileObject->Properties.Size)) {
+
+        Extend = TRUE;
+    }
+
+    KeReleaseSharedExclusiveLockExclusive(FileObject->Lock);
+    if (Extend != FALSE) {
+        Status = IopModifyFileObjectSize(FileObject,
+                                         DeviceContext,
+                                         AllocationSize);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopReserveFileObjectSpace (
+    PFILE_OBJECT FileObject,
+    ULONGLONG Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the file system to reserve space for a region of a file
+    that is about to be written into the page cache. The blocks themselves are
+    assigned when the page cache entries are flushed. This routine assumes the
+    file object lock is held exclusively.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object being written.
+
+    Offset - Supplies the file offset where the region begins.
+
+    Size - Supplies the size of the region, in bytes.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    SYSTEM_CONTROL_ALLOCATE Request;
+    KSTATUS Status;
+
+    ASSERT(KeIsSharedExclusiveLockHeldExclusive(FileObject->Lock) != FALSE);
+    ASSERT((FileObject->Flags & FILE_OBJECT_FLAG_DELAYED_ALLOCATION) != 0);
+
+    Request.FileProperties = &(FileObject->Properties);
+    Request.DeviceContext = FileObject->DeviceContext;
+    Request.Offset = Offset;
+    Request.Size = Size;
+    Request.Flags = SYSTEM_CONTROL_ALLOCATE_FLAG_RESERVE;
+    Status = IopSendSystemControlIrp(FileObject->Device,
+                                     IrpMinorSystemControlAllocate,
+                                     &Request);
+
+    if (Status == STATUS_NOT_HANDLED) {
+        Status = STATUS_NOT_SUPPORTED;
+    }
+
+    return Status;
+}
+
 VOID
 IopFileObjectIncrementHardLinkCount (
     PFILE_OBJECT FileObject
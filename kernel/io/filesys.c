@@ -116,6 +116,13 @@ LIST_ENTRY IoFileSystemList;
 
 PQUEUED_LOCK IoFileSystemListLock = NULL;
 
+//
+// This lock serializes picking a volume name with creating the volume, since
+// disks may be started concurrently.
+//
+
+PQUEUED_LOCK IoVolumeNameLock = NULL;
+
 //
 // Store a pointer to the volumes directory and the number of volumes in the
 // system.
@@ -324,11 +331,14 @@ Return Value:
     TargetAttached = FALSE;
 
     //
-    // Allocate the next available name for the volume.
+    // Allocate the next available name for the volume. The name lock is held
+    // until the volume exists so no other volume can pick the same name.
     //
 
+    KeAcquireQueuedLock(IoVolumeNameLock);
     NewName = IopGetNewVolumeName();
     if (NewName == NULL) {
+        KeReleaseQueuedLock(IoVolumeNameLock);
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto CreateVolumeEnd;
     }
@@ -347,6 +357,7 @@ Return Value:
                              sizeof(VOLUME),
                              (PDEVICE *)&NewVolume);
 
+    KeReleaseQueuedLock(IoVolumeNameLock);
     if (!KSUCCESS(Status)) {
         goto CreateVolumeEnd;
     }
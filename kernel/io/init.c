@@ -145,6 +145,12 @@ Return Value:
         goto InitializeEnd;
     }
 
+    IoDeviceTimelineLock = KeCreateQueuedLock();
+    if (IoDeviceTimelineLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeEnd;
+    }
+
     //
     // Copy the boot information over.
     //
@@ -261,6 +267,12 @@ Return Value:
         goto InitializeEnd;
     }
 
+    IoVolumeNameLock = KeCreateQueuedLock();
+    if (IoVolumeNameLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeEnd;
+    }
+
     //
     // Create the volume directory.
     //
@@ -425,15 +437,48 @@ Return Value:
 {
 
     KSTATUS Status;
+    ULONG ThreadCount;
     ULONG WorkQueueFlags;
 
+    //
+    // Service the device work queue with a pool of workers so that
+    // independent device subtrees can be started concurrently. Work on any
+    // one device is still serialized by its own device queue.
+    //
+
+    ThreadCount = KeGetActiveProcessorCount();
+    if (ThreadCount < IO_DEVICE_WORKER_THREAD_MIN) {
+        ThreadCount = IO_DEVICE_WORKER_THREAD_MIN;
+
+    } else if (ThreadCount > IO_DEVICE_WORKER_THREAD_MAX) {
+        ThreadCount = IO_DEVICE_WORKER_THREAD_MAX;
+    }
+
     WorkQueueFlags = WORK_QUEUE_FLAG_SUPPORT_DISPATCH_LEVEL;
-    IoDeviceWorkQueue = KeCreateWorkQueue(WorkQueueFlags, "IoDeviceWorker");
+    IoDeviceWorkQueue = KeCreateMultiThreadedWorkQueue(WorkQueueFlags,
+                                                       "IoDeviceWorker",
+                                                       ThreadCount);
+
     if (IoDeviceWorkQueue == NULL) {
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto InitializeDeviceSupportEnd;
     }
 
+    //
+    // Asynchronous IRPs completed from DPCs are finished off by workers that
+    // can be woken from dispatch level. Give each processor one.
+    //
+
+    ThreadCount = KeGetActiveProcessorCount();
+    IoIrpWorkQueue = KeCreateMultiThreadedWorkQueue(WorkQueueFlags,
+                                                    "IoIrpWorker",
+                                                    ThreadCount);
+
+    if (IoIrpWorkQueue == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeDeviceSupportEnd;
+    }
+
     //
     // Create and initialize the root device.
     //
@@ -114,6 +114,11 @@ IopFixMountPointDirectoryEntries (
     UINTN BufferSize
     );
 
+ULONG
+IopTranslateLookupFlags (
+    ULONG LookupFlags
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -1184,6 +1189,7 @@ Return Value:
 
 {
 
+    BOOL Allocate;
     ULONG FieldsToSet;
     PFILE_OBJECT FileObject;
     BOOL FileOwner;
@@ -1313,10 +1319,32 @@ Return Value:
     }
 
     //
-    // Truncating a file requires the caller to be able to write to it.
+    // The keep size field only modifies an allocation, and an allocation
+    // cannot also set the file size.
+    //
+
+    if ((FieldsToSet & FILE_PROPERTY_FIELD_KEEP_SIZE) != 0) {
+        if ((FieldsToSet & FILE_PROPERTY_FIELD_ALLOCATION) == 0) {
+            Status = STATUS_INVALID_PARAMETER;
+            goto SetFileInformationEnd;
+        }
+    }
+
+    if (((FieldsToSet & FILE_PROPERTY_FIELD_ALLOCATION) != 0) &&
+        ((FieldsToSet & FILE_PROPERTY_FIELD_FILE_SIZE) != 0)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto SetFileInformationEnd;
+    }
+
+    //
+    // Truncating or allocating space for a file requires the caller to be
+    // able to write to it.
     //
 
-    if ((FieldsToSet & FILE_PROPERTY_FIELD_FILE_SIZE) != 0) {
+    if (((FieldsToSet & FILE_PROPERTY_FIELD_FILE_SIZE) != 0) ||
+        ((FieldsToSet & FILE_PROPERTY_FIELD_ALLOCATION) != 0)) {
+
         Status = IopCheckPermissions(FromKernelMode,
                                      &(Handle->PathPoint),
                                      IO_ACCESS_WRITE);
@@ -1326,6 +1354,7 @@ Return Value:
         }
     }
 
+    Allocate = FALSE;
     ModifyFileSize = FALSE;
     NewFileSize = 0;
     if (FieldsToSet != 0) {
@@ -1454,6 +1483,21 @@ Return Value:
             NewFileSize = FileProperties->Size;
         }
 
+        if ((FieldsToSet & FILE_PROPERTY_FIELD_ALLOCATION) != 0) {
+            switch (FileObject->Properties.Type) {
+            case IoObjectRegularFile:
+            case IoObjectSharedMemoryObject:
+                break;
+
+            default:
+                Status = STATUS_PERMISSION_DENIED;
+                goto SetFileInformationEnd;
+            }
+
+            Allocate = TRUE;
+            NewFileSize = FileProperties->Size;
+        }
+
     } else {
         RtlCopyMemory(FileProperties,
                       &(FileObject->Properties),
@@ -1496,6 +1540,18 @@ Return Value:
         }
     }
 
+    if (Allocate != FALSE) {
+        Status = IopPreallocateFileObject(
+                          FileObject,
+                          Handle->DeviceContext,
+                          NewFileSize,
+                          (FieldsToSet & FILE_PROPERTY_FIELD_KEEP_SIZE) != 0);
+
+        if (!KSUCCESS(Status)) {
+            goto SetFileInformationEnd;
+        }
+    }
+
     if (Updated != FALSE) {
         IopMarkFileObjectPropertiesDirty(FileObject);
     }
@@ -4319,15 +4375,7 @@ Return Value:
                                      IrpMinorSystemControlLookup,
                                      &Request);
 
-    *Flags = 0;
-    if ((Request.Flags & LOOKUP_FLAG_NO_PAGE_CACHE) != 0) {
-        *Flags |= FILE_OBJECT_FLAG_NO_PAGE_CACHE;
-    }
-
-    if ((Request.Flags & LOOKUP_FLAG_NON_PAGED_IO_STATE) != 0) {
-        *Flags |= FILE_OBJECT_FLAG_NON_PAGED_IO_STATE;
-    }
-
+    *Flags = IopTranslateLookupFlags(Request.Flags);
     *MapFlags = Request.MapFlags;
     return Status;
 }
@@ -4338,7 +4386,8 @@ IopSendCreateRequest (
     PFILE_OBJECT Directory,
     PCSTR Name,
     ULONG NameSize,
-    PFILE_PROPERTIES Properties
+    PFILE_PROPERTIES Properties,
+    PULONG Flags
     )
 
 /*++
@@ -4366,6 +4415,9 @@ Routine Description:
         on success. The permissions, object type, user ID, group ID, and access
         times are all valid from the system.
 
+    Flags - Supplies a pointer where the translated file object flags will be
+        returned. See FILE_OBJECT_FLAG_* definitions.
+
 Return Value:
 
     Status code.
@@ -4396,6 +4448,8 @@ Return Value:
                   &(Request.FileProperties),
                   sizeof(FILE_PROPERTIES));
 
+    *Flags = IopTranslateLookupFlags(Request.Flags);
+
     //
     // Update the access time and modified time if file was created.
     //
@@ -6024,3 +6078,51 @@ Return Value:
     return;
 }
 
+ULONG
+IopTranslateLookupFlags (
+    ULONG LookupFlags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts the flags a file system returns from a lookup or
+    create request into file object flags.
+
+Arguments:
+
+    LookupFlags - Supplies the bitmask of flags returned by the file system.
+        See LOOKUP_FLAG_* definitions.
+
+Return Value:
+
+    Returns the corresponding file object flags. See FILE_OBJECT_FLAG_*
+    definitions.
+
+--*/
+
+{
+
+    ULONG Flags;
+
+    Flags = 0;
+    if ((LookupFlags & LOOKUP_FLAG_NO_PAGE_CACHE) != 0) {
+        Flags |= FILE_OBJECT_FLAG_NO_PAGE_CACHE;
+    }
+
+    if ((LookupFlags & LOOKUP_FLAG_NON_PAGED_IO_STATE) != 0) {
+        Flags |= FILE_OBJECT_FLAG_NON_PAGED_IO_STATE;
+    }
+
+    if ((LookupFlags & LOOKUP_FLAG_HARD_FLUSH_REQUIRED) != 0) {
+        Flags |= FILE_OBJECT_FLAG_HARD_FLUSH_REQUIRED;
+    }
+
+    if ((LookupFlags & LOOKUP_FLAG_DELAYED_ALLOCATION) != 0) {
+        Flags |= FILE_OBJECT_FLAG_DELAYED_ALLOCATION;
+    }
+
+    return Flags;
+}
+
@@ -0,0 +1,848 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    iocomp.c
+
+Abstract:
+
+    This module implements I/O completion queues and asynchronous direct I/O.
+    A caller submits any number of reads and writes against a handle and
+    collects their results from a completion queue later. Block aligned I/O to
+    block devices opened without the page cache is sent straight to the
+    device as asynchronous IRPs, so the number of requests in flight is bounded
+    by the hardware rather than by the number of waiting threads.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define IO_COMPLETION_ALLOCATION_TAG 0x706D6F43 // 'pmoC'
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines an I/O completion queue.
+
+Members:
+
+    ReferenceCount - Stores the reference count on the queue. The owner holds
+        one reference, and each outstanding request holds another.
+
+    Lock - Stores a pointer to the lock protecting the completion list.
+
+    CompletionListHead - Stores the head of the list of completed requests
+        waiting to be collected. See IO_ASYNC_REQUEST.
+
+    Event - Stores a pointer to the event that is signaled while the
+        completion list is not empty.
+
+--*/
+
+struct _IO_COMPLETION_QUEUE {
+    volatile ULONG ReferenceCount;
+    PQUEUED_LOCK Lock;
+    LIST_ENTRY CompletionListHead;
+    PKEVENT Event;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines an asynchronous I/O request.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous completed requests
+        in the completion queue.
+
+    Queue - Stores a pointer to the completion queue the request reports to.
+
+    Handle - Stores a pointer to the I/O handle the request was made on. A
+        reference is held on the handle until the request completes.
+
+    Completion - Stores the results that are handed back to the caller.
+
+--*/
+
+typedef struct _IO_ASYNC_REQUEST {
+    LIST_ENTRY ListEntry;
+    PIO_COMPLETION_QUEUE Queue;
+    PIO_HANDLE Handle;
+    IO_COMPLETION Completion;
+} IO_ASYNC_REQUEST, *PIO_ASYNC_REQUEST;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+BOOL
+IopCanSendAsynchronousIrp (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    UINTN SizeInBytes
+    );
+
+KSTATUS
+IopSendAsynchronousIoIrp (
+    PIO_ASYNC_REQUEST Request,
+    PIO_BUFFER IoBuffer,
+    IO_OFFSET Offset,
+    UINTN SizeInBytes,
+    ULONG Flags,
+    BOOL Write
+    );
+
+VOID
+IopAsynchronousIoIrpCompletion (
+    PIRP Irp,
+    PVOID Context
+    );
+
+VOID
+IopPostAsynchronousIo (
+    PIO_ASYNC_REQUEST Request
+    );
+
+VOID
+IopCompletionQueueAddReference (
+    PIO_COMPLETION_QUEUE Queue
+    );
+
+VOID
+IopCompletionQueueReleaseReference (
+    PIO_COMPLETION_QUEUE Queue
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KERNEL_API
+PIO_COMPLETION_QUEUE
+IoCreateCompletionQueue (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an I/O completion queue, which collects the results of
+    asynchronous I/O requests.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the new completion queue on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PIO_COMPLETION_QUEUE Queue;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Queue = MmAllocatePagedPool(sizeof(IO_COMPLETION_QUEUE),
+                                IO_COMPLETION_ALLOCATION_TAG);
+
+    if (Queue == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateCompletionQueueEnd;
+    }
+
+    RtlZeroMemory(Queue, sizeof(IO_COMPLETION_QUEUE));
+    Queue->ReferenceCount = 1;
+    INITIALIZE_LIST_HEAD(&(Queue->CompletionListHead));
+    Queue->Lock = KeCreateQueuedLock();
+    if (Queue->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateCompletionQueueEnd;
+    }
+
+    Queue->Event = KeCreateEvent(NULL);
+    if (Queue->Event == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateCompletionQueueEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+CreateCompletionQueueEnd:
+    if (!KSUCCESS(Status)) {
+        if (Queue != NULL) {
+            if (Queue->Lock != NULL) {
+                KeDestroyQueuedLock(Queue->Lock);
+            }
+
+            MmFreePagedPool(Queue);
+            Queue = NULL;
+        }
+    }
+
+    return Queue;
+}
+
+KERNEL_API
+VOID
+IoDestroyCompletionQueue (
+    PIO_COMPLETION_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys an I/O completion queue. Requests still in flight
+    keep the queue alive until they complete, and their results are then
+    discarded. The I/O buffers of those requests must remain valid until then.
+
+Arguments:
+
+    Queue - Supplies a pointer to the completion queue to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    IopCompletionQueueReleaseReference(Queue);
+    return;
+}
+
+KERNEL_API
+KSTATUS
+IoSubmitAsynchronousIo (
+    PIO_HANDLE Handle,
+    PIO_BUFFER IoBuffer,
+    IO_OFFSET Offset,
+    UINTN SizeInBytes,
+    ULONG Flags,
+    BOOL Write,
+    PIO_COMPLETION_QUEUE Queue,
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts a read or write on an I/O handle and returns without
+    waiting for it. When the I/O finishes, its results are posted to the given
+    completion queue along with the supplied context. Block aligned I/O to a
+    block device opened without the page cache is sent directly to the device
+    and completes from the driver. Any other I/O is performed synchronously
+    before this routine returns, and its result is posted all the same.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    IoBuffer - Supplies a pointer to the I/O buffer to read into or write
+        from. This buffer must stay valid until the completion is posted.
+
+    Offset - Supplies the offset from the beginning of the file or device where
+        the I/O should be done.
+
+    SizeInBytes - Supplies the number of bytes to read or write.
+
+    Flags - Supplies flags regarding the I/O operation. See IO_FLAG_*
+        definitions.
+
+    Write - Supplies a boolean indicating whether this is a read (FALSE) or a
+        write (TRUE).
+
+    Queue - Supplies a pointer to the completion queue to post the result to.
+
+    Context - Supplies an opaque pointer that is returned with the completion.
+
+Return Value:
+
+    STATUS_SUCCESS if the request was started. Its result, successful or not,
+    is delivered through the completion queue.
+
+    Other error codes if the request could not be started. Nothing is posted to
+    the completion queue in this case.
+
+--*/
+
+{
+
+    PIO_ASYNC_REQUEST Request;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Request = NULL;
+    if ((Handle->HandleType == IoHandleTypePaging) ||
+        ((Flags & IO_FLAG_NO_ALLOCATE) != 0)) {
+
+        Status = STATUS_NOT_SUPPORTED;
+        goto SubmitAsynchronousIoEnd;
+    }
+
+    if (Write != FALSE) {
+        if ((Handle->Access & IO_ACCESS_WRITE) == 0) {
+            Status = STATUS_INVALID_HANDLE;
+            goto SubmitAsynchronousIoEnd;
+        }
+
+    } else {
+        if ((Handle->Access & (IO_ACCESS_READ | IO_ACCESS_EXECUTE)) == 0) {
+            Status = STATUS_INVALID_HANDLE;
+            goto SubmitAsynchronousIoEnd;
+        }
+    }
+
+    Request = MmAllocatePagedPool(sizeof(IO_ASYNC_REQUEST),
+                                  IO_COMPLETION_ALLOCATION_TAG);
+
+    if (Request == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SubmitAsynchronousIoEnd;
+    }
+
+    RtlZeroMemory(Request, sizeof(IO_ASYNC_REQUEST));
+    Request->Queue = Queue;
+    Request->Handle = Handle;
+    Request->Completion.Context = Context;
+    IopCompletionQueueAddReference(Queue);
+    IoIoHandleAddReference(Handle);
+
+    //
+    // Send the I/O straight to the device if possible. Failing to start the
+    // IRP is reported to the caller directly.
+    //
+
+    if (IopCanSendAsynchronousIrp(Handle, Offset, SizeInBytes) != FALSE) {
+        Status = IopSendAsynchronousIoIrp(Request,
+                                          IoBuffer,
+                                          Offset,
+                                          SizeInBytes,
+                                          Flags,
+                                          Write);
+
+        if (!KSUCCESS(Status)) {
+            IoIoHandleReleaseReference(Handle);
+            IopCompletionQueueReleaseReference(Queue);
+            goto SubmitAsynchronousIoEnd;
+        }
+
+        Request = NULL;
+        goto SubmitAsynchronousIoEnd;
+    }
+
+    //
+    // Everything else goes through the regular I/O path in this thread.
+    //
+
+    if (Write != FALSE) {
+        Status = IoWriteAtOffset(Handle,
+                                 IoBuffer,
+                                 Offset,
+                                 SizeInBytes,
+                                 Flags,
+                                 WAIT_TIME_INDEFINITE,
+                                 &(Request->Completion.BytesCompleted),
+                                 NULL);
+
+    } else {
+        Status = IoReadAtOffset(Handle,
+                                IoBuffer,
+                                Offset,
+                                SizeInBytes,
+                                Flags,
+                                WAIT_TIME_INDEFINITE,
+                                &(Request->Completion.BytesCompleted),
+                                NULL);
+    }
+
+    Request->Completion.Status = Status;
+    IopPostAsynchronousIo(Request);
+    Request = NULL;
+    Status = STATUS_SUCCESS;
+
+SubmitAsynchronousIoEnd:
+    if (Request != NULL) {
+        MmFreePagedPool(Request);
+    }
+
+    return Status;
+}
+
+KERNEL_API
+KSTATUS
+IoGetQueuedCompletions (
+    PIO_COMPLETION_QUEUE Queue,
+    PIO_COMPLETION Completions,
+    UINTN Count,
+    ULONG TimeoutInMilliseconds,
+    PUINTN CompletionCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine collects the results of finished asynchronous I/O requests
+    from a completion queue, waiting for at least one if none are ready.
+
+Arguments:
+
+    Queue - Supplies a pointer to the completion queue.
+
+    Completions - Supplies a pointer to an array where the completions will be
+        returned, in the order the requests finished.
+
+    Count - Supplies the number of elements in the completions array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for a
+        completion. Use WAIT_TIME_INDEFINITE to wait forever, or zero to only
+        collect completions that are already available.
+
+    CompletionCount - Supplies a pointer where the number of completions
+        returned will be stored.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one completion was returned.
+
+    STATUS_TIMEOUT if no requests finished before the timeout expired.
+
+    Other error codes if the wait was interrupted.
+
+--*/
+
+{
+
+    UINTN Index;
+    PIO_ASYNC_REQUEST Request;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    *CompletionCount = 0;
+    if (Count == 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    while (TRUE) {
+        Status = KeWaitForEvent(Queue->Event, FALSE, TimeoutInMilliseconds);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Index = 0;
+        KeAcquireQueuedLock(Queue->Lock);
+        while ((Index < Count) &&
+               (LIST_EMPTY(&(Queue->CompletionListHead)) == FALSE)) {
+
+            Request = LIST_VALUE(Queue->CompletionListHead.Next,
+                                 IO_ASYNC_REQUEST,
+                                 ListEntry);
+
+            LIST_REMOVE(&(Request->ListEntry));
+            RtlCopyMemory(&(Completions[Index]),
+                          &(Request->Completion),
+                          sizeof(IO_COMPLETION));
+
+            MmFreePagedPool(Request);
+            Index += 1;
+        }
+
+        if (LIST_EMPTY(&(Queue->CompletionListHead)) != FALSE) {
+            KeSignalEvent(Queue->Event, SignalOptionUnsignal);
+        }
+
+        KeReleaseQueuedLock(Queue->Lock);
+
+        //
+        // Another thread may have collected the completions between the wait
+        // and the lock. Go back to waiting in that case.
+        //
+
+        if (Index != 0) {
+            *CompletionCount = Index;
+            Status = STATUS_SUCCESS;
+            break;
+        }
+    }
+
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+BOOL
+IopCanSendAsynchronousIrp (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    UINTN SizeInBytes
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether an I/O request can be sent directly to the
+    device as an asynchronous IRP.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset of the I/O.
+
+    SizeInBytes - Supplies the size of the I/O.
+
+Return Value:
+
+    TRUE if the request can bypass the regular I/O path.
+
+    FALSE if the request needs the regular I/O path.
+
+--*/
+
+{
+
+    ULONG BlockSize;
+    PFILE_OBJECT FileObject;
+
+    //
+    // Only raw block devices that skip the page cache go straight to the
+    // driver. Everything else needs the page cache or a file system to
+    // translate the request, and those are synchronous.
+    //
+
+    FileObject = Handle->FileObject;
+    if ((FileObject == NULL) ||
+        (FileObject->Properties.Type != IoObjectBlockDevice) ||
+        (IO_IS_FILE_OBJECT_CACHEABLE(FileObject) != FALSE) ||
+        (FileObject->Device->Header.Type != ObjectDevice)) {
+
+        return FALSE;
+    }
+
+    BlockSize = FileObject->Properties.BlockSize;
+    if ((Offset < 0) ||
+        (SizeInBytes == 0) ||
+        (IS_ALIGNED(Offset, BlockSize) == FALSE) ||
+        (IS_ALIGNED(SizeInBytes, BlockSize) == FALSE)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+KSTATUS
+IopSendAsynchronousIoIrp (
+    PIO_ASYNC_REQUEST Request,
+    PIO_BUFFER IoBuffer,
+    IO_OFFSET Offset,
+    UINTN SizeInBytes,
+    ULONG Flags,
+    BOOL Write
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends an asynchronous read or write IRP directly to a block
+    device on behalf of an asynchronous I/O request.
+
+Arguments:
+
+    Request - Supplies a pointer to the asynchronous request.
+
+    IoBuffer - Supplies a pointer to the I/O buffer.
+
+    Offset - Supplies the block aligned offset of the I/O.
+
+    SizeInBytes - Supplies the block aligned size of the I/O.
+
+    Flags - Supplies flags regarding the I/O operation. See IO_FLAG_*
+        definitions.
+
+    Write - Supplies a boolean indicating whether this is a read (FALSE) or a
+        write (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PFILE_OBJECT FileObject;
+    PIRP Irp;
+    PIRP_READ_WRITE ReadWrite;
+    KSTATUS Status;
+
+    FileObject = Request->Handle->FileObject;
+    Irp = IoCreateIrp(FileObject->Device, IrpMajorIo, 0);
+    if (Irp == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Irp->MinorCode = IrpMinorIoRead;
+    if (Write != FALSE) {
+        Irp->MinorCode = IrpMinorIoWrite;
+    }
+
+    if ((Request->Handle->OpenFlags & OPEN_FLAG_SYNCHRONIZED) != 0) {
+        Flags |= IO_FLAG_DATA_SYNCHRONIZED;
+    }
+
+    ReadWrite = &(Irp->U.ReadWrite);
+    RtlZeroMemory(ReadWrite, sizeof(IRP_READ_WRITE));
+    ReadWrite->DeviceContext = FileObject->DeviceContext;
+    ReadWrite->IoFlags = Flags;
+    ReadWrite->TimeoutInMilliseconds = WAIT_TIME_INDEFINITE;
+    ReadWrite->FileProperties = &(FileObject->Properties);
+    ReadWrite->IoOffset = Offset;
+    ReadWrite->IoSizeInBytes = SizeInBytes;
+    ReadWrite->NewIoOffset = Offset;
+    ReadWrite->IoBuffer = IoBuffer;
+    Irp->CompletionRoutine = IopAsynchronousIoIrpCompletion;
+    Irp->CompletionContext = Request;
+    Status = IoSendAsynchronousIrp(Irp);
+    if (!KSUCCESS(Status)) {
+        IoDestroyIrp(Irp);
+    }
+
+    return Status;
+}
+
+VOID
+IopAsynchronousIoIrpCompletion (
+    PIRP Irp,
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called at low level when an asynchronous I/O IRP finishes.
+    It records the result and posts it to the request's completion queue.
+
+Arguments:
+
+    Irp - Supplies a pointer to the completed IRP.
+
+    Context - Supplies a pointer to the asynchronous I/O request.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    ULONGLONG FileSize;
+    PIRP_READ_WRITE ReadWrite;
+    PIO_ASYNC_REQUEST Request;
+
+    Request = Context;
+    ReadWrite = &(Irp->U.ReadWrite);
+    BytesCompleted = ReadWrite->IoBytesCompleted;
+
+    //
+    // Like synchronous reads, don't report data beyond the end of the device.
+    //
+
+    if (Irp->MinorCode == IrpMinorIoRead) {
+        FileSize = ReadWrite->FileProperties->Size;
+        if (ReadWrite->IoOffset >= FileSize) {
+            BytesCompleted = 0;
+
+        } else if ((ReadWrite->IoOffset + BytesCompleted) > FileSize) {
+            BytesCompleted = FileSize - ReadWrite->IoOffset;
+        }
+
+        RtlAtomicAdd64(&(IoGlobalStatistics.BytesRead), BytesCompleted);
+
+    } else {
+        RtlAtomicAdd64(&(IoGlobalStatistics.BytesWritten), BytesCompleted);
+    }
+
+    Request->Completion.Status = IoGetIrpStatus(Irp);
+    Request->Completion.BytesCompleted = BytesCompleted;
+    IoDestroyIrp(Irp);
+    IopPostAsynchronousIo(Request);
+    return;
+}
+
+VOID
+IopPostAsynchronousIo (
+    PIO_ASYNC_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine posts a finished asynchronous I/O request to its completion
+    queue and releases the references it held.
+
+Arguments:
+
+    Request - Supplies a pointer to the finished request. The completion queue
+        takes ownership of it.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIO_COMPLETION_QUEUE Queue;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    IoIoHandleReleaseReference(Request->Handle);
+    Request->Handle = NULL;
+    Queue = Request->Queue;
+    KeAcquireQueuedLock(Queue->Lock);
+    INSERT_BEFORE(&(Request->ListEntry), &(Queue->CompletionListHead));
+    KeSignalEvent(Queue->Event, SignalOptionSignalAll);
+    KeReleaseQueuedLock(Queue->Lock);
+    IopCompletionQueueReleaseReference(Queue);
+    return;
+}
+
+VOID
+IopCompletionQueueAddReference (
+    PIO_COMPLETION_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a reference to an I/O completion queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the completion queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Queue->ReferenceCount), 1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x10000000));
+
+    return;
+}
+
+VOID
+IopCompletionQueueReleaseReference (
+    PIO_COMPLETION_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a reference on an I/O completion queue, destroying
+    it and any uncollected completions if this was the last reference.
+
+Arguments:
+
+    Queue - Supplies a pointer to the completion queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldReferenceCount;
+    PIO_ASYNC_REQUEST Request;
+
+    OldReferenceCount = RtlAtomicAdd32(&(Queue->ReferenceCount), (ULONG)-1);
+
+    ASSERT((OldReferenceCount != 0) && (OldReferenceCount < 0x10000000));
+
+    if (OldReferenceCount != 1) {
+        return;
+    }
+
+    while (LIST_EMPTY(&(Queue->CompletionListHead)) == FALSE) {
+        Request = LIST_VALUE(Queue->CompletionListHead.Next,
+                             IO_ASYNC_REQUEST,
+                             ListEntry);
+
+        LIST_REMOVE(&(Request->ListEntry));
+        MmFreePagedPool(Request);
+    }
+
+    KeDestroyEvent(Queue->Event);
+    KeDestroyQueuedLock(Queue->Lock);
+    MmFreePagedPool(Queue);
+    return;
+}
+
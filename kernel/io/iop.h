@@ -63,6 +63,7 @@ Module Name:
 #define FILE_LOCK_ALLOCATION_TAG 0x6B434C46 // 'kcLF'
 #define SOCKET_INFORMATION_ALLOCATION_TAG 0x666E4953 // 'fnIS'
 #define UNIX_SOCKET_ALLOCATION_TAG 0x6F536E55 // 'oSnU'
+#define BLOCK_QUEUE_ALLOCATION_TAG 0x516B6C42 // 'QklB'
 
 #define IRP_MAGIC_VALUE (USHORT)IRP_ALLOCATION_TAG
 
@@ -130,6 +131,13 @@ Module Name:
 
 #define IRP_ACTIVE 0x00000004
 
+//
+// This flag is set in an IRP when it was sent asynchronously, meaning no
+// thread is waiting on it and a worker must continue it after it is pended.
+//
+
+#define IRP_ASYNCHRONOUS 0x00000008
+
 //
 // This flag is used during processing Query Children to mark pre-existing
 // devices and notice missing ones.
@@ -228,6 +236,13 @@ Module Name:
 
 #define FILE_OBJECT_FLAG_NON_PAGED_IO_STATE 0x00000100
 
+//
+// This flag is set if the file system supports reserving space for cached
+// writes and assigning blocks when the page cache flushes them.
+//
+
+#define FILE_OBJECT_FLAG_DELAYED_ALLOCATION 0x00000200
+
 //
 // The resource allocation work is currently assigned to the system work queue.
 //
@@ -257,6 +272,21 @@ Module Name:
 
 #define EVICTION_FLAG_REMOVE 0x00000002
 
+//
+// Define the bounds on the number of worker threads servicing the device work
+// queue. Within these bounds the pool is sized to the processor count.
+//
+
+#define IO_DEVICE_WORKER_THREAD_MIN 2
+#define IO_DEVICE_WORKER_THREAD_MAX 8
+
+//
+// Define the number of device start records kept in the boot timeline. Starts
+// beyond this are counted but not recorded.
+//
+
+#define IO_DEVICE_TIMELINE_SIZE 256
+
 //
 // --------------------------------------------------------------------- Macros
 //
@@ -342,6 +372,7 @@ typedef enum _FILE_OBJECT_TIME_TYPE {
 } FILE_OBJECT_TIME_TYPE, *PFILE_OBJECT_TIME_TYPE;
 
 typedef struct _DEVICE_POWER DEVICE_POWER, *PDEVICE_POWER;
+typedef struct _BLOCK_QUEUE BLOCK_QUEUE, *PBLOCK_QUEUE;
 
 /*++
 
@@ -989,6 +1020,17 @@ Structure Description:
 
     Power - Stores the power management information for the device.
 
+    BlockQueue - Stores a pointer to the queue that schedules block I/O
+        requests sent to this device. This is created on the first block I/O
+        request.
+
+    BlockQueuePolicy - Stores the block I/O scheduling policy requested by the
+        driver for this device and the devices stacked on it.
+
+    StartTime - Stores the time counter value when the system began starting
+        the device, or 0 if the device is not in the middle of starting. This
+        is used to record the device in the start timeline.
+
 --*/
 
 struct _DEVICE {
@@ -1020,6 +1062,9 @@ struct _DEVICE {
     PRESOURCE_ALLOCATION_LIST ProcessorLocalResources;
     PRESOURCE_ALLOCATION_LIST BootResources;
     PDEVICE_POWER Power;
+    PBLOCK_QUEUE BlockQueue;
+    BLOCK_QUEUE_POLICY BlockQueuePolicy;
+    ULONGLONG StartTime;
 };
 
 /*++
@@ -1145,6 +1190,13 @@ extern PQUEUED_LOCK IoDeviceDatabaseLock;
 
 extern PWORK_QUEUE IoDeviceWorkQueue;
 
+//
+// Store a pointer to the work queue that drives asynchronous IRPs the rest of
+// the way up their stacks once a driver completes them.
+//
+
+extern PWORK_QUEUE IoIrpWorkQueue;
+
 //
 // Define the object that roots the device tree.
 //
@@ -1159,6 +1211,12 @@ extern PQUEUED_LOCK IoDeviceListLock;
 
 extern UINTN IoDeviceWorkItemsQueued;
 
+//
+// Store the device start timeline and the lock that protects it.
+//
+
+extern PQUEUED_LOCK IoDeviceTimelineLock;
+
 //
 // Store the array of devices that were delayed until the initial enumeration
 // was complete.
@@ -1186,6 +1244,13 @@ extern LIST_ENTRY IoFileSystemList;
 
 extern PQUEUED_LOCK IoFileSystemListLock;
 
+//
+// This lock serializes picking a volume name with creating the volume, since
+// disks may be started concurrently.
+//
+
+extern PQUEUED_LOCK IoVolumeNameLock;
+
 //
 // Store a pointer to the volumes directory and the number of volumes in the
 // system.
@@ -1217,6 +1282,12 @@ extern IO_BOOT_INFORMATION IoBootInformation;
 
 extern IO_GLOBAL_STATISTICS IoGlobalStatistics;
 
+//
+// Store the identifier of the block request queue device information.
+//
+
+extern UUID IoBlockQueueInformationUuid;
+
 //
 // Store the root path point.
 //
@@ -1455,6 +1526,40 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopGetDeviceTimeline (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets the device start timeline.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the timeline is
+        returned, an IO_DEVICE_TIMELINE structure.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_BUFFER_TOO_SMALL if the buffer cannot hold every entry.
+
+    STATUS_ACCESS_DENIED if this is a set operation.
+
+--*/
+
 VOID
 IopClearDeviceProblem (
     PDEVICE Device
@@ -2167,7 +2272,8 @@ IopSendCreateRequest (
     PFILE_OBJECT Directory,
     PCSTR Name,
     ULONG NameSize,
-    PFILE_PROPERTIES Properties
+    PFILE_PROPERTIES Properties,
+    PULONG Flags
     );
 
 /*++
@@ -2194,6 +2300,9 @@ Routine Description:
         on success. The permissions, object type, user ID, group ID, and access
         times are all valid from the system.
 
+    Flags - Supplies a pointer where the translated file object flags will be
+        returned. See FILE_OBJECT_FLAG_* definitions.
+
 Return Value:
 
     Status code.
@@ -2858,6 +2967,80 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopPreallocateFileObject (
+    PFILE_OBJECT FileObject,
+    PVOID DeviceContext,
+    ULONGLONG AllocationSize,
+    BOOL KeepSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks the file system to allocate disk space for the given
+    file object up to the given size. If the file is smaller than the
+    allocation and the caller did not ask to keep the size, the file size is
+    extended to match.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object to allocate space for.
+
+    DeviceContext - Supplies an optional pointer to the device context to use
+        when doing file operations. Not every file object has a built-in device
+        context.
+
+    AllocationSize - Supplies the number of bytes, starting at the beginning of
+        the file, that should have disk space allocated.
+
+    KeepSize - Supplies a boolean indicating whether the file size should be
+        left alone (TRUE) or extended to the allocation size if it is smaller
+        (FALSE).
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the file system cannot allocate space.
+
+    STATUS_VOLUME_FULL if there is not enough free space.
+
+    Other error codes on failure.
+
+--*/
+
+KSTATUS
+IopReserveFileObjectSpace (
+    PFILE_OBJECT FileObject,
+    ULONGLONG Offset,
+    ULONGLONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks the file system to reserve space for a region of a file
+    that is about to be written into the page cache. The blocks themselves are
+    assigned when the page cache entries are flushed. This routine assumes the
+    file object lock is held exclusively.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object being written.
+
+    Offset - Supplies the file offset where the region begins.
+
+    Size - Supplies the size of the region, in bytes.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 VOID
 IopFileObjectIncrementHardLinkCount (
     PFILE_OBJECT FileObject
@@ -4553,6 +4736,36 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopSendIoRequest (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCode,
+    PIRP_READ_WRITE Request
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an I/O IRP for the given request and sends it
+    straight to the device, waiting for it to complete. No accounting is
+    performed.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to send the IRP to.
+
+    MinorCode - Supplies the minor code of the IRP.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters, and on output contains the completion results.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 IopSendSystemControlIrp (
     PDEVICE Device,
@@ -4861,3 +5074,88 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopSendBlockIoRequest (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCode,
+    PIRP_READ_WRITE Request
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends a block I/O request through the device's request
+    queue, where it may be reordered according to the queue's policy and
+    merged with contiguous requests from other threads. This routine waits
+    for the request to complete, and must be called at low level.
+
+Arguments:
+
+    Device - Supplies a pointer to the block device to send the request to.
+
+    MinorCode - Supplies the minor code of the request, either read or write.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters, and on output contains the completion results.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+IopDestroyBlockQueue (
+    PDEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys the block request queue for the given device, if
+    one was ever created.
+
+Arguments:
+
+    Device - Supplies a pointer to the device being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+IopGetSetBlockQueueInformation (
+    PDEVICE Device,
+    PBLOCK_QUEUE_DEVICE_INFORMATION Information,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the block request queue device information for
+    the given device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Information - Supplies a pointer to the information buffer.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        buffer. On output, returns the needed size of the buffer.
+
+    Set - Supplies a boolean indicating whether to get the information (FALSE)
+        or set the policy (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
@@ -98,6 +98,16 @@ Structure Description:
     Flags - Stores a set of informational flags about the IRP. See IRP_*
         definitions.
 
+    WorkItem - Stores a pointer to the work item used to continue driving an
+        asynchronous IRP after a driver completes it, which may happen at
+        dispatch level. This is created the first time the IRP is sent
+        asynchronously.
+
+    Handoff - Stores the number of parties that have arrived at the point
+        where a pended asynchronous IRP can be driven again: the thread that
+        saw it pend and the driver that completed or continued it. Whichever
+        arrives second continues the IRP.
+
 --*/
 
 typedef struct _IRP_INTERNAL {
@@ -109,6 +119,8 @@ typedef struct _IRP_INTERNAL {
     ULONG StackIndex;
     ULONG StackSize;
     ULONG Flags;
+    PWORK_ITEM WorkItem;
+    volatile ULONG Handoff;
 } IRP_INTERNAL, *PIRP_INTERNAL;
 
 //
@@ -130,10 +142,27 @@ IopAdvanceIrpStackLocation (
     PIRP_INTERNAL Irp
     );
 
+VOID
+IopSignalPendingIrp (
+    PIRP_INTERNAL Irp
+    );
+
+VOID
+IopDriveAsynchronousIrp (
+    PVOID Parameter
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
+//
+// Store a pointer to the work queue that drives asynchronous IRPs the rest of
+// the way up their stacks once a driver completes them.
+//
+
+PWORK_QUEUE IoIrpWorkQueue;
+
 //
 // Store a pointer to the parent object of all IRPs.
 //
@@ -274,7 +303,7 @@ Return Value:
         //
 
         if ((InternalIrp->Flags & IRP_PENDING) != 0) {
-            ObSignalObject(Irp, SignalOptionSignalAll);
+            IopSignalPendingIrp(InternalIrp);
         }
     }
 
@@ -389,7 +418,7 @@ Return Value:
         //
 
         if ((InternalIrp->Flags & IRP_PENDING) != 0) {
-            ObSignalObject(Irp, SignalOptionSignalAll);
+            IopSignalPendingIrp(InternalIrp);
         }
     }
 
@@ -486,6 +515,7 @@ Return Value:
     Irp->Flags = 0;
     Irp->Stack = NULL;
     Irp->StackIndex = 0;
+    Irp->WorkItem = NULL;
 
     //
     // Figure out the size of the IRP stack, which is a chain of all the
@@ -691,6 +721,10 @@ Return Value:
         }
     }
 
+    if (InternalIrp->WorkItem != NULL) {
+        KeDestroyWorkItem(InternalIrp->WorkItem);
+    }
+
     MmFreeNonPagedPool(InternalIrp->Stack);
     ObReleaseReference(Irp);
     return;
@@ -854,6 +888,112 @@ Return Value:
     return Status;
 }
 
+KERNEL_API
+KSTATUS
+IoSendAsynchronousIrp (
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends an initialized IRP down the device stack and returns
+    without waiting for it to complete. If a driver pends the IRP, the calling
+    thread is released, and the IRP is driven the rest of the way through the
+    stack by a system worker thread once the driver completes it, usually from
+    its DPC. The IRP's completion routine is called at low level when the IRP
+    finishes its round trip, and is free to destroy the IRP. This routine must
+    be called at low level.
+
+Arguments:
+
+    Irp - Supplies a pointer to the initialized IRP to send. All parameters
+        should already be filled out and ready to go, including the
+        completion routine.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was sent. The completion routine will be called
+    exactly once, possibly before this routine returns. This says nothing of
+    the completion status of the IRP.
+
+    STATUS_INVALID_PARAMETER if the IRP was not properly initialized or has no
+    completion routine.
+
+    STATUS_INSUFFICIENT_RESOURCES if memory could not be allocated. The
+    completion routine is not called in this case.
+
+--*/
+
+{
+
+    PIRP_INTERNAL InternalIrp;
+    KSTATUS Status;
+
+    InternalIrp = (PIRP_INTERNAL)Irp;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    //
+    // Crash if the IRP was improperly allocated or modified.
+    //
+
+    if (InternalIrp->Magic != IRP_MAGIC_VALUE) {
+        KeCrashSystem(CRASH_INVALID_IRP,
+                      IrpCrashImproperlyAllocated,
+                      (UINTN)Irp,
+                      (UINTN)Irp->Device,
+                      0);
+    }
+
+    if ((InternalIrp->Device != Irp->Device) ||
+        (InternalIrp->MajorCode != Irp->MajorCode)) {
+
+        KeCrashSystem(CRASH_INVALID_IRP,
+                      IrpCrashConstantStateModified,
+                      (UINTN)Irp,
+                      (UINTN)Irp->Device,
+                      0);
+    }
+
+    if ((Irp->MinorCode == IrpMinorInvalid) ||
+        (Irp->Direction != IrpDown) ||
+        (Irp->CompletionRoutine == NULL)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto SendAsynchronousIrpEnd;
+    }
+
+    ASSERT((InternalIrp->Flags &
+            (IRP_COMPLETE | IRP_ACTIVE | IRP_PENDING)) == 0);
+
+    //
+    // Create the work item now, as a driver completing the IRP at dispatch
+    // level cannot allocate it. It is reused if the IRP is sent again.
+    //
+
+    if (InternalIrp->WorkItem == NULL) {
+        InternalIrp->WorkItem = KeCreateWorkItem(IoIrpWorkQueue,
+                                                 WorkPriorityNormal,
+                                                 IopDriveAsynchronousIrp,
+                                                 InternalIrp,
+                                                 IRP_ALLOCATION_TAG);
+
+        if (InternalIrp->WorkItem == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto SendAsynchronousIrpEnd;
+        }
+    }
+
+    InternalIrp->Flags |= IRP_ACTIVE | IRP_ASYNCHRONOUS;
+    IopDriveAsynchronousIrp(InternalIrp);
+    Status = STATUS_SUCCESS;
+
+SendAsynchronousIrpEnd:
+    return Status;
+}
+
 KERNEL_API
 KSTATUS
 IoPrepareReadWriteIrp (
@@ -1399,19 +1539,13 @@ Return Value:
 
 {
 
-    PIRP IoIrp;
+    PFILE_PROPERTIES FileProperties;
     KSTATUS Status;
     PKTHREAD Thread;
 
     ASSERT((Device != NULL) && (Device != IoRootDevice));
     ASSERT(KeGetRunLevel() < RunLevelDispatch);
 
-    IoIrp = IoCreateIrp(Device, IrpMajorIo, 0);
-    if (IoIrp == NULL) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto SendIoIrpEnd;
-    }
-
     Thread = KeGetCurrentThread();
 
     //
@@ -1425,48 +1559,45 @@ Return Value:
     }
 
     //
-    // Copy the supplied contents in and send the IRP.
+    // Reads and writes to block devices go through the device's request
+    // queue, which orders them and merges neighbors from other threads. The
+    // memory manager's no-allocate paths skip the queue, since the queue may
+    // need to allocate.
     //
 
-    IoIrp->MinorCode = MinorCodeNumber;
-    RtlCopyMemory(&(IoIrp->U.ReadWrite), Request, sizeof(IRP_READ_WRITE));
-    IoIrp->U.ReadWrite.IoBufferState.IoBuffer = NULL;
-    Status = IoSendSynchronousIrp(IoIrp);
-    if (!KSUCCESS(Status)) {
-        goto SendIoIrpEnd;
+    FileProperties = Request->FileProperties;
+    if ((Device->Header.Type == ObjectDevice) &&
+        (FileProperties != NULL) &&
+        (FileProperties->Type == IoObjectBlockDevice) &&
+        ((Request->IoFlags & IO_FLAG_NO_ALLOCATE) == 0)) {
+
+        Status = IopSendBlockIoRequest(Device, MinorCodeNumber, Request);
+
+    } else {
+        Status = IopSendIoRequest(Device, MinorCodeNumber, Request);
     }
 
-    ASSERT(IoIrp->U.ReadWrite.IoBufferState.IoBuffer == NULL);
+    //
+    // Only account for transfers that succeeded.
+    //
 
-    RtlCopyMemory(Request, &(IoIrp->U.ReadWrite), sizeof(IRP_READ_WRITE));
-    if (Device->Header.Type == ObjectDevice) {
+    if ((KSUCCESS(Status)) && (Device->Header.Type == ObjectDevice)) {
         if (MinorCodeNumber == IrpMinorIoWrite) {
             RtlAtomicAdd64(&(IoGlobalStatistics.BytesWritten),
-                           IoIrp->U.ReadWrite.IoBytesCompleted);
-
-            Thread->ResourceUsage.BytesWritten +=
-                                           IoIrp->U.ReadWrite.IoBytesCompleted;
+                           Request->IoBytesCompleted);
 
+            Thread->ResourceUsage.BytesWritten += Request->IoBytesCompleted;
             Thread->ResourceUsage.DeviceWrites += 1;
 
         } else {
             RtlAtomicAdd64(&(IoGlobalStatistics.BytesRead),
-                           IoIrp->U.ReadWrite.IoBytesCompleted);
-
-            Thread->ResourceUsage.BytesRead +=
-                                           IoIrp->U.ReadWrite.IoBytesCompleted;
+                           Request->IoBytesCompleted);
 
+            Thread->ResourceUsage.BytesRead += Request->IoBytesCompleted;
             Thread->ResourceUsage.DeviceReads += 1;
         }
     }
 
-    Status = IoGetIrpStatus(IoIrp);
-
-SendIoIrpEnd:
-    if (IoIrp != NULL) {
-        IoDestroyIrp(IoIrp);
-    }
-
     return Status;
 }
 
@@ -1525,6 +1656,72 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+IopSendIoRequest (
+    PDEVICE Device,
+    IRP_MINOR_CODE MinorCode,
+    PIRP_READ_WRITE Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an I/O IRP for the given request and sends it
+    straight to the device, waiting for it to complete. No accounting is
+    performed.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to send the IRP to.
+
+    MinorCode - Supplies the minor code of the IRP.
+
+    Request - Supplies a pointer that on input contains the I/O request
+        parameters, and on output contains the completion results.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIRP IoIrp;
+    KSTATUS Status;
+
+    IoIrp = IoCreateIrp(Device, IrpMajorIo, 0);
+    if (IoIrp == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SendIoRequestEnd;
+    }
+
+    //
+    // Copy the supplied contents in and send the IRP.
+    //
+
+    IoIrp->MinorCode = MinorCode;
+    RtlCopyMemory(&(IoIrp->U.ReadWrite), Request, sizeof(IRP_READ_WRITE));
+    IoIrp->U.ReadWrite.IoBufferState.IoBuffer = NULL;
+    Status = IoSendSynchronousIrp(IoIrp);
+    if (!KSUCCESS(Status)) {
+        goto SendIoRequestEnd;
+    }
+
+    ASSERT(IoIrp->U.ReadWrite.IoBufferState.IoBuffer == NULL);
+
+    RtlCopyMemory(Request, &(IoIrp->U.ReadWrite), sizeof(IRP_READ_WRITE));
+    Status = IoGetIrpStatus(IoIrp);
+
+SendIoRequestEnd:
+    if (IoIrp != NULL) {
+        IoDestroyIrp(IoIrp);
+    }
+
+    return Status;
+}
+
 KSTATUS
 IopSendSystemControlIrp (
     PDEVICE Device,
@@ -1779,7 +1976,14 @@ Return Value:
 
         ASSERT((Irp->Flags & IRP_PENDING) == 0);
 
+        //
+        // Only asynchronous IRPs have completion routines. The IRP is no
+        // longer active once it gets here, and the completion routine is
+        // allowed to destroy it, so it cannot be touched afterwards.
+        //
+
         if (Irp->Public.CompletionRoutine != NULL) {
+            Irp->Flags &= ~(IRP_ACTIVE | IRP_ASYNCHRONOUS);
             Irp->Public.CompletionRoutine((PIRP)Irp,
                                           Irp->Public.CompletionContext);
         }
@@ -1942,3 +2146,116 @@ Return Value:
     return FALSE;
 }
 
+VOID
+IopSignalPendingIrp (
+    PIRP_INTERNAL Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes whoever is responsible for driving a pended IRP that a
+    driver has just completed or continued. This routine may be called at
+    dispatch level.
+
+Arguments:
+
+    Irp - Supplies a pointer to the pended IRP.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OldHandoff;
+    KSTATUS Status;
+
+    ASSERT((Irp->Flags & IRP_PENDING) != 0);
+
+    //
+    // A synchronous IRP has its sending thread waiting on it.
+    //
+
+    if ((Irp->Flags & IRP_ASYNCHRONOUS) == 0) {
+        ObSignalObject(Irp, SignalOptionSignalAll);
+        return;
+    }
+
+    //
+    // An asynchronous IRP is continued by a worker thread, but only once the
+    // thread that pended it is done with it. If that thread has not yet
+    // arrived, it will notice this completion and continue the IRP itself.
+    //
+
+    OldHandoff = RtlAtomicAdd32(&(Irp->Handoff), 1);
+    if (OldHandoff != 0) {
+
+        ASSERT(OldHandoff == 1);
+
+        Status = KeQueueWorkItem(Irp->WorkItem);
+
+        ASSERT(KSUCCESS(Status));
+
+    }
+
+    return;
+}
+
+VOID
+IopDriveAsynchronousIrp (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pumps an asynchronous IRP through its stack until it either
+    completes or is pended by a driver that has not yet gotten back to it.
+    It is called by the sender and then by the IRP's work item after each
+    completion of a pended IRP.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the internal IRP.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIRP_INTERNAL Irp;
+    BOOL IrpDone;
+    ULONG OldHandoff;
+
+    Irp = Parameter;
+    while (TRUE) {
+        Irp->Flags &= ~IRP_PENDING;
+        Irp->Handoff = 0;
+        IrpDone = IopPumpIrpThroughStack(Irp);
+        if (IrpDone != FALSE) {
+            break;
+        }
+
+        //
+        // The IRP was pended. If the driver already finished with it, keep
+        // going here. Otherwise the driver's completion queues the work item.
+        //
+
+        OldHandoff = RtlAtomicAdd32(&(Irp->Handoff), 1);
+        if (OldHandoff == 0) {
+            break;
+        }
+
+        ASSERT((Irp->Flags & IRP_PENDING) != 0);
+    }
+
+    return;
+}
@@ -2666,7 +2666,8 @@ Return Value:
                                           DirectoryFileObject,
                                           Name,
                                           NameSize,
-                                          &Properties);
+                                          &Properties,
+                                          &FileObjectFlags);
 
             //
             // If the create request worked, create a file object for it. If
@@ -2680,7 +2681,6 @@ Return Value:
 
                 ASSERT(Properties.DeviceId == PathRoot->DeviceId);
 
-                FileObjectFlags = 0;
                 if ((OpenFlags & OPEN_FLAG_NO_PAGE_CACHE) != 0) {
                     FileObjectFlags |= FILE_OBJECT_FLAG_NO_PAGE_CACHE;
                 }
@@ -133,6 +133,7 @@ Return Value:
     return ArGetProcessorBlockRegisterForDebugger();
 }
 
+KERNEL_API
 ULONG
 KeGetCurrentProcessorNumber (
     VOID
@@ -165,6 +166,7 @@ Return Value:
     return ProcessorNumber;
 }
 
+KERNEL_API
 PKTHREAD
 KeGetCurrentThread (
     VOID
@@ -224,12 +224,57 @@ Return Value:
 
 --*/
 
+{
+
+    return KeCreateMultiThreadedWorkQueue(Flags, Name, 1);
+}
+
+KERNEL_API
+PWORK_QUEUE
+KeCreateMultiThreadedWorkQueue (
+    ULONG Flags,
+    PCSTR Name,
+    ULONG ThreadCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new work queue serviced by a pool of worker
+    threads. Work items are still dequeued in priority order, but up to the
+    given number of them may run concurrently, so callers must provide their
+    own ordering between dependent items.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags governing the behavior of the work
+        queue. See WORK_QUEUE_FLAG_* definitions.
+
+    Name - Supplies an optional pointer to the name of the worker threads
+        created. A copy of this memory will be made. This should only be used
+        for debugging, as text may be added to the end of the name supplied
+        here to the actual worker thread names.
+
+    ThreadCount - Supplies the number of worker threads to create. If not all
+        of them can be created, the queue is serviced by as many as could be.
+        At least one thread is always created.
+
+Return Value:
+
+    Returns a pointer to the new work queue on success.
+
+    NULL on failure.
+
+--*/
+
 {
 
     ULONG NameSize;
     BOOL NonPaged;
     PWORK_QUEUE Queue;
     KSTATUS Status;
+    ULONG ThreadIndex;
 
     //
     // Parse the flags.
@@ -295,12 +340,26 @@ Return Value:
     Queue->State = WorkQueueStateOpen;
 
     //
-    // Create a worker thread.
+    // Create the worker threads. The thread count is accounted for here
+    // rather than by the threads themselves so that a queue destroyed before
+    // all of its workers get scheduled is not freed by the first one out.
     //
 
-    Status = PsCreateKernelThread(KepWorkerThread, Queue, Name);
-    if (!KSUCCESS(Status)) {
-        goto CreateWorkQueueEnd;
+    if (ThreadCount == 0) {
+        ThreadCount = 1;
+    }
+
+    for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+        RtlAtomicAdd32(&(Queue->CurrentThreadCount), 1);
+        Status = PsCreateKernelThread(KepWorkerThread, Queue, Name);
+        if (!KSUCCESS(Status)) {
+            RtlAtomicAdd32(&(Queue->CurrentThreadCount), -1);
+            if (ThreadIndex == 0) {
+                goto CreateWorkQueueEnd;
+            }
+
+            break;
+        }
     }
 
     Status = STATUS_SUCCESS;
@@ -417,7 +476,9 @@ KeFlushWorkQueue (
 Routine Description:
 
     This routine flushes a work queue. If there are items on the work queue,
-    they will be completed before this routine returns.
+    they will be completed before this routine returns. On a queue with
+    multiple worker threads, items dequeued ahead of the flush may still be
+    running when this routine returns.
 
 Arguments:
 
@@ -1143,7 +1204,6 @@ Return Value:
 
     OldRunLevel = RunLevelCount;
     Queue = (PWORK_QUEUE)Parameter;
-    RtlAtomicAdd32(&(Queue->CurrentThreadCount), 1);
     RaiseToDispatch = FALSE;
     if ((Queue->Flags & WORK_QUEUE_FLAG_SUPPORT_DISPATCH_LEVEL) != 0) {
         RaiseToDispatch = TRUE;
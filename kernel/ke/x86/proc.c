@@ -169,6 +169,7 @@ Return Value:
     return Block;
 }
 
+KERNEL_API
 ULONG
 KeGetCurrentProcessorNumber (
     VOID
@@ -201,6 +202,7 @@ Return Value:
     return Number;
 }
 
+KERNEL_API
 PKTHREAD
 KeGetCurrentThread (
     VOID
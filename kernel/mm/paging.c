@@ -800,6 +800,7 @@ Return Value:
     return Status;
 }
 
+KERNEL_API
 KSTATUS
 MmAllocatePageFileSpace (
     PIMAGE_BACKING ImageBacking,
@@ -916,6 +917,7 @@ Return Value:
     return Status;
 }
 
+KERNEL_API
 VOID
 MmFreePageFileSpace (
     PIMAGE_BACKING ImageBacking,
@@ -1016,6 +1018,7 @@ Return Value:
     return;
 }
 
+KERNEL_API
 KSTATUS
 MmPageFilePerformIo (
     PIMAGE_BACKING ImageBacking,
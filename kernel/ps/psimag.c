@@ -229,6 +229,8 @@ IM_IMPORT_TABLE PsImageFunctionTable = {
     PspImInvalidateInstructionCacheRegion,
     PspImGetEnvironmentVariable,
     PspImFinalizeSegments,
+    NULL,
+    NULL,
     NULL
 };
 
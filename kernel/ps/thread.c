@@ -1402,6 +1402,7 @@ Return Value:
         WakeOperation.Value = 1;
         WakeOperation.Operation = UserLockWake;
         WakeOperation.TimeoutInMilliseconds = 0;
+        WakeOperation.RequeueAddress = NULL;
         PspUserLockWake(&WakeOperation);
     }
 
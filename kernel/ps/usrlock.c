@@ -97,6 +97,17 @@ PspUserLockWake (
     PSYSTEM_CALL_USER_LOCK Parameters
     );
 
+KSTATUS
+PspUserLockRequeue (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    );
+
+ULONG
+PspWakeUserLockWaiters (
+    PUSER_LOCK Lock,
+    ULONG Count
+    );
+
 KSTATUS
 PspInitializeUserLock (
     PVOID Address,
@@ -169,6 +180,10 @@ Return Value:
         Status = PspUserLockWake(Parameters);
         break;
 
+    case UserLockRequeue:
+        Status = PspUserLockRequeue(Parameters);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         break;
@@ -231,8 +246,6 @@ Return Value:
 
 {
 
-    PUSER_LOCK FoundLock;
-    PRED_BLACK_TREE_NODE FoundNode;
     USER_LOCK Lock;
     BOOL Private;
     ULONG ProcessesReleased;
@@ -252,36 +265,8 @@ Return Value:
     // Release the specified number of processes.
     //
 
-    ProcessesReleased = 0;
     KeAcquireQueuedLock(PsUserLockLock);
-    while (Parameters->Value != 0) {
-        FoundNode = RtlRedBlackTreeSearch(&PsUserLockTree, &(Lock.TreeNode));
-        if (FoundNode == NULL) {
-            break;
-        }
-
-        //
-        // Remove it from the tree first. The locks are stack allocated, so as
-        // soon as the thread is made ready the memory could go invalid.
-        //
-
-        FoundLock = RED_BLACK_TREE_VALUE(FoundNode, USER_LOCK, TreeNode);
-        RtlRedBlackTreeRemove(&PsUserLockTree, FoundNode);
-        ObSignalQueue(&(FoundLock->WaitQueue), SignalOptionSignalAll);
-
-        //
-        // The object can go away as soon as it's known to be removed from the
-        // tree. Make sure this thread is done touching the object before
-        // indicating to the woken thread that it can destroy this memory.
-        //
-
-        FoundNode->Parent = NULL;
-        ProcessesReleased += 1;
-        if (Parameters->Value != MAX_ULONG) {
-            Parameters->Value -= 1;
-        }
-    }
-
+    ProcessesReleased = PspWakeUserLockWaiters(&Lock, Parameters->Value);
     KeReleaseQueuedLock(PsUserLockLock);
     PspReleaseUserLockObject(&Lock);
     Parameters->Value = ProcessesReleased;
@@ -429,6 +414,176 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+PspUserLockRequeue (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes up the given number of threads blocked on a user mode
+    address, and moves all the remaining waiters over to wait on a second
+    address. Condition variables use this on broadcast so that all waiters but
+    one are woken one at a time as the associated mutex is released, rather
+    than all at once to fight over the mutex.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the requeue parameters.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the two addresses are the same, or are not
+    backed by the same object.
+
+    Other error codes if an address could not be resolved.
+
+--*/
+
+{
+
+    PUSER_LOCK FoundLock;
+    PRED_BLACK_TREE_NODE FoundNode;
+    USER_LOCK Lock;
+    BOOL Private;
+    ULONG ProcessesReleased;
+    KSTATUS Status;
+    USER_LOCK TargetLock;
+
+    Private = FALSE;
+    if ((Parameters->Operation & USER_LOCK_PRIVATE) != 0) {
+        Private = TRUE;
+    }
+
+    Status = PspInitializeUserLock(Parameters->Address, Private, &Lock);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Status = PspInitializeUserLock(Parameters->RequeueAddress,
+                                   Private,
+                                   &TargetLock);
+
+    if (!KSUCCESS(Status)) {
+        goto UserLockRequeueEnd;
+    }
+
+    //
+    // Each waiter holds its own reference on the object backing its lock, so
+    // waiters can only be moved to another offset within that same object.
+    //
+
+    if ((TargetLock.Type != Lock.Type) ||
+        (TargetLock.Object != Lock.Object) ||
+        (TargetLock.Offset == Lock.Offset)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto UserLockRequeueEnd;
+    }
+
+    KeAcquireQueuedLock(PsUserLockLock);
+    ProcessesReleased = PspWakeUserLockWaiters(&Lock, Parameters->Value);
+
+    //
+    // Move everyone else over to the target address. The waiters are still
+    // asleep, and only touch their tree node with the user lock lock held, so
+    // it is safe to change their keys here.
+    //
+
+    while (TRUE) {
+        FoundNode = RtlRedBlackTreeSearch(&PsUserLockTree, &(Lock.TreeNode));
+        if (FoundNode == NULL) {
+            break;
+        }
+
+        FoundLock = RED_BLACK_TREE_VALUE(FoundNode, USER_LOCK, TreeNode);
+        RtlRedBlackTreeRemove(&PsUserLockTree, FoundNode);
+        FoundLock->Offset = TargetLock.Offset;
+        RtlRedBlackTreeInsert(&PsUserLockTree, FoundNode);
+    }
+
+    KeReleaseQueuedLock(PsUserLockLock);
+    Parameters->Value = ProcessesReleased;
+    Status = STATUS_SUCCESS;
+
+UserLockRequeueEnd:
+    if (TargetLock.Object != NULL) {
+        PspReleaseUserLockObject(&TargetLock);
+    }
+
+    PspReleaseUserLockObject(&Lock);
+    return Status;
+}
+
+ULONG
+PspWakeUserLockWaiters (
+    PUSER_LOCK Lock,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes up threads blocked on the given user lock. This routine
+    assumes the user lock lock is already held.
+
+Arguments:
+
+    Lock - Supplies a pointer to an initialized user lock describing the
+        address to wake threads on.
+
+    Count - Supplies the maximum number of threads to wake. Supply MAX_ULONG
+        to wake all of them.
+
+Return Value:
+
+    Returns the number of threads woken.
+
+--*/
+
+{
+
+    PUSER_LOCK FoundLock;
+    PRED_BLACK_TREE_NODE FoundNode;
+    ULONG ProcessesReleased;
+
+    ProcessesReleased = 0;
+    while (Count != 0) {
+        FoundNode = RtlRedBlackTreeSearch(&PsUserLockTree, &(Lock->TreeNode));
+        if (FoundNode == NULL) {
+            break;
+        }
+
+        //
+        // Remove it from the tree first. The locks are stack allocated, so as
+        // soon as the thread is made ready the memory could go invalid.
+        //
+
+        FoundLock = RED_BLACK_TREE_VALUE(FoundNode, USER_LOCK, TreeNode);
+        RtlRedBlackTreeRemove(&PsUserLockTree, FoundNode);
+        ObSignalQueue(&(FoundLock->WaitQueue), SignalOptionSignalAll);
+
+        //
+        // The object can go away as soon as it's known to be removed from the
+        // tree. Make sure this thread is done touching the object before
+        // indicating to the woken thread that it can destroy this memory.
+        //
+
+        FoundNode->Parent = NULL;
+        ProcessesReleased += 1;
+        if (Count != MAX_ULONG) {
+            Count -= 1;
+        }
+    }
+
+    return ProcessesReleased;
+}
+
 KSTATUS
 PspInitializeUserLock (
     PVOID Address,
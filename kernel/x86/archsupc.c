@@ -105,6 +105,17 @@ Return Value:
         Data->ProcessorFeatures |= X86_FEATURE_I686;
     }
 
+    //
+    // SSE2 is only usable if the XMM registers are saved across context
+    // switches, which happens when the processor supports fxsave.
+    //
+
+    if (((Edx & X86_CPUID_BASIC_EDX_SSE2) != 0) &&
+        ((Edx & X86_CPUID_BASIC_EDX_FX_SAVE_RESTORE) != 0)) {
+
+        Data->ProcessorFeatures |= X86_FEATURE_SSE2;
+    }
+
     //
     // In 32-bit mode, shoot for sysenter, and then syscall. (Note that in
     // long mode, syscall is just assumed to be present architecturally).
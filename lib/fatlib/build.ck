@@ -36,6 +36,7 @@ function build() {
     var sources;
 
     sources = [
+        "dirindex.c",
         "fat.c",
         "fatcache.c",
         "fatsup.c",
@@ -0,0 +1,1572 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    dirindex.c
+
+Abstract:
+
+    This module implements the in-memory hashed directory index, which maps
+    file names to directory entry offsets so that lookups in large directories
+    do not need to scan and decode every entry.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel, Boot, Build
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/fat/fatlib.h>
+#include <minoca/lib/fat/fat.h>
+#include "fatlibp.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the maximum number of directories to keep an index for per volume.
+// The least recently used index is evicted when a new one is built.
+//
+
+#define FAT_DIRECTORY_INDEX_CACHE_SIZE 32
+
+//
+// Define the initial number of hash buckets in a directory index. The table
+// doubles whenever it averages more than two entries per bucket.
+//
+
+#define FAT_DIRECTORY_INDEX_INITIAL_BUCKETS 64
+
+//
+// Define the maximum number of free spans remembered per directory. Spans
+// beyond this are forgotten, and new entries go at the end of the directory.
+//
+
+#define FAT_DIRECTORY_INDEX_MAX_FREE_SPANS 256
+
+//
+// Define the FNV-1a hash constants.
+//
+
+#define FAT_NAME_HASH_OFFSET_BASIS 0x811C9DC5
+#define FAT_NAME_HASH_PRIME 0x01000193
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores a single named entry in a directory index.
+
+Members:
+
+    NameNext - Stores a pointer to the next entry in the same name hash bucket.
+
+    OffsetNext - Stores a pointer to the next entry in the same offset hash
+        bucket.
+
+    NameHash - Stores the hash of the case-folded name.
+
+    NameSize - Stores the size of the name in bytes, including the null
+        terminator.
+
+    Offset - Stores the directory offset of the entry's short directory entry.
+
+    Name - Stores the name of the entry as it decodes from the directory.
+
+--*/
+
+typedef struct _FAT_DIRECTORY_INDEX_ENTRY FAT_DIRECTORY_INDEX_ENTRY;
+typedef struct _FAT_DIRECTORY_INDEX_ENTRY *PFAT_DIRECTORY_INDEX_ENTRY;
+struct _FAT_DIRECTORY_INDEX_ENTRY {
+    PFAT_DIRECTORY_INDEX_ENTRY NameNext;
+    PFAT_DIRECTORY_INDEX_ENTRY OffsetNext;
+    ULONG NameHash;
+    ULONG NameSize;
+    ULONGLONG Offset;
+    CHAR Name[ANYSIZE_ARRAY];
+};
+
+/*++
+
+Structure Description:
+
+    This structure stores a run of erased directory entries that can be
+    reused.
+
+Members:
+
+    Offset - Stores the directory offset of the first erased entry.
+
+    Count - Stores the number of consecutive erased entries.
+
+--*/
+
+typedef struct _FAT_DIRECTORY_FREE_SPAN {
+    ULONGLONG Offset;
+    ULONG Count;
+} FAT_DIRECTORY_FREE_SPAN, *PFAT_DIRECTORY_FREE_SPAN;
+
+/*++
+
+Structure Description:
+
+    This structure stores the index for a single directory.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous indices on the
+        volume, in most recently used order.
+
+    DirectoryCluster - Stores the first cluster of the directory, its file ID.
+
+    NameBuckets - Stores the hash table of entries keyed by case-folded name.
+
+    OffsetBuckets - Stores the hash table of the same entries keyed by
+        directory offset.
+
+    BucketCount - Stores the number of buckets in each hash table. This is
+        always a power of two.
+
+    EntryCount - Stores the number of entries in the index.
+
+    FreeSpans - Stores an array of runs of erased entries, sorted by offset.
+
+    FreeSpanCount - Stores the number of valid elements in the free span
+        array.
+
+    FreeSpanCapacity - Stores the number of elements the free span array can
+        hold.
+
+    EndOffset - Stores the directory offset of the terminating entry, or of
+        the end of the directory file if there is none.
+
+--*/
+
+typedef struct _FAT_DIRECTORY_INDEX {
+    LIST_ENTRY ListEntry;
+    ULONG DirectoryCluster;
+    PFAT_DIRECTORY_INDEX_ENTRY *NameBuckets;
+    PFAT_DIRECTORY_INDEX_ENTRY *OffsetBuckets;
+    ULONG BucketCount;
+    ULONG EntryCount;
+    PFAT_DIRECTORY_FREE_SPAN FreeSpans;
+    ULONG FreeSpanCount;
+    ULONG FreeSpanCapacity;
+    ULONGLONG EndOffset;
+} FAT_DIRECTORY_INDEX, *PFAT_DIRECTORY_INDEX;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+FatpBuildDirectoryIndex (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_CONTEXT Directory,
+    PFAT_DIRECTORY_INDEX *NewIndex
+    );
+
+VOID
+FatpDestroyDirectoryIndex (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index
+    );
+
+PFAT_DIRECTORY_INDEX
+FatpFindDirectoryIndex (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster
+    );
+
+KSTATUS
+FatpAddDirectoryIndexEntry (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    PCSTR Name,
+    ULONG NameSize,
+    ULONGLONG Offset
+    );
+
+VOID
+FatpResizeDirectoryIndex (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONG BucketCount
+    );
+
+VOID
+FatpAddDirectoryFreeSpan (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONGLONG Offset,
+    ULONG Count
+    );
+
+VOID
+FatpRemoveDirectoryFreeSpan (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONGLONG Offset,
+    ULONG Count
+    );
+
+BOOL
+FatpInsertDirectoryFreeSpan (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONG SpanIndex,
+    ULONGLONG Offset,
+    ULONG Count
+    );
+
+VOID
+FatpDeleteDirectoryFreeSpan (
+    PFAT_DIRECTORY_INDEX Index,
+    ULONG SpanIndex
+    );
+
+ULONG
+FatpHashDirectoryName (
+    PCSTR Name,
+    ULONG NameSize
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VOID
+FatpInitializeDirectoryIndexCache (
+    PFAT_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the directory index cache for the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    INITIALIZE_LIST_HEAD(&(Volume->DirectoryIndexList));
+    Volume->DirectoryIndexCount = 0;
+    return;
+}
+
+VOID
+FatpDestroyDirectoryIndexCache (
+    PFAT_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys every directory index on the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PFAT_DIRECTORY_INDEX Index;
+
+    //
+    // The lock isn't acquired because the volume is being destroyed, so no one
+    // should be doing any accesses.
+    //
+
+    while (!LIST_EMPTY(&(Volume->DirectoryIndexList))) {
+        Index = LIST_VALUE(Volume->DirectoryIndexList.Next,
+                           FAT_DIRECTORY_INDEX,
+                           ListEntry);
+
+        LIST_REMOVE(&(Index->ListEntry));
+        FatpDestroyDirectoryIndex(Volume, Index);
+    }
+
+    Volume->DirectoryIndexCount = 0;
+    return;
+}
+
+KSTATUS
+FatpDirectoryIndexLookup (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_CONTEXT Directory,
+    PCSTR Name,
+    ULONG NameLength,
+    PFAT_DIRECTORY_ENTRY Entry,
+    PULONGLONG EntryOffset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up a name in the directory's index, building the index
+    first if the directory does not have one yet.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Directory - Supplies a pointer to the directory context for the open
+        directory. Its position is not preserved.
+
+    Name - Supplies the name of the file or directory to look up.
+
+    NameLength - Supplies the size of the name buffer in bytes, including the
+        null terminator.
+
+    Entry - Supplies a pointer where the short directory entry will be
+        returned.
+
+    EntryOffset - Supplies a pointer where the directory offset of the short
+        entry will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if the entry was found.
+
+    STATUS_PATH_NOT_FOUND if the index shows no such entry exists.
+
+    Other error codes if the index is unavailable, in which case the caller
+    should scan the directory.
+
+--*/
+
+{
+
+    PFAT_DIRECTORY_INDEX_ENTRY Candidate;
+    ULONG DirectoryCluster;
+    ULONG EntriesRead;
+    ULONG Hash;
+    PFAT_DIRECTORY_INDEX Index;
+    PFAT_DIRECTORY_INDEX NewIndex;
+    ULONGLONG Offset;
+    KSTATUS Status;
+
+    DirectoryCluster = Directory->File->FirstCluster;
+    Hash = FatpHashDirectoryName(Name, NameLength);
+    NewIndex = NULL;
+    FatAcquireLock(Volume->Lock);
+    Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+    if (Index == NULL) {
+
+        //
+        // Build the index with the lock released, since reading the directory
+        // needs the volume lock.
+        //
+
+        FatReleaseLock(Volume->Lock);
+        Status = FatpBuildDirectoryIndex(Volume, Directory, &NewIndex);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        NewIndex->DirectoryCluster = DirectoryCluster;
+        FatAcquireLock(Volume->Lock);
+        Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+        if (Index == NULL) {
+            if (Volume->DirectoryIndexCount >= FAT_DIRECTORY_INDEX_CACHE_SIZE) {
+                Index = LIST_VALUE(Volume->DirectoryIndexList.Previous,
+                                   FAT_DIRECTORY_INDEX,
+                                   ListEntry);
+
+                LIST_REMOVE(&(Index->ListEntry));
+                Volume->DirectoryIndexCount -= 1;
+                FatpDestroyDirectoryIndex(Volume, Index);
+            }
+
+            Index = NewIndex;
+            NewIndex = NULL;
+            INSERT_AFTER(&(Index->ListEntry), &(Volume->DirectoryIndexList));
+            Volume->DirectoryIndexCount += 1;
+        }
+    }
+
+    //
+    // Find the matching entry at the lowest offset, which is the one a scan
+    // of the directory would find.
+    //
+
+    Offset = -1ULL;
+    Candidate = Index->NameBuckets[Hash & (Index->BucketCount - 1)];
+    while (Candidate != NULL) {
+        if ((Candidate->NameHash == Hash) &&
+            (Candidate->NameSize <= NameLength) &&
+            (Candidate->Offset < Offset) &&
+            (RtlAreStringsEqual(Name, Candidate->Name, NameLength - 1) !=
+             FALSE)) {
+
+            Offset = Candidate->Offset;
+        }
+
+        Candidate = Candidate->NameNext;
+    }
+
+    FatReleaseLock(Volume->Lock);
+    if (NewIndex != NULL) {
+        FatpDestroyDirectoryIndex(Volume, NewIndex);
+    }
+
+    if (Offset == -1ULL) {
+        return STATUS_PATH_NOT_FOUND;
+    }
+
+    //
+    // Read in the short entry, and make sure it is still a live entry. If
+    // not, the index has gone stale, so throw it out and let the caller scan.
+    //
+
+    Status = FatpDirectorySeek(Directory, Offset);
+    if (KSUCCESS(Status)) {
+        Status = FatpReadDirectory(Directory, Entry, 1, &EntriesRead);
+    }
+
+    if ((KSUCCESS(Status)) &&
+        ((EntriesRead != 1) ||
+         (Entry->DosName[0] == FAT_DIRECTORY_ENTRY_END) ||
+         (Entry->DosName[0] == FAT_DIRECTORY_ENTRY_ERASED) ||
+         (Entry->FileAttributes == FAT_LONG_FILE_NAME_ATTRIBUTES) ||
+         ((Entry->FileAttributes & FAT_VOLUME_LABEL) != 0))) {
+
+        RtlDebugPrint("FAT: Stale directory index for 0x%x at 0x%I64x.\n",
+                      DirectoryCluster,
+                      Offset);
+
+        FatpInvalidateDirectoryIndex(Volume, DirectoryCluster);
+        Status = STATUS_NOT_FOUND;
+    }
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    *EntryOffset = Offset;
+    return STATUS_SUCCESS;
+}
+
+VOID
+FatpDirectoryIndexGetFreeSlot (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster,
+    ULONG EntryCount,
+    PULONGLONG Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine uses the directory's index to suggest where a new set of
+    directory entries should go. The suggestion is only a hint; the caller
+    must verify the entries on disk as it would for a scan.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+    EntryCount - Supplies the number of consecutive entries needed.
+
+    Offset - Supplies a pointer that on input contains the offset to start
+        searching at if the directory has no index. On output, this returns
+        the offset to start searching at.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PFAT_DIRECTORY_INDEX Index;
+    ULONG SpanIndex;
+
+    FatAcquireLock(Volume->Lock);
+    Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+    if (Index != NULL) {
+        *Offset = Index->EndOffset;
+        for (SpanIndex = 0; SpanIndex < Index->FreeSpanCount; SpanIndex += 1) {
+            if (Index->FreeSpans[SpanIndex].Count >= EntryCount) {
+                *Offset = Index->FreeSpans[SpanIndex].Offset;
+                break;
+            }
+        }
+    }
+
+    FatReleaseLock(Volume->Lock);
+    return;
+}
+
+VOID
+FatpDirectoryIndexInsert (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_CONTEXT Directory,
+    ULONGLONG Offset,
+    ULONG EntryCount,
+    BOOL WroteEndEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a newly written set of directory entries to the
+    directory's index, if it has one.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Directory - Supplies a pointer to the directory context the entries were
+        written through. Its position is not preserved.
+
+    Offset - Supplies the directory offset of the first new entry.
+
+    EntryCount - Supplies the number of entries written, including long name
+        entries.
+
+    WroteEndEntry - Supplies a boolean indicating whether a new terminating
+        entry was written after the new entries.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG DirectoryCluster;
+    FAT_DIRECTORY_ENTRY Entry;
+    ULONG EntriesRead;
+    PFAT_DIRECTORY_INDEX Index;
+    PSTR Name;
+    ULONG NameSize;
+    KSTATUS Status;
+
+    DirectoryCluster = Directory->File->FirstCluster;
+    FatAcquireLock(Volume->Lock);
+    Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+    FatReleaseLock(Volume->Lock);
+    if (Index == NULL) {
+        return;
+    }
+
+    //
+    // Decode the name back out of the directory so that the index holds
+    // exactly what a scan would see.
+    //
+
+    Name = FatAllocatePagedMemory(Volume->Device.DeviceToken,
+                                  FAT_MAX_LONG_FILE_LENGTH + 1);
+
+    if (Name == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto DirectoryIndexInsertEnd;
+    }
+
+    Status = FatpDirectorySeek(Directory, Offset);
+    if (!KSUCCESS(Status)) {
+        goto DirectoryIndexInsertEnd;
+    }
+
+    NameSize = FAT_MAX_LONG_FILE_LENGTH + 1;
+    Status = FatpReadNextDirectoryEntry(Directory,
+                                        NULL,
+                                        Name,
+                                        &NameSize,
+                                        &Entry,
+                                        &EntriesRead);
+
+    if (!KSUCCESS(Status)) {
+        goto DirectoryIndexInsertEnd;
+    }
+
+    if (EntriesRead != EntryCount) {
+        Status = STATUS_VOLUME_CORRUPT;
+        goto DirectoryIndexInsertEnd;
+    }
+
+    FatAcquireLock(Volume->Lock);
+    Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+    if (Index != NULL) {
+        Status = FatpAddDirectoryIndexEntry(Volume,
+                                            Index,
+                                            Name,
+                                            NameSize,
+                                            Offset + EntryCount - 1);
+
+        FatpRemoveDirectoryFreeSpan(Volume, Index, Offset, EntryCount);
+        if ((WroteEndEntry != FALSE) &&
+            (Offset + EntryCount > Index->EndOffset)) {
+
+            Index->EndOffset = Offset + EntryCount;
+        }
+    }
+
+    FatReleaseLock(Volume->Lock);
+
+DirectoryIndexInsertEnd:
+    if (Name != NULL) {
+        FatFreePagedMemory(Volume->Device.DeviceToken, Name);
+    }
+
+    if (!KSUCCESS(Status)) {
+        FatpInvalidateDirectoryIndex(Volume, DirectoryCluster);
+    }
+
+    return;
+}
+
+VOID
+FatpDirectoryIndexRemove (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster,
+    ULONGLONG Offset,
+    ULONG EntryCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an erased entry from the directory's index, if it
+    has one, and records its entries as free.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+    Offset - Supplies the directory offset of the erased short entry.
+
+    EntryCount - Supplies the number of entries erased, including the long
+        name entries directly before the short entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    PFAT_DIRECTORY_INDEX_ENTRY IndexEntry;
+    PFAT_DIRECTORY_INDEX Index;
+    PFAT_DIRECTORY_INDEX_ENTRY *Previous;
+
+    ASSERT(EntryCount != 0);
+
+    IndexEntry = NULL;
+    FatAcquireLock(Volume->Lock);
+    Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+    if (Index == NULL) {
+        goto DirectoryIndexRemoveEnd;
+    }
+
+    Bucket = (ULONG)Offset & (Index->BucketCount - 1);
+    Previous = &(Index->OffsetBuckets[Bucket]);
+    while (*Previous != NULL) {
+        if ((*Previous)->Offset == Offset) {
+            IndexEntry = *Previous;
+            *Previous = IndexEntry->OffsetNext;
+            break;
+        }
+
+        Previous = &((*Previous)->OffsetNext);
+    }
+
+    if (IndexEntry != NULL) {
+        Bucket = IndexEntry->NameHash & (Index->BucketCount - 1);
+        Previous = &(Index->NameBuckets[Bucket]);
+        while (*Previous != IndexEntry) {
+
+            ASSERT(*Previous != NULL);
+
+            Previous = &((*Previous)->NameNext);
+        }
+
+        *Previous = IndexEntry->NameNext;
+        Index->EntryCount -= 1;
+    }
+
+    FatpAddDirectoryFreeSpan(Volume,
+                             Index,
+                             Offset - (EntryCount - 1),
+                             EntryCount);
+
+DirectoryIndexRemoveEnd:
+    FatReleaseLock(Volume->Lock);
+    if (IndexEntry != NULL) {
+        FatFreePagedMemory(Volume->Device.DeviceToken, IndexEntry);
+    }
+
+    return;
+}
+
+VOID
+FatpInvalidateDirectoryIndex (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster
+    )
+
+/*++
+
+Routine Description:
+
+    This routine throws away the index for the given directory, if there is
+    one. It will be rebuilt on the next lookup.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PFAT_DIRECTORY_INDEX Index;
+
+    FatAcquireLock(Volume->Lock);
+    Index = FatpFindDirectoryIndex(Volume, DirectoryCluster);
+    if (Index != NULL) {
+        LIST_REMOVE(&(Index->ListEntry));
+        Volume->DirectoryIndexCount -= 1;
+    }
+
+    FatReleaseLock(Volume->Lock);
+    if (Index != NULL) {
+        FatpDestroyDirectoryIndex(Volume, Index);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+FatpBuildDirectoryIndex (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_CONTEXT Directory,
+    PFAT_DIRECTORY_INDEX *NewIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine scans a directory and builds its index.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Directory - Supplies a pointer to the directory context. Its position is
+        not preserved.
+
+    NewIndex - Supplies a pointer where the new index will be returned on
+        success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    FAT_DIRECTORY_ENTRY Entry;
+    ULONG EntriesRead;
+    PFAT_DIRECTORY_INDEX Index;
+    PSTR Name;
+    ULONG NameSize;
+    ULONGLONG Offset;
+    ULONGLONG SpanOffset;
+    KSTATUS Status;
+
+    Name = NULL;
+    Index = FatAllocatePagedMemory(Volume->Device.DeviceToken,
+                                   sizeof(FAT_DIRECTORY_INDEX));
+
+    if (Index == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto BuildDirectoryIndexEnd;
+    }
+
+    RtlZeroMemory(Index, sizeof(FAT_DIRECTORY_INDEX));
+    AllocationSize = 2 * FAT_DIRECTORY_INDEX_INITIAL_BUCKETS *
+                     sizeof(PFAT_DIRECTORY_INDEX_ENTRY);
+
+    Index->NameBuckets = FatAllocatePagedMemory(Volume->Device.DeviceToken,
+                                                AllocationSize);
+
+    if (Index->NameBuckets == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto BuildDirectoryIndexEnd;
+    }
+
+    RtlZeroMemory(Index->NameBuckets, AllocationSize);
+    Index->OffsetBuckets = Index->NameBuckets +
+                           FAT_DIRECTORY_INDEX_INITIAL_BUCKETS;
+
+    Index->BucketCount = FAT_DIRECTORY_INDEX_INITIAL_BUCKETS;
+    Name = FatAllocatePagedMemory(Volume->Device.DeviceToken,
+                                  FAT_MAX_LONG_FILE_LENGTH + 1);
+
+    if (Name == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto BuildDirectoryIndexEnd;
+    }
+
+    //
+    // Make one pass decoding every name in the directory.
+    //
+
+    Offset = DIRECTORY_CONTENTS_OFFSET;
+    Status = FatpDirectorySeek(Directory, Offset);
+    if (!KSUCCESS(Status)) {
+        goto BuildDirectoryIndexEnd;
+    }
+
+    while (TRUE) {
+        NameSize = FAT_MAX_LONG_FILE_LENGTH + 1;
+        Status = FatpReadNextDirectoryEntry(Directory,
+                                            NULL,
+                                            Name,
+                                            &NameSize,
+                                            &Entry,
+                                            &EntriesRead);
+
+        if (Status == STATUS_END_OF_FILE) {
+            break;
+
+        } else if (!KSUCCESS(Status)) {
+            goto BuildDirectoryIndexEnd;
+        }
+
+        Offset += EntriesRead;
+        Status = FatpAddDirectoryIndexEntry(Volume,
+                                            Index,
+                                            Name,
+                                            NameSize,
+                                            Offset - 1);
+
+        if (!KSUCCESS(Status)) {
+            goto BuildDirectoryIndexEnd;
+        }
+    }
+
+    //
+    // Make a second pass over the raw entries to find the runs of erased
+    // entries and the end of the directory.
+    //
+
+    Offset = DIRECTORY_CONTENTS_OFFSET;
+    Status = FatpDirectorySeek(Directory, Offset);
+    if (!KSUCCESS(Status)) {
+        goto BuildDirectoryIndexEnd;
+    }
+
+    SpanOffset = -1ULL;
+    while (TRUE) {
+        Status = FatpReadDirectory(Directory, &Entry, 1, &EntriesRead);
+        if (Status == STATUS_END_OF_FILE) {
+            break;
+
+        } else if (!KSUCCESS(Status)) {
+            goto BuildDirectoryIndexEnd;
+        }
+
+        if ((EntriesRead == 0) ||
+            (Entry.DosName[0] == FAT_DIRECTORY_ENTRY_END)) {
+
+            break;
+        }
+
+        if (Entry.DosName[0] == FAT_DIRECTORY_ENTRY_ERASED) {
+            if (SpanOffset == -1ULL) {
+                SpanOffset = Offset;
+            }
+
+        } else if (SpanOffset != -1ULL) {
+            FatpAddDirectoryFreeSpan(Volume,
+                                     Index,
+                                     SpanOffset,
+                                     Offset - SpanOffset);
+
+            SpanOffset = -1ULL;
+        }
+
+        Offset += 1;
+    }
+
+    if (SpanOffset != -1ULL) {
+        FatpAddDirectoryFreeSpan(Volume,
+                                 Index,
+                                 SpanOffset,
+                                 Offset - SpanOffset);
+    }
+
+    Index->EndOffset = Offset;
+    Status = STATUS_SUCCESS;
+
+BuildDirectoryIndexEnd:
+    if (Name != NULL) {
+        FatFreePagedMemory(Volume->Device.DeviceToken, Name);
+    }
+
+    if (!KSUCCESS(Status)) {
+        if (Index != NULL) {
+            FatpDestroyDirectoryIndex(Volume, Index);
+            Index = NULL;
+        }
+    }
+
+    *NewIndex = Index;
+    return Status;
+}
+
+VOID
+FatpDestroyDirectoryIndex (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a directory index. It must already be off the volume's
+    list.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Index - Supplies a pointer to the index to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    PVOID DeviceToken;
+    PFAT_DIRECTORY_INDEX_ENTRY Entry;
+    PFAT_DIRECTORY_INDEX_ENTRY NextEntry;
+
+    DeviceToken = Volume->Device.DeviceToken;
+    if (Index->NameBuckets != NULL) {
+        for (Bucket = 0; Bucket < Index->BucketCount; Bucket += 1) {
+            Entry = Index->NameBuckets[Bucket];
+            while (Entry != NULL) {
+                NextEntry = Entry->NameNext;
+                FatFreePagedMemory(DeviceToken, Entry);
+                Entry = NextEntry;
+            }
+        }
+
+        FatFreePagedMemory(DeviceToken, Index->NameBuckets);
+    }
+
+    if (Index->FreeSpans != NULL) {
+        FatFreePagedMemory(DeviceToken, Index->FreeSpans);
+    }
+
+    FatFreePagedMemory(DeviceToken, Index);
+    return;
+}
+
+PFAT_DIRECTORY_INDEX
+FatpFindDirectoryIndex (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the index for the given directory and marks it most
+    recently used. The volume lock must be held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+Return Value:
+
+    Returns a pointer to the index on success.
+
+    NULL if the directory has no index.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PFAT_DIRECTORY_INDEX Index;
+
+    CurrentEntry = Volume->DirectoryIndexList.Next;
+    while (CurrentEntry != &(Volume->DirectoryIndexList)) {
+        Index = LIST_VALUE(CurrentEntry, FAT_DIRECTORY_INDEX, ListEntry);
+        if (Index->DirectoryCluster == DirectoryCluster) {
+            if (CurrentEntry != Volume->DirectoryIndexList.Next) {
+                LIST_REMOVE(CurrentEntry);
+                INSERT_AFTER(CurrentEntry, &(Volume->DirectoryIndexList));
+            }
+
+            return Index;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+    }
+
+    return NULL;
+}
+
+KSTATUS
+FatpAddDirectoryIndexEntry (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    PCSTR Name,
+    ULONG NameSize,
+    ULONGLONG Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a name to a directory index.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Index - Supplies a pointer to the index.
+
+    Name - Supplies a pointer to the name.
+
+    NameSize - Supplies the size of the name in bytes, including the null
+        terminator.
+
+    Offset - Supplies the directory offset of the entry's short entry.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    PFAT_DIRECTORY_INDEX_ENTRY Entry;
+
+    ASSERT(NameSize != 0);
+
+    Entry = FatAllocatePagedMemory(Volume->Device.DeviceToken,
+                                   sizeof(FAT_DIRECTORY_INDEX_ENTRY) +
+                                   NameSize);
+
+    if (Entry == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Entry->NameHash = FatpHashDirectoryName(Name, NameSize);
+    Entry->NameSize = NameSize;
+    Entry->Offset = Offset;
+    RtlCopyMemory(Entry->Name, Name, NameSize - 1);
+    Entry->Name[NameSize - 1] = '\0';
+    if (Index->EntryCount >= Index->BucketCount * 2) {
+        FatpResizeDirectoryIndex(Volume, Index, Index->BucketCount * 2);
+    }
+
+    Bucket = Entry->NameHash & (Index->BucketCount - 1);
+    Entry->NameNext = Index->NameBuckets[Bucket];
+    Index->NameBuckets[Bucket] = Entry;
+    Bucket = (ULONG)Offset & (Index->BucketCount - 1);
+    Entry->OffsetNext = Index->OffsetBuckets[Bucket];
+    Index->OffsetBuckets[Bucket] = Entry;
+    Index->EntryCount += 1;
+    return STATUS_SUCCESS;
+}
+
+VOID
+FatpResizeDirectoryIndex (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONG BucketCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine rehashes a directory index into a new number of buckets. On
+    allocation failure the index is left as it was.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Index - Supplies a pointer to the index.
+
+    BucketCount - Supplies the new number of buckets, a power of two.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    ULONG Bucket;
+    PFAT_DIRECTORY_INDEX_ENTRY Entry;
+    PFAT_DIRECTORY_INDEX_ENTRY *NameBuckets;
+    ULONG NewBucket;
+    PFAT_DIRECTORY_INDEX_ENTRY NextEntry;
+    PFAT_DIRECTORY_INDEX_ENTRY *OffsetBuckets;
+
+    ASSERT(POWER_OF_2(BucketCount));
+
+    AllocationSize = 2 * BucketCount * sizeof(PFAT_DIRECTORY_INDEX_ENTRY);
+    NameBuckets = FatAllocatePagedMemory(Volume->Device.DeviceToken,
+                                         AllocationSize);
+
+    if (NameBuckets == NULL) {
+        return;
+    }
+
+    RtlZeroMemory(NameBuckets, AllocationSize);
+    OffsetBuckets = NameBuckets + BucketCount;
+    for (Bucket = 0; Bucket < Index->BucketCount; Bucket += 1) {
+        Entry = Index->NameBuckets[Bucket];
+        while (Entry != NULL) {
+            NextEntry = Entry->NameNext;
+            NewBucket = Entry->NameHash & (BucketCount - 1);
+            Entry->NameNext = NameBuckets[NewBucket];
+            NameBuckets[NewBucket] = Entry;
+            NewBucket = (ULONG)Entry->Offset & (BucketCount - 1);
+            Entry->OffsetNext = OffsetBuckets[NewBucket];
+            OffsetBuckets[NewBucket] = Entry;
+            Entry = NextEntry;
+        }
+    }
+
+    FatFreePagedMemory(Volume->Device.DeviceToken, Index->NameBuckets);
+    Index->NameBuckets = NameBuckets;
+    Index->OffsetBuckets = OffsetBuckets;
+    Index->BucketCount = BucketCount;
+    return;
+}
+
+VOID
+FatpAddDirectoryFreeSpan (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONGLONG Offset,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records a run of erased entries in a directory index,
+    merging it with any neighboring runs.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Index - Supplies a pointer to the index.
+
+    Offset - Supplies the directory offset of the first erased entry.
+
+    Count - Supplies the number of erased entries.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PFAT_DIRECTORY_FREE_SPAN Next;
+    PFAT_DIRECTORY_FREE_SPAN Previous;
+    ULONG SpanIndex;
+
+    //
+    // Find the first span that starts after this one.
+    //
+
+    SpanIndex = 0;
+    while ((SpanIndex < Index->FreeSpanCount) &&
+           (Index->FreeSpans[SpanIndex].Offset <= Offset)) {
+
+        SpanIndex += 1;
+    }
+
+    Previous = NULL;
+    if (SpanIndex != 0) {
+        Previous = &(Index->FreeSpans[SpanIndex - 1]);
+        if (Previous->Offset + Previous->Count >= Offset + Count) {
+            return;
+        }
+
+        if (Previous->Offset + Previous->Count >= Offset) {
+            Previous->Count = Offset + Count - Previous->Offset;
+
+        } else {
+            Previous = NULL;
+        }
+    }
+
+    if (Previous == NULL) {
+        if (FatpInsertDirectoryFreeSpan(Volume,
+                                        Index,
+                                        SpanIndex,
+                                        Offset,
+                                        Count) == FALSE) {
+
+            return;
+        }
+
+        Previous = &(Index->FreeSpans[SpanIndex]);
+        SpanIndex += 1;
+    }
+
+    //
+    // Absorb any following spans that now touch this one.
+    //
+
+    while (SpanIndex < Index->FreeSpanCount) {
+        Next = &(Index->FreeSpans[SpanIndex]);
+        if (Next->Offset > Previous->Offset + Previous->Count) {
+            break;
+        }
+
+        if (Next->Offset + Next->Count > Previous->Offset + Previous->Count) {
+            Previous->Count = Next->Offset + Next->Count - Previous->Offset;
+        }
+
+        FatpDeleteDirectoryFreeSpan(Index, SpanIndex);
+    }
+
+    return;
+}
+
+VOID
+FatpRemoveDirectoryFreeSpan (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONGLONG Offset,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a range of entries that are now in use from the free
+    runs of a directory index.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Index - Supplies a pointer to the index.
+
+    Offset - Supplies the directory offset of the first entry now in use.
+
+    Count - Supplies the number of entries now in use.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG End;
+    PFAT_DIRECTORY_FREE_SPAN Span;
+    ULONGLONG SpanEnd;
+    ULONG SpanIndex;
+
+    End = Offset + Count;
+    SpanIndex = 0;
+    while (SpanIndex < Index->FreeSpanCount) {
+        Span = &(Index->FreeSpans[SpanIndex]);
+        SpanEnd = Span->Offset + Span->Count;
+        if ((SpanEnd <= Offset) || (Span->Offset >= End)) {
+            SpanIndex += 1;
+            continue;
+        }
+
+        //
+        // If the used range is in the middle of the span, split it. If there
+        // is no room for the second half, it is forgotten.
+        //
+
+        if ((Span->Offset < Offset) && (SpanEnd > End)) {
+            Span->Count = Offset - Span->Offset;
+            FatpInsertDirectoryFreeSpan(Volume,
+                                        Index,
+                                        SpanIndex + 1,
+                                        End,
+                                        SpanEnd - End);
+
+            break;
+        }
+
+        if (Span->Offset < Offset) {
+            Span->Count = Offset - Span->Offset;
+            SpanIndex += 1;
+
+        } else if (SpanEnd > End) {
+            Span->Count = SpanEnd - End;
+            Span->Offset = End;
+            SpanIndex += 1;
+
+        } else {
+            FatpDeleteDirectoryFreeSpan(Index, SpanIndex);
+        }
+    }
+
+    return;
+}
+
+BOOL
+FatpInsertDirectoryFreeSpan (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_INDEX Index,
+    ULONG SpanIndex,
+    ULONGLONG Offset,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine inserts a new element into the free span array of a
+    directory index, growing the array if needed.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Index - Supplies a pointer to the index.
+
+    SpanIndex - Supplies the array index to insert at.
+
+    Offset - Supplies the directory offset of the first erased entry.
+
+    Count - Supplies the number of erased entries.
+
+Return Value:
+
+    TRUE if the span was inserted.
+
+    FALSE if the array is full or could not be grown.
+
+--*/
+
+{
+
+    ULONG Capacity;
+    ULONG MoveIndex;
+    PFAT_DIRECTORY_FREE_SPAN NewSpans;
+
+    if (Index->FreeSpanCount == Index->FreeSpanCapacity) {
+        if (Index->FreeSpanCapacity >= FAT_DIRECTORY_INDEX_MAX_FREE_SPANS) {
+            return FALSE;
+        }
+
+        Capacity = Index->FreeSpanCapacity * 2;
+        if (Capacity == 0) {
+            Capacity = 8;
+        }
+
+        NewSpans = FatAllocatePagedMemory(
+                                    Volume->Device.DeviceToken,
+                                    Capacity * sizeof(FAT_DIRECTORY_FREE_SPAN));
+
+        if (NewSpans == NULL) {
+            return FALSE;
+        }
+
+        if (Index->FreeSpans != NULL) {
+            RtlCopyMemory(NewSpans,
+                          Index->FreeSpans,
+                          Index->FreeSpanCount *
+                          sizeof(FAT_DIRECTORY_FREE_SPAN));
+
+            FatFreePagedMemory(Volume->Device.DeviceToken, Index->FreeSpans);
+        }
+
+        Index->FreeSpans = NewSpans;
+        Index->FreeSpanCapacity = Capacity;
+    }
+
+    for (MoveIndex = Index->FreeSpanCount;
+         MoveIndex > SpanIndex;
+         MoveIndex -= 1) {
+
+        Index->FreeSpans[MoveIndex] = Index->FreeSpans[MoveIndex - 1];
+    }
+
+    Index->FreeSpans[SpanIndex].Offset = Offset;
+    Index->FreeSpans[SpanIndex].Count = Count;
+    Index->FreeSpanCount += 1;
+    return TRUE;
+}
+
+VOID
+FatpDeleteDirectoryFreeSpan (
+    PFAT_DIRECTORY_INDEX Index,
+    ULONG SpanIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an element from the free span array of a directory
+    index.
+
+Arguments:
+
+    Index - Supplies a pointer to the index.
+
+    SpanIndex - Supplies the array index to remove.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(SpanIndex < Index->FreeSpanCount);
+
+    Index->FreeSpanCount -= 1;
+    while (SpanIndex < Index->FreeSpanCount) {
+        Index->FreeSpans[SpanIndex] = Index->FreeSpans[SpanIndex + 1];
+        SpanIndex += 1;
+    }
+
+    return;
+}
+
+ULONG
+FatpHashDirectoryName (
+    PCSTR Name,
+    ULONG NameSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the hash of a case-folded file name.
+
+Arguments:
+
+    Name - Supplies a pointer to the name, which may not be null terminated.
+
+    NameSize - Supplies the size of the name buffer in bytes, including space
+        for a null terminator.
+
+Return Value:
+
+    Returns the hash of the name.
+
+--*/
+
+{
+
+    ULONG Hash;
+    ULONG Index;
+
+    Hash = FAT_NAME_HASH_OFFSET_BASIS;
+    for (Index = 0; Index + 1 < NameSize; Index += 1) {
+        if (Name[Index] == '\0') {
+            break;
+        }
+
+        Hash ^= (UCHAR)RtlConvertCharacterToLowerCase(Name[Index]);
+        Hash *= FAT_NAME_HASH_PRIME;
+    }
+
+    return Hash;
+}
@@ -89,6 +89,12 @@ FatpPerformFileIo (
     PUINTN BytesCompleted
     );
 
+KSTATUS
+FatpGetFileClusterCount (
+    PFAT_FILE File,
+    PULONG ClusterCount
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -939,6 +945,7 @@ Return Value:
                   sizeof(BLOCK_DEVICE_PARAMETERS));
 
     FatpInitializeFileMappingTree(FatVolume);
+    FatpInitializeDirectoryIndexCache(FatVolume);
     FatVolume->BlockShift =
                           RtlCountTrailingZeros32(FatVolume->Device.BlockSize);
 
@@ -1128,6 +1135,16 @@ Return Value:
         FatVolume->ClusterSearchStart = Information->LastClusterAllocated;
     }
 
+    //
+    // Build the bitmap of allocated clusters so that allocations don't have
+    // to scan the FAT.
+    //
+
+    Status = FatpCreateClusterBitmap(FatVolume);
+    if (!KSUCCESS(Status)) {
+        goto MountEnd;
+    }
+
     Status = STATUS_SUCCESS;
 
 MountEnd:
@@ -1136,6 +1153,7 @@ Return Value:
 
     } else {
         if (FatVolume != NULL) {
+            FatpDestroyClusterBitmap(FatVolume);
             if (FatVolume->Lock != NULL) {
                 FatDestroyLock(FatVolume->Lock);
             }
@@ -1181,8 +1199,10 @@ Return Value:
     PFAT_VOLUME FatVolume;
 
     FatVolume = (PFAT_VOLUME)Volume;
+    FatpDestroyClusterBitmap(FatVolume);
     FatpDestroyFatCache(FatVolume);
     FatpDestroyFileMappingTree(FatVolume);
+    FatpDestroyDirectoryIndexCache(FatVolume);
     FatDestroyLock(FatVolume->Lock);
     FatFreeNonPagedMemory(FatVolume->Device.DeviceToken, FatVolume);
     return STATUS_SUCCESS;
@@ -1229,7 +1249,9 @@ Return Value:
     ULONG CacheDataSize;
     ULONG Cluster;
     ULONG ClusterBad;
+    PVOID ExtentLock;
     PFAT_FILE FatFile;
+    ULONG FileCluster;
     PFAT_VOLUME FatVolume;
     ULONG FirstCluster;
     ULONG PageSize;
@@ -1237,6 +1259,7 @@ Return Value:
     PVOID ScratchIoBufferLock;
     KSTATUS Status;
 
+    ExtentLock = NULL;
     FatFile = NULL;
     FatVolume = (PFAT_VOLUME)Volume;
     ClusterBad = FatVolume->ClusterBad;
@@ -1319,21 +1342,6 @@ Return Value:
             }
         }
 
-        //
-        // Before a page file can be opened for business, all of the FAT
-        // entries for its clusters need to be read in.
-        //
-        // TODO: Lock FAT cache once memory notifications are introduced.
-        //
-
-        Cluster = FirstCluster;
-        while (Cluster < ClusterBad) {
-            Status = FatpGetNextCluster(Volume, 0, Cluster, &Cluster);
-            if (!KSUCCESS(Status)) {
-                goto OpenFileIdEnd;
-            }
-        }
-
         FatFile = FatAllocateNonPagedMemory(FatVolume->Device.DeviceToken,
                                             sizeof(FAT_FILE));
 
@@ -1347,12 +1355,48 @@ Return Value:
         goto OpenFileIdEnd;
     }
 
+    Status = FatCreateLock(&ExtentLock);
+    if (!KSUCCESS(Status)) {
+        goto OpenFileIdEnd;
+    }
+
     RtlZeroMemory(FatFile, sizeof(FAT_FILE));
     FatFile->Volume = FatVolume;
     FatFile->OpenFlags = Flags;
-    FatFile->SeekTable[0] = FirstCluster;
     FatFile->ScratchIoBuffer = ScratchIoBuffer;
     FatFile->ScratchIoBufferLock = ScratchIoBufferLock;
+    FatFile->ExtentLock = ExtentLock;
+    FatpInitializeFileExtents(FatFile, FirstCluster);
+
+    //
+    // Before a page file can be opened for business, all of the FAT entries
+    // for its clusters need to be read in and its extent map built, as
+    // neither can happen on the paging path.
+    //
+    // TODO: Lock FAT cache once memory notifications are introduced.
+    //
+
+    if ((Flags & OPEN_FLAG_PAGE_FILE) != 0) {
+        Cluster = FirstCluster;
+        FileCluster = 0;
+        while (TRUE) {
+            Status = FatpGetNextCluster(Volume, 0, Cluster, &Cluster);
+            if (!KSUCCESS(Status)) {
+                goto OpenFileIdEnd;
+            }
+
+            if ((Cluster < FAT_CLUSTER_BEGIN) || (Cluster >= ClusterBad)) {
+                break;
+            }
+
+            FileCluster += 1;
+            FatpAddFileCluster(FatFile, FileCluster, Cluster);
+            if (FatFile->MappedClusterCount != FileCluster + 1) {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                goto OpenFileIdEnd;
+            }
+        }
+    }
 
     //
     // If this is the root directory and the root directory is outside the
@@ -1378,7 +1422,15 @@ Return Value:
             FatDestroyLock(ScratchIoBufferLock);
         }
 
+        if (ExtentLock != NULL) {
+            FatDestroyLock(ExtentLock);
+        }
+
         if (FatFile != NULL) {
+            if (FatFile->Extents != NULL) {
+                FatpDestroyFileExtents(FatFile);
+            }
+
             if ((Flags & OPEN_FLAG_PAGE_FILE) != 0) {
                 FatFreeNonPagedMemory(FatVolume->Device.DeviceToken, FatFile);
 
@@ -1415,11 +1467,27 @@ Return Value:
 {
 
     PFAT_FILE FatFile;
+    PFAT_VOLUME Volume;
 
     FatFile = (PFAT_FILE)FileToken;
 
     ASSERT(FatFile != NULL);
 
+    //
+    // Give back any clusters that were reserved but never written.
+    //
+
+    if (FatFile->ReservedClusterCount != 0) {
+        Volume = FatFile->Volume;
+        FatAcquireLock(Volume->Lock);
+
+        ASSERT(Volume->ReservedClusterCount >= FatFile->ReservedClusterCount);
+
+        Volume->ReservedClusterCount -= FatFile->ReservedClusterCount;
+        FatFile->ReservedClusterCount = 0;
+        FatReleaseLock(Volume->Lock);
+    }
+
     if (FatFile->ScratchIoBuffer != NULL) {
         FatFreeIoBuffer(FatFile->ScratchIoBuffer);
     }
@@ -1428,6 +1496,8 @@ Return Value:
         FatDestroyLock(FatFile->ScratchIoBufferLock);
     }
 
+    FatpDestroyFileExtents(FatFile);
+    FatDestroyLock(FatFile->ExtentLock);
     if ((FatFile->OpenFlags & OPEN_FLAG_PAGE_FILE) != 0) {
         FatFreeNonPagedMemory(FatFile->Volume->Device.DeviceToken, FatFile);
 
@@ -2057,7 +2127,7 @@ Return Value:
             ShortEntryOffset = EntryOffset + EntriesRead - 1;
             Status = FatpAllocateClusterForEmptyFile(Volume,
                                                      &DirectoryContext,
-                                                     File->SeekTable[0],
+                                                     File->FirstCluster,
                                                      &FatDirectoryEntry,
                                                      ShortEntryOffset);
 
@@ -2643,7 +2713,10 @@ Return Value:
     }
 
     //
-    // It's time to grow the file. Seek to the old end of the file.
+    // It's time to grow the file. Seek to the old end of the file. If the
+    // cluster chain ends before that, the file size covers data whose
+    // clusters have not been allocated yet. Start zeroing from the end of the
+    // chain; the real data lands on top when it is written.
     //
 
     RtlZeroMemory(&Seek, sizeof(FAT_SEEK_INFORMATION));
@@ -2654,6 +2727,11 @@ Return Value:
                          OldSize,
                          &Seek);
 
+    if (Status == STATUS_END_OF_FILE) {
+        OldSize = Seek.FileByteOffset;
+        Status = STATUS_SUCCESS;
+    }
+
     if (!KSUCCESS(Status)) {
         goto TruncateEnd;
     }
@@ -2763,10 +2841,11 @@ Return Value:
     ULONGLONG DiskByteOffset;
     PFAT_FILE File;
     ULONGLONG FileByteOffset;
+    ULONG FileCluster;
+    ULONG MappedFileCluster;
     ULONG PreviousCluster;
-    ULONG PreviousTableIndex;
+    ULONG RunLength;
     KSTATUS Status;
-    ULONG TableIndex;
     PFAT_VOLUME Volume;
     PVOID Window;
     ULONG WindowIndex;
@@ -2865,15 +2944,15 @@ Return Value:
             // end of the file.
             //
 
-            if ((File->SeekTable[0] == FAT_CLUSTER_FREE) ||
-                (File->SeekTable[0] >= Volume->ClusterCount)) {
+            if ((File->FirstCluster == FAT_CLUSTER_FREE) ||
+                (File->FirstCluster >= Volume->ClusterCount)) {
 
                 Status = STATUS_END_OF_FILE;
                 goto FatFileSeekEnd;
             }
 
-            FatSeekInformation->CurrentCluster = File->SeekTable[0];
-            ByteOffset = FAT_CLUSTER_TO_BYTE(File->Volume, File->SeekTable[0]);
+            FatSeekInformation->CurrentCluster = File->FirstCluster;
+            ByteOffset = FAT_CLUSTER_TO_BYTE(File->Volume, File->FirstCluster);
             FatSeekInformation->CurrentBlock = ByteOffset >> BlockShift;
 
             ASSERT(IS_ALIGNED(ByteOffset, BlockSize) != FALSE);
@@ -2911,19 +2990,27 @@ Return Value:
     }
 
     //
-    // Get the nearest seek table index, and march down until a seek table
-    // entry is filled in. The first one is guaranteed to be filled in.
+    // Find the destination cluster, or the closest cluster before it, in the
+    // extent map. The first cluster is guaranteed to be mapped.
     //
 
-    ASSERT(File->SeekTable[0] != 0);
+    ASSERT(File->FirstCluster != 0);
+
+    ClusterAlignedDestination = ALIGN_RANGE_DOWN(DestinationOffset,
+                                                 ClusterSize);
+
+    FileCluster = ClusterAlignedDestination >> Volume->ClusterShift;
+    if (FatpLookupFileCluster(File,
+                              FileCluster,
+                              &MappedFileCluster,
+                              &CurrentCluster,
+                              &RunLength) == FALSE) {
 
-    TableIndex = FAT_SEEK_TABLE_INDEX(DestinationOffset);
-    while (File->SeekTable[TableIndex] == 0) {
-        TableIndex -= 1;
+        Status = STATUS_FILE_CORRUPT;
+        goto FatFileSeekEnd;
     }
 
-    CurrentOffset = FAT_SEEK_TABLE_OFFSET(TableIndex);
-    CurrentCluster = File->SeekTable[TableIndex];
+    CurrentOffset = (ULONGLONG)MappedFileCluster << Volume->ClusterShift;
 
     ASSERT((CurrentCluster >= FAT_CLUSTER_BEGIN) &&
            (CurrentCluster < Volume->ClusterCount));
@@ -2948,14 +3035,11 @@ Return Value:
     }
 
     //
-    // Cruise the singly linked list of clusters.
+    // Cruise the singly linked list of clusters beyond the mapped region,
+    // extending the map along the way.
     //
 
-    ClusterAlignedDestination = ALIGN_RANGE_DOWN(DestinationOffset,
-                                                 ClusterSize);
-
     PreviousCluster = CurrentCluster;
-    PreviousTableIndex = TableIndex;
     CurrentWindowIndex = MAX_ULONG;
     while (CurrentOffset < ClusterAlignedDestination) {
 
@@ -3027,24 +3111,9 @@ Return Value:
             goto FatFileSeekEnd;
         }
 
-        //
-        // Populate the seek table.
-        //
-
-        TableIndex = FAT_SEEK_TABLE_INDEX(CurrentOffset);
-        if (TableIndex != PreviousTableIndex) {
-            if ((CurrentOffset & FAT_SEEK_OFFSET_MASK) == 0) {
-
-                ASSERT((File->SeekTable[TableIndex] == 0) ||
-                       (File->SeekTable[TableIndex] == CurrentCluster));
-
-                ASSERT(CurrentCluster != 0);
-
-                File->SeekTable[TableIndex] = CurrentCluster;
-            }
-
-            PreviousTableIndex = TableIndex;
-        }
+        FatpAddFileCluster(File,
+                           CurrentOffset >> Volume->ClusterShift,
+                           CurrentCluster);
 
         PreviousCluster = CurrentCluster;
     }
@@ -3113,6 +3182,7 @@ Return Value:
     USHORT FatTime;
     PFAT_VOLUME FatVolume;
     ULONGLONG FileSize;
+    ULONG LongEntryCount;
     UCHAR NewChecksum;
     ULONG ReadCluster;
     KSTATUS Status;
@@ -3319,11 +3389,21 @@ Return Value:
         Status = FatpPerformLongEntryMaintenance(&DirectoryContext,
                                                  EntryOffset,
                                                  Checksum,
-                                                 NewChecksum);
+                                                 NewChecksum,
+                                                 &LongEntryCount);
 
         if (!KSUCCESS(Status)) {
             goto FatWriteFilePropertiesEnd;
         }
+
+        //
+        // Without long entries, the short name is the name, and it just
+        // changed. Throw out the directory's index.
+        //
+
+        if (LongEntryCount == 0) {
+            FatpInvalidateDirectoryIndex(FatVolume, DirectoryCluster);
+        }
     }
 
     Status = FatpFlushDirectory(&DirectoryContext);
@@ -3399,10 +3479,11 @@ Return Value:
     PFAT_VOLUME FatVolume;
     PFAT_FILE File;
     KSTATUS FlushStatus;
+    ULONG KeptClusterCount;
     ULONG NextCluster;
+    ULONGLONG NeededClusterCount;
     ULONG StartingCluster;
     KSTATUS Status;
-    ULONG TableIndex;
     BOOL VolumeLockHeld;
 
     ASSERT((Truncate != FALSE) || (FileSize == 0));
@@ -3411,6 +3492,7 @@ Return Value:
     FatVolume = (PFAT_VOLUME)Volume;
     File = (PFAT_FILE)FileToken;
     ClusterCount = FatVolume->ClusterCount;
+    KeptClusterCount = 0;
     StartingCluster = (ULONG)FileId;
     VolumeLockHeld = FALSE;
 
@@ -3420,11 +3502,37 @@ Return Value:
 
     if (Truncate != FALSE) {
 
+        //
+        // A reservation only needs to cover the clusters the file can still
+        // grow into. Trim it down once the new size is known.
+        //
+
+        if ((File != NULL) && (File->ReservedClusterCount != 0)) {
+            NeededClusterCount = ALIGN_RANGE_UP(FileSize,
+                                                FatVolume->ClusterSize) >>
+                                 FatVolume->ClusterShift;
+
+            if (NeededClusterCount == 0) {
+                NeededClusterCount = 1;
+            }
+
+            FatAcquireLock(FatVolume->Lock);
+            if (File->ReservedClusterCount > NeededClusterCount) {
+                FatVolume->ReservedClusterCount -=
+                      File->ReservedClusterCount - (ULONG)NeededClusterCount;
+
+                File->ReservedClusterCount = (ULONG)NeededClusterCount;
+            }
+
+            FatReleaseLock(FatVolume->Lock);
+        }
+
         //
         // If this is not a truncate to zero, then find the last cluster that
         // will remain in the file and make that the starting cluster.
         //
 
+        KeptClusterCount = 1;
         while (FileSize > FatVolume->ClusterSize) {
             Status = FatpGetNextCluster(FatVolume,
                                         0,
@@ -3436,18 +3544,20 @@ Return Value:
             }
 
             //
-            // Fail if the end of file is hit. The caller should have specified
-            // a new file size smaller than the original.
+            // If the end of the cluster chain is hit, there is nothing to
+            // free. This happens when the file size covers data whose
+            // clusters have not been allocated yet.
             //
 
             if ((StartingCluster < FAT_CLUSTER_BEGIN) ||
                 (StartingCluster >= ClusterCount)) {
 
-                Status = STATUS_INVALID_PARAMETER;
+                Status = STATUS_SUCCESS;
                 goto DeleteFileBlocksEnd;
             }
 
             FileSize -= FatVolume->ClusterSize;
+            KeptClusterCount += 1;
         }
 
         //
@@ -3495,17 +3605,20 @@ Return Value:
     }
 
     //
-    // Clean out the seek table if a file was provided.
+    // Trim the extent map if a file was provided.
     //
 
     if (File != NULL) {
-        TableIndex = FAT_SEEK_TABLE_INDEX(FileSize);
-        if ((TableIndex == 0) && (Truncate != FALSE)) {
-            TableIndex = 1;
-        }
+        FatpTruncateFileExtents(File, KeptClusterCount);
+    }
+
+    //
+    // If the whole file is going away and it was a directory, its index is
+    // no longer valid. Throw it out before the cluster can be reused.
+    //
 
-        RtlZeroMemory(&(File->SeekTable[TableIndex]),
-                      (FAT_SEEK_TABLE_SIZE - TableIndex) * FAT32_CLUSTER_WIDTH);
+    if (KeptClusterCount == 0) {
+        FatpInvalidateDirectoryIndex(FatVolume, StartingCluster);
     }
 
     //
@@ -3734,7 +3847,8 @@ Routine Description:
     This routine expands the file capacity of the given file ID by allocating
     clusters for it. It does not zero out those clusters, so the usefulness of
     this function is limited to scenarios where the security of uninitialized
-    disk contents is not a concern.
+    disk contents is not a concern. The new clusters are placed in a single
+    contiguous run if the volume has one large enough.
 
 Arguments:
 
@@ -3758,17 +3872,24 @@ Return Value:
     BOOL Dirty;
     PFAT_VOLUME FatVolume;
     ULONG NextCluster;
+    ULONGLONG RemainingClusters;
+    ULONG RunStart;
     KSTATUS Status;
 
     FatVolume = Volume;
     ClusterCount = FatVolume->ClusterCount;
-    CurrentSize = 0;
     Dirty = FALSE;
     Status = STATUS_SUCCESS;
 
     ASSERT((FileId > FAT_CLUSTER_BEGIN) && (FileId < ClusterCount));
 
+    //
+    // Walk to the end of the existing cluster chain. The file ID is the first
+    // cluster, so it already accounts for one cluster's worth of space.
+    //
+
     Cluster = FileId;
+    CurrentSize = FatVolume->ClusterSize;
     while (CurrentSize < FileSize) {
         Status = FatpGetNextCluster(Volume, 0, Cluster, &NextCluster);
         if (!KSUCCESS(Status)) {
@@ -3776,27 +3897,165 @@ Return Value:
         }
 
         if (NextCluster >= ClusterCount) {
-            Status = FatpAllocateCluster(Volume, Cluster, &NextCluster, FALSE);
-            if (!KSUCCESS(Status)) {
-                return Status;
+            break;
+        }
+
+        Cluster = NextCluster;
+        CurrentSize += FatVolume->ClusterSize;
+    }
+
+    if (CurrentSize >= FileSize) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // Rather than growing the file a run at a time, look for a free run that
+    // holds everything still needed and point the allocator at it. If the
+    // cluster after the end of the chain is free, the allocator extends the
+    // chain in place on its own.
+    //
+
+    RemainingClusters = (FileSize - CurrentSize + FatVolume->ClusterSize - 1) >>
+                        FatVolume->ClusterShift;
+
+    if ((RemainingClusters > 1) && (RemainingClusters < ClusterCount)) {
+        FatAcquireLock(FatVolume->Lock);
+        if (((Cluster + 1) >= ClusterCount) ||
+            (FAT_CLUSTER_BITMAP_TEST(FatVolume, Cluster + 1))) {
+
+            RunStart = FatpFindFreeClusterRun(FatVolume,
+                                              FAT_CLUSTER_BEGIN,
+                                              ClusterCount,
+                                              RemainingClusters);
+
+            if (RunStart != FAT_CLUSTER_FREE) {
+                FatVolume->ClusterSearchStart = RunStart;
             }
+        }
+
+        FatReleaseLock(FatVolume->Lock);
+    }
+
+    while (CurrentSize < FileSize) {
+        Status = FatpAllocateCluster(Volume,
+                                     NULL,
+                                     Cluster,
+                                     &NextCluster,
+                                     FALSE);
 
-            Dirty = TRUE;
+        if (!KSUCCESS(Status)) {
+            break;
         }
 
+        Dirty = TRUE;
         Cluster = NextCluster;
         CurrentSize += FatVolume->ClusterSize;
     }
 
     if (Dirty != FALSE) {
         FatAcquireLock(FatVolume->Lock);
-        Status = FatpFatCacheFlush(FatVolume, 0);
+        if (KSUCCESS(Status)) {
+            Status = FatpFatCacheFlush(FatVolume, 0);
+
+        } else {
+            FatpFatCacheFlush(FatVolume, 0);
+        }
+
         FatReleaseLock(FatVolume->Lock);
     }
 
     return Status;
 }
 
+KSTATUS
+FatReserveFileClusters (
+    PVOID FileToken,
+    ULONGLONG Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reserves free clusters on the volume for a region of the
+    given file that is about to be written, without assigning them. Later
+    writes that extend the file's cluster chain draw from the reservation, so
+    they cannot fail for lack of space. Any unused reservation is released
+    when the file is truncated below it or closed.
+
+Arguments:
+
+    FileToken - Supplies the open file token.
+
+    Offset - Supplies the byte offset where the region begins.
+
+    Size - Supplies the size of the region in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_VOLUME_FULL if the volume does not have enough unreserved free
+    clusters.
+
+    STATUS_FILE_CORRUPT if the file's cluster chain is damaged.
+
+--*/
+
+{
+
+    ULONG AllocatedClusters;
+    ULONGLONG EndCluster;
+    PFAT_FILE File;
+    ULONGLONG NewClusters;
+    KSTATUS Status;
+    PFAT_VOLUME Volume;
+
+    File = FileToken;
+    Volume = File->Volume;
+    EndCluster = (Offset + Size + Volume->ClusterSize - 1) >>
+                 Volume->ClusterShift;
+
+    //
+    // The file size says nothing about clusters allocated past it (by an
+    // earlier fallocate, for instance), so count the actual chain.
+    //
+
+    Status = FatpGetFileClusterCount(File, &AllocatedClusters);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if (EndCluster <= AllocatedClusters) {
+        return STATUS_SUCCESS;
+    }
+
+    FatAcquireLock(Volume->Lock);
+    NewClusters = EndCluster - AllocatedClusters;
+    if (NewClusters <= File->ReservedClusterCount) {
+        Status = STATUS_SUCCESS;
+        goto ReserveFileClustersEnd;
+    }
+
+    NewClusters -= File->ReservedClusterCount;
+    if ((Volume->FreeClusterCount < Volume->ReservedClusterCount) ||
+        (NewClusters >
+         (Volume->FreeClusterCount - Volume->ReservedClusterCount))) {
+
+        Status = STATUS_VOLUME_FULL;
+        goto ReserveFileClustersEnd;
+    }
+
+    File->ReservedClusterCount += (ULONG)NewClusters;
+    Volume->ReservedClusterCount += (ULONG)NewClusters;
+    Status = STATUS_SUCCESS;
+
+ReserveFileClustersEnd:
+    FatReleaseLock(Volume->Lock);
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -3873,15 +4132,18 @@ Return Value:
     ULONG CurrentCluster;
     PFAT_FILE File;
     ULONGLONG FileByteOffset;
+    ULONG FileCluster;
     KSTATUS FlushStatus;
+    ULONG MappedCluster;
+    ULONG MappedFileCluster;
     UINTN MaxContiguousBytes;
     ULONG NewCluster;
     BOOL NewTerritory;
     ULONG NextCluster;
+    ULONG RunLength;
     PFAT_IO_BUFFER ScratchIoBuffer;
     BOOL ScratchLockHeld;
     KSTATUS Status;
-    ULONG TableIndex;
     UINTN TotalBytesProcessed;
     PFAT_VOLUME Volume;
 
@@ -3932,7 +4194,7 @@ Return Value:
             // ID.
             //
 
-            if (File->SeekTable[0] == FAT_CLUSTER_FREE) {
+            if (File->FirstCluster == FAT_CLUSTER_FREE) {
 
                 ASSERT(FALSE);
 
@@ -3940,8 +4202,8 @@ Return Value:
                 goto PerformFileIoEnd;
             }
 
-            if ((File->SeekTable[0] < FAT_CLUSTER_BEGIN) ||
-                (File->SeekTable[0] >= ClusterBad)) {
+            if ((File->FirstCluster < FAT_CLUSTER_BEGIN) ||
+                (File->FirstCluster >= ClusterBad)) {
 
                 Status = STATUS_FILE_CORRUPT;
                 goto PerformFileIoEnd;
@@ -3952,8 +4214,8 @@ Return Value:
             // the file.
             //
 
-            FatSeekInformation->CurrentCluster = File->SeekTable[0];
-            ByteOffset = FAT_CLUSTER_TO_BYTE(Volume, File->SeekTable[0]);
+            FatSeekInformation->CurrentCluster = File->FirstCluster;
+            ByteOffset = FAT_CLUSTER_TO_BYTE(Volume, File->FirstCluster);
             FatSeekInformation->CurrentBlock = ByteOffset >> BlockShift;
 
             ASSERT(IS_ALIGNED(ByteOffset, BlockSize) != FALSE);
@@ -4005,6 +4267,7 @@ Return Value:
             ASSERT((File->OpenFlags & OPEN_FLAG_PAGE_FILE) == 0);
 
             Status = FatpAllocateCluster(Volume,
+                                         File,
                                          FatSeekInformation->CurrentCluster,
                                          &NewCluster,
                                          FALSE);
@@ -4034,22 +4297,9 @@ Return Value:
         }
 
         FatSeekInformation->ClusterByteOffset = 0;
-
-        //
-        // Populate the seek table.
-        //
-
-        TableIndex = FAT_SEEK_TABLE_INDEX(FatSeekInformation->FileByteOffset);
-        if ((FatSeekInformation->FileByteOffset & FAT_SEEK_OFFSET_MASK) == 0) {
-
-            ASSERT((File->SeekTable[TableIndex] == 0) ||
-                   (File->SeekTable[TableIndex] ==
-                    FatSeekInformation->CurrentCluster));
-
-            ASSERT(FatSeekInformation->CurrentCluster != 0);
-
-            File->SeekTable[TableIndex] = FatSeekInformation->CurrentCluster;
-        }
+        FatpAddFileCluster(File,
+                           FatSeekInformation->FileByteOffset >> ClusterShift,
+                           FatSeekInformation->CurrentCluster);
     }
 
     ASSERT(FatSeekInformation->CurrentBlock != 0);
@@ -4073,7 +4323,33 @@ Return Value:
                                  FatSeekInformation->ClusterByteOffset;
 
             CurrentCluster = FatSeekInformation->CurrentCluster;
-            FileByteOffset = FatSeekInformation->FileByteOffset;
+            FileCluster = (FatSeekInformation->FileByteOffset -
+                           FatSeekInformation->ClusterByteOffset) >>
+                          ClusterShift;
+
+            //
+            // Consume the run from the extent map first, which saves looking
+            // up each cluster in the FAT.
+            //
+
+            if ((FatpLookupFileCluster(File,
+                                       FileCluster,
+                                       &MappedFileCluster,
+                                       &MappedCluster,
+                                       &RunLength) != FALSE) &&
+                (MappedFileCluster == FileCluster) &&
+                (MappedCluster == CurrentCluster)) {
+
+                while ((RunLength != 0) &&
+                       (MaxContiguousBytes < SizeInBytes)) {
+
+                    MaxContiguousBytes += ClusterSize;
+                    CurrentCluster += 1;
+                    FileCluster += 1;
+                    RunLength -= 1;
+                }
+            }
+
             while (MaxContiguousBytes < SizeInBytes) {
                 Status = FatpGetNextCluster(Volume,
                                             IoFlags,
@@ -4100,6 +4376,7 @@ Return Value:
                     ASSERT((File->OpenFlags & OPEN_FLAG_PAGE_FILE) == 0);
 
                     Status = FatpAllocateCluster(Volume,
+                                                 File,
                                                  CurrentCluster,
                                                  &NewCluster,
                                                  FALSE);
@@ -4118,22 +4395,8 @@ Return Value:
 
                 MaxContiguousBytes += ClusterSize;
                 CurrentCluster = NextCluster;
-                FileByteOffset += ClusterSize;
-
-                //
-                // Populate the seek table.
-                //
-
-                TableIndex = FAT_SEEK_TABLE_INDEX(FileByteOffset);
-                if ((FileByteOffset & FAT_SEEK_OFFSET_MASK) == 0) {
-
-                    ASSERT((File->SeekTable[TableIndex] == 0) ||
-                           (File->SeekTable[TableIndex] == CurrentCluster));
-
-                    ASSERT(CurrentCluster != 0);
-
-                    File->SeekTable[TableIndex] = CurrentCluster;
-                }
+                FileCluster += 1;
+                FatpAddFileCluster(File, FileCluster, CurrentCluster);
             }
         }
 
@@ -4374,6 +4637,11 @@ Return Value:
             FatSeekInformation->CurrentBlock = ByteOffset >> BlockShift;
             FatSeekInformation->CurrentCluster = NextCluster;
             FatSeekInformation->ClusterByteOffset = 0;
+            FatpAddFileCluster(File,
+                               FatSeekInformation->FileByteOffset >>
+                               ClusterShift,
+                               NextCluster);
+
             MaxContiguousBytes = 0;
 
         //
@@ -4452,3 +4720,85 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+FatpGetFileClusterCount (
+    PFAT_FILE File,
+    PULONG ClusterCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts the clusters allocated to a file by following its
+    cluster chain past the end of the extent map, extending the map along
+    the way.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    ClusterCount - Supplies a pointer where the number of clusters in the
+        file's chain is returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_FILE_CORRUPT if the cluster chain is damaged.
+
+    Other error codes on device I/O errors.
+
+--*/
+
+{
+
+    ULONG Cluster;
+    ULONG FileCluster;
+    ULONG NextCluster;
+    ULONG RunLength;
+    KSTATUS Status;
+    PFAT_VOLUME Volume;
+
+    *ClusterCount = 0;
+    if ((File->IsRootDirectory != FALSE) || (File->FirstCluster == 0)) {
+        return STATUS_SUCCESS;
+    }
+
+    if (FatpLookupFileCluster(File,
+                              MAX_ULONG,
+                              &FileCluster,
+                              &Cluster,
+                              &RunLength) == FALSE) {
+
+        return STATUS_FILE_CORRUPT;
+    }
+
+    Volume = File->Volume;
+    FileCluster += RunLength;
+    Cluster += RunLength;
+    while (TRUE) {
+        Status = FatpGetNextCluster(Volume, 0, Cluster, &NextCluster);
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if ((NextCluster < FAT_CLUSTER_BEGIN) ||
+            (NextCluster == Volume->ClusterBad)) {
+
+            return STATUS_FILE_CORRUPT;
+        }
+
+        if (NextCluster > Volume->ClusterBad) {
+            break;
+        }
+
+        FileCluster += 1;
+        Cluster = NextCluster;
+        FatpAddFileCluster(File, FileCluster, Cluster);
+    }
+
+    *ClusterCount = FileCluster + 1;
+    return STATUS_SUCCESS;
+}
+
@@ -70,16 +70,20 @@ Module Name:
      (_Volume)->ClusterWidthShift)
 
 //
-// This macro gets the closest seek table entry for the given file offset.
+// These macros test, set, and clear the bit for a cluster in the volume's
+// allocated cluster bitmap.
 //
 
-#define FAT_SEEK_TABLE_INDEX(_Offset) ((_Offset) >> FAT_SEEK_OFFSET_SHIFT)
+#define FAT_CLUSTER_BITMAP_TEST(_Volume, _Cluster)        \
+    (((_Volume)->ClusterBitmap[(_Cluster) >> 5] &         \
+      (1UL << ((_Cluster) & 0x1F))) != 0)
 
-//
-// This macro converts a seek table index back into an offset.
-//
+#define FAT_CLUSTER_BITMAP_SET(_Volume, _Cluster)         \
+    ((_Volume)->ClusterBitmap[(_Cluster) >> 5] |= (1UL << ((_Cluster) & 0x1F)))
 
-#define FAT_SEEK_TABLE_OFFSET(_Index) ((_Index) << FAT_SEEK_OFFSET_SHIFT)
+#define FAT_CLUSTER_BITMAP_CLEAR(_Volume, _Cluster)       \
+    ((_Volume)->ClusterBitmap[(_Cluster) >> 5] &=         \
+     ~(1UL << ((_Cluster) & 0x1F)))
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -93,14 +97,20 @@ Module Name:
 #define FAT_DIRECTORY_FLAG_POSITION_AT_END 0x00000002
 
 //
-// Define the number of seek table entries to keep across the entire
-// theoretical 4GB file.
+// Define the initial number of extents allocated for a file's extent map, and
+// the most extents a map will grow to. Offsets beyond a full map are found by
+// walking the cluster chain from the last mapped cluster.
+//
+
+#define FAT_INITIAL_EXTENT_COUNT 8
+#define FAT_MAX_EXTENT_COUNT 0x10000
+
+//
+// Define the size, in bytes, of the free run the allocator looks for when a
+// growing file can no longer be extended in place.
 //
 
-#define FAT_SEEK_TABLE_SHIFT 6
-#define FAT_SEEK_TABLE_SIZE (1UL << FAT_SEEK_TABLE_SHIFT)
-#define FAT_SEEK_OFFSET_SHIFT (32 - FAT_SEEK_TABLE_SHIFT)
-#define FAT_SEEK_OFFSET_MASK ((1UL << FAT_SEEK_OFFSET_SHIFT) - 1)
+#define FAT_CONTIGUOUS_RUN_SIZE 0x100000
 
 //
 // Define bits in the encoded non-standard permissions field.
@@ -246,6 +256,17 @@ Structure Description:
     ClusterSearchStart - Stores the cluster to start searching from. 0
         specifies an uninitialized value.
 
+    ClusterBitmap - Stores a pointer to a bitmap with one bit for each cluster
+        in the volume, set if the cluster is in use. It is built from the FAT
+        at mount and kept up to date under the volume lock.
+
+    FreeClusterCount - Stores the number of clear bits in the cluster bitmap.
+
+    ReservedClusterCount - Stores the number of free clusters promised to open
+        files for writes whose clusters have not been assigned yet. Only
+        allocations against a reservation may dip into these. Protected by the
+        volume lock.
+
     InformationByteOffset - Stores the offset, in bytes, to the FS information
         block.
 
@@ -265,6 +286,11 @@ Structure Description:
     FatCache - Stores the File Allocation Table cache. This is used for cluster
         allocation and next cluster lookup during seek, read, and write.
 
+    DirectoryIndexList - Stores the head of the list of hashed directory
+        indices, in most recently used order. Protected by the volume lock.
+
+    DirectoryIndexCount - Stores the number of directory indices on the list.
+
 --*/
 
 typedef struct _FAT_VOLUME {
@@ -285,6 +311,9 @@ typedef struct _FAT_VOLUME {
     ULONGLONG RootDirectoryByteOffset;
     ULONGLONG ClusterByteOffset;
     ULONG ClusterSearchStart;
+    PULONG ClusterBitmap;
+    ULONG FreeClusterCount;
+    ULONG ReservedClusterCount;
     ULONGLONG InformationByteOffset;
     ULONGLONG FatByteStart;
     ULONGLONG FatSize;
@@ -292,10 +321,34 @@ typedef struct _FAT_VOLUME {
     PVOID Lock;
     RED_BLACK_TREE FileMappingTree;
     FAT_CACHE FatCache;
+    LIST_ENTRY DirectoryIndexList;
+    ULONG DirectoryIndexCount;
 } FAT_VOLUME, *PFAT_VOLUME;
 
 /*++
 
+Structure Description:
+
+    This structure defines a run of physically contiguous clusters in a file.
+
+Members:
+
+    FileCluster - Stores the index of the run's first cluster within the file.
+
+    Cluster - Stores the cluster number on the volume where the run begins.
+
+    Length - Stores the number of clusters in the run.
+
+--*/
+
+typedef struct _FAT_EXTENT {
+    ULONG FileCluster;
+    ULONG Cluster;
+    ULONG Length;
+} FAT_EXTENT, *PFAT_EXTENT;
+
+/*++
+
 Structure Description:
 
     This structure defines file system state associated with an open file.
@@ -321,9 +374,30 @@ Structure Description:
         guaranteed to be at least 512 bytes large. This should only be used
         for page file operations.
 
-    SeekTable - Stores cluster numbers for file offsets spread evenly through
-        out the maximum theoretical file size of 4GB. The first value is file
-        offset 0, and is always filled in.
+    FirstCluster - Stores the first cluster of the file, which is also its
+        file ID.
+
+    ExtentLock - Stores a pointer to the lock synchronizing access to the
+        extent map.
+
+    InlineExtent - Stores the storage for the first extent, which is all most
+        files ever need.
+
+    Extents - Stores an array of extents mapping the beginning of the file to
+        clusters on the volume. The map always covers a prefix of the file and
+        is built lazily as the cluster chain is walked. Page files map their
+        entire chain when opened and never grow the map.
+
+    ExtentCount - Stores the number of valid elements in the extent array.
+
+    ExtentCapacity - Stores the number of elements the extent array can hold.
+
+    MappedClusterCount - Stores the number of file clusters covered by the
+        extent map.
+
+    ReservedClusterCount - Stores the number of clusters this file has
+        reserved on the volume and not yet allocated. Protected by the volume
+        lock.
 
 --*/
 
@@ -333,7 +407,14 @@ typedef struct _FAT_FILE {
     BOOL IsRootDirectory;
     PVOID ScratchIoBufferLock;
     PFAT_IO_BUFFER ScratchIoBuffer;
-    ULONG SeekTable[FAT_SEEK_TABLE_SIZE];
+    ULONG FirstCluster;
+    PVOID ExtentLock;
+    FAT_EXTENT InlineExtent;
+    PFAT_EXTENT Extents;
+    ULONG ExtentCount;
+    ULONG ExtentCapacity;
+    ULONG MappedClusterCount;
+    ULONG ReservedClusterCount;
 } FAT_FILE, *PFAT_FILE;
 
 /*++
@@ -623,9 +704,43 @@ Return Value:
 
 --*/
 
+ULONG
+FatpFindFreeClusterRun (
+    PFAT_VOLUME Volume,
+    ULONG Start,
+    ULONG End,
+    ULONG RunLength
+    );
+
+/*++
+
+Routine Description:
+
+    This routine searches the allocated cluster bitmap for a run of free
+    clusters. The volume lock must be held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Start - Supplies the first cluster to search.
+
+    End - Supplies the cluster to stop searching at, exclusive.
+
+    RunLength - Supplies the number of consecutive free clusters desired.
+
+Return Value:
+
+    Returns the first cluster of the run on success.
+
+    FAT_CLUSTER_FREE if no free run of the given length exists in the range.
+
+--*/
+
 KSTATUS
 FatpAllocateCluster (
     PFAT_VOLUME Volume,
+    PFAT_FILE File,
     ULONG PreviousCluster,
     PULONG NewCluster,
     BOOL Flush
@@ -642,6 +757,10 @@ Routine Description:
 
     Volume - Supplies a pointer to the FAT volume.
 
+    File - Supplies an optional pointer to the file being extended. If the
+        file holds a cluster reservation, the allocation is charged against
+        it.
+
     PreviousCluster - Supplies the cluster that should point to the newly
         allocated cluster. Specify FAT32_CLUSTER_END if no previous cluster
         should be updated.
@@ -693,6 +812,189 @@ Return Value:
 
 --*/
 
+KSTATUS
+FatpCreateClusterBitmap (
+    PFAT_VOLUME Volume
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reads the entire File Allocation Table and builds the
+    in-memory bitmap of allocated clusters used to find free space.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+FatpDestroyClusterBitmap (
+    PFAT_VOLUME Volume
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees the in-memory bitmap of allocated clusters.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpInitializeFileExtents (
+    PFAT_FILE File,
+    ULONG FirstCluster
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes the extent map of a newly opened file.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    FirstCluster - Supplies the first cluster of the file.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpDestroyFileExtents (
+    PFAT_FILE File
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees the extent map of a file.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+FatpLookupFileCluster (
+    PFAT_FILE File,
+    ULONG FileCluster,
+    PULONG MappedFileCluster,
+    PULONG Cluster,
+    PULONG RunLength
+    );
+
+/*++
+
+Routine Description:
+
+    This routine uses the file's extent map to find the cluster backing the
+    given cluster of the file, or the closest mapped cluster before it.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    FileCluster - Supplies the index of the desired cluster within the file.
+
+    MappedFileCluster - Supplies a pointer where the index of the cluster that
+        was found is returned. This is the desired cluster if it is mapped, or
+        the last mapped cluster of the file otherwise.
+
+    Cluster - Supplies a pointer where the volume cluster number backing the
+        mapped file cluster is returned.
+
+    RunLength - Supplies a pointer where the number of physically contiguous
+        clusters that immediately follow the returned cluster in the file is
+        returned.
+
+Return Value:
+
+    TRUE if a cluster was found.
+
+    FALSE if the extent map is empty.
+
+--*/
+
+VOID
+FatpAddFileCluster (
+    PFAT_FILE File,
+    ULONG FileCluster,
+    ULONG Cluster
+    );
+
+/*++
+
+Routine Description:
+
+    This routine records the cluster backing the given file cluster in the
+    file's extent map. Since the map only ever covers a prefix of the file,
+    clusters that do not immediately follow the mapped region are ignored.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    FileCluster - Supplies the index of the cluster within the file.
+
+    Cluster - Supplies the volume cluster number backing the file cluster.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpTruncateFileExtents (
+    PFAT_FILE File,
+    ULONG ClusterCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine removes every cluster at or beyond the given file cluster
+    from the file's extent map.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    ClusterCount - Supplies the number of clusters the file still has.
+
+Return Value:
+
+    None.
+
+--*/
+
 KSTATUS
 FatpIsDirectoryEmpty (
     PFAT_VOLUME Volume,
@@ -843,7 +1145,8 @@ FatpPerformLongEntryMaintenance (
     PFAT_DIRECTORY_CONTEXT Directory,
     ULONGLONG EntryOffset,
     UCHAR Checksum,
-    ULONG NewChecksum
+    ULONG NewChecksum,
+    PULONG EntriesModified
     );
 
 /*++
@@ -867,6 +1170,9 @@ Routine Description:
     NewChecksum - Supplies the new checksum to set in the long entries. If this
         is -1, then the directory entries will be marked erased.
 
+    EntriesModified - Supplies an optional pointer where the number of long
+        entries modified will be returned.
+
 Return Value:
 
     Status code.
@@ -1326,6 +1632,226 @@ Return Value:
 
 --*/
 
+//
+// Directory index support functions.
+//
+
+VOID
+FatpInitializeDirectoryIndexCache (
+    PFAT_VOLUME Volume
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes the directory index cache for the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpDestroyDirectoryIndexCache (
+    PFAT_VOLUME Volume
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys every directory index on the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+FatpDirectoryIndexLookup (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_CONTEXT Directory,
+    PCSTR Name,
+    ULONG NameLength,
+    PFAT_DIRECTORY_ENTRY Entry,
+    PULONGLONG EntryOffset
+    );
+
+/*++
+
+Routine Description:
+
+    This routine looks up a name in the directory's index, building the index
+    first if the directory does not have one yet.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Directory - Supplies a pointer to the directory context for the open
+        directory. Its position is not preserved.
+
+    Name - Supplies the name of the file or directory to look up.
+
+    NameLength - Supplies the size of the name buffer in bytes, including the
+        null terminator.
+
+    Entry - Supplies a pointer where the short directory entry will be
+        returned.
+
+    EntryOffset - Supplies a pointer where the directory offset of the short
+        entry will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if the entry was found.
+
+    STATUS_PATH_NOT_FOUND if the index shows no such entry exists.
+
+    Other error codes if the index is unavailable, in which case the caller
+    should scan the directory.
+
+--*/
+
+VOID
+FatpDirectoryIndexGetFreeSlot (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster,
+    ULONG EntryCount,
+    PULONGLONG Offset
+    );
+
+/*++
+
+Routine Description:
+
+    This routine uses the directory's index to suggest where a new set of
+    directory entries should go. The suggestion is only a hint; the caller
+    must verify the entries on disk as it would for a scan.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+    EntryCount - Supplies the number of consecutive entries needed.
+
+    Offset - Supplies a pointer that on input contains the offset to start
+        searching at if the directory has no index. On output, this returns
+        the offset to start searching at.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpDirectoryIndexInsert (
+    PFAT_VOLUME Volume,
+    PFAT_DIRECTORY_CONTEXT Directory,
+    ULONGLONG Offset,
+    ULONG EntryCount,
+    BOOL WroteEndEntry
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds a newly written set of directory entries to the
+    directory's index, if it has one.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Directory - Supplies a pointer to the directory context the entries were
+        written through. Its position is not preserved.
+
+    Offset - Supplies the directory offset of the first new entry.
+
+    EntryCount - Supplies the number of entries written, including long name
+        entries.
+
+    WroteEndEntry - Supplies a boolean indicating whether a new terminating
+        entry was written after the new entries.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpDirectoryIndexRemove (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster,
+    ULONGLONG Offset,
+    ULONG EntryCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine removes an erased entry from the directory's index, if it
+    has one, and records its entries as free.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+    Offset - Supplies the directory offset of the erased short entry.
+
+    EntryCount - Supplies the number of entries erased, including the long
+        name entries directly before the short entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+FatpInvalidateDirectoryIndex (
+    PFAT_VOLUME Volume,
+    ULONG DirectoryCluster
+    );
+
+/*++
+
+Routine Description:
+
+    This routine throws away the index for the given directory, if there is
+    one. It will be rebuilt on the next lookup.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    DirectoryCluster - Supplies the first cluster of the directory.
+
+Return Value:
+
+    None.
+
+--*/
+
 //
 // File Allocation Table cache support functions.
 //
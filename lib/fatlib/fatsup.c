@@ -161,10 +161,31 @@ Return Value:
         return STATUS_PATH_NOT_FOUND;
     }
 
+    //
+    // Try the directory's hashed index first. If the index is unavailable,
+    // fall back to scanning the directory.
+    //
+
+    Status = FatpDirectoryIndexLookup(Volume,
+                                      Directory,
+                                      Name,
+                                      NameLength,
+                                      Entry,
+                                      &Offset);
+
+    if (KSUCCESS(Status)) {
+        goto LookupDirectoryEntryFound;
+
+    } else if (Status == STATUS_PATH_NOT_FOUND) {
+        goto LookupDirectoryEntryEnd;
+    }
+
     //
     // Seek to the beginning of the directory.
     //
 
+    Offset = DIRECTORY_CONTENTS_OFFSET;
+
     Status = FatpDirectorySeek(Directory, Offset);
     if (!KSUCCESS(Status)) {
         goto LookupDirectoryEntryEnd;
@@ -215,38 +236,36 @@ Return Value:
             ASSERT(Offset != 0);
 
             Offset -= 1;
+            break;
+        }
+    }
 
-            //
-            // Set the mapping between the file and the directory, except for
-            // the . and .. entries. Also, empty files may have a cluster ID of
-            // 0, don't save those either.
-            //
+LookupDirectoryEntryFound:
 
-            IsDotEntry = FALSE;
-            if ((Name[0] == '.') &&
-                ((Name[1] == '\0') ||
-                 ((Name[1] == '.') && (Name[2] == '\0')))) {
+    //
+    // Set the mapping between the file and the directory, except for the .
+    // and .. entries. Also, empty files may have a cluster ID of 0, don't
+    // save those either.
+    //
 
-                IsDotEntry = TRUE;
-            }
+    IsDotEntry = FALSE;
+    if ((Name[0] == '.') &&
+        ((Name[1] == '\0') || ((Name[1] == '.') && (Name[2] == '\0')))) {
 
-            if (IsDotEntry == FALSE) {
-                Cluster = (Entry->ClusterHigh << 16) | Entry->ClusterLow;
-                if ((Cluster >= FAT_CLUSTER_BEGIN) &&
-                    (Cluster < Volume->ClusterBad)) {
+        IsDotEntry = TRUE;
+    }
 
-                    Status = FatpSetFileMapping(Volume,
-                                                Cluster,
-                                                Directory->File->SeekTable[0],
-                                                Offset);
+    if (IsDotEntry == FALSE) {
+        Cluster = (Entry->ClusterHigh << 16) | Entry->ClusterLow;
+        if ((Cluster >= FAT_CLUSTER_BEGIN) && (Cluster < Volume->ClusterBad)) {
+            Status = FatpSetFileMapping(Volume,
+                                        Cluster,
+                                        Directory->File->FirstCluster,
+                                        Offset);
 
-                    if (!KSUCCESS(Status)) {
-                        goto LookupDirectoryEntryEnd;
-                    }
-                }
+            if (!KSUCCESS(Status)) {
+                goto LookupDirectoryEntryEnd;
             }
-
-            break;
         }
     }
 
@@ -385,6 +404,7 @@ Return Value:
     //
 
     Status = FatpAllocateCluster(Volume,
+                                 NULL,
                                  Volume->ClusterEnd,
                                  &FirstCluster,
                                  TRUE);
@@ -612,12 +632,19 @@ Return Value:
     ASSERT(EntryCount != 0);
 
     //
-    // Reset to the beginning of the directory file.
+    // Start at the beginning of the directory file, unless the directory
+    // index knows of a better place to start looking. A seek to the end of
+    // the directory is fine, the read below will just hit the end.
     //
 
     Offset = DIRECTORY_CONTENTS_OFFSET;
+    FatpDirectoryIndexGetFreeSlot(Volume,
+                                  DirectoryContext.File->FirstCluster,
+                                  EntryCount,
+                                  &Offset);
+
     Status = FatpDirectorySeek(&DirectoryContext, Offset);
-    if (!KSUCCESS(Status)) {
+    if (!KSUCCESS(Status) && (Status != STATUS_END_OF_FILE)) {
         goto CreateDirectoryEntryEnd;
     }
 
@@ -787,11 +814,19 @@ Return Value:
     }
 
     *DirectorySize = DirectoryContext.ClusterPosition.FileByteOffset;
+    FatpDirectoryIndexInsert(Volume,
+                             &DirectoryContext,
+                             EntryOffset,
+                             EntryCount,
+                             WriteEndEntry);
+
     Status = STATUS_SUCCESS;
 
 CreateDirectoryEntryEnd:
     if (!KSUCCESS(Status) && (SetMapping != FALSE)) {
         FatpUnsetFileMapping(Volume, FirstCluster);
+        FatpInvalidateDirectoryIndex(Volume,
+                                     DirectoryContext.File->FirstCluster);
     }
 
     if (DirectoryContextInitialized != FALSE) {
@@ -1278,6 +1313,7 @@ Return Value:
 KSTATUS
 FatpAllocateCluster (
     PFAT_VOLUME Volume,
+    PFAT_FILE File,
     ULONG PreviousCluster,
     PULONG NewCluster,
     BOOL Flush
@@ -1294,6 +1330,10 @@ Routine Description:
 
     Volume - Supplies a pointer to the FAT volume.
 
+    File - Supplies an optional pointer to the file being extended. If the
+        file holds a cluster reservation, the allocation is charged against
+        it.
+
     PreviousCluster - Supplies the cluster that should point to the newly
         allocated cluster. Specify FAT32_CLUSTER_END if no previous cluster
         should be updated.
@@ -1322,20 +1362,14 @@ Return Value:
     ULONG AllocatedCluster;
     ULONG BlockShift;
     ULONG ClusterCount;
-    ULONG ClusterEnd;
-    ULONG CurrentCluster;
     PFAT32_INFORMATION_SECTOR Information;
     ULONGLONG InformationBlock;
     PFAT_IO_BUFFER InformationIoBuffer;
     ULONG IoFlags;
+    BOOL Reserved;
+    ULONG RunLength;
     ULONG SearchStart;
     KSTATUS Status;
-    ULONG Value;
-    PVOID Window;
-    PUSHORT Window16;
-    PULONG Window32;
-    ULONG WindowOffset;
-    ULONG WindowSize;
 
     AllocatedCluster = FAT_CLUSTER_FREE;
     BlockShift = Volume->BlockShift;
@@ -1360,97 +1394,79 @@ Return Value:
     }
 
     //
-    // Search for a free block. Start just after the last allocated cluster.
+    // Clusters reserved by open files are off limits unless this allocation
+    // is the one they were reserved for.
     //
 
-    CurrentCluster = Volume->ClusterSearchStart;
-    ClusterEnd = ClusterCount;
-    SearchStart = CurrentCluster;
-    CurrentCluster += 1;
-    WindowSize = FAT_WINDOW_INDEX_TO_CLUSTER(Volume, 1);
-    WindowOffset = MAX_ULONG;
-    while (CurrentCluster != SearchStart) {
-
-        //
-        // If this is the end of the FAT, wrap around to the beginning.
-        //
-
-        if (CurrentCluster >= ClusterEnd) {
-            CurrentCluster = FAT_CLUSTER_BEGIN;
-            WindowOffset = MAX_ULONG;
-            ClusterEnd = SearchStart;
-        }
-
-        //
-        // Read the next window if needed.
-        //
-
-        if (WindowOffset >= WindowSize) {
-            Status = FatpFatCacheGetFatWindow(Volume,
-                                              TRUE,
-                                              CurrentCluster,
-                                              &Window,
-                                              &WindowOffset);
+    Reserved = FALSE;
+    if ((File != NULL) && (File->ReservedClusterCount != 0)) {
+        Reserved = TRUE;
 
-            if (!KSUCCESS(Status)) {
-                goto AllocateClusterEnd;
-            }
-        }
+    } else if (Volume->FreeClusterCount <= Volume->ReservedClusterCount) {
+        Status = STATUS_VOLUME_FULL;
+        goto AllocateClusterEnd;
+    }
 
-        //
-        // Scan the whole window.
-        //
+    ASSERT(Volume->FreeClusterCount != 0);
 
-        if (Volume->Format == Fat12Format) {
-            while (CurrentCluster < ClusterEnd) {
-                Value = FAT12_READ_CLUSTER(Window, CurrentCluster);
-                if (Value == FAT_CLUSTER_FREE) {
-                    break;
-                }
+    //
+    // If a file is being extended, try to keep it contiguous. The cluster
+    // right after the previous one is best. Failing that, start a new run
+    // somewhere with enough free space behind it that the next several
+    // allocations can extend it in place. A file with space reserved is about
+    // to write that much, so look for a run that holds all of it.
+    //
 
-                CurrentCluster += 1;
-            }
+    SearchStart = Volume->ClusterSearchStart;
+    if ((PreviousCluster >= FAT_CLUSTER_BEGIN) &&
+        (PreviousCluster < ClusterCount)) {
 
-        } else if (Volume->Format == Fat16Format) {
-            Window16 = Window;
-            while ((WindowOffset < WindowSize) &&
-                   (CurrentCluster < ClusterEnd) &&
-                   (Window16[WindowOffset] != FAT_CLUSTER_FREE)) {
+        if (((PreviousCluster + 1) < ClusterCount) &&
+            (!FAT_CLUSTER_BITMAP_TEST(Volume, PreviousCluster + 1))) {
 
-                WindowOffset += 1;
-                CurrentCluster += 1;
-            }
+            AllocatedCluster = PreviousCluster + 1;
 
         } else {
-            Window32 = Window;
-            while ((WindowOffset < WindowSize) &&
-                   (CurrentCluster < ClusterEnd) &&
-                   (Window32[WindowOffset] != FAT_CLUSTER_FREE)) {
+            RunLength = FAT_CONTIGUOUS_RUN_SIZE >> Volume->ClusterShift;
+            if ((Reserved != FALSE) &&
+                (File->ReservedClusterCount > RunLength)) {
 
-                WindowOffset += 1;
-                CurrentCluster += 1;
+                RunLength = File->ReservedClusterCount;
             }
-        }
 
-        if ((WindowOffset >= WindowSize) || (CurrentCluster >= ClusterEnd)) {
-            continue;
+            if (RunLength > 1) {
+                AllocatedCluster = FatpFindFreeClusterRun(Volume,
+                                                          SearchStart,
+                                                          ClusterCount,
+                                                          RunLength);
+
+                if (AllocatedCluster == FAT_CLUSTER_FREE) {
+                    AllocatedCluster = FatpFindFreeClusterRun(Volume,
+                                                              FAT_CLUSTER_BEGIN,
+                                                              SearchStart,
+                                                              RunLength);
+                }
+            }
         }
+    }
 
-        Status = FatpFatCacheWriteClusterEntry(Volume,
-                                               CurrentCluster,
-                                               Volume->ClusterEnd,
-                                               NULL);
+    //
+    // Otherwise take the first free cluster after the last one allocated,
+    // wrapping around to the beginning of the volume if needed.
+    //
 
-        if (!KSUCCESS(Status)) {
-            goto AllocateClusterEnd;
+    if (AllocatedCluster == FAT_CLUSTER_FREE) {
+        AllocatedCluster = FatpFindFreeClusterRun(Volume,
+                                                  SearchStart,
+                                                  ClusterCount,
+                                                  1);
+
+        if (AllocatedCluster == FAT_CLUSTER_FREE) {
+            AllocatedCluster = FatpFindFreeClusterRun(Volume,
+                                                      FAT_CLUSTER_BEGIN,
+                                                      SearchStart,
+                                                      1);
         }
-
-        //
-        // Mark a cluster as allocated now that it's been written in stone.
-        //
-
-        AllocatedCluster = CurrentCluster;
-        break;
     }
 
     //
@@ -1462,6 +1478,27 @@ Return Value:
         goto AllocateClusterEnd;
     }
 
+    Status = FatpFatCacheWriteClusterEntry(Volume,
+                                           AllocatedCluster,
+                                           Volume->ClusterEnd,
+                                           NULL);
+
+    if (!KSUCCESS(Status)) {
+        AllocatedCluster = FAT_CLUSTER_FREE;
+        goto AllocateClusterEnd;
+    }
+
+    //
+    // Mark the cluster as allocated now that it's been written in stone.
+    //
+
+    FAT_CLUSTER_BITMAP_SET(Volume, AllocatedCluster);
+    Volume->FreeClusterCount -= 1;
+    if (Reserved != FALSE) {
+        File->ReservedClusterCount -= 1;
+        Volume->ReservedClusterCount -= 1;
+    }
+
     //
     // Update the FS information block saving the new free space and last block
     // allocated.
@@ -1641,6 +1678,11 @@ Return Value:
             goto FreeClusterChainEnd;
         }
 
+        if (FAT_CLUSTER_BITMAP_TEST(Volume, Cluster)) {
+            FAT_CLUSTER_BITMAP_CLEAR(Volume, Cluster);
+            Volume->FreeClusterCount += 1;
+        }
+
         ClusterCount += 1;
         if (NextCluster >= TotalClusters) {
             break;
@@ -1714,6 +1756,530 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+FatpCreateClusterBitmap (
+    PFAT_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the entire File Allocation Table and builds the
+    in-memory bitmap of allocated clusters used to find free space.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    PULONG Bitmap;
+    ULONG Cluster;
+    ULONG ClusterCount;
+    ULONG FreeCount;
+    KSTATUS Status;
+    ULONG Value;
+    PVOID Window;
+    ULONG WindowEnd;
+    ULONG WindowOffset;
+    ULONG WindowSize;
+
+    ASSERT(Volume->ClusterBitmap == NULL);
+
+    ClusterCount = Volume->ClusterCount;
+    AllocationSize = ALIGN_RANGE_UP(ClusterCount, 32) / BITS_PER_BYTE;
+    Bitmap = FatAllocateNonPagedMemory(Volume->Device.DeviceToken,
+                                       AllocationSize);
+
+    if (Bitmap == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Bitmap, AllocationSize);
+    Volume->ClusterBitmap = Bitmap;
+
+    //
+    // The two reserved clusters at the beginning and the padding bits beyond
+    // the end of the volume can never be allocated.
+    //
+
+    for (Cluster = 0; Cluster < FAT_CLUSTER_BEGIN; Cluster += 1) {
+        FAT_CLUSTER_BITMAP_SET(Volume, Cluster);
+    }
+
+    for (Cluster = ClusterCount;
+         Cluster < ALIGN_RANGE_UP(ClusterCount, 32);
+         Cluster += 1) {
+
+        FAT_CLUSTER_BITMAP_SET(Volume, Cluster);
+    }
+
+    FreeCount = 0;
+    WindowSize = FAT_WINDOW_INDEX_TO_CLUSTER(Volume, 1);
+    Status = STATUS_SUCCESS;
+    FatAcquireLock(Volume->Lock);
+    Cluster = FAT_CLUSTER_BEGIN;
+    while (Cluster < ClusterCount) {
+        Status = FatpFatCacheGetFatWindow(Volume,
+                                          TRUE,
+                                          Cluster,
+                                          &Window,
+                                          &WindowOffset);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        //
+        // A FAT12 table always fits in a single window.
+        //
+
+        if (Volume->Format == Fat12Format) {
+            WindowEnd = ClusterCount;
+
+        } else {
+            WindowEnd = Cluster + (WindowSize - WindowOffset);
+            if (WindowEnd > ClusterCount) {
+                WindowEnd = ClusterCount;
+            }
+        }
+
+        while (Cluster < WindowEnd) {
+            if (Volume->Format == Fat12Format) {
+                Value = FAT12_READ_CLUSTER(Window, Cluster);
+
+            } else if (Volume->Format == Fat16Format) {
+                Value = ((PUSHORT)Window)[WindowOffset];
+
+            } else {
+                Value = ((PULONG)Window)[WindowOffset];
+            }
+
+            if (Value == FAT_CLUSTER_FREE) {
+                FreeCount += 1;
+
+            } else {
+                FAT_CLUSTER_BITMAP_SET(Volume, Cluster);
+            }
+
+            Cluster += 1;
+            WindowOffset += 1;
+        }
+    }
+
+    Volume->FreeClusterCount = FreeCount;
+    FatReleaseLock(Volume->Lock);
+    if (!KSUCCESS(Status)) {
+        FatpDestroyClusterBitmap(Volume);
+    }
+
+    return Status;
+}
+
+VOID
+FatpDestroyClusterBitmap (
+    PFAT_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the in-memory bitmap of allocated clusters.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Volume->ClusterBitmap != NULL) {
+        FatFreeNonPagedMemory(Volume->Device.DeviceToken,
+                              Volume->ClusterBitmap);
+
+        Volume->ClusterBitmap = NULL;
+    }
+
+    Volume->FreeClusterCount = 0;
+    return;
+}
+
+VOID
+FatpInitializeFileExtents (
+    PFAT_FILE File,
+    ULONG FirstCluster
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the extent map of a newly opened file.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    FirstCluster - Supplies the first cluster of the file.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    File->FirstCluster = FirstCluster;
+    File->Extents = &(File->InlineExtent);
+    File->ExtentCapacity = 1;
+    File->ExtentCount = 0;
+    File->MappedClusterCount = 0;
+    if ((FirstCluster >= FAT_CLUSTER_BEGIN) &&
+        (FirstCluster < File->Volume->ClusterCount)) {
+
+        File->InlineExtent.FileCluster = 0;
+        File->InlineExtent.Cluster = FirstCluster;
+        File->InlineExtent.Length = 1;
+        File->ExtentCount = 1;
+        File->MappedClusterCount = 1;
+    }
+
+    return;
+}
+
+VOID
+FatpDestroyFileExtents (
+    PFAT_FILE File
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the extent map of a file.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID DeviceToken;
+
+    if ((File->Extents != NULL) && (File->Extents != &(File->InlineExtent))) {
+        DeviceToken = File->Volume->Device.DeviceToken;
+        if ((File->OpenFlags & OPEN_FLAG_PAGE_FILE) != 0) {
+            FatFreeNonPagedMemory(DeviceToken, File->Extents);
+
+        } else {
+            FatFreePagedMemory(DeviceToken, File->Extents);
+        }
+    }
+
+    File->Extents = NULL;
+    File->ExtentCount = 0;
+    File->ExtentCapacity = 0;
+    File->MappedClusterCount = 0;
+    return;
+}
+
+BOOL
+FatpLookupFileCluster (
+    PFAT_FILE File,
+    ULONG FileCluster,
+    PULONG MappedFileCluster,
+    PULONG Cluster,
+    PULONG RunLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine uses the file's extent map to find the cluster backing the
+    given cluster of the file, or the closest mapped cluster before it.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    FileCluster - Supplies the index of the desired cluster within the file.
+
+    MappedFileCluster - Supplies a pointer where the index of the cluster that
+        was found is returned. This is the desired cluster if it is mapped, or
+        the last mapped cluster of the file otherwise.
+
+    Cluster - Supplies a pointer where the volume cluster number backing the
+        mapped file cluster is returned.
+
+    RunLength - Supplies a pointer where the number of physically contiguous
+        clusters that immediately follow the returned cluster in the file is
+        returned.
+
+Return Value:
+
+    TRUE if a cluster was found.
+
+    FALSE if the extent map is empty.
+
+--*/
+
+{
+
+    PFAT_EXTENT Extent;
+    ULONG High;
+    ULONG Low;
+    ULONG Middle;
+    ULONG Offset;
+    BOOL Result;
+
+    FatAcquireLock(File->ExtentLock);
+    if (File->ExtentCount == 0) {
+        Result = FALSE;
+        goto LookupFileClusterEnd;
+    }
+
+    if (FileCluster >= File->MappedClusterCount) {
+        FileCluster = File->MappedClusterCount - 1;
+    }
+
+    //
+    // Binary search for the last extent starting at or before the cluster.
+    // The first extent always starts at zero.
+    //
+
+    Low = 0;
+    High = File->ExtentCount;
+    while (High - Low > 1) {
+        Middle = Low + ((High - Low) / 2);
+        if (File->Extents[Middle].FileCluster <= FileCluster) {
+            Low = Middle;
+
+        } else {
+            High = Middle;
+        }
+    }
+
+    Extent = &(File->Extents[Low]);
+
+    ASSERT((FileCluster >= Extent->FileCluster) &&
+           (FileCluster < Extent->FileCluster + Extent->Length));
+
+    Offset = FileCluster - Extent->FileCluster;
+    *MappedFileCluster = FileCluster;
+    *Cluster = Extent->Cluster + Offset;
+    *RunLength = Extent->Length - Offset - 1;
+    Result = TRUE;
+
+LookupFileClusterEnd:
+    FatReleaseLock(File->ExtentLock);
+    return Result;
+}
+
+VOID
+FatpAddFileCluster (
+    PFAT_FILE File,
+    ULONG FileCluster,
+    ULONG Cluster
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records the cluster backing the given file cluster in the
+    file's extent map. Since the map only ever covers a prefix of the file,
+    clusters that do not immediately follow the mapped region are ignored.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    FileCluster - Supplies the index of the cluster within the file.
+
+    Cluster - Supplies the volume cluster number backing the file cluster.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Capacity;
+    PVOID DeviceToken;
+    PFAT_EXTENT Extent;
+    PFAT_EXTENT NewExtents;
+
+    ASSERT((Cluster >= FAT_CLUSTER_BEGIN) &&
+           (Cluster < File->Volume->ClusterCount));
+
+    NewExtents = NULL;
+    FatAcquireLock(File->ExtentLock);
+    if ((FileCluster != File->MappedClusterCount) || (File->Extents == NULL)) {
+        goto AddFileClusterEnd;
+    }
+
+    //
+    // Extend the last extent if this cluster is physically contiguous with it.
+    //
+
+    if (File->ExtentCount != 0) {
+        Extent = &(File->Extents[File->ExtentCount - 1]);
+        if (Cluster == Extent->Cluster + Extent->Length) {
+            Extent->Length += 1;
+            File->MappedClusterCount += 1;
+            goto AddFileClusterEnd;
+        }
+    }
+
+    //
+    // A new extent is needed. Grow the array if it is full. A page file maps
+    // its whole chain when it is opened and so is never capped, as it can
+    // never allocate here later.
+    //
+
+    if (File->ExtentCount == File->ExtentCapacity) {
+        if (((File->OpenFlags & OPEN_FLAG_PAGE_FILE) == 0) &&
+            (File->ExtentCapacity >= FAT_MAX_EXTENT_COUNT)) {
+
+            goto AddFileClusterEnd;
+        }
+
+        Capacity = File->ExtentCapacity * 2;
+        if (Capacity < FAT_INITIAL_EXTENT_COUNT) {
+            Capacity = FAT_INITIAL_EXTENT_COUNT;
+        }
+
+        DeviceToken = File->Volume->Device.DeviceToken;
+        if ((File->OpenFlags & OPEN_FLAG_PAGE_FILE) != 0) {
+            NewExtents = FatAllocateNonPagedMemory(
+                                              DeviceToken,
+                                              Capacity * sizeof(FAT_EXTENT));
+
+        } else {
+            NewExtents = FatAllocatePagedMemory(DeviceToken,
+                                                Capacity * sizeof(FAT_EXTENT));
+        }
+
+        if (NewExtents == NULL) {
+            goto AddFileClusterEnd;
+        }
+
+        RtlCopyMemory(NewExtents,
+                      File->Extents,
+                      File->ExtentCount * sizeof(FAT_EXTENT));
+
+        //
+        // Swap in the new array and free the old one after the lock is
+        // released.
+        //
+
+        Extent = File->Extents;
+        File->Extents = NewExtents;
+        File->ExtentCapacity = Capacity;
+        NewExtents = Extent;
+        if (NewExtents == &(File->InlineExtent)) {
+            NewExtents = NULL;
+        }
+    }
+
+    Extent = &(File->Extents[File->ExtentCount]);
+    Extent->FileCluster = FileCluster;
+    Extent->Cluster = Cluster;
+    Extent->Length = 1;
+    File->ExtentCount += 1;
+    File->MappedClusterCount += 1;
+
+AddFileClusterEnd:
+    FatReleaseLock(File->ExtentLock);
+    if (NewExtents != NULL) {
+        DeviceToken = File->Volume->Device.DeviceToken;
+        if ((File->OpenFlags & OPEN_FLAG_PAGE_FILE) != 0) {
+            FatFreeNonPagedMemory(DeviceToken, NewExtents);
+
+        } else {
+            FatFreePagedMemory(DeviceToken, NewExtents);
+        }
+    }
+
+    return;
+}
+
+VOID
+FatpTruncateFileExtents (
+    PFAT_FILE File,
+    ULONG ClusterCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes every cluster at or beyond the given file cluster
+    from the file's extent map.
+
+Arguments:
+
+    File - Supplies a pointer to the file.
+
+    ClusterCount - Supplies the number of clusters the file still has.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PFAT_EXTENT Extent;
+
+    FatAcquireLock(File->ExtentLock);
+    while (File->ExtentCount != 0) {
+        Extent = &(File->Extents[File->ExtentCount - 1]);
+        if (Extent->FileCluster >= ClusterCount) {
+            File->ExtentCount -= 1;
+            continue;
+        }
+
+        if (Extent->FileCluster + Extent->Length > ClusterCount) {
+            Extent->Length = ClusterCount - Extent->FileCluster;
+        }
+
+        break;
+    }
+
+    if (File->MappedClusterCount > ClusterCount) {
+        File->MappedClusterCount = ClusterCount;
+    }
+
+    FatReleaseLock(File->ExtentLock);
+    return;
+}
+
 KSTATUS
 FatpIsDirectoryEmpty (
     PFAT_VOLUME Volume,
@@ -1940,6 +2506,7 @@ Return Value:
     ULONG EntriesRead;
     ULONG EntriesWritten;
     BOOL LocalEntryErased;
+    ULONG LongEntryCount;
     KSTATUS Status;
 
     LocalEntryErased = FALSE;
@@ -2005,7 +2572,8 @@ Return Value:
     Status = FatpPerformLongEntryMaintenance(Directory,
                                              EntryOffset,
                                              Checksum,
-                                             (ULONG)-1);
+                                             (ULONG)-1,
+                                             &LongEntryCount);
 
     if ((Directory->FatFlags & FAT_DIRECTORY_FLAG_DIRTY) == 0) {
         LocalEntryErased = TRUE;
@@ -2036,6 +2604,22 @@ Return Value:
         FatpUnsetFileMapping(Directory->File->Volume, Cluster);
     }
 
+    //
+    // Keep the directory index in sync. If the erase only partially made it
+    // out, the index can't know what's on disk, so throw it away.
+    //
+
+    if (KSUCCESS(Status)) {
+        FatpDirectoryIndexRemove(Directory->File->Volume,
+                                 Directory->File->FirstCluster,
+                                 EntryOffset,
+                                 LongEntryCount + 1);
+
+    } else if (LocalEntryErased != FALSE) {
+        FatpInvalidateDirectoryIndex(Directory->File->Volume,
+                                     Directory->File->FirstCluster);
+    }
+
     *EntryErased = LocalEntryErased;
     return Status;
 }
@@ -2254,6 +2838,7 @@ Return Value:
     }
 
     Status = FatpAllocateCluster(Volume,
+                                 NULL,
                                  Volume->ClusterEnd,
                                  &Cluster,
                                  TRUE);
@@ -2299,7 +2884,8 @@ Return Value:
     Status = FatpPerformLongEntryMaintenance(DirectoryContext,
                                              EntryOffset,
                                              OriginalChecksum,
-                                             NewChecksum);
+                                             NewChecksum,
+                                             NULL);
 
     if (!KSUCCESS(Status)) {
         goto AllocateClusterForEmptyFileEnd;
@@ -2340,7 +2926,8 @@ FatpPerformLongEntryMaintenance (
     PFAT_DIRECTORY_CONTEXT Directory,
     ULONGLONG EntryOffset,
     UCHAR Checksum,
-    ULONG NewChecksum
+    ULONG NewChecksum,
+    PULONG EntriesModified
     )
 
 /*++
@@ -2364,6 +2951,9 @@ Routine Description:
     NewChecksum - Supplies the new checksum to set in the long entries. If this
         is -1, then the directory entries will be marked erased.
 
+    EntriesModified - Supplies an optional pointer where the number of long
+        entries modified will be returned.
+
 Return Value:
 
     Status code.
@@ -2376,6 +2966,7 @@ Return Value:
     ULONG EntriesRead;
     ULONG EntriesWritten;
     PFAT_LONG_DIRECTORY_ENTRY LongEntry;
+    ULONG ModifiedCount;
     UCHAR NextSequence;
     UCHAR Sequence;
     KSTATUS Status;
@@ -2387,6 +2978,7 @@ Return Value:
     // first entry erased.
     //
 
+    ModifiedCount = 0;
     NextSequence = 1;
     while (EntryOffset > DIRECTORY_CONTENTS_OFFSET) {
         EntryOffset -= 1;
@@ -2452,6 +3044,8 @@ Return Value:
 
             ASSERT(EntriesWritten == 1);
 
+            ModifiedCount += 1;
+
             //
             // Stop if that was the last one.
             //
@@ -2470,6 +3064,10 @@ Return Value:
     Status = STATUS_SUCCESS;
 
 PerformLongEntryMaintenanceEnd:
+    if (EntriesModified != NULL) {
+        *EntriesModified = ModifiedCount;
+    }
+
     return Status;
 }
 
@@ -4059,3 +4657,88 @@ Return Value:
     return Status;
 }
 
+ULONG
+FatpFindFreeClusterRun (
+    PFAT_VOLUME Volume,
+    ULONG Start,
+    ULONG End,
+    ULONG RunLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine searches the allocated cluster bitmap for a run of free
+    clusters. The volume lock must be held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Start - Supplies the first cluster to search.
+
+    End - Supplies the cluster to stop searching at, exclusive.
+
+    RunLength - Supplies the number of consecutive free clusters desired.
+
+Return Value:
+
+    Returns the first cluster of the run on success.
+
+    FAT_CLUSTER_FREE if no free run of the given length exists in the range.
+
+--*/
+
+{
+
+    PULONG Bitmap;
+    ULONG Cluster;
+    ULONG RunSize;
+    ULONG RunStart;
+
+    ASSERT(RunLength != 0);
+
+    Bitmap = Volume->ClusterBitmap;
+    if (Start < FAT_CLUSTER_BEGIN) {
+        Start = FAT_CLUSTER_BEGIN;
+    }
+
+    if (End > Volume->ClusterCount) {
+        End = Volume->ClusterCount;
+    }
+
+    RunSize = 0;
+    RunStart = FAT_CLUSTER_FREE;
+    Cluster = Start;
+    while (Cluster < End) {
+
+        //
+        // Skip over fully allocated words quickly.
+        //
+
+        if (((Cluster & 0x1F) == 0) && (Bitmap[Cluster >> 5] == MAX_ULONG)) {
+            RunSize = 0;
+            Cluster += 32;
+            continue;
+        }
+
+        if (FAT_CLUSTER_BITMAP_TEST(Volume, Cluster)) {
+            RunSize = 0;
+
+        } else {
+            if (RunSize == 0) {
+                RunStart = Cluster;
+            }
+
+            RunSize += 1;
+            if (RunSize >= RunLength) {
+                return RunStart;
+            }
+        }
+
+        Cluster += 1;
+    }
+
+    return FAT_CLUSTER_FREE;
+}
@@ -49,6 +49,13 @@ Module Name:
 #define TEST_FILE_SIZE (1024 * 1024 * 8)
 #define BLOCK_ITERATIONS 10000
 #define BLOCK_SIZE 4096
+#define READ_BENCHMARK_ITERATIONS 100000
+#define APPEND_FILE_NAME "append.dat"
+#define APPEND_FILE_SIZE (1024 * 1024 * 4)
+#define APPEND_CHUNK_SIZE (1024 * 16)
+#define LOOKUP_DIRECTORY_NAME "lookup"
+#define LOOKUP_FILE_COUNT 500
+#define LOOKUP_BENCHMARK_PASSES 20
 
 #define USAGE_STRING    \
     "Testfat.exe will test the FAT file system implementation.\n\n" \
@@ -97,6 +104,31 @@ FormatDisk (
     PVOID *VolumeToken
     );
 
+BOOL
+BenchmarkRandomReads (
+    PVOID FileToken,
+    PFAT_IO_BUFFER PageIoBuffer
+    );
+
+BOOL
+BenchmarkAppend (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties
+    );
+
+BOOL
+BenchmarkDirectoryLookups (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties
+    );
+
+KSTATUS
+CreateLookupFile (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties,
+    PCSTR Name
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -474,7 +506,22 @@ Return Value:
         }
     }
 
+    VPRINT("\n");
+    if (BenchmarkRandomReads(FileToken, PageIoBuffer) == FALSE) {
+        goto MainEnd;
+    }
+
     FatCloseFile(FileToken);
+    if (BenchmarkAppend(VolumeToken, &DirectoryProperties) == FALSE) {
+        goto MainEnd;
+    }
+
+    if (BenchmarkDirectoryLookups(VolumeToken, &DirectoryProperties) ==
+        FALSE) {
+
+        goto MainEnd;
+    }
+
     Result = TRUE;
 
 MainEnd:
@@ -497,6 +544,560 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+BOOL
+BenchmarkRandomReads (
+    PVOID FileToken,
+    PFAT_IO_BUFFER PageIoBuffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine times a large number of seeks and block reads at random
+    offsets throughout the test file.
+
+Arguments:
+
+    FileToken - Supplies the open test file.
+
+    PageIoBuffer - Supplies a block sized buffer to read into.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    ULONG BlockIndex;
+    UINTN BytesRead;
+    clock_t End;
+    FAT_SEEK_INFORMATION FatSeekInformation;
+    ULONG Iteration;
+    clock_t Start;
+    KSTATUS Status;
+
+    RtlZeroMemory(&FatSeekInformation, sizeof(FAT_SEEK_INFORMATION));
+    Start = clock();
+    for (Iteration = 0;
+         Iteration < READ_BENCHMARK_ITERATIONS;
+         Iteration += 1) {
+
+        BlockIndex = rand() % (TEST_FILE_SIZE / BLOCK_SIZE);
+        Status = FatFileSeek(FileToken,
+                             NULL,
+                             0,
+                             SeekCommandFromBeginning,
+                             (BlockIndex * BLOCK_SIZE),
+                             &FatSeekInformation);
+
+        if (!KSUCCESS(Status)) {
+            printf("Error: Could not seek to offset 0x%x.\n",
+                   BlockIndex * BLOCK_SIZE);
+
+            return FALSE;
+        }
+
+        Status = FatReadFile(FileToken,
+                             &FatSeekInformation,
+                             PageIoBuffer,
+                             BLOCK_SIZE,
+                             0,
+                             NULL,
+                             &BytesRead);
+
+        if ((!KSUCCESS(Status)) || (BytesRead != BLOCK_SIZE)) {
+            printf("Error: Reading block %x read %lu bytes, status %d.\n",
+                   BlockIndex,
+                   BytesRead,
+                   Status);
+
+            return FALSE;
+        }
+    }
+
+    End = clock();
+    printf("%d random %d byte reads: %.3f seconds.\n",
+           READ_BENCHMARK_ITERATIONS,
+           BLOCK_SIZE,
+           (double)(End - Start) / CLOCKS_PER_SEC);
+
+    return TRUE;
+}
+
+BOOL
+BenchmarkAppend (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties
+    )
+
+/*++
+
+Routine Description:
+
+    This routine times growing a new file to a large size in small appends,
+    then verifies a sampling of what was written.
+
+Arguments:
+
+    VolumeToken - Supplies the mounted volume.
+
+    DirectoryProperties - Supplies the properties of the root directory.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    ULONG ChunkIndex;
+    PULONG ChunkBuffer;
+    PFAT_IO_BUFFER ChunkIoBuffer;
+    clock_t End;
+    FAT_SEEK_INFORMATION FatSeekInformation;
+    PVOID FileToken;
+    ULONG FillIndex;
+    ULONG Iteration;
+    ULONGLONG NewDirectorySize;
+    FILE_PROPERTIES Properties;
+    BOOL Result;
+    clock_t Start;
+    KSTATUS Status;
+
+    ChunkIoBuffer = NULL;
+    FileToken = NULL;
+    Result = FALSE;
+    RtlZeroMemory(&Properties, sizeof(FILE_PROPERTIES));
+    Properties.Type = IoObjectRegularFile;
+    Properties.Permissions = FILE_PERMISSION_USER_READ |
+                             FILE_PERMISSION_USER_WRITE;
+
+    Properties.HardLinkCount = 1;
+    Status = FatCreate(VolumeToken,
+                       DirectoryProperties->FileId,
+                       APPEND_FILE_NAME,
+                       sizeof(APPEND_FILE_NAME),
+                       &NewDirectorySize,
+                       &Properties);
+
+    if (!KSUCCESS(Status)) {
+        printf("Error: Unable to create file %s. Status %d.\n",
+               APPEND_FILE_NAME,
+               Status);
+
+        goto BenchmarkAppendEnd;
+    }
+
+    if (NewDirectorySize > DirectoryProperties->Size) {
+        DirectoryProperties->Size = NewDirectorySize;
+        FatWriteFileProperties(VolumeToken, DirectoryProperties, 0);
+    }
+
+    Status = FatOpenFileId(VolumeToken,
+                           Properties.FileId,
+                           IO_ACCESS_READ | IO_ACCESS_WRITE,
+                           OPEN_FLAG_CREATE,
+                           &FileToken);
+
+    if (!KSUCCESS(Status)) {
+        printf("Error: Unable to open %s. Status %d\n",
+               APPEND_FILE_NAME,
+               Status);
+
+        goto BenchmarkAppendEnd;
+    }
+
+    ChunkIoBuffer = FatAllocateIoBuffer(NULL, APPEND_CHUNK_SIZE);
+    if (ChunkIoBuffer == NULL) {
+        printf("Error: Unable to allocate append buffer.\n");
+        goto BenchmarkAppendEnd;
+    }
+
+    ChunkBuffer = FatMapIoBuffer(ChunkIoBuffer);
+    if (ChunkBuffer == NULL) {
+        printf("Error: Unable to map append buffer.\n");
+        goto BenchmarkAppendEnd;
+    }
+
+    //
+    // Append chunks one at a time, each stamped with its index.
+    //
+
+    RtlZeroMemory(&FatSeekInformation, sizeof(FAT_SEEK_INFORMATION));
+    Start = clock();
+    for (ChunkIndex = 0;
+         ChunkIndex < (APPEND_FILE_SIZE / APPEND_CHUNK_SIZE);
+         ChunkIndex += 1) {
+
+        for (FillIndex = 0;
+             FillIndex < (APPEND_CHUNK_SIZE / sizeof(ULONG));
+             FillIndex += 1) {
+
+            ChunkBuffer[FillIndex] = ChunkIndex;
+        }
+
+        Status = FatWriteFile(FileToken,
+                              &FatSeekInformation,
+                              ChunkIoBuffer,
+                              APPEND_CHUNK_SIZE,
+                              0,
+                              NULL,
+                              &BytesCompleted);
+
+        if ((!KSUCCESS(Status)) || (BytesCompleted != APPEND_CHUNK_SIZE)) {
+            printf("Error: Append %d wrote %lu bytes, status %d.\n",
+                   ChunkIndex,
+                   BytesCompleted,
+                   Status);
+
+            goto BenchmarkAppendEnd;
+        }
+    }
+
+    End = clock();
+    printf("%d byte file appended in %d byte chunks: %.3f seconds.\n",
+           APPEND_FILE_SIZE,
+           APPEND_CHUNK_SIZE,
+           (double)(End - Start) / CLOCKS_PER_SEC);
+
+    //
+    // Read back a sampling of chunks to make sure they landed correctly.
+    //
+
+    for (Iteration = 0; Iteration < 64; Iteration += 1) {
+        ChunkIndex = rand() % (APPEND_FILE_SIZE / APPEND_CHUNK_SIZE);
+        Status = FatFileSeek(FileToken,
+                             NULL,
+                             0,
+                             SeekCommandFromBeginning,
+                             (ChunkIndex * APPEND_CHUNK_SIZE),
+                             &FatSeekInformation);
+
+        if (!KSUCCESS(Status)) {
+            printf("Error: Could not seek to offset 0x%x.\n",
+                   ChunkIndex * APPEND_CHUNK_SIZE);
+
+            goto BenchmarkAppendEnd;
+        }
+
+        Status = FatReadFile(FileToken,
+                             &FatSeekInformation,
+                             ChunkIoBuffer,
+                             APPEND_CHUNK_SIZE,
+                             0,
+                             NULL,
+                             &BytesCompleted);
+
+        if ((!KSUCCESS(Status)) || (BytesCompleted != APPEND_CHUNK_SIZE)) {
+            printf("Error: Reading chunk %d read %lu bytes, status %d.\n",
+                   ChunkIndex,
+                   BytesCompleted,
+                   Status);
+
+            goto BenchmarkAppendEnd;
+        }
+
+        for (FillIndex = 0;
+             FillIndex < (APPEND_CHUNK_SIZE / sizeof(ULONG));
+             FillIndex += 1) {
+
+            if (ChunkBuffer[FillIndex] != ChunkIndex) {
+                printf("Error: Appended chunk %d offset %lu had %x in it.\n",
+                       ChunkIndex,
+                       (long)FillIndex * sizeof(ULONG),
+                       ChunkBuffer[FillIndex]);
+
+                goto BenchmarkAppendEnd;
+            }
+        }
+    }
+
+    Result = TRUE;
+
+BenchmarkAppendEnd:
+    if (FileToken != NULL) {
+        FatCloseFile(FileToken);
+    }
+
+    if (ChunkIoBuffer != NULL) {
+        FatFreeIoBuffer(ChunkIoBuffer);
+    }
+
+    return Result;
+}
+
+BOOL
+BenchmarkDirectoryLookups (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills a directory with many files, times looking them all
+    up, and then makes sure lookups stay correct as files are unlinked and
+    new ones take their place.
+
+Arguments:
+
+    VolumeToken - Supplies the mounted volume.
+
+    DirectoryProperties - Supplies the properties of the root directory.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    ULONGLONG DirectorySize;
+    clock_t End;
+    ULONG FileIndex;
+    FILE_PROPERTIES LookupDirectory;
+    CHAR Name[64];
+    ULONGLONG NewDirectorySize;
+    ULONG Pass;
+    FILE_PROPERTIES Properties;
+    clock_t Start;
+    KSTATUS Status;
+    BOOL Unlinked;
+
+    RtlZeroMemory(&LookupDirectory, sizeof(FILE_PROPERTIES));
+    LookupDirectory.Type = IoObjectRegularDirectory;
+    LookupDirectory.Permissions = FILE_PERMISSION_USER_READ |
+                                  FILE_PERMISSION_USER_WRITE |
+                                  FILE_PERMISSION_USER_EXECUTE;
+
+    LookupDirectory.HardLinkCount = 1;
+    Status = FatCreate(VolumeToken,
+                       DirectoryProperties->FileId,
+                       LOOKUP_DIRECTORY_NAME,
+                       sizeof(LOOKUP_DIRECTORY_NAME),
+                       &NewDirectorySize,
+                       &LookupDirectory);
+
+    if (!KSUCCESS(Status)) {
+        printf("Error: Unable to create directory %s. Status %d.\n",
+               LOOKUP_DIRECTORY_NAME,
+               Status);
+
+        return FALSE;
+    }
+
+    if (NewDirectorySize > DirectoryProperties->Size) {
+        DirectoryProperties->Size = NewDirectorySize;
+        FatWriteFileProperties(VolumeToken, DirectoryProperties, 0);
+    }
+
+    for (FileIndex = 0; FileIndex < LOOKUP_FILE_COUNT; FileIndex += 1) {
+        snprintf(Name, sizeof(Name), "Lookup File %d.txt", FileIndex);
+        Status = CreateLookupFile(VolumeToken, &LookupDirectory, Name);
+        if (!KSUCCESS(Status)) {
+            return FALSE;
+        }
+    }
+
+    //
+    // Time looking up every file several times over.
+    //
+
+    Start = clock();
+    for (Pass = 0; Pass < LOOKUP_BENCHMARK_PASSES; Pass += 1) {
+        for (FileIndex = 0; FileIndex < LOOKUP_FILE_COUNT; FileIndex += 1) {
+            snprintf(Name, sizeof(Name), "Lookup File %d.txt", FileIndex);
+            Status = FatLookup(VolumeToken,
+                               FALSE,
+                               LookupDirectory.FileId,
+                               Name,
+                               strlen(Name) + 1,
+                               &Properties);
+
+            if (!KSUCCESS(Status)) {
+                printf("Error: Unable to look up %s. Status %d.\n",
+                       Name,
+                       Status);
+
+                return FALSE;
+            }
+        }
+    }
+
+    End = clock();
+    printf("%d lookups in a %d file directory: %.3f seconds.\n",
+           LOOKUP_FILE_COUNT * LOOKUP_BENCHMARK_PASSES,
+           LOOKUP_FILE_COUNT,
+           (double)(End - Start) / CLOCKS_PER_SEC);
+
+    //
+    // Unlink every other file, and fill the holes with files of a different
+    // name. The new names are no longer than the old, so the directory
+    // shouldn't grow.
+    //
+
+    DirectorySize = LookupDirectory.Size;
+
+    for (FileIndex = 0; FileIndex < LOOKUP_FILE_COUNT; FileIndex += 2) {
+        snprintf(Name, sizeof(Name), "Lookup File %d.txt", FileIndex);
+        Status = FatLookup(VolumeToken,
+                           FALSE,
+                           LookupDirectory.FileId,
+                           Name,
+                           strlen(Name) + 1,
+                           &Properties);
+
+        if (KSUCCESS(Status)) {
+            Status = FatUnlink(VolumeToken,
+                               LookupDirectory.FileId,
+                               Name,
+                               strlen(Name) + 1,
+                               Properties.FileId,
+                               &Unlinked);
+        }
+
+        if (KSUCCESS(Status)) {
+            Status = FatDeleteFileBlocks(VolumeToken,
+                                         NULL,
+                                         Properties.FileId,
+                                         0,
+                                         FALSE);
+        }
+
+        if (!KSUCCESS(Status)) {
+            printf("Error: Unable to unlink %s. Status %d.\n", Name, Status);
+            return FALSE;
+        }
+    }
+
+    for (FileIndex = 0; FileIndex < LOOKUP_FILE_COUNT; FileIndex += 2) {
+        snprintf(Name, sizeof(Name), "Renamed %d.txt", FileIndex);
+        Status = CreateLookupFile(VolumeToken, &LookupDirectory, Name);
+        if (!KSUCCESS(Status)) {
+            return FALSE;
+        }
+    }
+
+    //
+    // Make sure every name resolves exactly as it should.
+    //
+
+    for (FileIndex = 0; FileIndex < LOOKUP_FILE_COUNT; FileIndex += 1) {
+        snprintf(Name, sizeof(Name), "Lookup File %d.txt", FileIndex);
+        Status = FatLookup(VolumeToken,
+                           FALSE,
+                           LookupDirectory.FileId,
+                           Name,
+                           strlen(Name) + 1,
+                           &Properties);
+
+        if ((FileIndex & 1) == 0) {
+            if (Status != STATUS_PATH_NOT_FOUND) {
+                printf("Error: Unlinked %s lookup returned %d.\n",
+                       Name,
+                       Status);
+
+                return FALSE;
+            }
+
+            snprintf(Name, sizeof(Name), "Renamed %d.txt", FileIndex);
+            Status = FatLookup(VolumeToken,
+                               FALSE,
+                               LookupDirectory.FileId,
+                               Name,
+                               strlen(Name) + 1,
+                               &Properties);
+        }
+
+        if (!KSUCCESS(Status)) {
+            printf("Error: Unable to look up %s. Status %d.\n", Name, Status);
+            return FALSE;
+        }
+    }
+
+    if (LookupDirectory.Size != DirectorySize) {
+        printf("Error: Directory grew from %lld to %lld bytes.\n",
+               DirectorySize,
+               LookupDirectory.Size);
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+KSTATUS
+CreateLookupFile (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties,
+    PCSTR Name
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an empty file for the directory lookup benchmark.
+
+Arguments:
+
+    VolumeToken - Supplies the mounted volume.
+
+    DirectoryProperties - Supplies the properties of the directory to create
+        the file in. The size is updated if the directory grows.
+
+    Name - Supplies the name of the file to create.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONGLONG NewDirectorySize;
+    FILE_PROPERTIES Properties;
+    KSTATUS Status;
+
+    RtlZeroMemory(&Properties, sizeof(FILE_PROPERTIES));
+    Properties.Type = IoObjectRegularFile;
+    Properties.Permissions = FILE_PERMISSION_USER_READ |
+                             FILE_PERMISSION_USER_WRITE;
+
+    Properties.HardLinkCount = 1;
+    Status = FatCreate(VolumeToken,
+                       DirectoryProperties->FileId,
+                       Name,
+                       strlen(Name) + 1,
+                       &NewDirectorySize,
+                       &Properties);
+
+    if (!KSUCCESS(Status)) {
+        printf("Error: Unable to create file %s. Status %d.\n", Name, Status);
+        return Status;
+    }
+
+    if (NewDirectorySize > DirectoryProperties->Size) {
+        DirectoryProperties->Size = NewDirectorySize;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 KSTATUS
 FormatDisk (
     FILE *File,
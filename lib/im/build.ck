@@ -43,12 +43,14 @@ function build() {
         "elf64.c",
         "elfcomm.c",
         "image.c",
+        "imcache.c",
         "imuniv.c",
         "pe.c"
     ];
 
     nativeSources = [
         ":elfcomm.o",
+        ":imcache.o",
         "imnative.c",
     ];
 
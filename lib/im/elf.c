@@ -67,7 +67,9 @@ Module Name:
 #define ImpElfAdjustJumpSlots ImpElf64AdjustJumpSlots
 #define ImpElfGetSymbolValue ImpElf64GetSymbolValue
 #define ImpElfGetSymbolInScope ImpElf64GetSymbolInScope
+#define ImpElfGetCachedSymbol ImpElf64GetCachedSymbol
 #define ImpElfGetSymbol ImpElf64GetSymbol
+#define ImpElfGetSymbolCount ImpElf64GetSymbolCount
 #define ImpElfApplyRelocation ImpElf64ApplyRelocation
 #define ImpElfFreeContext ImpElf64FreeContext
 
@@ -95,7 +97,9 @@ Module Name:
 #define ImpElfAdjustJumpSlots ImpElf32AdjustJumpSlots
 #define ImpElfGetSymbolValue ImpElf32GetSymbolValue
 #define ImpElfGetSymbolInScope ImpElf32GetSymbolInScope
+#define ImpElfGetCachedSymbol ImpElf32GetCachedSymbol
 #define ImpElfGetSymbol ImpElf32GetSymbol
+#define ImpElfGetSymbolCount ImpElf32GetSymbolCount
 #define ImpElfApplyRelocation ImpElf32ApplyRelocation
 #define ImpElfFreeContext ImpElf32FreeContext
 
@@ -143,6 +147,9 @@ Structure Description:
     RelocationEnd - Stores the address at the end of the highest image
         relocation.
 
+    BindingCache - Stores an optional pointer to the symbol binding cache to
+        consult and update while this image is being relocated.
+
 --*/
 
 typedef struct _ELF_LOADING_IMAGE {
@@ -150,6 +157,7 @@ typedef struct _ELF_LOADING_IMAGE {
     PELF_HEADER ElfHeader;
     PVOID RelocationStart;
     PVOID RelocationEnd;
+    PIM_BINDING_CACHE BindingCache;
 } ELF_LOADING_IMAGE, *PELF_LOADING_IMAGE;
 
 //
@@ -212,6 +220,15 @@ ImpElfGetSymbolInScope (
     PLOADED_IMAGE *FoundImage
     );
 
+PELF_SYMBOL
+ImpElfGetCachedSymbol (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    PELF_SYMBOL Symbol,
+    PCSTR SymbolName,
+    PLOADED_IMAGE *FoundImage
+    );
+
 PELF_SYMBOL
 ImpElfGetSymbol (
     PLOADED_IMAGE Image,
@@ -219,6 +236,11 @@ ImpElfGetSymbol (
     PCSTR SymbolName
     );
 
+ULONG
+ImpElfGetSymbolCount (
+    PLOADED_IMAGE Image
+    );
+
 BOOL
 ImpElfApplyRelocation (
     PLOADED_IMAGE Image,
@@ -1644,15 +1666,25 @@ Return Value:
 
 {
 
+    PIM_BINDING_CACHE BindingCache;
     PLIST_ENTRY CurrentEntry;
     PLOADED_IMAGE CurrentImage;
+    PELF_LOADING_IMAGE LoadingImage;
     KSTATUS Status;
 
+    BindingCache = NULL;
     Status = ImpElfLoadAllImports(ListHead);
     if (!KSUCCESS(Status)) {
         goto RelocateImagesEnd;
     }
 
+    //
+    // If this is the initial relocation of the primary executable and its
+    // dependencies, use the saved symbol bindings from the last run.
+    //
+
+    BindingCache = ImpCreateBindingCache(ListHead, ImpElfGetSymbolCount);
+
     //
     // Iterate backwards because a copy relocation in the executable might
     // copy a portion of a shared library that has relocations inside it. So
@@ -1666,7 +1698,10 @@ Return Value:
         ASSERT(CurrentImage->Format == ImageElfNative);
 
         if ((CurrentImage->Flags & IMAGE_FLAG_RELOCATED) == 0) {
+            LoadingImage = CurrentImage->ImageContext;
+            LoadingImage->BindingCache = BindingCache;
             Status = ImpElfRelocateImage(CurrentImage);
+            LoadingImage->BindingCache = NULL;
             if (!KSUCCESS(Status)) {
                 goto RelocateImagesEnd;
             }
@@ -1691,6 +1726,10 @@ Return Value:
     Status = STATUS_SUCCESS;
 
 RelocateImagesEnd:
+    if (BindingCache != NULL) {
+        ImpDestroyBindingCache(BindingCache, KSUCCESS(Status));
+    }
+
     return Status;
 }
 
@@ -3039,6 +3078,7 @@ Return Value:
 
     ELF_SYMBOL_BIND_TYPE BindType;
     ULONG Hash;
+    PELF_LOADING_IMAGE LoadingImage;
     PELF_SYMBOL Potential;
     PSTR SymbolName;
     ELF_ADDR Value;
@@ -3072,10 +3112,22 @@ Return Value:
             }
 
         } else {
-            Potential = ImpElfGetSymbolInScope(Image,
-                                               SkipImage,
-                                               SymbolName,
-                                               FoundImage);
+            LoadingImage = Image->ImageContext;
+            if ((SkipImage == NULL) && (LoadingImage != NULL) &&
+                (LoadingImage->BindingCache != NULL)) {
+
+                Potential = ImpElfGetCachedSymbol(LoadingImage->BindingCache,
+                                                  Image,
+                                                  Symbol,
+                                                  SymbolName,
+                                                  FoundImage);
+
+            } else {
+                Potential = ImpElfGetSymbolInScope(Image,
+                                                   SkipImage,
+                                                   SymbolName,
+                                                   FoundImage);
+            }
         }
 
         if (Potential != NULL) {
@@ -3271,6 +3323,103 @@ Return Value:
     return NULL;
 }
 
+PELF_SYMBOL
+ImpElfGetCachedSymbol (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    PELF_SYMBOL Symbol,
+    PCSTR SymbolName,
+    PLOADED_IMAGE *FoundImage
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the definition of a global symbol using the binding
+    cache, falling back to a search of the image's scope and recording the
+    result if the symbol is not cached. A cached binding is only used if the
+    definition it points to has the same name, so a stale entry costs a
+    search rather than a wrong answer.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Image - Supplies a pointer to the image referencing the symbol.
+
+    Symbol - Supplies a pointer to the symbol within the image's dynamic symbol
+        table.
+
+    SymbolName - Supplies a pointer to the name of the symbol.
+
+    FoundImage - Supplies a pointer where a pointer to the image the symbol
+        was found in will be returned on success.
+
+Return Value:
+
+    Returns a pointer to the symbol definition on success.
+
+    NULL if no such symbol was found.
+
+--*/
+
+{
+
+    BOOL Equal;
+    BOOL Found;
+    PELF_SYMBOL Potential;
+    PSTR PotentialName;
+    PLOADED_IMAGE Provider;
+    ULONG ProviderSymbolIndex;
+    ULONG SymbolIndex;
+
+    SymbolIndex = Symbol - (PELF_SYMBOL)(Image->ExportSymbolTable);
+    Found = ImpLookupBinding(Cache,
+                             Image,
+                             SymbolIndex,
+                             &Provider,
+                             &ProviderSymbolIndex);
+
+    if ((Found != FALSE) && (Provider->ExportSymbolTable != NULL)) {
+        Potential = (PELF_SYMBOL)(Provider->ExportSymbolTable) +
+                    ProviderSymbolIndex;
+
+        if ((Potential->NameOffset < Provider->ExportStringTableSize) &&
+            (Potential->SectionIndex != 0) &&
+            ((Potential->SectionIndex < ELF_SECTION_RESERVED_LOW) ||
+             (Potential->SectionIndex == ELF_SECTION_ABSOLUTE))) {
+
+            PotentialName = Provider->ExportStringTable +
+                            Potential->NameOffset;
+
+            Equal = RtlAreStringsEqual(SymbolName,
+                                       PotentialName,
+                                       Provider->ExportStringTableSize -
+                                       Potential->NameOffset);
+
+            if (Equal != FALSE) {
+                *FoundImage = Provider;
+                return Potential;
+            }
+        }
+    }
+
+    Potential = ImpElfGetSymbolInScope(Image, NULL, SymbolName, FoundImage);
+    if (Potential != NULL) {
+        ProviderSymbolIndex = Potential -
+                              (PELF_SYMBOL)((*FoundImage)->ExportSymbolTable);
+
+        ImpRecordBinding(Cache,
+                         Image,
+                         SymbolIndex,
+                         *FoundImage,
+                         ProviderSymbolIndex);
+    }
+
+    return Potential;
+}
+
 PELF_SYMBOL
 ImpElfGetSymbol (
     PLOADED_IMAGE Image,
@@ -3452,6 +3601,79 @@ Return Value:
     return NULL;
 }
 
+ULONG
+ImpElfGetSymbolCount (
+    PLOADED_IMAGE Image
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of symbols in an image's dynamic symbol
+    table. ELF does not record this directly, so it is derived from the hash
+    table. The SVR hash table has one chain entry per symbol. The GNU hash
+    table only covers the symbols after its base index, and they end with the
+    chain that starts furthest into the table.
+
+Arguments:
+
+    Image - Supplies a pointer to the image to query.
+
+Return Value:
+
+    Returns the number of dynamic symbols, or zero if the image has no
+    export information.
+
+--*/
+
+{
+
+    ELF_WORD BucketCount;
+    ELF_WORD BucketIndex;
+    ELF_WORD FilterWords;
+    PELF_WORD HashChains;
+    PELF_WORD HashTable;
+    ELF_WORD SymbolBase;
+    ELF_WORD SymbolIndex;
+
+    if ((Image->ExportSymbolTable == NULL) ||
+        (Image->ExportHashTable == NULL)) {
+
+        return 0;
+    }
+
+    HashTable = Image->ExportHashTable;
+    if ((Image->Flags & IMAGE_FLAG_GNU_HASH) == 0) {
+        return HashTable[1];
+    }
+
+    BucketCount = *HashTable;
+    HashTable += 1;
+    SymbolBase = *HashTable;
+    HashTable += 1;
+    FilterWords = *HashTable;
+    HashTable += 2;
+    HashTable = (PELF_WORD)(HashTable + FilterWords);
+    SymbolIndex = 0;
+    for (BucketIndex = 0; BucketIndex < BucketCount; BucketIndex += 1) {
+        if (HashTable[BucketIndex] > SymbolIndex) {
+            SymbolIndex = HashTable[BucketIndex];
+        }
+    }
+
+    if ((SymbolIndex == 0) || (SymbolIndex < SymbolBase)) {
+        return SymbolBase;
+    }
+
+    HashChains = HashTable + BucketCount;
+    while ((HashChains[SymbolIndex - SymbolBase] & 0x1) == 0) {
+        SymbolIndex += 1;
+    }
+
+    return SymbolIndex + 1;
+}
+
 BOOL
 ImpElfApplyRelocation (
     PLOADED_IMAGE Image,
@@ -0,0 +1,988 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    imcache.c
+
+Abstract:
+
+    This module implements the persistent symbol binding cache. The cache
+    remembers which image and symbol each symbol reference resolved to the
+    last time a given executable and its libraries were relocated, so that
+    later runs can skip searching the scope for each symbol.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Any
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "imp.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define IM_BINDING_CACHE_MAGIC 0x63426D49 // 'cBmI'
+#define IM_BINDING_CACHE_VERSION 1
+
+//
+// Define the initial and maximum number of slots in the hash table. The slot
+// count must always be a power of two.
+//
+
+#define IM_BINDING_CACHE_INITIAL_SLOTS 1024
+#define IM_BINDING_CACHE_MAX_SLOTS 0x100000
+
+//
+// Define the maximum number of images a cache can describe.
+//
+
+#define IM_BINDING_CACHE_MAX_IMAGES 0x1000
+
+//
+// Define the value stored in the image field of an empty slot. Image indices
+// are stored plus one so that a zeroed table is empty.
+//
+
+#define IM_BINDING_CACHE_EMPTY 0
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure stores the header of a saved binding cache. It is followed
+    by the image identity array and then the hash table slots.
+
+Members:
+
+    Magic - Stores the constant IM_BINDING_CACHE_MAGIC.
+
+    Version - Stores the constant IM_BINDING_CACHE_VERSION.
+
+    Crc32 - Stores the CRC32 of everything following the header.
+
+    Format - Stores the image format of the primary executable.
+
+    Machine - Stores the machine type of the primary executable.
+
+    ImageCount - Stores the number of image identities following the header.
+
+    SlotCount - Stores the number of hash table slots following the image
+        identities.
+
+    EntryCount - Stores the number of hash table slots in use.
+
+--*/
+
+typedef struct _IM_BINDING_CACHE_HEADER {
+    ULONG Magic;
+    ULONG Version;
+    ULONG Crc32;
+    ULONG Format;
+    ULONG Machine;
+    ULONG ImageCount;
+    ULONG SlotCount;
+    ULONG EntryCount;
+} IM_BINDING_CACHE_HEADER, *PIM_BINDING_CACHE_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure stores enough information about a loaded image to tell
+    whether or not it has changed since the cache was written.
+
+Members:
+
+    FileSize - Stores the size of the image file.
+
+    ModificationDate - Stores the modification date of the image file.
+
+    DeviceId - Stores the device identifier the image file lives on.
+
+    FileId - Stores the file identifier of the image file.
+
+    ImageSize - Stores the size of the image in memory.
+
+    NameCrc - Stores the CRC32 of the library name.
+
+    Reserved - Stores padding that is always zero.
+
+--*/
+
+typedef struct _IM_BINDING_CACHE_IMAGE {
+    ULONGLONG FileSize;
+    ULONGLONG ModificationDate;
+    ULONGLONG DeviceId;
+    ULONGLONG FileId;
+    ULONGLONG ImageSize;
+    ULONG NameCrc;
+    ULONG Reserved;
+} IM_BINDING_CACHE_IMAGE, *PIM_BINDING_CACHE_IMAGE;
+
+/*++
+
+Structure Description:
+
+    This structure stores a single hash table slot, binding one symbol
+    reference to its definition.
+
+Members:
+
+    Image - Stores one plus the index of the image referencing the symbol, or
+        IM_BINDING_CACHE_EMPTY if the slot is not in use.
+
+    Symbol - Stores the index of the symbol in the referencing image's dynamic
+        symbol table.
+
+    Provider - Stores the index of the image that defines the symbol.
+
+    ProviderSymbol - Stores the index of the definition in the provider's
+        dynamic symbol table.
+
+--*/
+
+typedef struct _IM_BINDING_CACHE_ENTRY {
+    ULONG Image;
+    ULONG Symbol;
+    ULONG Provider;
+    ULONG ProviderSymbol;
+} IM_BINDING_CACHE_ENTRY, *PIM_BINDING_CACHE_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure stores the in-memory state of a binding cache.
+
+Members:
+
+    Executable - Stores a pointer to the primary executable the cache belongs
+        to.
+
+    Images - Stores an array of pointers to the images on the list, in list
+        order. An image's index in this array is how the cache refers to it.
+
+    SymbolCounts - Stores an array of the number of dynamic symbols in each
+        image, parallel to the images array.
+
+    ImageCount - Stores the number of elements in the images array.
+
+    LastImage - Stores the image most recently translated to an index, since
+        relocations for one image come in long runs.
+
+    LastIndex - Stores the index of the last image.
+
+    Buffer - Stores a pointer to the allocation holding the header, image
+        identities, and hash table, laid out exactly as they are saved.
+
+    Identities - Stores a pointer to the image identities within the buffer.
+
+    Slots - Stores a pointer to the hash table within the buffer.
+
+    SlotCount - Stores the number of slots in the hash table.
+
+    EntryCount - Stores the number of slots in use.
+
+    Dirty - Stores a boolean indicating whether the cache has changed since it
+        was loaded.
+
+--*/
+
+struct _IM_BINDING_CACHE {
+    PLOADED_IMAGE Executable;
+    PLOADED_IMAGE *Images;
+    PULONG SymbolCounts;
+    ULONG ImageCount;
+    PLOADED_IMAGE LastImage;
+    ULONG LastIndex;
+    PVOID Buffer;
+    PIM_BINDING_CACHE_IMAGE Identities;
+    PIM_BINDING_CACHE_ENTRY Slots;
+    ULONG SlotCount;
+    ULONG EntryCount;
+    BOOL Dirty;
+};
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+BOOL
+ImpAdoptSavedBindingCache (
+    PIM_BINDING_CACHE Cache,
+    PIM_BINDING_CACHE_IMAGE Identities,
+    PVOID Buffer,
+    UINTN Size
+    );
+
+KSTATUS
+ImpResizeBindingCache (
+    PIM_BINDING_CACHE Cache,
+    ULONG SlotCount
+    );
+
+PIM_BINDING_CACHE_ENTRY
+ImpFindBindingSlot (
+    PIM_BINDING_CACHE_ENTRY Slots,
+    ULONG SlotCount,
+    ULONG Image,
+    ULONG Symbol
+    );
+
+BOOL
+ImpGetBindingImageIndex (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    PULONG Index
+    );
+
+VOID
+ImpGetBindingImageIdentity (
+    PLOADED_IMAGE Image,
+    PIM_BINDING_CACHE_IMAGE Identity
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+PIM_BINDING_CACHE
+ImpCreateBindingCache (
+    PLIST_ENTRY ListHead,
+    PIM_GET_SYMBOL_COUNT GetSymbolCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the symbol binding cache used while relocating the
+    initial set of images for the primary executable. The saved cache is
+    loaded if the import table supports it, and is discarded if any image on
+    the list has changed since it was written.
+
+Arguments:
+
+    ListHead - Supplies a pointer to the head of the list of loaded images
+        about to be relocated.
+
+    GetSymbolCount - Supplies a pointer to a routine that returns the size of
+        an image's dynamic symbol table, used to bounds check cached bindings.
+
+Return Value:
+
+    Returns a pointer to the binding cache on success.
+
+    NULL if binding caching is not supported or not appropriate for this
+    relocation pass.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    PVOID Buffer;
+    PIM_BINDING_CACHE Cache;
+    PLIST_ENTRY CurrentEntry;
+    PLOADED_IMAGE CurrentImage;
+    BOOL FoundExecutable;
+    PIM_BINDING_CACHE_IMAGE Identities;
+    ULONG ImageCount;
+    ULONG Index;
+    UINTN Size;
+    KSTATUS Status;
+
+    Buffer = NULL;
+    Cache = NULL;
+    Identities = NULL;
+    if ((ImLoadBindingCache == NULL) || (ImSaveBindingCache == NULL) ||
+        (ImPrimaryExecutable == NULL) ||
+        ((ImPrimaryExecutable->Flags & IMAGE_FLAG_RELOCATED) != 0)) {
+
+        goto CreateBindingCacheEnd;
+    }
+
+    //
+    // Only cache the initial load, where the list is exactly the primary
+    // executable and its dependencies. Placeholder images have no symbols to
+    // bind to.
+    //
+
+    FoundExecutable = FALSE;
+    ImageCount = 0;
+    CurrentEntry = ListHead->Next;
+    while (CurrentEntry != ListHead) {
+        CurrentImage = LIST_VALUE(CurrentEntry, LOADED_IMAGE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((CurrentImage->LoadFlags & IMAGE_LOAD_FLAG_PLACEHOLDER) != 0) {
+            goto CreateBindingCacheEnd;
+        }
+
+        if (CurrentImage == ImPrimaryExecutable) {
+            FoundExecutable = TRUE;
+        }
+
+        ImageCount += 1;
+    }
+
+    if ((FoundExecutable == FALSE) ||
+        (ImageCount > IM_BINDING_CACHE_MAX_IMAGES)) {
+
+        goto CreateBindingCacheEnd;
+    }
+
+    AllocationSize = sizeof(IM_BINDING_CACHE) +
+                     (ImageCount * (sizeof(PLOADED_IMAGE) + sizeof(ULONG)));
+
+    Cache = ImAllocateMemory(AllocationSize, IM_ALLOCATION_TAG);
+    if (Cache == NULL) {
+        goto CreateBindingCacheEnd;
+    }
+
+    RtlZeroMemory(Cache, AllocationSize);
+    Cache->Executable = ImPrimaryExecutable;
+    Cache->Images = (PLOADED_IMAGE *)(Cache + 1);
+    Cache->SymbolCounts = (PULONG)(Cache->Images + ImageCount);
+    Cache->ImageCount = ImageCount;
+    Identities = ImAllocateMemory(ImageCount * sizeof(IM_BINDING_CACHE_IMAGE),
+                                  IM_ALLOCATION_TAG);
+
+    if (Identities == NULL) {
+        ImFreeMemory(Cache);
+        Cache = NULL;
+        goto CreateBindingCacheEnd;
+    }
+
+    Index = 0;
+    CurrentEntry = ListHead->Next;
+    while (CurrentEntry != ListHead) {
+        CurrentImage = LIST_VALUE(CurrentEntry, LOADED_IMAGE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Cache->Images[Index] = CurrentImage;
+        Cache->SymbolCounts[Index] = GetSymbolCount(CurrentImage);
+        ImpGetBindingImageIdentity(CurrentImage, &(Identities[Index]));
+        Index += 1;
+    }
+
+    Status = ImLoadBindingCache(Cache->Executable, &Buffer, &Size);
+    if (Status == STATUS_NOT_SUPPORTED) {
+        ImFreeMemory(Cache);
+        Cache = NULL;
+        goto CreateBindingCacheEnd;
+    }
+
+    if (KSUCCESS(Status)) {
+        if (ImpAdoptSavedBindingCache(Cache, Identities, Buffer, Size) !=
+            FALSE) {
+
+            Buffer = NULL;
+            goto CreateBindingCacheEnd;
+        }
+    }
+
+    //
+    // Start over with an empty table, which will be saved at the end.
+    //
+
+    Status = ImpResizeBindingCache(Cache, IM_BINDING_CACHE_INITIAL_SLOTS);
+    if (!KSUCCESS(Status)) {
+        ImFreeMemory(Cache);
+        Cache = NULL;
+        goto CreateBindingCacheEnd;
+    }
+
+    RtlCopyMemory(Cache->Identities,
+                  Identities,
+                  ImageCount * sizeof(IM_BINDING_CACHE_IMAGE));
+
+    Cache->Dirty = TRUE;
+
+CreateBindingCacheEnd:
+    if (Buffer != NULL) {
+        ImFreeMemory(Buffer);
+    }
+
+    if (Identities != NULL) {
+        ImFreeMemory(Identities);
+    }
+
+    return Cache;
+}
+
+VOID
+ImpDestroyBindingCache (
+    PIM_BINDING_CACHE Cache,
+    BOOL Save
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a symbol binding cache, saving it first if it has
+    changed.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to destroy.
+
+    Save - Supplies a boolean indicating whether the cache should be saved if
+        it changed. This is FALSE if relocation failed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIM_BINDING_CACHE_HEADER Header;
+    UINTN Size;
+
+    if ((Save != FALSE) && (Cache->Dirty != FALSE) &&
+        (Cache->Buffer != NULL)) {
+
+        Header = Cache->Buffer;
+        Header->Magic = IM_BINDING_CACHE_MAGIC;
+        Header->Version = IM_BINDING_CACHE_VERSION;
+        Header->Format = Cache->Executable->Format;
+        Header->Machine = Cache->Executable->Machine;
+        Header->ImageCount = Cache->ImageCount;
+        Header->SlotCount = Cache->SlotCount;
+        Header->EntryCount = Cache->EntryCount;
+        Size = (Cache->ImageCount * sizeof(IM_BINDING_CACHE_IMAGE)) +
+               (Cache->SlotCount * sizeof(IM_BINDING_CACHE_ENTRY));
+
+        Header->Crc32 = RtlComputeCrc32(0, Header + 1, Size);
+        Size += sizeof(IM_BINDING_CACHE_HEADER);
+        ImSaveBindingCache(Cache->Executable, Header, Size);
+    }
+
+    if (Cache->Buffer != NULL) {
+        ImFreeMemory(Cache->Buffer);
+    }
+
+    ImFreeMemory(Cache);
+    return;
+}
+
+BOOL
+ImpLookupBinding (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    ULONG SymbolIndex,
+    PLOADED_IMAGE *Provider,
+    PULONG ProviderSymbolIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up the cached binding for an image's symbol. Bindings
+    that point outside the provider's symbol table are treated as misses, but
+    the caller is still expected to check that the definition matches.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Image - Supplies a pointer to the image referencing the symbol.
+
+    SymbolIndex - Supplies the index of the symbol in the image's dynamic
+        symbol table.
+
+    Provider - Supplies a pointer where the image defining the symbol will be
+        returned on success.
+
+    ProviderSymbolIndex - Supplies a pointer where the index of the definition
+        in the provider's dynamic symbol table will be returned on success.
+
+Return Value:
+
+    TRUE if a binding was found.
+
+    FALSE if the symbol is not in the cache.
+
+--*/
+
+{
+
+    ULONG ImageIndex;
+    PIM_BINDING_CACHE_ENTRY Slot;
+
+    if (ImpGetBindingImageIndex(Cache, Image, &ImageIndex) == FALSE) {
+        return FALSE;
+    }
+
+    Slot = ImpFindBindingSlot(Cache->Slots,
+                              Cache->SlotCount,
+                              ImageIndex + 1,
+                              SymbolIndex);
+
+    //
+    // The saved table is only protected by a checksum, so make sure the
+    // binding actually points inside the provider's symbol table.
+    //
+
+    if ((Slot == NULL) || (Slot->Image == IM_BINDING_CACHE_EMPTY) ||
+        (Slot->Provider >= Cache->ImageCount) ||
+        (Slot->ProviderSymbol >= Cache->SymbolCounts[Slot->Provider])) {
+
+        return FALSE;
+    }
+
+    *Provider = Cache->Images[Slot->Provider];
+    *ProviderSymbolIndex = Slot->ProviderSymbol;
+    return TRUE;
+}
+
+VOID
+ImpRecordBinding (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    ULONG SymbolIndex,
+    PLOADED_IMAGE Provider,
+    ULONG ProviderSymbolIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records the binding of an image's symbol in the cache. If
+    memory cannot be allocated the binding is silently dropped.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Image - Supplies a pointer to the image referencing the symbol.
+
+    SymbolIndex - Supplies the index of the symbol in the image's dynamic
+        symbol table.
+
+    Provider - Supplies a pointer to the image defining the symbol.
+
+    ProviderSymbolIndex - Supplies the index of the definition in the
+        provider's dynamic symbol table.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG ImageIndex;
+    ULONG ProviderIndex;
+    PIM_BINDING_CACHE_ENTRY Slot;
+    KSTATUS Status;
+
+    if ((ImpGetBindingImageIndex(Cache, Image, &ImageIndex) == FALSE) ||
+        (ImpGetBindingImageIndex(Cache, Provider, &ProviderIndex) == FALSE)) {
+
+        return;
+    }
+
+    //
+    // Keep the table at most three quarters full so probe sequences stay
+    // short.
+    //
+
+    if ((Cache->EntryCount + 1) > ((Cache->SlotCount / 4) * 3)) {
+        if (Cache->SlotCount >= IM_BINDING_CACHE_MAX_SLOTS) {
+            return;
+        }
+
+        Status = ImpResizeBindingCache(Cache, Cache->SlotCount * 2);
+        if (!KSUCCESS(Status)) {
+            return;
+        }
+    }
+
+    Slot = ImpFindBindingSlot(Cache->Slots,
+                              Cache->SlotCount,
+                              ImageIndex + 1,
+                              SymbolIndex);
+
+    ASSERT(Slot != NULL);
+
+    if (Slot->Image == IM_BINDING_CACHE_EMPTY) {
+        Slot->Image = ImageIndex + 1;
+        Slot->Symbol = SymbolIndex;
+        Cache->EntryCount += 1;
+
+    } else if ((Slot->Provider == ProviderIndex) &&
+               (Slot->ProviderSymbol == ProviderSymbolIndex)) {
+
+        return;
+    }
+
+    Slot->Provider = ProviderIndex;
+    Slot->ProviderSymbol = ProviderSymbolIndex;
+    Cache->Dirty = TRUE;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+BOOL
+ImpAdoptSavedBindingCache (
+    PIM_BINDING_CACHE Cache,
+    PIM_BINDING_CACHE_IMAGE Identities,
+    PVOID Buffer,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine validates a saved binding cache and, if it matches the
+    current set of images, takes it over as the cache's table.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Identities - Supplies a pointer to the identities of the images currently
+        on the list.
+
+    Buffer - Supplies a pointer to the saved cache contents. On success, the
+        cache takes ownership of this buffer.
+
+    Size - Supplies the size of the saved contents in bytes.
+
+Return Value:
+
+    TRUE if the saved cache was valid and adopted.
+
+    FALSE if the saved cache is stale or corrupt.
+
+--*/
+
+{
+
+    ULONG Crc32;
+    UINTN ExpectedSize;
+    PIM_BINDING_CACHE_HEADER Header;
+    UINTN IdentitiesSize;
+
+    Header = Buffer;
+    if (Size < sizeof(IM_BINDING_CACHE_HEADER)) {
+        return FALSE;
+    }
+
+    if ((Header->Magic != IM_BINDING_CACHE_MAGIC) ||
+        (Header->Version != IM_BINDING_CACHE_VERSION) ||
+        (Header->Format != Cache->Executable->Format) ||
+        (Header->Machine != Cache->Executable->Machine) ||
+        (Header->ImageCount != Cache->ImageCount) ||
+        (Header->SlotCount < IM_BINDING_CACHE_INITIAL_SLOTS) ||
+        (Header->SlotCount > IM_BINDING_CACHE_MAX_SLOTS) ||
+        (!POWER_OF_2(Header->SlotCount)) ||
+        (Header->EntryCount >= Header->SlotCount)) {
+
+        return FALSE;
+    }
+
+    IdentitiesSize = Cache->ImageCount * sizeof(IM_BINDING_CACHE_IMAGE);
+    ExpectedSize = sizeof(IM_BINDING_CACHE_HEADER) + IdentitiesSize +
+                   (Header->SlotCount * sizeof(IM_BINDING_CACHE_ENTRY));
+
+    if (Size != ExpectedSize) {
+        return FALSE;
+    }
+
+    Crc32 = RtlComputeCrc32(0,
+                            Header + 1,
+                            Size - sizeof(IM_BINDING_CACHE_HEADER));
+
+    if (Crc32 != Header->Crc32) {
+        return FALSE;
+    }
+
+    //
+    // Any image that was added, removed, reordered, or changed on disk means
+    // the saved bindings may no longer be right.
+    //
+
+    if (RtlCompareMemory(Header + 1, Identities, IdentitiesSize) == FALSE) {
+        return FALSE;
+    }
+
+    Cache->Buffer = Buffer;
+    Cache->Identities = (PIM_BINDING_CACHE_IMAGE)(Header + 1);
+    Cache->Slots = (PIM_BINDING_CACHE_ENTRY)(Cache->Identities +
+                                             Cache->ImageCount);
+
+    Cache->SlotCount = Header->SlotCount;
+    Cache->EntryCount = Header->EntryCount;
+    Cache->Dirty = FALSE;
+    return TRUE;
+}
+
+KSTATUS
+ImpResizeBindingCache (
+    PIM_BINDING_CACHE Cache,
+    ULONG SlotCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a new buffer for the binding cache with the given
+    number of hash table slots, and moves any existing entries into it.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    SlotCount - Supplies the new number of slots. This must be a power of two.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INSUFFICIENT_RESOURCES on allocation failure.
+
+--*/
+
+{
+
+    PVOID Buffer;
+    PIM_BINDING_CACHE_IMAGE Identities;
+    UINTN IdentitiesSize;
+    ULONG Index;
+    PIM_BINDING_CACHE_ENTRY NewSlot;
+    PIM_BINDING_CACHE_ENTRY OldSlot;
+    PIM_BINDING_CACHE_ENTRY Slots;
+    UINTN Size;
+
+    ASSERT(POWER_OF_2(SlotCount));
+
+    IdentitiesSize = Cache->ImageCount * sizeof(IM_BINDING_CACHE_IMAGE);
+    Size = sizeof(IM_BINDING_CACHE_HEADER) + IdentitiesSize +
+           (SlotCount * sizeof(IM_BINDING_CACHE_ENTRY));
+
+    Buffer = ImAllocateMemory(Size, IM_ALLOCATION_TAG);
+    if (Buffer == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Buffer, Size);
+    Identities = (PIM_BINDING_CACHE_IMAGE)((PIM_BINDING_CACHE_HEADER)Buffer +
+                                           1);
+
+    Slots = (PIM_BINDING_CACHE_ENTRY)(Identities + Cache->ImageCount);
+    if (Cache->Buffer != NULL) {
+        RtlCopyMemory(Identities, Cache->Identities, IdentitiesSize);
+        for (Index = 0; Index < Cache->SlotCount; Index += 1) {
+            OldSlot = &(Cache->Slots[Index]);
+            if (OldSlot->Image == IM_BINDING_CACHE_EMPTY) {
+                continue;
+            }
+
+            NewSlot = ImpFindBindingSlot(Slots,
+                                         SlotCount,
+                                         OldSlot->Image,
+                                         OldSlot->Symbol);
+
+            ASSERT((NewSlot != NULL) &&
+                   (NewSlot->Image == IM_BINDING_CACHE_EMPTY));
+
+            *NewSlot = *OldSlot;
+        }
+
+        ImFreeMemory(Cache->Buffer);
+    }
+
+    Cache->Buffer = Buffer;
+    Cache->Identities = Identities;
+    Cache->Slots = Slots;
+    Cache->SlotCount = SlotCount;
+    return STATUS_SUCCESS;
+}
+
+PIM_BINDING_CACHE_ENTRY
+ImpFindBindingSlot (
+    PIM_BINDING_CACHE_ENTRY Slots,
+    ULONG SlotCount,
+    ULONG Image,
+    ULONG Symbol
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the hash table slot for the given key using linear
+    probing.
+
+Arguments:
+
+    Slots - Supplies a pointer to the hash table.
+
+    SlotCount - Supplies the number of slots in the table, a power of two.
+
+    Image - Supplies the stored image value of the key (the image index plus
+        one).
+
+    Symbol - Supplies the symbol index of the key.
+
+Return Value:
+
+    Returns a pointer to the slot holding the key, or the empty slot where it
+    would be inserted.
+
+    NULL if the table is full and does not contain the key.
+
+--*/
+
+{
+
+    ULONG Hash;
+    ULONG Mask;
+    ULONG Probe;
+    PIM_BINDING_CACHE_ENTRY Slot;
+
+    Hash = (Image * 0x9E3779B1) ^ (Symbol * 0x85EBCA6B);
+    Hash ^= Hash >> 15;
+    Mask = SlotCount - 1;
+    for (Probe = 0; Probe < SlotCount; Probe += 1) {
+        Slot = &(Slots[(Hash + Probe) & Mask]);
+        if ((Slot->Image == IM_BINDING_CACHE_EMPTY) ||
+            ((Slot->Image == Image) && (Slot->Symbol == Symbol))) {
+
+            return Slot;
+        }
+    }
+
+    return NULL;
+}
+
+BOOL
+ImpGetBindingImageIndex (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    PULONG Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the index the cache uses to refer to the given image.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Image - Supplies a pointer to the image to find.
+
+    Index - Supplies a pointer where the image index will be returned on
+        success.
+
+Return Value:
+
+    TRUE if the image was found.
+
+    FALSE if the image is not one the cache knows about.
+
+--*/
+
+{
+
+    ULONG Search;
+
+    if (Image == Cache->LastImage) {
+        *Index = Cache->LastIndex;
+        return TRUE;
+    }
+
+    for (Search = 0; Search < Cache->ImageCount; Search += 1) {
+        if (Cache->Images[Search] == Image) {
+            Cache->LastImage = Image;
+            Cache->LastIndex = Search;
+            *Index = Search;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+VOID
+ImpGetBindingImageIdentity (
+    PLOADED_IMAGE Image,
+    PIM_BINDING_CACHE_IMAGE Identity
+    )
+
+/*++
+
+Routine Description:
+
+    This routine collects the information used to decide whether an image has
+    changed since a cache was saved.
+
+Arguments:
+
+    Image - Supplies a pointer to the image.
+
+    Identity - Supplies a pointer where the identity will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN NameLength;
+
+    RtlZeroMemory(Identity, sizeof(IM_BINDING_CACHE_IMAGE));
+    Identity->FileSize = Image->File.Size;
+    Identity->ModificationDate = Image->File.ModificationDate;
+    Identity->DeviceId = Image->File.DeviceId;
+    Identity->FileId = Image->File.FileId;
+    Identity->ImageSize = Image->Size;
+    if (Image->LibraryName != NULL) {
+        NameLength = RtlStringLength(Image->LibraryName);
+        Identity->NameCrc = RtlComputeCrc32(0, Image->LibraryName, NameLength);
+    }
+
+    return;
+}
+
@@ -62,6 +62,8 @@ Module Name:
 
 #define ImGetEnvironmentVariable ImImportTable->GetEnvironmentVariable
 #define ImFinalizeSegments ImImportTable->FinalizeSegments
+#define ImLoadBindingCache ImImportTable->LoadBindingCache
+#define ImSaveBindingCache ImImportTable->SaveBindingCache
 
 //
 // Define the initial scope array size.
@@ -80,6 +82,32 @@ Module Name:
 // ------------------------------------------------------ Data Type Definitions
 //
 
+typedef struct _IM_BINDING_CACHE IM_BINDING_CACHE, *PIM_BINDING_CACHE;
+
+typedef
+ULONG
+(*PIM_GET_SYMBOL_COUNT) (
+    PLOADED_IMAGE Image
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of symbols in an image's dynamic symbol
+    table.
+
+Arguments:
+
+    Image - Supplies a pointer to the image to query.
+
+Return Value:
+
+    Returns the number of dynamic symbols, or zero if the image has no
+    export information.
+
+--*/
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -211,3 +239,137 @@ Return Value:
 
 --*/
 
+PIM_BINDING_CACHE
+ImpCreateBindingCache (
+    PLIST_ENTRY ListHead,
+    PIM_GET_SYMBOL_COUNT GetSymbolCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates the symbol binding cache used while relocating the
+    initial set of images for the primary executable. The saved cache is
+    loaded if the import table supports it, and is discarded if any image on
+    the list has changed since it was written.
+
+Arguments:
+
+    ListHead - Supplies a pointer to the head of the list of loaded images
+        about to be relocated.
+
+    GetSymbolCount - Supplies a pointer to a routine that returns the size of
+        an image's dynamic symbol table, used to bounds check cached bindings.
+
+Return Value:
+
+    Returns a pointer to the binding cache on success.
+
+    NULL if binding caching is not supported or not appropriate for this
+    relocation pass.
+
+--*/
+
+VOID
+ImpDestroyBindingCache (
+    PIM_BINDING_CACHE Cache,
+    BOOL Save
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys a symbol binding cache, saving it first if it has
+    changed.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache to destroy.
+
+    Save - Supplies a boolean indicating whether the cache should be saved if
+        it changed. This is FALSE if relocation failed.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+ImpLookupBinding (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    ULONG SymbolIndex,
+    PLOADED_IMAGE *Provider,
+    PULONG ProviderSymbolIndex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine looks up the cached binding for an image's symbol. Bindings
+    that point outside the provider's symbol table are treated as misses, but
+    the caller is still expected to check that the definition matches.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Image - Supplies a pointer to the image referencing the symbol.
+
+    SymbolIndex - Supplies the index of the symbol in the image's dynamic
+        symbol table.
+
+    Provider - Supplies a pointer where the image defining the symbol will be
+        returned on success.
+
+    ProviderSymbolIndex - Supplies a pointer where the index of the definition
+        in the provider's dynamic symbol table will be returned on success.
+
+Return Value:
+
+    TRUE if a binding was found.
+
+    FALSE if the symbol is not in the cache.
+
+--*/
+
+VOID
+ImpRecordBinding (
+    PIM_BINDING_CACHE Cache,
+    PLOADED_IMAGE Image,
+    ULONG SymbolIndex,
+    PLOADED_IMAGE Provider,
+    ULONG ProviderSymbolIndex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine records the binding of an image's symbol in the cache. If
+    memory cannot be allocated the binding is silently dropped.
+
+Arguments:
+
+    Cache - Supplies a pointer to the binding cache.
+
+    Image - Supplies a pointer to the image referencing the symbol.
+
+    SymbolIndex - Supplies the index of the symbol in the image's dynamic
+        symbol table.
+
+    Provider - Supplies a pointer to the image defining the symbol.
+
+    ProviderSymbolIndex - Supplies the index of the definition in the
+        provider's dynamic symbol table.
+
+Return Value:
+
+    None.
+
+--*/
+
@@ -32,6 +32,7 @@ function build() {
     var arch = mconfig.arch;
     var armv7BootSources;
     var armv7Intrinsics;
+    var armv7SimdSources;
     var armv7Sources;
     var baseRtl32Lib;
     var baseRtl32Sources;
@@ -81,7 +82,8 @@ function build() {
 
     x86Sources = x86Intrinsics + [
         "x86/rtlarch.S",
-        "x86/rtlmem.S"
+        "x86/rtlmem.S",
+        "x86/rtlsimd.S"
     ];
 
     armv7Intrinsics = [
@@ -95,6 +97,14 @@ function build() {
         "fp2int.c"
     ];
 
+    //
+    // The NEON routines are only built for ARMv7, as ARMv6 has no NEON unit.
+    //
+
+    armv7SimdSources = [
+        "armv7/rtlsimd.S"
+    ];
+
     //
     // Add eabisfp.c and softfp.c even though they're not needed in this
     // library just so they get exercise.
@@ -110,7 +120,8 @@ function build() {
 
     x64Sources = [
         "x64/rtlarch.S",
-        "x64/rtlmem.S"
+        "x64/rtlmem.S",
+        "x64/rtlsimd.S"
     ];
 
     //
@@ -123,6 +134,10 @@ function build() {
 
     } else if ((arch == "armv7") || (arch == "armv6")) {
         targetSources = sources + armv7Sources;
+        if (arch == "armv7") {
+            targetSources += armv7SimdSources;
+        }
+
         intrinsics = armv7Intrinsics;
         bootSources = sources + armv7BootSources;
 
@@ -148,6 +163,9 @@ function build() {
                (mconfig.build_arch == "armv6")) {
 
         buildSources += armv7Sources;
+        if (mconfig.build_arch == "armv7") {
+            buildSources += armv7SimdSources;
+        }
 
     } else if (mconfig.build_arch == "x64") {
         buildSources += x64Sources + [
@@ -75,6 +75,18 @@ Module Name:
 #define FORMAT_HEX_CAPITAL 'X'
 #define FORMAT_LONGLONG_START 'I'
 
+//
+// Define the size of the local buffer used to write out padding in bulk.
+//
+
+#define PRINT_PADDING_BUFFER_SIZE 32
+
+//
+// Define the size below which string format output is copied by hand.
+//
+
+#define PRINT_SHORT_COPY_SIZE 32
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -120,10 +132,34 @@ RtlpStringFormatWriteCharacter (
     PPRINT_FORMAT_CONTEXT Context
     );
 
+UINTN
+RtlpStringFormatWriteString (
+    PCSTR String,
+    UINTN Size,
+    PPRINT_FORMAT_CONTEXT Context
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
+//
+// Store the two digit strings for every value from 0 to 99, used to convert
+// decimal integers two digits at a time.
+//
+
+const CHAR RtlpDecimalDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -233,6 +269,7 @@ Return Value:
 
     RtlZeroMemory(&Context, sizeof(PRINT_FORMAT_CONTEXT));
     Context.WriteCharacter = RtlpStringFormatWriteCharacter;
+    Context.WriteString = RtlpStringFormatWriteString;
     Context.Context = Destination;
     if (DestinationSize != 0) {
         Context.Limit = DestinationSize - 1;
@@ -288,6 +325,7 @@ Return Value:
 
     va_list ArgumentListCopy;
     ULONG Index;
+    ULONG LiteralEnd;
     BOOL Result;
 
     ASSERT((Context != NULL) && (Context->WriteCharacter != NULL) &&
@@ -316,13 +354,28 @@ Return Value:
                 goto FormatEnd;
             }
 
+        //
+        // Write out the run of literal characters up to the next conversion
+        // all at once.
+        //
+
         } else {
-            Result = RtlpFormatWriteCharacter(Context, Format[Index]);
+            LiteralEnd = Index + 1;
+            while ((Format[LiteralEnd] != STRING_TERMINATOR) &&
+                   (Format[LiteralEnd] != CONVERSION_CHARACTER)) {
+
+                LiteralEnd += 1;
+            }
+
+            Result = RtlpFormatWriteString(Context,
+                                           Format + Index,
+                                           LiteralEnd - Index);
+
             if (Result == FALSE) {
                 goto FormatEnd;
             }
 
-            Index += 1;
+            Index = LiteralEnd;
         }
     }
 
@@ -375,7 +428,6 @@ Return Value:
 
 {
 
-    ULONG PaddingIndex;
     ULONG PaddingLength;
     BOOL Result;
     ULONG StringLength;
@@ -404,48 +456,35 @@ Return Value:
         PaddingLength = FieldWidth - StringLength;
     }
 
-    PaddingIndex = PaddingLength;
-
     //
     // Pad left, if required.
     //
 
     if (LeftJustified == FALSE) {
-        while (PaddingIndex > 0) {
-            Result = RtlpFormatWriteCharacter(Context, ' ');
-            if (Result == FALSE) {
-                return FALSE;
-            }
-
-            PaddingIndex -= 1;
+        Result = RtlpFormatWriteRepeatedCharacter(Context, ' ', PaddingLength);
+        if (Result == FALSE) {
+            return FALSE;
         }
+
+        PaddingLength = 0;
     }
 
     //
     // Copy the string.
     //
 
-    while (StringLength != 0) {
-        Result = RtlpFormatWriteCharacter(Context, *String);
-        if (Result == FALSE) {
-            return FALSE;
-        }
-
-        String += 1;
-        StringLength -= 1;
+    Result = RtlpFormatWriteString(Context, String, StringLength);
+    if (Result == FALSE) {
+        return FALSE;
     }
 
     //
     // Pad right, if required.
     //
 
-    while (PaddingIndex > 0) {
-        Result = RtlpFormatWriteCharacter(Context, ' ');
-        if (Result == FALSE) {
-            return FALSE;
-        }
-
-        PaddingIndex -= 1;
+    Result = RtlpFormatWriteRepeatedCharacter(Context, ' ', PaddingLength);
+    if (Result == FALSE) {
+        return FALSE;
     }
 
     return TRUE;
@@ -488,22 +527,24 @@ Return Value:
 {
 
     UCHAR Character;
+    PSTR Digits;
     ULONG FieldCount;
-    ULONG FieldIndex;
     ULONG IntegerLength;
     CHAR LocalBuffer[MAX_INTEGER_STRING_SIZE];
-    ULONG LocalIndex;
     BOOL Negative;
     ULONGLONG NextInteger;
     LONG Precision;
     ULONG PrecisionCount;
-    ULONG PrecisionIndex;
-    UCHAR Prefix[4];
-    ULONG PrefixIndex;
+    CHAR Prefix[4];
     ULONG PrefixSize;
+    ULONG Radix;
     ULONGLONG Remainder;
     BOOL Result;
+    ULONG Shift;
+    ULONG SmallInteger;
+    ULONG SmallRemainder;
 
+    Digits = LocalBuffer + sizeof(LocalBuffer);
     IntegerLength = 0;
     Negative = FALSE;
     Precision = Properties->Precision;
@@ -551,53 +592,84 @@ Return Value:
         }
 
         //
-        // Convert the integer into a reversed string.
+        // Convert the integer into a string, filling the local buffer from
+        // the end backwards. Decimal numbers are converted two digits at a
+        // time, using native word sized division once the value is small
+        // enough. The power of two radices just shift.
         //
 
-        RtlZeroMemory(LocalBuffer, sizeof(LocalBuffer));
-        do {
+        Radix = Properties->Radix;
+        if (Radix == 10) {
+            while (Integer > MAX_ULONG) {
+                NextInteger = RtlDivideUnsigned64(Integer, 100, &Remainder);
+                Digits -= 2;
+                Digits[0] = RtlpDecimalDigitPairs[Remainder * 2];
+                Digits[1] = RtlpDecimalDigitPairs[(Remainder * 2) + 1];
+                Integer = NextInteger;
+            }
 
-            //
-            // Get the least significant digit.
-            //
+            SmallInteger = (ULONG)Integer;
+            while (SmallInteger >= 100) {
+                SmallRemainder = SmallInteger % 100;
+                SmallInteger /= 100;
+                Digits -= 2;
+                Digits[0] = RtlpDecimalDigitPairs[SmallRemainder * 2];
+                Digits[1] = RtlpDecimalDigitPairs[(SmallRemainder * 2) + 1];
+            }
 
-            NextInteger = RtlDivideUnsigned64(Integer,
-                                              Properties->Radix,
-                                              &Remainder);
+            if (SmallInteger >= 10) {
+                Digits -= 2;
+                Digits[0] = RtlpDecimalDigitPairs[SmallInteger * 2];
+                Digits[1] = RtlpDecimalDigitPairs[(SmallInteger * 2) + 1];
 
-            Character = (UCHAR)Remainder;
-            if (Character > 9) {
-                if (Properties->PrintUpperCase != FALSE) {
-                    Character = Character - 10 + 'A';
+            } else {
+                Digits -= 1;
+                Digits[0] = '0' + SmallInteger;
+            }
 
-                } else {
-                    Character = Character - 10 + 'a';
-                }
+        } else {
+            Shift = 0;
+            if (Radix == 16) {
+                Shift = 4;
 
-            } else {
-                Character += '0';
+            } else if (Radix == 8) {
+                Shift = 3;
             }
 
-            //
-            // Write out the character.
-            //
+            do {
 
-            LocalBuffer[IntegerLength] = Character;
-            IntegerLength += 1;
+                //
+                // Get the least significant digit.
+                //
 
-            //
-            // Use the divided integer to get the next least significant digit.
-            //
+                if (Shift != 0) {
+                    Character = (UCHAR)Integer & (Radix - 1);
+                    Integer >>= Shift;
 
-            Integer = NextInteger;
+                } else {
+                    Integer = RtlDivideUnsigned64(Integer, Radix, &Remainder);
+                    Character = (UCHAR)Remainder;
+                }
 
-        } while (Integer > 0);
+                if (Character > 9) {
+                    if (Properties->PrintUpperCase != FALSE) {
+                        Character = Character - 10 + 'A';
 
-        //
-        // Reverse the integer string.
-        //
+                    } else {
+                        Character = Character - 10 + 'a';
+                    }
 
-        RtlStringReverse(LocalBuffer, LocalBuffer + IntegerLength);
+                } else {
+                    Character += '0';
+                }
+
+                Digits -= 1;
+                Digits[0] = Character;
+
+            } while (Integer > 0);
+        }
+
+        IntegerLength = (LocalBuffer + sizeof(LocalBuffer)) - Digits;
     }
 
     //
@@ -622,7 +694,7 @@ Return Value:
 
     if (Properties->PrintRadix != FALSE) {
         if (Properties->Radix == 8) {
-            if (LocalBuffer[0] != '0') {
+            if ((IntegerLength == 0) || (Digits[0] != '0')) {
                 Prefix[PrefixSize] = '0';
                 PrefixSize += 1;
             }
@@ -679,11 +751,9 @@ Return Value:
         Character = ' ';
         if (Properties->PrintLeadingZeroes != FALSE) {
             Character = '0';
-            for (PrefixIndex = 0; PrefixIndex < PrefixSize; PrefixIndex += 1) {
-                Result = RtlpFormatWriteCharacter(Context, Prefix[PrefixIndex]);
-                if (Result == FALSE) {
-                    return FALSE;
-                }
+            Result = RtlpFormatWriteString(Context, Prefix, PrefixSize);
+            if (Result == FALSE) {
+                return FALSE;
             }
 
             //
@@ -693,11 +763,12 @@ Return Value:
             PrefixSize = 0;
         }
 
-        for (FieldIndex = 0; FieldIndex < FieldCount; FieldIndex += 1) {
-            Result = RtlpFormatWriteCharacter(Context, Character);
-            if (Result == FALSE) {
-                return FALSE;
-            }
+        Result = RtlpFormatWriteRepeatedCharacter(Context,
+                                                  Character,
+                                                  FieldCount);
+
+        if (Result == FALSE) {
+            return FALSE;
         }
 
         FieldCount = 0;
@@ -708,28 +779,19 @@ Return Value:
     // followed by the integer itself.
     //
 
-    for (PrefixIndex = 0; PrefixIndex < PrefixSize; PrefixIndex += 1) {
-        Result = RtlpFormatWriteCharacter(Context, Prefix[PrefixIndex]);
-        if (Result == FALSE) {
-            return FALSE;
-        }
+    Result = RtlpFormatWriteString(Context, Prefix, PrefixSize);
+    if (Result == FALSE) {
+        return FALSE;
     }
 
-    for (PrecisionIndex = 0;
-         PrecisionIndex < PrecisionCount;
-         PrecisionIndex += 1) {
-
-        Result = RtlpFormatWriteCharacter(Context, '0');
-        if (Result == FALSE) {
-            return FALSE;
-        }
+    Result = RtlpFormatWriteRepeatedCharacter(Context, '0', PrecisionCount);
+    if (Result == FALSE) {
+        return FALSE;
     }
 
-    for (LocalIndex = 0; LocalIndex < IntegerLength; LocalIndex += 1) {
-        Result = RtlpFormatWriteCharacter(Context, LocalBuffer[LocalIndex]);
-        if (Result == FALSE) {
-            return FALSE;
-        }
+    Result = RtlpFormatWriteString(Context, Digits, IntegerLength);
+    if (Result == FALSE) {
+        return FALSE;
     }
 
     //
@@ -737,11 +799,9 @@ Return Value:
     // They must be spaces, as there can't be leading zeroes on the end.
     //
 
-    for (FieldIndex = 0; FieldIndex < FieldCount; FieldIndex += 1) {
-        Result = RtlpFormatWriteCharacter(Context, ' ');
-        if (Result == FALSE) {
-            return FALSE;
-        }
+    Result = RtlpFormatWriteRepeatedCharacter(Context, ' ', FieldCount);
+    if (Result == FALSE) {
+        return FALSE;
     }
 
     return TRUE;
@@ -786,6 +846,143 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+RtlpFormatWriteString (
+    PPRINT_FORMAT_CONTEXT Context,
+    PCSTR String,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes a run of characters to the print format destination,
+    in one go if the destination supports it.
+
+Arguments:
+
+    Context - Supplies a pointer to the print format context.
+
+    String - Supplies a pointer to the characters to write.
+
+    Size - Supplies the number of characters to write.
+
+Return Value:
+
+    TRUE if all characters were written.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    BOOL Result;
+    UINTN Written;
+
+    if (Size == 0) {
+        return TRUE;
+    }
+
+    if (Context->WriteString != NULL) {
+        Written = Context->WriteString(String, Size, Context);
+        Context->CharactersWritten += Written;
+        if (Written != Size) {
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    while (Size != 0) {
+        Result = RtlpFormatWriteCharacter(Context, *String);
+        if (Result == FALSE) {
+            return FALSE;
+        }
+
+        String += 1;
+        Size -= 1;
+    }
+
+    return TRUE;
+}
+
+BOOL
+RtlpFormatWriteRepeatedCharacter (
+    PPRINT_FORMAT_CONTEXT Context,
+    CHAR Character,
+    UINTN Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes the same character to the print format destination a
+    number of times, usually for padding a field.
+
+Arguments:
+
+    Context - Supplies a pointer to the print format context.
+
+    Character - Supplies the character to write.
+
+    Count - Supplies the number of times to write the character.
+
+Return Value:
+
+    TRUE if all characters were written.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    CHAR Buffer[PRINT_PADDING_BUFFER_SIZE];
+    BOOL Result;
+    UINTN Size;
+
+    if (Count == 0) {
+        return TRUE;
+    }
+
+    if (Context->WriteString == NULL) {
+        while (Count != 0) {
+            Result = RtlpFormatWriteCharacter(Context, Character);
+            if (Result == FALSE) {
+                return FALSE;
+            }
+
+            Count -= 1;
+        }
+
+        return TRUE;
+    }
+
+    Size = Count;
+    if (Size > sizeof(Buffer)) {
+        Size = sizeof(Buffer);
+    }
+
+    RtlSetMemory(Buffer, Character, Size);
+    while (Count != 0) {
+        if (Size > Count) {
+            Size = Count;
+        }
+
+        Result = RtlpFormatWriteString(Context, Buffer, Size);
+        if (Result == FALSE) {
+            return FALSE;
+        }
+
+        Count -= Size;
+    }
+
+    return TRUE;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2019,3 +2216,66 @@ Return Value:
     return TRUE;
 }
 
+UINTN
+RtlpStringFormatWriteString (
+    PCSTR String,
+    UINTN Size,
+    PPRINT_FORMAT_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes a run of characters to the string during a
+    printf-style formatting operation.
+
+Arguments:
+
+    String - Supplies a pointer to the characters to write.
+
+    Size - Supplies the number of characters to write.
+
+    Context - Supplies a pointer to the printf-context.
+
+Return Value:
+
+    Returns the number of characters written, which is always the given size.
+    Characters beyond the limit are counted but dropped.
+
+--*/
+
+{
+
+    UINTN CopySize;
+    PSTR Destination;
+    UINTN Index;
+
+    Destination = Context->Context;
+    if ((Destination != NULL) &&
+        (Context->CharactersWritten < Context->Limit)) {
+
+        CopySize = Context->Limit - Context->CharactersWritten;
+        if (CopySize > Size) {
+            CopySize = Size;
+        }
+
+        //
+        // Most runs are short, where a simple loop beats the setup cost of
+        // the block copy.
+        //
+
+        Destination += Context->CharactersWritten;
+        if (CopySize < PRINT_SHORT_COPY_SIZE) {
+            for (Index = 0; Index < CopySize; Index += 1) {
+                Destination[Index] = String[Index];
+            }
+
+        } else {
+            RtlCopyMemory(Destination, (PVOID)String, CopySize);
+        }
+    }
+
+    return Size;
+}
+
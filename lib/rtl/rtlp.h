@@ -335,6 +335,66 @@ Return Value:
 
 --*/
 
+BOOL
+RtlpFormatWriteString (
+    PPRINT_FORMAT_CONTEXT Context,
+    PCSTR String,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine writes a run of characters to the print format destination,
+    in one go if the destination supports it.
+
+Arguments:
+
+    Context - Supplies a pointer to the print format context.
+
+    String - Supplies a pointer to the characters to write.
+
+    Size - Supplies the number of characters to write.
+
+Return Value:
+
+    TRUE if all characters were written.
+
+    FALSE on failure.
+
+--*/
+
+BOOL
+RtlpFormatWriteRepeatedCharacter (
+    PPRINT_FORMAT_CONTEXT Context,
+    CHAR Character,
+    UINTN Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine writes the same character to the print format destination a
+    number of times, usually for padding a field.
+
+Arguments:
+
+    Context - Supplies a pointer to the print format context.
+
+    Character - Supplies the character to write.
+
+    Count - Supplies the number of times to write the character.
+
+Return Value:
+
+    TRUE if all characters were written.
+
+    FALSE on failure.
+
+--*/
+
 LONG
 RtlpGetDoubleBase10Exponent (
     double Value,
@@ -0,0 +1,646 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    memtest.c
+
+Abstract:
+
+    This module tests the SIMD memory and string routines in the runtime
+    library against simple reference implementations, and optionally measures
+    them against the generic routines across a sweep of sizes.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Test
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#define RTL_API
+
+#include <minoca/lib/types.h>
+#include <minoca/lib/status.h>
+#include <minoca/lib/rtl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define whether or not the runtime library has SIMD routines for the
+// architecture this test is being built for.
+//
+
+#if defined(__i386) || defined(__amd64) || defined(__ARM_ARCH_7A__)
+
+#define TEST_SIMD_ROUTINES 1
+
+#else
+
+#define TEST_SIMD_ROUTINES 0
+
+#endif
+
+//
+// Define the size of the test buffers. This is big enough to exercise the
+// non-temporal store paths.
+//
+
+#define TEST_MEMORY_BUFFER_SIZE (8 * 1024 * 1024)
+
+//
+// Define the amount of slack around each operation used to catch writes
+// outside the requested region.
+//
+
+#define TEST_MEMORY_GUARD 64
+
+//
+// Define the largest misalignment tried.
+//
+
+#define TEST_MEMORY_ALIGNMENTS 16
+
+//
+// Define the largest size for which every size is tested.
+//
+
+#define TEST_MEMORY_EXHAUSTIVE_SIZE 300
+
+//
+// Define the number of bytes each benchmark size is run over in total.
+//
+
+#define TEST_MEMORY_BENCHMARK_TOTAL (64ULL * 1024 * 1024)
+
+//
+// Define a tiny amount of time added to each measurement so that the
+// throughput calculation never divides by zero.
+//
+
+#define TEST_MEMORY_MINIMUM_TIME 0.000001
+
+//
+// Define the guard byte value.
+//
+
+#define TEST_MEMORY_GUARD_BYTE 0xEE
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+#if TEST_SIMD_ROUTINES
+
+BOOL
+TestSimdSupported (
+    VOID
+    );
+
+ULONG
+TestMemorySize (
+    PUCHAR Source,
+    PUCHAR Destination,
+    PUCHAR Reference,
+    UINTN Size,
+    UINTN SourceAlignment,
+    UINTN DestinationAlignment
+    );
+
+VOID
+TestBenchmarkMemoryRoutines (
+    PUCHAR Source,
+    PUCHAR Destination
+    );
+
+double
+TestGetSeconds (
+    VOID
+    );
+
+#endif
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+#if TEST_SIMD_ROUTINES
+
+//
+// Store the sizes tested beyond the exhaustive range, and swept by the
+// benchmark.
+//
+
+UINTN TestMemorySizes[] = {
+    1,
+    8,
+    16,
+    32,
+    64,
+    128,
+    256,
+    511,
+    1024,
+    4095,
+    16384,
+    65536,
+    262144,
+    1048575,
+    4194304,
+    TEST_MEMORY_BUFFER_SIZE - (2 * TEST_MEMORY_GUARD)
+};
+
+#endif
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+ULONG
+TestMemoryRoutines (
+    BOOL Benchmark
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests the SIMD memory and string routines.
+
+Arguments:
+
+    Benchmark - Supplies a boolean indicating whether or not to also time the
+        SIMD routines against the generic ones and print the results.
+
+Return Value:
+
+    Returns the number of failures in the test.
+
+--*/
+
+{
+
+    ULONG Failures;
+
+#if TEST_SIMD_ROUTINES
+
+    PUCHAR Destination;
+    UINTN DestinationAlignment;
+    PUCHAR Reference;
+    UINTN Size;
+    UINTN SizeIndex;
+    PUCHAR Source;
+    UINTN SourceAlignment;
+
+#endif
+
+    Failures = 0;
+
+#if TEST_SIMD_ROUTINES
+
+    if (TestSimdSupported() == FALSE) {
+        printf("Skipping SIMD memory tests: processor lacks support.\n");
+        return 0;
+    }
+
+    Source = malloc(TEST_MEMORY_BUFFER_SIZE);
+    Destination = malloc(TEST_MEMORY_BUFFER_SIZE);
+    Reference = malloc(TEST_MEMORY_BUFFER_SIZE);
+    if ((Source == NULL) || (Destination == NULL) || (Reference == NULL)) {
+        printf("Failed to allocate memory test buffers.\n");
+        Failures += 1;
+        goto TestMemoryRoutinesEnd;
+    }
+
+    for (SourceAlignment = 0;
+         SourceAlignment < TEST_MEMORY_ALIGNMENTS;
+         SourceAlignment += 1) {
+
+        for (DestinationAlignment = 0;
+             DestinationAlignment < TEST_MEMORY_ALIGNMENTS;
+             DestinationAlignment += 1) {
+
+            for (Size = 0; Size <= TEST_MEMORY_EXHAUSTIVE_SIZE; Size += 1) {
+                Failures += TestMemorySize(Source,
+                                           Destination,
+                                           Reference,
+                                           Size,
+                                           SourceAlignment,
+                                           DestinationAlignment);
+            }
+        }
+    }
+
+    //
+    // Run the larger sizes at a few alignments only, as they take longer.
+    //
+
+    for (SizeIndex = 0;
+         SizeIndex < sizeof(TestMemorySizes) / sizeof(TestMemorySizes[0]);
+         SizeIndex += 1) {
+
+        Size = TestMemorySizes[SizeIndex];
+        Failures += TestMemorySize(Source, Destination, Reference, Size, 0, 0);
+        Failures += TestMemorySize(Source, Destination, Reference, Size, 3, 7);
+        Failures += TestMemorySize(Source, Destination, Reference, Size, 9, 0);
+    }
+
+    if (Benchmark != FALSE) {
+        TestBenchmarkMemoryRoutines(Source, Destination);
+    }
+
+TestMemoryRoutinesEnd:
+    if (Source != NULL) {
+        free(Source);
+    }
+
+    if (Destination != NULL) {
+        free(Destination);
+    }
+
+    if (Reference != NULL) {
+        free(Reference);
+    }
+
+#endif
+
+    if (Failures != 0) {
+        printf("%d memory routine test failures.\n", Failures);
+    }
+
+    return Failures;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+#if TEST_SIMD_ROUTINES
+
+BOOL
+TestSimdSupported (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the processor running the test supports
+    the SIMD routines.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    TRUE if the SIMD routines can be run.
+
+    FALSE if the processor does not support them.
+
+--*/
+
+{
+
+#if defined(__i386)
+
+    return __builtin_cpu_supports("sse2");
+
+#elif defined(__amd64)
+
+    return TRUE;
+
+#elif defined(__ARM_NEON__)
+
+    return TRUE;
+
+#else
+
+    return FALSE;
+
+#endif
+
+}
+
+ULONG
+TestMemorySize (
+    PUCHAR Source,
+    PUCHAR Destination,
+    PUCHAR Reference,
+    UINTN Size,
+    UINTN SourceAlignment,
+    UINTN DestinationAlignment
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests each SIMD routine at a given size and alignment.
+
+Arguments:
+
+    Source - Supplies a pointer to the source buffer.
+
+    Destination - Supplies a pointer to the destination buffer.
+
+    Reference - Supplies a pointer to a buffer used to compute the expected
+        results.
+
+    Size - Supplies the number of bytes to operate on.
+
+    SourceAlignment - Supplies the offset from the start of the source buffer
+        guard region to operate on.
+
+    DestinationAlignment - Supplies the offset from the start of the
+        destination buffer guard region to operate on.
+
+Return Value:
+
+    Returns the number of failures.
+
+--*/
+
+{
+
+    INT Expected;
+    PVOID ExpectedFind;
+    ULONG Failures;
+    UINTN Index;
+    UINTN Length;
+    UINTN Mismatch;
+    INT Result;
+    PVOID ResultFind;
+    PUCHAR SourceStart;
+    PUCHAR Start;
+    UINTN Total;
+
+    Failures = 0;
+    Total = Size + (2 * TEST_MEMORY_GUARD);
+    SourceStart = Source + TEST_MEMORY_GUARD + SourceAlignment;
+    Start = Destination + TEST_MEMORY_GUARD + DestinationAlignment;
+    for (Index = 0; Index < Total; Index += 1) {
+        Source[Index] = rand();
+        Destination[Index] = TEST_MEMORY_GUARD_BYTE;
+        Reference[Index] = TEST_MEMORY_GUARD_BYTE;
+    }
+
+    //
+    // Test copy, making sure nothing outside the region was touched.
+    //
+
+    for (Index = 0; Index < Size; Index += 1) {
+        Reference[TEST_MEMORY_GUARD + DestinationAlignment + Index] =
+                                                            SourceStart[Index];
+    }
+
+    if ((RtlCopyMemorySimd(Start, SourceStart, Size) != Start) ||
+        (memcmp(Destination, Reference, Total) != 0)) {
+
+        printf("RtlCopyMemorySimd failed: Size %ld, alignment %ld/%ld.\n",
+               (long)Size,
+               (long)SourceAlignment,
+               (long)DestinationAlignment);
+
+        Failures += 1;
+    }
+
+    //
+    // Test set.
+    //
+
+    for (Index = 0; Index < Size; Index += 1) {
+        Reference[TEST_MEMORY_GUARD + DestinationAlignment + Index] = 0xA5;
+    }
+
+    RtlSetMemorySimd(Start, 0x1A5, Size);
+    if (memcmp(Destination, Reference, Total) != 0) {
+        printf("RtlSetMemorySimd failed: Size %ld, alignment %ld.\n",
+               (long)Size,
+               (long)DestinationAlignment);
+
+        Failures += 1;
+    }
+
+    //
+    // Test compare, first on equal buffers and then with a difference at a
+    // random point.
+    //
+
+    for (Index = 0; Index < Size; Index += 1) {
+        Start[Index] = SourceStart[Index];
+    }
+
+    if (RtlCompareMemorySimd(Start, SourceStart, Size) != 0) {
+        printf("RtlCompareMemorySimd failed on equal buffers: Size %ld.\n",
+               (long)Size);
+
+        Failures += 1;
+    }
+
+    if (Size != 0) {
+        Mismatch = rand() % Size;
+        Start[Mismatch] ^= 0x80;
+        Expected = (INT)Start[Mismatch] - (INT)SourceStart[Mismatch];
+        Result = RtlCompareMemorySimd(Start, SourceStart, Size);
+        if (Result != Expected) {
+            printf("RtlCompareMemorySimd failed: Size %ld, mismatch at %ld, "
+                   "got %d expected %d.\n",
+                   (long)Size,
+                   (long)Mismatch,
+                   Result,
+                   Expected);
+
+            Failures += 1;
+        }
+    }
+
+    //
+    // Test string length with a terminator right at the end of the region.
+    //
+
+    for (Index = 0; Index < Size; Index += 1) {
+        Start[Index] = (Index % 255) + 1;
+    }
+
+    Start[Size] = '\0';
+    Length = RtlStringLengthSimd((PCSTR)Start);
+    if (Length != Size) {
+        printf("RtlStringLengthSimd failed: Size %ld, alignment %ld, "
+               "got %ld.\n",
+               (long)Size,
+               (long)DestinationAlignment,
+               (long)Length);
+
+        Failures += 1;
+    }
+
+    //
+    // Test finding a byte, first with the byte just past the region and then
+    // with the byte at a random point within it.
+    //
+
+    for (Index = 0; Index < Size; Index += 1) {
+        Start[Index] = 1;
+    }
+
+    Start[Size] = 7;
+    if (RtlFindByteSimd(Start, 7, Size) != NULL) {
+        printf("RtlFindByteSimd found a byte past the end: Size %ld.\n",
+               (long)Size);
+
+        Failures += 1;
+    }
+
+    if (Size != 0) {
+        Start[rand() % Size] = 7;
+        ExpectedFind = memchr(Start, 7, Size);
+        ResultFind = RtlFindByteSimd(Start, 0x107, Size);
+        if (ResultFind != ExpectedFind) {
+            printf("RtlFindByteSimd failed: Size %ld, got %p expected %p.\n",
+                   (long)Size,
+                   ResultFind,
+                   ExpectedFind);
+
+            Failures += 1;
+        }
+    }
+
+    return Failures;
+}
+
+VOID
+TestBenchmarkMemoryRoutines (
+    PUCHAR Source,
+    PUCHAR Destination
+    )
+
+/*++
+
+Routine Description:
+
+    This routine times the generic and SIMD memory routines across the size
+    sweep and prints the throughput of each.
+
+Arguments:
+
+    Source - Supplies a pointer to the source buffer.
+
+    Destination - Supplies a pointer to the destination buffer.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    double Generic;
+    UINTN Iteration;
+    UINTN Iterations;
+    double Megabytes;
+    UINTN Size;
+    UINTN SizeIndex;
+    double Simd;
+    double Start;
+
+    printf("%10s %10s %10s %10s %10s (MB/s)\n",
+           "Size",
+           "copy",
+           "copy simd",
+           "set",
+           "set simd");
+
+    for (SizeIndex = 0;
+         SizeIndex < sizeof(TestMemorySizes) / sizeof(TestMemorySizes[0]);
+         SizeIndex += 1) {
+
+        Size = TestMemorySizes[SizeIndex];
+        Iterations = TEST_MEMORY_BENCHMARK_TOTAL / Size;
+        Megabytes = ((double)Size * Iterations) / (1024.0 * 1024.0);
+        printf("%10ld ", (long)Size);
+        Start = TestGetSeconds();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            RtlCopyMemory(Destination, Source, Size);
+        }
+
+        Generic = TestGetSeconds() - Start + TEST_MEMORY_MINIMUM_TIME;
+        Start = TestGetSeconds();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            RtlCopyMemorySimd(Destination, Source, Size);
+        }
+
+        Simd = TestGetSeconds() - Start + TEST_MEMORY_MINIMUM_TIME;
+        printf("%10.0f %10.0f ", Megabytes / Generic, Megabytes / Simd);
+        Start = TestGetSeconds();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            RtlSetMemory(Destination, Iteration, Size);
+        }
+
+        Generic = TestGetSeconds() - Start + TEST_MEMORY_MINIMUM_TIME;
+        Start = TestGetSeconds();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            RtlSetMemorySimd(Destination, Iteration, Size);
+        }
+
+        Simd = TestGetSeconds() - Start + TEST_MEMORY_MINIMUM_TIME;
+        printf("%10.0f %10.0f\n", Megabytes / Generic, Megabytes / Simd);
+    }
+
+    return;
+}
+
+double
+TestGetSeconds (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the processor time used so far, in seconds.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the processor time in seconds.
+
+--*/
+
+{
+
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+#endif
+
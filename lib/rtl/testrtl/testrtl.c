@@ -71,6 +71,19 @@ Module Name:
 #define FORMATTED_STRING_POSITIONAL_RESULT \
     "   -0001; ff; 255; 1ffffeeee; a       ; ; 6"
 
+#define PRINT_INTEGER_FORMAT \
+    "%d %d %u %llu %lld %o %#X|%40d|%-40u|%.30d"
+
+#define PRINT_INTEGER_ARGUMENTS \
+    9, 10, 4294967295U, 18446744073709551615ULL, \
+    -9223372036854775807LL - 1, 8, 255, 100, 99, -42
+
+#define PRINT_INTEGER_RESULT \
+    "9 10 4294967295 18446744073709551615 -9223372036854775808 10 0XFF|" \
+    "                                     100|" \
+    "99                                      |" \
+    "-000000000000000000000000000042"
+
 #define PRINT_FLOAT_FORMAT               \
     "% 1f %5F % e %+#E %+g %.7G\n"       \
     "% 030F\n"                           \
@@ -433,6 +446,11 @@ TestTime (
     VOID
     );
 
+ULONG
+TestMemoryRoutines (
+    BOOL Benchmark
+    );
+
 ULONG
 TestRedBlackTrees (
     BOOL Quiet
@@ -581,6 +599,7 @@ Return Value:
 
 {
 
+    BOOL Benchmark;
     int BytesPrinted;
     ULONGLONG Dividend;
     ULONGLONG Divisor;
@@ -599,6 +618,12 @@ Return Value:
     TestsFailed += TestSoftFloatDouble();
     TestsFailed += TestTime();
     TestsFailed += TestHeaps(TRUE);
+    Benchmark = FALSE;
+    if ((ArgumentCount > 1) && (strcmp(Arguments[1], "--benchmark") == 0)) {
+        Benchmark = TRUE;
+    }
+
+    TestsFailed += TestMemoryRoutines(Benchmark);
 
     //
     // Test basic unsigned division.
@@ -958,6 +983,27 @@ Return Value:
         TestsFailed += 1;
     }
 
+    //
+    // Test integer conversions across digit and word size boundaries, and
+    // padding wider than the internal padding buffer.
+    //
+
+    StringLength = RtlPrintToString(PrintOutput,
+                                    MAX_OUTPUT,
+                                    CharacterEncodingDefault,
+                                    PRINT_INTEGER_FORMAT,
+                                    PRINT_INTEGER_ARGUMENTS);
+
+    if ((StringLength != strlen(PRINT_INTEGER_RESULT) + 1) ||
+        (strcmp(PrintOutput, PRINT_INTEGER_RESULT) != 0)) {
+
+        printf("Error: Print integers failed:\nOutput : %s\nCorrect: %s\n",
+               PrintOutput,
+               PRINT_INTEGER_RESULT);
+
+        TestsFailed += 1;
+    }
+
     //
     // Test wide basic print, no formatting, with output.
     //